@@ -874,6 +874,19 @@ static const bool audio_enable_menu_bgm    = false;
 /* How many frames to rewind at a time. */
 #define DEFAULT_REWIND_GRANULARITY 1
 
+/* Number of threads computing rewind deltas in the background,
+ * overlapped with the following frames. 0 = compute them on the
+ * main thread when the state is pushed */
+#define DEFAULT_REWIND_THREADS 0
+
+/* Keep the rewind buffer in a file mapped from the cache directory
+ * instead of anonymous memory. */
+#define DEFAULT_REWIND_BUFFER_TO_DISK false
+
+/* Size in MB of the zlib-compressed archive that patches dropped
+ * from the rewind buffer are moved to. 0 = drop them. */
+#define DEFAULT_REWIND_ARCHIVE_SIZE 0
+
 /* Pause gameplay when gameplay loses focus. */
 #ifdef EMSCRIPTEN
 #define DEFAULT_PAUSE_NONACTIVE false
@@ -1004,6 +1017,12 @@ static const uint16_t network_remote_base_port = 55400;
  * a new one) */
 #define DEFAULT_CORE_UPDATER_AUTO_BACKUP_HISTORY_SIZE 1
 
+/* Decompressed hunks kept in memory for each open
+ * CHD image, and how many of them are decompressed
+ * ahead of sequential reads (CD hunks are ~19 KB) */
+#define DEFAULT_CHD_CACHE_HUNKS 16
+#define DEFAULT_CHD_READAHEAD_HUNKS 4
+
 #if defined(ANDROID) || defined(IOS)
 #define DEFAULT_NETWORK_ON_DEMAND_THUMBNAILS true
 #else
@@ -1030,6 +1049,10 @@ static const int default_content_favorites_size = 200;
 #define DEFAULT_PLAYLIST_COMPRESSION false
 #endif
 
+/* Keep a binary copy of each playlist that can be
+ * loaded without parsing, at the cost of disk space */
+#define DEFAULT_PLAYLIST_BINARY_CACHE false
+
 #ifdef HAVE_MENU
 /* Specify when to display 'core name' inline on playlist entries */
 #define DEFAULT_PLAYLIST_SHOW_INLINE_CORE_NAME PLAYLIST_INLINE_CORE_DISPLAY_HIST_FAV
@@ -1045,6 +1068,10 @@ static const int default_content_favorites_size = 200;
 
 #define DEFAULT_SCAN_WITHOUT_CORE_MATCH false
 
+/* Number of threads used to hash content files
+ * during a database scan. 0 = one per CPU core */
+#define DEFAULT_SCAN_HASH_THREADS 0
+
 #ifdef __WINRT__
 /* Be paranoid about WinRT file I/O performance, and leave this disabled by
  * default */
@@ -1127,6 +1154,12 @@ static const unsigned menu_left_thumbnails_default = 0;
 
 static const unsigned gfx_thumbnail_upscale_threshold = 0;
 
+/* Size in MB of the on-disk cache of decoded (and upscaled)
+ * thumbnails, kept in the cache directory (or the thumbnails
+ * directory, if none is set). 0 = decode thumbnails every time
+ * they are shown. */
+#define DEFAULT_GFX_THUMBNAIL_CACHE_SIZE 0
+
 #ifdef HAVE_MENU
 #define DEFAULT_MENU_TIMEDATE_STYLE          MENU_TIMEDATE_STYLE_DDMM_HM
 #define DEFAULT_MENU_TIMEDATE_DATE_SEPARATOR MENU_TIMEDATE_DATE_SEPARATOR_HYPHEN
@@ -347,6 +347,7 @@ typedef struct settings
       bool history_list_enable;
       bool playlist_entry_rename;
       bool rewind_enable;
+      bool rewind_buffer_to_disk;
       bool vrr_runloop_enable;
       bool apply_cheats_after_toggle;
       bool apply_cheats_after_load;
@@ -398,6 +399,7 @@ typedef struct settings
       bool sustained_performance_mode;
       bool playlist_use_old_format;
       bool playlist_compression;
+      bool playlist_binary_cache;
       bool content_runtime_log;
       bool content_runtime_log_aggregate;
 
@@ -526,6 +528,8 @@ typedef struct settings
       unsigned libretro_log_level;
       unsigned rewind_granularity;
       unsigned rewind_buffer_size_step;
+      unsigned rewind_threads;
+      unsigned rewind_archive_size;
       unsigned autosave_interval;
       unsigned network_cmd_port;
       unsigned network_remote_base_port;
@@ -572,6 +576,7 @@ typedef struct settings
       unsigned gfx_thumbnails;
       unsigned menu_left_thumbnails;
       unsigned gfx_thumbnail_upscale_threshold;
+      unsigned gfx_thumbnail_cache_size;
       unsigned menu_rgui_thumbnail_downscaler;
       unsigned menu_rgui_thumbnail_delay;
       unsigned menu_rgui_color_theme;
@@ -636,12 +641,17 @@ typedef struct settings
 
       unsigned video_record_threads;
 
+      unsigned scan_hash_threads;
+
       unsigned libnx_overclock;
       unsigned ai_service_mode;
       unsigned ai_service_target_lang;
       unsigned ai_service_source_lang;
 
       unsigned core_updater_auto_backup_history_size;
+
+      unsigned chd_cache_hunks;
+      unsigned chd_readahead_hunks;
    } uints;
 
    struct
@@ -15,6 +15,10 @@
  *  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <stdlib.h>
+#include <string.h>
+
+#include <memmap.h>
 #include <compat/strl.h>
 #include <string/stdstring.h>
 #include <file/config_file.h>
@@ -22,11 +26,17 @@
 #include <streams/file_stream.h>
 #include <lists/dir_list.h>
 #include <file/archive_file.h>
+#include <rhash.h>
 
 #ifdef HAVE_CONFIG_H
 #include "config.h"
 #endif
 
+#ifdef HAVE_MMAN
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 #include "retroarch.h"
 
 #include "core_info.h"
@@ -36,6 +46,11 @@
 #include "uwp/uwp_func.h"
 #endif
 
+#define CORE_INFO_CACHE_FILE        "core_info_%08x.cache"
+#define CORE_INFO_CACHE_MAGIC       "RACINF1"
+#define CORE_INFO_CACHE_BYTE_ORDER  0x01020304
+#define CORE_INFO_CACHE_VERSION     1
+
 enum compare_op
 {
    COMPARE_OP_EQUAL = 0,
@@ -46,6 +61,115 @@ enum compare_op
    COMPARE_OP_GREATER_EQUAL
 };
 
+/* Core info cache
+ *
+ * Parsed .info files are kept in a single binary file inside the
+ * cache directory (or the info directory, if no cache directory is
+ * set), named after a hash of the info directory path, so that
+ * startup only has to stat each .info file instead of opening and
+ * parsing it. On-disk layout, in host byte order:
+ *
+ *   core_info_cache_header
+ *   core_info_cache_record   [record_count], sorted by info file name
+ *   core_info_cache_firmware [firmware_count]
+ *   string table; offset 0 holds an empty string and stands for NULL
+ *
+ * A record is used only while the size and mtime of its .info file
+ * are unchanged. Files that changed are re-parsed and the cache is
+ * rewritten to a temporary file, which is then renamed over the old
+ * one, so readers never see a partially written cache. */
+
+enum core_info_cache_flags
+{
+   CORE_INFO_CACHE_SUPPORTS_NO_GAME = (1 << 0),
+   CORE_INFO_CACHE_MATCH_ARCHIVE    = (1 << 1),
+   CORE_INFO_CACHE_EXPERIMENTAL     = (1 << 2)
+};
+
+/* String members of core_info_t that come from the .info file */
+static const size_t core_info_cache_fields[] = {
+   offsetof(core_info_t, display_name),
+   offsetof(core_info_t, display_version),
+   offsetof(core_info_t, core_name),
+   offsetof(core_info_t, systemname),
+   offsetof(core_info_t, system_id),
+   offsetof(core_info_t, system_manufacturer),
+   offsetof(core_info_t, supported_extensions),
+   offsetof(core_info_t, authors),
+   offsetof(core_info_t, permissions),
+   offsetof(core_info_t, licenses),
+   offsetof(core_info_t, categories),
+   offsetof(core_info_t, databases),
+   offsetof(core_info_t, notes),
+   offsetof(core_info_t, required_hw_api),
+   offsetof(core_info_t, description)
+};
+
+#define CORE_INFO_CACHE_FIELD_COUNT \
+   (sizeof(core_info_cache_fields) / sizeof(core_info_cache_fields[0]))
+
+#define CORE_INFO_FIELD(info, i) \
+   (*(char**)((uint8_t*)(info) + core_info_cache_fields[i]))
+
+typedef struct core_info_cache_header
+{
+   char magic[8];
+   uint32_t byte_order;
+   uint32_t version;
+   uint32_t record_count;
+   uint32_t firmware_count;
+   uint32_t strings_size;
+   uint32_t reserved;
+} core_info_cache_header_t;
+
+typedef struct core_info_cache_record
+{
+   int64_t info_size;
+   int64_t info_mtime;
+   uint32_t info_name;
+   uint32_t flags;
+   uint32_t firmware_index;
+   uint32_t firmware_count;
+   uint32_t fields[CORE_INFO_CACHE_FIELD_COUNT];
+} core_info_cache_record_t;
+
+typedef struct core_info_cache_firmware
+{
+   uint32_t path;
+   uint32_t desc;
+   uint32_t optional;
+} core_info_cache_firmware_t;
+
+/* A loaded cache file */
+typedef struct core_info_cache
+{
+   uint8_t *data;
+   size_t size;
+   bool mapped;
+   const core_info_cache_header_t *header;
+   const core_info_cache_record_t *records;
+   const core_info_cache_firmware_t *firmware;
+   const char *strings;
+} core_info_cache_t;
+
+/* Contents of the cache file to be written */
+typedef struct core_info_cache_builder
+{
+   core_info_cache_record_t *records;
+   core_info_cache_firmware_t *firmware;
+   char *strings;
+   size_t record_count;
+   size_t record_capacity;
+   size_t firmware_count;
+   size_t firmware_capacity;
+   size_t strings_size;
+   size_t strings_capacity;
+   /* Set when the file on disk no longer matches */
+   bool dirty;
+   /* Set on allocation failure; nothing is written then */
+   bool failed;
+} core_info_cache_builder_t;
+
 static void core_info_list_resolve_all_extensions(
       core_info_list_t *core_info_list)
 {
@@ -86,57 +210,650 @@ static void core_info_list_resolve_all_extensions(
 #endif
 }
 
-static void core_info_list_resolve_all_firmware(
-      core_info_list_t *core_info_list)
+static void core_info_resolve_firmware(core_info_t *info,
+      config_file_t *config)
 {
-   size_t i;
    unsigned c;
+   unsigned count                 = 0;
+   core_info_firmware_t *firmware = NULL;
 
-   for (i = 0; i < core_info_list->count; i++)
+   if (!config_get_uint(config, "firmware_count", &count))
+      return;
+
+   firmware = (core_info_firmware_t*)calloc(count, sizeof(*firmware));
+
+   if (!firmware)
+      return;
+
+   info->firmware = firmware;
+
+   for (c = 0; c < count; c++)
    {
-      unsigned count                  = 0;
-      core_info_firmware_t *firmware  = NULL;
-      core_info_t *info               = (core_info_t*)&core_info_list->list[i];
-      config_file_t *config           = (config_file_t*)info->config_data;
+      char path_key[64];
+      char desc_key[64];
+      char opt_key[64];
+      struct config_entry_list 
+         *entry         = NULL;
+      bool tmp_bool     = false;
+      path_key[0]       = desc_key[0] = opt_key[0] = '\0';
 
-      if (!config || !config_get_uint(config, "firmware_count", &count))
-         continue;
+      snprintf(path_key, sizeof(path_key), "firmware%u_path", c);
+      snprintf(desc_key, sizeof(desc_key), "firmware%u_desc", c);
+      snprintf(opt_key,  sizeof(opt_key),  "firmware%u_opt",  c);
 
-      firmware = (core_info_firmware_t*)calloc(count, sizeof(*firmware));
+      entry             = config_get_entry(config, path_key, NULL);
 
-      if (!firmware)
-         continue;
+      if (entry && !string_is_empty(entry->value))
+         info->firmware[c].path = strdup(entry->value);
+
+      entry             = config_get_entry(config, desc_key, NULL);
+
+      if (entry && !string_is_empty(entry->value))
+         info->firmware[c].desc     = strdup(entry->value);
+
+      if (config_get_bool(config, opt_key , &tmp_bool))
+         info->firmware[c].optional = tmp_bool;
+   }
+}
+
+/* Builds the '|'-separated lists from their source strings */
+static void core_info_split_lists(core_info_t *info)
+{
+   if (info->supported_extensions)
+      info->supported_extensions_list =
+         string_split(info->supported_extensions, "|");
+   if (info->authors)
+      info->authors_list     = string_split(info->authors, "|");
+   if (info->permissions)
+      info->permissions_list = string_split(info->permissions, "|");
+   if (info->licenses)
+      info->licenses_list    = string_split(info->licenses, "|");
+   if (info->categories)
+      info->categories_list  = string_split(info->categories, "|");
+   if (info->databases)
+      info->databases_list   = string_split(info->databases, "|");
+   if (info->notes)
+      info->note_list        = string_split(info->notes, "|");
+   if (info->required_hw_api)
+      info->required_hw_api_list =
+         string_split(info->required_hw_api, "|");
+}
+
+static void core_info_parse_config(core_info_t *info, config_file_t *conf)
+{
+   bool tmp_bool      = false;
+   unsigned tmp_uint  = 0;
+   struct config_entry_list 
+      *entry = config_get_entry(conf, "display_name", NULL);
+
+   if (entry && !string_is_empty(entry->value))
+      info->display_name = strdup(entry->value);
+
+   entry = config_get_entry(conf, "display_version", NULL);
+
+   if (entry && !string_is_empty(entry->value))
+      info->display_version = strdup(entry->value);
+
+   entry = config_get_entry(conf, "corename", NULL);
+
+   if (entry && !string_is_empty(entry->value))
+      info->core_name = strdup(entry->value);
+
+   entry = config_get_entry(conf, "systemname", NULL);
+
+   if (entry && !string_is_empty(entry->value))
+      info->systemname = strdup(entry->value);
+
+   entry = config_get_entry(conf, "systemid", NULL);
+
+   if (entry && !string_is_empty(entry->value))
+      info->system_id = strdup(entry->value);
+
+   entry = config_get_entry(conf, "manufacturer", NULL);
+
+   if (entry && !string_is_empty(entry->value))
+      info->system_manufacturer = strdup(entry->value);
+
+   config_get_uint(conf, "firmware_count", &tmp_uint);
+   info->firmware_count = tmp_uint;
+
+   entry = config_get_entry(conf, "supported_extensions", NULL);
+
+   if (entry && !string_is_empty(entry->value))
+      info->supported_extensions = strdup(entry->value);
+
+   entry = config_get_entry(conf, "authors", NULL);
+
+   if (entry && !string_is_empty(entry->value))
+      info->authors = strdup(entry->value);
+
+   entry = config_get_entry(conf, "permissions", NULL);
+
+   if (entry && !string_is_empty(entry->value))
+      info->permissions = strdup(entry->value);
+
+   entry = config_get_entry(conf, "license", NULL);
+
+   if (entry && !string_is_empty(entry->value))
+      info->licenses = strdup(entry->value);
+
+   entry = config_get_entry(conf, "categories", NULL);
+
+   if (entry && !string_is_empty(entry->value))
+      info->categories = strdup(entry->value);
+
+   entry = config_get_entry(conf, "database", NULL);
+
+   if (entry && !string_is_empty(entry->value))
+      info->databases = strdup(entry->value);
+
+   entry = config_get_entry(conf, "notes", NULL);
+
+   if (entry && !string_is_empty(entry->value))
+      info->notes = strdup(entry->value);
+
+   entry = config_get_entry(conf, "required_hw_api", NULL);
+
+   if (entry && !string_is_empty(entry->value))
+      info->required_hw_api = strdup(entry->value);
 
-      info->firmware = firmware;
+   entry = config_get_entry(conf, "description", NULL);
 
-      for (c = 0; c < count; c++)
+   if (entry && !string_is_empty(entry->value))
+      info->description = strdup(entry->value);
+
+   if (config_get_bool(conf, "supports_no_game",
+            &tmp_bool))
+      info->supports_no_game = tmp_bool;
+
+   if (config_get_bool(conf, "database_match_archive_member",
+            &tmp_bool))
+      info->database_match_archive_member = tmp_bool;
+
+   if (config_get_bool(conf, "is_experimental",
+            &tmp_bool))
+      info->is_experimental = tmp_bool;
+
+   core_info_resolve_firmware(info, conf);
+   core_info_split_lists(info);
+
+   info->has_info = true;
+}
+
+static void core_info_cache_unload(core_info_cache_t *cache)
+{
+   if (!cache->data)
+      return;
+#ifdef HAVE_MMAN
+   if (cache->mapped)
+      munmap(cache->data, cache->size);
+   else
+#endif
+      free(cache->data);
+   cache->data   = NULL;
+   cache->size   = 0;
+   cache->mapped = false;
+}
+
+static bool core_info_cache_attach(core_info_cache_t *cache)
+{
+   const core_info_cache_header_t *header =
+      (const core_info_cache_header_t*)cache->data;
+   size_t expected;
+
+   if (cache->size < sizeof(*header))
+      return false;
+   if (memcmp(header->magic, CORE_INFO_CACHE_MAGIC,
+            sizeof(CORE_INFO_CACHE_MAGIC)) != 0)
+      return false;
+   if (     header->byte_order != CORE_INFO_CACHE_BYTE_ORDER
+         || header->version    != CORE_INFO_CACHE_VERSION
+         || header->strings_size == 0)
+      return false;
+
+   expected = sizeof(*header)
+      + header->record_count   * sizeof(core_info_cache_record_t)
+      + header->firmware_count * sizeof(core_info_cache_firmware_t)
+      + header->strings_size;
+
+   if (cache->size != expected)
+      return false;
+
+   cache->header   = header;
+   cache->records  = (const core_info_cache_record_t*)(header + 1);
+   cache->firmware = (const core_info_cache_firmware_t*)
+      (cache->records + header->record_count);
+   cache->strings  = (const char*)
+      (cache->firmware + header->firmware_count);
+
+   return cache->strings[header->strings_size - 1] == '\0';
+}
+
+/**
+ * core_info_cache_load:
+ * @cache              : Receives the cache contents.
+ * @path               : Path of the cache file.
+ *
+ * Maps (or reads, where mmap is unavailable) the cache file.
+ *
+ * Returns: true if a valid cache file was loaded.
+ **/
+static bool core_info_cache_load(core_info_cache_t *cache,
+      const char *path)
+{
+#ifdef HAVE_MMAN
+   int fd         = open(path, O_RDONLY);
+   off_t len;
+   void *ptr;
+
+   if (fd < 0)
+      return false;
+
+   len            = lseek(fd, 0, SEEK_END);
+   if (len <= 0)
+   {
+      close(fd);
+      return false;
+   }
+
+   ptr            = mmap(NULL, (size_t)len, PROT_READ, MAP_SHARED, fd, 0);
+   close(fd);
+
+   if (ptr == MAP_FAILED)
+      return false;
+
+   cache->data    = (uint8_t*)ptr;
+   cache->size    = (size_t)len;
+   cache->mapped  = true;
+#else
+   void *buf      = NULL;
+   int64_t len    = 0;
+
+   if (!path_is_valid(path))
+      return false;
+
+   if (!filestream_read_file(path, &buf, &len) || len <= 0)
+   {
+      if (buf)
+         free(buf);
+      return false;
+   }
+
+   cache->data    = (uint8_t*)buf;
+   cache->size    = (size_t)len;
+   cache->mapped  = false;
+#endif
+
+   if (core_info_cache_attach(cache))
+      return true;
+
+   core_info_cache_unload(cache);
+   return false;
+}
+
+static const char *core_info_cache_string(const core_info_cache_t *cache,
+      uint32_t offset)
+{
+   if (offset == 0 || offset >= cache->header->strings_size)
+      return NULL;
+   return cache->strings + offset;
+}
+
+static const core_info_cache_record_t *core_info_cache_find(
+      const core_info_cache_t *cache, const char *info_name)
+{
+   size_t lo = 0;
+   size_t hi = cache->data ? cache->header->record_count : 0;
+
+   while (lo < hi)
+   {
+      size_t mid       = lo + (hi - lo) / 2;
+      const char *name = core_info_cache_string(cache,
+            cache->records[mid].info_name);
+      int cmp          = strcmp(info_name, name ? name : "");
+
+      if (cmp == 0)
+         return &cache->records[mid];
+      if (cmp < 0)
+         hi = mid;
+      else
+         lo = mid + 1;
+   }
+
+   return NULL;
+}
+
+static void core_info_from_cache(core_info_t *info,
+      const core_info_cache_t *cache, const core_info_cache_record_t *rec)
+{
+   size_t i;
+
+   for (i = 0; i < CORE_INFO_CACHE_FIELD_COUNT; i++)
+   {
+      const char *str = core_info_cache_string(cache, rec->fields[i]);
+      if (str)
+         CORE_INFO_FIELD(info, i) = strdup(str);
+   }
+
+   info->supports_no_game              =
+      (rec->flags & CORE_INFO_CACHE_SUPPORTS_NO_GAME) != 0;
+   info->database_match_archive_member =
+      (rec->flags & CORE_INFO_CACHE_MATCH_ARCHIVE) != 0;
+   info->is_experimental               =
+      (rec->flags & CORE_INFO_CACHE_EXPERIMENTAL) != 0;
+   info->firmware_count                = rec->firmware_count;
+
+   if (     rec->firmware_count > 0
+         && rec->firmware_index <= cache->header->firmware_count
+         && rec->firmware_count <=
+            cache->header->firmware_count - rec->firmware_index)
+   {
+      info->firmware = (core_info_firmware_t*)
+         calloc(rec->firmware_count, sizeof(*info->firmware));
+
+      if (info->firmware)
       {
-         char path_key[64];
-         char desc_key[64];
-         char opt_key[64];
-         struct config_entry_list 
-            *entry         = NULL;
-         bool tmp_bool     = false;
-         path_key[0]       = desc_key[0] = opt_key[0] = '\0';
+         for (i = 0; i < rec->firmware_count; i++)
+         {
+            const core_info_cache_firmware_t *fw =
+               &cache->firmware[rec->firmware_index + i];
+            const char *path = core_info_cache_string(cache, fw->path);
+            const char *desc = core_info_cache_string(cache, fw->desc);
+
+            if (path)
+               info->firmware[i].path = strdup(path);
+            if (desc)
+               info->firmware[i].desc = strdup(desc);
+            info->firmware[i].optional = fw->optional != 0;
+         }
+      }
+   }
+   else
+      info->firmware_count = 0;
 
-         snprintf(path_key, sizeof(path_key), "firmware%u_path", c);
-         snprintf(desc_key, sizeof(desc_key), "firmware%u_desc", c);
-         snprintf(opt_key,  sizeof(opt_key),  "firmware%u_opt",  c);
+   core_info_split_lists(info);
 
-         entry             = config_get_entry(config, path_key, NULL);
+   info->has_info = true;
+}
 
-         if (entry && !string_is_empty(entry->value))
-            info->firmware[c].path = strdup(entry->value);
+static bool core_info_cache_builder_reserve(void **buf, size_t *capacity,
+      size_t needed, size_t elem_size)
+{
+   void *tmp;
+   size_t new_capacity = *capacity ? *capacity : 64;
 
-         entry             = config_get_entry(config, desc_key, NULL);
+   if (needed <= *capacity)
+      return true;
 
-         if (entry && !string_is_empty(entry->value))
-            info->firmware[c].desc     = strdup(entry->value);
+   while (new_capacity < needed)
+      new_capacity *= 2;
 
-         if (config_get_bool(config, opt_key , &tmp_bool))
-            info->firmware[c].optional = tmp_bool;
+   if (!(tmp = realloc(*buf, new_capacity * elem_size)))
+      return false;
+
+   *buf      = tmp;
+   *capacity = new_capacity;
+   return true;
+}
+
+static uint32_t core_info_cache_builder_string(
+      core_info_cache_builder_t *builder, const char *str)
+{
+   size_t len;
+   uint32_t offset;
+
+   if (!str)
+      return 0;
+
+   len = strlen(str) + 1;
+
+   if (!core_info_cache_builder_reserve((void**)&builder->strings,
+            &builder->strings_capacity, builder->strings_size + len, 1))
+   {
+      builder->failed = true;
+      return 0;
+   }
+
+   offset = (uint32_t)builder->strings_size;
+   memcpy(builder->strings + offset, str, len);
+   builder->strings_size += len;
+
+   return offset;
+}
+
+/* Adds the .info derived fields of 'info' as a record */
+static void core_info_cache_builder_add(core_info_cache_builder_t *builder,
+      const core_info_t *info, const char *info_name,
+      int64_t info_size, int64_t info_mtime)
+{
+   size_t i;
+   core_info_cache_record_t *rec = NULL;
+
+   if (!core_info_cache_builder_reserve((void**)&builder->records,
+            &builder->record_capacity, builder->record_count + 1,
+            sizeof(*builder->records)))
+   {
+      builder->failed = true;
+      return;
+   }
+
+   if (info->firmware && !core_info_cache_builder_reserve(
+            (void**)&builder->firmware, &builder->firmware_capacity,
+            builder->firmware_count + info->firmware_count,
+            sizeof(*builder->firmware)))
+   {
+      builder->failed = true;
+      return;
+   }
+
+   rec                 = &builder->records[builder->record_count++];
+   memset(rec, 0, sizeof(*rec));
+   rec->info_size      = info_size;
+   rec->info_mtime     = info_mtime;
+   rec->info_name      = core_info_cache_builder_string(builder, info_name);
+
+   for (i = 0; i < CORE_INFO_CACHE_FIELD_COUNT; i++)
+      rec->fields[i]   = core_info_cache_builder_string(builder,
+            CORE_INFO_FIELD(info, i));
+
+   if (info->supports_no_game)
+      rec->flags      |= CORE_INFO_CACHE_SUPPORTS_NO_GAME;
+   if (info->database_match_archive_member)
+      rec->flags      |= CORE_INFO_CACHE_MATCH_ARCHIVE;
+   if (info->is_experimental)
+      rec->flags      |= CORE_INFO_CACHE_EXPERIMENTAL;
+
+   if (info->firmware)
+   {
+      rec->firmware_index = (uint32_t)builder->firmware_count;
+      rec->firmware_count = (uint32_t)info->firmware_count;
+
+      for (i = 0; i < info->firmware_count; i++)
+      {
+         core_info_cache_firmware_t *fw =
+            &builder->firmware[builder->firmware_count++];
+         fw->path     = core_info_cache_builder_string(builder,
+               info->firmware[i].path);
+         fw->desc     = core_info_cache_builder_string(builder,
+               info->firmware[i].desc);
+         fw->optional = info->firmware[i].optional ? 1 : 0;
+      }
+   }
+}
+
+/**
+ * core_info_cache_save:
+ * @path               : Path of the cache file.
+ * @data               : Cache contents.
+ * @size               : Size of @data in bytes.
+ *
+ * Writes the cache next to @path and renames it into place.
+ *
+ * Returns: true if the cache file was replaced.
+ **/
+static bool core_info_cache_save(const char *path,
+      const void *data, size_t size)
+{
+   char tmp_path[PATH_MAX_LENGTH];
+
+   snprintf(tmp_path, sizeof(tmp_path), "%s.%lx.tmp",
+         path, (unsigned long)(uintptr_t)data);
+
+   if (!filestream_write_file(tmp_path, data, (int64_t)size))
+   {
+      filestream_delete(tmp_path);
+      return false;
+   }
+
+   if (filestream_rename(tmp_path, path) != 0)
+   {
+      /* Windows will not rename over an existing file */
+      filestream_delete(path);
+      if (filestream_rename(tmp_path, path) != 0)
+      {
+         filestream_delete(tmp_path);
+         return false;
       }
    }
+
+   return true;
+}
+
+typedef struct core_info_cache_order
+{
+   const char *name;
+   size_t index;
+} core_info_cache_order_t;
+
+static int core_info_cache_order_cmp(const void *a_, const void *b_)
+{
+   const core_info_cache_order_t *a = (const core_info_cache_order_t*)a_;
+   const core_info_cache_order_t *b = (const core_info_cache_order_t*)b_;
+   return strcmp(a->name, b->name);
+}
+
+/**
+ * core_info_cache_update:
+ * @builder            : New cache contents.
+ * @cache              : Currently loaded cache, if any.
+ * @path               : Path of the cache file.
+ *
+ * Writes the records of @builder sorted by info file name,
+ * dropping duplicates (several cores may share one .info file).
+ * Skips the write if nothing was re-parsed and the current cache
+ * holds no records for .info files that are no longer used.
+ * @cache is unloaded before the new file replaces it.
+ **/
+static void core_info_cache_update(core_info_cache_builder_t *builder,
+      core_info_cache_t *cache, const char *path)
+{
+   size_t i;
+   size_t count                    = 0;
+   size_t size                     = 0;
+   uint8_t *data                   = NULL;
+   core_info_cache_order_t *order  = NULL;
+   core_info_cache_header_t *header;
+   core_info_cache_record_t *records;
+
+   if (     builder->failed
+         || builder->strings_size == 0
+         || (!builder->dirty && !cache->data))
+      return;
+
+   if (builder->record_count > 0)
+   {
+      order = (core_info_cache_order_t*)
+         malloc(builder->record_count * sizeof(*order));
+      if (!order)
+         return;
+
+      for (i = 0; i < builder->record_count; i++)
+      {
+         order[i].name  = builder->strings + builder->records[i].info_name;
+         order[i].index = i;
+      }
+
+      qsort(order, builder->record_count, sizeof(*order),
+            core_info_cache_order_cmp);
+   }
+
+   size = sizeof(*header)
+      + builder->record_count   * sizeof(core_info_cache_record_t)
+      + builder->firmware_count * sizeof(core_info_cache_firmware_t)
+      + builder->strings_size;
+
+   if (!(data = (uint8_t*)calloc(1, size)))
+   {
+      free(order);
+      return;
+   }
+
+   header  = (core_info_cache_header_t*)data;
+   records = (core_info_cache_record_t*)(header + 1);
+
+   for (i = 0; i < builder->record_count; i++)
+   {
+      if (i > 0 && string_is_equal(order[i].name, order[i - 1].name))
+         continue;
+      records[count++] = builder->records[order[i].index];
+   }
+
+   if (     !builder->dirty
+         && cache->data
+         && cache->header->record_count == count)
+   {
+      free(data);
+      free(order);
+      return;
+   }
+
+   /* Shift firmware and strings down over dropped duplicates */
+   memcpy(records + count, builder->firmware,
+         builder->firmware_count * sizeof(core_info_cache_firmware_t));
+   memcpy((uint8_t*)(records + count)
+         + builder->firmware_count * sizeof(core_info_cache_firmware_t),
+         builder->strings, builder->strings_size);
+
+   size -= (builder->record_count - count)
+      * sizeof(core_info_cache_record_t);
+
+   memcpy(header->magic, CORE_INFO_CACHE_MAGIC,
+         sizeof(CORE_INFO_CACHE_MAGIC));
+   header->byte_order     = CORE_INFO_CACHE_BYTE_ORDER;
+   header->version        = CORE_INFO_CACHE_VERSION;
+   header->record_count   = (uint32_t)count;
+   header->firmware_count = (uint32_t)builder->firmware_count;
+   header->strings_size   = (uint32_t)builder->strings_size;
+
+   /* The builder holds its own copies of every string, and an
+    * open mapping would keep Windows from replacing the file */
+   core_info_cache_unload(cache);
+   core_info_cache_save(path, data, size);
+
+   free(data);
+   free(order);
+}
+
+static void core_info_cache_builder_init(core_info_cache_builder_t *builder)
+{
+   memset(builder, 0, sizeof(*builder));
+
+   /* Offset 0 is the empty string, standing for NULL */
+   if (core_info_cache_builder_reserve((void**)&builder->strings,
+            &builder->strings_capacity, 1, 1))
+   {
+      builder->strings[0]    = '\0';
+      builder->strings_size  = 1;
+   }
+   else
+      builder->failed        = true;
+}
+
+static void core_info_cache_builder_free(core_info_cache_builder_t *builder)
+{
+   free(builder->records);
+   free(builder->firmware);
+   free(builder->strings);
 }
 
 static void core_info_list_free(core_info_list_t *core_info_list)
@@ -174,7 +891,6 @@ static void core_info_list_free(core_info_list_t *core_info_list)
       string_list_free(info->categories_list);
       string_list_free(info->databases_list);
       string_list_free(info->required_hw_api_list);
-      config_file_free((config_file_t*)info->config_data);
 
       for (j = 0; j < info->firmware_count; j++)
       {
@@ -191,19 +907,20 @@ static void core_info_list_free(core_info_list_t *core_info_list)
    free(core_info_list);
 }
 
-static config_file_t *core_info_list_iterate(
+/* Gets the path of the .info file belonging to the
+ * core at 'current_path' */
+static void core_info_get_info_path(
       const char *current_path,
-      const char *path_basedir)
+      const char *path_basedir,
+      char *s, size_t len)
 {
    size_t info_path_base_size = PATH_MAX_LENGTH * sizeof(char);
-   char *info_path_base       = NULL;
-   char *info_path            = NULL;
-   config_file_t *conf        = NULL;
+   char *info_path_base       = (char*)malloc(info_path_base_size);
 
-   if (!current_path)
-      return NULL;
+   s[0]                       = '\0';
 
-   info_path_base             = (char*)malloc(info_path_base_size);
+   if (!info_path_base)
+      return;
 
    info_path_base[0] = '\0';
 
@@ -221,12 +938,27 @@ static config_file_t *core_info_list_iterate(
 
    strlcat(info_path_base, ".info", info_path_base_size);
 
-   info_path = (char*)malloc(info_path_base_size);
-   fill_pathname_join(info_path,
-         path_basedir,
-         info_path_base, info_path_base_size);
+   fill_pathname_join(s, path_basedir, info_path_base, len);
    free(info_path_base);
-   info_path_base = NULL;
+}
+
+static config_file_t *core_info_list_iterate(
+      const char *current_path,
+      const char *path_basedir)
+{
+   size_t info_path_size      = PATH_MAX_LENGTH * sizeof(char);
+   char *info_path            = NULL;
+   config_file_t *conf        = NULL;
+
+   if (!current_path)
+      return NULL;
+
+   info_path = (char*)malloc(info_path_size);
+   if (!info_path)
+      return NULL;
+
+   core_info_get_info_path(current_path, path_basedir,
+         info_path, info_path_size);
 
    if (path_is_valid(info_path))
       conf = config_file_new_from_path_to_string(info_path);
@@ -267,10 +999,16 @@ static char *core_info_get_core_lock_file_path(const char *core_path)
 
 static core_info_list_t *core_info_list_new(const char *path,
       const char *libretro_info_dir,
+      const char *dir_cache,
       const char *exts,
       bool dir_show_hidden_files)
 {
    size_t i;
+   core_info_cache_t cache;
+   core_info_cache_builder_t builder;
+   size_t info_path_size            = PATH_MAX_LENGTH * sizeof(char);
+   char *info_path                  = NULL;
+   char *cache_path                 = NULL;
    core_info_t *core_info           = NULL;
    core_info_list_t *core_info_list = NULL;
    const char       *path_basedir   = libretro_info_dir;
@@ -322,140 +1060,81 @@ static core_info_list_t *core_info_list_new(const char *path,
    core_info_list->list    = core_info;
    core_info_list->count   = contents->size;
 
-   for (i = 0; i < contents->size; i++)
-   {
-      const char *base_path = contents->elems[i].data;
-      config_file_t *conf   = core_info_list_iterate(base_path,
-            path_basedir);
-
-      if (conf)
-      {
-         bool tmp_bool      = false;
-         unsigned tmp_uint  = 0;
-         struct config_entry_list 
-            *entry = config_get_entry(conf, "display_name", NULL);
-
-         if (entry && !string_is_empty(entry->value))
-            core_info[i].display_name = strdup(entry->value);
-
-         entry = config_get_entry(conf, "display_version", NULL);
-
-         if (entry && !string_is_empty(entry->value))
-            core_info[i].display_version = strdup(entry->value);
-
-         entry = config_get_entry(conf, "corename", NULL);
-
-         if (entry && !string_is_empty(entry->value))
-            core_info[i].core_name = strdup(entry->value);
-
-         entry = config_get_entry(conf, "systemname", NULL);
-
-         if (entry && !string_is_empty(entry->value))
-               core_info[i].systemname = strdup(entry->value);
-
-         entry = config_get_entry(conf, "systemid", NULL);
-
-         if (entry && !string_is_empty(entry->value))
-            core_info[i].system_id = strdup(entry->value);
-
-         entry = config_get_entry(conf, "manufacturer", NULL);
-
-         if (entry && !string_is_empty(entry->value))
-            core_info[i].system_manufacturer = strdup(entry->value);
-
-         config_get_uint(conf, "firmware_count", &tmp_uint);
-         core_info[i].firmware_count = tmp_uint;
-
-         entry = config_get_entry(conf, "supported_extensions", NULL);
-
-         if (entry && !string_is_empty(entry->value))
-         {
-            core_info[i].supported_extensions      = strdup(entry->value);
-            core_info[i].supported_extensions_list =
-               string_split(core_info[i].supported_extensions, "|");
-         }
-
-         entry = config_get_entry(conf, "authors", NULL);
+   cache_path = (char*)malloc(info_path_size);
+   info_path  = (char*)malloc(info_path_size);
 
-         if (entry && !string_is_empty(entry->value))
-         {
-            core_info[i].authors      = strdup(entry->value);
-            core_info[i].authors_list =
-               string_split(core_info[i].authors, "|");
-         }
-
-         entry = config_get_entry(conf, "permissions", NULL);
-
-         if (entry && !string_is_empty(entry->value))
-         {
-            core_info[i].permissions      = strdup(entry->value);
-            core_info[i].permissions_list =
-               string_split(core_info[i].permissions, "|");
-         }
-
-         entry = config_get_entry(conf, "license", NULL);
-
-         if (entry && !string_is_empty(entry->value))
-         {
-            core_info[i].licenses      = strdup(entry->value);
-            core_info[i].licenses_list =
-               string_split(core_info[i].licenses, "|");
-         }
-
-         entry = config_get_entry(conf, "categories", NULL);
+   if (!cache_path || !info_path)
+   {
+      free(cache_path);
+      free(info_path);
+      core_info_list_free(core_info_list);
+      string_list_free(contents);
+      return NULL;
+   }
 
-         if (entry && !string_is_empty(entry->value))
-         {
-            core_info[i].categories      = strdup(entry->value);
-            core_info[i].categories_list =
-               string_split(core_info[i].categories, "|");
-         }
+   /* The info directory may be read-only (e.g. system-wide
+    * installs), so prefer the cache directory */
+   snprintf(info_path, info_path_size, CORE_INFO_CACHE_FILE,
+         djb2_calculate(path_basedir));
+   if (!string_is_empty(dir_cache))
+   {
+      if (!path_is_directory(dir_cache))
+         path_mkdir(dir_cache);
+      fill_pathname_join(cache_path, dir_cache,
+            info_path, info_path_size);
+   }
+   else
+      fill_pathname_join(cache_path, path_basedir,
+            info_path, info_path_size);
 
-         entry = config_get_entry(conf, "database", NULL);
+   memset(&cache, 0, sizeof(cache));
+   core_info_cache_load(&cache, cache_path);
+   core_info_cache_builder_init(&builder);
 
-         if (entry && !string_is_empty(entry->value))
-         {
-            core_info[i].databases      = strdup(entry->value);
-            core_info[i].databases_list =
-               string_split(core_info[i].databases, "|");
-         }
+   for (i = 0; i < contents->size; i++)
+   {
+      const char *base_path = contents->elems[i].data;
+      int64_t info_size     = -1;
+      int64_t info_mtime    = -1;
 
-         entry = config_get_entry(conf, "notes", NULL);
+      if (!string_is_empty(base_path))
+      {
+         core_info_get_info_path(base_path, path_basedir,
+               info_path, info_path_size);
+         info_size = path_get_size(info_path);
+      }
 
-         if (entry && !string_is_empty(entry->value))
+      if (info_size >= 0)
+      {
+         const char *info_name               = path_basename(info_path);
+         const core_info_cache_record_t *rec =
+            core_info_cache_find(&cache, info_name);
+
+         /* Platforms that cannot report mtimes (0) always re-parse */
+         info_mtime = path_get_mtime(info_path);
+
+         if (     rec
+               && info_mtime > 0
+               && rec->info_size  == info_size
+               && rec->info_mtime == info_mtime)
+            core_info_from_cache(&core_info[i], &cache, rec);
+         else
          {
-            core_info[i].notes     = strdup(entry->value);
-            core_info[i].note_list =
-               string_split(core_info[i].notes, "|");
-         }
+            config_file_t *conf =
+               config_file_new_from_path_to_string(info_path);
 
-         entry = config_get_entry(conf, "required_hw_api", NULL);
+            if (conf)
+            {
+               core_info_parse_config(&core_info[i], conf);
+               config_file_free(conf);
+            }
 
-         if (entry && !string_is_empty(entry->value))
-         {
-            core_info[i].required_hw_api      = strdup(entry->value);
-            core_info[i].required_hw_api_list =
-               string_split(core_info[i].required_hw_api, "|");
+            builder.dirty = true;
          }
 
-         entry = config_get_entry(conf, "description", NULL);
-
-         if (entry && !string_is_empty(entry->value))
-            core_info[i].description = strdup(entry->value);
-
-         if (config_get_bool(conf, "supports_no_game",
-                  &tmp_bool))
-            core_info[i].supports_no_game = tmp_bool;
-
-         if (config_get_bool(conf, "database_match_archive_member",
-                  &tmp_bool))
-            core_info[i].database_match_archive_member = tmp_bool;
-
-         if (config_get_bool(conf, "is_experimental",
-                  &tmp_bool))
-            core_info[i].is_experimental = tmp_bool;
-
-         core_info[i].config_data = conf;
+         if (core_info[i].has_info && info_mtime > 0)
+            core_info_cache_builder_add(&builder, &core_info[i],
+                  info_name, info_size, info_mtime);
       }
 
       if (!string_is_empty(base_path))
@@ -501,11 +1180,14 @@ static core_info_list_t *core_info_list_new(const char *path,
       core_info[i].is_locked = core_info_get_core_lock(core_info[i].path, false);
    }
 
-   if (core_info_list)
-   {
-      core_info_list_resolve_all_extensions(core_info_list);
-      core_info_list_resolve_all_firmware(core_info_list);
-   }
+   core_info_list_resolve_all_extensions(core_info_list);
+
+   core_info_cache_update(&builder, &cache, cache_path);
+
+   core_info_cache_builder_free(&builder);
+   core_info_cache_unload(&cache);
+   free(cache_path);
+   free(info_path);
 
    string_list_free(contents);
    return core_info_list;
@@ -688,7 +1370,7 @@ bool core_info_init_current_core(void)
    current->is_locked                     = false;
    current->firmware_count                = 0;
    current->path                          = NULL;
-   current->config_data                   = NULL;
+   current->has_info                      = false;
    current->display_name                  = NULL;
    current->display_version               = NULL;
    current->core_name                     = NULL;
@@ -739,11 +1421,12 @@ void core_info_deinit_list(void)
 }
 
 bool core_info_init_list(const char *path_info, const char *dir_cores,
-      const char *exts, bool dir_show_hidden_files)
+      const char *dir_cache, const char *exts, bool dir_show_hidden_files)
 {
    core_info_state_t *p_coreinfo = coreinfo_get_ptr();
    if (!(p_coreinfo->curr_list = core_info_list_new(dir_cores,
                !string_is_empty(path_info) ? path_info : dir_cores,
+               dir_cache,
                exts,
                dir_show_hidden_files)))
       return false;
@@ -929,9 +1612,7 @@ size_t core_info_list_num_info_files(core_info_list_t *core_info_list)
 
    for (i = 0; i < core_info_list->count; i++)
    {
-      config_file_t *conf = (config_file_t*)
-         core_info_list->list[i].config_data;
-      num += !!conf;
+      num += core_info_list->list[i].has_info;
    }
 
    return num;
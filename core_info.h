@@ -58,9 +58,10 @@ typedef struct
    bool database_match_archive_member;
    bool is_experimental;
    bool is_locked;
+   /* Set if a matching .info file was found */
+   bool has_info;
    size_t firmware_count;
    char *path;
-   void *config_data;
    char *display_name;
    char *display_version;
    char *core_name;
@@ -176,7 +177,7 @@ bool core_info_get_current_core(core_info_t **core);
 void core_info_deinit_list(void);
 
 bool core_info_init_list(const char *path_info, const char *dir_cores,
-      const char *exts, bool show_hidden_files);
+      const char *dir_cache, const char *exts, bool show_hidden_files);
 
 bool core_info_get_list(core_info_list_t **core);
 
@@ -534,6 +534,60 @@ end:
    return database_info_list;
 }
 
+database_info_list_t *database_info_list_new_at(
+      const char *rdb_path, const uint64_t *offsets, size_t count)
+{
+   size_t i;
+   database_info_list_t *database_info_list = NULL;
+   libretrodb_t *db                         = libretrodb_new();
+   libretrodb_cursor_t *cur                 = libretrodb_cursor_new();
+
+   if (!db || !cur)
+      goto end;
+
+   if ((database_cursor_open(db, cur, rdb_path, NULL) != 0))
+      goto end;
+
+   database_info_list = (database_info_list_t*)
+      malloc(sizeof(*database_info_list));
+
+   if (!database_info_list)
+      goto end;
+
+   database_info_list->count  = 0;
+   database_info_list->list   = NULL;
+
+   if (count)
+      database_info_list->list = (database_info_t*)
+         calloc(count, sizeof(database_info_t));
+
+   if (!database_info_list->list)
+      goto end;
+
+   for (i = 0; i < count; i++)
+   {
+      database_info_t *db_ptr =
+         &database_info_list->list[database_info_list->count];
+
+      if (libretrodb_cursor_seek(cur, offsets[i]) != 0)
+         continue;
+
+      if (database_cursor_iterate(cur, db_ptr) == 0)
+         database_info_list->count++;
+   }
+
+end:
+   if (db)
+   {
+      database_cursor_close(db, cur);
+      libretrodb_free(db);
+   }
+   if (cur)
+      libretrodb_cursor_free(cur);
+
+   return database_info_list;
+}
+
 void database_info_list_free(database_info_list_t *database_info_list)
 {
    size_t i;
@@ -122,6 +122,11 @@ typedef struct
 database_info_list_t *database_info_list_new(const char *rdb_path,
       const char *query);
 
+/* Reads the items stored at @offsets in @rdb_path,
+ * as returned by rdb_index_find_crc()/rdb_index_find_serial(). */
+database_info_list_t *database_info_list_new_at(const char *rdb_path,
+      const uint64_t *offsets, size_t count);
+
 void database_info_list_free(database_info_list_t *list);
 
 database_info_handle_t *database_info_dir_init(const char *dir,
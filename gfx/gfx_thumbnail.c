@@ -309,9 +309,9 @@ void gfx_thumbnail_request(
 
          /* Would like to cancel any existing image load tasks
           * here, but can't see how to do it... */
-         if (task_push_image_load(
+         if (task_push_image_load_cached(
                thumbnail_path, video_driver_supports_rgba(),
-               gfx_thumbnail_upscale_threshold,
+               gfx_thumbnail_upscale_threshold, p_gfx_thumb->cache,
                gfx_thumbnail_handle_upload, thumbnail_tag))
             thumbnail->status = GFX_THUMBNAIL_STATUS_PENDING;
       }
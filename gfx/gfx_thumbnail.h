@@ -29,6 +29,7 @@
 #include <boolean.h>
 
 #include "gfx_thumbnail_path.h"
+#include "gfx_thumbnail_cache.h"
 
 RETRO_BEGIN_DECLS
 
@@ -120,6 +121,11 @@ struct gfx_thumbnail_state
     * handled if the tag matches the most recent value
     * at the time when the load completes */
    uint64_t list_id;
+
+   /* Decoded thumbnails kept on disk, so that scrolling
+    * back to an entry does not decode its images again.
+    * NULL when disabled */
+   gfx_thumbnail_cache_t *cache;
 };
 
 typedef struct gfx_thumbnail_state gfx_thumbnail_state_t;
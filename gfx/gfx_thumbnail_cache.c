@@ -0,0 +1,661 @@
+/* Copyright  (C) 2010-2019 The RetroArch team
+ *
+ * ---------------------------------------------------------------------------------------
+ * The following license statement only applies to this file (gfx_thumbnail_cache.c).
+ * ---------------------------------------------------------------------------------------
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <memmap.h>
+#include <retro_miscellaneous.h>
+#include <compat/strl.h>
+#include <file/file_path.h>
+#include <lists/dir_list.h>
+#include <lists/string_list.h>
+#include <streams/file_stream.h>
+#include <string/stdstring.h>
+#ifdef HAVE_THREADS
+#include <rthreads/rthreads.h>
+#endif
+
+#ifdef HAVE_CONFIG_H
+#include "../config.h"
+#endif
+
+#ifdef HAVE_MMAN
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "gfx_thumbnail_cache.h"
+
+/* On-disk layout, in host byte order:
+ *
+ *   <key>.thumb : gfx_thumbnail_cache_header, then width * height
+ *                 32-bit pixels exactly as the image load task
+ *                 produced them
+ *   index       : gfx_thumbnail_cache_header (count in 'width'),
+ *                 then one key per entry, least recently used
+ *                 first
+ *
+ * The index only carries recency; the set of entries is whatever
+ * blobs are in the directory. Blobs missing from the index (the
+ * cache was not closed cleanly) are treated as least recently
+ * used. */
+
+#define GFX_THUMBNAIL_CACHE_MAGIC       "RATHMB1"
+#define GFX_THUMBNAIL_CACHE_BYTE_ORDER  0x01020304
+#define GFX_THUMBNAIL_CACHE_VERSION     1
+#define GFX_THUMBNAIL_CACHE_EXT         "thumb"
+#define GFX_THUMBNAIL_CACHE_INDEX       "index"
+
+typedef struct gfx_thumbnail_cache_header
+{
+   char magic[8];
+   uint32_t byte_order;
+   uint32_t version;
+   uint64_t key;
+   uint32_t width;
+   uint32_t height;
+} gfx_thumbnail_cache_header_t;
+
+typedef struct gfx_thumbnail_cache_entry
+{
+   uint64_t key;
+   uint64_t size;
+   uint64_t last_used;
+} gfx_thumbnail_cache_entry_t;
+
+struct gfx_thumbnail_cache
+{
+   gfx_thumbnail_cache_entry_t *entries;
+#ifdef HAVE_THREADS
+   slock_t *lock;
+#endif
+   size_t count;
+   size_t capacity;
+   uint64_t total_size;
+   uint64_t max_size;
+   uint64_t clock;
+   char dir[PATH_MAX_LENGTH];
+};
+
+static void gfx_thumbnail_cache_lock(gfx_thumbnail_cache_t *cache)
+{
+#ifdef HAVE_THREADS
+   slock_lock(cache->lock);
+#endif
+}
+
+static void gfx_thumbnail_cache_unlock(gfx_thumbnail_cache_t *cache)
+{
+#ifdef HAVE_THREADS
+   slock_unlock(cache->lock);
+#endif
+}
+
+/* Returns false if the path does not fit in @len, as a truncated
+ * name could be that of another blob */
+static bool gfx_thumbnail_cache_blob_path(const gfx_thumbnail_cache_t *cache,
+      uint64_t key, char *s, size_t len)
+{
+   char name[32];
+
+   snprintf(name, sizeof(name), "%016llx." GFX_THUMBNAIL_CACHE_EXT,
+         (unsigned long long)key);
+   return fill_pathname_join(s, cache->dir, name, len) < len;
+}
+
+static void gfx_thumbnail_cache_header_init(
+      gfx_thumbnail_cache_header_t *header, uint64_t key,
+      uint32_t width, uint32_t height)
+{
+   memset(header, 0, sizeof(*header));
+   memcpy(header->magic, GFX_THUMBNAIL_CACHE_MAGIC,
+         sizeof(GFX_THUMBNAIL_CACHE_MAGIC));
+   header->byte_order = GFX_THUMBNAIL_CACHE_BYTE_ORDER;
+   header->version    = GFX_THUMBNAIL_CACHE_VERSION;
+   header->key        = key;
+   header->width      = width;
+   header->height     = height;
+}
+
+static bool gfx_thumbnail_cache_header_valid(
+      const gfx_thumbnail_cache_header_t *header, uint64_t key)
+{
+   return memcmp(header->magic, GFX_THUMBNAIL_CACHE_MAGIC,
+            sizeof(GFX_THUMBNAIL_CACHE_MAGIC)) == 0
+      && header->byte_order == GFX_THUMBNAIL_CACHE_BYTE_ORDER
+      && header->version    == GFX_THUMBNAIL_CACHE_VERSION
+      && header->key        == key;
+}
+
+/* Must be called with the lock held */
+static gfx_thumbnail_cache_entry_t *gfx_thumbnail_cache_find(
+      gfx_thumbnail_cache_t *cache, uint64_t key)
+{
+   size_t i;
+
+   for (i = 0; i < cache->count; i++)
+      if (cache->entries[i].key == key)
+         return &cache->entries[i];
+
+   return NULL;
+}
+
+/* Must be called with the lock held */
+static bool gfx_thumbnail_cache_add(gfx_thumbnail_cache_t *cache,
+      uint64_t key, uint64_t size, uint64_t last_used)
+{
+   gfx_thumbnail_cache_entry_t *entry = NULL;
+
+   if (cache->count == cache->capacity)
+   {
+      size_t capacity = cache->capacity ? cache->capacity * 2 : 256;
+      gfx_thumbnail_cache_entry_t *entries =
+         (gfx_thumbnail_cache_entry_t*)realloc(cache->entries,
+               capacity * sizeof(*entries));
+
+      if (!entries)
+         return false;
+
+      cache->entries  = entries;
+      cache->capacity = capacity;
+   }
+
+   entry            = &cache->entries[cache->count++];
+   entry->key       = key;
+   entry->size      = size;
+   entry->last_used = last_used;
+
+   cache->total_size += size;
+   return true;
+}
+
+/* Must be called with the lock held */
+static void gfx_thumbnail_cache_remove(gfx_thumbnail_cache_t *cache,
+      gfx_thumbnail_cache_entry_t *entry)
+{
+   cache->total_size -= entry->size;
+   *entry = cache->entries[--cache->count];
+}
+
+/* Drops least recently used entries (other than 'keep') until the
+ * cache fits under its cap. Their keys are returned in 'evicted'
+ * so that the blobs can be deleted once the lock is released.
+ * Must be called with the lock held. */
+static size_t gfx_thumbnail_cache_evict(gfx_thumbnail_cache_t *cache,
+      uint64_t keep, uint64_t **evicted)
+{
+   size_t count    = 0;
+   size_t capacity = 0;
+
+   *evicted        = NULL;
+
+   while (cache->total_size > cache->max_size)
+   {
+      size_t i;
+      gfx_thumbnail_cache_entry_t *oldest = NULL;
+
+      for (i = 0; i < cache->count; i++)
+         if (     cache->entries[i].key != keep
+               && (!oldest
+                  || cache->entries[i].last_used < oldest->last_used))
+            oldest = &cache->entries[i];
+
+      if (!oldest)
+         break;
+
+      if (count == capacity)
+      {
+         uint64_t *keys;
+         capacity = capacity ? capacity * 2 : 16;
+         keys     = (uint64_t*)realloc(*evicted,
+               capacity * sizeof(*keys));
+         if (!keys)
+            break;
+         *evicted = keys;
+      }
+
+      (*evicted)[count++] = oldest->key;
+      gfx_thumbnail_cache_remove(cache, oldest);
+   }
+
+   return count;
+}
+
+static void gfx_thumbnail_cache_delete(const gfx_thumbnail_cache_t *cache,
+      const uint64_t *keys, size_t count)
+{
+   size_t i;
+
+   for (i = 0; i < count; i++)
+   {
+      char path[PATH_MAX_LENGTH];
+      if (gfx_thumbnail_cache_blob_path(cache, keys[i], path, sizeof(path)))
+         filestream_delete(path);
+   }
+}
+
+/* Applies the recency order of the index file to the entries
+ * found in the directory */
+static void gfx_thumbnail_cache_read_index(gfx_thumbnail_cache_t *cache)
+{
+   char path[PATH_MAX_LENGTH];
+   const gfx_thumbnail_cache_header_t *header = NULL;
+   const uint64_t *keys                       = NULL;
+   void *buf                                  = NULL;
+   int64_t len                                = 0;
+   size_t i;
+
+   fill_pathname_join(path, cache->dir, GFX_THUMBNAIL_CACHE_INDEX,
+         sizeof(path));
+
+   if (!path_is_valid(path))
+      return;
+
+   if (     !filestream_read_file(path, &buf, &len)
+         || len < (int64_t)sizeof(*header))
+      goto end;
+
+   header = (const gfx_thumbnail_cache_header_t*)buf;
+   keys   = (const uint64_t*)(header + 1);
+
+   if (     !gfx_thumbnail_cache_header_valid(header, 0)
+         || (uint64_t)len != sizeof(*header)
+            + (uint64_t)header->width * sizeof(uint64_t))
+      goto end;
+
+   for (i = 0; i < header->width; i++)
+   {
+      gfx_thumbnail_cache_entry_t *entry =
+         gfx_thumbnail_cache_find(cache, keys[i]);
+
+      if (entry)
+         entry->last_used = ++cache->clock;
+   }
+
+end:
+   if (buf)
+      free(buf);
+}
+
+static void gfx_thumbnail_cache_write_index(gfx_thumbnail_cache_t *cache)
+{
+   char path[PATH_MAX_LENGTH];
+   gfx_thumbnail_cache_header_t *header = NULL;
+   uint64_t *keys                       = NULL;
+   size_t size                          = sizeof(*header)
+      + cache->count * sizeof(uint64_t);
+   uint8_t *data                        = (uint8_t*)malloc(size);
+   size_t i;
+
+   if (!data)
+      return;
+
+   header = (gfx_thumbnail_cache_header_t*)data;
+   keys   = (uint64_t*)(header + 1);
+
+   gfx_thumbnail_cache_header_init(header, 0, (uint32_t)cache->count, 0);
+
+   /* Oldest first. Entries are few enough that a selection of
+    * the next oldest on each step is fine at shutdown. */
+   for (i = 0; i < cache->count; i++)
+   {
+      size_t j;
+      size_t oldest = i;
+
+      for (j = i + 1; j < cache->count; j++)
+         if (cache->entries[j].last_used < cache->entries[oldest].last_used)
+            oldest = j;
+
+      if (oldest != i)
+      {
+         gfx_thumbnail_cache_entry_t tmp = cache->entries[i];
+         cache->entries[i]               = cache->entries[oldest];
+         cache->entries[oldest]          = tmp;
+      }
+
+      keys[i] = cache->entries[i].key;
+   }
+
+   fill_pathname_join(path, cache->dir, GFX_THUMBNAIL_CACHE_INDEX,
+         sizeof(path));
+   filestream_write_file(path, data, (int64_t)size);
+
+   free(data);
+}
+
+gfx_thumbnail_cache_t *gfx_thumbnail_cache_new(const char *dir,
+      uint64_t max_size)
+{
+   size_t i;
+   struct string_list *list     = NULL;
+   uint64_t *evicted            = NULL;
+   size_t evicted_count         = 0;
+   gfx_thumbnail_cache_t *cache = NULL;
+
+   if (string_is_empty(dir))
+      return NULL;
+
+   if (!path_is_directory(dir) && !path_mkdir(dir))
+      return NULL;
+
+   cache = (gfx_thumbnail_cache_t*)calloc(1, sizeof(*cache));
+   if (!cache)
+      return NULL;
+
+#ifdef HAVE_THREADS
+   if (!(cache->lock = slock_new()))
+   {
+      free(cache);
+      return NULL;
+   }
+#endif
+
+   strlcpy(cache->dir, dir, sizeof(cache->dir));
+   cache->max_size = max_size;
+
+   /* Pick up the blobs left by earlier runs */
+   list = dir_list_new(dir, GFX_THUMBNAIL_CACHE_EXT,
+         false, false, false, false);
+
+   if (list)
+   {
+      for (i = 0; i < list->size; i++)
+      {
+         const char *path = list->elems[i].data;
+         const char *name = path_basename(path);
+         char *end        = NULL;
+         uint64_t key     = strtoull(name, &end, 16);
+         int32_t size     = path_get_size(path);
+
+         if (     key == 0
+               || end != name + 16
+               || size < (int32_t)sizeof(gfx_thumbnail_cache_header_t)
+               || gfx_thumbnail_cache_find(cache, key))
+            continue;
+
+         gfx_thumbnail_cache_add(cache, key, (uint64_t)size, 0);
+      }
+
+      string_list_free(list);
+   }
+
+   gfx_thumbnail_cache_read_index(cache);
+
+   evicted_count = gfx_thumbnail_cache_evict(cache, 0, &evicted);
+   gfx_thumbnail_cache_delete(cache, evicted, evicted_count);
+   free(evicted);
+
+   return cache;
+}
+
+void gfx_thumbnail_cache_free(gfx_thumbnail_cache_t *cache)
+{
+   if (!cache)
+      return;
+
+   gfx_thumbnail_cache_write_index(cache);
+
+#ifdef HAVE_THREADS
+   slock_free(cache->lock);
+#endif
+   free(cache->entries);
+   free(cache);
+}
+
+uint64_t gfx_thumbnail_cache_key(const char *path,
+      unsigned upscale_threshold, bool supports_rgba)
+{
+   /* 64-bit FNV-1a over the path and the fields below */
+   uint64_t fields[4];
+   uint64_t hash       = 0xcbf29ce484222325ULL;
+   const uint8_t *data = (const uint8_t*)path;
+   int64_t mtime;
+   int32_t size;
+   size_t i;
+
+   if (string_is_empty(path))
+      return 0;
+
+   mtime = path_get_mtime(path);
+   size  = path_get_size(path);
+
+   /* Some platforms report no mtime, in which case a changed
+    * image could not be told apart from the cached one */
+   if (mtime <= 0 || size < 0)
+      return 0;
+
+   fields[0] = (uint64_t)mtime;
+   fields[1] = (uint64_t)size;
+   fields[2] = upscale_threshold;
+   fields[3] = supports_rgba ? 1 : 0;
+
+   for (; *data; data++)
+      hash = (hash ^ *data) * 0x100000001b3ULL;
+
+   data = (const uint8_t*)fields;
+   for (i = 0; i < sizeof(fields); i++)
+      hash = (hash ^ data[i]) * 0x100000001b3ULL;
+
+   /* 0 means 'not cacheable' */
+   return hash ? hash : 1;
+}
+
+bool gfx_thumbnail_cache_contains(gfx_thumbnail_cache_t *cache,
+      uint64_t key)
+{
+   gfx_thumbnail_cache_entry_t *entry = NULL;
+
+   if (!cache || !key)
+      return false;
+
+   gfx_thumbnail_cache_lock(cache);
+   if ((entry = gfx_thumbnail_cache_find(cache, key)))
+      entry->last_used = ++cache->clock;
+   gfx_thumbnail_cache_unlock(cache);
+
+   return entry != NULL;
+}
+
+bool gfx_thumbnail_cache_load(gfx_thumbnail_cache_t *cache,
+      uint64_t key, struct texture_image *img)
+{
+   char path[PATH_MAX_LENGTH];
+   const gfx_thumbnail_cache_header_t *header = NULL;
+   uint8_t *data                              = NULL;
+   size_t len                                 = 0;
+   size_t pixels_size                         = 0;
+   bool ret                                   = false;
+#ifdef HAVE_MMAN
+   int fd;
+   off_t end;
+#else
+   void *buf                                  = NULL;
+   int64_t buf_len                            = 0;
+#endif
+
+   if (!cache || !key || !img)
+      return false;
+
+   if (!gfx_thumbnail_cache_blob_path(cache, key, path, sizeof(path)))
+      return false;
+
+#ifdef HAVE_MMAN
+   if ((fd = open(path, O_RDONLY)) < 0)
+      goto end;
+
+   end = lseek(fd, 0, SEEK_END);
+   if (end >= (off_t)sizeof(*header))
+   {
+      void *ptr = mmap(NULL, (size_t)end, PROT_READ, MAP_SHARED, fd, 0);
+      if (ptr != MAP_FAILED)
+      {
+         data = (uint8_t*)ptr;
+         len  = (size_t)end;
+      }
+   }
+   close(fd);
+#else
+   if (     filestream_read_file(path, &buf, &buf_len)
+         && buf_len >= (int64_t)sizeof(*header))
+   {
+      data = (uint8_t*)buf;
+      len  = (size_t)buf_len;
+   }
+#endif
+
+   if (!data)
+      goto end;
+
+   header      = (const gfx_thumbnail_cache_header_t*)data;
+   pixels_size = (size_t)header->width * header->height * sizeof(uint32_t);
+
+   if (     !gfx_thumbnail_cache_header_valid(header, key)
+         || header->width  < 1
+         || header->height < 1
+         || len != sizeof(*header) + pixels_size)
+      goto end;
+
+   /* The image is freed with free() once it has been uploaded,
+    * so it can't point into the mapping */
+   if (!(img->pixels = (uint32_t*)malloc(pixels_size)))
+      goto end;
+
+   memcpy(img->pixels, header + 1, pixels_size);
+   img->width         = header->width;
+   img->height        = header->height;
+   img->supports_rgba = false;
+   ret                = true;
+
+end:
+#ifdef HAVE_MMAN
+   if (data)
+      munmap(data, len);
+#else
+   if (buf)
+      free(buf);
+#endif
+
+   if (!ret)
+   {
+      gfx_thumbnail_cache_entry_t *entry = NULL;
+
+      gfx_thumbnail_cache_lock(cache);
+      if ((entry = gfx_thumbnail_cache_find(cache, key)))
+         gfx_thumbnail_cache_remove(cache, entry);
+      gfx_thumbnail_cache_unlock(cache);
+
+      if (entry)
+         filestream_delete(path);
+   }
+
+   return ret;
+}
+
+bool gfx_thumbnail_cache_store(gfx_thumbnail_cache_t *cache,
+      uint64_t key, const struct texture_image *img)
+{
+   char path[PATH_MAX_LENGTH];
+   char tmp_path[PATH_MAX_LENGTH];
+   gfx_thumbnail_cache_header_t header;
+   gfx_thumbnail_cache_entry_t *entry = NULL;
+   RFILE *file                        = NULL;
+   uint64_t *evicted                  = NULL;
+   size_t evicted_count               = 0;
+   size_t pixels_size;
+   uint64_t size;
+   bool written;
+
+   if (     !cache || !key || !img || !img->pixels
+         || img->width < 1 || img->height < 1)
+      return false;
+
+   pixels_size = (size_t)img->width * img->height * sizeof(uint32_t);
+   size        = sizeof(header) + pixels_size;
+
+   /* Don't let one image flush the whole cache */
+   if (size > cache->max_size)
+      return false;
+
+   if (!gfx_thumbnail_cache_blob_path(cache, key, path, sizeof(path)))
+      return false;
+
+   if (snprintf(tmp_path, sizeof(tmp_path), "%s.%lx.tmp",
+         path, (unsigned long)(uintptr_t)img->pixels)
+         >= (int)sizeof(tmp_path))
+      return false;
+
+   /* Written under a temporary name, so that a blob is never
+    * seen half-written. The name is unique to this image, as two
+    * tasks may store the same key at once. */
+   file = filestream_open(tmp_path,
+         RETRO_VFS_FILE_ACCESS_WRITE, RETRO_VFS_FILE_ACCESS_HINT_NONE);
+   if (!file)
+      return false;
+
+   gfx_thumbnail_cache_header_init(&header, key, img->width, img->height);
+
+   written =
+         filestream_write(file, &header, sizeof(header))
+            == (int64_t)sizeof(header)
+      && filestream_write(file, img->pixels, pixels_size)
+            == (int64_t)pixels_size;
+
+   filestream_close(file);
+
+   if (written)
+   {
+      filestream_delete(path);
+      written = filestream_rename(tmp_path, path) == 0;
+   }
+
+   if (!written)
+   {
+      filestream_delete(tmp_path);
+      return false;
+   }
+
+   gfx_thumbnail_cache_lock(cache);
+
+   if ((entry = gfx_thumbnail_cache_find(cache, key)))
+   {
+      cache->total_size -= entry->size;
+      cache->total_size += size;
+      entry->size        = size;
+      entry->last_used   = ++cache->clock;
+   }
+   else
+      written = gfx_thumbnail_cache_add(cache, key, size, ++cache->clock);
+
+   evicted_count = gfx_thumbnail_cache_evict(cache, key, &evicted);
+
+   gfx_thumbnail_cache_unlock(cache);
+
+   gfx_thumbnail_cache_delete(cache, evicted, evicted_count);
+   free(evicted);
+
+   if (!written)
+      filestream_delete(path);
+
+   return written;
+}
@@ -0,0 +1,128 @@
+/* Copyright  (C) 2010-2019 The RetroArch team
+ *
+ * ---------------------------------------------------------------------------------------
+ * The following license statement only applies to this file (gfx_thumbnail_cache.h).
+ * ---------------------------------------------------------------------------------------
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __GFX_THUMBNAIL_CACHE_H
+#define __GFX_THUMBNAIL_CACHE_H
+
+#include <stdint.h>
+
+#include <retro_common_api.h>
+#include <boolean.h>
+
+#include <formats/image.h>
+
+RETRO_BEGIN_DECLS
+
+/* Disk cache of decoded thumbnails
+ *
+ * Each entry is the final texture_image of an image load task
+ * (decoded, colour converted and upscaled), stored as a raw
+ * blob named after a hash of the source image path, its size
+ * and mtime, and the load parameters. A hit can therefore be
+ * mapped and handed to the video driver without decoding the
+ * source image again.
+ *
+ * Entries are evicted least recently used first once the
+ * cache grows beyond its size cap. Recency survives restarts
+ * via an index file written by gfx_thumbnail_cache_free().
+ *
+ * Lookups and stores may be made from different threads. */
+typedef struct gfx_thumbnail_cache gfx_thumbnail_cache_t;
+
+/**
+ * gfx_thumbnail_cache_new:
+ * @dir                : Directory holding the cache. Created if
+ *                       it does not exist.
+ * @max_size           : Size cap in bytes.
+ *
+ * Opens the cache, picking up entries left by earlier runs and
+ * evicting any that no longer fit under @max_size.
+ *
+ * Returns: the cache, or NULL on failure.
+ **/
+gfx_thumbnail_cache_t *gfx_thumbnail_cache_new(const char *dir,
+      uint64_t max_size);
+
+/**
+ * gfx_thumbnail_cache_free:
+ * @cache              : Cache to close.
+ *
+ * Writes the LRU index and frees @cache. No load or store may
+ * be in progress.
+ **/
+void gfx_thumbnail_cache_free(gfx_thumbnail_cache_t *cache);
+
+/**
+ * gfx_thumbnail_cache_key:
+ * @path               : Path of the source image.
+ * @upscale_threshold  : Upscale threshold of the image load.
+ * @supports_rgba      : Pixel format of the image load.
+ *
+ * Returns: key of the decoded image, or 0 if @path cannot be
+ * stat'ed (in which case the image must not be cached).
+ **/
+uint64_t gfx_thumbnail_cache_key(const char *path,
+      unsigned upscale_threshold, bool supports_rgba);
+
+/**
+ * gfx_thumbnail_cache_contains:
+ * @cache              : Cache to search.
+ * @key                : Key returned by gfx_thumbnail_cache_key().
+ *
+ * Checks for an entry without touching the disk, and marks it
+ * as most recently used.
+ *
+ * Returns: true if @cache holds an entry for @key.
+ **/
+bool gfx_thumbnail_cache_contains(gfx_thumbnail_cache_t *cache,
+      uint64_t key);
+
+/**
+ * gfx_thumbnail_cache_load:
+ * @cache              : Cache to read from.
+ * @key                : Key returned by gfx_thumbnail_cache_key().
+ * @img                : Receives the image. Its pixels are
+ *                       malloc()ed and owned by the caller.
+ *
+ * Returns: true on success. Fails if the entry was evicted or
+ * its blob is damaged, in which case it is dropped.
+ **/
+bool gfx_thumbnail_cache_load(gfx_thumbnail_cache_t *cache,
+      uint64_t key, struct texture_image *img);
+
+/**
+ * gfx_thumbnail_cache_store:
+ * @cache              : Cache to write to.
+ * @key                : Key returned by gfx_thumbnail_cache_key().
+ * @img                : Image to store.
+ *
+ * Adds (or replaces) the entry for @key, then evicts the least
+ * recently used entries until the cache fits under its cap.
+ *
+ * Returns: true if the entry was written.
+ **/
+bool gfx_thumbnail_cache_store(gfx_thumbnail_cache_t *cache,
+      uint64_t key, const struct texture_image *img);
+
+RETRO_END_DECLS
+
+#endif
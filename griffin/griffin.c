@@ -803,6 +803,7 @@ INPUT (HID)
 FIFO BUFFER
 ============================================================ */
 #include "../libretro-common/queues/fifo_queue.c"
+#include "../libretro-common/queues/spsc_queue.c"
 
 /*============================================================
 AUDIO RESAMPLER
@@ -944,6 +945,7 @@ DRIVERS
 #include "../gfx/gfx_display.c"
 #include "../gfx/gfx_thumbnail_path.c"
 #include "../gfx/gfx_thumbnail.c"
+#include "../gfx/gfx_thumbnail_cache.c"
 #include "../gfx/video_coord_array.c"
 #ifdef HAVE_AUDIOMIXER
 #include "../libretro-common/audio/audio_mixer.c"
@@ -1068,9 +1070,14 @@ CONFIGURATION
 /*============================================================
 STATE MANAGER
 ============================================================ */
+#include "../managers/savestate_pool.c"
+
 #ifdef HAVE_REWIND
 #include "../managers/state_manager.c"
 #endif
+#if defined(HAVE_REWIND) || defined(HAVE_NETWORKING)
+#include "../managers/state_manager_diff.c"
+#endif
 
 /*============================================================
 FRONTEND
@@ -1200,6 +1207,7 @@ WIFI
 RECORDING
 ============================================================ */
 #ifdef HAVE_FFMPEG
+#include "../record/record_frame_pool.c"
 #include "../record/drivers/record_ffmpeg.c"
 #endif
 
@@ -1233,6 +1241,7 @@ THREAD
 #endif
 
 #include "../libretro-common/rthreads/rthreads.c"
+#include "../libretro-common/rthreads/tpool.c"
 #include "../gfx/video_thread_wrapper.c"
 #include "../audio/audio_thread_wrapper.c"
 #endif
@@ -1246,12 +1255,17 @@ NETPLAY
 #ifdef HAVE_NETWORKING
 #include "../network/netplay/netplay_delta.c"
 #include "../network/netplay/netplay_handshake.c"
+#include "../network/netplay/netplay_protocol.c"
 #include "../network/netplay/netplay_init.c"
 #include "../network/netplay/netplay_io.c"
 #include "../network/netplay/netplay_keyboard.c"
 #include "../network/netplay/netplay_sync.c"
 #include "../network/netplay/netplay_discovery.c"
 #include "../network/netplay/netplay_buf.c"
+#include "../network/netplay/netplay_savestate.c"
+#include "../network/netplay/netplay_hash.c"
+#include "../network/netplay/netplay_poll.c"
+#include "../network/netplay/netplay_relay.c"
 #include "../network/netplay/netplay_room_parse.c"
 #include "../libretro-common/net/net_compat.c"
 #include "../libretro-common/net/net_socket.c"
@@ -1509,6 +1523,7 @@ XML
 #include "../libretro-db/rmsgpack.c"
 #include "../libretro-db/rmsgpack_dom.c"
 #include "../libretro-db/query.c"
+#include "../libretro-db/rdb_index.c"
 #include "../database_info.c"
 #endif
 
@@ -1110,6 +1110,14 @@ MSG_HASH(
    "always_reload_core_on_run_content"
    )
 #endif
+MSG_HASH(
+   MENU_ENUM_LABEL_CHD_CACHE_HUNKS,
+   "chd_cache_hunks"
+   )
+MSG_HASH(
+   MENU_ENUM_LABEL_CHD_READAHEAD_HUNKS,
+   "chd_readahead_hunks"
+   )
 MSG_HASH(
    MENU_ENUM_LABEL_DYNAMIC_WALLPAPER,
    "menu_dynamic_wallpaper_enable"
@@ -2424,6 +2432,18 @@ MSG_HASH(
    MENU_ENUM_LABEL_REWIND_BUFFER_SIZE_STEP,
    "rewind_buffer_size_step"
    )
+MSG_HASH(
+   MENU_ENUM_LABEL_REWIND_THREADS,
+   "rewind_threads"
+   )
+MSG_HASH(
+   MENU_ENUM_LABEL_REWIND_BUFFER_TO_DISK,
+   "rewind_buffer_to_disk"
+   )
+MSG_HASH(
+   MENU_ENUM_LABEL_REWIND_ARCHIVE_SIZE,
+   "rewind_archive_size"
+   )
 MSG_HASH(
    MENU_ENUM_LABEL_REWIND_SETTINGS,
    "rewind_settings"
@@ -2728,6 +2748,10 @@ MSG_HASH(
    MENU_ENUM_LABEL_MENU_THUMBNAIL_UPSCALE_THRESHOLD,
    "menu_thumbnail_upscale_threshold"
    )
+MSG_HASH(
+   MENU_ENUM_LABEL_MENU_THUMBNAIL_CACHE_SIZE,
+   "menu_thumbnail_cache_size"
+   )
 MSG_HASH(
    MENU_ENUM_LABEL_MENU_RGUI_THUMBNAIL_DOWNSCALER,
    "rgui_thumbnail_downscaler"
@@ -4252,6 +4276,10 @@ MSG_HASH(
    MENU_ENUM_LABEL_PLAYLIST_COMPRESSION,
    "playlist_compression"
    )
+MSG_HASH(
+   MENU_ENUM_LABEL_PLAYLIST_BINARY_CACHE,
+   "playlist_binary_cache"
+   )
 MSG_HASH(
    MENU_ENUM_LABEL_MENU_SOUND_OK,
    "menu_sound_ok"
@@ -4368,6 +4396,10 @@ MSG_HASH(
    MENU_ENUM_LABEL_SCAN_WITHOUT_CORE_MATCH,
    "scan_without_core_match"
    )
+MSG_HASH(
+   MENU_ENUM_LABEL_SCAN_HASH_THREADS,
+   "scan_hash_threads"
+   )
 MSG_HASH(
    MENU_ENUM_LABEL_MENU_XMB_ANIMATION_HORIZONTAL_HIGHLIGHT,
    "xmb_menu_animation_horizontal_highlight"
@@ -2726,6 +2726,22 @@ MSG_HASH(
    "Restart RetroArch when launching content, even when the requested core is already loaded. This may improve system stability, at the expense of increased loading times."
    )
 #endif
+MSG_HASH(
+   MENU_ENUM_LABEL_VALUE_CHD_CACHE_HUNKS,
+   "CHD Cache Size (Hunks)"
+   )
+MSG_HASH(
+   MENU_ENUM_SUBLABEL_CHD_CACHE_HUNKS,
+   "Number of decompressed hunks kept in memory for each open CHD image. A larger cache avoids decompressing the same data again when a core seeks back and forth. Applies to images opened afterwards."
+   )
+MSG_HASH(
+   MENU_ENUM_LABEL_VALUE_CHD_READAHEAD_HUNKS,
+   "CHD Read-Ahead (Hunks)"
+   )
+MSG_HASH(
+   MENU_ENUM_SUBLABEL_CHD_READAHEAD_HUNKS,
+   "Number of hunks decompressed in the background ahead of a core reading a CHD image in order. Limited to half the cache size. Applies to images opened afterwards."
+   )
 MSG_HASH(
    MENU_ENUM_LABEL_VALUE_VIDEO_ALLOW_ROTATE,
    "Allow Rotation"
@@ -3060,6 +3076,30 @@ MSG_HASH(
    MENU_ENUM_SUBLABEL_REWIND_BUFFER_SIZE_STEP,
    "Each time you increase or decrease the rewind buffer size value via this UI it will change by this amount"
    )
+MSG_HASH(
+   MENU_ENUM_LABEL_VALUE_REWIND_THREADS,
+   "Rewind Threads"
+   )
+MSG_HASH(
+   MENU_ENUM_SUBLABEL_REWIND_THREADS,
+   "Number of threads computing rewind data in the background while the next frames run. When off, it is computed on the main thread. Takes effect when rewind is next enabled."
+   )
+MSG_HASH(
+   MENU_ENUM_LABEL_VALUE_REWIND_BUFFER_TO_DISK,
+   "Keep Rewind Buffer on Disk"
+   )
+MSG_HASH(
+   MENU_ENUM_SUBLABEL_REWIND_BUFFER_TO_DISK,
+   "Map the rewind buffer from a file in the cache directory instead of keeping it in memory. Allows for large buffers on systems with little memory."
+   )
+MSG_HASH(
+   MENU_ENUM_LABEL_VALUE_REWIND_ARCHIVE_SIZE,
+   "Rewind Archive Size (MB)"
+   )
+MSG_HASH(
+   MENU_ENUM_SUBLABEL_REWIND_ARCHIVE_SIZE,
+   "Compress rewind history that no longer fits in the rewind buffer into an archive of this size, extending how far back you can rewind."
+   )
 
 /* Settings > Frame Throttle > Frame Time Counter */
 
@@ -4367,6 +4407,14 @@ MSG_HASH(
    MENU_ENUM_SUBLABEL_MENU_THUMBNAIL_UPSCALE_THRESHOLD,
    "Automatically upscale thumbnail images with a width/height smaller than the specified value. Improves picture quality. Has a moderate performance impact."
    )
+MSG_HASH(
+   MENU_ENUM_LABEL_VALUE_MENU_THUMBNAIL_CACHE_SIZE,
+   "Thumbnail Cache Size (MB)"
+   )
+MSG_HASH(
+   MENU_ENUM_SUBLABEL_MENU_THUMBNAIL_CACHE_SIZE,
+   "Keep decoded and upscaled thumbnails in the cache directory, up to this size, so they show faster next time. Takes effect after a restart."
+   )
 MSG_HASH(
    MENU_ENUM_LABEL_VALUE_MENU_TICKER_TYPE,
    "Ticker Text Animation"
@@ -4839,6 +4887,14 @@ MSG_HASH(
    MENU_ENUM_SUBLABEL_PLAYLIST_COMPRESSION,
    "Archive playlist data when writing to disk. Reduces file size and loading times at the expense of (negligibly) increased CPU usage. May be used with either old or new format playlists."
    )
+MSG_HASH(
+   MENU_ENUM_LABEL_VALUE_PLAYLIST_BINARY_CACHE,
+   "Cache Playlists"
+   )
+MSG_HASH(
+   MENU_ENUM_SUBLABEL_PLAYLIST_BINARY_CACHE,
+   "Keep a binary copy of each playlist next to it, which loads without parsing. Speeds up opening large playlists at the expense of disk space. Has no effect on old format playlists."
+   )
 MSG_HASH(
    MENU_ENUM_LABEL_VALUE_PLAYLIST_SHOW_INLINE_CORE_NAME,
    "Show Associated Cores in Playlists"
@@ -4899,6 +4955,14 @@ MSG_HASH(
    MENU_ENUM_SUBLABEL_SCAN_WITHOUT_CORE_MATCH,
    "When disabled, content is only added to playlists if you have a core installed that supports its extension. By enabling this, it will add to playlist regardless. This way, you can install the core you need later on after scanning."
    )
+MSG_HASH(
+   MENU_ENUM_LABEL_VALUE_SCAN_HASH_THREADS,
+   "Scan Hashing Threads"
+   )
+MSG_HASH(
+   MENU_ENUM_SUBLABEL_SCAN_HASH_THREADS,
+   "Number of threads reading and checksumming files while scanning content. 'Auto' uses one per CPU core."
+   )
 MSG_HASH(
    MENU_ENUM_LABEL_VALUE_PLAYLIST_MANAGER_LIST,
    "Manage Playlists"
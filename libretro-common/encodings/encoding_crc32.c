@@ -26,69 +26,447 @@
 #include <streams/file_stream.h>
 #include <stdlib.h>
 
-static const uint32_t crc32_table[256] = {
-  0x00000000L, 0x77073096L, 0xee0e612cL, 0x990951baL, 0x076dc419L,
-  0x706af48fL, 0xe963a535L, 0x9e6495a3L, 0x0edb8832L, 0x79dcb8a4L,
-  0xe0d5e91eL, 0x97d2d988L, 0x09b64c2bL, 0x7eb17cbdL, 0xe7b82d07L,
-  0x90bf1d91L, 0x1db71064L, 0x6ab020f2L, 0xf3b97148L, 0x84be41deL,
-  0x1adad47dL, 0x6ddde4ebL, 0xf4d4b551L, 0x83d385c7L, 0x136c9856L,
-  0x646ba8c0L, 0xfd62f97aL, 0x8a65c9ecL, 0x14015c4fL, 0x63066cd9L,
-  0xfa0f3d63L, 0x8d080df5L, 0x3b6e20c8L, 0x4c69105eL, 0xd56041e4L,
-  0xa2677172L, 0x3c03e4d1L, 0x4b04d447L, 0xd20d85fdL, 0xa50ab56bL,
-  0x35b5a8faL, 0x42b2986cL, 0xdbbbc9d6L, 0xacbcf940L, 0x32d86ce3L,
-  0x45df5c75L, 0xdcd60dcfL, 0xabd13d59L, 0x26d930acL, 0x51de003aL,
-  0xc8d75180L, 0xbfd06116L, 0x21b4f4b5L, 0x56b3c423L, 0xcfba9599L,
-  0xb8bda50fL, 0x2802b89eL, 0x5f058808L, 0xc60cd9b2L, 0xb10be924L,
-  0x2f6f7c87L, 0x58684c11L, 0xc1611dabL, 0xb6662d3dL, 0x76dc4190L,
-  0x01db7106L, 0x98d220bcL, 0xefd5102aL, 0x71b18589L, 0x06b6b51fL,
-  0x9fbfe4a5L, 0xe8b8d433L, 0x7807c9a2L, 0x0f00f934L, 0x9609a88eL,
-  0xe10e9818L, 0x7f6a0dbbL, 0x086d3d2dL, 0x91646c97L, 0xe6635c01L,
-  0x6b6b51f4L, 0x1c6c6162L, 0x856530d8L, 0xf262004eL, 0x6c0695edL,
-  0x1b01a57bL, 0x8208f4c1L, 0xf50fc457L, 0x65b0d9c6L, 0x12b7e950L,
-  0x8bbeb8eaL, 0xfcb9887cL, 0x62dd1ddfL, 0x15da2d49L, 0x8cd37cf3L,
-  0xfbd44c65L, 0x4db26158L, 0x3ab551ceL, 0xa3bc0074L, 0xd4bb30e2L,
-  0x4adfa541L, 0x3dd895d7L, 0xa4d1c46dL, 0xd3d6f4fbL, 0x4369e96aL,
-  0x346ed9fcL, 0xad678846L, 0xda60b8d0L, 0x44042d73L, 0x33031de5L,
-  0xaa0a4c5fL, 0xdd0d7cc9L, 0x5005713cL, 0x270241aaL, 0xbe0b1010L,
-  0xc90c2086L, 0x5768b525L, 0x206f85b3L, 0xb966d409L, 0xce61e49fL,
-  0x5edef90eL, 0x29d9c998L, 0xb0d09822L, 0xc7d7a8b4L, 0x59b33d17L,
-  0x2eb40d81L, 0xb7bd5c3bL, 0xc0ba6cadL, 0xedb88320L, 0x9abfb3b6L,
-  0x03b6e20cL, 0x74b1d29aL, 0xead54739L, 0x9dd277afL, 0x04db2615L,
-  0x73dc1683L, 0xe3630b12L, 0x94643b84L, 0x0d6d6a3eL, 0x7a6a5aa8L,
-  0xe40ecf0bL, 0x9309ff9dL, 0x0a00ae27L, 0x7d079eb1L, 0xf00f9344L,
-  0x8708a3d2L, 0x1e01f268L, 0x6906c2feL, 0xf762575dL, 0x806567cbL,
-  0x196c3671L, 0x6e6b06e7L, 0xfed41b76L, 0x89d32be0L, 0x10da7a5aL,
-  0x67dd4accL, 0xf9b9df6fL, 0x8ebeeff9L, 0x17b7be43L, 0x60b08ed5L,
-  0xd6d6a3e8L, 0xa1d1937eL, 0x38d8c2c4L, 0x4fdff252L, 0xd1bb67f1L,
-  0xa6bc5767L, 0x3fb506ddL, 0x48b2364bL, 0xd80d2bdaL, 0xaf0a1b4cL,
-  0x36034af6L, 0x41047a60L, 0xdf60efc3L, 0xa867df55L, 0x316e8eefL,
-  0x4669be79L, 0xcb61b38cL, 0xbc66831aL, 0x256fd2a0L, 0x5268e236L,
-  0xcc0c7795L, 0xbb0b4703L, 0x220216b9L, 0x5505262fL, 0xc5ba3bbeL,
-  0xb2bd0b28L, 0x2bb45a92L, 0x5cb36a04L, 0xc2d7ffa7L, 0xb5d0cf31L,
-  0x2cd99e8bL, 0x5bdeae1dL, 0x9b64c2b0L, 0xec63f226L, 0x756aa39cL,
-  0x026d930aL, 0x9c0906a9L, 0xeb0e363fL, 0x72076785L, 0x05005713L,
-  0x95bf4a82L, 0xe2b87a14L, 0x7bb12baeL, 0x0cb61b38L, 0x92d28e9bL,
-  0xe5d5be0dL, 0x7cdcefb7L, 0x0bdbdf21L, 0x86d3d2d4L, 0xf1d4e242L,
-  0x68ddb3f8L, 0x1fda836eL, 0x81be16cdL, 0xf6b9265bL, 0x6fb077e1L,
-  0x18b74777L, 0x88085ae6L, 0xff0f6a70L, 0x66063bcaL, 0x11010b5cL,
-  0x8f659effL, 0xf862ae69L, 0x616bffd3L, 0x166ccf45L, 0xa00ae278L,
-  0xd70dd2eeL, 0x4e048354L, 0x3903b3c2L, 0xa7672661L, 0xd06016f7L,
-  0x4969474dL, 0x3e6e77dbL, 0xaed16a4aL, 0xd9d65adcL, 0x40df0b66L,
-  0x37d83bf0L, 0xa9bcae53L, 0xdebb9ec5L, 0x47b2cf7fL, 0x30b5ffe9L,
-  0xbdbdf21cL, 0xcabac28aL, 0x53b39330L, 0x24b4a3a6L, 0xbad03605L,
-  0xcdd70693L, 0x54de5729L, 0x23d967bfL, 0xb3667a2eL, 0xc4614ab8L,
-  0x5d681b02L, 0x2a6f2b94L, 0xb40bbe37L, 0xc30c8ea1L, 0x5a05df1bL,
-  0x2d02ef8dL
-};
+#include "encoding_crc32_tables.h"
 
-uint32_t encoding_crc32(uint32_t crc, const uint8_t *buf, size_t len)
+#if (defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)) \
+   && (defined(__clang__) || (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))) \
+   || (defined(_MSC_VER) && _MSC_VER >= 1500))
+#define CRC32_HAVE_PCLMUL
+#include <emmintrin.h>
+#include <wmmintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+#define CRC32_TARGET_PCLMUL __attribute__((target("pclmul,sse2")))
+#else
+#define CRC32_TARGET_PCLMUL
+#endif
+#endif
+
+/* The ARMv8 kernel is built for the CRC32 extension whatever the
+ * build targets, and only run on CPUs the probe below finds it on.
+ * Older arm_acle.h only defines the intrinsics when the whole build
+ * targets the extension, so the builtins are used instead. */
+#if defined(__aarch64__) && (defined(__ARM_FEATURE_CRC32) \
+   || defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 6))
+#define CRC32_HAVE_ARMV8
+#if defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define CRC32_TARGET_ARMV8
+#define CRC32_ARMV8_B(crc, v) __crc32b(crc, v)
+#define CRC32_ARMV8_D(crc, v) __crc32d(crc, v)
+#elif defined(__clang__)
+#define CRC32_TARGET_ARMV8 __attribute__((target("crc")))
+#define CRC32_ARMV8_B(crc, v) __builtin_arm_crc32b(crc, v)
+#define CRC32_ARMV8_D(crc, v) __builtin_arm_crc32d(crc, v)
+#else
+#define CRC32_TARGET_ARMV8 __attribute__((target("+crc")))
+#define CRC32_ARMV8_B(crc, v) __builtin_aarch64_crc32b(crc, v)
+#define CRC32_ARMV8_D(crc, v) __builtin_aarch64_crc32x(crc, v)
+#endif
+#endif
+
+#if defined(CRC32_HAVE_PCLMUL)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+#if defined(CRC32_HAVE_ARMV8)
+#if defined(__linux__)
+#include <sys/auxv.h>
+#ifndef HWCAP_CRC32
+#define HWCAP_CRC32 (1 << 7)
+#endif
+#elif defined(__APPLE__)
+#include <sys/types.h>
+#include <sys/sysctl.h>
+#endif
+#endif
+
+/* All update functions work on the pre-inverted CRC state. */
+typedef uint32_t (*crc32_update_t)(uint32_t crc,
+      const uint8_t *buf, size_t len);
+
+#define CRC32_LOAD32_LE(p) \
+   (  (uint32_t)(p)[0]        | ((uint32_t)(p)[1] << 8) \
+   | ((uint32_t)(p)[2] << 16) | ((uint32_t)(p)[3] << 24))
+
+static uint32_t crc32_update_bytewise(uint32_t crc,
+      const uint8_t *buf, size_t len)
+{
+   while (len--)
+      crc = crc32_tables[0][(crc ^ (*buf++)) & 0xff] ^ (crc >> 8);
+
+   return crc;
+}
+
+static uint32_t crc32_update_slice8(uint32_t crc,
+      const uint8_t *buf, size_t len)
+{
+   while (len >= 8)
+   {
+      uint32_t a = crc ^ CRC32_LOAD32_LE(buf);
+      uint32_t b = CRC32_LOAD32_LE(buf + 4);
+
+      crc = crc32_tables[7][ a        & 0xff]
+          ^ crc32_tables[6][(a >>  8) & 0xff]
+          ^ crc32_tables[5][(a >> 16) & 0xff]
+          ^ crc32_tables[4][ a >> 24        ]
+          ^ crc32_tables[3][ b        & 0xff]
+          ^ crc32_tables[2][(b >>  8) & 0xff]
+          ^ crc32_tables[1][(b >> 16) & 0xff]
+          ^ crc32_tables[0][ b >> 24        ];
+
+      buf += 8;
+      len -= 8;
+   }
+
+   return crc32_update_bytewise(crc, buf, len);
+}
+
+static uint32_t crc32_update_slice16(uint32_t crc,
+      const uint8_t *buf, size_t len)
+{
+   while (len >= 16)
+   {
+      uint32_t a = crc ^ CRC32_LOAD32_LE(buf);
+      uint32_t b = CRC32_LOAD32_LE(buf + 4);
+      uint32_t c = CRC32_LOAD32_LE(buf + 8);
+      uint32_t d = CRC32_LOAD32_LE(buf + 12);
+
+      crc = crc32_tables[15][ a        & 0xff]
+          ^ crc32_tables[14][(a >>  8) & 0xff]
+          ^ crc32_tables[13][(a >> 16) & 0xff]
+          ^ crc32_tables[12][ a >> 24        ]
+          ^ crc32_tables[11][ b        & 0xff]
+          ^ crc32_tables[10][(b >>  8) & 0xff]
+          ^ crc32_tables[ 9][(b >> 16) & 0xff]
+          ^ crc32_tables[ 8][ b >> 24        ]
+          ^ crc32_tables[ 7][ c        & 0xff]
+          ^ crc32_tables[ 6][(c >>  8) & 0xff]
+          ^ crc32_tables[ 5][(c >> 16) & 0xff]
+          ^ crc32_tables[ 4][ c >> 24        ]
+          ^ crc32_tables[ 3][ d        & 0xff]
+          ^ crc32_tables[ 2][(d >>  8) & 0xff]
+          ^ crc32_tables[ 1][(d >> 16) & 0xff]
+          ^ crc32_tables[ 0][ d >> 24        ];
+
+      buf += 16;
+      len -= 16;
+   }
+
+   return crc32_update_bytewise(crc, buf, len);
+}
+
+#ifdef CRC32_HAVE_PCLMUL
+/* Folding constants for the reflected polynomial, see Intel's
+ * "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ
+ * Instruction". k1/k2 fold 512 bits, k3/k4 fold 128 bits, k5 folds
+ * 96 bits to 64 and the last pair is (P', u) for the Barrett
+ * reduction. */
+static const uint64_t crc32_pclmul_k1k2[2] = { 0x0154442bd4ULL, 0x01c6e41596ULL };
+static const uint64_t crc32_pclmul_k3k4[2] = { 0x01751997d0ULL, 0x00ccaa009eULL };
+static const uint64_t crc32_pclmul_k5k0[2] = { 0x0163cd6124ULL, 0x0000000000ULL };
+static const uint64_t crc32_pclmul_poly[2] = { 0x01db710641ULL, 0x01f7011641ULL };
+
+/* Requires len >= 64; handles len & ~15 bytes and leaves the
+ * tail to the caller. */
+static CRC32_TARGET_PCLMUL uint32_t crc32_fold_pclmul(uint32_t crc,
+      const uint8_t *buf, size_t len)
 {
-   crc = crc ^ 0xffffffff;
+   __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8, y5, y6, y7, y8;
+
+   x1  = _mm_loadu_si128((const __m128i*)(buf + 0x00));
+   x2  = _mm_loadu_si128((const __m128i*)(buf + 0x10));
+   x3  = _mm_loadu_si128((const __m128i*)(buf + 0x20));
+   x4  = _mm_loadu_si128((const __m128i*)(buf + 0x30));
+
+   x1  = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)crc));
+   x0  = _mm_loadu_si128((const __m128i*)crc32_pclmul_k1k2);
+
+   buf += 64;
+   len -= 64;
+
+   /* Fold four 128-bit lanes in parallel */
+   while (len >= 64)
+   {
+      x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+      x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+      x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+      x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+
+      x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+      x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+      x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+      x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+
+      y5 = _mm_loadu_si128((const __m128i*)(buf + 0x00));
+      y6 = _mm_loadu_si128((const __m128i*)(buf + 0x10));
+      y7 = _mm_loadu_si128((const __m128i*)(buf + 0x20));
+      y8 = _mm_loadu_si128((const __m128i*)(buf + 0x30));
+
+      x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), y5);
+      x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), y6);
+      x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), y7);
+      x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), y8);
+
+      buf += 64;
+      len -= 64;
+   }
+
+   /* Fold the four lanes into one */
+   x0 = _mm_loadu_si128((const __m128i*)crc32_pclmul_k3k4);
+
+   x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+   x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+   x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+   x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+   x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+   x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+
+   x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+   x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+   x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+   /* Remaining 16-byte blocks */
+   while (len >= 16)
+   {
+      x2 = _mm_loadu_si128((const __m128i*)buf);
+
+      x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+      x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+      x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+      buf += 16;
+      len -= 16;
+   }
+
+   /* 128 -> 64 bits */
+   x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+   x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+   x1 = _mm_srli_si128(x1, 8);
+   x1 = _mm_xor_si128(x1, x2);
+
+   x0 = _mm_loadl_epi64((const __m128i*)crc32_pclmul_k5k0);
+
+   x2 = _mm_srli_si128(x1, 4);
+   x1 = _mm_and_si128(x1, x3);
+   x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+   x1 = _mm_xor_si128(x1, x2);
+
+   /* Barrett reduction to 32 bits */
+   x0 = _mm_loadu_si128((const __m128i*)crc32_pclmul_poly);
+
+   x2 = _mm_and_si128(x1, x3);
+   x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+   x2 = _mm_and_si128(x2, x3);
+   x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+   x1 = _mm_xor_si128(x1, x2);
+
+   return (uint32_t)_mm_cvtsi128_si32(_mm_srli_si128(x1, 4));
+}
+
+static uint32_t crc32_update_pclmul(uint32_t crc,
+      const uint8_t *buf, size_t len)
+{
+   if (len >= 64)
+   {
+      size_t folded = len & ~(size_t)15;
+      crc           = crc32_fold_pclmul(crc, buf, folded);
+      buf          += folded;
+      len          -= folded;
+   }
+
+   return crc32_update_slice16(crc, buf, len);
+}
+#endif
+
+#ifdef CRC32_HAVE_ARMV8
+static CRC32_TARGET_ARMV8 uint32_t crc32_update_armv8(uint32_t crc,
+      const uint8_t *buf, size_t len)
+{
+   while (len && ((uintptr_t)buf & 7))
+   {
+      crc = CRC32_ARMV8_B(crc, *buf++);
+      len--;
+   }
+
+   while (len >= 32)
+   {
+      const uint64_t *p = (const uint64_t*)buf;
+      crc = CRC32_ARMV8_D(crc, p[0]);
+      crc = CRC32_ARMV8_D(crc, p[1]);
+      crc = CRC32_ARMV8_D(crc, p[2]);
+      crc = CRC32_ARMV8_D(crc, p[3]);
+      buf += 32;
+      len -= 32;
+   }
+
+   while (len >= 8)
+   {
+      crc  = CRC32_ARMV8_D(crc, *(const uint64_t*)buf);
+      buf += 8;
+      len -= 8;
+   }
 
    while (len--)
-      crc = crc32_table[(crc ^ (*buf++)) & 0xff] ^ (crc >> 8);
+      crc = CRC32_ARMV8_B(crc, *buf++);
+
+   return crc;
+}
+#endif
+
+static crc32_update_t crc32_impl_update(enum encoding_crc32_impl impl)
+{
+   switch (impl)
+   {
+      case ENCODING_CRC32_IMPL_SLICE8:
+         return crc32_update_slice8;
+      case ENCODING_CRC32_IMPL_SLICE16:
+         return crc32_update_slice16;
+#ifdef CRC32_HAVE_PCLMUL
+      case ENCODING_CRC32_IMPL_PCLMUL:
+         return crc32_update_pclmul;
+#endif
+#ifdef CRC32_HAVE_ARMV8
+      case ENCODING_CRC32_IMPL_ARMV8:
+         return crc32_update_armv8;
+#endif
+      default:
+         break;
+   }
+
+   return crc32_update_bytewise;
+}
+
+#ifdef CRC32_HAVE_PCLMUL
+/* CPUID leaf 1: SSE2 is EDX bit 26, PCLMULQDQ is ECX bit 1.
+ * Checked here rather than through features_cpu, which would
+ * drag the whole CPU probing module into every CRC user. */
+static bool crc32_cpu_has_pclmul(void)
+{
+   unsigned ecx, edx;
+#if defined(_MSC_VER)
+   int regs[4];
+   __cpuid(regs, 1);
+   ecx = (unsigned)regs[2];
+   edx = (unsigned)regs[3];
+#else
+   unsigned eax, ebx;
+   if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+      return false;
+#endif
+   return (edx & (1u << 26)) && (ecx & (1u << 1));
+}
+#endif
+
+#ifdef CRC32_HAVE_ARMV8
+static bool crc32_cpu_has_armv8_crc(void)
+{
+#if defined(__linux__)
+   return (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0;
+#elif defined(__APPLE__)
+   int val    = 0;
+   size_t len = sizeof(val);
+   return sysctlbyname("hw.optional.armv8_crc32",
+         &val, &len, NULL, 0) == 0 && val;
+#elif defined(__ARM_FEATURE_CRC32)
+   /* The compiler was told to target a CPU with the
+    * CRC32 extension. */
+   return true;
+#else
+   /* No way to ask; stay on the portable code */
+   return false;
+#endif
+}
+#endif
+
+bool encoding_crc32_impl_supported(enum encoding_crc32_impl impl)
+{
+   switch (impl)
+   {
+      case ENCODING_CRC32_IMPL_BYTEWISE:
+      case ENCODING_CRC32_IMPL_SLICE8:
+      case ENCODING_CRC32_IMPL_SLICE16:
+         return true;
+#ifdef CRC32_HAVE_PCLMUL
+      case ENCODING_CRC32_IMPL_PCLMUL:
+         return crc32_cpu_has_pclmul();
+#endif
+#ifdef CRC32_HAVE_ARMV8
+      case ENCODING_CRC32_IMPL_ARMV8:
+         return crc32_cpu_has_armv8_crc();
+#endif
+      default:
+         break;
+   }
+
+   return false;
+}
+
+const char *encoding_crc32_impl_name(enum encoding_crc32_impl impl)
+{
+   switch (impl)
+   {
+      case ENCODING_CRC32_IMPL_BYTEWISE:
+         return "bytewise";
+      case ENCODING_CRC32_IMPL_SLICE8:
+         return "slice-by-8";
+      case ENCODING_CRC32_IMPL_SLICE16:
+         return "slice-by-16";
+      case ENCODING_CRC32_IMPL_PCLMUL:
+         return "pclmul";
+      case ENCODING_CRC32_IMPL_ARMV8:
+         return "armv8";
+      default:
+         break;
+   }
+
+   return "unknown";
+}
+
+/* Resolved on first use. Concurrent first calls may both resolve,
+ * but they store the same pointer. */
+static crc32_update_t crc32_update_best = NULL;
+
+static crc32_update_t crc32_resolve(void)
+{
+   crc32_update_t update = crc32_update_slice16;
+
+#ifdef CRC32_HAVE_PCLMUL
+   if (encoding_crc32_impl_supported(ENCODING_CRC32_IMPL_PCLMUL))
+      update = crc32_update_pclmul;
+#endif
+#ifdef CRC32_HAVE_ARMV8
+   if (encoding_crc32_impl_supported(ENCODING_CRC32_IMPL_ARMV8))
+      update = crc32_update_armv8;
+#endif
+
+   crc32_update_best = update;
+   return update;
+}
+
+uint32_t encoding_crc32(uint32_t crc, const uint8_t *buf, size_t len)
+{
+   crc32_update_t update = crc32_update_best;
+
+   if (!update)
+      update = crc32_resolve();
+
+   return update(crc ^ 0xffffffff, buf, len) ^ 0xffffffff;
+}
+
+uint32_t encoding_crc32_with_impl(enum encoding_crc32_impl impl,
+      uint32_t crc, const uint8_t *buf, size_t len)
+{
+   crc32_update_t update = crc32_update_bytewise;
+
+   if (encoding_crc32_impl_supported(impl))
+      update = crc32_impl_update(impl);
 
-   return crc ^ 0xffffffff;
+   return update(crc ^ 0xffffffff, buf, len) ^ 0xffffffff;
 }
 
 #define CRC32_BUFFER_SIZE 1048576
@@ -50,12 +50,158 @@
 
 #define MAX_INCLUDE_DEPTH 16
 
+#define CONFIG_MAP_MIN_SIZE 32
+
 struct config_include_list
 {
    char *path;
    struct config_include_list *next;
 };
 
+/* Open addressing (linear probing) hash index over the entry list.
+ * Each key maps to the first entry carrying it in list order, which
+ * is the entry a linear search would find. Slots whose entry was
+ * unset (key == NULL) are kept as tombstones until the next rebuild.
+ * When the index cannot be allocated, lookups walk the list. */
+struct config_entry_map_slot
+{
+   uint32_t hash;
+   struct config_entry_list *entry;
+};
+
+static uint32_t config_key_hash(const char *key)
+{
+   /* FNV-1a */
+   uint32_t hash = 0x811c9dc5;
+
+   while (*key)
+   {
+      hash ^= (uint8_t)*key++;
+      hash *= 0x01000193;
+   }
+
+   return hash;
+}
+
+/* Adds 'entry' unless its key is already indexed.
+ * The caller makes sure there is a free slot. */
+static void config_map_insert(struct config_entry_map_slot *map,
+      size_t size, size_t *used, struct config_entry_list *entry)
+{
+   uint32_t hash                          = config_key_hash(entry->key);
+   size_t mask                            = size - 1;
+   size_t i                               = hash & mask;
+   struct config_entry_map_slot *tombstone = NULL;
+
+   for (; map[i].entry; i = (i + 1) & mask)
+   {
+      const char *key = map[i].entry->key;
+
+      if (!key)
+      {
+         if (!tombstone)
+            tombstone = &map[i];
+      }
+      else if (map[i].hash == hash && string_is_equal(key, entry->key))
+         return;
+   }
+
+   if (tombstone)
+   {
+      tombstone->hash  = hash;
+      tombstone->entry = entry;
+      return;
+   }
+
+   map[i].hash  = hash;
+   map[i].entry = entry;
+   (*used)++;
+}
+
+/**
+ * config_file_reindex:
+ * @conf               : Config file.
+ *
+ * Rebuilds the hash index and the tail pointer from the entry
+ * list. Must be called whenever the list is reordered.
+ **/
+static void config_file_reindex(config_file_t *conf)
+{
+   struct config_entry_list *entry = NULL;
+   size_t count                    = 0;
+   size_t size                     = CONFIG_MAP_MIN_SIZE;
+
+   conf->tail = NULL;
+   for (entry = conf->entries; entry; entry = entry->next)
+   {
+      conf->tail = entry;
+      count++;
+   }
+
+   /* Keep the load factor at or below 1/3 after a rebuild */
+   while (size < (count + 1) * 3)
+      size <<= 1;
+
+   free(conf->map);
+   conf->map_used = 0;
+   conf->map_size = 0;
+   conf->map      = (struct config_entry_map_slot*)
+      calloc(size, sizeof(*conf->map));
+
+   if (!conf->map)
+      return;
+
+   conf->map_size = size;
+
+   for (entry = conf->entries; entry; entry = entry->next)
+      if (entry->key)
+         config_map_insert(conf->map, conf->map_size,
+               &conf->map_used, entry);
+}
+
+/* Indexes an entry that was just appended to the list */
+static void config_map_add(config_file_t *conf,
+      struct config_entry_list *entry)
+{
+   if (!entry->key)
+      return;
+
+   /* Grow (and drop tombstones) at half load */
+   if ((conf->map_used + 1) * 2 > conf->map_size)
+   {
+      /* The rebuild walks the list, which already holds 'entry' */
+      config_file_reindex(conf);
+      return;
+   }
+
+   config_map_insert(conf->map, conf->map_size, &conf->map_used, entry);
+}
+
+static struct config_entry_map_slot *config_map_find(
+      const config_file_t *conf, const char *key)
+{
+   uint32_t hash;
+   size_t i, mask;
+
+   if (!conf->map)
+      return NULL;
+
+   hash = config_key_hash(key);
+   mask = conf->map_size - 1;
+
+   for (i = hash & mask; conf->map[i].entry; i = (i + 1) & mask)
+   {
+      const char *entry_key = conf->map[i].entry->key;
+
+      if (     conf->map[i].hash == hash
+            && entry_key
+            && string_is_equal(entry_key, key))
+         return &conf->map[i];
+   }
+
+   return NULL;
+}
+
 static config_file_t *config_file_new_internal(
       const char *path, unsigned depth, config_file_cb_t *cb);
 
@@ -303,20 +449,16 @@ static void add_child_list(config_file_t *parent, config_file_t *child)
       parent->entries   = child->entries;
    }
 
-   child->entries = NULL;
-
-   /* Rebase tail. */
-   if (parent->entries)
+   /* Index the adopted entries behind the parent's own,
+    * and rebase tail. */
+   for (list = child->entries; list; list = list->next)
    {
-      struct config_entry_list *head =
-         (struct config_entry_list*)parent->entries;
-
-      while (head->next)
-         head = head->next;
-      parent->tail = head;
+      config_map_add(parent, list);
+      parent->tail = list;
    }
-   else
-      parent->tail = NULL;
+
+   child->entries = NULL;
+   child->tail    = NULL;
 }
 
 static void add_sub_conf(config_file_t *conf, char *path, config_file_cb_t *cb)
@@ -533,6 +675,7 @@ static config_file_t *config_file_new_internal(
             conf->entries    = list;
 
          conf->tail = list;
+         config_map_add(conf, list);
 
          if (cb && list->key && list->value)
             cb->config_file_new_entry_cb(list->key, list->value) ;
@@ -594,6 +737,7 @@ void config_file_free(config_file_t *conf)
 
    if (conf->path)
       free(conf->path);
+   free(conf->map);
    free(conf);
 }
 
@@ -608,6 +752,9 @@ bool config_append_file(config_file_t *conf, const char *path)
       new_conf->tail->next = conf->entries;
       conf->entries        = new_conf->entries; /* Pilfer. */
       new_conf->entries    = NULL;
+
+      /* The new entries now shadow the old ones */
+      config_file_reindex(conf);
    }
 
    config_file_free(new_conf);
@@ -629,6 +776,9 @@ config_file_t *config_file_new_from_string(char *from_string,
    conf->entries                  = NULL;
    conf->tail                     = NULL;
    conf->last                     = NULL;
+   conf->map                      = NULL;
+   conf->map_size                 = 0;
+   conf->map_used                 = 0;
    conf->includes                 = NULL;
    conf->include_depth            = 0;
    conf->guaranteed_no_duplicates = false;
@@ -670,6 +820,7 @@ config_file_t *config_file_new_from_string(char *from_string,
             conf->entries    = list;
 
          conf->tail          = list;
+         config_map_add(conf, list);
       }
 
       if (list != conf->tail)
@@ -725,6 +876,9 @@ config_file_t *config_file_new_alloc(void)
    conf->entries                  = NULL;
    conf->tail                     = NULL;
    conf->last                     = NULL;
+   conf->map                      = NULL;
+   conf->map_size                 = 0;
+   conf->map_used                 = 0;
    conf->includes                 = NULL;
    conf->include_depth            = 0;
    conf->guaranteed_no_duplicates = false;
@@ -740,6 +894,20 @@ struct config_entry_list *config_get_entry(
    struct config_entry_list *entry    = NULL;
    struct config_entry_list *previous = prev ? *prev : NULL;
 
+   if (conf->map)
+   {
+      struct config_entry_map_slot *slot = config_map_find(conf, key);
+
+      if (slot)
+         return slot->entry;
+
+      /* Not found: report the last entry, as the list walk does */
+      if (prev && conf->tail)
+         *prev = conf->tail;
+
+      return NULL;
+   }
+
    for (entry = conf->entries; entry; entry = entry->next)
    {
       if (string_is_equal(key, entry->key))
@@ -1011,6 +1179,8 @@ void config_set_string(config_file_t *conf, const char *key, const char *val)
       conf->entries = entry;
 
    conf->last       = entry;
+   conf->tail       = entry;
+   config_map_add(conf, entry);
 }
 
 void config_unset(config_file_t *conf, const char *key)
@@ -1027,6 +1197,24 @@ void config_unset(config_file_t *conf, const char *key)
    if (!entry)
       return;
 
+   /* Point the index at the next entry with the same key, if
+    * any; otherwise the slot becomes a tombstone */
+   if (conf->map)
+   {
+      struct config_entry_map_slot *slot = config_map_find(conf, key);
+
+      if (slot)
+      {
+         struct config_entry_list *next = entry->next;
+
+         while (next && !string_is_equal(next->key, key))
+            next = next->next;
+
+         if (next)
+            slot->entry = next;
+      }
+   }
+
    if (entry->key)
       free(entry->key);
 
@@ -1186,6 +1374,7 @@ void config_file_dump_orbis(config_file_t *conf, int fd)
 
    list = merge_sort_linked_list((struct config_entry_list*)conf->entries, config_sort_compare_func);
    conf->entries = list;
+   config_file_reindex(conf);
 
    while (list)
    {
@@ -1212,12 +1401,16 @@ void config_file_dump(config_file_t *conf, FILE *file, bool sort)
    }
 
    if (sort)
-      list = merge_sort_linked_list((struct config_entry_list*)
+   {
+      list          = merge_sort_linked_list((struct config_entry_list*)
             conf->entries, config_sort_compare_func);
-   else
-      list = (struct config_entry_list*)conf->entries;
+      conf->entries = list;
 
-   conf->entries = list;
+      /* Sorting may reorder entries sharing a key */
+      config_file_reindex(conf);
+   }
+   else
+      list          = (struct config_entry_list*)conf->entries;
 
    while (list)
    {
@@ -1231,6 +1424,9 @@ bool config_entry_exists(config_file_t *conf, const char *entry)
 {
    struct config_entry_list *list = conf->entries;
 
+   if (conf->map)
+      return config_map_find(conf, entry) != NULL;
+
    while (list)
    {
       if (string_is_equal(entry, list->key))
@@ -165,6 +165,48 @@ int32_t path_get_size(const char *path)
    return -1;
 }
 
+/**
+ * path_get_mtime:
+ * @path               : path
+ *
+ * Gets the last modification time of a file.
+ *
+ * Returns: modification time in seconds since the epoch,
+ * 0 if the platform cannot report it, or -1 on error.
+ */
+int64_t path_get_mtime(const char *path)
+{
+#if defined(VITA) || defined(PSP) || defined(ORBIS) || (defined(__CELLOS_LV2__) && !defined(__PSL1GHT__))
+   return path_is_valid(path) ? 0 : -1;
+#elif defined(_WIN32) && !defined(LEGACY_WIN32)
+   struct _stat buf;
+   int ret             = -1;
+   wchar_t *path_wide  = NULL;
+
+   if (!path || !*path)
+      return -1;
+
+   path_wide           = utf8_to_utf16_string_alloc(path);
+   if (path_wide)
+   {
+      ret = _wstat(path_wide, &buf);
+      free(path_wide);
+   }
+
+   if (ret < 0)
+      return -1;
+   return (int64_t)buf.st_mtime;
+#else
+   struct stat buf;
+
+   if (!path || !*path)
+      return -1;
+   if (stat(path, &buf) < 0)
+      return -1;
+   return (int64_t)buf.st_mtime;
+#endif
+}
+
 /**
  * path_mkdir:
  * @dir                : directory
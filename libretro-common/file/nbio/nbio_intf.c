@@ -39,16 +39,26 @@ extern nbio_intf_t nbio_stdio;
 
 #if defined(_linux__)
 static nbio_intf_t *internal_nbio = &nbio_linux;
+static const bool internal_nbio_mapped = false;
 #elif defined(HAVE_MMAP) && defined(BSD)
 static nbio_intf_t *internal_nbio = &nbio_mmap_unix;
+static const bool internal_nbio_mapped = true;
 #elif defined(_WIN32) && !defined(_XBOX)
 static nbio_intf_t *internal_nbio = &nbio_mmap_win32;
+static const bool internal_nbio_mapped = true;
 #elif defined(ORBIS)
 static nbio_intf_t *internal_nbio = &nbio_orbis;
+static const bool internal_nbio_mapped = false;
 #else
 static nbio_intf_t *internal_nbio = &nbio_stdio;
+static const bool internal_nbio_mapped = false;
 #endif
 
+bool nbio_is_memory_mapped(void)
+{
+   return internal_nbio_mapped;
+}
+
 void *nbio_open(const char * filename, unsigned mode)
 {
    return internal_nbio->open(filename, mode);
@@ -30,6 +30,8 @@
 #endif
 
 #include <boolean.h>
+#include <retro_inline.h>
+#include <features/features_cpu.h>
 #include <formats/image.h>
 #include <formats/rpng.h>
 #include <streams/trans_stream.h>
@@ -37,6 +39,32 @@
 
 #include "rpng_internal.h"
 
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#if defined(__clang__) || (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)))
+#define RPNG_HAVE_SSE2
+#define RPNG_HAVE_SSSE3
+#define RPNG_TARGET_SSE2 __attribute__((target("sse2")))
+#define RPNG_TARGET_SSSE3 __attribute__((target("ssse3")))
+#elif defined(_MSC_VER) && _MSC_VER >= 1500
+#define RPNG_HAVE_SSE2
+#define RPNG_HAVE_SSSE3
+#define RPNG_TARGET_SSE2
+#define RPNG_TARGET_SSSE3
+#endif
+#endif
+
+#ifdef RPNG_HAVE_SSE2
+#include <emmintrin.h>
+#endif
+#ifdef RPNG_HAVE_SSSE3
+#include <tmmintrin.h>
+#endif
+
+#if (defined(__ARM_NEON) || defined(__ARM_NEON__)) && !defined(DONT_WANT_ARM_OPTIMIZATIONS)
+#define RPNG_HAVE_NEON
+#include <arm_neon.h>
+#endif
+
 enum png_ihdr_color_type
 {
    PNG_IHDR_COLOR_GRAY       = 0,
@@ -112,6 +140,7 @@ struct rpng_process
    unsigned pass_pos;
    uint32_t *data;
    uint32_t *palette;
+   const struct png_kernels *kernels;
    void *stream;
    const struct trans_stream_backend *stream_backend;
 };
@@ -119,6 +148,7 @@ struct rpng_process
 struct rpng
 {
    struct rpng_process *process;
+   const struct png_kernels *kernels; /* NULL for the fastest */
    bool has_ihdr;
    bool has_idat;
    bool has_iend;
@@ -426,6 +456,695 @@ static void png_reverse_filter_copy_line_plt(uint32_t *data,
    }
 }
 
+/* Unfilters a scanline: @line gets the decoded bytes of @in, the
+ * filtered line, given @prev, the decoded line above it. */
+typedef void (*png_unfilter_t)(uint8_t *line, const uint8_t *prev,
+      const uint8_t *in, unsigned pitch, unsigned bpp);
+
+/* Expands a decoded scanline to ARGB8888. */
+typedef void (*png_copy_line_t)(uint32_t *data,
+      const uint8_t *decoded, unsigned width, unsigned depth);
+
+typedef void (*png_copy_line_plt_t)(uint32_t *data,
+      const uint8_t *decoded, unsigned width,
+      unsigned depth, const uint32_t *palette);
+
+struct png_kernels
+{
+   png_unfilter_t sub;
+   png_unfilter_t up;
+   png_unfilter_t avg;
+   png_unfilter_t paeth;
+   png_copy_line_t rgb;
+   png_copy_line_t rgba;
+   png_copy_line_plt_t plt;
+};
+
+static void png_unfilter_sub_scalar(uint8_t *line, const uint8_t *prev,
+      const uint8_t *in, unsigned pitch, unsigned bpp)
+{
+   unsigned i;
+   for (i = 0; i < bpp; i++)
+      line[i] = in[i];
+   for (i = bpp; i < pitch; i++)
+      line[i] = line[i - bpp] + in[i];
+}
+
+static void png_unfilter_up_scalar(uint8_t *line, const uint8_t *prev,
+      const uint8_t *in, unsigned pitch, unsigned bpp)
+{
+   unsigned i;
+   for (i = 0; i < pitch; i++)
+      line[i] = prev[i] + in[i];
+}
+
+static void png_unfilter_avg_scalar(uint8_t *line, const uint8_t *prev,
+      const uint8_t *in, unsigned pitch, unsigned bpp)
+{
+   unsigned i;
+   for (i = 0; i < bpp; i++)
+   {
+      uint8_t avg = prev[i] >> 1;
+      line[i]     = avg + in[i];
+   }
+   for (i = bpp; i < pitch; i++)
+   {
+      uint8_t avg = (line[i - bpp] + prev[i]) >> 1;
+      line[i]     = avg + in[i];
+   }
+}
+
+static void png_unfilter_paeth_scalar(uint8_t *line, const uint8_t *prev,
+      const uint8_t *in, unsigned pitch, unsigned bpp)
+{
+   unsigned i;
+   for (i = 0; i < bpp; i++)
+      line[i] = paeth(0, prev[i], 0) + in[i];
+   for (i = bpp; i < pitch; i++)
+      line[i] = paeth(line[i - bpp], prev[i], prev[i - bpp]) + in[i];
+}
+
+static const struct png_kernels png_kernels_scalar = {
+   png_unfilter_sub_scalar,
+   png_unfilter_up_scalar,
+   png_unfilter_avg_scalar,
+   png_unfilter_paeth_scalar,
+   png_reverse_filter_copy_line_rgb,
+   png_reverse_filter_copy_line_rgba,
+   png_reverse_filter_copy_line_plt
+};
+
+/* The vector unfilters below work a pixel at a time, as each pixel
+ * depends on the one to its left; they take 3 and 4 byte pixels
+ * (8-bit RGB and RGBA) and leave the rest to the scalar code. The
+ * pixel conversions only take 8-bit channels, and 4-bit palettes. */
+
+#ifdef RPNG_HAVE_SSE2
+static INLINE RPNG_TARGET_SSE2 __m128i png_load_pixel_sse2(
+      const uint8_t *p, unsigned bpp)
+{
+   uint32_t v = 0;
+   memcpy(&v, p, bpp);
+   return _mm_cvtsi32_si128((int)v);
+}
+
+static INLINE RPNG_TARGET_SSE2 void png_store_pixel_sse2(
+      uint8_t *p, __m128i x, unsigned bpp)
+{
+   uint32_t v = (uint32_t)_mm_cvtsi128_si32(x);
+   memcpy(p, &v, bpp);
+}
+
+static INLINE RPNG_TARGET_SSE2 void png_unfilter_sub_sse2_bpp(
+      uint8_t *line, const uint8_t *in, unsigned pitch, unsigned bpp)
+{
+   unsigned i;
+   __m128i a = _mm_setzero_si128();
+
+   for (i = 0; i < pitch; i += bpp)
+   {
+      a = _mm_add_epi8(a, png_load_pixel_sse2(in + i, bpp));
+      png_store_pixel_sse2(line + i, a, bpp);
+   }
+}
+
+static INLINE RPNG_TARGET_SSE2 void png_unfilter_avg_sse2_bpp(
+      uint8_t *line, const uint8_t *prev, const uint8_t *in,
+      unsigned pitch, unsigned bpp)
+{
+   unsigned i;
+   __m128i one = _mm_set1_epi8(1);
+   __m128i a   = _mm_setzero_si128();
+
+   for (i = 0; i < pitch; i += bpp)
+   {
+      __m128i b   = png_load_pixel_sse2(prev + i, bpp);
+      /* _mm_avg_epu8 rounds up; take the odd bit back off */
+      __m128i avg = _mm_sub_epi8(_mm_avg_epu8(a, b),
+            _mm_and_si128(_mm_xor_si128(a, b), one));
+      a           = _mm_add_epi8(avg, png_load_pixel_sse2(in + i, bpp));
+      png_store_pixel_sse2(line + i, a, bpp);
+   }
+}
+
+static INLINE RPNG_TARGET_SSE2 __m128i png_abs_epi16_sse2(__m128i x)
+{
+   return _mm_max_epi16(x, _mm_sub_epi16(_mm_setzero_si128(), x));
+}
+
+static INLINE RPNG_TARGET_SSE2 __m128i png_select_sse2(__m128i mask,
+      __m128i x, __m128i y)
+{
+   return _mm_or_si128(_mm_and_si128(mask, x), _mm_andnot_si128(mask, y));
+}
+
+static INLINE RPNG_TARGET_SSE2 void png_unfilter_paeth_sse2_bpp(
+      uint8_t *line, const uint8_t *prev, const uint8_t *in,
+      unsigned pitch, unsigned bpp)
+{
+   unsigned i;
+   /* Left, up and up-left, in 16-bit lanes */
+   __m128i zero = _mm_setzero_si128();
+   __m128i a    = zero;
+   __m128i c    = zero;
+
+   for (i = 0; i < pitch; i += bpp)
+   {
+      __m128i b        = _mm_unpacklo_epi8(
+            png_load_pixel_sse2(prev + i, bpp), zero);
+      __m128i d        = _mm_unpacklo_epi8(
+            png_load_pixel_sse2(in + i, bpp), zero);
+      __m128i pa       = _mm_sub_epi16(b, c);
+      __m128i pb       = _mm_sub_epi16(a, c);
+      __m128i pc       = png_abs_epi16_sse2(_mm_add_epi16(pa, pb));
+      __m128i smallest;
+
+      pa               = png_abs_epi16_sse2(pa);
+      pb               = png_abs_epi16_sse2(pb);
+      smallest         = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+
+      /* a if pa is smallest, else b if pb is, else c; as paeth() */
+      d = _mm_add_epi8(d, png_select_sse2(_mm_cmpeq_epi16(smallest, pa), a,
+               png_select_sse2(_mm_cmpeq_epi16(smallest, pb), b, c)));
+      png_store_pixel_sse2(line + i, _mm_packus_epi16(d, d), bpp);
+
+      a = d;
+      c = b;
+   }
+}
+
+static RPNG_TARGET_SSE2 void png_unfilter_sub_sse2(uint8_t *line,
+      const uint8_t *prev, const uint8_t *in, unsigned pitch, unsigned bpp)
+{
+   if (bpp == 4)
+      png_unfilter_sub_sse2_bpp(line, in, pitch, 4);
+   else if (bpp == 3)
+      png_unfilter_sub_sse2_bpp(line, in, pitch, 3);
+   else
+      png_unfilter_sub_scalar(line, prev, in, pitch, bpp);
+}
+
+static RPNG_TARGET_SSE2 void png_unfilter_up_sse2(uint8_t *line,
+      const uint8_t *prev, const uint8_t *in, unsigned pitch, unsigned bpp)
+{
+   unsigned i = 0;
+
+   for (; i + 16 <= pitch; i += 16)
+      _mm_storeu_si128((__m128i*)(line + i), _mm_add_epi8(
+               _mm_loadu_si128((const __m128i*)(prev + i)),
+               _mm_loadu_si128((const __m128i*)(in + i))));
+   for (; i < pitch; i++)
+      line[i] = prev[i] + in[i];
+}
+
+static RPNG_TARGET_SSE2 void png_unfilter_avg_sse2(uint8_t *line,
+      const uint8_t *prev, const uint8_t *in, unsigned pitch, unsigned bpp)
+{
+   if (bpp == 4)
+      png_unfilter_avg_sse2_bpp(line, prev, in, pitch, 4);
+   else if (bpp == 3)
+      png_unfilter_avg_sse2_bpp(line, prev, in, pitch, 3);
+   else
+      png_unfilter_avg_scalar(line, prev, in, pitch, bpp);
+}
+
+static RPNG_TARGET_SSE2 void png_unfilter_paeth_sse2(uint8_t *line,
+      const uint8_t *prev, const uint8_t *in, unsigned pitch, unsigned bpp)
+{
+   if (bpp == 4)
+      png_unfilter_paeth_sse2_bpp(line, prev, in, pitch, 4);
+   else if (bpp == 3)
+      png_unfilter_paeth_sse2_bpp(line, prev, in, pitch, 3);
+   else
+      png_unfilter_paeth_scalar(line, prev, in, pitch, bpp);
+}
+
+static RPNG_TARGET_SSE2 void png_copy_line_rgba_sse2(uint32_t *data,
+      const uint8_t *decoded, unsigned width, unsigned depth)
+{
+   unsigned i   = 0;
+   __m128i ag   = _mm_set1_epi32((int)0xff00ff00);
+   __m128i rb   = _mm_set1_epi32(0x00ff00ff);
+
+   if (depth != 8)
+   {
+      png_reverse_filter_copy_line_rgba(data, decoded, width, depth);
+      return;
+   }
+
+   /* Swap R and B in each little-endian RGBA dword */
+   for (; i + 4 <= width; i += 4)
+   {
+      __m128i x   = _mm_loadu_si128((const __m128i*)(decoded + i * 4));
+      __m128i r_b = _mm_and_si128(x, rb);
+      r_b         = _mm_or_si128(_mm_slli_epi32(r_b, 16),
+            _mm_srli_epi32(r_b, 16));
+      _mm_storeu_si128((__m128i*)(data + i),
+            _mm_or_si128(_mm_and_si128(x, ag), r_b));
+   }
+
+   png_reverse_filter_copy_line_rgba(data + i, decoded + i * 4,
+         width - i, depth);
+}
+
+static const struct png_kernels png_kernels_sse2 = {
+   png_unfilter_sub_sse2,
+   png_unfilter_up_sse2,
+   png_unfilter_avg_sse2,
+   png_unfilter_paeth_sse2,
+   png_reverse_filter_copy_line_rgb,
+   png_copy_line_rgba_sse2,
+   png_reverse_filter_copy_line_plt
+};
+#endif
+
+#ifdef RPNG_HAVE_SSSE3
+static RPNG_TARGET_SSSE3 void png_copy_line_rgb_ssse3(uint32_t *data,
+      const uint8_t *decoded, unsigned width, unsigned depth)
+{
+   unsigned i      = 0;
+   __m128i shuffle = _mm_setr_epi8(
+         2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1);
+   __m128i alpha   = _mm_set1_epi32((int)0xff000000);
+
+   if (depth != 8)
+   {
+      png_reverse_filter_copy_line_rgb(data, decoded, width, depth);
+      return;
+   }
+
+   /* Four pixels a time, from a 16 byte load that must stay
+    * within the line */
+   for (; i + 6 <= width; i += 4)
+      _mm_storeu_si128((__m128i*)(data + i), _mm_or_si128(alpha,
+               _mm_shuffle_epi8(_mm_loadu_si128(
+                     (const __m128i*)(decoded + i * 3)), shuffle)));
+
+   png_reverse_filter_copy_line_rgb(data + i, decoded + i * 3,
+         width - i, depth);
+}
+
+static RPNG_TARGET_SSSE3 void png_copy_line_rgba_ssse3(uint32_t *data,
+      const uint8_t *decoded, unsigned width, unsigned depth)
+{
+   unsigned i      = 0;
+   __m128i shuffle = _mm_setr_epi8(
+         2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+
+   if (depth != 8)
+   {
+      png_reverse_filter_copy_line_rgba(data, decoded, width, depth);
+      return;
+   }
+
+   for (; i + 4 <= width; i += 4)
+      _mm_storeu_si128((__m128i*)(data + i), _mm_shuffle_epi8(
+               _mm_loadu_si128((const __m128i*)(decoded + i * 4)),
+               shuffle));
+
+   png_reverse_filter_copy_line_rgba(data + i, decoded + i * 4,
+         width - i, depth);
+}
+
+/* 4-bit palettes fit a byte shuffle: one table per byte of the
+ * 16 ARGB entries, looked up by 16 indices at once. */
+static RPNG_TARGET_SSSE3 void png_copy_line_plt_ssse3(uint32_t *data,
+      const uint8_t *decoded, unsigned width,
+      unsigned depth, const uint32_t *palette)
+{
+   unsigned i = 0;
+   unsigned k;
+   uint8_t planes[4][16];
+   __m128i table[4];
+   __m128i nibble = _mm_set1_epi8(0x0f);
+
+   if (depth != 4)
+   {
+      png_reverse_filter_copy_line_plt(data, decoded, width, depth, palette);
+      return;
+   }
+
+   for (k = 0; k < 16; k++)
+   {
+      planes[0][k] = (uint8_t)(palette[k] >>  0);
+      planes[1][k] = (uint8_t)(palette[k] >>  8);
+      planes[2][k] = (uint8_t)(palette[k] >> 16);
+      planes[3][k] = (uint8_t)(palette[k] >> 24);
+   }
+   for (k = 0; k < 4; k++)
+      table[k] = _mm_loadu_si128((const __m128i*)planes[k]);
+
+   for (; i + 16 <= width; i += 16)
+   {
+      __m128i x   = _mm_loadl_epi64((const __m128i*)(decoded + i / 2));
+      /* High nibble first */
+      __m128i idx = _mm_unpacklo_epi8(
+            _mm_and_si128(_mm_srli_epi16(x, 4), nibble),
+            _mm_and_si128(x, nibble));
+      __m128i b0  = _mm_shuffle_epi8(table[0], idx);
+      __m128i b1  = _mm_shuffle_epi8(table[1], idx);
+      __m128i b2  = _mm_shuffle_epi8(table[2], idx);
+      __m128i b3  = _mm_shuffle_epi8(table[3], idx);
+      __m128i lo  = _mm_unpacklo_epi8(b0, b1);
+      __m128i hi  = _mm_unpackhi_epi8(b0, b1);
+      __m128i lo2 = _mm_unpacklo_epi8(b2, b3);
+      __m128i hi2 = _mm_unpackhi_epi8(b2, b3);
+
+      _mm_storeu_si128((__m128i*)(data + i +  0), _mm_unpacklo_epi16(lo, lo2));
+      _mm_storeu_si128((__m128i*)(data + i +  4), _mm_unpackhi_epi16(lo, lo2));
+      _mm_storeu_si128((__m128i*)(data + i +  8), _mm_unpacklo_epi16(hi, hi2));
+      _mm_storeu_si128((__m128i*)(data + i + 12), _mm_unpackhi_epi16(hi, hi2));
+   }
+
+   png_reverse_filter_copy_line_plt(data + i, decoded + i / 2,
+         width - i, depth, palette);
+}
+
+static const struct png_kernels png_kernels_ssse3 = {
+   png_unfilter_sub_sse2,
+   png_unfilter_up_sse2,
+   png_unfilter_avg_sse2,
+   png_unfilter_paeth_sse2,
+   png_copy_line_rgb_ssse3,
+   png_copy_line_rgba_ssse3,
+   png_copy_line_plt_ssse3
+};
+#endif
+
+#ifdef RPNG_HAVE_NEON
+static INLINE uint8x8_t png_load_pixel_neon(const uint8_t *p, unsigned bpp)
+{
+   uint32_t v = 0;
+   memcpy(&v, p, bpp);
+   return vreinterpret_u8_u32(vdup_n_u32(v));
+}
+
+static INLINE void png_store_pixel_neon(uint8_t *p, uint8x8_t x,
+      unsigned bpp)
+{
+   uint32_t v = vget_lane_u32(vreinterpret_u32_u8(x), 0);
+   memcpy(p, &v, bpp);
+}
+
+static INLINE void png_unfilter_sub_neon_bpp(uint8_t *line,
+      const uint8_t *in, unsigned pitch, unsigned bpp)
+{
+   unsigned i;
+   uint8x8_t a = vdup_n_u8(0);
+
+   for (i = 0; i < pitch; i += bpp)
+   {
+      a = vadd_u8(a, png_load_pixel_neon(in + i, bpp));
+      png_store_pixel_neon(line + i, a, bpp);
+   }
+}
+
+static INLINE void png_unfilter_avg_neon_bpp(uint8_t *line,
+      const uint8_t *prev, const uint8_t *in, unsigned pitch, unsigned bpp)
+{
+   unsigned i;
+   uint8x8_t a = vdup_n_u8(0);
+
+   for (i = 0; i < pitch; i += bpp)
+   {
+      a = vadd_u8(vhadd_u8(a, png_load_pixel_neon(prev + i, bpp)),
+            png_load_pixel_neon(in + i, bpp));
+      png_store_pixel_neon(line + i, a, bpp);
+   }
+}
+
+static INLINE void png_unfilter_paeth_neon_bpp(uint8_t *line,
+      const uint8_t *prev, const uint8_t *in, unsigned pitch, unsigned bpp)
+{
+   unsigned i;
+   uint8x8_t a = vdup_n_u8(0);
+   uint8x8_t c = vdup_n_u8(0);
+
+   for (i = 0; i < pitch; i += bpp)
+   {
+      uint8x8_t b       = png_load_pixel_neon(prev + i, bpp);
+      uint16x8_t pa     = vabdl_u8(b, c);
+      uint16x8_t pb     = vabdl_u8(a, c);
+      uint16x8_t pc     = vabdq_u16(vaddl_u8(a, b), vaddl_u8(c, c));
+      /* a if pa is smallest, else b if pb is, else c; as paeth() */
+      uint8x8_t use_a   = vmovn_u16(vandq_u16(vcleq_u16(pa, pb),
+               vcleq_u16(pa, pc)));
+      uint8x8_t use_b   = vmovn_u16(vcleq_u16(pb, pc));
+      uint8x8_t nearest = vbsl_u8(use_a, a, vbsl_u8(use_b, b, c));
+
+      a = vadd_u8(nearest, png_load_pixel_neon(in + i, bpp));
+      png_store_pixel_neon(line + i, a, bpp);
+      c = b;
+   }
+}
+
+static void png_unfilter_sub_neon(uint8_t *line,
+      const uint8_t *prev, const uint8_t *in, unsigned pitch, unsigned bpp)
+{
+   if (bpp == 4)
+      png_unfilter_sub_neon_bpp(line, in, pitch, 4);
+   else if (bpp == 3)
+      png_unfilter_sub_neon_bpp(line, in, pitch, 3);
+   else
+      png_unfilter_sub_scalar(line, prev, in, pitch, bpp);
+}
+
+static void png_unfilter_up_neon(uint8_t *line,
+      const uint8_t *prev, const uint8_t *in, unsigned pitch, unsigned bpp)
+{
+   unsigned i = 0;
+
+   for (; i + 16 <= pitch; i += 16)
+      vst1q_u8(line + i, vaddq_u8(vld1q_u8(prev + i), vld1q_u8(in + i)));
+   for (; i < pitch; i++)
+      line[i] = prev[i] + in[i];
+}
+
+static void png_unfilter_avg_neon(uint8_t *line,
+      const uint8_t *prev, const uint8_t *in, unsigned pitch, unsigned bpp)
+{
+   if (bpp == 4)
+      png_unfilter_avg_neon_bpp(line, prev, in, pitch, 4);
+   else if (bpp == 3)
+      png_unfilter_avg_neon_bpp(line, prev, in, pitch, 3);
+   else
+      png_unfilter_avg_scalar(line, prev, in, pitch, bpp);
+}
+
+static void png_unfilter_paeth_neon(uint8_t *line,
+      const uint8_t *prev, const uint8_t *in, unsigned pitch, unsigned bpp)
+{
+   if (bpp == 4)
+      png_unfilter_paeth_neon_bpp(line, prev, in, pitch, 4);
+   else if (bpp == 3)
+      png_unfilter_paeth_neon_bpp(line, prev, in, pitch, 3);
+   else
+      png_unfilter_paeth_scalar(line, prev, in, pitch, bpp);
+}
+
+static void png_copy_line_rgb_neon(uint32_t *data,
+      const uint8_t *decoded, unsigned width, unsigned depth)
+{
+   unsigned i = 0;
+
+   if (depth != 8)
+   {
+      png_reverse_filter_copy_line_rgb(data, decoded, width, depth);
+      return;
+   }
+
+   for (; i + 8 <= width; i += 8)
+   {
+      uint8x8x3_t rgb = vld3_u8(decoded + i * 3);
+      uint8x8x4_t bgra;
+
+      bgra.val[0] = rgb.val[2];
+      bgra.val[1] = rgb.val[1];
+      bgra.val[2] = rgb.val[0];
+      bgra.val[3] = vdup_n_u8(0xff);
+      vst4_u8((uint8_t*)(data + i), bgra);
+   }
+
+   png_reverse_filter_copy_line_rgb(data + i, decoded + i * 3,
+         width - i, depth);
+}
+
+static void png_copy_line_rgba_neon(uint32_t *data,
+      const uint8_t *decoded, unsigned width, unsigned depth)
+{
+   unsigned i = 0;
+
+   if (depth != 8)
+   {
+      png_reverse_filter_copy_line_rgba(data, decoded, width, depth);
+      return;
+   }
+
+   for (; i + 8 <= width; i += 8)
+   {
+      uint8x8x4_t rgba = vld4_u8(decoded + i * 4);
+      uint8x8_t r      = rgba.val[0];
+
+      rgba.val[0]      = rgba.val[2];
+      rgba.val[2]      = r;
+      vst4_u8((uint8_t*)(data + i), rgba);
+   }
+
+   png_reverse_filter_copy_line_rgba(data + i, decoded + i * 4,
+         width - i, depth);
+}
+
+static void png_copy_line_plt_neon(uint32_t *data,
+      const uint8_t *decoded, unsigned width,
+      unsigned depth, const uint32_t *palette)
+{
+   unsigned i = 0;
+   unsigned k;
+   uint8_t planes[4][16];
+   uint8x8x2_t table[4];
+   uint8x8_t nibble = vdup_n_u8(0x0f);
+
+   if (depth != 4)
+   {
+      png_reverse_filter_copy_line_plt(data, decoded, width, depth, palette);
+      return;
+   }
+
+   for (k = 0; k < 16; k++)
+   {
+      planes[0][k] = (uint8_t)(palette[k] >>  0);
+      planes[1][k] = (uint8_t)(palette[k] >>  8);
+      planes[2][k] = (uint8_t)(palette[k] >> 16);
+      planes[3][k] = (uint8_t)(palette[k] >> 24);
+   }
+   for (k = 0; k < 4; k++)
+   {
+      table[k].val[0] = vld1_u8(planes[k]);
+      table[k].val[1] = vld1_u8(planes[k] + 8);
+   }
+
+   for (; i + 16 <= width; i += 16)
+   {
+      uint8x8_t x     = vld1_u8(decoded + i / 2);
+      /* High nibble first */
+      uint8x8x2_t idx = vzip_u8(vshr_n_u8(x, 4), vand_u8(x, nibble));
+      unsigned half;
+
+      for (half = 0; half < 2; half++)
+      {
+         uint8x8x4_t argb;
+
+         argb.val[0] = vtbl2_u8(table[0], idx.val[half]);
+         argb.val[1] = vtbl2_u8(table[1], idx.val[half]);
+         argb.val[2] = vtbl2_u8(table[2], idx.val[half]);
+         argb.val[3] = vtbl2_u8(table[3], idx.val[half]);
+         vst4_u8((uint8_t*)(data + i + half * 8), argb);
+      }
+   }
+
+   png_reverse_filter_copy_line_plt(data + i, decoded + i / 2,
+         width - i, depth, palette);
+}
+
+static const struct png_kernels png_kernels_neon = {
+   png_unfilter_sub_neon,
+   png_unfilter_up_neon,
+   png_unfilter_avg_neon,
+   png_unfilter_paeth_neon,
+   png_copy_line_rgb_neon,
+   png_copy_line_rgba_neon,
+   png_copy_line_plt_neon
+};
+#endif
+
+static const struct png_kernels *png_impl_kernels(
+      enum rpng_decode_impl impl)
+{
+   switch (impl)
+   {
+#ifdef RPNG_HAVE_SSE2
+      case RPNG_DECODE_IMPL_SSE2:
+         return &png_kernels_sse2;
+#endif
+#ifdef RPNG_HAVE_SSSE3
+      case RPNG_DECODE_IMPL_SSSE3:
+         return &png_kernels_ssse3;
+#endif
+#ifdef RPNG_HAVE_NEON
+      case RPNG_DECODE_IMPL_NEON:
+         return &png_kernels_neon;
+#endif
+      default:
+         break;
+   }
+
+   return &png_kernels_scalar;
+}
+
+bool rpng_decode_impl_supported(enum rpng_decode_impl impl)
+{
+   switch (impl)
+   {
+      case RPNG_DECODE_IMPL_SCALAR:
+         return true;
+#ifdef RPNG_HAVE_SSE2
+      case RPNG_DECODE_IMPL_SSE2:
+         return (cpu_features_get() & RETRO_SIMD_SSE2) != 0;
+#endif
+#ifdef RPNG_HAVE_SSSE3
+      case RPNG_DECODE_IMPL_SSSE3:
+         return (cpu_features_get() & (RETRO_SIMD_SSE2 | RETRO_SIMD_SSSE3))
+            == (RETRO_SIMD_SSE2 | RETRO_SIMD_SSSE3);
+#endif
+#ifdef RPNG_HAVE_NEON
+      case RPNG_DECODE_IMPL_NEON:
+         return (cpu_features_get() & RETRO_SIMD_NEON) != 0;
+#endif
+      default:
+         break;
+   }
+
+   return false;
+}
+
+const char *rpng_decode_impl_name(enum rpng_decode_impl impl)
+{
+   switch (impl)
+   {
+      case RPNG_DECODE_IMPL_SCALAR:
+         return "scalar";
+      case RPNG_DECODE_IMPL_SSE2:
+         return "sse2";
+      case RPNG_DECODE_IMPL_SSSE3:
+         return "ssse3";
+      case RPNG_DECODE_IMPL_NEON:
+         return "neon";
+      default:
+         break;
+   }
+
+   return "unknown";
+}
+
+/* Resolved on first use. Concurrent first calls may both resolve,
+ * but they store the same pointer. */
+static const struct png_kernels *png_kernels_best = NULL;
+
+static const struct png_kernels *png_kernels_resolve(void)
+{
+   unsigned impl;
+   const struct png_kernels *kernels = &png_kernels_scalar;
+
+   /* Later implementations are faster */
+   for (impl = RPNG_DECODE_IMPL_SCALAR + 1;
+         impl < RPNG_DECODE_IMPL_LAST; impl++)
+      if (rpng_decode_impl_supported((enum rpng_decode_impl)impl))
+         kernels = png_impl_kernels((enum rpng_decode_impl)impl);
+
+   png_kernels_best = kernels;
+   return kernels;
+}
+
 static void png_pass_geom(const struct png_ihdr *ihdr,
       unsigned width, unsigned height,
       unsigned *bpp_out, unsigned *pitch_out, size_t *pass_size)
@@ -583,7 +1302,9 @@ error:
 static int png_reverse_filter_copy_line(uint32_t *data, const struct png_ihdr *ihdr,
       struct rpng_process *pngp, unsigned filter)
 {
-   unsigned i;
+
+   const struct png_kernels *kernels = pngp->kernels;
+   uint8_t *swap;
 
    switch (filter)
    {
@@ -591,33 +1312,20 @@ static int png_reverse_filter_copy_line(uint32_t *data, const struct png_ihdr *i
          memcpy(pngp->decoded_scanline, pngp->inflate_buf, pngp->pitch);
          break;
       case PNG_FILTER_SUB:
-         for (i = 0; i < pngp->bpp; i++)
-            pngp->decoded_scanline[i] = pngp->inflate_buf[i];
-         for (i = pngp->bpp; i < pngp->pitch; i++)
-            pngp->decoded_scanline[i] = pngp->decoded_scanline[i - pngp->bpp] + pngp->inflate_buf[i];
+         kernels->sub(pngp->decoded_scanline, pngp->prev_scanline,
+               pngp->inflate_buf, pngp->pitch, pngp->bpp);
          break;
       case PNG_FILTER_UP:
-         for (i = 0; i < pngp->pitch; i++)
-            pngp->decoded_scanline[i] = pngp->prev_scanline[i] + pngp->inflate_buf[i];
+         kernels->up(pngp->decoded_scanline, pngp->prev_scanline,
+               pngp->inflate_buf, pngp->pitch, pngp->bpp);
          break;
       case PNG_FILTER_AVERAGE:
-         for (i = 0; i < pngp->bpp; i++)
-         {
-            uint8_t avg = pngp->prev_scanline[i] >> 1;
-            pngp->decoded_scanline[i] = avg + pngp->inflate_buf[i];
-         }
-         for (i = pngp->bpp; i < pngp->pitch; i++)
-         {
-            uint8_t avg = (pngp->decoded_scanline[i - pngp->bpp] + pngp->prev_scanline[i]) >> 1;
-            pngp->decoded_scanline[i] = avg + pngp->inflate_buf[i];
-         }
+         kernels->avg(pngp->decoded_scanline, pngp->prev_scanline,
+               pngp->inflate_buf, pngp->pitch, pngp->bpp);
          break;
       case PNG_FILTER_PAETH:
-         for (i = 0; i < pngp->bpp; i++)
-            pngp->decoded_scanline[i] = paeth(0, pngp->prev_scanline[i], 0) + pngp->inflate_buf[i];
-         for (i = pngp->bpp; i < pngp->pitch; i++)
-            pngp->decoded_scanline[i] = paeth(pngp->decoded_scanline[i - pngp->bpp],
-                  pngp->prev_scanline[i], pngp->prev_scanline[i - pngp->bpp]) + pngp->inflate_buf[i];
+         kernels->paeth(pngp->decoded_scanline, pngp->prev_scanline,
+               pngp->inflate_buf, pngp->pitch, pngp->bpp);
          break;
 
       default:
@@ -630,10 +1338,10 @@ static int png_reverse_filter_copy_line(uint32_t *data, const struct png_ihdr *i
          png_reverse_filter_copy_line_bw(data, pngp->decoded_scanline, ihdr->width, ihdr->depth);
          break;
       case PNG_IHDR_COLOR_RGB:
-         png_reverse_filter_copy_line_rgb(data, pngp->decoded_scanline, ihdr->width, ihdr->depth);
+         kernels->rgb(data, pngp->decoded_scanline, ihdr->width, ihdr->depth);
          break;
       case PNG_IHDR_COLOR_PLT:
-         png_reverse_filter_copy_line_plt(data, pngp->decoded_scanline, ihdr->width,
+         kernels->plt(data, pngp->decoded_scanline, ihdr->width,
                ihdr->depth, pngp->palette);
          break;
       case PNG_IHDR_COLOR_GRAY_ALPHA:
@@ -641,11 +1349,14 @@ static int png_reverse_filter_copy_line(uint32_t *data, const struct png_ihdr *i
                ihdr->depth);
          break;
       case PNG_IHDR_COLOR_RGBA:
-         png_reverse_filter_copy_line_rgba(data, pngp->decoded_scanline, ihdr->width, ihdr->depth);
+         kernels->rgba(data, pngp->decoded_scanline, ihdr->width, ihdr->depth);
          break;
    }
 
-   memcpy(pngp->prev_scanline, pngp->decoded_scanline, pngp->pitch);
+   /* This line is the next one's previous */
+   swap                   = pngp->prev_scanline;
+   pngp->prev_scanline    = pngp->decoded_scanline;
+   pngp->decoded_scanline = swap;
 
    return IMAGE_PROCESS_NEXT;
 }
@@ -907,6 +1618,7 @@ static struct rpng_process *rpng_process_init(rpng_t *rpng)
    process->pass_pos               = 0;
    process->data                   = 0;
    process->palette                = 0;
+   process->kernels                = rpng->kernels;
    process->stream                 = NULL;
    process->stream_backend         = trans_stream_get_zlib_inflate_backend();
 
@@ -917,6 +1629,10 @@ static struct rpng_process *rpng_process_init(rpng_t *rpng)
 
    process->stream = process->stream_backend->stream_new();
 
+   if (!process->kernels)
+      process->kernels = png_kernels_best
+         ? png_kernels_best : png_kernels_resolve();
+
    if (!process->stream)
    {
       free(process);
@@ -1257,3 +1973,13 @@ rpng_t *rpng_alloc(void)
       return NULL;
    return rpng;
 }
+
+void rpng_set_decode_impl(rpng_t *rpng, enum rpng_decode_impl impl)
+{
+   if (!rpng)
+      return;
+
+   rpng->kernels = &png_kernels_scalar;
+   if (rpng_decode_impl_supported(impl))
+      rpng->kernels = png_impl_kernels(impl);
+}
@@ -22,12 +22,24 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <string.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON__) && !defined(DONT_WANT_ARM_OPTIMIZATIONS)
+#include <arm_neon.h>
+#endif
+
 #include <libretro.h>
+#include <retro_inline.h>
 #include <encodings/crc32.h>
 #include <streams/interface_stream.h>
 #include <streams/trans_stream.h>
+#ifdef HAVE_THREADS
+#include <features/features_cpu.h>
+#include <rthreads/tpool.h>
+#endif
 
 #include "rpng_internal.h"
 
@@ -38,6 +50,11 @@
    goto end; \
 } while (0)
 
+/* Fewest rows worth giving a strip of their own */
+#define RPNG_ENCODE_STRIP_ROWS 32
+
+#define RPNG_ADLER_BASE 65521
+
 double DEFLATE_PADDING = 1.1;
 int PNG_ROUGH_HEADER = 100;
 
@@ -140,24 +157,77 @@ static void copy_bgr24_line(uint8_t *dst, const uint8_t *src, unsigned width)
    }
 }
 
+#if defined(__SSE2__)
+/* Paeth predictors of eight bytes, widened to 16-bit lanes */
+static INLINE __m128i paeth_sse2(__m128i a, __m128i b, __m128i c)
+{
+   __m128i zero  = _mm_setzero_si128();
+   __m128i pa_s  = _mm_sub_epi16(b, c);
+   __m128i pb_s  = _mm_sub_epi16(a, c);
+   __m128i pc_s  = _mm_add_epi16(pa_s, pb_s);
+   __m128i pa    = _mm_max_epi16(pa_s, _mm_sub_epi16(zero, pa_s));
+   __m128i pb    = _mm_max_epi16(pb_s, _mm_sub_epi16(zero, pb_s));
+   __m128i pc    = _mm_max_epi16(pc_s, _mm_sub_epi16(zero, pc_s));
+   __m128i not_a = _mm_or_si128(_mm_cmpgt_epi16(pa, pb),
+         _mm_cmpgt_epi16(pa, pc));
+   __m128i use_c = _mm_cmpgt_epi16(pb, pc);
+   __m128i bc    = _mm_or_si128(_mm_and_si128(use_c, c),
+         _mm_andnot_si128(use_c, b));
+
+   return _mm_or_si128(_mm_and_si128(not_a, bc),
+         _mm_andnot_si128(not_a, a));
+}
+#endif
+
 static unsigned count_sad(const uint8_t *data, size_t size)
 {
-   size_t i;
+   size_t i     = 0;
    unsigned cnt = 0;
-   for (i = 0; i < size; i++)
+#if defined(__SSE2__)
+   __m128i zero = _mm_setzero_si128();
+   __m128i sum  = zero;
+
+   for (; i + 16 <= size; i += 16)
    {
-      if (data[i])
-         cnt += abs((int8_t)data[i]);
+      __m128i x = _mm_loadu_si128((const __m128i*)(data + i));
+      /* The magnitude of a signed byte is the smaller of x and -x */
+      x         = _mm_min_epu8(x, _mm_sub_epi8(zero, x));
+      sum       = _mm_add_epi64(sum, _mm_sad_epu8(x, zero));
    }
+   cnt = (unsigned)_mm_cvtsi128_si32(sum)
+       + (unsigned)_mm_cvtsi128_si32(_mm_srli_si128(sum, 8));
+#elif defined(__ARM_NEON__) && !defined(DONT_WANT_ARM_OPTIMIZATIONS)
+   uint32x4_t sum = vdupq_n_u32(0);
+
+   for (; i + 16 <= size; i += 16)
+   {
+      uint8x16_t x = vreinterpretq_u8_s8(
+            vabsq_s8(vld1q_s8((const int8_t*)data + i)));
+      sum          = vpadalq_u16(sum, vpaddlq_u8(x));
+   }
+   cnt = vgetq_lane_u32(sum, 0) + vgetq_lane_u32(sum, 1)
+       + vgetq_lane_u32(sum, 2) + vgetq_lane_u32(sum, 3);
+#endif
+   for (; i < size; i++)
+      cnt += abs((int8_t)data[i]);
    return cnt;
 }
 
 static unsigned filter_up(uint8_t *target, const uint8_t *line,
       const uint8_t *prev, unsigned width, unsigned bpp)
 {
-   unsigned i;
+   unsigned i = 0;
    width *= bpp;
-   for (i = 0; i < width; i++)
+#if defined(__SSE2__)
+   for (; i + 16 <= width; i += 16)
+      _mm_storeu_si128((__m128i*)(target + i), _mm_sub_epi8(
+               _mm_loadu_si128((const __m128i*)(line + i)),
+               _mm_loadu_si128((const __m128i*)(prev + i))));
+#elif defined(__ARM_NEON__) && !defined(DONT_WANT_ARM_OPTIMIZATIONS)
+   for (; i + 16 <= width; i += 16)
+      vst1q_u8(target + i, vsubq_u8(vld1q_u8(line + i), vld1q_u8(prev + i)));
+#endif
+   for (; i < width; i++)
       target[i] = line[i] - prev[i];
 
    return count_sad(target, width);
@@ -170,7 +240,17 @@ static unsigned filter_sub(uint8_t *target, const uint8_t *line,
    width *= bpp;
    for (i = 0; i < bpp; i++)
       target[i] = line[i];
-   for (i = bpp; i < width; i++)
+#if defined(__SSE2__)
+   for (; i + 16 <= width; i += 16)
+      _mm_storeu_si128((__m128i*)(target + i), _mm_sub_epi8(
+               _mm_loadu_si128((const __m128i*)(line + i)),
+               _mm_loadu_si128((const __m128i*)(line + i - bpp))));
+#elif defined(__ARM_NEON__) && !defined(DONT_WANT_ARM_OPTIMIZATIONS)
+   for (; i + 16 <= width; i += 16)
+      vst1q_u8(target + i, vsubq_u8(vld1q_u8(line + i),
+               vld1q_u8(line + i - bpp)));
+#endif
+   for (; i < width; i++)
       target[i] = line[i] - line[i - bpp];
 
    return count_sad(target, width);
@@ -180,10 +260,29 @@ static unsigned filter_avg(uint8_t *target, const uint8_t *line,
       const uint8_t *prev, unsigned width, unsigned bpp)
 {
    unsigned i;
+#if defined(__SSE2__)
+   __m128i one = _mm_set1_epi8(1);
+#endif
    width *= bpp;
    for (i = 0; i < bpp; i++)
       target[i] = line[i] - (prev[i] >> 1);
-   for (i = bpp; i < width; i++)
+#if defined(__SSE2__)
+   for (; i + 16 <= width; i += 16)
+   {
+      __m128i a   = _mm_loadu_si128((const __m128i*)(line + i - bpp));
+      __m128i b   = _mm_loadu_si128((const __m128i*)(prev + i));
+      /* _mm_avg_epu8 rounds up; take the odd bit back off */
+      __m128i avg = _mm_sub_epi8(_mm_avg_epu8(a, b),
+            _mm_and_si128(_mm_xor_si128(a, b), one));
+      _mm_storeu_si128((__m128i*)(target + i), _mm_sub_epi8(
+               _mm_loadu_si128((const __m128i*)(line + i)), avg));
+   }
+#elif defined(__ARM_NEON__) && !defined(DONT_WANT_ARM_OPTIMIZATIONS)
+   for (; i + 16 <= width; i += 16)
+      vst1q_u8(target + i, vsubq_u8(vld1q_u8(line + i),
+               vhaddq_u8(vld1q_u8(line + i - bpp), vld1q_u8(prev + i))));
+#endif
+   for (; i < width; i++)
       target[i] = line[i] - ((line[i - bpp] + prev[i]) >> 1);
 
    return count_sad(target, width);
@@ -194,76 +293,184 @@ static unsigned filter_paeth(uint8_t *target,
       unsigned width, unsigned bpp)
 {
    unsigned i;
+#if defined(__SSE2__)
+   __m128i zero = _mm_setzero_si128();
+#endif
    width *= bpp;
    for (i = 0; i < bpp; i++)
       target[i] = line[i] - paeth(0, prev[i], 0);
-   for (i = bpp; i < width; i++)
+#if defined(__SSE2__)
+   for (; i + 16 <= width; i += 16)
+   {
+      __m128i a  = _mm_loadu_si128((const __m128i*)(line + i - bpp));
+      __m128i b  = _mm_loadu_si128((const __m128i*)(prev + i));
+      __m128i c  = _mm_loadu_si128((const __m128i*)(prev + i - bpp));
+      __m128i lo = paeth_sse2(_mm_unpacklo_epi8(a, zero),
+            _mm_unpacklo_epi8(b, zero), _mm_unpacklo_epi8(c, zero));
+      __m128i hi = paeth_sse2(_mm_unpackhi_epi8(a, zero),
+            _mm_unpackhi_epi8(b, zero), _mm_unpackhi_epi8(c, zero));
+      _mm_storeu_si128((__m128i*)(target + i), _mm_sub_epi8(
+               _mm_loadu_si128((const __m128i*)(line + i)),
+               _mm_packus_epi16(lo, hi)));
+   }
+#elif defined(__ARM_NEON__) && !defined(DONT_WANT_ARM_OPTIMIZATIONS)
+   for (; i + 8 <= width; i += 8)
+   {
+      uint8x8_t a     = vld1_u8(line + i - bpp);
+      uint8x8_t b     = vld1_u8(prev + i);
+      uint8x8_t c     = vld1_u8(prev + i - bpp);
+      int16x8_t pa_s  = vreinterpretq_s16_u16(vsubl_u8(b, c));
+      int16x8_t pb_s  = vreinterpretq_s16_u16(vsubl_u8(a, c));
+      int16x8_t pa    = vabsq_s16(pa_s);
+      int16x8_t pb    = vabsq_s16(pb_s);
+      int16x8_t pc    = vabsq_s16(vaddq_s16(pa_s, pb_s));
+      uint8x8_t not_a = vmovn_u16(vorrq_u16(vcgtq_s16(pa, pb),
+               vcgtq_s16(pa, pc)));
+      uint8x8_t use_c = vmovn_u16(vcgtq_s16(pb, pc));
+      uint8x8_t pred  = vbsl_u8(not_a, vbsl_u8(use_c, c, b), a);
+      vst1_u8(target + i, vsub_u8(vld1_u8(line + i), pred));
+   }
+#endif
+   for (; i < width; i++)
       target[i] = line[i] - paeth(line[i - bpp], prev[i], prev[i - bpp]);
 
    return count_sad(target, width);
 }
 
-bool rpng_save_image_stream(const uint8_t *data, intfstream_t* intf_s,
-      unsigned width, unsigned height, signed pitch, unsigned bpp)
+/* The zlib stream's checksum, so strips can sum their own rows */
+static uint32_t rpng_adler32(uint32_t adler, const uint8_t *data, size_t size)
 {
-   unsigned h;
-   struct png_ihdr ihdr = {0};
-   bool ret = true;
-   const struct trans_stream_backend *stream_backend = NULL;
-   size_t encode_buf_size  = 0;
-   uint8_t *encode_buf     = NULL;
-   uint8_t *deflate_buf    = NULL;
-   uint8_t *rgba_line      = NULL;
-   uint8_t *up_filtered    = NULL;
-   uint8_t *sub_filtered   = NULL;
-   uint8_t *avg_filtered   = NULL;
-   uint8_t *paeth_filtered = NULL;
-   uint8_t *prev_encoded   = NULL;
-   uint8_t *encode_target  = NULL;
-   void *stream            = NULL;
-   uint32_t total_in       = 0;
-   uint32_t total_out      = 0;
-   
-   if (!intf_s)
-      GOTO_END_ERROR();
-
-   stream_backend = trans_stream_get_zlib_deflate_backend();
+   uint32_t a = adler & 0xffff;
+   uint32_t b = adler >> 16;
 
-   if (intfstream_write(intf_s, png_magic, sizeof(png_magic)) != sizeof(png_magic))
-      GOTO_END_ERROR();
+   while (size)
+   {
+      /* The most bytes b can take before it overflows */
+      size_t len = size < 5552 ? size : 5552;
 
-   ihdr.width = width;
-   ihdr.height = height;
-   ihdr.depth = 8;
-   ihdr.color_type = bpp == sizeof(uint32_t) ? 6 : 2; /* RGBA or RGB */
-   if (!png_write_ihdr_string(intf_s, &ihdr))
-      GOTO_END_ERROR();
+      size -= len;
+      while (len--)
+      {
+         a += *data++;
+         b += a;
+      }
+      a %= RPNG_ADLER_BASE;
+      b %= RPNG_ADLER_BASE;
+   }
 
-   encode_buf_size = (width * bpp + 1) * height;
-   encode_buf      = (uint8_t*)malloc(encode_buf_size);
-   if (!encode_buf)
-      GOTO_END_ERROR();
+   return (b << 16) | a;
+}
 
-   prev_encoded = (uint8_t*)calloc(1, width * bpp);
-   if (!prev_encoded)
-      GOTO_END_ERROR();
+/* The checksum of two runs of bytes from the checksum of each,
+ * as zlib's adler32_combine */
+static uint32_t rpng_adler32_combine(uint32_t adler1, uint32_t adler2,
+      size_t size2)
+{
+   uint32_t rem  = (uint32_t)(size2 % RPNG_ADLER_BASE);
+   uint32_t sum1 = adler1 & 0xffff;
+   uint32_t sum2 = (rem * sum1) % RPNG_ADLER_BASE;
+
+   sum1 += (adler2 & 0xffff) + RPNG_ADLER_BASE - 1;
+   sum2 += (adler1 >> 16) + (adler2 >> 16) + RPNG_ADLER_BASE - rem;
+   if (sum1 >= RPNG_ADLER_BASE)
+      sum1 -= RPNG_ADLER_BASE;
+   if (sum1 >= RPNG_ADLER_BASE)
+      sum1 -= RPNG_ADLER_BASE;
+   if (sum2 >= RPNG_ADLER_BASE << 1)
+      sum2 -= RPNG_ADLER_BASE << 1;
+   if (sum2 >= RPNG_ADLER_BASE)
+      sum2 -= RPNG_ADLER_BASE;
+
+   return sum1 | (sum2 << 16);
+}
 
-   rgba_line      = (uint8_t*)malloc(width * bpp);
-   up_filtered    = (uint8_t*)malloc(width * bpp);
-   sub_filtered   = (uint8_t*)malloc(width * bpp);
-   avg_filtered   = (uint8_t*)malloc(width * bpp);
-   paeth_filtered = (uint8_t*)malloc(width * bpp);
-   if (!rgba_line || !up_filtered || !sub_filtered || !avg_filtered || !paeth_filtered)
-      GOTO_END_ERROR();
+struct rpng_encode_job
+{
+   const uint8_t *data;
+   uint8_t *encode_buf;   /* Filtered rows, each after its filter byte */
+   uint8_t *deflate_buf;  /* An IDAT chunk's worth of room per strip */
+   size_t deflate_size;
+   signed pitch;
+   unsigned width;
+   unsigned height;
+   unsigned bpp;
+   unsigned strips;
+   unsigned strip_rows;
+   int level;
+   bool all_filters;
+};
+
+struct rpng_encode_strip
+{
+   const struct rpng_encode_job *job;
+   size_t size;           /* Filtered bytes */
+   uint32_t adler;
+   uint32_t deflated;     /* Chunk data written after the chunk header */
+   unsigned index;
+   bool ok;
+};
+
+static void rpng_encode_copy_line(const struct rpng_encode_job *job,
+      uint8_t *dst, const uint8_t *src)
+{
+   if (job->bpp == sizeof(uint32_t))
+      copy_argb_line(dst, (const uint32_t*)src, job->width);
+   else
+      copy_bgr24_line(dst, src, job->width);
+}
 
-   encode_target = encode_buf;
-   for (h = 0; h < height;
-         h++, encode_target += width * bpp, data += pitch)
+/* Filters and deflates one strip of rows. Strips may run on any
+ * thread; each writes only its own part of the job's buffers. */
+static void rpng_encode_strip(void *arg)
+{
+   uint32_t total_in  = 0;
+   uint32_t total_out = 0;
+   unsigned h;
+   struct rpng_encode_strip *strip   = (struct rpng_encode_strip*)arg;
+   const struct rpng_encode_job *job = strip->job;
+   const struct trans_stream_backend *stream_backend =
+      trans_stream_get_zlib_deflate_backend();
+   size_t line_size       = job->width * job->bpp;
+   unsigned first         = strip->index * job->strip_rows;
+   unsigned rows          = job->height - first;
+   bool last              = strip->index + 1 == job->strips;
+   const uint8_t *data    = job->data + (ptrdiff_t)first * job->pitch;
+   uint8_t *filtered      = job->encode_buf + (line_size + 1) * first;
+   uint8_t *encode_target = filtered;
+   uint8_t *out           = job->deflate_buf
+      + job->deflate_size * strip->index + 8;
+   size_t out_size        = job->deflate_size - 8 - 4;
+   uint8_t *scratch       = NULL;
+   uint8_t *rgba_line, *prev_line, *up_filtered, *sub_filtered,
+           *avg_filtered, *paeth_filtered;
+   void *stream           = NULL;
+
+   if (rows > job->strip_rows)
+      rows = job->strip_rows;
+   strip->size = (line_size + 1) * rows;
+
+   scratch = (uint8_t*)malloc(line_size * 6);
+   if (!scratch)
+      return;
+
+   rgba_line      = scratch;
+   prev_line      = scratch + line_size;
+   up_filtered    = scratch + line_size * 2;
+   sub_filtered   = scratch + line_size * 3;
+   avg_filtered   = scratch + line_size * 4;
+   paeth_filtered = scratch + line_size * 5;
+
+   /* Filters look at the row above, which the strip before us owns */
+   if (first)
+      rpng_encode_copy_line(job, prev_line, data - job->pitch);
+   else
+      memset(prev_line, 0, line_size);
+
+   for (h = 0; h < rows; h++, data += job->pitch)
    {
-      if (bpp == sizeof(uint32_t))
-         copy_argb_line(rgba_line, (const uint32_t*)data, width);
-      else
-         copy_bgr24_line(rgba_line, data, width);
+      uint8_t *swap;
+
+      rpng_encode_copy_line(job, rgba_line, data);
 
       /* Try every filtering method, and choose the method
        * which has most entries as zero.
@@ -272,11 +479,9 @@ bool rpng_save_image_stream(const uint8_t *data, intfstream_t* intf_s,
        * simple to implement.
        */
       {
-         unsigned none_score  = count_sad(rgba_line, width * bpp);
-         unsigned up_score    = filter_up(up_filtered, rgba_line, prev_encoded, width, bpp);
-         unsigned sub_score   = filter_sub(sub_filtered, rgba_line, width, bpp);
-         unsigned avg_score   = filter_avg(avg_filtered, rgba_line, prev_encoded, width, bpp);
-         unsigned paeth_score = filter_paeth(paeth_filtered, rgba_line, prev_encoded, width, bpp);
+         unsigned none_score  = count_sad(rgba_line, line_size);
+         unsigned up_score    = filter_up(up_filtered, rgba_line, prev_line, job->width, job->bpp);
+         unsigned sub_score   = filter_sub(sub_filtered, rgba_line, job->width, job->bpp);
 
          uint8_t filter       = 0;
          unsigned min_sad     = none_score;
@@ -296,109 +501,272 @@ bool rpng_save_image_stream(const uint8_t *data, intfstream_t* intf_s,
             min_sad = up_score;
          }
 
-         if (avg_score < min_sad)
+         if (job->all_filters)
          {
-            filter = 3;
-            chosen_filtered = avg_filtered;
-            min_sad = avg_score;
-         }
-
-         if (paeth_score < min_sad)
-         {
-            filter = 4;
-            chosen_filtered = paeth_filtered;
+            unsigned avg_score   = filter_avg(avg_filtered, rgba_line, prev_line, job->width, job->bpp);
+            unsigned paeth_score = filter_paeth(paeth_filtered, rgba_line, prev_line, job->width, job->bpp);
+
+            if (avg_score < min_sad)
+            {
+               filter = 3;
+               chosen_filtered = avg_filtered;
+               min_sad = avg_score;
+            }
+
+            if (paeth_score < min_sad)
+            {
+               filter = 4;
+               chosen_filtered = paeth_filtered;
+            }
          }
 
          *encode_target++ = filter;
-         memcpy(encode_target, chosen_filtered, width * bpp);
-
-         memcpy(prev_encoded, rgba_line, width * bpp);
+         memcpy(encode_target, chosen_filtered, line_size);
+         encode_target += line_size;
       }
+
+      swap      = prev_line;
+      prev_line = rgba_line;
+      rgba_line = swap;
    }
 
-   deflate_buf = (uint8_t*)malloc(encode_buf_size * 2); /* Just to be sure. */
-   if (!deflate_buf)
-      GOTO_END_ERROR();
+   free(scratch);
 
    stream = stream_backend->stream_new();
-
    if (!stream)
+      return;
+
+   stream_backend->define(stream, "level", (uint32_t)job->level);
+
+   /* A lone strip is an ordinary zlib stream. Otherwise each strip is
+    * raw deflate, ending on a byte boundary with a sync flush; the
+    * first carries the zlib header and the last the checksum of the
+    * lot, which we piece together from the strips' own. */
+   if (job->strips > 1)
+   {
+      if (strip->index == 0)
+      {
+         int flevel = job->level <= 1 ? 0 : job->level <= 5 ? 1
+            : job->level == 6 ? 2 : 3;
+
+         out[0]     = 0x78; /* Deflate, 32K window */
+         out[1]     = (uint8_t)(flevel << 6);
+         out[1]    |= 31 - ((out[0] << 8 | out[1]) % 31);
+         out       += 2;
+         out_size  -= 2;
+         strip->deflated += 2;
+      }
+
+      stream_backend->define(stream, "window_bits", (uint32_t)-15);
+      stream_backend->define(stream, "sync_flush", !last);
+      strip->adler = rpng_adler32(1, filtered, strip->size);
+   }
+
+   stream_backend->set_in(stream, filtered, (uint32_t)strip->size);
+   stream_backend->set_out(stream, out, (uint32_t)out_size);
+
+   strip->ok = stream_backend->trans(stream, true,
+         &total_in, &total_out, NULL)
+      && total_in  == strip->size
+      && total_out <  out_size;
+   strip->deflated += total_out;
+
+   stream_backend->stream_free(stream);
+}
+
+static bool rpng_encode_image_stream(const uint8_t *data,
+      intfstream_t* intf_s, unsigned width, unsigned height,
+      signed pitch, unsigned bpp,
+      const struct rpng_encode_options *options)
+{
+   unsigned i;
+   struct png_ihdr ihdr = {0};
+   struct rpng_encode_job job;
+   bool ret                     = true;
+   enum rpng_encode_preset preset = options
+      ? options->preset : RPNG_ENCODE_SMALL;
+   unsigned threads             = options ? options->threads : 1;
+   struct rpng_encode_strip *strip_list = NULL;
+   uint32_t adler               = 1;
+   size_t strip_size            = 0;
+
+   memset(&job, 0, sizeof(job));
+
+   if (!intf_s)
       GOTO_END_ERROR();
 
-   stream_backend->set_in(
-         stream,
-         encode_buf,
-         (unsigned)encode_buf_size);
-   stream_backend->set_out(
-         stream,
-         deflate_buf + 8,
-         (unsigned)(encode_buf_size * 2));
+   if (intfstream_write(intf_s, png_magic, sizeof(png_magic)) != sizeof(png_magic))
+      GOTO_END_ERROR();
 
-   if (!stream_backend->trans(stream, true, &total_in, &total_out, NULL))
+   ihdr.width = width;
+   ihdr.height = height;
+   ihdr.depth = 8;
+   ihdr.color_type = bpp == sizeof(uint32_t) ? 6 : 2; /* RGBA or RGB */
+   if (!png_write_ihdr_string(intf_s, &ihdr))
       GOTO_END_ERROR();
 
-   memcpy(deflate_buf + 4, "IDAT", 4);
-   dword_write_be(deflate_buf + 0,        ((uint32_t)total_out));
-   if (!png_write_idat_string(intf_s, deflate_buf, ((size_t)total_out + 8)))
+#ifdef HAVE_THREADS
+   if (threads == 0)
+      threads = cpu_features_get_core_amount();
+#else
+   threads = 1;
+#endif
+
+   job.data        = data;
+   job.pitch       = pitch;
+   job.width       = width;
+   job.height      = height;
+   job.bpp         = bpp;
+   job.level       = preset == RPNG_ENCODE_FAST ? 1
+      : preset == RPNG_ENCODE_BALANCED ? 6 : 9;
+   job.all_filters = preset != RPNG_ENCODE_FAST;
+
+   /* A strip apiece for each thread, so long as strips stay big
+    * enough for the deflate window to find something */
+   job.strips      = threads;
+   if (job.strips > height / RPNG_ENCODE_STRIP_ROWS)
+      job.strips   = height / RPNG_ENCODE_STRIP_ROWS;
+   if (job.strips < 1)
+      job.strips   = 1;
+   job.strip_rows  = (height + job.strips - 1) / job.strips;
+   if (job.strip_rows)
+      job.strips   = (height + job.strip_rows - 1) / job.strip_rows;
+
+   job.encode_buf  = (uint8_t*)malloc((width * bpp + 1) * height);
+   if (!job.encode_buf)
       GOTO_END_ERROR();
 
-   if (!png_write_iend_string(intf_s))
+   /* Room for the chunk header, the zlib header and checksum, and
+    * deflate's worst case of stored blocks */
+   strip_size       = (width * bpp + 1) * job.strip_rows;
+   job.deflate_size = 8 + 2 + strip_size + strip_size / 8 + 64 + 4;
+   job.deflate_buf  = (uint8_t*)malloc(job.deflate_size * job.strips);
+   if (!job.deflate_buf)
       GOTO_END_ERROR();
-end:
-   free(encode_buf);
-   free(deflate_buf);
-   free(rgba_line);
-   free(prev_encoded);
-   free(up_filtered);
-   free(sub_filtered);
-   free(avg_filtered);
-   free(paeth_filtered);
-
-   if (stream_backend)
+
+   strip_list = (struct rpng_encode_strip*)calloc(job.strips,
+         sizeof(*strip_list));
+   if (!strip_list)
+      GOTO_END_ERROR();
+
+   for (i = 0; i < job.strips; i++)
+   {
+      strip_list[i].job   = &job;
+      strip_list[i].index = i;
+   }
+
+#ifdef HAVE_THREADS
+   if (job.strips > 1)
+   {
+      tpool_t *pool = tpool_create(job.strips);
+
+      if (!pool)
+         GOTO_END_ERROR();
+
+      for (i = 0; i < job.strips; i++)
+         if (!tpool_add_work(pool, rpng_encode_strip, &strip_list[i]))
+            rpng_encode_strip(&strip_list[i]);
+
+      tpool_wait(pool);
+      tpool_destroy(pool);
+   }
+   else
+#endif
    {
-      if (stream)
+      for (i = 0; i < job.strips; i++)
+         rpng_encode_strip(&strip_list[i]);
+   }
+
+   /* An IDAT chunk per strip; decoders join them back up */
+   for (i = 0; i < job.strips; i++)
+   {
+      uint8_t *chunk = job.deflate_buf + job.deflate_size * i;
+      uint32_t size  = strip_list[i].deflated;
+
+      if (!strip_list[i].ok)
+         GOTO_END_ERROR();
+
+      if (job.strips > 1)
       {
-         if (stream_backend->stream_free)
-            stream_backend->stream_free(stream);
+         adler = i ? rpng_adler32_combine(adler, strip_list[i].adler,
+               strip_list[i].size) : strip_list[i].adler;
+
+         if (i + 1 == job.strips)
+         {
+            dword_write_be(chunk + 8 + size, adler);
+            size += 4;
+         }
       }
+
+      memcpy(chunk + 4, "IDAT", 4);
+      dword_write_be(chunk + 0, size);
+      if (!png_write_idat_string(intf_s, chunk, (size_t)size + 8))
+         GOTO_END_ERROR();
    }
+
+   if (!png_write_iend_string(intf_s))
+      GOTO_END_ERROR();
+end:
+   free(job.encode_buf);
+   free(job.deflate_buf);
+   free(strip_list);
    return ret;
 }
 
-bool rpng_save_image_argb(const char *path, const uint32_t *data,
-      unsigned width, unsigned height, unsigned pitch)
+bool rpng_save_image_stream(const uint8_t *data, intfstream_t* intf_s,
+      unsigned width, unsigned height, signed pitch, unsigned bpp)
+{
+   return rpng_encode_image_stream(data, intf_s, width, height,
+         pitch, bpp, NULL);
+}
+
+bool rpng_save_image_argb_ex(const char *path, const uint32_t *data,
+      unsigned width, unsigned height, unsigned pitch,
+      const struct rpng_encode_options *options)
 {
    bool ret                      = false;
    intfstream_t* intf_s          = NULL;
-   
-   intf_s = intfstream_open_file(path, 
+
+   intf_s = intfstream_open_file(path,
          RETRO_VFS_FILE_ACCESS_WRITE,
          RETRO_VFS_FILE_ACCESS_HINT_NONE);
 
-   ret = rpng_save_image_stream((const uint8_t*) data, intf_s,
-                                width, height,
-                                (signed) pitch, sizeof(uint32_t));
+   ret = rpng_encode_image_stream((const uint8_t*) data, intf_s,
+                                  width, height,
+                                  (signed) pitch, sizeof(uint32_t), options);
    intfstream_close(intf_s);
    free(intf_s);
    return ret;
 }
 
-bool rpng_save_image_bgr24(const char *path, const uint8_t *data,
-      unsigned width, unsigned height, unsigned pitch)
+bool rpng_save_image_bgr24_ex(const char *path, const uint8_t *data,
+      unsigned width, unsigned height, unsigned pitch,
+      const struct rpng_encode_options *options)
 {
    bool ret                      = false;
    intfstream_t* intf_s          = NULL;
-   
-   intf_s = intfstream_open_file(path, 
+
+   intf_s = intfstream_open_file(path,
          RETRO_VFS_FILE_ACCESS_WRITE,
          RETRO_VFS_FILE_ACCESS_HINT_NONE);
-   ret = rpng_save_image_stream(data, intf_s, width, height, 
-                                (signed) pitch, 3);
+   ret = rpng_encode_image_stream(data, intf_s, width, height,
+                                  (signed) pitch, 3, options);
    intfstream_close(intf_s);
    free(intf_s);
    return ret;
 }
 
+bool rpng_save_image_argb(const char *path, const uint32_t *data,
+      unsigned width, unsigned height, unsigned pitch)
+{
+   return rpng_save_image_argb_ex(path, data, width, height, pitch, NULL);
+}
+
+bool rpng_save_image_bgr24(const char *path, const uint8_t *data,
+      unsigned width, unsigned height, unsigned pitch)
+{
+   return rpng_save_image_bgr24_ex(path, data, width, height, pitch, NULL);
+}
 
 uint8_t* rpng_save_image_bgr24_string(const uint8_t *data,
       unsigned width, unsigned height, signed pitch, uint64_t* bytes)
@@ -433,7 +801,10 @@ end:
    if (buf)
       free(buf);
    if (intf_s)
+   {
+      intfstream_close(intf_s);
       free(intf_s);
+   }
    if (ret == false)
    {
       if (output)
@@ -27,10 +27,52 @@
 #include <stddef.h>
 
 #include <retro_common_api.h>
+#include <boolean.h>
 
 RETRO_BEGIN_DECLS
 
+/* CRC32 implementations. encoding_crc32() picks the fastest one
+ * supported by the running CPU the first time it is called; all of
+ * them produce identical results. */
+enum encoding_crc32_impl
+{
+   ENCODING_CRC32_IMPL_BYTEWISE = 0,
+   ENCODING_CRC32_IMPL_SLICE8,
+   ENCODING_CRC32_IMPL_SLICE16,
+   ENCODING_CRC32_IMPL_PCLMUL,
+   ENCODING_CRC32_IMPL_ARMV8,
+   ENCODING_CRC32_IMPL_LAST
+};
+
 uint32_t encoding_crc32(uint32_t crc, const uint8_t *buf, size_t len);
+
+/**
+ * encoding_crc32_impl_supported:
+ * @impl                : CRC32 implementation.
+ *
+ * Returns: true if @impl was compiled in and the running CPU
+ * supports it.
+ **/
+bool encoding_crc32_impl_supported(enum encoding_crc32_impl impl);
+
+const char *encoding_crc32_impl_name(enum encoding_crc32_impl impl);
+
+/**
+ * encoding_crc32_with_impl:
+ * @impl                : CRC32 implementation.
+ * @crc                 : CRC of the preceding data, or 0.
+ * @buf                 : Data.
+ * @len                 : Size of @buf in bytes.
+ *
+ * Same as encoding_crc32(), but forces @impl. Falls back to the
+ * byte-wise implementation if @impl is not supported. Meant for
+ * benchmarks and tests.
+ *
+ * Returns: the updated CRC32.
+ **/
+uint32_t encoding_crc32_with_impl(enum encoding_crc32_impl impl,
+      uint32_t crc, const uint8_t *buf, size_t len);
+
 uint32_t file_crc32(uint32_t crc, const char *path);
 
 RETRO_END_DECLS
@@ -57,6 +57,10 @@ struct config_file
    struct config_entry_list *entries;
    struct config_entry_list *tail;
    struct config_entry_list *last;
+   /* Hash index over 'entries', see config_get_entry() */
+   struct config_entry_map_slot *map;
+   size_t map_size;
+   size_t map_used;
    unsigned include_depth;
    bool guaranteed_no_duplicates;
    bool modified;
@@ -73,6 +73,13 @@ typedef struct nbio_intf
    const char *ident;
 } nbio_intf_t;
 
+/*
+ * Returns true if the backend maps files into memory. Reading
+ * a file then costs no allocation, and nbio_get_ptr is valid
+ * as soon as nbio_begin_read has been called.
+ */
+bool nbio_is_memory_mapped(void);
+
 /*
  * Creates an nbio structure for performing the
  * given operation on the given file.
@@ -34,6 +34,26 @@ RETRO_BEGIN_DECLS
 
 typedef struct rpng rpng_t;
 
+enum rpng_encode_preset
+{
+   /* Every filter tried on every line, zlib level 9 */
+   RPNG_ENCODE_SMALL = 0,
+   /* Every filter, zlib level 6 */
+   RPNG_ENCODE_BALANCED,
+   /* None, Sub and Up filters only, zlib level 1 */
+   RPNG_ENCODE_FAST
+};
+
+struct rpng_encode_options
+{
+   enum rpng_encode_preset preset;
+   /* Threads filtering and deflating strips of the image
+    * side by side; 0 for one per core. With more than one,
+    * each strip is a deflate stream of its own, so the file
+    * grows slightly. */
+   unsigned threads;
+};
+
 rpng_t *rpng_init(const char *path);
 
 bool rpng_is_valid(rpng_t *rpng);
@@ -51,11 +71,53 @@ int rpng_process_image(rpng_t *rpng,
 
 bool rpng_start(rpng_t *rpng);
 
+/* Unfiltering and pixel conversion implementations. Decoders pick
+ * the fastest one supported by the running CPU; all of them produce
+ * identical images. */
+enum rpng_decode_impl
+{
+   RPNG_DECODE_IMPL_SCALAR = 0,
+   RPNG_DECODE_IMPL_SSE2,
+   RPNG_DECODE_IMPL_SSSE3,
+   RPNG_DECODE_IMPL_NEON,
+   RPNG_DECODE_IMPL_LAST
+};
+
+/**
+ * rpng_decode_impl_supported:
+ * @impl                : Decode implementation.
+ *
+ * Returns: true if @impl was compiled in and the running CPU
+ * supports it.
+ **/
+bool rpng_decode_impl_supported(enum rpng_decode_impl impl);
+
+const char *rpng_decode_impl_name(enum rpng_decode_impl impl);
+
+/**
+ * rpng_set_decode_impl:
+ * @rpng                : PNG decoder, before rpng_process_image().
+ * @impl                : Decode implementation.
+ *
+ * Forces @impl on @rpng. Falls back to the scalar implementation
+ * if @impl is not supported. Meant for benchmarks and tests.
+ **/
+void rpng_set_decode_impl(rpng_t *rpng, enum rpng_decode_impl impl);
+
 bool rpng_save_image_argb(const char *path, const uint32_t *data,
       unsigned width, unsigned height, unsigned pitch);
 bool rpng_save_image_bgr24(const char *path, const uint8_t *data,
       unsigned width, unsigned height, unsigned pitch);
 
+/* As above, but with @options choosing the speed and size of
+ * the encoder. NULL is RPNG_ENCODE_SMALL on a single thread. */
+bool rpng_save_image_argb_ex(const char *path, const uint32_t *data,
+      unsigned width, unsigned height, unsigned pitch,
+      const struct rpng_encode_options *options);
+bool rpng_save_image_bgr24_ex(const char *path, const uint8_t *data,
+      unsigned width, unsigned height, unsigned pitch,
+      const struct rpng_encode_options *options);
+
 uint8_t* rpng_save_image_bgr24_string(const uint8_t *data,
       unsigned width, unsigned height, signed pitch, uint64_t *bytes);
 
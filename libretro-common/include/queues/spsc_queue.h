@@ -0,0 +1,81 @@
+/* Copyright  (C) 2010-2020 The RetroArch team
+ *
+ * ---------------------------------------------------------------------------------------
+ * The following license statement only applies to this file (spsc_queue.h).
+ * ---------------------------------------------------------------------------------------
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __LIBRETRO_SDK_SPSC_QUEUE_H
+#define __LIBRETRO_SDK_SPSC_QUEUE_H
+
+#include <stddef.h>
+
+#include <retro_common_api.h>
+#include <boolean.h>
+
+RETRO_BEGIN_DECLS
+
+/* Bounded queue of pointers between exactly one producer thread and
+ * one consumer thread. Pushing and popping take no lock where the
+ * compiler provides atomics (GCC, clang and MSVC), and fall back to
+ * a mutex elsewhere. */
+typedef struct spsc_queue spsc_queue_t;
+
+/**
+ * spsc_queue_new:
+ * @capacity           : Number of items the queue must hold. Rounded
+ *                       up to a power of two.
+ *
+ * Returns: the queue, or NULL on failure.
+ **/
+spsc_queue_t *spsc_queue_new(size_t capacity);
+
+void spsc_queue_free(spsc_queue_t *queue);
+
+/**
+ * spsc_queue_push:
+ * @queue              : Queue to push to. Producer thread only.
+ * @item               : Item to push.
+ *
+ * Returns: false if the queue is full.
+ **/
+bool spsc_queue_push(spsc_queue_t *queue, void *item);
+
+/**
+ * spsc_queue_pop:
+ * @queue              : Queue to pop from. Consumer thread only.
+ * @item               : Receives the oldest item.
+ *
+ * Returns: false if the queue is empty.
+ **/
+bool spsc_queue_pop(spsc_queue_t *queue, void **item);
+
+/**
+ * spsc_queue_size:
+ * @queue              : Queue to inspect. Any thread.
+ *
+ * Returns: number of items queued. Only a snapshot when called
+ * while the other side is running.
+ **/
+size_t spsc_queue_size(spsc_queue_t *queue);
+
+size_t spsc_queue_capacity(spsc_queue_t *queue);
+
+RETRO_END_DECLS
+
+#endif
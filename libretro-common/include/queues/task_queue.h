@@ -44,6 +44,29 @@ enum task_type
    TASK_TYPE_BLOCKING
 };
 
+/* What a task spends its time on, which decides how many
+ * such tasks the threaded queue runs side by side */
+enum task_class
+{
+   /* Not declared: tasks of this class run one at a time,
+    * as they did before the queue had several workers */
+   TASK_CLASS_DEFAULT = 0,
+   /* Mostly waits on files or the network */
+   TASK_CLASS_IO,
+   /* Mostly computes; always leaves a worker to the others */
+   TASK_CLASS_CPU,
+   /* Someone is waiting on the result; runs before other
+    * tasks of the same priority */
+   TASK_CLASS_LATENCY
+};
+
+enum task_priority
+{
+   TASK_PRIORITY_LOW    = -1,
+   TASK_PRIORITY_NORMAL = 0,
+   TASK_PRIORITY_HIGH   = 1
+};
+
 typedef struct retro_task retro_task_t;
 typedef void (*retro_task_callback_t)(retro_task_t *task,
       void *task_data,
@@ -130,6 +153,21 @@ struct retro_task
 
    /* when the task should run (0 for as soon as possible) */
    retro_time_t when;
+
+   /* see enum task_class */
+   enum task_class task_class;
+
+   /* among tasks that are due, higher runs first
+    * (see enum task_priority); a task that waits on
+    * tasks it pushed should not outrank them */
+   int8_t priority;
+
+   /* if set to true, no two tasks with this handler
+    * run at the same time */
+   bool non_reentrant;
+
+   /* set while a worker runs the handler; don't touch this. */
+   bool busy;
 };
 
 typedef struct task_finder_data
@@ -39,6 +39,27 @@ typedef struct chdstream chdstream_t;
 /* Primary (largest) data track, used for CRC identification purposes */
 #define CHDSTREAM_TRACK_PRIMARY (-3)
 
+/* Counters of the hunk cache of a CHD file */
+struct chdstream_cache_stats
+{
+   /* Hunks found in the cache */
+   uint64_t hits;
+   /* Hunks a reader had to decompress */
+   uint64_t misses;
+   /* Hunks decompressed ahead of a sequential reader */
+   uint64_t readahead;
+};
+
+/* Sets how many decompressed hunks are cached for each
+ * CHD file, and how many are read ahead in the background
+ * once a stream reads sequentially (0 disables read-ahead,
+ * which is also capped at half the cache and needs a second
+ * CPU core). Streams open on
+ * the same file share its cache. Only affects files opened
+ * afterwards; call it before opening streams from several
+ * threads. */
+void chdstream_set_cache(unsigned hunks, unsigned readahead);
+
 chdstream_t *chdstream_open(const char *path, int32_t track);
 
 void chdstream_close(chdstream_t *stream);
@@ -61,6 +82,11 @@ uint32_t chdstream_get_track_start(chdstream_t* stream);
 
 uint32_t chdstream_get_frame_size(chdstream_t* stream);
 
+/* Counters of the cache 'stream' shares with
+ * the other streams open on its file */
+void chdstream_get_cache_stats(chdstream_t *stream,
+      struct chdstream_cache_stats *stats);
+
 RETRO_END_DECLS
 
 #endif
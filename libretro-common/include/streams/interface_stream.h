@@ -32,6 +32,9 @@
 
 RETRO_BEGIN_DECLS
 
+/* Size of the read buffer used by intfstream_get_crc_range */
+#define INTFSTREAM_CRC_CHUNK_SIZE (256 * 1024)
+
 enum intfstream_type
 {
    INTFSTREAM_FILE = 0,
@@ -110,9 +113,44 @@ bool intfstream_is_compressed(intfstream_internal_t *intf);
 
 bool intfstream_get_crc(intfstream_internal_t *intf, uint32_t *crc);
 
+/**
+ * intfstream_get_crc_range:
+ * @intf               : stream
+ * @offset             : start of the range
+ * @len                : length of the range; hashing stops
+ *                       early at the end of the stream
+ * @crc                : receives the CRC32 of the range
+ *
+ * Computes the CRC32 of a range of a stream, reading it
+ * through a fixed INTFSTREAM_CRC_CHUNK_SIZE buffer.
+ *
+ * Returns: true on success, false on a seek or read error.
+ **/
+bool intfstream_get_crc_range(intfstream_internal_t *intf,
+      uint64_t offset, uint64_t len, uint32_t *crc);
+
 intfstream_t *intfstream_open_file(const char *path,
       unsigned mode, unsigned hints);
 
+/**
+ * intfstream_open_file_range:
+ * @path               : file to open
+ * @mode               : RETRO_VFS_FILE_ACCESS_* mode
+ * @hints              : RETRO_VFS_FILE_ACCESS_HINT_* hints
+ * @offset             : start of the range
+ * @size               : length of the range; it is cut
+ *                       short at the end of the file
+ *
+ * Opens a read-only stream over a range of a file, such as a
+ * track of a disc image. Offsets, sizes and reads are those of
+ * the range, which is read from the file as it is needed.
+ *
+ * Returns: the stream, or NULL if the file can't be opened
+ * or ends before @offset.
+ **/
+intfstream_t *intfstream_open_file_range(const char *path,
+      unsigned mode, unsigned hints, uint64_t offset, uint64_t size);
+
 intfstream_t *intfstream_open_memory(void *data,
       unsigned mode, unsigned hints, uint64_t size);
 
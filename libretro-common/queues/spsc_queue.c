@@ -0,0 +1,188 @@
+/* Copyright  (C) 2010-2020 The RetroArch team
+ *
+ * ---------------------------------------------------------------------------------------
+ * The following license statement only applies to this file (spsc_queue.c).
+ * ---------------------------------------------------------------------------------------
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdlib.h>
+
+#include <queues/spsc_queue.h>
+
+#if defined(__clang__) || (defined(__GNUC__) \
+      && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 7)))
+#define SPSC_LOAD_ACQUIRE(ptr)       __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+#define SPSC_STORE_RELEASE(ptr, val) __atomic_store_n((ptr), (val), __ATOMIC_RELEASE)
+#elif defined(_MSC_VER) && !defined(_XBOX)
+#include <windows.h>
+static size_t spsc_load_acquire(volatile size_t *ptr)
+{
+   size_t val = *ptr;
+   MemoryBarrier();
+   return val;
+}
+static void spsc_store_release(volatile size_t *ptr, size_t val)
+{
+   MemoryBarrier();
+   *ptr = val;
+}
+#define SPSC_LOAD_ACQUIRE(ptr)       spsc_load_acquire(ptr)
+#define SPSC_STORE_RELEASE(ptr, val) spsc_store_release((ptr), (val))
+#elif defined(HAVE_THREADS)
+#define SPSC_QUEUE_LOCKED
+#include <rthreads/rthreads.h>
+#else
+/* Without threads, both sides run on the same one */
+#define SPSC_LOAD_ACQUIRE(ptr)       (*(ptr))
+#define SPSC_STORE_RELEASE(ptr, val) (*(ptr) = (val))
+#endif
+
+/* Keeps the producer's and the consumer's indices on separate cache
+ * lines, so that each side only writes to its own */
+#define SPSC_QUEUE_PAD 64
+
+struct spsc_queue
+{
+   void **items;
+   size_t mask;
+#ifdef SPSC_QUEUE_LOCKED
+   slock_t *lock;
+#endif
+
+   /* Next slot to pop; written by the consumer only */
+   char pad0[SPSC_QUEUE_PAD];
+   volatile size_t head;
+
+   /* Next slot to push; written by the producer only */
+   char pad1[SPSC_QUEUE_PAD];
+   volatile size_t tail;
+   char pad2[SPSC_QUEUE_PAD];
+};
+
+#ifdef SPSC_QUEUE_LOCKED
+static size_t spsc_locked_load(spsc_queue_t *queue, volatile size_t *ptr)
+{
+   size_t val;
+   slock_lock(queue->lock);
+   val = *ptr;
+   slock_unlock(queue->lock);
+   return val;
+}
+
+static void spsc_locked_store(spsc_queue_t *queue,
+      volatile size_t *ptr, size_t val)
+{
+   slock_lock(queue->lock);
+   *ptr = val;
+   slock_unlock(queue->lock);
+}
+
+#define SPSC_LOAD_ACQUIRE(ptr)       spsc_locked_load(queue, (ptr))
+#define SPSC_STORE_RELEASE(ptr, val) spsc_locked_store(queue, (ptr), (val))
+#endif
+
+spsc_queue_t *spsc_queue_new(size_t capacity)
+{
+   size_t size         = 1;
+   spsc_queue_t *queue = NULL;
+
+   if (!capacity)
+      return NULL;
+
+   while (size < capacity)
+      size <<= 1;
+
+   queue = (spsc_queue_t*)calloc(1, sizeof(*queue));
+   if (!queue)
+      return NULL;
+
+   queue->items = (void**)calloc(size, sizeof(*queue->items));
+   queue->mask  = size - 1;
+
+#ifdef SPSC_QUEUE_LOCKED
+   queue->lock  = slock_new();
+   if (!queue->lock)
+   {
+      free(queue->items);
+      queue->items = NULL;
+   }
+#endif
+
+   if (!queue->items)
+   {
+      free(queue);
+      return NULL;
+   }
+
+   return queue;
+}
+
+void spsc_queue_free(spsc_queue_t *queue)
+{
+   if (!queue)
+      return;
+
+#ifdef SPSC_QUEUE_LOCKED
+   slock_free(queue->lock);
+#endif
+   free(queue->items);
+   free(queue);
+}
+
+bool spsc_queue_push(spsc_queue_t *queue, void *item)
+{
+   size_t tail = queue->tail;
+
+   if (tail - SPSC_LOAD_ACQUIRE(&queue->head) > queue->mask)
+      return false;
+
+   queue->items[tail & queue->mask] = item;
+
+   /* Publishes the item along with the new tail */
+   SPSC_STORE_RELEASE(&queue->tail, tail + 1);
+   return true;
+}
+
+bool spsc_queue_pop(spsc_queue_t *queue, void **item)
+{
+   size_t head = queue->head;
+
+   if (head == SPSC_LOAD_ACQUIRE(&queue->tail))
+      return false;
+
+   *item = queue->items[head & queue->mask];
+
+   /* Hands the slot back to the producer only once it has been read */
+   SPSC_STORE_RELEASE(&queue->head, head + 1);
+   return true;
+}
+
+size_t spsc_queue_size(spsc_queue_t *queue)
+{
+   size_t head = SPSC_LOAD_ACQUIRE(&queue->head);
+   size_t tail = SPSC_LOAD_ACQUIRE(&queue->tail);
+
+   /* The two loads aren't one snapshot, so the other side may have
+    * moved in between. Clamp what a stale head could overstate. */
+   return tail - head > queue->mask ? queue->mask + 1 : tail - head;
+}
+
+size_t spsc_queue_capacity(spsc_queue_t *queue)
+{
+   return queue->mask + 1;
+}
@@ -37,6 +37,10 @@
 #define SLOCK_UNLOCK(x)
 #endif
 
+/* Upper bound on threaded workers; there are as many
+ * as CPU cores, but at least two */
+#define TASK_QUEUE_MAX_WORKERS 4
+
 typedef struct
 {
    retro_task_t *front;
@@ -71,7 +75,8 @@ static slock_t *finished_lock               = NULL;
 static slock_t *property_lock               = NULL;
 static slock_t *queue_lock                  = NULL;
 static scond_t *worker_cond                 = NULL;
-static sthread_t *worker_thread             = NULL;
+static sthread_t *worker_threads[TASK_QUEUE_MAX_WORKERS];
+static unsigned worker_count                = 0;
 static bool worker_continue                 = true; 
 /* use running_lock when touching it */
 #endif
@@ -467,41 +472,107 @@ static void retro_task_threaded_retrieve(task_retriever_data_t *data)
    slock_unlock(running_lock);
 }
 
-static void threaded_worker(void *userdata)
+/* 'running_lock' must be held. Whether 'task' may start on a
+ * worker, given the tasks other workers are running. */
+static bool task_queue_can_run(const retro_task_t *task)
 {
-   (void)userdata;
+   const retro_task_t *t = NULL;
+   unsigned cpu_busy     = 0;
 
-   for (;;)
+   for (t = tasks_running.front; t; t = t->next)
    {
-      retro_task_t *task  = NULL;
-      bool       finished = false;
+      if (!t->busy)
+         continue;
 
-      if (!worker_continue)
-         break; /* should we keep running until all tasks finished? */
+      if (t->task_class == TASK_CLASS_CPU)
+         cpu_busy++;
 
-      slock_lock(running_lock);
+      if (     task->task_class == TASK_CLASS_DEFAULT
+            && t->task_class    == TASK_CLASS_DEFAULT)
+         return false;
 
-      /* Get first task to run */
-      task = tasks_running.front;
-      if (!task)
-      {
-         scond_wait(worker_cond, running_lock);
-         slock_unlock(running_lock);
+      if (task->non_reentrant && t->handler == task->handler)
+         return false;
+   }
+
+   return task->task_class != TASK_CLASS_CPU
+      || worker_count < 2
+      || cpu_busy < worker_count - 1;
+}
+
+static int task_queue_rank(const retro_task_t *task)
+{
+   return task->priority * 2 + (task->task_class == TASK_CLASS_LATENCY);
+}
+
+/* 'running_lock' must be held. Picks the task a worker should
+ * run next: the best ranked of those due, the one nearest the
+ * front of the queue among equals, so that tasks of the same
+ * rank take turns. Returns NULL if there is none, with 'delay'
+ * set to the time until the next scheduled task is due, or to
+ * 0 if it has to wait for another worker. */
+static retro_task_t *task_queue_pick(retro_time_t *delay)
+{
+   retro_task_t *task = NULL;
+   retro_task_t *best = NULL;
+   retro_time_t now   = 0;
+
+   *delay             = 0;
+
+   for (task = tasks_running.front; task; task = task->next)
+   {
+      if (task->busy)
          continue;
-      }
 
       if (task->when)
       {
-         retro_time_t now   = cpu_features_get_time_usec();
-         retro_time_t delay = task->when - now - 500; /* allow half a millisecond for context switching */
-         if (delay > 0)
+         retro_time_t wait;
+
+         if (!now)
+            now  = cpu_features_get_time_usec();
+
+         wait    = task->when - now - 500; /* allow half a millisecond for context switching */
+
+         /* Sorted by 'when', so nothing further on is due either */
+         if (wait > 0)
          {
-            scond_wait_timeout(worker_cond, running_lock, delay);
-            slock_unlock(running_lock);
-            continue;
+            if (!best)
+               *delay = wait;
+            break;
          }
       }
 
+      if (     (!best || task_queue_rank(task) > task_queue_rank(best))
+            && task_queue_can_run(task))
+         best = task;
+   }
+
+   return best;
+}
+
+static void threaded_worker(void *userdata)
+{
+   (void)userdata;
+
+   slock_lock(running_lock);
+
+   /* should we keep running until all tasks finished? */
+   while (worker_continue)
+   {
+      retro_time_t delay  = 0;
+      bool       finished = false;
+      retro_task_t *task  = task_queue_pick(&delay);
+
+      if (!task)
+      {
+         if (delay > 0)
+            scond_wait_timeout(worker_cond, running_lock, delay);
+         else
+            scond_wait(worker_cond, running_lock);
+         continue;
+      }
+
+      task->busy = true;
       slock_unlock(running_lock);
 
       task->handler(task);
@@ -510,44 +581,51 @@ static void threaded_worker(void *userdata)
       finished = task->finished;
       slock_unlock(property_lock);
 
+      slock_lock(running_lock);
+      slock_lock(queue_lock);
+
+      task->busy = false;
+
       /* Update queue */
       if (!finished)
       {
-         /* Move the task to the back of the queue */
-         /* mimics retro_task_threaded_push_running, 
-          * but also includes a task_queue_remove */
-         slock_lock(running_lock);
-         slock_lock(queue_lock);
-
-         /* do nothing if only item in queue */
-         if (task->next) 
+         /* Move the task to the back of the queue,
+          * unless it is there already */
+         if (task->next)
          {
             task_queue_remove(&tasks_running, task);
             task_queue_put(&tasks_running, task);
-            scond_signal(worker_cond);
          }
-         slock_unlock(queue_lock);
-         slock_unlock(running_lock);
       }
       else
-      {
-         /* Remove task from running queue */
-         slock_lock(running_lock);
-         slock_lock(queue_lock);
          task_queue_remove(&tasks_running, task);
-         slock_unlock(queue_lock);
-         slock_unlock(running_lock);
 
-         /* Add task to finished queue */
+      /* The task may have held back others */
+      scond_broadcast(worker_cond);
+
+      slock_unlock(queue_lock);
+
+      if (finished)
+      {
+         /* Add task to finished queue. Callbacks may push tasks
+          * while 'finished_lock' is held, so let go of
+          * 'running_lock' first. */
+         slock_unlock(running_lock);
          slock_lock(finished_lock);
          task_queue_put(&tasks_finished, task);
          slock_unlock(finished_lock);
+         slock_lock(running_lock);
       }
    }
+
+   slock_unlock(running_lock);
 }
 
 static void retro_task_threaded_init(void)
 {
+   unsigned i;
+   unsigned cores  = cpu_features_get_core_amount();
+
    running_lock    = slock_new();
    finished_lock   = slock_new();
    property_lock   = slock_new();
@@ -558,17 +636,35 @@ static void retro_task_threaded_init(void)
    worker_continue = true;
    slock_unlock(running_lock);
 
-   worker_thread   = sthread_create(threaded_worker, NULL);
+   if (cores < 2)
+      cores        = 2;
+   if (cores > TASK_QUEUE_MAX_WORKERS)
+      cores        = TASK_QUEUE_MAX_WORKERS;
+
+   worker_count    = 0;
+   for (i = 0; i < cores; i++)
+   {
+      if (!(worker_threads[worker_count] =
+               sthread_create(threaded_worker, NULL)))
+         break;
+      worker_count++;
+   }
 }
 
 static void retro_task_threaded_deinit(void)
 {
+   unsigned i;
+
    slock_lock(running_lock);
    worker_continue = false;
-   scond_signal(worker_cond);
+   scond_broadcast(worker_cond);
    slock_unlock(running_lock);
 
-   sthread_join(worker_thread);
+   for (i = 0; i < worker_count; i++)
+   {
+      sthread_join(worker_threads[i]);
+      worker_threads[i] = NULL;
+   }
 
    scond_free(worker_cond);
    slock_free(running_lock);
@@ -576,7 +672,7 @@ static void retro_task_threaded_deinit(void)
    slock_free(property_lock);
    slock_free(queue_lock);
 
-   worker_thread   = NULL;
+   worker_count    = 0;
    worker_cond     = NULL;
    running_lock    = NULL;
    finished_lock   = NULL;
@@ -913,6 +1009,10 @@ retro_task_t *task_init(void)
    task->alternative_look  = false;
    task->next              = NULL;
    task->when              = 0;
+   task->task_class        = TASK_CLASS_DEFAULT;
+   task->priority          = TASK_PRIORITY_NORMAL;
+   task->non_reentrant     = false;
+   task->busy              = false;
 
    return task;
 }
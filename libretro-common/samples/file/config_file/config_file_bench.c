@@ -0,0 +1,115 @@
+/* Copyright  (C) 2010-2020 The RetroArch team
+ *
+ * ---------------------------------------------------------------------------------------
+ * The following license statement only applies to this file (config_file_bench.c).
+ * ---------------------------------------------------------------------------------------
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/* Times the config round trip RetroArch performs on retroarch.cfg:
+ * load a file, read back every key, then update every key and write
+ * the file out sorted. Also times building a config of the same size
+ * from scratch with config_set_string(), as done when saving core
+ * options and overrides.
+ *
+ * Usage: config_file_bench [keys] */
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <file/config_file.h>
+#include <features/features_cpu.h>
+
+#define BENCH_CFG_PATH "config_file_bench.cfg"
+
+int main(int argc, char *argv[])
+{
+   unsigned i;
+   char key[64];
+   char value[64];
+   FILE *file;
+   retro_time_t start, load_time, get_time, set_time, write_time, build_time;
+   config_file_t *conf = NULL;
+   unsigned keys       = argc > 1 ? (unsigned)strtoul(argv[1], NULL, 0) : 5000;
+   unsigned found      = 0;
+
+   if (!(file = fopen(BENCH_CFG_PATH, "w")))
+      return 1;
+   for (i = 0; i < keys; i++)
+      fprintf(file, "bench_setting_%u_%08x = \"%u\"\n",
+            i, i * 2654435761u, i);
+   fclose(file);
+
+   start     = cpu_features_get_time_usec();
+   conf      = config_file_new(BENCH_CFG_PATH);
+   load_time = cpu_features_get_time_usec() - start;
+
+   if (!conf)
+   {
+      fprintf(stderr, "Failed to load %s\n", BENCH_CFG_PATH);
+      return 1;
+   }
+
+   start = cpu_features_get_time_usec();
+   for (i = 0; i < keys; i++)
+   {
+      unsigned val = 0;
+      snprintf(key, sizeof(key), "bench_setting_%u_%08x",
+            i, i * 2654435761u);
+      if (config_get_uint(conf, key, &val) && val == i)
+         found++;
+   }
+   get_time = cpu_features_get_time_usec() - start;
+
+   start = cpu_features_get_time_usec();
+   for (i = 0; i < keys; i++)
+   {
+      snprintf(key, sizeof(key), "bench_setting_%u_%08x",
+            i, i * 2654435761u);
+      config_set_uint(conf, key, i + 1);
+   }
+   set_time   = cpu_features_get_time_usec() - start;
+
+   start      = cpu_features_get_time_usec();
+   config_file_write(conf, BENCH_CFG_PATH, true);
+   write_time = cpu_features_get_time_usec() - start;
+   config_file_free(conf);
+
+   start = cpu_features_get_time_usec();
+   conf  = config_file_new_alloc();
+   for (i = 0; i < keys; i++)
+   {
+      snprintf(key,   sizeof(key),   "bench_option_%u", i);
+      snprintf(value, sizeof(value), "value_%u", i);
+      config_set_string(conf, key, value);
+   }
+   build_time = cpu_features_get_time_usec() - start;
+
+   printf("keys   : %u (%u read back)\n", keys, found);
+   printf("load   : %10.3f ms\n", load_time  / 1000.0);
+   printf("get    : %10.3f ms\n", get_time   / 1000.0);
+   printf("set    : %10.3f ms\n", set_time   / 1000.0);
+   printf("write  : %10.3f ms\n", write_time / 1000.0);
+   printf("total  : %10.3f ms (load + get + set + write)\n",
+         (load_time + get_time + set_time + write_time) / 1000.0);
+   printf("build  : %10.3f ms (%u new keys)\n", build_time / 1000.0, keys);
+
+   config_file_free(conf);
+   remove(BENCH_CFG_PATH);
+
+   return found == keys ? 0 : 1;
+}
@@ -59,6 +59,91 @@ static void test_config_file_parse_contains(
    free(out);
 }
 
+static void test_config_file_expect(config_file_t *cfg,
+      const char *key, const char *val)
+{
+   struct config_entry_list *entry = config_get_entry(cfg, key, NULL);
+
+   if (val ? (!entry || strcmp(entry->value, val) != 0) : entry != NULL)
+   {
+      printf("[FAILED] Key [%s] should be [%s]\n", key, val ? val : "(unset)");
+      abort();
+   }
+   if (config_entry_exists(cfg, key) != (val != NULL))
+   {
+      printf("[FAILED] config_entry_exists() disagrees for key [%s]\n", key);
+      abort();
+   }
+}
+
+/* Lookups must keep returning the first entry in list order when
+ * keys repeat, across unset, append, sort and many inserts. */
+static void test_config_file_lookup_order(void)
+{
+   unsigned i;
+   char key[32];
+   char *cfgtext      = strdup(
+         "dup = \"first\"\nother = \"x\"\ndup = \"second\"\n");
+   config_file_t *cfg = config_file_new_from_string(cfgtext, NULL);
+
+   free(cfgtext);
+   if (!cfg)
+      abort();
+
+   test_config_file_expect(cfg, "dup", "first");
+
+   config_set_string(cfg, "dup", "updated");
+   test_config_file_expect(cfg, "dup", "updated");
+
+   config_unset(cfg, "dup");
+   test_config_file_expect(cfg, "dup", "second");
+
+   config_unset(cfg, "dup");
+   test_config_file_expect(cfg, "dup", NULL);
+
+   config_set_string(cfg, "dup", "again");
+   test_config_file_expect(cfg, "dup", "again");
+
+   for (i = 0; i < 1000; i++)
+   {
+      snprintf(key, sizeof(key), "key_%u", i);
+      config_set_int(cfg, key, (int)i);
+   }
+   for (i = 0; i < 1000; i++)
+   {
+      int val = -1;
+      snprintf(key, sizeof(key), "key_%u", i);
+      if (!config_get_int(cfg, key, &val) || val != (int)i)
+      {
+         printf("[FAILED] Key [%s] lost after growing the index\n", key);
+         abort();
+      }
+   }
+
+   config_file_write(cfg, "config_file_test.cfg", true);
+   test_config_file_expect(cfg, "dup",   "again");
+   test_config_file_expect(cfg, "other", "x");
+
+   /* Appended files take priority over existing entries */
+   {
+      FILE *file = fopen("config_file_test_append.cfg", "w");
+      if (!file)
+         abort();
+      fputs("other = \"appended\"\n", file);
+      fclose(file);
+   }
+   if (!config_append_file(cfg, "config_file_test_append.cfg"))
+      abort();
+   test_config_file_expect(cfg, "other", "appended");
+   test_config_file_expect(cfg, "key_999", "999");
+
+   remove("config_file_test.cfg");
+   remove("config_file_test_append.cfg");
+   config_file_free(cfg);
+
+   printf("[SUCCESS] Lookup order preserved\n");
+}
+
 int main(void)
 {
    test_config_file_parse_contains("foo = \"bar\"\n",   "foo", "bar");
@@ -75,4 +160,6 @@ int main(void)
    test_config_file_parse_contains("foo = \"\"",     "bar", NULL);
    test_config_file_parse_contains("foo = \"\"\r\n", "bar", NULL);
    test_config_file_parse_contains("foo = \"\"",     "bar", NULL);
+
+   test_config_file_lookup_order();
 }
@@ -0,0 +1,522 @@
+/* Copyright  (C) 2010-2020 The RetroArch team
+ *
+ * ---------------------------------------------------------------------------------------
+ * The following license statement only applies to this file (rpng_decode_bench.c).
+ * ---------------------------------------------------------------------------------------
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/* Decodes a corpus of PNGs - such as a libretro-thumbnails
+ * Named_Boxarts directory - with every rpng decode implementation
+ * this CPU supports, checks each decodes every image exactly as the
+ * scalar one does, and reports how long each took.
+ *
+ * With no corpus given, a synthetic one is made up of RGB and RGBA
+ * images from rpng's own encoder and 4 and 8-bit palette images.
+ *
+ * Usage: rpng_decode_bench [passes] [file or directory...]
+ * Returns non-zero if any implementation disagrees. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include <strings.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <zlib.h>
+
+#include <retro_miscellaneous.h>
+#include <formats/rpng.h>
+#include <formats/image.h>
+
+struct bench_image
+{
+   char name[PATH_MAX_LENGTH];
+   uint8_t *data;
+   size_t size;
+};
+
+struct bench_corpus
+{
+   struct bench_image *images;
+   size_t count;
+   size_t capacity;
+};
+
+static uint64_t bench_now_ns(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static bool bench_add(struct bench_corpus *corpus, const char *name,
+      uint8_t *data, size_t size)
+{
+   struct bench_image *image;
+
+   if (corpus->count == corpus->capacity)
+   {
+      size_t capacity = corpus->capacity ? corpus->capacity * 2 : 64;
+      struct bench_image *images = (struct bench_image*)realloc(
+            corpus->images, capacity * sizeof(*images));
+
+      if (!images)
+         return false;
+      corpus->images   = images;
+      corpus->capacity = capacity;
+   }
+
+   image       = &corpus->images[corpus->count++];
+   strncpy(image->name, name, sizeof(image->name) - 1);
+   image->name[sizeof(image->name) - 1] = '\0';
+   image->data = data;
+   image->size = size;
+   return true;
+}
+
+static void bench_add_file(struct bench_corpus *corpus, const char *path)
+{
+   long size;
+   uint8_t *data;
+   FILE *file = fopen(path, "rb");
+
+   if (!file)
+      return;
+
+   fseek(file, 0, SEEK_END);
+   size = ftell(file);
+   fseek(file, 0, SEEK_SET);
+
+   data = (uint8_t*)malloc(size > 0 ? size : 1);
+   if (data && size > 0 && fread(data, 1, size, file) == (size_t)size)
+      bench_add(corpus, path, data, size);
+   else
+      free(data);
+
+   fclose(file);
+}
+
+static void bench_add_path(struct bench_corpus *corpus, const char *path)
+{
+   struct stat st;
+   DIR *dir;
+   struct dirent *entry;
+
+   if (stat(path, &st) != 0)
+      return;
+
+   if (!S_ISDIR(st.st_mode))
+   {
+      bench_add_file(corpus, path);
+      return;
+   }
+
+   if (!(dir = opendir(path)))
+      return;
+
+   while ((entry = readdir(dir)))
+   {
+      char child[PATH_MAX_LENGTH];
+      size_t len = strlen(entry->d_name);
+
+      if (entry->d_name[0] == '.')
+         continue;
+
+      snprintf(child, sizeof(child), "%s/%s", path, entry->d_name);
+
+      if (len > 4 && !strcasecmp(entry->d_name + len - 4, ".png"))
+         bench_add_file(corpus, child);
+      else if (stat(child, &st) == 0 && S_ISDIR(st.st_mode))
+         bench_add_path(corpus, child);
+   }
+
+   closedir(dir);
+}
+
+static void bench_write_chunk(uint8_t **out, const char *type,
+      const uint8_t *data, uint32_t size)
+{
+   uint8_t *p   = *out;
+   uint32_t crc;
+
+   p[0] = (uint8_t)(size >> 24);
+   p[1] = (uint8_t)(size >> 16);
+   p[2] = (uint8_t)(size >>  8);
+   p[3] = (uint8_t)(size >>  0);
+   memcpy(p + 4, type, 4);
+   if (size)
+      memcpy(p + 8, data, size);
+
+   crc = (uint32_t)crc32(0, p + 4, size + 4);
+   p[8 + size + 0] = (uint8_t)(crc >> 24);
+   p[8 + size + 1] = (uint8_t)(crc >> 16);
+   p[8 + size + 2] = (uint8_t)(crc >>  8);
+   p[8 + size + 3] = (uint8_t)(crc >>  0);
+
+   *out = p + 12 + size;
+}
+
+/* rpng only writes true colour, so palette images are put
+ * together by hand: unfiltered lines of stripes and noise */
+static bool bench_add_palette_image(struct bench_corpus *corpus,
+      unsigned width, unsigned height, unsigned depth)
+{
+   static const uint8_t magic[8] = { 0x89, 'P', 'N', 'G', 0x0d, 0x0a, 0x1a, 0x0a };
+   unsigned x, y;
+   char name[64];
+   uint8_t ihdr[13];
+   uint8_t plte[256 * 3];
+   unsigned entries = 1 << depth;
+   size_t pitch     = (width * depth + 7) / 8;
+   size_t raw_size  = (pitch + 1) * height;
+   uLongf zsize     = compressBound(raw_size);
+   uint8_t *raw     = (uint8_t*)calloc(1, raw_size);
+   uint8_t *zdata   = (uint8_t*)malloc(zsize);
+   uint8_t *png     = (uint8_t*)malloc(zsize + sizeof(plte) + 128);
+   uint8_t *out     = png;
+   uint32_t seed    = 1;
+
+   if (!raw || !zdata || !png)
+      return false;
+
+   for (y = 0; y < height; y++)
+   {
+      uint8_t *line = raw + (pitch + 1) * y + 1;
+
+      for (x = 0; x < width; x++)
+      {
+         unsigned index;
+         unsigned bit = x * depth;
+
+         seed  = seed * 1103515245 + 12345;
+         index = (y < height / 2 ? x / 8 + y / 16 : seed >> 16)
+            & (entries - 1);
+         line[bit / 8] |= index << (8 - depth - bit % 8);
+      }
+   }
+
+   for (x = 0; x < entries; x++)
+   {
+      plte[x * 3 + 0] = (uint8_t)(x * 37);
+      plte[x * 3 + 1] = (uint8_t)(x * 91 + 5);
+      plte[x * 3 + 2] = (uint8_t)(255 - x * 13);
+   }
+
+   if (compress2(zdata, &zsize, raw, raw_size, 9) != Z_OK)
+      return false;
+
+   ihdr[0]  = (uint8_t)(width  >> 24);
+   ihdr[1]  = (uint8_t)(width  >> 16);
+   ihdr[2]  = (uint8_t)(width  >>  8);
+   ihdr[3]  = (uint8_t)(width  >>  0);
+   ihdr[4]  = (uint8_t)(height >> 24);
+   ihdr[5]  = (uint8_t)(height >> 16);
+   ihdr[6]  = (uint8_t)(height >>  8);
+   ihdr[7]  = (uint8_t)(height >>  0);
+   ihdr[8]  = (uint8_t)depth;
+   ihdr[9]  = 3; /* Palette */
+   ihdr[10] = 0;
+   ihdr[11] = 0;
+   ihdr[12] = 0;
+
+   memcpy(out, magic, sizeof(magic));
+   out += sizeof(magic);
+   bench_write_chunk(&out, "IHDR", ihdr, sizeof(ihdr));
+   bench_write_chunk(&out, "PLTE", plte, entries * 3);
+   bench_write_chunk(&out, "IDAT", zdata, (uint32_t)zsize);
+   bench_write_chunk(&out, "IEND", NULL, 0);
+
+   free(raw);
+   free(zdata);
+
+   snprintf(name, sizeof(name), "synthetic %ux%u %u-bit palette",
+         width, height, depth);
+   return bench_add(corpus, name, png, out - png);
+}
+
+/* Boxart-ish: a flat border, gradients, and a noisy block in the
+ * middle, with varying alpha if there is any */
+static bool bench_add_rgb_image(struct bench_corpus *corpus,
+      unsigned width, unsigned height, bool alpha)
+{
+   unsigned x, y;
+   char name[64];
+   uint64_t size   = 0;
+   uint32_t seed   = 7;
+   uint8_t *pixels = (uint8_t*)malloc(width * height * 3);
+   uint8_t *png;
+   const char *path = "/tmp/rpng_decode_bench.png";
+
+   if (!pixels)
+      return false;
+
+   if (alpha)
+   {
+      uint32_t *argb = (uint32_t*)malloc(width * height * sizeof(uint32_t));
+      FILE *file;
+      long file_size;
+
+      if (!argb)
+         return false;
+
+      for (y = 0; y < height; y++)
+         for (x = 0; x < width; x++)
+         {
+            seed = seed * 1103515245 + 12345;
+            argb[y * width + x] =
+                 ((uint32_t)((x + y) & 0xff) << 24)
+               | ((x * 255 / width) << 16)
+               | ((y * 255 / height) << 8)
+               | ((x > width / 4 && x < width * 3 / 4 && y > height / 4)
+                     ? (seed >> 24) : 0x40);
+         }
+
+      if (!rpng_save_image_argb(path, argb, width, height,
+               width * sizeof(uint32_t)))
+         return false;
+      free(argb);
+
+      if (!(file = fopen(path, "rb")))
+         return false;
+      fseek(file, 0, SEEK_END);
+      file_size = ftell(file);
+      fseek(file, 0, SEEK_SET);
+      png = (uint8_t*)malloc(file_size);
+      if (!png || fread(png, 1, file_size, file) != (size_t)file_size)
+         return false;
+      fclose(file);
+      size = file_size;
+   }
+   else
+   {
+      for (y = 0; y < height; y++)
+         for (x = 0; x < width; x++)
+         {
+            uint8_t *p = pixels + (y * width + x) * 3;
+
+            seed = seed * 1103515245 + 12345;
+            if (x < 8 || y < 8 || x >= width - 8 || y >= height - 8)
+               p[0] = p[1] = p[2] = 0x10;
+            else if (x > width / 4 && x < width * 3 / 4 && y > height / 4)
+            {
+               p[0] = (uint8_t)(seed >> 24);
+               p[1] = (uint8_t)(seed >> 16);
+               p[2] = (uint8_t)(seed >>  8);
+            }
+            else
+            {
+               p[0] = (uint8_t)(x * 255 / width);
+               p[1] = (uint8_t)(y * 255 / height);
+               p[2] = (uint8_t)((x + y) / 4);
+            }
+         }
+
+      if (!(png = rpng_save_image_bgr24_string(pixels, width, height,
+                  width * 3, &size)))
+         return false;
+   }
+
+   free(pixels);
+
+   snprintf(name, sizeof(name), "synthetic %ux%u %s", width, height,
+         alpha ? "RGBA" : "RGB");
+   return bench_add(corpus, name, png, (size_t)size);
+}
+
+static bool bench_decode(const struct bench_image *image,
+      enum rpng_decode_impl impl, uint32_t **data,
+      unsigned *width, unsigned *height)
+{
+   int retval;
+   bool ret   = false;
+   rpng_t *rpng = rpng_alloc();
+
+   *data      = NULL;
+
+   if (!rpng)
+      return false;
+
+   rpng_set_decode_impl(rpng, impl);
+
+   if (     !rpng_set_buf_ptr(rpng, image->data, image->size)
+         || !rpng_start(rpng))
+      goto end;
+
+   while (rpng_iterate_image(rpng));
+
+   if (!rpng_is_valid(rpng))
+      goto end;
+
+   do
+   {
+      retval = rpng_process_image(rpng, (void**)data,
+            image->size, width, height);
+   } while (retval == IMAGE_PROCESS_NEXT);
+
+   ret = retval != IMAGE_PROCESS_ERROR && retval != IMAGE_PROCESS_ERROR_END;
+
+end:
+   rpng_free(rpng);
+   if (!ret)
+   {
+      free(*data);
+      *data = NULL;
+   }
+   return ret;
+}
+
+int main(int argc, char *argv[])
+{
+   unsigned impl;
+   size_t i;
+   struct bench_corpus corpus = {0};
+   unsigned passes            = argc > 1 ? strtoul(argv[1], NULL, 0) : 5;
+   uint64_t pixels            = 0;
+   uint64_t scalar_ns         = 0;
+   bool ok                    = true;
+   uint32_t **reference;
+   unsigned *ref_width, *ref_height;
+
+   if (passes < 1)
+      passes = 1;
+
+   for (i = 2; i < (size_t)argc; i++)
+      bench_add_path(&corpus, argv[i]);
+
+   if (argc <= 2)
+   {
+      if (     !bench_add_rgb_image(&corpus, 512, 720, false)
+            || !bench_add_rgb_image(&corpus, 512, 720, true)
+            || !bench_add_rgb_image(&corpus, 1001, 333, false)
+            || !bench_add_rgb_image(&corpus, 333, 257, true)
+            || !bench_add_palette_image(&corpus, 512, 720, 8)
+            || !bench_add_palette_image(&corpus, 512, 720, 4)
+            || !bench_add_palette_image(&corpus, 333, 91, 4))
+      {
+         fprintf(stderr, "Failed to make the synthetic corpus.\n");
+         return 1;
+      }
+   }
+
+   if (!corpus.count)
+   {
+      fprintf(stderr, "No PNGs found.\n");
+      return 1;
+   }
+
+   /* The scalar decode of every image is what the others must match */
+   reference  = (uint32_t**)calloc(corpus.count, sizeof(*reference));
+   ref_width  = (unsigned*)calloc(corpus.count, sizeof(*ref_width));
+   ref_height = (unsigned*)calloc(corpus.count, sizeof(*ref_height));
+
+   for (i = 0; i < corpus.count; i++)
+   {
+      if (!bench_decode(&corpus.images[i], RPNG_DECODE_IMPL_SCALAR,
+               &reference[i], &ref_width[i], &ref_height[i]))
+      {
+         fprintf(stderr, "Skipping %s: rpng can't decode it.\n",
+               corpus.images[i].name);
+         continue;
+      }
+      pixels += (uint64_t)ref_width[i] * ref_height[i];
+   }
+
+   printf("%u images, %.1f Mpixels, %u passes\n", (unsigned)corpus.count,
+         pixels / 1000000.0, passes);
+
+   for (impl = RPNG_DECODE_IMPL_SCALAR; impl < RPNG_DECODE_IMPL_LAST; impl++)
+   {
+      unsigned pass;
+      uint64_t ns    = 0;
+      bool impl_ok   = true;
+
+      if (!rpng_decode_impl_supported((enum rpng_decode_impl)impl))
+      {
+         printf("%-8s unsupported\n",
+               rpng_decode_impl_name((enum rpng_decode_impl)impl));
+         continue;
+      }
+
+      for (pass = 0; pass < passes; pass++)
+      {
+         for (i = 0; i < corpus.count; i++)
+         {
+            uint32_t *data = NULL;
+            unsigned width = 0, height = 0;
+            uint64_t start;
+
+            if (!reference[i])
+               continue;
+
+            start = bench_now_ns();
+            if (!bench_decode(&corpus.images[i],
+                     (enum rpng_decode_impl)impl, &data, &width, &height))
+            {
+               fprintf(stderr, "%s: failed to decode %s\n",
+                     rpng_decode_impl_name((enum rpng_decode_impl)impl),
+                     corpus.images[i].name);
+               impl_ok = false;
+               continue;
+            }
+            ns += bench_now_ns() - start;
+
+            if (     width  != ref_width[i]
+                  || height != ref_height[i]
+                  || memcmp(data, reference[i],
+                     (size_t)width * height * sizeof(uint32_t)))
+            {
+               if (pass == 0)
+                  fprintf(stderr, "%s: %s differs from scalar\n",
+                        rpng_decode_impl_name((enum rpng_decode_impl)impl),
+                        corpus.images[i].name);
+               impl_ok = false;
+            }
+            free(data);
+         }
+      }
+
+      if (impl == RPNG_DECODE_IMPL_SCALAR)
+         scalar_ns = ns;
+
+      printf("%-8s %9.2f ms/pass %9.1f Mpixels/s %6.2fx %s\n",
+            rpng_decode_impl_name((enum rpng_decode_impl)impl),
+            ns / 1000000.0 / passes,
+            ns ? pixels * passes * 1000.0 / ns : 0.0,
+            ns ? (double)scalar_ns / ns : 0.0,
+            impl_ok ? "ok" : "MISMATCH");
+
+      if (!impl_ok)
+         ok = false;
+   }
+
+   for (i = 0; i < corpus.count; i++)
+   {
+      free(reference[i]);
+      free(corpus.images[i].data);
+   }
+   free(reference);
+   free(ref_width);
+   free(ref_height);
+   free(corpus.images);
+
+   return ok ? 0 : 1;
+}
@@ -24,10 +24,12 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
+#include <time.h>
 #ifdef HAVE_IMLIB2
 #include <Imlib2.h>
 #endif
 
+#include <retro_miscellaneous.h>
 #include <file/nbio.h>
 #include <formats/rpng.h>
 #include <formats/image.h>
@@ -182,6 +184,125 @@ static int test_rpng(const char *in_path)
    return 0;
 }
 
+/* Something like a frame of a game: flat fills, gradients and noise */
+static void make_test_image(uint32_t *data, unsigned width, unsigned height)
+{
+   unsigned x, y;
+   uint32_t seed = 1;
+
+   for (y = 0; y < height; y++)
+   {
+      for (x = 0; x < width; x++)
+      {
+         uint32_t col;
+
+         seed = seed * 1103515245 + 12345;
+
+         if (y < height / 3)
+            col = 0x203040;
+         else if (y < height * 2 / 3)
+            col = ((x * 255 / width) << 16) | ((y & 0xff) << 8) | ((x ^ y) & 0xff);
+         else
+            col = (seed >> 8) & 0xffffff;
+
+         data[y * width + x] = 0xff000000 | col;
+      }
+   }
+}
+
+/* Encodes a test image with every preset and thread count, and
+ * checks rpng decodes each back to the same pixels */
+static int test_rpng_encode(void)
+{
+   static const char *preset_names[] = { "small", "balanced", "fast" };
+   static const unsigned threads[]   = { 1, 2, 4, 0 };
+   const char *path   = "/tmp/test_encode.png";
+   unsigned width     = 1280;
+   unsigned height    = 720;
+   unsigned preset, t, i;
+   uint32_t *image    = (uint32_t*)malloc(width * height * sizeof(uint32_t));
+   uint8_t *bgr24     = (uint8_t*)malloc(width * height * 3);
+
+   if (!image || !bgr24)
+      return 1;
+
+   make_test_image(image, width, height);
+   for (i = 0; i < width * height; i++)
+   {
+      bgr24[i * 3 + 0] = (uint8_t)(image[i] >>  0);
+      bgr24[i * 3 + 1] = (uint8_t)(image[i] >>  8);
+      bgr24[i * 3 + 2] = (uint8_t)(image[i] >> 16);
+   }
+
+   for (preset = RPNG_ENCODE_SMALL; preset <= RPNG_ENCODE_FAST; preset++)
+   {
+      for (t = 0; t < ARRAY_SIZE(threads); t++)
+      {
+         unsigned j;
+         struct rpng_encode_options options;
+         double ms;
+         int64_t size;
+         FILE *file;
+
+         options.preset  = (enum rpng_encode_preset)preset;
+         options.threads = threads[t];
+
+         /* The ARGB path and the BGR24 path by turns */
+         for (j = 0; j < 2; j++)
+         {
+            uint32_t *data          = NULL;
+            unsigned decoded_width  = 0;
+            unsigned decoded_height = 0;
+            struct timespec ts0, ts1;
+            bool saved;
+
+            clock_gettime(CLOCK_MONOTONIC, &ts0);
+            if (j == 0)
+               saved = rpng_save_image_argb_ex(path, image,
+                     width, height, width * sizeof(uint32_t), &options);
+            else
+               saved = rpng_save_image_bgr24_ex(path, bgr24,
+                     width, height, width * 3, &options);
+            clock_gettime(CLOCK_MONOTONIC, &ts1);
+            if (!saved)
+               return 2;
+            ms = (ts1.tv_sec - ts0.tv_sec) * 1000.0
+               + (ts1.tv_nsec - ts0.tv_nsec) / 1000000.0;
+
+            file = fopen(path, "rb");
+            if (!file)
+               return 3;
+            fseek(file, 0, SEEK_END);
+            size = ftell(file);
+            fclose(file);
+
+            if (!rpng_load_image_argb(path, &data,
+                     &decoded_width, &decoded_height))
+               return 4;
+
+            if (     decoded_width  != width
+                  || decoded_height != height
+                  || memcmp(data, image, width * height * sizeof(uint32_t)))
+            {
+               fprintf(stderr, "%s, %u threads: decoded image differs!\n",
+                     preset_names[preset], threads[t]);
+               free(data);
+               return 5;
+            }
+            free(data);
+
+            fprintf(stderr, "%-8s %-5s %u threads: %8.2f ms, %8u bytes\n",
+                  preset_names[preset], j == 0 ? "argb" : "bgr24",
+                  threads[t], ms, (unsigned)size);
+         }
+      }
+   }
+
+   free(image);
+   free(bgr24);
+   return 0;
+}
+
 int main(int argc, char *argv[])
 {
    const char *in_path = "/tmp/test.png";
@@ -203,5 +324,11 @@ int main(int argc, char *argv[])
       return -1;
    }
 
+   if (test_rpng_encode() != 0)
+   {
+      fprintf(stderr, "Encoder test failed.\n");
+      return -1;
+   }
+
    return 0;
 }
@@ -0,0 +1,321 @@
+/* Copyright  (C) 2010-2020 The RetroArch team
+ *
+ * ---------------------------------------------------------------------------------------
+ * The following license statement only applies to this file (task_queue_test.c).
+ * ---------------------------------------------------------------------------------------
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/* Runs tasks that sleep in their handlers through the threaded
+ * task queue, and checks which of them the workers run side by
+ * side, in which order, and that callbacks still come from
+ * task_queue_check() on the calling thread. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <retro_timers.h>
+#include <rthreads/rthreads.h>
+#include <features/features_cpu.h>
+#include <queues/task_queue.h>
+
+#define TEST_CHECK(cond) \
+   do \
+   { \
+      if (!(cond)) \
+      { \
+         fprintf(stderr, "%s:%d: check failed: %s\n", \
+               __FILE__, __LINE__, #cond); \
+         return false; \
+      } \
+   } while (0)
+
+#define TEST_MAX_TASKS 16
+
+/* Per task: how many handler calls, each sleeping 'slice_ms' */
+struct test_task
+{
+   unsigned slices;
+   unsigned slice_ms;
+   unsigned group;
+   bool started;
+};
+
+/* What the handlers saw; guarded by 'test_lock' */
+static slock_t *test_lock;
+static unsigned test_running[2];
+static unsigned test_max_running[2];
+static unsigned test_total;
+static unsigned test_max_total;
+static unsigned test_started;
+static int test_order[TEST_MAX_TASKS];
+static retro_time_t test_start_time[TEST_MAX_TASKS];
+static unsigned test_finished;
+static uintptr_t test_main_thread;
+static bool test_callback_elsewhere;
+
+static void test_reset(void)
+{
+   slock_lock(test_lock);
+   memset(test_running, 0, sizeof(test_running));
+   memset(test_max_running, 0, sizeof(test_max_running));
+   memset(test_order, -1, sizeof(test_order));
+   memset(test_start_time, 0, sizeof(test_start_time));
+   test_total     = 0;
+   test_max_total = 0;
+   test_started   = 0;
+   test_finished  = 0;
+   slock_unlock(test_lock);
+}
+
+static void test_handler(retro_task_t *task)
+{
+   struct test_task *state = (struct test_task*)task->state;
+   unsigned group          = state->group;
+   size_t id               = (size_t)task->user_data;
+
+   slock_lock(test_lock);
+   if (!state->started)
+   {
+      state->started = true;
+      if (id < TEST_MAX_TASKS)
+         test_start_time[id] = cpu_features_get_time_usec();
+      if (test_started < TEST_MAX_TASKS)
+         test_order[test_started] = (int)id;
+      test_started++;
+   }
+   if (++test_running[group] > test_max_running[group])
+      test_max_running[group] = test_running[group];
+   if (++test_total > test_max_total)
+      test_max_total = test_total;
+   slock_unlock(test_lock);
+
+   retro_sleep(state->slice_ms);
+
+   slock_lock(test_lock);
+   test_running[group]--;
+   test_total--;
+   slock_unlock(test_lock);
+
+   if (--state->slices == 0)
+      task_set_finished(task, true);
+}
+
+/* Same as test_handler, only a different function */
+static void test_other_handler(retro_task_t *task)
+{
+   test_handler(task);
+}
+
+static void test_callback(retro_task_t *task, void *task_data,
+      void *user_data, const char *error)
+{
+   if (sthread_get_current_thread_id() != test_main_thread)
+      test_callback_elsewhere = true;
+   test_finished++;
+}
+
+static void test_cleanup(retro_task_t *task)
+{
+   free(task->state);
+}
+
+static retro_task_t *test_push(retro_task_handler_t handler,
+      enum task_class task_class, int8_t priority, bool non_reentrant,
+      unsigned group, unsigned slices, unsigned slice_ms, size_t id)
+{
+   retro_task_t *task      = task_init();
+   struct test_task *state = (struct test_task*)calloc(1, sizeof(*state));
+
+   if (!task || !state)
+      return NULL;
+
+   state->slices       = slices;
+   state->slice_ms     = slice_ms;
+   state->group        = group;
+
+   task->handler       = handler;
+   task->callback      = test_callback;
+   task->cleanup       = test_cleanup;
+   task->state         = state;
+   task->user_data     = (void*)id;
+   task->task_class    = task_class;
+   task->priority      = priority;
+   task->non_reentrant = non_reentrant;
+
+   task_queue_push(task);
+   return task;
+}
+
+/* Gathers until 'count' tasks have called back */
+static bool test_wait(unsigned count)
+{
+   retro_time_t deadline = cpu_features_get_time_usec() + 10000000;
+
+   while (test_finished < count)
+   {
+      if (cpu_features_get_time_usec() > deadline)
+         return false;
+      task_queue_check();
+      retro_sleep(1);
+   }
+
+   return true;
+}
+
+static bool test_parallel(void)
+{
+   retro_time_t start;
+   unsigned i;
+
+   test_reset();
+
+   /* Two I/O tasks of one 100 ms slice overlap */
+   start = cpu_features_get_time_usec();
+   for (i = 0; i < 2; i++)
+      TEST_CHECK(test_push(test_handler, TASK_CLASS_IO,
+               TASK_PRIORITY_NORMAL, false, 0, 1, 100, i));
+   TEST_CHECK(test_wait(2));
+   TEST_CHECK(test_max_running[0] == 2);
+   TEST_CHECK(cpu_features_get_time_usec() - start < 190000);
+   TEST_CHECK(!test_callback_elsewhere);
+
+   return true;
+}
+
+static bool test_exclusion(void)
+{
+   unsigned i;
+
+   /* Tasks declaring no class run one at a time */
+   test_reset();
+   for (i = 0; i < 3; i++)
+      TEST_CHECK(test_push(test_handler, TASK_CLASS_DEFAULT,
+               TASK_PRIORITY_NORMAL, false, 0, 3, 10, i));
+   TEST_CHECK(test_wait(3));
+   TEST_CHECK(test_max_running[0] == 1);
+
+   /* Non-reentrant tasks exclude their own handler only */
+   test_reset();
+   for (i = 0; i < 3; i++)
+   {
+      TEST_CHECK(test_push(test_handler, TASK_CLASS_IO,
+               TASK_PRIORITY_NORMAL, true, 0, 3, 10, i));
+      TEST_CHECK(test_push(test_other_handler, TASK_CLASS_IO,
+               TASK_PRIORITY_NORMAL, false, 1, 3, 10, i));
+   }
+   TEST_CHECK(test_wait(6));
+   TEST_CHECK(test_max_running[0] == 1);
+   TEST_CHECK(test_max_total >= 2);
+
+   return true;
+}
+
+static bool test_latency(void)
+{
+   unsigned i;
+   retro_time_t pushed;
+
+   test_reset();
+
+   /* A scan on every worker it can get... */
+   for (i = 0; i < 4; i++)
+      TEST_CHECK(test_push(test_handler, TASK_CLASS_CPU,
+               TASK_PRIORITY_LOW, false, 0, 10, 20, i));
+   retro_sleep(30);
+
+   /* ...still leaves one for a thumbnail */
+   pushed = cpu_features_get_time_usec();
+   TEST_CHECK(test_push(test_other_handler, TASK_CLASS_LATENCY,
+            TASK_PRIORITY_HIGH, false, 1, 1, 5, 4));
+
+   TEST_CHECK(test_wait(5));
+   TEST_CHECK(test_start_time[4] - pushed < 15000);
+   TEST_CHECK(test_max_running[0] < 4);
+
+   return true;
+}
+
+static bool test_priority(void)
+{
+   unsigned i;
+
+   test_reset();
+
+   /* With tasks run one at a time, the high priority one
+    * overtakes those waiting */
+   for (i = 0; i < 4; i++)
+      TEST_CHECK(test_push(test_handler, TASK_CLASS_DEFAULT,
+               TASK_PRIORITY_LOW, false, 0, 2, 10, i));
+   TEST_CHECK(test_push(test_handler, TASK_CLASS_DEFAULT,
+            TASK_PRIORITY_HIGH, false, 0, 2, 10, 4));
+
+   TEST_CHECK(test_wait(5));
+   TEST_CHECK(test_order[0] == 4 || test_order[1] == 4);
+
+   return true;
+}
+
+static bool test_schedule(void)
+{
+   retro_time_t start = cpu_features_get_time_usec();
+   retro_task_t *task = NULL;
+   struct test_task *state;
+
+   test_reset();
+
+   TEST_CHECK(task = task_init());
+   TEST_CHECK(state = (struct test_task*)calloc(1, sizeof(*state)));
+   state->slices   = 1;
+   state->slice_ms = 1;
+   task->handler   = test_handler;
+   task->callback  = test_callback;
+   task->cleanup   = test_cleanup;
+   task->state     = state;
+   task->user_data = (void*)(size_t)0;
+   task->when      = start + 50000;
+   task_queue_push(task);
+
+   TEST_CHECK(test_wait(1));
+   /* Workers start scheduled tasks half a millisecond early */
+   TEST_CHECK(test_start_time[0] >= start + 49000);
+
+   return true;
+}
+
+int main(int argc, char *argv[])
+{
+   bool ok          = true;
+
+   test_lock        = slock_new();
+   test_main_thread = sthread_get_current_thread_id();
+
+   task_queue_init(true, NULL);
+
+   ok = test_parallel()  && ok;
+   ok = test_exclusion() && ok;
+   ok = test_latency()   && ok;
+   ok = test_priority()  && ok;
+   ok = test_schedule()  && ok;
+
+   task_queue_deinit();
+   slock_free(test_lock);
+
+   printf("%s\n", ok ? "ok" : "FAILED");
+   return ok ? 0 : 1;
+}
@@ -0,0 +1,666 @@
+/* Copyright  (C) 2010-2020 The RetroArch team
+ *
+ * ---------------------------------------------------------------------------------------
+ * The following license statement only applies to this file (chd_stream_bench.c).
+ * ---------------------------------------------------------------------------------------
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/* Replays a seek trace against the CHD stream hunk cache, at a few
+ * cache and read-ahead sizes.
+ *
+ * The image is written here: a zlib compressed CHD (v4, which needs
+ * no huffman coded map) with a data track and two audio tracks.
+ *
+ * A trace is a text file of "<track> <byte offset> <bytes>" lines, one
+ * per chdstream_seek() and chdstream_read() pair, as a core or a scan
+ * would issue them; lines starting with '#' are skipped. Without one,
+ * a built-in trace is used, which boots the disc, loads files sector
+ * by sector, streams video next to CD audio, and seeks back and forth
+ * between two files.
+ *
+ * Each trace is replayed as fast as possible, then again with the
+ * reader busy for a while after each read, as a core emulating the
+ * drive is. The time reported is the time spent inside
+ * chdstream_read(), which read-ahead can only cut in the second case.
+ * Read-ahead stays off on a single core, where it would only take
+ * time from the reader.
+ *
+ * Last, the whole image is decompressed hunk by hunk with chd_read(),
+ * and the tracks are checksummed a sector a read, then as the database
+ * scan does it, 256 KB a read, which chdstream_read() splits between
+ * the cores.
+ *
+ * Usage: chd_stream_bench [trace] */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <zlib.h>
+
+#include <retro_endianness.h>
+#include <features/features_cpu.h>
+#include <libchdr/chd.h>
+#include <libchdr/cdrom.h>
+#include <streams/chd_stream.h>
+
+#define TEST_CHECK(cond) \
+   do \
+   { \
+      if (!(cond)) \
+      { \
+         fprintf(stderr, "%s:%d: check failed: %s\n", \
+               __FILE__, __LINE__, #cond); \
+         return false; \
+      } \
+   } while (0)
+
+#define BENCH_PATH        "chd_stream_bench.chd"
+#define BENCH_SECTOR      2352
+#define BENCH_HUNKBYTES   (CD_FRAME_SIZE * CD_FRAMES_PER_HUNK)
+#define BENCH_TRACKS      3
+/* Microseconds of emulation after each read, when paced */
+#define BENCH_PACE        100
+#define BENCH_RUNS        3
+/* Bytes per CRC scan read */
+#define BENCH_SCAN_CHUNK  (256 * 1024)
+
+/* Frames in each track; multiples of 4, so no padding */
+static const uint32_t bench_track_frames[BENCH_TRACKS] = { 4000, 1000, 1000 };
+
+struct bench_op
+{
+   unsigned track;
+   uint64_t offset;
+   uint32_t bytes;
+};
+
+typedef struct bench_trace
+{
+   struct bench_op *ops;
+   size_t count;
+   size_t capacity;
+} bench_trace_t;
+
+struct bench_config
+{
+   unsigned hunks;
+   unsigned readahead;
+   const char *name;
+};
+
+static const struct bench_config bench_configs[] = {
+   {  1, 0, "1 hunk (as before)" },
+   { 16, 0, "16 hunks" },
+   { 16, 4, "16 hunks, 4 ahead" },
+   { 64, 8, "64 hunks, 8 ahead" },
+};
+
+static uint64_t bench_now_ns(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* Contents of a frame: data compresses about 2:1, audio
+ * (a ramp with noisy low bytes) a little worse */
+static void bench_frame(uint32_t frame, uint8_t *out)
+{
+   uint32_t i;
+   uint32_t seed = frame * 2654435761u + 1;
+
+   for (i = 0; i < CD_FRAME_SIZE; i++)
+   {
+      seed = seed * 1103515245 + 12345;
+      if (frame < bench_track_frames[0])
+         out[i] = (uint8_t)('a' + ((seed >> 16) & 15));
+      else if (i & 1)
+         out[i] = (uint8_t)((i / 2 + frame * 1176) >> 4);
+      else
+         out[i] = (uint8_t)(seed >> 16);
+   }
+}
+
+static void bench_put_be(uint8_t *out, uint64_t value, unsigned bytes)
+{
+   while (bytes--)
+   {
+      out[bytes] = (uint8_t)value;
+      value    >>= 8;
+   }
+}
+
+static bool bench_write_image(const char *path)
+{
+   unsigned i;
+   uint32_t hunk;
+   z_stream zs;
+   char meta[BENCH_TRACKS][128];
+   uint8_t header[CHD_V4_HEADER_SIZE];
+   uint32_t frames         = 0;
+   uint64_t offset         = 0;
+   uint64_t meta_offset    = 0;
+   uint32_t total_hunks    = 0;
+   uint8_t *map            = NULL;
+   uint8_t *raw            = NULL;
+   uint8_t *packed         = NULL;
+   FILE *fp                = NULL;
+   bool ok                 = false;
+
+   for (i = 0; i < BENCH_TRACKS; i++)
+      frames += bench_track_frames[i];
+   total_hunks = (frames + CD_FRAMES_PER_HUNK - 1) / CD_FRAMES_PER_HUNK;
+
+   for (i = 0; i < BENCH_TRACKS; i++)
+      snprintf(meta[i], sizeof(meta[i]), CDROM_TRACK_METADATA2_FORMAT,
+            i + 1, i ? "AUDIO" : "MODE1_RAW", "NONE",
+            bench_track_frames[i], 0, i ? "VAUDIO" : "MODE1", "NONE", 0);
+
+   memset(&zs, 0, sizeof(zs));
+   if (deflateInit2(&zs, 6, Z_DEFLATED, -MAX_WBITS, 8,
+            Z_DEFAULT_STRATEGY) != Z_OK)
+      return false;
+
+   map    = (uint8_t*)calloc(total_hunks, 16);
+   raw    = (uint8_t*)calloc(1, BENCH_HUNKBYTES);
+   packed = (uint8_t*)malloc(BENCH_HUNKBYTES);
+   if (!map || !raw || !packed || !(fp = fopen(path, "wb")))
+      goto end;
+
+   /* Header, hunk map and metadata come first;
+    * hunks follow at 'offset' */
+   meta_offset = CHD_V4_HEADER_SIZE + (uint64_t)total_hunks * 16 + 16;
+   offset      = meta_offset;
+   for (i = 0; i < BENCH_TRACKS; i++)
+      offset  += 16 + strlen(meta[i]) + 1;
+
+   memset(header, 0, sizeof(header));
+   memcpy(header, "MComprHD", 8);
+   bench_put_be(header + 8,  CHD_V4_HEADER_SIZE, 4);
+   bench_put_be(header + 12, 4, 4);
+   bench_put_be(header + 20, CHDCOMPRESSION_ZLIB, 4);
+   bench_put_be(header + 24, total_hunks, 4);
+   bench_put_be(header + 28, (uint64_t)total_hunks * BENCH_HUNKBYTES, 8);
+   bench_put_be(header + 36, meta_offset, 8);
+   bench_put_be(header + 44, BENCH_HUNKBYTES, 4);
+
+   if (fseek(fp, (long)offset, SEEK_SET) != 0)
+      goto end;
+
+   for (hunk = 0; hunk < total_hunks; hunk++)
+   {
+      uint32_t length;
+      uint8_t *entry = map + hunk * 16;
+      uint8_t type   = 1; /* compressed */
+
+      memset(raw, 0, BENCH_HUNKBYTES);
+      for (i = 0; i < CD_FRAMES_PER_HUNK; i++)
+         if (hunk * CD_FRAMES_PER_HUNK + i < frames)
+            bench_frame(hunk * CD_FRAMES_PER_HUNK + i,
+                  raw + i * CD_FRAME_SIZE);
+
+      deflateReset(&zs);
+      zs.next_in   = raw;
+      zs.avail_in  = BENCH_HUNKBYTES;
+      zs.next_out  = packed;
+      zs.avail_out = BENCH_HUNKBYTES;
+
+      if (deflate(&zs, Z_FINISH) == Z_STREAM_END
+            && zs.total_out < BENCH_HUNKBYTES)
+         length = (uint32_t)zs.total_out;
+      else
+      {
+         memcpy(packed, raw, BENCH_HUNKBYTES);
+         length = BENCH_HUNKBYTES;
+         type   = 2; /* uncompressed */
+      }
+
+      if (fwrite(packed, 1, length, fp) != length)
+         goto end;
+
+      bench_put_be(entry, offset, 8);
+      bench_put_be(entry + 12, length & 0xffff, 2);
+      entry[14] = (uint8_t)(length >> 16);
+      entry[15] = type | 0x10; /* no CRC */
+      offset   += length;
+   }
+
+   rewind(fp);
+   if (     fwrite(header, 1, sizeof(header), fp) != sizeof(header)
+         || fwrite(map, 16, total_hunks, fp) != total_hunks
+         || fwrite("EndOfListCookie", 1, 16, fp) != 16)
+      goto end;
+
+   offset = meta_offset;
+   for (i = 0; i < BENCH_TRACKS; i++)
+   {
+      uint8_t entry[16];
+      size_t length = strlen(meta[i]) + 1;
+
+      offset += 16 + length;
+      bench_put_be(entry,     CDROM_TRACK_METADATA2_TAG, 4);
+      bench_put_be(entry + 4, length, 4);
+      bench_put_be(entry + 8, i + 1 < BENCH_TRACKS ? offset : 0, 8);
+      if (     fwrite(entry, 1, sizeof(entry), fp) != sizeof(entry)
+            || fwrite(meta[i], 1, length, fp) != length)
+         goto end;
+   }
+
+   ok = true;
+
+end:
+   if (fp && fclose(fp) != 0)
+      ok = false;
+   deflateEnd(&zs);
+   free(map);
+   free(raw);
+   free(packed);
+   return ok;
+}
+
+static void bench_trace_push(bench_trace_t *trace, unsigned track,
+      uint64_t offset, uint32_t bytes)
+{
+   if (trace->count == trace->capacity)
+   {
+      trace->capacity = trace->capacity ? trace->capacity * 2 : 1024;
+      trace->ops      = (struct bench_op*)realloc(trace->ops,
+            trace->capacity * sizeof(*trace->ops));
+   }
+
+   trace->ops[trace->count].track  = track;
+   trace->ops[trace->count].offset = offset;
+   trace->ops[trace->count].bytes  = bytes;
+   trace->count++;
+}
+
+static void bench_trace_sectors(bench_trace_t *trace, unsigned track,
+      uint32_t sector, uint32_t count)
+{
+   while (count--)
+      bench_trace_push(trace, track, (uint64_t)sector++ * BENCH_SECTOR,
+            BENCH_SECTOR);
+}
+
+static void bench_trace_build(bench_trace_t *trace)
+{
+   unsigned i;
+   static const uint32_t file_start[] = { 100, 400, 900, 1500, 2200 };
+   static const uint32_t file_size[]  = { 150, 300, 200,  400,  250 };
+   uint32_t seed                      = 1;
+
+   /* Boot: volume descriptors and root directory, twice */
+   for (i = 0; i < 2; i++)
+      bench_trace_sectors(trace, 1, 16, 6);
+
+   /* Files looked up in the directory, then read in */
+   for (i = 0; i < sizeof(file_start) / sizeof(file_start[0]); i++)
+   {
+      bench_trace_sectors(trace, 1, 18, 2);
+      bench_trace_sectors(trace, 1, file_start[i], file_size[i]);
+   }
+
+   /* Video streamed next to CD audio */
+   for (i = 0; i < 800; i++)
+   {
+      bench_trace_sectors(trace, 1, 2600 + i, 1);
+      bench_trace_sectors(trace, 2, i, 1);
+   }
+
+   /* Level data read back and forth between two files */
+   for (i = 0; i < 40; i++)
+   {
+      seed = seed * 1103515245 + 12345;
+      bench_trace_sectors(trace, 1, 1000 + (seed >> 16) % 150, 12);
+      seed = seed * 1103515245 + 12345;
+      bench_trace_sectors(trace, 1, 3000 + (seed >> 16) % 300, 12);
+   }
+
+   /* Music from the last track while menus read small files */
+   for (i = 0; i < 600; i++)
+   {
+      bench_trace_sectors(trace, 3, i, 1);
+      if (i % 20 == 0)
+      {
+         bench_trace_sectors(trace, 1, 18, 1);
+         bench_trace_sectors(trace, 1, 50 + (i / 20) % 10, 1);
+      }
+   }
+}
+
+static bool bench_trace_load(bench_trace_t *trace, const char *path)
+{
+   char line[256];
+   FILE *fp = fopen(path, "r");
+
+   if (!fp)
+      return false;
+
+   while (fgets(line, sizeof(line), fp))
+   {
+      unsigned track;
+      unsigned long long offset;
+      unsigned bytes;
+
+      if (line[0] == '#')
+         continue;
+      if (sscanf(line, "%u %llu %u", &track, &offset, &bytes) == 3
+            && track >= 1 && track <= BENCH_TRACKS)
+         bench_trace_push(trace, track, offset, bytes);
+   }
+
+   fclose(fp);
+   return trace->count > 0;
+}
+
+static void bench_busy(unsigned usec)
+{
+   uint64_t end = bench_now_ns() + (uint64_t)usec * 1000;
+
+   while (bench_now_ns() < end);
+}
+
+struct bench_result
+{
+   uint64_t read_ns;
+   uint32_t checksum;
+   struct chdstream_cache_stats stats;
+};
+
+static bool bench_replay(const bench_trace_t *trace, unsigned pace,
+      struct bench_result *result)
+{
+   size_t i;
+   unsigned t;
+   chdstream_t *streams[BENCH_TRACKS];
+   uint8_t *buf     = NULL;
+   uint32_t max     = 0;
+
+   memset(result, 0, sizeof(*result));
+   result->checksum = 2166136261u;
+
+   for (i = 0; i < trace->count; i++)
+      if (trace->ops[i].bytes > max)
+         max = trace->ops[i].bytes;
+
+   for (t = 0; t < BENCH_TRACKS; t++)
+      TEST_CHECK(streams[t] = chdstream_open(BENCH_PATH, t + 1));
+   TEST_CHECK(buf = (uint8_t*)malloc(max));
+
+   for (i = 0; i < trace->count; i++)
+   {
+      uint32_t j;
+      ssize_t got;
+      const struct bench_op *op = &trace->ops[i];
+      uint64_t start            = bench_now_ns();
+
+      chdstream_seek(streams[op->track - 1], op->offset, SEEK_SET);
+      got              = chdstream_read(streams[op->track - 1],
+            buf, op->bytes);
+      result->read_ns += bench_now_ns() - start;
+
+      TEST_CHECK(got >= 0);
+      for (j = 0; j < (uint32_t)got; j++)
+         result->checksum = (result->checksum ^ buf[j]) * 16777619u;
+
+      if (pace)
+         bench_busy(pace);
+   }
+
+   chdstream_get_cache_stats(streams[0], &result->stats);
+
+   for (t = 0; t < BENCH_TRACKS; t++)
+      chdstream_close(streams[t]);
+   free(buf);
+
+   return true;
+}
+
+/* Sectors read back match what was written, audio byte
+ * swapped, and streams on one file share its cache */
+static bool bench_check(void)
+{
+   unsigned i;
+   uint8_t frame[CD_FRAME_SIZE];
+   uint8_t sector[BENCH_SECTOR];
+   struct chdstream_cache_stats before;
+   struct chdstream_cache_stats after;
+   chdstream_t *data  = NULL;
+   chdstream_t *again = NULL;
+   chdstream_t *audio = NULL;
+
+   chdstream_set_cache(16, 4);
+
+   TEST_CHECK(data = chdstream_open(BENCH_PATH, 1));
+   TEST_CHECK(audio = chdstream_open(BENCH_PATH, 2));
+   TEST_CHECK(chdstream_get_size(data)
+         == (ssize_t)bench_track_frames[0] * BENCH_SECTOR);
+
+   chdstream_seek(data, 123 * BENCH_SECTOR, SEEK_SET);
+   TEST_CHECK(chdstream_read(data, sector, sizeof(sector))
+         == sizeof(sector));
+   bench_frame(123, frame);
+   TEST_CHECK(!memcmp(sector, frame, sizeof(sector)));
+
+   chdstream_seek(audio, 5 * BENCH_SECTOR, SEEK_SET);
+   TEST_CHECK(chdstream_read(audio, sector, sizeof(sector))
+         == sizeof(sector));
+   bench_frame(bench_track_frames[0] + 5, frame);
+   for (i = 0; i < BENCH_SECTOR; i++)
+      TEST_CHECK(sector[i] == frame[i ^ 1]);
+
+   /* Another stream finds the hunk the first one loaded */
+   chdstream_get_cache_stats(data, &before);
+   TEST_CHECK(again = chdstream_open(BENCH_PATH, 1));
+   chdstream_seek(again, 123 * BENCH_SECTOR, SEEK_SET);
+   TEST_CHECK(chdstream_read(again, sector, sizeof(sector))
+         == sizeof(sector));
+   chdstream_get_cache_stats(data, &after);
+   TEST_CHECK(after.hits == before.hits + 1);
+   TEST_CHECK(after.misses == before.misses);
+
+   /* Reading on, read-ahead gets to the next hunks first */
+   for (i = 0; i < 64; i++)
+   {
+      TEST_CHECK(chdstream_read(again, sector, sizeof(sector))
+            == sizeof(sector));
+      bench_frame(124 + i, frame);
+      TEST_CHECK(!memcmp(sector, frame, sizeof(sector)));
+      bench_busy(200);
+   }
+   chdstream_get_cache_stats(data, &after);
+   TEST_CHECK((after.readahead > 0) ==
+         (cpu_features_get_core_amount() > 1));
+
+   chdstream_close(again);
+   chdstream_close(audio);
+   chdstream_close(data);
+
+   return true;
+}
+
+/* Reads a track 'chunk' bytes at a time, and gives the
+ * time it took and the CRC32 of what it read */
+static bool bench_scan(unsigned track, size_t chunk,
+      uint32_t *crc, uint64_t *ns)
+{
+   ssize_t got;
+   uint64_t start;
+   uint8_t *buf        = NULL;
+   chdstream_t *stream = NULL;
+
+   TEST_CHECK(buf = (uint8_t*)malloc(chunk));
+   TEST_CHECK(stream = chdstream_open(BENCH_PATH, track));
+
+   *crc  = crc32(0, NULL, 0);
+   start = bench_now_ns();
+   while ((got = chdstream_read(stream, buf, chunk)) > 0)
+      *crc = crc32(*crc, buf, (uInt)got);
+   *ns   = bench_now_ns() - start;
+
+   chdstream_close(stream);
+   free(buf);
+
+   TEST_CHECK(got == 0);
+   return true;
+}
+
+/* Large reads, decompressed on every core, give what reads
+ * a sector at a time through the cache do, on every track */
+static bool bench_decode(void)
+{
+   unsigned t;
+   uint32_t hunk;
+   uint32_t total;
+   uint64_t start;
+   uint64_t serial_ns;
+   uint64_t sector_ns = 0;
+   uint64_t chunk_ns  = 0;
+   const chd_header *hd = NULL;
+   chd_file *chd        = NULL;
+   uint8_t *serial      = NULL;
+
+   TEST_CHECK(chd_open(BENCH_PATH, CHD_OPEN_READ, NULL, &chd)
+         == CHDERR_NONE);
+   hd    = chd_get_header(chd);
+   total = hd->totalhunks;
+
+   TEST_CHECK(serial = (uint8_t*)malloc(hd->hunkbytes));
+
+   start     = bench_now_ns();
+   for (hunk = 0; hunk < total; hunk++)
+      TEST_CHECK(chd_read(chd, hunk, serial) == CHDERR_NONE);
+   serial_ns = bench_now_ns() - start;
+
+   free(serial);
+   chd_close(chd);
+
+   chdstream_set_cache(16, 0);
+   for (t = 1; t <= BENCH_TRACKS; t++)
+   {
+      uint64_t ns;
+      uint32_t sector_crc;
+      uint32_t chunk_crc;
+
+      TEST_CHECK(bench_scan(t, BENCH_SECTOR, &sector_crc, &ns));
+      sector_ns += ns;
+      TEST_CHECK(bench_scan(t, BENCH_SCAN_CHUNK, &chunk_crc, &ns));
+      chunk_ns  += ns;
+      TEST_CHECK(sector_crc == chunk_crc);
+   }
+
+   printf("\n%u hunks on %u core(s)\n\n", (unsigned)total,
+         cpu_features_get_core_amount());
+   printf("%-32s %10s\n", "decompress", "ms");
+   printf("%-32s %10.1f\n", "chd_read(), one hunk a call",
+         serial_ns / 1000000.0);
+   printf("%-32s %10.1f\n", "CRC scan, a sector a read",
+         sector_ns / 1000000.0);
+   printf("%-32s %10.1f\n", "CRC scan, 256 KB a read",
+         chunk_ns / 1000000.0);
+
+   return true;
+}
+
+int main(int argc, char *argv[])
+{
+   size_t i;
+   unsigned run;
+   unsigned pace;
+   bench_trace_t trace;
+   uint32_t checksum = 0;
+   bool ok           = true;
+
+   memset(&trace, 0, sizeof(trace));
+
+   if (argc > 1)
+   {
+      if (!bench_trace_load(&trace, argv[1]))
+      {
+         fprintf(stderr, "Could not read trace %s\n", argv[1]);
+         return 1;
+      }
+   }
+   else
+      bench_trace_build(&trace);
+
+   if (!bench_write_image(BENCH_PATH))
+   {
+      fprintf(stderr, "Could not write %s\n", BENCH_PATH);
+      return 1;
+   }
+
+   ok = bench_check();
+
+   printf("%u reads on %u core(s)\n\n", (unsigned)trace.count,
+         cpu_features_get_core_amount());
+   printf("%-20s %-6s %10s %8s %8s %10s\n", "cache", "paced",
+         "read ms", "hits", "misses", "readahead");
+
+   for (pace = 0; ok && pace <= BENCH_PACE; pace += BENCH_PACE)
+   {
+      for (i = 0; ok && i < sizeof(bench_configs) / sizeof(bench_configs[0]); i++)
+      {
+         struct bench_result best;
+
+         memset(&best, 0, sizeof(best));
+
+         chdstream_set_cache(bench_configs[i].hunks,
+               bench_configs[i].readahead);
+
+         for (run = 0; run < BENCH_RUNS; run++)
+         {
+            struct bench_result result;
+
+            if (!(ok = bench_replay(&trace, pace, &result)))
+               break;
+
+            /* Every configuration reads the same bytes */
+            if (!checksum)
+               checksum = result.checksum;
+            if (result.checksum != checksum)
+            {
+               fprintf(stderr, "%s: data differs\n", bench_configs[i].name);
+               ok = false;
+               break;
+            }
+
+            if (!run || result.read_ns < best.read_ns)
+               best = result;
+         }
+
+         if (ok)
+            printf("%-20s %-6s %10.1f %8llu %8llu %10llu\n",
+                  bench_configs[i].name, pace ? "yes" : "no",
+                  best.read_ns / 1000000.0,
+                  (unsigned long long)best.stats.hits,
+                  (unsigned long long)best.stats.misses,
+                  (unsigned long long)best.stats.readahead);
+      }
+   }
+
+   ok = ok && bench_decode();
+
+   remove(BENCH_PATH);
+   free(trace.ops);
+
+   printf("\n%s\n", ok ? "ok" : "FAILED");
+   return ok ? 0 : 1;
+}
@@ -0,0 +1,244 @@
+/* Copyright  (C) 2010-2020 The RetroArch team
+ *
+ * ---------------------------------------------------------------------------------------
+ * The following license statement only applies to this file (interface_stream_test.c).
+ * ---------------------------------------------------------------------------------------
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/* Checks the CRC32 intfstream_get_crc_range() streams through its
+ * chunk buffer against one computed over the whole range in memory,
+ * for file and memory streams, with ranges starting and ending on
+ * either side of chunk boundaries and running past the end. Then
+ * checks that a stream over a range of a file reads, seeks and
+ * hashes as if the range were the whole file. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <encodings/crc32.h>
+#include <streams/file_stream.h>
+#include <streams/interface_stream.h>
+
+#define TEST_CHECK(cond) \
+   do \
+   { \
+      if (!(cond)) \
+      { \
+         fprintf(stderr, "%s:%d: check failed: %s\n", \
+               __FILE__, __LINE__, #cond); \
+         return false; \
+      } \
+   } while (0)
+
+#define TEST_PATH  "interface_stream_test.bin"
+#define TEST_CHUNK INTFSTREAM_CRC_CHUNK_SIZE
+#define TEST_SIZE  (3 * TEST_CHUNK + 1234)
+
+struct test_range
+{
+   uint64_t offset;
+   uint64_t len;
+};
+
+static const struct test_range test_ranges[] = {
+   { 0,              0                  },
+   { 0,              1                  },
+   { 0,              TEST_CHUNK - 1     },
+   { 0,              TEST_CHUNK         },
+   { 0,              TEST_CHUNK + 1     },
+   { 17,             2 * TEST_CHUNK     },
+   { TEST_CHUNK - 1, TEST_CHUNK + 2     },
+   { 0,              TEST_SIZE          },
+   /* Past the end: hashing stops there */
+   { 1000,           TEST_SIZE          },
+   { TEST_SIZE - 5,  ~(uint64_t)0       },
+   { TEST_SIZE,      100                },
+};
+
+static uint8_t *test_data;
+
+static uint32_t test_expected(const struct test_range *range)
+{
+   uint64_t len = range->len;
+
+   if (range->offset >= TEST_SIZE)
+      return 0;
+   if (len > TEST_SIZE - range->offset)
+      len = TEST_SIZE - range->offset;
+
+   return encoding_crc32(0, test_data + range->offset, (size_t)len);
+}
+
+static bool test_ranges_of(intfstream_t *stream)
+{
+   size_t i;
+   uint32_t crc;
+
+   for (i = 0; i < sizeof(test_ranges) / sizeof(test_ranges[0]); i++)
+   {
+      crc = 0xdeadbeef;
+      TEST_CHECK(intfstream_get_crc_range(stream,
+               test_ranges[i].offset, test_ranges[i].len, &crc));
+      TEST_CHECK(crc == test_expected(&test_ranges[i]));
+   }
+
+   /* The whole stream, which leaves it rewound */
+   intfstream_seek(stream, 4321, SEEK_SET);
+   TEST_CHECK(intfstream_get_crc(stream, &crc));
+   TEST_CHECK(crc == encoding_crc32(0, test_data, TEST_SIZE));
+   TEST_CHECK(intfstream_tell(stream) == 0);
+
+   return true;
+}
+
+static bool test_file(void)
+{
+   bool ok;
+   intfstream_t *stream = NULL;
+
+   TEST_CHECK(filestream_write_file(TEST_PATH, test_data, TEST_SIZE));
+   TEST_CHECK(stream = intfstream_open_file(TEST_PATH,
+            RETRO_VFS_FILE_ACCESS_READ, RETRO_VFS_FILE_ACCESS_HINT_NONE));
+
+   ok = test_ranges_of(stream);
+
+   intfstream_close(stream);
+   free(stream);
+   filestream_delete(TEST_PATH);
+   return ok;
+}
+
+static bool test_file_range(void)
+{
+   uint8_t buf[16];
+   uint32_t crc;
+   bool ok                = false;
+   const uint64_t start   = 1000;
+   const uint64_t size    = 2 * TEST_CHUNK + 7;
+   intfstream_t *stream   = NULL;
+   intfstream_t *tail     = NULL;
+
+   TEST_CHECK(filestream_write_file(TEST_PATH, test_data, TEST_SIZE));
+   stream = intfstream_open_file_range(TEST_PATH,
+         RETRO_VFS_FILE_ACCESS_READ, RETRO_VFS_FILE_ACCESS_HINT_NONE,
+         start, size);
+   tail   = intfstream_open_file_range(TEST_PATH,
+         RETRO_VFS_FILE_ACCESS_READ, RETRO_VFS_FILE_ACCESS_HINT_NONE,
+         TEST_SIZE - 5, ~(uint64_t)0);
+   if (!stream || !tail)
+      goto end;
+
+   if (     intfstream_get_size(stream) != (int64_t)size
+         || intfstream_tell(stream) != 0
+         || intfstream_read(stream, buf, 4) != 4
+         || memcmp(buf, test_data + start, 4)
+         /* Reads stop at the end of the range */
+         || intfstream_seek(stream, -3, SEEK_END) == -1
+         || intfstream_tell(stream) != (int64_t)size - 3
+         || intfstream_read(stream, buf, sizeof(buf)) != 3
+         || memcmp(buf, test_data + start + size - 3, 3)
+         || intfstream_read(stream, buf, sizeof(buf)) != 0
+         || intfstream_getc(stream) != EOF
+         || !intfstream_eof(stream)
+         /* Nothing before it can be reached */
+         || intfstream_seek(stream, -1, SEEK_SET) != -1
+         || !intfstream_get_crc(stream, &crc)
+         || crc != encoding_crc32(0, test_data + start, (size_t)size)
+         || intfstream_tell(stream) != 0
+         || intfstream_getc(stream) != test_data[start]
+         /* A range running past the end is cut short there */
+         || intfstream_get_size(tail) != 5
+         || !intfstream_get_crc(tail, &crc)
+         || crc != encoding_crc32(0, test_data + TEST_SIZE - 5, 5))
+   {
+      fprintf(stderr, "%s:%d: check failed: file range\n",
+            __FILE__, __LINE__);
+      goto end;
+   }
+
+   ok = !intfstream_open_file_range(TEST_PATH,
+         RETRO_VFS_FILE_ACCESS_READ, RETRO_VFS_FILE_ACCESS_HINT_NONE,
+         TEST_SIZE + 1, 1);
+   if (!ok)
+      fprintf(stderr, "%s:%d: check failed: range past the end\n",
+            __FILE__, __LINE__);
+
+end:
+   intfstream_close(stream);
+   free(stream);
+   intfstream_close(tail);
+   free(tail);
+   filestream_delete(TEST_PATH);
+   return ok;
+}
+
+static bool test_memory(void)
+{
+   bool ok;
+   intfstream_t *stream = NULL;
+
+   TEST_CHECK(stream = intfstream_open_memory(test_data,
+            RETRO_VFS_FILE_ACCESS_READ, RETRO_VFS_FILE_ACCESS_HINT_NONE,
+            TEST_SIZE));
+
+   ok = test_ranges_of(stream);
+
+   intfstream_close(stream);
+   free(stream);
+   return ok;
+}
+
+static bool test_errors(void)
+{
+   uint32_t crc = 0;
+
+   TEST_CHECK(!intfstream_get_crc_range(NULL, 0, 1, &crc));
+   TEST_CHECK(!intfstream_get_crc(NULL, &crc));
+   TEST_CHECK(!intfstream_open_file(TEST_PATH ".missing",
+            RETRO_VFS_FILE_ACCESS_READ, RETRO_VFS_FILE_ACCESS_HINT_NONE));
+
+   return true;
+}
+
+int main(int argc, char *argv[])
+{
+   size_t i;
+   bool ok         = true;
+   uint32_t seed   = 1;
+
+   test_data = (uint8_t*)malloc(TEST_SIZE);
+   if (!test_data)
+      return 1;
+
+   for (i = 0; i < TEST_SIZE; i++)
+   {
+      seed         = seed * 1103515245 + 12345;
+      test_data[i] = (uint8_t)(seed >> 16);
+   }
+
+   ok = test_file()       && ok;
+   ok = test_file_range() && ok;
+   ok = test_memory()     && ok;
+   ok = test_errors() && ok;
+
+   free(test_data);
+
+   printf("%s\n", ok ? "ok" : "FAILED");
+   return ok ? 0 : 1;
+}
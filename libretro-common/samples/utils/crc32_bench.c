@@ -0,0 +1,178 @@
+/* Copyright  (C) 2010-2020 The RetroArch team
+ *
+ * ---------------------------------------------------------------------------------------
+ * The following license statement only applies to this file (crc32_bench.c).
+ * ---------------------------------------------------------------------------------------
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/* Cross-checks every CRC32 implementation supported by this CPU
+ * against a bit-at-a-time reference over assorted lengths, offsets
+ * and seeds, then reports the throughput of each one.
+ *
+ * Usage: crc32_bench [buffer MB] [passes]
+ * Returns non-zero if any implementation disagrees. */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <encodings/crc32.h>
+#include <features/features_cpu.h>
+
+static uint32_t crc32_reference(uint32_t crc, const uint8_t *buf, size_t len)
+{
+   crc = ~crc;
+
+   while (len--)
+   {
+      unsigned k;
+      crc ^= *buf++;
+      for (k = 0; k < 8; k++)
+         crc = (crc >> 1) ^ (0xedb88320 & (0 - (crc & 1)));
+   }
+
+   return ~crc;
+}
+
+static int crc32_cross_check(const uint8_t *data, size_t size)
+{
+   unsigned impl;
+   int failures = 0;
+   static const size_t lengths[] = {
+      0, 1, 3, 7, 8, 15, 16, 17, 31, 63, 64, 65, 127, 128,
+      129, 255, 256, 1000, 4095, 4096, 4097, 65536 + 13
+   };
+
+   for (impl = 0; impl < ENCODING_CRC32_IMPL_LAST; impl++)
+   {
+      size_t i, offset;
+
+      if (!encoding_crc32_impl_supported((enum encoding_crc32_impl)impl))
+         continue;
+
+      for (i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++)
+      {
+         for (offset = 0; offset < 16; offset++)
+         {
+            size_t len        = lengths[i];
+            uint32_t seed     = (uint32_t)(i * 0x9e3779b9u + offset);
+            uint32_t expected, got, split;
+
+            if (offset + len > size)
+               continue;
+
+            expected = crc32_reference(seed, data + offset, len);
+            got      = encoding_crc32_with_impl(
+                  (enum encoding_crc32_impl)impl, seed, data + offset, len);
+
+            /* Chained calls must match a single call */
+            split    = encoding_crc32_with_impl(
+                  (enum encoding_crc32_impl)impl, seed, data + offset, len / 3);
+            split    = encoding_crc32_with_impl(
+                  (enum encoding_crc32_impl)impl, split,
+                  data + offset + len / 3, len - len / 3);
+
+            if (got != expected || split != expected)
+            {
+               fprintf(stderr, "%s: mismatch (len %u, offset %u): "
+                     "%08x / %08x, expected %08x\n",
+                     encoding_crc32_impl_name((enum encoding_crc32_impl)impl),
+                     (unsigned)len, (unsigned)offset,
+                     got, split, expected);
+               failures++;
+            }
+         }
+      }
+   }
+
+   if (encoding_crc32(0, data, size) != crc32_reference(0, data, size))
+   {
+      fprintf(stderr, "encoding_crc32: mismatch on full buffer\n");
+      failures++;
+   }
+
+   /* Check value from the CRC32 catalogue */
+   if (encoding_crc32(0, (const uint8_t*)"123456789", 9) != 0xcbf43926)
+   {
+      fprintf(stderr, "encoding_crc32: wrong check value\n");
+      failures++;
+   }
+
+   return failures;
+}
+
+int main(int argc, char *argv[])
+{
+   unsigned impl;
+   size_t i;
+   uint8_t *data;
+   uint32_t state     = 0x12345678;
+   unsigned megabytes = argc > 1 ? (unsigned)strtoul(argv[1], NULL, 0) : 64;
+   unsigned passes    = argc > 2 ? (unsigned)strtoul(argv[2], NULL, 0) : 4;
+   size_t size        = (size_t)megabytes * 1024 * 1024;
+
+   if (size < 65536 + 64)
+      size = 65536 + 64;
+
+   data = (uint8_t*)malloc(size);
+   if (!data)
+      return 1;
+
+   for (i = 0; i < size; i++)
+   {
+      state   = state * 1664525 + 1013904223;
+      data[i] = (uint8_t)(state >> 24);
+   }
+
+   if (crc32_cross_check(data, size) != 0)
+   {
+      free(data);
+      return 1;
+   }
+
+   printf("cross-check: OK\n");
+
+   for (impl = 0; impl < ENCODING_CRC32_IMPL_LAST; impl++)
+   {
+      unsigned pass;
+      retro_time_t start, elapsed;
+      uint32_t crc = 0;
+
+      if (!encoding_crc32_impl_supported((enum encoding_crc32_impl)impl))
+      {
+         printf("%-12s: not supported\n",
+               encoding_crc32_impl_name((enum encoding_crc32_impl)impl));
+         continue;
+      }
+
+      start = cpu_features_get_time_usec();
+      for (pass = 0; pass < passes; pass++)
+         crc = encoding_crc32_with_impl((enum encoding_crc32_impl)impl,
+               crc, data, size);
+      elapsed = cpu_features_get_time_usec() - start;
+
+      if (elapsed <= 0)
+         elapsed = 1;
+
+      printf("%-12s: %7.3f GB/s (%08x)\n",
+            encoding_crc32_impl_name((enum encoding_crc32_impl)impl),
+            ((double)size * passes / 1e9) / (elapsed / 1e6), crc);
+   }
+
+   free(data);
+   return 0;
+}
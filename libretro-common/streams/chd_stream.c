@@ -31,12 +31,91 @@
 #include <libchdr/chd.h>
 #include <string/stdstring.h>
 
+#ifdef HAVE_THREADS
+#include <rthreads/rthreads.h>
+#include <rthreads/tpool.h>
+#include <features/features_cpu.h>
+#endif
+
 #define SECTOR_SIZE 2352
 #define SUBCODE_SIZE 96
 #define TRACK_PAD 4
 
+#define CHDSTREAM_MAX_CACHE_HUNKS 256
+
+/* Reads spanning this many hunks decompress them together,
+ * on every core, up to CHDSTREAM_BULK_HUNKS at a time */
+#define CHDSTREAM_BULK_MIN_HUNKS 4
+#define CHDSTREAM_BULK_HUNKS 32
+
+/* Most pool threads helping the reader with a long read */
+#define CHDSTREAM_MAX_WORKERS 7
+
+/* A decompressed hunk kept by the cache of a CHD file */
+typedef struct chdstream_slot
+{
+   uint8_t *mem;
+   /* Cached hunk number, or -1 */
+   int32_t hunknum;
+   /* Clock at last use; the smallest is evicted first */
+   uint32_t used;
+   /* Being decompressed, with the cache unlocked */
+   bool loading;
+} chdstream_slot_t;
+
+/* An open CHD file, shared by all streams open on its tracks */
+typedef struct chdstream_file
+{
+   struct chdstream_file *next;
+   char *path;
+   chd_file *chd;
+   chdstream_slot_t *slots;
+   unsigned num_slots;
+   unsigned refcount;
+   uint32_t clock;
+   struct chdstream_cache_stats stats;
+#ifdef HAVE_THREADS
+   /* Guards the cache; 'chd' has a lock of its own,
+    * since libchdr reads one hunk at a time */
+   slock_t *lock;
+   slock_t *chd_lock;
+   /* Broadcast when a hunk is loaded or read-ahead is asked for */
+   scond_t *cond;
+   sthread_t *thread;
+   unsigned readahead;
+   /* Hunks still to read ahead are [ahead_next, ahead_end) */
+   uint32_t ahead_next;
+   uint32_t ahead_end;
+   /* Readers decompressing a hunk, which read-ahead waits for */
+   unsigned demand;
+   bool quit;
+   /* Handles of the pool threads on this file, opened when a
+    * long read first needs them; 'bulk_lock' lets one long
+    * read at a time use them */
+   chd_file *workers[CHDSTREAM_MAX_WORKERS];
+   slock_t *bulk_lock;
+#endif
+} chdstream_file_t;
+
+#ifdef HAVE_THREADS
+/* Part of a long read, decompressed by a pool thread */
+typedef struct chdstream_job
+{
+   chdstream_file_t *file;
+   chd_file *chd;
+   uint8_t *out;
+   uint32_t hunknum;
+   uint32_t count;
+   uint32_t hunkbytes;
+   bool ok;
+   /* Set with the cache locked, then 'cond' is broadcast */
+   bool done;
+} chdstream_job_t;
+#endif
+
 struct chdstream
 {
+   chdstream_file_t *file;
    chd_file *chd;
    /* Should we swap bytes? */
    bool swab;
@@ -56,8 +135,17 @@ struct chdstream
    size_t offset;
    /* Loaded hunk number */
    int32_t hunknum;
-   /* Loaded hunk */
+   /* Hunks loaded in a row, each one after the last */
+   uint32_t run;
+   /* Loaded hunk, copied out of the cache */
    uint8_t *hunkmem;
+   /* Hunks decompressed together for a long read,
+    * [bulk_first, bulk_first + bulk_count) */
+   uint8_t *bulk;
+   uint32_t bulk_first;
+   uint32_t bulk_count;
+   /* Loaded hunk; points into 'hunkmem' or 'bulk' */
+   const uint8_t *data;
 };
 
 typedef struct metadata
@@ -75,13 +163,54 @@ typedef struct metadata
    uint32_t track;
 } metadata_t;
 
+static unsigned chdstream_cache_hunks     = 16;
+static unsigned chdstream_readahead_hunks = 4;
+
+/* CHD files open, looked up by path */
+static chdstream_file_t *chdstream_files  = NULL;
+#ifdef HAVE_THREADS
+static slock_t *chdstream_files_lock      = NULL;
+/* Threads shared by long reads on every file; made on the
+ * first one, and gone with the last file */
+static tpool_t *chdstream_pool            = NULL;
+static unsigned chdstream_pool_threads    = 0;
+#endif
+
 static uint32_t padding_frames(uint32_t frames)
 {
    return ((frames + TRACK_PAD - 1) & ~(TRACK_PAD - 1)) - frames;
 }
 
+static void chdstream_file_lock(chdstream_file_t *file)
+{
+#ifdef HAVE_THREADS
+   slock_lock(file->lock);
+#endif
+}
+
+static void chdstream_file_unlock(chdstream_file_t *file)
+{
+#ifdef HAVE_THREADS
+   slock_unlock(file->lock);
+#endif
+}
+
+static void chdstream_chd_lock(chdstream_file_t *file)
+{
+#ifdef HAVE_THREADS
+   slock_lock(file->chd_lock);
+#endif
+}
+
+static void chdstream_chd_unlock(chdstream_file_t *file)
+{
+#ifdef HAVE_THREADS
+   slock_unlock(file->chd_lock);
+#endif
+}
+
 static bool
-chdstream_get_meta(chd_file *chd, int idx, metadata_t *md)
+chdstream_get_meta_locked(chd_file *chd, int idx, metadata_t *md)
 {
    char meta[256];
    uint32_t meta_size = 0;
@@ -130,7 +259,20 @@ chdstream_get_meta(chd_file *chd, int idx, metadata_t *md)
 }
 
 static bool
-chdstream_find_track_number(chd_file *fd, int32_t track, metadata_t *meta)
+chdstream_get_meta(chdstream_file_t *file, int idx, metadata_t *md)
+{
+   bool ret;
+
+   chdstream_chd_lock(file);
+   ret = chdstream_get_meta_locked(file->chd, idx, md);
+   chdstream_chd_unlock(file);
+
+   return ret;
+}
+
+static bool
+chdstream_find_track_number(chdstream_file_t *fd, int32_t track,
+      metadata_t *meta)
 {
    uint32_t i;
    uint32_t frame_offset = 0;
@@ -151,7 +293,8 @@ chdstream_find_track_number(chd_file *fd, int32_t track, metadata_t *meta)
 }
 
 static bool
-chdstream_find_special_track(chd_file *fd, int32_t track, metadata_t *meta)
+chdstream_find_special_track(chdstream_file_t *fd, int32_t track,
+      metadata_t *meta)
 {
    int32_t i;
    metadata_t iter;
@@ -197,13 +340,347 @@ chdstream_find_special_track(chd_file *fd, int32_t track, metadata_t *meta)
 }
 
 static bool
-chdstream_find_track(chd_file *fd, int32_t track, metadata_t *meta)
+chdstream_find_track(chdstream_file_t *fd, int32_t track, metadata_t *meta)
 {
    if (track < 0)
       return chdstream_find_special_track(fd, track, meta);
    return chdstream_find_track_number(fd, track, meta);
 }
 
+static void chdstream_file_free(chdstream_file_t *file)
+{
+   unsigned i;
+
+#ifdef HAVE_THREADS
+   if (file->thread)
+   {
+      slock_lock(file->lock);
+      file->quit = true;
+      scond_broadcast(file->cond);
+      slock_unlock(file->lock);
+      sthread_join(file->thread);
+   }
+
+   for (i = 0; i < CHDSTREAM_MAX_WORKERS; i++)
+      if (file->workers[i])
+         chd_close(file->workers[i]);
+
+   if (file->bulk_lock)
+      slock_free(file->bulk_lock);
+   if (file->cond)
+      scond_free(file->cond);
+   if (file->chd_lock)
+      slock_free(file->chd_lock);
+   if (file->lock)
+      slock_free(file->lock);
+#endif
+
+   if (file->slots)
+   {
+      for (i = 0; i < file->num_slots; i++)
+         free(file->slots[i].mem);
+      free(file->slots);
+   }
+
+   if (file->chd)
+      chd_close(file->chd);
+   free(file->path);
+   free(file);
+}
+
+static chdstream_file_t *chdstream_file_new(const char *path)
+{
+   unsigned i;
+   const chd_header *hd   = NULL;
+   chdstream_file_t *file = (chdstream_file_t*)calloc(1, sizeof(*file));
+
+   if (!file)
+      return NULL;
+
+   file->refcount  = 1;
+   file->path      = strdup(path);
+   file->num_slots = chdstream_cache_hunks;
+
+   if (!file->path || chd_open(path, CHD_OPEN_READ, NULL, &file->chd)
+         != CHDERR_NONE)
+      goto error;
+
+   hd              = chd_get_header(file->chd);
+   file->slots     = (chdstream_slot_t*)calloc(file->num_slots,
+         sizeof(*file->slots));
+   if (!file->slots)
+      goto error;
+
+   for (i = 0; i < file->num_slots; i++)
+   {
+      file->slots[i].hunknum = -1;
+      if (!(file->slots[i].mem = (uint8_t*)malloc(hd->hunkbytes)))
+         goto error;
+   }
+
+#ifdef HAVE_THREADS
+   /* Read-ahead must leave room for the hunks being read,
+    * and only pays with a core to spare */
+   file->readahead = chdstream_readahead_hunks;
+   if (file->readahead > file->num_slots / 2)
+      file->readahead = file->num_slots / 2;
+   if (cpu_features_get_core_amount() < 2)
+      file->readahead = 0;
+
+   if (  !(file->lock      = slock_new())
+      || !(file->chd_lock  = slock_new())
+      || !(file->bulk_lock = slock_new())
+      || !(file->cond      = scond_new()))
+      goto error;
+#endif
+
+   return file;
+
+error:
+   chdstream_file_free(file);
+   return NULL;
+}
+
+/* Opens 'path', or takes another reference
+ * to it if a stream has it open already */
+static chdstream_file_t *chdstream_file_open(const char *path)
+{
+   chdstream_file_t *file = NULL;
+
+#ifdef HAVE_THREADS
+   if (!chdstream_files_lock)
+      chdstream_files_lock = slock_new();
+   slock_lock(chdstream_files_lock);
+#endif
+
+   for (file = chdstream_files; file; file = file->next)
+   {
+      if (string_is_equal(file->path, path))
+      {
+         file->refcount++;
+         break;
+      }
+   }
+
+   if (!file && (file = chdstream_file_new(path)))
+   {
+      file->next      = chdstream_files;
+      chdstream_files = file;
+   }
+
+#ifdef HAVE_THREADS
+   slock_unlock(chdstream_files_lock);
+#endif
+
+   return file;
+}
+
+static void chdstream_file_close(chdstream_file_t *file)
+{
+   chdstream_file_t **link;
+   bool last = false;
+
+#ifdef HAVE_THREADS
+   slock_lock(chdstream_files_lock);
+#endif
+
+   if (--file->refcount == 0)
+   {
+      for (link = &chdstream_files; *link; link = &(*link)->next)
+      {
+         if (*link == file)
+         {
+            *link = file->next;
+            break;
+         }
+      }
+      last = true;
+   }
+
+#ifdef HAVE_THREADS
+   /* With no file open, no long read can be using the pool */
+   if (!chdstream_files && chdstream_pool)
+   {
+      tpool_destroy(chdstream_pool);
+      chdstream_pool = NULL;
+   }
+
+   slock_unlock(chdstream_files_lock);
+#endif
+
+   if (last)
+      chdstream_file_free(file);
+}
+
+static chdstream_slot_t *chdstream_file_find(chdstream_file_t *file,
+      uint32_t hunknum)
+{
+   unsigned i;
+
+   for (i = 0; i < file->num_slots; i++)
+      if (file->slots[i].hunknum == (int32_t)hunknum)
+         return &file->slots[i];
+
+   return NULL;
+}
+
+/* Least recently used slot not being loaded, if any */
+static chdstream_slot_t *chdstream_file_evict(chdstream_file_t *file)
+{
+   unsigned i;
+   chdstream_slot_t *victim = NULL;
+
+   for (i = 0; i < file->num_slots; i++)
+   {
+      chdstream_slot_t *slot = &file->slots[i];
+
+      if (slot->loading)
+         continue;
+      if (slot->hunknum < 0)
+         return slot;
+      if (!victim || (int32_t)(slot->used - victim->used) < 0)
+         victim = slot;
+   }
+
+   return victim;
+}
+
+#ifdef HAVE_THREADS
+static void chdstream_readahead_thread(void *data)
+{
+   chdstream_file_t *file = (chdstream_file_t*)data;
+
+   slock_lock(file->lock);
+
+   while (!file->quit)
+   {
+      bool ok;
+      uint32_t hunknum;
+      chdstream_slot_t *slot = NULL;
+
+      if (file->demand || file->ahead_next >= file->ahead_end)
+      {
+         scond_wait(file->cond, file->lock);
+         continue;
+      }
+
+      hunknum = file->ahead_next++;
+      if (chdstream_file_find(file, hunknum))
+         continue;
+      if (!(slot = chdstream_file_evict(file)))
+         continue;
+
+      slot->hunknum = hunknum;
+      slot->loading = true;
+      file->stats.readahead++;
+      slock_unlock(file->lock);
+
+      slock_lock(file->chd_lock);
+      ok = chd_read(file->chd, hunknum, slot->mem) == CHDERR_NONE;
+      slock_unlock(file->chd_lock);
+
+      slock_lock(file->lock);
+      slot->loading = false;
+      if (ok)
+         slot->used    = ++file->clock;
+      else
+         slot->hunknum = -1;
+      scond_broadcast(file->cond);
+   }
+
+   slock_unlock(file->lock);
+}
+
+/* Asks for up to 'count' hunks after 'hunknum' to be
+ * decompressed in the background. Call with the cache locked. */
+static void chdstream_file_read_ahead(chdstream_file_t *file,
+      uint32_t hunknum, uint32_t count)
+{
+   uint32_t total = chd_get_header(file->chd)->totalhunks;
+   uint32_t end;
+
+   if (count > file->readahead)
+      count = file->readahead;
+   if (!count)
+      return;
+
+   end            = hunknum + 1 + count;
+   if (end > total)
+      end = total;
+
+   /* Carry on from where read-ahead got to, unless
+    * the reader has left that window */
+   if (file->ahead_next <= hunknum || file->ahead_next > end)
+      file->ahead_next = hunknum + 1;
+   file->ahead_end     = end;
+
+   if (!file->thread)
+      file->thread     = sthread_create(chdstream_readahead_thread, file);
+
+   scond_broadcast(file->cond);
+}
+
+static void chdstream_job_run(void *data)
+{
+   uint32_t i;
+   bool ok              = true;
+   chdstream_job_t *job = (chdstream_job_t*)data;
+
+   for (i = 0; ok && i < job->count; i++)
+      ok = chd_read(job->chd, job->hunknum + i,
+            job->out + (size_t)i * job->hunkbytes) == CHDERR_NONE;
+
+   slock_lock(job->file->lock);
+   job->ok   = ok;
+   job->done = true;
+   scond_broadcast(job->file->cond);
+   slock_unlock(job->file->lock);
+}
+
+/* The pool long reads share, made if there is a core to spare
+ * next to the reader. Gives how many threads it has. */
+static tpool_t *chdstream_pool_get(unsigned *threads)
+{
+   tpool_t *pool;
+
+   slock_lock(chdstream_files_lock);
+
+   if (!chdstream_pool)
+   {
+      unsigned cores         = cpu_features_get_core_amount();
+
+      chdstream_pool_threads = cores > 1 ? cores - 1 : 0;
+      if (chdstream_pool_threads > CHDSTREAM_MAX_WORKERS)
+         chdstream_pool_threads = CHDSTREAM_MAX_WORKERS;
+      if (chdstream_pool_threads)
+         chdstream_pool      = tpool_create(chdstream_pool_threads);
+   }
+
+   pool     = chdstream_pool;
+   *threads = pool ? chdstream_pool_threads : 0;
+
+   slock_unlock(chdstream_files_lock);
+
+   return pool;
+}
+#endif
+
+void chdstream_set_cache(unsigned hunks, unsigned readahead)
+{
+   if (hunks < 1)
+      hunks = 1;
+   else if (hunks > CHDSTREAM_MAX_CACHE_HUNKS)
+      hunks = CHDSTREAM_MAX_CACHE_HUNKS;
+
+   chdstream_cache_hunks     = hunks;
+   chdstream_readahead_hunks = readahead;
+
+#ifdef HAVE_THREADS
+   if (!chdstream_files_lock)
+      chdstream_files_lock   = slock_new();
+#endif
+}
+
 chdstream_t *chdstream_open(const char *path, int32_t track)
 {
    metadata_t meta;
@@ -211,19 +688,19 @@ chdstream_t *chdstream_open(const char *path, int32_t track)
    uint8_t *hunkmem        = NULL;
    const chd_header *hd    = NULL;
    chdstream_t *stream     = NULL;
-   chd_file *chd           = NULL;
-   chd_error err           = chd_open(path, CHD_OPEN_READ, NULL, &chd);
+   chdstream_file_t *file  = chdstream_file_open(path);
 
-   if (err != CHDERR_NONE)
+   if (!file)
       return NULL;
 
-   if (!chdstream_find_track(chd, track, &meta))
+   if (!chdstream_find_track(file, track, &meta))
       goto error;
 
    stream                  = (chdstream_t*)malloc(sizeof(*stream));
    if (!stream)
       goto error;
 
+   stream->file            = NULL;
    stream->chd             = NULL;
    stream->swab            = false;
    stream->frame_size      = 0;
@@ -235,8 +712,13 @@ chdstream_t *chdstream_open(const char *path, int32_t track)
    stream->offset          = 0;
    stream->hunkmem         = NULL;
    stream->hunknum         = -1;
+   stream->run             = 0;
+   stream->bulk            = NULL;
+   stream->bulk_first      = 0;
+   stream->bulk_count      = 0;
+   stream->data            = NULL;
 
-   hd                      = chd_get_header(chd);
+   hd                      = chd_get_header(file->chd);
    hunkmem                 = (uint8_t*)malloc(hd->hunkbytes);
    if (!hunkmem)
       goto error;
@@ -259,7 +741,8 @@ chdstream_t *chdstream_open(const char *path, int32_t track)
    if (meta.pgtype[0] != 'V')
       pregap               = meta.pregap;
 
-   stream->chd             = chd;
+   stream->file            = file;
+   stream->chd             = file->chd;
    stream->frames_per_hunk = hd->hunkbytes / hd->unitbytes;
    stream->track_frame     = meta.frame_offset;
    stream->track_start     = (size_t)pregap * stream->frame_size;
@@ -271,9 +754,7 @@ chdstream_t *chdstream_open(const char *path, int32_t track)
 error:
 
    chdstream_close(stream);
-
-   if (chd)
-      chd_close(chd);
+   chdstream_file_close(file);
 
    return NULL;
 }
@@ -285,31 +766,243 @@ void chdstream_close(chdstream_t *stream)
 
    if (stream->hunkmem)
       free(stream->hunkmem);
-   if (stream->chd)
-      chd_close(stream->chd);
+   if (stream->bulk)
+      free(stream->bulk);
+   if (stream->file)
+      chdstream_file_close(stream->file);
    free(stream);
 }
 
+void chdstream_get_cache_stats(chdstream_t *stream,
+      struct chdstream_cache_stats *stats)
+{
+   chdstream_file_lock(stream->file);
+   *stats = stream->file->stats;
+   chdstream_file_unlock(stream->file);
+}
+
+static void chdstream_swab(uint8_t *mem, size_t bytes)
+{
+   size_t i;
+   size_t count    = bytes / 2;
+   uint16_t *array = (uint16_t*)mem;
+   for (i = 0; i < count; ++i)
+      array[i] = SWAP16(array[i]);
+}
+
+/* Decompresses 'count' hunks from 'hunknum' on, split in parts
+ * between the reader and the pool threads, so that long reads
+ * use every core. A chd_file reads one hunk at a time, so each
+ * thread reads its part with a handle of its own. The hunks
+ * skip the shared cache, which they would only flush. */
 static bool
-chdstream_load_hunk(chdstream_t *stream, uint32_t hunknum)
+chdstream_load_bulk(chdstream_t *stream, uint32_t hunknum, uint32_t count)
 {
-   uint16_t *array;
+   uint32_t i;
+   bool ok                 = true;
+   unsigned parts          = 1;
+   chdstream_file_t *file  = stream->file;
+   uint32_t hunkbytes      = chd_get_header(stream->chd)->hunkbytes;
+#ifdef HAVE_THREADS
+   chdstream_job_t jobs[CHDSTREAM_MAX_WORKERS];
+   unsigned threads        = 0;
+   tpool_t *pool           = chdstream_pool_get(&threads);
+#endif
+
+   if (count > CHDSTREAM_BULK_HUNKS)
+      count = CHDSTREAM_BULK_HUNKS;
+
+   stream->bulk_count      = 0;
+   if (!stream->bulk)
+   {
+      stream->bulk = (uint8_t*)malloc((size_t)CHDSTREAM_BULK_HUNKS * hunkbytes);
+      if (!stream->bulk)
+         return false;
+   }
 
-   if (hunknum == stream->hunknum)
-      return true;
+#ifdef HAVE_THREADS
+   slock_lock(file->bulk_lock);
+
+   /* A part for each pool thread with a handle, and one for
+    * the reader, which goes on with the one it has */
+   for (; parts <= threads && parts < count; parts++)
+   {
+      chd_file **worker = &file->workers[parts - 1];
 
-   if (chd_read(stream->chd, hunknum, stream->hunkmem) != CHDERR_NONE)
+      if (!*worker && chd_open(file->path, CHD_OPEN_READ, NULL, worker)
+            != CHDERR_NONE)
+      {
+         *worker = NULL;
+         break;
+      }
+   }
+
+   for (i = 1; i < parts; i++)
+   {
+      chdstream_job_t *job = &jobs[i - 1];
+      uint32_t first       = count * i / parts;
+
+      job->file            = file;
+      job->chd             = file->workers[i - 1];
+      job->out             = stream->bulk + (size_t)first * hunkbytes;
+      job->hunknum         = hunknum + first;
+      job->count           = count * (i + 1) / parts - first;
+      job->hunkbytes       = hunkbytes;
+      job->ok              = false;
+      job->done            = false;
+
+      if (!tpool_add_work(pool, chdstream_job_run, job))
+         chdstream_job_run(job);
+   }
+#endif
+
+   chdstream_chd_lock(file);
+   for (i = 0; ok && i < count / parts; i++)
+      ok = chd_read(stream->chd, hunknum + i,
+            stream->bulk + (size_t)i * hunkbytes) == CHDERR_NONE;
+   chdstream_chd_unlock(file);
+
+   chdstream_file_lock(file);
+#ifdef HAVE_THREADS
+   /* The parts are read into 'bulk', so wait for all of them */
+   for (i = 1; i < parts; i++)
+   {
+      while (!jobs[i - 1].done)
+         scond_wait(file->cond, file->lock);
+      if (!jobs[i - 1].ok)
+         ok = false;
+   }
+#endif
+   file->stats.misses += count;
+   chdstream_file_unlock(file);
+
+#ifdef HAVE_THREADS
+   slock_unlock(file->bulk_lock);
+#endif
+
+   if (!ok)
       return false;
 
    if (stream->swab)
+      chdstream_swab(stream->bulk, (size_t)count * hunkbytes);
+
+   stream->bulk_first      = hunknum;
+   stream->bulk_count      = count;
+   return true;
+}
+
+/* Loads a hunk, knowing the read goes on for 'ahead' hunks after it */
+static bool
+chdstream_load_hunk(chdstream_t *stream, uint32_t hunknum, uint32_t ahead)
+{
+   bool ok                 = true;
+   chdstream_slot_t *slot  = NULL;
+   chdstream_file_t *file  = stream->file;
+   uint32_t hunkbytes      = chd_get_header(stream->chd)->hunkbytes;
+
+   if (hunknum == stream->hunknum)
+      return true;
+
+   if (     hunknum - stream->bulk_first >= stream->bulk_count
+         && ahead + 1 >= CHDSTREAM_BULK_MIN_HUNKS)
    {
-      uint32_t i;
-      uint32_t count = chd_get_header(stream->chd)->hunkbytes / 2;
-      array          = (uint16_t*)stream->hunkmem;
-      for (i = 0; i < count; ++i)
-         array[i] = SWAP16(array[i]);
+      if (!chdstream_load_bulk(stream, hunknum, ahead + 1))
+      {
+         stream->hunknum = -1;
+         return false;
+      }
+   }
+
+   if (hunknum - stream->bulk_first < stream->bulk_count)
+   {
+      stream->run     = 0;
+      stream->data    = stream->bulk +
+         (size_t)(hunknum - stream->bulk_first) * hunkbytes;
+      stream->hunknum = hunknum;
+      return true;
    }
 
+   /* Short runs get short read-ahead, so that reads hopping
+    * between files don't wait on hunks nobody asked for */
+   if (stream->hunknum >= 0 && hunknum == (uint32_t)stream->hunknum + 1)
+      stream->run++;
+   else
+      stream->run = 0;
+
+   chdstream_file_lock(file);
+
+   /* Wait out read-ahead if it is decompressing this hunk */
+   while ((slot = chdstream_file_find(file, hunknum)) && slot->loading)
+   {
+#ifdef HAVE_THREADS
+      scond_wait(file->cond, file->lock);
+#endif
+   }
+
+   if (slot)
+   {
+      file->stats.hits++;
+      slot->used = ++file->clock;
+      memcpy(stream->hunkmem, slot->mem, hunkbytes);
+   }
+   else
+   {
+      /* With every slot being loaded, skip the cache */
+      if ((slot = chdstream_file_evict(file)))
+      {
+         slot->hunknum = hunknum;
+         slot->loading = true;
+      }
+      file->stats.misses++;
+#ifdef HAVE_THREADS
+      file->demand++;
+#endif
+      chdstream_file_unlock(file);
+
+      chdstream_chd_lock(file);
+      ok = chd_read(stream->chd, hunknum,
+            slot ? slot->mem : stream->hunkmem) == CHDERR_NONE;
+      chdstream_chd_unlock(file);
+
+      chdstream_file_lock(file);
+#ifdef HAVE_THREADS
+      file->demand--;
+#endif
+      if (slot)
+      {
+         slot->loading = false;
+         if (ok)
+         {
+            slot->used = ++file->clock;
+            memcpy(stream->hunkmem, slot->mem, hunkbytes);
+         }
+         else
+            slot->hunknum = -1;
+      }
+#ifdef HAVE_THREADS
+      scond_broadcast(file->cond);
+#endif
+   }
+
+#ifdef HAVE_THREADS
+   if (ok)
+      chdstream_file_read_ahead(file, hunknum, stream->run);
+#endif
+
+   chdstream_file_unlock(file);
+
+   if (!ok)
+   {
+      stream->hunknum = -1;
+      return false;
+   }
+
+   /* The cache is shared with streams on other tracks,
+    * so it keeps hunks as they are stored */
+   if (stream->swab)
+      chdstream_swab(stream->hunkmem, hunkbytes);
+
+   stream->data    = stream->hunkmem;
    stream->hunknum = hunknum;
    return true;
 }
@@ -317,6 +1010,7 @@ chdstream_load_hunk(chdstream_t *stream, uint32_t hunknum)
 ssize_t chdstream_read(chdstream_t *stream, void *data, size_t bytes)
 {
    size_t end;
+   uint32_t last_hunk   = 0;
    size_t data_offset   = 0;
    const chd_header *hd = chd_get_header(stream->chd);
    uint8_t         *out = (uint8_t*)data;
@@ -326,6 +1020,11 @@ ssize_t chdstream_read(chdstream_t *stream, void *data, size_t bytes)
 
    end                  = stream->offset + bytes;
 
+   if (end > stream->track_start)
+      last_hunk         = (uint32_t)(stream->track_frame +
+            (end - 1 - stream->track_start) / stream->frame_size)
+         / stream->frames_per_hunk;
+
    while (stream->offset < end)
    {
       uint32_t frame_offset = stream->offset % stream->frame_size;
@@ -345,11 +1044,11 @@ ssize_t chdstream_read(chdstream_t *stream, void *data, size_t bytes)
          uint32_t hunk_offset = (chd_frame % stream->frames_per_hunk) 
             * hd->unitbytes;
 
-         if (!chdstream_load_hunk(stream, hunk))
+         if (!chdstream_load_hunk(stream, hunk, last_hunk - hunk))
             return -1;
 
          memcpy(out + data_offset,
-                stream->hunkmem + frame_offset
+                stream->data + frame_offset
                 + hunk_offset + stream->frame_offset, amount);
       }
 
@@ -435,7 +1134,7 @@ uint32_t chdstream_get_track_start(chdstream_t *stream)
    metadata_t meta;
    uint32_t frame_offset = 0;
 
-   for (i = 0; chdstream_get_meta(stream->chd, i, &meta); ++i)
+   for (i = 0; chdstream_get_meta(stream->file, i, &meta); ++i)
    {
       if (stream->track_frame == frame_offset)
          return meta.pregap * stream->frame_size;
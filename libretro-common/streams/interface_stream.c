@@ -40,6 +40,10 @@ struct intfstream_internal
    struct
    {
       RFILE *fp;
+      /* Range of the file the stream covers, [start, end);
+       * 'end' is -1 when it covers the whole file */
+      int64_t start;
+      int64_t end;
    } file;
 
    struct
@@ -67,6 +71,21 @@ struct intfstream_internal
 #endif
 };
 
+/* Bytes left in the range of a file stream, or -1 if the
+ * stream covers the whole file */
+static int64_t intfstream_file_remaining(intfstream_internal_t *intf)
+{
+   int64_t pos;
+
+   if (intf->file.end < 0)
+      return -1;
+
+   pos = filestream_tell(intf->file.fp);
+   if (pos < intf->file.start || pos >= intf->file.end)
+      return 0;
+   return intf->file.end - pos;
+}
+
 int64_t intfstream_get_size(intfstream_internal_t *intf)
 {
    if (!intf)
@@ -75,6 +94,8 @@ int64_t intfstream_get_size(intfstream_internal_t *intf)
    switch (intf->type)
    {
       case INTFSTREAM_FILE:
+         if (intf->file.end >= 0)
+            return intf->file.end - intf->file.start;
          return filestream_get_size(intf->file.fp);
       case INTFSTREAM_MEMORY:
          return intf->memory.buf.size;
@@ -228,6 +249,8 @@ void *intfstream_init(intfstream_info_t *info)
 
    intf->type            = info->type;
    intf->file.fp         = NULL;
+   intf->file.start      = 0;
+   intf->file.end        = -1;
    intf->memory.buf.data = NULL;
    intf->memory.buf.size = 0;
    intf->memory.fp       = NULL;
@@ -277,6 +300,34 @@ int64_t intfstream_seek(
    switch (intf->type)
    {
       case INTFSTREAM_FILE:
+         if (intf->file.end >= 0)
+         {
+            int64_t pos;
+
+            switch (whence)
+            {
+               case SEEK_SET:
+                  pos = intf->file.start + offset;
+                  break;
+               case SEEK_CUR:
+                  pos = filestream_tell(intf->file.fp) + offset;
+                  break;
+               case SEEK_END:
+                  pos = intf->file.end + offset;
+                  break;
+               default:
+                  return -1;
+            }
+
+            if (pos < intf->file.start)
+               return -1;
+            if (pos > intf->file.end)
+               pos = intf->file.end;
+
+            return (int64_t)filestream_seek(intf->file.fp, pos,
+                  RETRO_VFS_SEEK_POSITION_START);
+         }
+         else
          {
             int seek_position = 0;
             switch (whence)
@@ -318,6 +369,14 @@ int64_t intfstream_read(intfstream_internal_t *intf, void *s, uint64_t len)
    switch (intf->type)
    {
       case INTFSTREAM_FILE:
+         {
+            int64_t remaining = intfstream_file_remaining(intf);
+
+            if (remaining >= 0 && len > (uint64_t)remaining)
+               len = (uint64_t)remaining;
+            if (!len)
+               return 0;
+         }
          return filestream_read(intf->file.fp, s, len);
       case INTFSTREAM_MEMORY:
          return memstream_read(intf->memory.fp, s, len);
@@ -426,6 +485,14 @@ char *intfstream_gets(intfstream_internal_t *intf,
    switch (intf->type)
    {
       case INTFSTREAM_FILE:
+         {
+            int64_t remaining = intfstream_file_remaining(intf);
+
+            if (remaining == 0)
+               return NULL;
+            if (remaining > 0 && len > (uint64_t)remaining + 1)
+               len = (uint64_t)remaining + 1;
+         }
          return filestream_gets(intf->file.fp,
                buffer, (size_t)len);
       case INTFSTREAM_MEMORY:
@@ -456,6 +523,8 @@ int intfstream_getc(intfstream_internal_t *intf)
    switch (intf->type)
    {
       case INTFSTREAM_FILE:
+         if (intfstream_file_remaining(intf) == 0)
+            return EOF;
          return filestream_getc(intf->file.fp);
       case INTFSTREAM_MEMORY:
          return memstream_getc(intf->memory.fp);
@@ -484,7 +553,7 @@ int64_t intfstream_tell(intfstream_internal_t *intf)
    switch (intf->type)
    {
       case INTFSTREAM_FILE:
-         return (int64_t)filestream_tell(intf->file.fp);
+         return (int64_t)filestream_tell(intf->file.fp) - intf->file.start;
       case INTFSTREAM_MEMORY:
          return (int64_t)memstream_pos(intf->memory.fp);
       case INTFSTREAM_CHD:
@@ -512,6 +581,8 @@ int intfstream_eof(intfstream_internal_t *intf)
    switch (intf->type)
    {
       case INTFSTREAM_FILE:
+         if (intf->file.end >= 0)
+            return intfstream_file_remaining(intf) == 0;
          return filestream_eof(intf->file.fp);
       case INTFSTREAM_MEMORY:
          /* TODO: Add this functionality to
@@ -537,7 +608,11 @@ void intfstream_rewind(intfstream_internal_t *intf)
    switch (intf->type)
    {
       case INTFSTREAM_FILE:
-         filestream_rewind(intf->file.fp);
+         if (intf->file.start)
+            filestream_seek(intf->file.fp, intf->file.start,
+                  RETRO_VFS_SEEK_POSITION_START);
+         else
+            filestream_rewind(intf->file.fp);
          break;
       case INTFSTREAM_MEMORY:
          memstream_rewind(intf->memory.fp);
@@ -629,30 +704,57 @@ bool intfstream_is_compressed(intfstream_internal_t *intf)
    return false;
 }
 
-bool intfstream_get_crc(intfstream_internal_t *intf, uint32_t *crc)
+bool intfstream_get_crc_range(intfstream_internal_t *intf,
+      uint64_t offset, uint64_t len, uint32_t *crc)
 {
    int64_t data_read    = 0;
    uint32_t accumulator = 0;
-   uint8_t buffer[4096];
+   uint8_t *buffer      = NULL;
 
    if (!intf || !crc)
       return false;
 
-   /* Ensure we start at the beginning of the file */
-   intfstream_rewind(intf);
+   if (intfstream_seek(intf, (int64_t)offset, SEEK_SET) == -1)
+      return false;
+
+   buffer = (uint8_t*)malloc(INTFSTREAM_CRC_CHUNK_SIZE);
+   if (!buffer)
+      return false;
+
+   while (len > 0)
+   {
+      uint64_t chunk = len < INTFSTREAM_CRC_CHUNK_SIZE
+         ? len : INTFSTREAM_CRC_CHUNK_SIZE;
+
+      if ((data_read = intfstream_read(intf, buffer, chunk)) <= 0)
+         break;
 
-   while ((data_read = intfstream_read(intf, buffer, sizeof(buffer))) > 0)
       accumulator = encoding_crc32(accumulator, buffer, (size_t)data_read);
+      len        -= (uint64_t)data_read;
+   }
+
+   free(buffer);
 
    if (data_read < 0)
       return false;
 
    *crc = accumulator;
+   return true;
+}
+
+bool intfstream_get_crc(intfstream_internal_t *intf, uint32_t *crc)
+{
+   bool ret;
+
+   if (!intf || !crc)
+      return false;
+
+   ret = intfstream_get_crc_range(intf, 0, ~(uint64_t)0, crc);
 
    /* Reset file to the beginning */
    intfstream_rewind(intf);
 
-   return true;
+   return ret;
 }
 
 intfstream_t* intfstream_open_file(const char *path,
@@ -681,6 +783,37 @@ error:
    return NULL;
 }
 
+intfstream_t *intfstream_open_file_range(const char *path,
+      unsigned mode, unsigned hints, uint64_t offset, uint64_t size)
+{
+   int64_t file_size;
+   intfstream_t *fd = intfstream_open_file(path, mode, hints);
+
+   if (!fd)
+      return NULL;
+
+   file_size        = filestream_get_size(fd->file.fp);
+   if (file_size < 0 || offset > (uint64_t)file_size)
+      goto error;
+
+   if (size > (uint64_t)file_size - offset)
+      size = (uint64_t)file_size - offset;
+
+   fd->file.start   = (int64_t)offset;
+   fd->file.end     = (int64_t)(offset + size);
+
+   if (filestream_seek(fd->file.fp, fd->file.start,
+            RETRO_VFS_SEEK_POSITION_START) == -1)
+      goto error;
+
+   return fd;
+
+error:
+   intfstream_close(fd);
+   free(fd);
+   return NULL;
+}
+
 intfstream_t *intfstream_open_memory(void *data,
       unsigned mode, unsigned hints, uint64_t size)
 {
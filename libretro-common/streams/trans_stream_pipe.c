@@ -87,7 +87,8 @@ static bool pipe_trans(
       *rd     = *wn = p->out_size;
       p->in  += p->out_size;
       p->out += p->out_size;
-      *error  = TRANS_STREAM_ERROR_BUFFER_FULL;
+      if (error)
+         *error = TRANS_STREAM_ERROR_BUFFER_FULL;
       return false;
    }
 
@@ -95,7 +96,8 @@ static bool pipe_trans(
    *rd     = *wn = p->in_size;
    p->in  += p->in_size;
    p->out += p->in_size;
-   *error  = TRANS_STREAM_ERROR_NONE;
+   if (error)
+      *error = TRANS_STREAM_ERROR_NONE;
    return true;
 }
 
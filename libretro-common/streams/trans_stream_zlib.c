@@ -30,7 +30,9 @@
 struct zlib_trans_stream
 {
    bool inited;
-   int ex; /* window_bits or level */
+   bool sync_flush;  /* deflate: flush ends in Z_SYNC_FLUSH, not Z_FINISH */
+   int ex;           /* window_bits or level */
+   int window_bits;  /* deflate only, negative for a raw stream */
    z_stream z;
 };
 
@@ -41,7 +43,9 @@ static void *zlib_deflate_stream_new(void)
    if (!ret)
       return NULL;
    ret->inited      = false;
+   ret->sync_flush  = false;
    ret->ex          = 9;
+   ret->window_bits = MAX_WBITS;
 
    ret->z.next_in   = NULL;
    ret->z.avail_in  = 0;
@@ -70,7 +74,9 @@ static void *zlib_inflate_stream_new(void)
    if (!ret)
       return NULL;
    ret->inited      = false;
+   ret->sync_flush  = false;
    ret->ex          = MAX_WBITS;
+   ret->window_bits = MAX_WBITS;
 
    ret->z.next_in   = NULL;
    ret->z.avail_in  = 0;
@@ -122,6 +128,18 @@ static bool zlib_deflate_define(void *data, const char *prop, uint32_t val)
          z->ex = (int) val;
       return true;
    }
+   else if (string_is_equal(prop, "window_bits"))
+   {
+      if (z)
+         z->window_bits = (int) val;
+      return true;
+   }
+   else if (string_is_equal(prop, "sync_flush"))
+   {
+      if (z)
+         z->sync_flush = val != 0;
+      return true;
+   }
    return false;
 }
 
@@ -149,7 +167,8 @@ static void zlib_deflate_set_in(void *data, const uint8_t *in, uint32_t in_size)
 
    if (!z->inited)
    {
-      deflateInit(&z->z, z->ex);
+      deflateInit2(&z->z, z->ex, Z_DEFLATED, z->window_bits,
+            8, Z_DEFAULT_STRATEGY);
       z->inited = true;
    }
 }
@@ -195,13 +214,15 @@ static bool zlib_deflate_trans(
 
    if (!zt->inited)
    {
-      deflateInit(z, zt->ex);
+      deflateInit2(z, zt->ex, Z_DEFLATED, zt->window_bits,
+            8, Z_DEFAULT_STRATEGY);
       zt->inited = true;
    }
 
    pre_avail_in  = z->avail_in;
    pre_avail_out = z->avail_out;
-   zret          = deflate(z, flush ? Z_FINISH : Z_NO_FLUSH);
+   zret          = deflate(z, flush
+         ? (zt->sync_flush ? Z_SYNC_FLUSH : Z_FINISH) : Z_NO_FLUSH);
 
    if (zret == Z_OK)
    {
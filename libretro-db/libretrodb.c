@@ -399,6 +399,37 @@ retry:
    return 0;
 }
 
+/**
+ * libretrodb_cursor_tell:
+ * @cursor              : Handle to database cursor.
+ *
+ * Returns: file offset of the next item the cursor will read.
+ **/
+uint64_t libretrodb_cursor_tell(libretrodb_cursor_t *cursor)
+{
+   return (uint64_t)filestream_tell(cursor->fd);
+}
+
+/**
+ * libretrodb_cursor_seek:
+ * @cursor              : Handle to database cursor.
+ * @offset              : File offset of an item, as returned
+ *                        by libretrodb_cursor_tell().
+ *
+ * Positions cursor so that the next read returns the
+ * item stored at @offset.
+ *
+ * Returns: 0 if successful, otherwise negative.
+ **/
+int libretrodb_cursor_seek(libretrodb_cursor_t *cursor, uint64_t offset)
+{
+   cursor->eof = 0;
+   if (filestream_seek(cursor->fd, (int64_t)offset,
+            RETRO_VFS_SEEK_POSITION_START) < 0)
+      return -1;
+   return 0;
+}
+
 /**
  * libretrodb_cursor_close:
  * @cursor              : Handle to database cursor.
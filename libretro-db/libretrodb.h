@@ -89,6 +89,27 @@ int libretrodb_cursor_open(libretrodb_t *db,
  **/
 int libretrodb_cursor_reset(libretrodb_cursor_t *cursor);
 
+/**
+ * libretrodb_cursor_tell:
+ * @cursor              : Handle to database cursor.
+ *
+ * Returns: file offset of the next item the cursor will read.
+ **/
+uint64_t libretrodb_cursor_tell(libretrodb_cursor_t *cursor);
+
+/**
+ * libretrodb_cursor_seek:
+ * @cursor              : Handle to database cursor.
+ * @offset              : File offset of an item, as returned
+ *                        by libretrodb_cursor_tell().
+ *
+ * Positions cursor so that the next read returns the
+ * item stored at @offset.
+ *
+ * Returns: 0 if successful, otherwise negative.
+ **/
+int libretrodb_cursor_seek(libretrodb_cursor_t *cursor, uint64_t offset);
+
 /**
  * libretrodb_cursor_close:
  * @cursor              : Handle to database cursor.
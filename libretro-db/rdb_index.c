@@ -0,0 +1,574 @@
+/* Copyright  (C) 2010-2020 The RetroArch team
+ *
+ * ---------------------------------------------------------------------------------------
+ * The following license statement only applies to this file (rdb_index.c).
+ * ---------------------------------------------------------------------------------------
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <boolean.h>
+#include <memmap.h>
+#include <retro_miscellaneous.h>
+#include <file/file_path.h>
+#include <streams/file_stream.h>
+#include <string/stdstring.h>
+
+#ifdef HAVE_MMAN
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "libretrodb.h"
+#include "rmsgpack_dom.h"
+#include "rdb_index.h"
+
+#define RDB_INDEX_MAGIC       "RDBIDX1"
+#define RDB_INDEX_BYTE_ORDER  0x01020304
+#define RDB_INDEX_EMPTY       0xFFFFFFFF
+
+/* On-disk layout, in host byte order:
+ *
+ *   rdb_index_header
+ *   rdb_index_db      [db_count]
+ *   rdb_index_slot    [crc_mask + 1]
+ *   rdb_index_slot    [serial_mask + 1]
+ *   NUL-terminated database paths
+ *
+ * Both slot tables use open addressing with linear probing.
+ * A slot whose db is RDB_INDEX_EMPTY terminates a probe. */
+
+typedef struct rdb_index_header
+{
+   char magic[8];
+   uint32_t byte_order;
+   uint32_t db_count;
+   uint32_t crc_mask;
+   uint32_t serial_mask;
+   uint64_t crc_offset;
+   uint64_t serial_offset;
+   uint64_t strings_offset;
+   uint64_t size;
+} rdb_index_header_t;
+
+typedef struct rdb_index_db
+{
+   int64_t mtime;
+   int64_t size;
+   uint64_t path_offset;
+} rdb_index_db_t;
+
+typedef struct rdb_index_slot
+{
+   uint32_t key;
+   uint32_t db;
+   uint64_t offset;
+} rdb_index_slot_t;
+
+struct rdb_index
+{
+   uint8_t *data;
+   size_t size;
+   bool mapped;
+   const rdb_index_header_t *header;
+   const rdb_index_slot_t *crc_slots;
+   const rdb_index_slot_t *serial_slots;
+};
+
+struct rdb_index_records
+{
+   rdb_index_slot_t *crc;
+   rdb_index_slot_t *serial;
+   size_t crc_count;
+   size_t crc_capacity;
+   size_t serial_count;
+   size_t serial_capacity;
+};
+
+static uint32_t rdb_index_hash(uint32_t key, uint32_t db)
+{
+   uint32_t h = key ^ (db * 0x9E3779B1);
+   h ^= h >> 16;
+   h *= 0x85EBCA6B;
+   h ^= h >> 13;
+   h *= 0xC2B2AE35;
+   h ^= h >> 16;
+   return h;
+}
+
+static uint32_t rdb_index_serial_key(const char *serial, size_t len)
+{
+   /* FNV-1a */
+   size_t i;
+   uint32_t h = 0x811C9DC5;
+   for (i = 0; i < len && serial[i]; i++)
+   {
+      h ^= (uint8_t)serial[i];
+      h *= 0x01000193;
+   }
+   return h;
+}
+
+static uint32_t rdb_index_table_mask(size_t count)
+{
+   uint32_t size = 16;
+   /* Keep load factor at or below 50% */
+   while (size < count * 2)
+      size <<= 1;
+   return size - 1;
+}
+
+static bool rdb_index_records_push(rdb_index_slot_t **list,
+      size_t *count, size_t *capacity,
+      uint32_t key, uint32_t db, uint64_t offset)
+{
+   rdb_index_slot_t *slot = NULL;
+
+   if (*count == *capacity)
+   {
+      size_t new_capacity         = *capacity ? *capacity * 2 : 1024;
+      rdb_index_slot_t *new_list  = (rdb_index_slot_t*)realloc(*list,
+            new_capacity * sizeof(*new_list));
+
+      if (!new_list)
+         return false;
+
+      *list     = new_list;
+      *capacity = new_capacity;
+   }
+
+   slot         = &(*list)[(*count)++];
+   slot->key    = key;
+   slot->db     = db;
+   slot->offset = offset;
+   return true;
+}
+
+static void rdb_index_table_insert(rdb_index_slot_t *table,
+      uint32_t mask, const rdb_index_slot_t *rec)
+{
+   uint32_t i = rdb_index_hash(rec->key, rec->db) & mask;
+
+   while (table[i].db != RDB_INDEX_EMPTY)
+      i = (i + 1) & mask;
+
+   table[i] = *rec;
+}
+
+static bool rdb_index_collect(struct rdb_index_records *rec,
+      const char *path, uint32_t db_num)
+{
+   struct rmsgpack_dom_value item;
+   libretrodb_t *db         = libretrodb_new();
+   libretrodb_cursor_t *cur = libretrodb_cursor_new();
+   bool ret                 = false;
+
+   if (!db || !cur)
+      goto end;
+
+   if (libretrodb_open(path, db) != 0)
+      goto end;
+
+   if (libretrodb_cursor_open(db, cur, NULL) != 0)
+   {
+      libretrodb_close(db);
+      goto end;
+   }
+
+   ret = true;
+
+   for (;;)
+   {
+      unsigned i;
+      uint64_t offset = libretrodb_cursor_tell(cur);
+
+      if (libretrodb_cursor_read_item(cur, &item) != 0)
+         break;
+
+      if (item.type == RDT_MAP)
+      {
+         for (i = 0; i < item.val.map.len; i++)
+         {
+            const struct rmsgpack_dom_value *key = &item.val.map.items[i].key;
+            const struct rmsgpack_dom_value *val = &item.val.map.items[i].value;
+
+            if (key->type != RDT_STRING)
+               continue;
+
+            if (     string_is_equal(key->val.string.buff, "crc")
+                  && val->type == RDT_BINARY
+                  && val->val.binary.len == 4)
+            {
+               const uint8_t *b = (const uint8_t*)val->val.binary.buff;
+               uint32_t crc     = ((uint32_t)b[0] << 24)
+                                | ((uint32_t)b[1] << 16)
+                                | ((uint32_t)b[2] <<  8)
+                                |  (uint32_t)b[3];
+
+               if (!rdb_index_records_push(&rec->crc,
+                        &rec->crc_count, &rec->crc_capacity,
+                        crc, db_num, offset))
+                  ret = false;
+            }
+            else if (string_is_equal(key->val.string.buff, "serial")
+                  && (val->type == RDT_BINARY || val->type == RDT_STRING)
+                  && val->val.string.len > 0)
+            {
+               if (!rdb_index_records_push(&rec->serial,
+                        &rec->serial_count, &rec->serial_capacity,
+                        rdb_index_serial_key(val->val.string.buff,
+                           val->val.string.len),
+                        db_num, offset))
+                  ret = false;
+            }
+         }
+      }
+
+      rmsgpack_dom_value_free(&item);
+
+      if (!ret)
+         break;
+   }
+
+   libretrodb_cursor_close(cur);
+   libretrodb_close(db);
+
+end:
+   if (cur)
+      libretrodb_cursor_free(cur);
+   if (db)
+      libretrodb_free(db);
+   return ret;
+}
+
+static bool rdb_index_attach(rdb_index_t *idx)
+{
+   const rdb_index_header_t *header = (const rdb_index_header_t*)idx->data;
+
+   if (idx->size < sizeof(*header))
+      return false;
+   if (memcmp(header->magic, RDB_INDEX_MAGIC, sizeof(RDB_INDEX_MAGIC)) != 0)
+      return false;
+   if (header->byte_order != RDB_INDEX_BYTE_ORDER)
+      return false;
+   if (header->size != idx->size)
+      return false;
+   if (header->crc_offset + (uint64_t)(header->crc_mask + 1)
+         * sizeof(rdb_index_slot_t) > header->serial_offset)
+      return false;
+   if (header->serial_offset + (uint64_t)(header->serial_mask + 1)
+         * sizeof(rdb_index_slot_t) > header->strings_offset)
+      return false;
+   if (header->strings_offset > header->size)
+      return false;
+   if (idx->data[idx->size - 1] != '\0')
+      return false;
+
+   idx->header       = header;
+   idx->crc_slots    = (const rdb_index_slot_t*)
+      (idx->data + header->crc_offset);
+   idx->serial_slots = (const rdb_index_slot_t*)
+      (idx->data + header->serial_offset);
+   return true;
+}
+
+static bool rdb_index_is_current(const rdb_index_t *idx,
+      const char **rdb_paths, size_t count)
+{
+   size_t i;
+   const rdb_index_db_t *dbs = (const rdb_index_db_t*)
+      (idx->data + sizeof(rdb_index_header_t));
+
+   if (idx->header->db_count != count)
+      return false;
+
+   for (i = 0; i < count; i++)
+   {
+      if (dbs[i].path_offset < idx->header->strings_offset ||
+          dbs[i].path_offset >= idx->size)
+         return false;
+      if (!string_is_equal((const char*)idx->data + dbs[i].path_offset,
+               rdb_paths[i]))
+         return false;
+      if (dbs[i].size  != (int64_t)path_get_size(rdb_paths[i]))
+         return false;
+      if (dbs[i].mtime != path_get_mtime(rdb_paths[i]))
+         return false;
+   }
+
+   return true;
+}
+
+static void rdb_index_unload(rdb_index_t *idx)
+{
+   if (!idx->data)
+      return;
+#ifdef HAVE_MMAN
+   if (idx->mapped)
+      munmap(idx->data, idx->size);
+   else
+#endif
+      free(idx->data);
+   idx->data         = NULL;
+   idx->size         = 0;
+   idx->mapped       = false;
+   idx->header       = NULL;
+   idx->crc_slots    = NULL;
+   idx->serial_slots = NULL;
+}
+
+static bool rdb_index_load(rdb_index_t *idx, const char *index_path)
+{
+#ifdef HAVE_MMAN
+   int fd       = open(index_path, O_RDONLY);
+   off_t len;
+   void *ptr;
+
+   if (fd < 0)
+      return false;
+
+   len          = lseek(fd, 0, SEEK_END);
+   if (len <= 0)
+   {
+      close(fd);
+      return false;
+   }
+
+   ptr          = mmap(NULL, (size_t)len, PROT_READ, MAP_SHARED, fd, 0);
+   close(fd);
+
+   if (ptr == MAP_FAILED)
+      return false;
+
+   idx->data    = (uint8_t*)ptr;
+   idx->size    = (size_t)len;
+   idx->mapped  = true;
+#else
+   void *buf    = NULL;
+   int64_t len  = 0;
+
+   if (!filestream_read_file(index_path, &buf, &len) || len <= 0)
+   {
+      if (buf)
+         free(buf);
+      return false;
+   }
+
+   idx->data    = (uint8_t*)buf;
+   idx->size    = (size_t)len;
+   idx->mapped  = false;
+#endif
+
+   if (rdb_index_attach(idx))
+      return true;
+
+   rdb_index_unload(idx);
+   return false;
+}
+
+static bool rdb_index_build(rdb_index_t *idx,
+      const char **rdb_paths, size_t count)
+{
+   size_t i;
+   rdb_index_header_t *header;
+   rdb_index_db_t *dbs;
+   rdb_index_slot_t *crc_slots;
+   rdb_index_slot_t *serial_slots;
+   struct rdb_index_records rec = {0};
+   uint32_t crc_mask;
+   uint32_t serial_mask;
+   uint64_t strings_len         = 0;
+   uint64_t offset              = 0;
+   uint8_t *data                = NULL;
+
+   for (i = 0; i < count; i++)
+   {
+      /* A database that cannot be read simply has no entries */
+      rdb_index_collect(&rec, rdb_paths[i], (uint32_t)i);
+      strings_len += strlen(rdb_paths[i]) + 1;
+   }
+
+   crc_mask    = rdb_index_table_mask(rec.crc_count);
+   serial_mask = rdb_index_table_mask(rec.serial_count);
+
+   idx->size   = sizeof(rdb_index_header_t)
+               + count * sizeof(rdb_index_db_t)
+               + (crc_mask + 1) * sizeof(rdb_index_slot_t)
+               + (serial_mask + 1) * sizeof(rdb_index_slot_t)
+               + (size_t)strings_len + 1;
+   data        = (uint8_t*)calloc(1, idx->size);
+
+   if (!data)
+   {
+      free(rec.crc);
+      free(rec.serial);
+      idx->size = 0;
+      return false;
+   }
+
+   header                 = (rdb_index_header_t*)data;
+   offset                 = sizeof(*header);
+   dbs                    = (rdb_index_db_t*)(data + offset);
+   offset                += count * sizeof(rdb_index_db_t);
+   header->crc_offset     = offset;
+   crc_slots              = (rdb_index_slot_t*)(data + offset);
+   offset                += (crc_mask + 1) * sizeof(rdb_index_slot_t);
+   header->serial_offset  = offset;
+   serial_slots           = (rdb_index_slot_t*)(data + offset);
+   offset                += (serial_mask + 1) * sizeof(rdb_index_slot_t);
+   header->strings_offset = offset;
+
+   memcpy(header->magic, RDB_INDEX_MAGIC, sizeof(RDB_INDEX_MAGIC));
+   header->byte_order     = RDB_INDEX_BYTE_ORDER;
+   header->db_count       = (uint32_t)count;
+   header->crc_mask       = crc_mask;
+   header->serial_mask    = serial_mask;
+   header->size           = idx->size;
+
+   for (i = 0; i < count; i++)
+   {
+      size_t len          = strlen(rdb_paths[i]) + 1;
+      dbs[i].mtime        = path_get_mtime(rdb_paths[i]);
+      dbs[i].size         = (int64_t)path_get_size(rdb_paths[i]);
+      dbs[i].path_offset  = offset;
+      memcpy(data + offset, rdb_paths[i], len);
+      offset             += len;
+   }
+
+   for (i = 0; i <= crc_mask; i++)
+      crc_slots[i].db    = RDB_INDEX_EMPTY;
+   for (i = 0; i <= serial_mask; i++)
+      serial_slots[i].db = RDB_INDEX_EMPTY;
+
+   for (i = 0; i < rec.crc_count; i++)
+      rdb_index_table_insert(crc_slots, crc_mask, &rec.crc[i]);
+   for (i = 0; i < rec.serial_count; i++)
+      rdb_index_table_insert(serial_slots, serial_mask, &rec.serial[i]);
+
+   free(rec.crc);
+   free(rec.serial);
+
+   idx->data   = data;
+   idx->mapped = false;
+
+   return rdb_index_attach(idx);
+}
+
+/* Other scans may have the old index mapped, and truncating it
+ * under them would fault their reads; so the new one is written
+ * next to it, under a name only this writer uses, and renamed
+ * over it. Readers keep the old file until they unmap it. */
+static bool rdb_index_save(const rdb_index_t *idx, const char *index_path)
+{
+   char tmp_path[PATH_MAX_LENGTH];
+
+   snprintf(tmp_path, sizeof(tmp_path), "%s.%lx.tmp",
+         index_path, (unsigned long)(uintptr_t)idx);
+
+   if (!filestream_write_file(tmp_path, idx->data, (int64_t)idx->size))
+   {
+      filestream_delete(tmp_path);
+      return false;
+   }
+
+   if (filestream_rename(tmp_path, index_path) != 0)
+   {
+      /* Windows will not rename over an existing file */
+      filestream_delete(index_path);
+      if (filestream_rename(tmp_path, index_path) != 0)
+      {
+         filestream_delete(tmp_path);
+         return false;
+      }
+   }
+
+   return true;
+}
+
+rdb_index_t *rdb_index_open(const char *index_path,
+      const char **rdb_paths, size_t count)
+{
+   rdb_index_t *idx = (rdb_index_t*)calloc(1, sizeof(*idx));
+
+   if (!idx)
+      return NULL;
+
+   if (!string_is_empty(index_path) && rdb_index_load(idx, index_path))
+   {
+      if (rdb_index_is_current(idx, rdb_paths, count))
+         return idx;
+      rdb_index_unload(idx);
+   }
+
+   if (!rdb_index_build(idx, rdb_paths, count))
+   {
+      rdb_index_free(idx);
+      return NULL;
+   }
+
+   /* Failing to persist the index only costs a rebuild next time */
+   if (!string_is_empty(index_path))
+      rdb_index_save(idx, index_path);
+
+   return idx;
+}
+
+void rdb_index_free(rdb_index_t *idx)
+{
+   if (!idx)
+      return;
+   rdb_index_unload(idx);
+   free(idx);
+}
+
+static size_t rdb_index_find(const rdb_index_slot_t *table, uint32_t mask,
+      uint32_t key, uint32_t db, uint64_t *offsets, size_t max)
+{
+   size_t found = 0;
+   uint32_t i   = rdb_index_hash(key, db) & mask;
+
+   while (table[i].db != RDB_INDEX_EMPTY && found < max)
+   {
+      if (table[i].key == key && table[i].db == db)
+         offsets[found++] = table[i].offset;
+      i = (i + 1) & mask;
+   }
+
+   return found;
+}
+
+size_t rdb_index_find_crc(const rdb_index_t *idx, unsigned db,
+      uint32_t crc, uint64_t *offsets, size_t max)
+{
+   if (!idx || db >= idx->header->db_count)
+      return 0;
+   return rdb_index_find(idx->crc_slots, idx->header->crc_mask,
+         crc, (uint32_t)db, offsets, max);
+}
+
+size_t rdb_index_find_serial(const rdb_index_t *idx, unsigned db,
+      const char *serial, uint64_t *offsets, size_t max)
+{
+   if (!idx || string_is_empty(serial) || db >= idx->header->db_count)
+      return 0;
+   return rdb_index_find(idx->serial_slots, idx->header->serial_mask,
+         rdb_index_serial_key(serial, strlen(serial)),
+         (uint32_t)db, offsets, max);
+}
@@ -0,0 +1,97 @@
+/* Copyright  (C) 2010-2020 The RetroArch team
+ *
+ * ---------------------------------------------------------------------------------------
+ * The following license statement only applies to this file (rdb_index.h).
+ * ---------------------------------------------------------------------------------------
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __LIBRETRODB_RDB_INDEX_H__
+#define __LIBRETRODB_RDB_INDEX_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <retro_common_api.h>
+
+RETRO_BEGIN_DECLS
+
+/* Persistent hash index over a set of RDB files.
+ *
+ * Maps (crc32, database) and (serial, database) keys to the file
+ * offset of the matching item inside that database, so that the
+ * content scanner can probe each database once instead of running
+ * a filtered cursor over every item.
+ *
+ * The index file is written once per set of databases and reused
+ * (memory mapped where supported) for as long as the database paths,
+ * sizes and modification times stay the same. */
+
+typedef struct rdb_index rdb_index_t;
+
+/**
+ * rdb_index_open:
+ * @index_path          : Path of the index file.
+ * @rdb_paths           : Array of database paths.
+ * @count               : Number of elements in @rdb_paths.
+ *
+ * Opens the index stored at @index_path. If it is missing or does
+ * not describe exactly @rdb_paths (same order, size and mtime), it
+ * is rebuilt from the databases and written back to @index_path.
+ *
+ * Database numbers passed to the lookup functions are positions in
+ * @rdb_paths.
+ *
+ * Returns: index handle, or NULL on error.
+ **/
+rdb_index_t *rdb_index_open(const char *index_path,
+      const char **rdb_paths, size_t count);
+
+void rdb_index_free(rdb_index_t *idx);
+
+/**
+ * rdb_index_find_crc:
+ * @idx                 : Handle to index.
+ * @db                  : Database number.
+ * @crc                 : CRC32 to look up.
+ * @offsets             : Receives item offsets in the database.
+ * @max                 : Capacity of @offsets.
+ *
+ * Returns: number of matching items written to @offsets.
+ **/
+size_t rdb_index_find_crc(const rdb_index_t *idx, unsigned db,
+      uint32_t crc, uint64_t *offsets, size_t max);
+
+/**
+ * rdb_index_find_serial:
+ * @idx                 : Handle to index.
+ * @db                  : Database number.
+ * @serial              : Serial to look up.
+ * @offsets             : Receives item offsets in the database.
+ * @max                 : Capacity of @offsets.
+ *
+ * Serials are stored hashed; callers must compare the serial of
+ * the items they read back.
+ *
+ * Returns: number of candidate items written to @offsets.
+ **/
+size_t rdb_index_find_serial(const rdb_index_t *idx, unsigned db,
+      const char *serial, uint64_t *offsets, size_t max);
+
+RETRO_END_DECLS
+
+#endif
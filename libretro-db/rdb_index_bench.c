@@ -0,0 +1,286 @@
+/* Copyright  (C) 2010-2020 The RetroArch team
+ *
+ * ---------------------------------------------------------------------------------------
+ * The following license statement only applies to this file (rdb_index_bench.c).
+ * ---------------------------------------------------------------------------------------
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/* Compares CRC lookups through a filtered libretrodb cursor (the
+ * content scanner's original path) against rdb_index probes, over
+ * a synthetic database.
+ *
+ * Usage: rdb_index_bench [entries] [cursor lookups] */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <streams/file_stream.h>
+#include <features/features_cpu.h>
+
+#include "libretrodb.h"
+#include "rmsgpack_dom.h"
+#include "rdb_index.h"
+
+#define BENCH_RDB_PATH   "rdb_index_bench.rdb"
+#define BENCH_INDEX_PATH "rdb_index_bench.idx"
+
+struct bench_provider_ctx
+{
+   unsigned count;
+   unsigned next;
+};
+
+static uint32_t bench_crc(unsigned i)
+{
+   return (uint32_t)i * 2654435761u + 0x1234567;
+}
+
+static char *bench_strdup_len(const char *s, uint32_t *len)
+{
+   *len = (uint32_t)strlen(s);
+   return strdup(s);
+}
+
+static int bench_value_provider(void *data, struct rmsgpack_dom_value *out)
+{
+   char name[64];
+   char serial[32];
+   uint32_t crc;
+   struct rmsgpack_dom_pair *items = NULL;
+   struct bench_provider_ctx *ctx  = (struct bench_provider_ctx*)data;
+
+   if (ctx->next >= ctx->count)
+      return 1;
+
+   snprintf(name,   sizeof(name),   "Synthetic Game %u (World)", ctx->next);
+   snprintf(serial, sizeof(serial), "SYN-%06u", ctx->next);
+   crc   = bench_crc(ctx->next);
+
+   items = (struct rmsgpack_dom_pair*)calloc(3, sizeof(*items));
+
+   items[0].key.type                = RDT_STRING;
+   items[0].key.val.string.buff     = bench_strdup_len("name",
+         &items[0].key.val.string.len);
+   items[0].value.type              = RDT_STRING;
+   items[0].value.val.string.buff   = bench_strdup_len(name,
+         &items[0].value.val.string.len);
+
+   items[1].key.type                = RDT_STRING;
+   items[1].key.val.string.buff     = bench_strdup_len("serial",
+         &items[1].key.val.string.len);
+   items[1].value.type              = RDT_BINARY;
+   items[1].value.val.binary.buff   = bench_strdup_len(serial,
+         &items[1].value.val.binary.len);
+
+   items[2].key.type                = RDT_STRING;
+   items[2].key.val.string.buff     = bench_strdup_len("crc",
+         &items[2].key.val.string.len);
+   items[2].value.type              = RDT_BINARY;
+   items[2].value.val.binary.len    = 4;
+   items[2].value.val.binary.buff   = (char*)malloc(4);
+   items[2].value.val.binary.buff[0] = (char)(crc >> 24);
+   items[2].value.val.binary.buff[1] = (char)(crc >> 16);
+   items[2].value.val.binary.buff[2] = (char)(crc >>  8);
+   items[2].value.val.binary.buff[3] = (char)(crc >>  0);
+
+   out->type          = RDT_MAP;
+   out->val.map.len   = 3;
+   out->val.map.items = items;
+
+   ctx->next++;
+   return 0;
+}
+
+static int bench_create_rdb(unsigned count)
+{
+   int rv;
+   struct bench_provider_ctx ctx;
+   RFILE *fd = filestream_open(BENCH_RDB_PATH,
+         RETRO_VFS_FILE_ACCESS_WRITE,
+         RETRO_VFS_FILE_ACCESS_HINT_NONE);
+
+   if (!fd)
+      return -1;
+
+   ctx.count = count;
+   ctx.next  = 0;
+   rv        = libretrodb_create(fd, bench_value_provider, &ctx);
+   filestream_close(fd);
+   return rv;
+}
+
+static unsigned bench_cursor_lookup(uint32_t crc)
+{
+   char query[50];
+   struct rmsgpack_dom_value item;
+   const char *error        = NULL;
+   unsigned found           = 0;
+   libretrodb_query_t *q    = NULL;
+   libretrodb_t *db         = libretrodb_new();
+   libretrodb_cursor_t *cur = libretrodb_cursor_new();
+
+   snprintf(query, sizeof(query),
+         "{crc:or(b\"%08X\",b\"%08X\")}", crc, 0);
+
+   if (libretrodb_open(BENCH_RDB_PATH, db) != 0)
+      goto end;
+
+   q = (libretrodb_query_t*)libretrodb_query_compile(db, query,
+         strlen(query), &error);
+
+   if (!error && libretrodb_cursor_open(db, cur, q) == 0)
+   {
+      while (libretrodb_cursor_read_item(cur, &item) == 0)
+      {
+         found++;
+         rmsgpack_dom_value_free(&item);
+      }
+      libretrodb_cursor_close(cur);
+   }
+
+   if (q)
+      libretrodb_query_free(q);
+   libretrodb_close(db);
+
+end:
+   libretrodb_cursor_free(cur);
+   libretrodb_free(db);
+   return found;
+}
+
+int main(int argc, char *argv[])
+{
+   unsigned i;
+   uint64_t offsets[4];
+   struct rmsgpack_dom_value item;
+   retro_time_t start;
+   retro_time_t cursor_time, build_time, load_time, probe_time;
+   const char *paths[1];
+   unsigned entries         = argc > 1 ? (unsigned)strtoul(argv[1], NULL, 0) : 100000;
+   unsigned cursor_lookups  = argc > 2 ? (unsigned)strtoul(argv[2], NULL, 0) : 20;
+   unsigned found           = 0;
+   rdb_index_t *idx         = NULL;
+   libretrodb_t *db         = NULL;
+   libretrodb_cursor_t *cur = NULL;
+
+   paths[0] = BENCH_RDB_PATH;
+
+   printf("Creating synthetic database with %u entries...\n", entries);
+   if (bench_create_rdb(entries) < 0)
+   {
+      fprintf(stderr, "Failed to create %s\n", BENCH_RDB_PATH);
+      return 1;
+   }
+
+   /* Original path: one filtered cursor pass per lookup */
+   start = cpu_features_get_time_usec();
+   for (i = 0; i < cursor_lookups; i++)
+      found += bench_cursor_lookup(bench_crc((i * 7919) % entries));
+   cursor_time = cpu_features_get_time_usec() - start;
+
+   printf("cursor : %u lookups, %u found, %10.1f us/lookup\n",
+         cursor_lookups, found, (double)cursor_time / cursor_lookups);
+
+   remove(BENCH_INDEX_PATH);
+
+   start      = cpu_features_get_time_usec();
+   idx        = rdb_index_open(BENCH_INDEX_PATH, paths, 1);
+   build_time = cpu_features_get_time_usec() - start;
+   rdb_index_free(idx);
+
+   start      = cpu_features_get_time_usec();
+   idx        = rdb_index_open(BENCH_INDEX_PATH, paths, 1);
+   load_time  = cpu_features_get_time_usec() - start;
+
+   if (!idx)
+   {
+      fprintf(stderr, "Failed to open index\n");
+      return 1;
+   }
+
+   printf("index  : build %.1f ms, reopen %.1f ms\n",
+         build_time / 1000.0, load_time / 1000.0);
+
+   /* Indexed path: probe, then read back the matching item */
+   db    = libretrodb_new();
+   cur   = libretrodb_cursor_new();
+   libretrodb_open(BENCH_RDB_PATH, db);
+   libretrodb_cursor_open(db, cur, NULL);
+
+   found = 0;
+   start = cpu_features_get_time_usec();
+   for (i = 0; i < entries; i++)
+   {
+      size_t j;
+      size_t n = rdb_index_find_crc(idx, 0,
+            bench_crc((i * 7919) % entries), offsets, 4);
+
+      for (j = 0; j < n; j++)
+      {
+         libretrodb_cursor_seek(cur, offsets[j]);
+         if (libretrodb_cursor_read_item(cur, &item) == 0)
+         {
+            found++;
+            rmsgpack_dom_value_free(&item);
+         }
+      }
+   }
+   probe_time = cpu_features_get_time_usec() - start;
+
+   printf("index  : %u lookups, %u found, %10.3f us/lookup\n",
+         entries, found, (double)probe_time / entries);
+
+   if (probe_time > 0 && cursor_lookups > 0)
+      printf("speedup: %.0fx\n",
+            ((double)cursor_time / cursor_lookups)
+            / ((double)probe_time / entries));
+
+   libretrodb_cursor_close(cur);
+   libretrodb_cursor_free(cur);
+   libretrodb_close(db);
+   libretrodb_free(db);
+
+   /* A changed database gets a new index, renamed over the old one
+    * while it is still mapped here, which stays readable */
+   if (found == entries)
+   {
+      rdb_index_t *rebuilt = NULL;
+      uint64_t offset      = 0;
+
+      bench_create_rdb(entries + 1);
+      rebuilt = rdb_index_open(BENCH_INDEX_PATH, paths, 1);
+
+      if (     !rebuilt
+            || rdb_index_find_crc(rebuilt, 0, bench_crc(entries), &offset, 1) != 1
+            || rdb_index_find_crc(idx, 0, bench_crc(entries), &offset, 1) != 0
+            || rdb_index_find_crc(idx, 0, bench_crc(0), &offset, 1) != 1)
+      {
+         fprintf(stderr, "Stale index was not rebuilt aside\n");
+         found = 0;
+      }
+      rdb_index_free(rebuilt);
+   }
+
+   rdb_index_free(idx);
+
+   remove(BENCH_INDEX_PATH);
+   remove(BENCH_RDB_PATH);
+
+   return found == entries ? 0 : 1;
+}
@@ -41,6 +41,7 @@
 #endif
 
 #include "cheat_manager.h"
+#include "savestate_pool.h"
 
 #include "../msg_hash.h"
 #include "../configuration.h"
@@ -1478,6 +1479,7 @@ void cheat_manager_apply_retro_cheats(void)
 #ifdef HAVE_CHEEVOS
          cheat_applied = true;
 #endif
+         savestate_pool_invalidate();
          for (repeat_iter = 1; repeat_iter <= cheat_st->cheats[i].repeat_count; repeat_iter++)
          {
             switch (bytes_per_item)
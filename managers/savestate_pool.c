@@ -0,0 +1,305 @@
+/*  RetroArch - A frontend for libretro.
+ *  Copyright (C) 2010-2014 - Hans-Kristian Arntzen
+ *  Copyright (C) 2011-2017 - Daniel De Matteis
+ *
+ *  RetroArch is free software: you can redistribute it and/or modify it under the terms
+ *  of the GNU General Public License as published by the Free Software Found-
+ *  ation, either version 3 of the License, or (at your option) any later version.
+ *
+ *  RetroArch is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ *  PURPOSE.  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with RetroArch.
+ *  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "savestate_pool.h"
+#include "../core.h"
+#include "../verbosity.h"
+
+/* Smallest size class. Anything above it is rounded up to a quarter
+ * of its power of two, so at most 25% of a buffer is wasted. */
+#define SAVESTATE_POOL_MIN_SHIFT   12
+#define SAVESTATE_POOL_CLASSES     (4 * (sizeof(size_t) * 8 - SAVESTATE_POOL_MIN_SHIFT) + 1)
+
+/* Free buffers kept per size class. Run-ahead, rewind and netplay
+ * rarely hold more than a couple at once. */
+#define SAVESTATE_POOL_MAX_FREE    4
+
+struct savestate_pool
+{
+   savestate_buf_t *free_list[SAVESTATE_POOL_CLASSES];
+   unsigned num_free[SAVESTATE_POOL_CLASSES];
+
+   /* Buffer holding the current core state, NULL if unknown */
+   savestate_buf_t *current;
+
+   struct savestate_pool_stats frame;
+   struct savestate_pool_stats last_frame;
+   struct savestate_pool_stats total;
+};
+
+static struct savestate_pool savestate_pool_st;
+
+/* Returns the size class for 'size', and its capacity in 'capacity'. */
+static unsigned savestate_pool_class(size_t size, size_t *capacity)
+{
+   size_t step;
+   size_t base     = (size_t)1 << SAVESTATE_POOL_MIN_SHIFT;
+   unsigned shift  = SAVESTATE_POOL_MIN_SHIFT;
+   unsigned quarter;
+
+   if (size <= base)
+   {
+      *capacity = base;
+      return 0;
+   }
+
+   while ((base << 1) < size && (base << 1) > base)
+   {
+      base <<= 1;
+      shift++;
+   }
+
+   step      = base >> 2;
+   quarter   = (unsigned)((size - base + step - 1) / step);
+   *capacity = base + quarter * step;
+
+   return 4 * (shift - SAVESTATE_POOL_MIN_SHIFT) + quarter;
+}
+
+static void savestate_pool_count(size_t serialized, size_t copied)
+{
+   struct savestate_pool *pool = &savestate_pool_st;
+
+   if (serialized)
+   {
+      pool->frame.serialize_calls++;
+      pool->frame.bytes_serialized += serialized;
+      pool->total.serialize_calls++;
+      pool->total.bytes_serialized += serialized;
+   }
+   else
+   {
+      pool->frame.reused++;
+      pool->frame.bytes_copied     += copied;
+      pool->total.reused++;
+      pool->total.bytes_copied     += copied;
+   }
+}
+
+/* Returns the current state if it can stand in for a state of 'size'
+ * bytes, NULL otherwise. */
+static savestate_buf_t *savestate_pool_current(size_t size, bool fast)
+{
+   savestate_buf_t *current = savestate_pool_st.current;
+
+   if (!current || current->size != size)
+      return NULL;
+   if (current->fast && !fast)
+      return NULL;
+
+   return current;
+}
+
+savestate_buf_t *savestate_pool_alloc(size_t size)
+{
+   size_t capacity;
+   savestate_buf_t *buf        = NULL;
+   struct savestate_pool *pool = &savestate_pool_st;
+   unsigned size_class         = savestate_pool_class(size, &capacity);
+
+   if (!size)
+      return NULL;
+
+   if ((buf = pool->free_list[size_class]))
+   {
+      pool->free_list[size_class] = buf->next;
+      pool->num_free[size_class]--;
+   }
+   else
+   {
+      if (!(buf = (savestate_buf_t*)malloc(sizeof(*buf))))
+         return NULL;
+
+      if (!(buf->data = (uint8_t*)malloc(capacity)))
+      {
+         free(buf);
+         return NULL;
+      }
+
+      buf->capacity   = capacity;
+      buf->size_class = size_class;
+   }
+
+   buf->size = size;
+   buf->refs = 1;
+   buf->fast = false;
+   buf->next = NULL;
+
+   return buf;
+}
+
+savestate_buf_t *savestate_buf_ref(savestate_buf_t *buf)
+{
+   if (buf)
+      buf->refs++;
+   return buf;
+}
+
+void savestate_buf_unref(savestate_buf_t *buf)
+{
+   struct savestate_pool *pool = &savestate_pool_st;
+
+   if (!buf || --buf->refs)
+      return;
+
+   if (pool->num_free[buf->size_class] >= SAVESTATE_POOL_MAX_FREE)
+   {
+      free(buf->data);
+      free(buf);
+      return;
+   }
+
+   buf->next                        = pool->free_list[buf->size_class];
+   pool->free_list[buf->size_class] = buf;
+   pool->num_free[buf->size_class]++;
+}
+
+savestate_buf_t *savestate_pool_snapshot(size_t size, bool fast)
+{
+   retro_ctx_serialize_info_t serial_info;
+   savestate_buf_t *buf = savestate_pool_current(size, fast);
+
+   if (buf)
+   {
+      savestate_pool_count(0, 0);
+      return savestate_buf_ref(buf);
+   }
+
+   if (!(buf = savestate_pool_alloc(size)))
+      return NULL;
+
+   serial_info.data_const = NULL;
+   serial_info.data       = buf->data;
+   serial_info.size       = size;
+
+   if (!core_serialize(&serial_info))
+   {
+      savestate_buf_unref(buf);
+      return NULL;
+   }
+
+   savestate_pool_count(size, 0);
+
+   buf->fast = fast;
+   savestate_pool_set_current(buf);
+
+   return buf;
+}
+
+bool savestate_pool_serialize_to(void *data, size_t size, bool fast)
+{
+   retro_ctx_serialize_info_t serial_info;
+   savestate_buf_t *buf = savestate_pool_current(size, fast);
+
+   if (buf)
+   {
+      memcpy(data, buf->data, size);
+      savestate_pool_count(0, size);
+      return true;
+   }
+
+   serial_info.data_const = NULL;
+   serial_info.data       = data;
+   serial_info.size       = size;
+
+   if (!core_serialize(&serial_info))
+      return false;
+
+   savestate_pool_count(size, 0);
+
+   return true;
+}
+
+void savestate_pool_set_current(savestate_buf_t *buf)
+{
+   struct savestate_pool *pool = &savestate_pool_st;
+
+   if (pool->current == buf)
+      return;
+
+   savestate_buf_ref(buf);
+   savestate_buf_unref(pool->current);
+   pool->current = buf;
+}
+
+void savestate_pool_invalidate(void)
+{
+   struct savestate_pool *pool = &savestate_pool_st;
+
+   if (!pool->current)
+      return;
+
+   savestate_buf_unref(pool->current);
+   pool->current = NULL;
+}
+
+void savestate_pool_frame_end(void)
+{
+   struct savestate_pool *pool = &savestate_pool_st;
+
+   pool->last_frame = pool->frame;
+   memset(&pool->frame, 0, sizeof(pool->frame));
+}
+
+void savestate_pool_get_stats(struct savestate_pool_stats *last_frame,
+      struct savestate_pool_stats *total)
+{
+   struct savestate_pool *pool = &savestate_pool_st;
+
+   if (last_frame)
+      *last_frame = pool->last_frame;
+   if (total)
+      *total      = pool->total;
+}
+
+void savestate_pool_deinit(void)
+{
+   unsigned i;
+   struct savestate_pool *pool = &savestate_pool_st;
+
+   if (pool->total.serialize_calls || pool->total.reused)
+      RARCH_LOG("[Savestate pool]: %u states serialized (%.1f MB), "
+            "%u reused (%.1f MB copied).\n",
+            pool->total.serialize_calls,
+            pool->total.bytes_serialized / (1024.0 * 1024.0),
+            pool->total.reused,
+            pool->total.bytes_copied / (1024.0 * 1024.0));
+
+   savestate_pool_invalidate();
+
+   for (i = 0; i < SAVESTATE_POOL_CLASSES; i++)
+   {
+      savestate_buf_t *buf = pool->free_list[i];
+
+      while (buf)
+      {
+         savestate_buf_t *next = buf->next;
+         free(buf->data);
+         free(buf);
+         buf = next;
+      }
+
+      pool->free_list[i] = NULL;
+      pool->num_free[i]  = 0;
+   }
+
+   memset(&pool->frame,      0, sizeof(pool->frame));
+   memset(&pool->last_frame, 0, sizeof(pool->last_frame));
+   memset(&pool->total,      0, sizeof(pool->total));
+}
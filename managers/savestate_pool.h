@@ -0,0 +1,151 @@
+/*  RetroArch - A frontend for libretro.
+ *  Copyright (C) 2010-2014 - Hans-Kristian Arntzen
+ *  Copyright (C) 2011-2017 - Daniel De Matteis
+ *
+ *  RetroArch is free software: you can redistribute it and/or modify it under the terms
+ *  of the GNU General Public License as published by the Free Software Found-
+ *  ation, either version 3 of the License, or (at your option) any later version.
+ *
+ *  RetroArch is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ *  PURPOSE.  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with RetroArch.
+ *  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __SAVESTATE_POOL_H
+#define __SAVESTATE_POOL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <boolean.h>
+#include <retro_common_api.h>
+
+RETRO_BEGIN_DECLS
+
+/* Reference counted savestate buffers shared between run-ahead,
+ * rewind and netplay.
+ *
+ * Buffers are recycled through per size class free lists, so that
+ * consumers serializing every frame don't hit the allocator. The pool
+ * also remembers which buffer matches the current core state: as long
+ * as the core hasn't run since that buffer was saved or loaded, asking
+ * for the core state again hands out that buffer (or a copy of it)
+ * instead of serializing the core a second time.
+ *
+ * The pool is not thread safe; only use it from the main thread. */
+
+typedef struct savestate_buf
+{
+   uint8_t *data;
+   size_t size;
+   size_t capacity;
+   unsigned refs;
+   unsigned size_class;
+   /* Was saved with request_fast_savestate set */
+   bool fast;
+   struct savestate_buf *next;
+} savestate_buf_t;
+
+struct savestate_pool_stats
+{
+   /* Calls into the core's retro_serialize() */
+   unsigned serialize_calls;
+   /* Requests served from the current state without serializing */
+   unsigned reused;
+   uint64_t bytes_serialized;
+   /* Bytes copied out of a reused state */
+   uint64_t bytes_copied;
+};
+
+/**
+ * savestate_pool_alloc:
+ * @size                 : size of the savestate in bytes.
+ *
+ * Returns: a buffer of @size bytes with a single reference, or NULL.
+ * Its contents are undefined.
+ **/
+savestate_buf_t *savestate_pool_alloc(size_t size);
+
+savestate_buf_t *savestate_buf_ref(savestate_buf_t *buf);
+
+/**
+ * savestate_buf_unref:
+ * @buf                  : buffer to release, may be NULL.
+ *
+ * Drops a reference to @buf, returning it to the pool once the
+ * last one is gone.
+ **/
+void savestate_buf_unref(savestate_buf_t *buf);
+
+/**
+ * savestate_pool_snapshot:
+ * @size                 : savestate size in bytes.
+ * @fast                 : whether a fast savestate will do; those must
+ *                         not leave this RetroArch instance.
+ *
+ * Gets the current core state without copying it if it is already
+ * known, serializing the core otherwise. The buffer may be shared and
+ * must not be written to.
+ *
+ * Returns: a new reference to the state, or NULL if serializing failed.
+ **/
+savestate_buf_t *savestate_pool_snapshot(size_t size, bool fast);
+
+/**
+ * savestate_pool_serialize_to:
+ * @data                 : destination.
+ * @size                 : savestate size in bytes.
+ * @fast                 : whether a fast savestate will do.
+ *
+ * Writes the current core state to @data, copying it if it is already
+ * known and serializing the core otherwise.
+ *
+ * Returns: true on success.
+ **/
+bool savestate_pool_serialize_to(void *data, size_t size, bool fast);
+
+/**
+ * savestate_pool_set_current:
+ * @buf                  : buffer the core state was just loaded from.
+ *
+ * Records that the core state matches @buf again.
+ **/
+void savestate_pool_set_current(savestate_buf_t *buf);
+
+/**
+ * savestate_pool_invalidate:
+ *
+ * Forgets the current core state. Call whenever the core runs, resets,
+ * loads a state from elsewhere or has its memory poked.
+ **/
+void savestate_pool_invalidate(void);
+
+/**
+ * savestate_pool_frame_end:
+ *
+ * Closes the counters of the current frame.
+ **/
+void savestate_pool_frame_end(void);
+
+/**
+ * savestate_pool_get_stats:
+ * @last_frame           : counters of the last complete frame, or NULL.
+ * @total                : counters since the pool was last freed, or NULL.
+ **/
+void savestate_pool_get_stats(struct savestate_pool_stats *last_frame,
+      struct savestate_pool_stats *total);
+
+/**
+ * savestate_pool_deinit:
+ *
+ * Releases the free lists and resets the counters. Buffers still
+ * referenced stay valid.
+ **/
+void savestate_pool_deinit(void);
+
+RETRO_END_DECLS
+
+#endif
@@ -25,9 +25,22 @@
 
 #include <retro_inline.h>
 #include <compat/strl.h>
-#include <compat/intrinsics.h>
+#include <file/file_path.h>
+#include <string/stdstring.h>
+#include <memmap.h>
+
+#ifdef HAVE_MMAN
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef HAVE_ZLIB
+#include <streams/trans_stream.h>
+#endif
 
 #include "state_manager.h"
+#include "state_manager_diff.h"
+#include "savestate_pool.h"
 #include "../msg_hash.h"
 #include "../core.h"
 #include "../retroarch.h"
@@ -45,24 +58,34 @@
 #define UINT16_MAX 0xffff
 #endif
 
-#ifndef UINT32_MAX
-#define UINT32_MAX 0xffffffffu
-#endif
+#ifdef HAVE_THREADS
+#include <rthreads/tpool.h>
 
-#if defined(__x86_64__) || defined(__i386__) || defined(__i486__) || defined(__i686__) || defined(_M_IX86) || defined(_M_AMD64) || defined(_M_X64)
-#define CPU_X86
-#endif
+/* Smallest range of the savestate diffed by a single worker job. */
+#define STATE_MANAGER_MIN_DIFF_BLOCK (64 * 1024)
 
-/* Other arches SIGBUS (usually) on unaligned accesses. */
-#ifndef CPU_X86
-#define NO_UNALIGNED_MEM
-#endif
+/* Diff jobs queued per worker thread, so that a slow range
+ * doesn't leave the other workers idle. */
+#define STATE_MANAGER_DIFF_BLOCKS_PER_THREAD 4
 
-#if __SSE2__
-#include <emmintrin.h>
+struct state_manager_diff_block
+{
+   const uint16_t *old16;
+   const uint16_t *new16;
+   uint16_t *out;
+   /* Offset of this range in the savestate, in uint16s. */
+   size_t start16;
+   size_t num16s;
+   /* Offset of this range's output in the patch, in bytes. */
+   size_t out_offset;
+   size_t out_len;
+   size_t trailing;
+};
 #endif
 
-struct state_manager
+/* A ring of variable sized records, see the format description
+ * below. */
+struct state_manager_ring
 {
    uint8_t *data;
    size_t capacity;
@@ -70,6 +93,15 @@ struct state_manager
    uint8_t *head;
    /* If head comes close to this, discard a frame. */
    uint8_t *tail;
+   /* Largest record, including the offsets around it. */
+   size_t maxsize;
+   /* Set if 'data' is a mapped file rather than malloc()ed. */
+   bool mapped;
+};
+
+struct state_manager
+{
+   struct state_manager_ring ring;
 
    uint8_t *thisblock;
    uint8_t *nextblock;
@@ -77,13 +109,30 @@ struct state_manager
    /* This one is rounded up from reset::blocksize. */
    size_t blocksize;
 
-   /* size_t + (blocksize + 131071) / 131072 *
-    * (blocksize + u16 + u16) + u16 + u32 + size_t
-    * (yes, the math is a bit ugly). */
-   size_t maxcompsize;
-
    unsigned entries;
    bool thisblock_valid;
+#ifdef HAVE_ZLIB
+   /* Patches dropped from the tail of 'ring' are deflated into
+    * 'archive', and inflated into 'archive_patch' when rewinding
+    * past the start of 'ring'. */
+   struct state_manager_ring archive;
+   const struct trans_stream_backend *deflate_backend;
+   const struct trans_stream_backend *inflate_backend;
+   void *deflate_stream;
+   void *inflate_stream;
+   uint8_t *archive_patch;
+#endif
+#ifdef HAVE_THREADS
+   /* With a worker pool, the diff of the last push runs in the
+    * background against 'prevblock' while the core serializes the
+    * next state into 'nextblock'. */
+   tpool_t *pool;
+   struct state_manager_diff_block *diff_blocks;
+   unsigned num_diff_blocks;
+   uint8_t *prevblock;
+   /* Patch being written by the workers, NULL if none is pending. */
+   uint8_t *pending;
+#endif
 #if STRICT_BUF_SIZE
    size_t debugsize;
    uint8_t *debugblock;
@@ -121,292 +170,442 @@ size thisstart;
 static struct state_manager_rewind_state rewind_state;
 static bool frame_is_reversed                         = false;
 
-/* There's no equivalent in libc, you'd think so ...
- * std::mismatch exists, but it's not optimized at all. */
-static size_t find_change(const uint16_t *a, const uint16_t *b)
+/* The start offsets point to 'nextstart' of any given compressed frame.
+ * Each uint16 is stored native endian; anything that claims any other
+ * endianness refers to the endianness of this specific item.
+ * The uint32 is stored little endian.
+ *
+ * Each size value is stored native endian if alignment is not enforced;
+ * if it is, they're little endian.
+ *
+ * The start of the buffer contains a size pointing to the end of the
+ * buffer; the end points to its start.
+ *
+ * Wrapping is handled by returning to the start of the buffer if the
+ * compressed data could potentially hit the edge;
+ *
+ * if the compressed data could potentially overwrite the tail pointer,
+ * the tail retreats until it can no longer collide.
+ *
+ * This means that on average, ~2 * maxsize is
+ * unused at any given moment. */
+
+/* These are called very few constant times per frame,
+ * keep it as simple as possible. */
+static INLINE void write_size_t(void *ptr, size_t val)
 {
-#if __SSE2__
-   const __m128i *a128 = (const __m128i*)a;
-   const __m128i *b128 = (const __m128i*)b;
+   memcpy(ptr, &val, sizeof(val));
+}
 
-   for (;;)
+static INLINE size_t read_size_t(const void *ptr)
+{
+   size_t ret;
+
+   memcpy(&ret, ptr, sizeof(ret));
+   return ret;
+}
+
+#ifdef HAVE_THREADS
+static void state_manager_diff_block_run(void *data)
+{
+   struct state_manager_diff_block *block =
+      (struct state_manager_diff_block*)data;
+
+   block->out_len = state_manager_raw_compress_range(
+         block->old16, block->new16, block->num16s,
+         block->out, &block->trailing);
+}
+
+/* Splits the savestate into ranges for the diff workers. Each range
+ * gets room for its own worst case output in the patch, plus a skip
+ * record carried over from the previous range.
+ *
+ * Returns the maximum size of a joined patch. */
+static size_t state_manager_diff_blocks_init(state_manager_t *state,
+      unsigned threads)
+{
+   unsigned i;
+   size_t num16s     = state->blocksize / sizeof(uint16_t);
+   size_t block_size = state->blocksize /
+      (threads * STATE_MANAGER_DIFF_BLOCKS_PER_THREAD);
+   size_t offset     = 0;
+
+   if (block_size < STATE_MANAGER_MIN_DIFF_BLOCK)
+      block_size = STATE_MANAGER_MIN_DIFF_BLOCK;
+   block_size  = (block_size + 15) & -(size_t)16;
+
+   state->num_diff_blocks = (unsigned)
+      ((state->blocksize + block_size - 1) / block_size);
+   state->diff_blocks     = (struct state_manager_diff_block*)
+      calloc(state->num_diff_blocks, sizeof(*state->diff_blocks));
+
+   if (!state->diff_blocks)
+      return 0;
+
+   for (i = 0; i < state->num_diff_blocks; i++)
    {
-      __m128i v0    = _mm_loadu_si128(a128);
-      __m128i v1    = _mm_loadu_si128(b128);
-      __m128i c     = _mm_cmpeq_epi32(v0, v1);
-      uint32_t mask = _mm_movemask_epi8(c);
+      struct state_manager_diff_block *block = &state->diff_blocks[i];
 
-      if (mask != 0xffff) /* Something has changed, figure out where. */
-      {
-         size_t ret = (((uint8_t*)a128 - (uint8_t*)a) |
-               (compat_ctz(~mask))) >> 1;
-         return ret | (a[ret] == b[ret]);
-      }
+      block->start16    = i * (block_size / sizeof(uint16_t));
+      block->num16s     = num16s - block->start16;
+      if (block->num16s > block_size / sizeof(uint16_t))
+         block->num16s  = block_size / sizeof(uint16_t);
+      block->out_offset = offset;
 
-      a128++;
-      b128++;
+      offset           += state_manager_raw_maxsize(
+            block->num16s * sizeof(uint16_t)) + sizeof(uint16_t) * 3;
    }
-#else
-   const uint16_t *a_org = a;
-#ifdef NO_UNALIGNED_MEM
-   while (((uintptr_t)a & (sizeof(size_t) - 1)) && *a == *b)
+
+   return offset + sizeof(uint16_t) * 3;
+}
+
+/* Queues the diff of 'thisblock' against 'nextblock' into 'patch'. */
+static void state_manager_diff_start(state_manager_t *state, uint8_t *patch)
+{
+   unsigned i;
+   const uint16_t *old16 = (const uint16_t*)state->thisblock;
+   const uint16_t *new16 = (const uint16_t*)state->nextblock;
+
+   for (i = 0; i < state->num_diff_blocks; i++)
    {
-      a++;
-      b++;
+      struct state_manager_diff_block *block = &state->diff_blocks[i];
+
+      block->old16 = old16 + block->start16;
+      block->new16 = new16 + block->start16;
+      block->out   = (uint16_t*)(patch + block->out_offset);
+
+      tpool_add_work(state->pool, state_manager_diff_block_run, block);
    }
-   if (*a == *b)
-#endif
+
+   state->pending = patch;
+}
+
+/* Moves the output of each range down to the end of the previous one.
+ * Unchanged data at the end of a range is folded into the skip of the
+ * next range's first record, or written as a separate skip record.
+ *
+ * Returns the number of bytes in the joined patch. */
+static size_t state_manager_diff_join(state_manager_t *state, uint8_t *patch)
+{
+   unsigned i;
+   size_t carry  = 0;
+   uint16_t *out = (uint16_t*)patch;
+
+   for (i = 0; i < state->num_diff_blocks; i++)
    {
-      const size_t *a_big = (const size_t*)a;
-      const size_t *b_big = (const size_t*)b;
+      struct state_manager_diff_block *block = &state->diff_blocks[i];
 
-      while (*a_big == *b_big)
+      if (block->out_len)
       {
-         a_big++;
-         b_big++;
-      }
-      a = (const uint16_t*)a_big;
-      b = (const uint16_t*)b_big;
+         if (carry)
+         {
+            if (block->out[0] && block->out[1] + carry <= UINT16_MAX)
+               block->out[1] += carry;
+            else
+            {
+               *out++ = 0;
+               *out++ = carry;
+               *out++ = carry >> 16;
+            }
+            carry = 0;
+         }
 
-      while (*a == *b)
-      {
-         a++;
-         b++;
+         memmove(out, block->out, block->out_len);
+         out = (uint16_t*)((uint8_t*)out + block->out_len);
       }
+
+      carry += block->trailing;
    }
-   return a - a_org;
-#endif
+
+   out[0] = 0;
+   out[1] = 0;
+   out[2] = 0;
+
+   return (uint8_t*)(out + 3) - patch;
 }
+#endif
+
+typedef void (*state_manager_drop_t)(state_manager_t *state,
+      const uint8_t *record);
 
-static size_t find_same(const uint16_t *a, const uint16_t *b)
+/* Maps an unlinked file of 'size' bytes at 'path', so that the ring
+ * is kept in the page cache instead of anonymous memory. */
+static uint8_t *state_manager_map_file(const char *path, size_t size)
 {
-   const uint16_t *a_org = a;
-#ifdef NO_UNALIGNED_MEM
-   if (((uintptr_t)a & (sizeof(uint32_t) - 1)) && *a != *b)
+   uint8_t *data = NULL;
+#ifdef HAVE_MMAN
+   int fd        = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+
+   if (fd < 0)
+      return NULL;
+
+   /* Only the mapping keeps the file around, so it is gone
+    * once rewind is deinitialized or RetroArch exits. */
+   unlink(path);
+
+   /* Reserve the blocks up front; writing to a sparse mapping
+    * on a full disk raises SIGBUS. */
+#if defined(__linux__)
+   if (posix_fallocate(fd, 0, (off_t)size) == 0)
+#else
+   if (ftruncate(fd, (off_t)size) == 0)
+#endif
    {
-      a++;
-      b++;
+      data = (uint8_t*)mmap(NULL, size, PROT_READ | PROT_WRITE,
+            MAP_SHARED, fd, 0);
+      if ((void*)data == MAP_FAILED)
+         data = NULL;
    }
-   if (*a != *b)
+
+   close(fd);
 #endif
-   {
-      /* With this, it's random whether two consecutive identical
-       * words are caught.
-       *
-       * Luckily, compression rate is the same for both cases, and
-       * three is always caught.
-       *
-       * (We prefer to miss two-word blocks, anyways; fewer iterations
-       * of the outer loop, as well as in the decompressor.) */
-      const uint32_t *a_big = (const uint32_t*)a;
-      const uint32_t *b_big = (const uint32_t*)b;
-
-      while (*a_big != *b_big)
-      {
-         a_big++;
-         b_big++;
-      }
-      a = (const uint16_t*)a_big;
-      b = (const uint16_t*)b_big;
+   return data;
+}
 
-      if (a != a_org && a[-1] == b[-1])
-      {
-         a--;
-         b--;
-      }
+static bool state_manager_ring_init(struct state_manager_ring *ring,
+      size_t capacity, size_t maxsize, const char *path)
+{
+   ring->data     = NULL;
+   ring->mapped   = false;
+
+   if (!string_is_empty(path))
+   {
+      if ((ring->data = state_manager_map_file(path, capacity)))
+         ring->mapped = true;
+      else
+         RARCH_WARN("[Rewind]: Failed to map \"%s\", "
+               "keeping the buffer in memory.\n", path);
    }
-   return a - a_org;
+
+   if (!ring->data)
+      ring->data  = (uint8_t*)malloc(capacity);
+
+   if (!ring->data)
+      return false;
+
+   ring->capacity = capacity;
+   ring->maxsize  = maxsize;
+   ring->head     = ring->data + sizeof(size_t);
+   ring->tail     = ring->data + sizeof(size_t);
+
+   return true;
 }
 
-/* Returns the maximum compressed size of a savestate.
- * It is very likely to compress to far less. */
-static size_t state_manager_raw_maxsize(size_t uncomp)
+static void state_manager_ring_free(struct state_manager_ring *ring)
 {
-   /* bytes covered by a compressed block */
-   const int maxcblkcover = UINT16_MAX * sizeof(uint16_t);
-   /* uncompressed size, rounded to 16 bits */
-   size_t uncomp16        = (uncomp + sizeof(uint16_t) - 1) & -sizeof(uint16_t);
-   /* number of blocks */
-   size_t maxcblks        = (uncomp + maxcblkcover - 1) / maxcblkcover;
-   return uncomp16 + maxcblks * sizeof(uint16_t) * 2 /* two u16 overhead per block */ + sizeof(uint16_t) *
-      3; /* three u16 to end it */
-}
+   if (!ring->data)
+      return;
 
-/*
- * See state_manager_raw_compress for information about this.
- * When you're done with it, send it to free().
- */
-static void *state_manager_raw_alloc(size_t len, uint16_t uniq)
-{
-   size_t  len16 = (len + sizeof(uint16_t) - 1) & -sizeof(uint16_t);
-   uint16_t *ret = (uint16_t*)calloc(len16 + sizeof(uint16_t) * 4 + 16, 1);
-
-   /* Force in a different byte at the end, so we don't need to check
-    * bounds in the innermost loop (it's expensive).
-    *
-    * There is also a large amount of data that's the same, to stop
-    * the other scan.
-    *
-    * There is also some padding at the end. This is so we don't
-    * read outside the buffer end if we're reading in large blocks;
-    *
-    * It doesn't make any difference to us, but sacrificing 16 bytes to get
-    * Valgrind happy is worth it. */
-   ret[len16/sizeof(uint16_t) + 3] = uniq;
+#ifdef HAVE_MMAN
+   if (ring->mapped)
+      munmap(ring->data, ring->capacity);
+   else
+#endif
+      free(ring->data);
 
-   return ret;
+   ring->data = NULL;
 }
 
-/*
- * Takes two savestates and creates a patch that turns 'src' into 'dst'.
- * Both 'src' and 'dst' must be returned from state_manager_raw_alloc(),
- * with the same 'len', and different 'uniq'.
+/* Discards the oldest record, after handing it to 'drop'. */
+static void state_manager_ring_drop(state_manager_t *state,
+      struct state_manager_ring *ring, state_manager_drop_t drop)
+{
+   if (drop)
+      drop(state, ring->tail + sizeof(size_t));
+   ring->tail = ring->data + read_size_t(ring->tail);
+}
+
+/* Makes room for a record of up to ring->maxsize bytes at the head,
+ * discarding the oldest ones as needed.
  *
- * 'patch' must be size 'state_manager_raw_maxsize(len)' or more.
- * Returns the number of bytes actually written to 'patch'.
- */
-static size_t state_manager_raw_compress(const void *src,
-      const void *dst, size_t len, void *patch)
+ * Returns where the record goes, or NULL if the ring is too small.
+ * It must fit two records, or wrapping around could overwrite the
+ * only one. */
+static uint8_t *state_manager_ring_reserve(state_manager_t *state,
+      struct state_manager_ring *ring, state_manager_drop_t drop)
 {
-   const uint16_t  *old16 = (const uint16_t*)src;
-   const uint16_t  *new16 = (const uint16_t*)dst;
-   uint16_t *compressed16 = (uint16_t*)patch;
-   size_t          num16s = (len + sizeof(uint16_t) - 1)
-      / sizeof(uint16_t);
+   if (ring->capacity < sizeof(size_t) + ring->maxsize * 2)
+      return NULL;
 
-   while (num16s)
+   for (;;)
    {
-      size_t i, changed;
-      size_t skip = find_change(old16, new16);
+      size_t headpos   = ring->head - ring->data;
+      size_t tailpos   = ring->tail - ring->data;
+      size_t remaining = (tailpos + ring->capacity -
+            sizeof(size_t) - headpos - 1) % ring->capacity + 1;
 
-      if (skip >= num16s)
+      if (remaining > ring->maxsize)
          break;
 
-      old16  += skip;
-      new16  += skip;
-      num16s -= skip;
+      state_manager_ring_drop(state, ring, drop);
+   }
 
-      if (skip > UINT16_MAX)
-      {
-         if (skip > UINT32_MAX)
-         {
-            /* This will make it scan the entire thing again,
-             * but it only hits on 8GB unchanged data anyways,
-             * and if you're doing that, you've got bigger problems. */
-            skip = UINT32_MAX;
-         }
-         *compressed16++ = 0;
-         *compressed16++ = skip;
-         *compressed16++ = skip >> 16;
-         continue;
-      }
+   return ring->head + sizeof(size_t);
+}
 
-      changed = find_same(old16, new16);
-      if (changed > UINT16_MAX)
-         changed = UINT16_MAX;
+/* Links the record ending at 'end' into the ring. */
+static void state_manager_ring_commit(state_manager_t *state,
+      struct state_manager_ring *ring, uint8_t *end,
+      state_manager_drop_t drop)
+{
+   if (end - ring->data + ring->maxsize > ring->capacity)
+   {
+      end = ring->data;
+      if (ring->tail == ring->data + sizeof(size_t))
+         state_manager_ring_drop(state, ring, drop);
+   }
+   write_size_t(end, ring->head - ring->data);
+   end += sizeof(size_t);
+   write_size_t(ring->head, end - ring->data);
+   ring->head = end;
+}
 
-      *compressed16++ = changed;
-      *compressed16++ = skip;
+/* Removes the newest record.
+ *
+ * Returns the record, or NULL if the ring is empty. */
+static const uint8_t *state_manager_ring_pop(struct state_manager_ring *ring)
+{
+   size_t start;
 
-      for (i = 0; i < changed; i++)
-         compressed16[i] = old16[i];
+   if (ring->head == ring->tail)
+      return NULL;
 
-      old16 += changed;
-      new16 += changed;
-      num16s -= changed;
-      compressed16 += changed;
-   }
+   start      = read_size_t(ring->head - sizeof(size_t));
+   ring->head = ring->data + start;
 
-   compressed16[0] = 0;
-   compressed16[1] = 0;
-   compressed16[2] = 0;
+   return ring->data + start + sizeof(size_t);
+}
 
-   return (uint8_t*)(compressed16+3) - (uint8_t*)patch;
+#ifdef HAVE_ZLIB
+/* Empties the archive. Its records are patches that only apply on
+ * top of each other, so once one is lost, the older ones are too. */
+static void state_manager_archive_clear(state_manager_t *state)
+{
+   state->archive.head = state->archive.data + sizeof(size_t);
+   state->archive.tail = state->archive.head;
 }
 
-/*
- * Takes 'patch' from a previous call to 'state_manager_raw_compress'
- * and applies it to 'data' ('src' from that call),
- * yielding 'dst' in that call.
- *
- * If the given arguments do not match a previous call to
- * state_manager_raw_compress(), anything at all can happen.
- */
-static void state_manager_raw_decompress(const void *patch,
-      size_t patchlen, void *data, size_t datalen)
+/* Replaces a stream an error left mid-way, which would otherwise
+ * carry that half-done patch over into the next one. Without a
+ * stream, the archive is dropped. */
+static bool state_manager_archive_renew(state_manager_t *state,
+      const struct trans_stream_backend *backend, void **stream)
 {
-   uint16_t         *out16 = (uint16_t*)data;
-   const uint16_t *patch16 = (const uint16_t*)patch;
+   backend->stream_free(*stream);
 
-   (void)patchlen;
-   (void)datalen;
+   if (!(*stream = backend->stream_new()))
+   {
+      RARCH_WARN("[Rewind]: Failed to reset the archive stream.\n");
+      state_manager_ring_free(&state->archive);
+      return false;
+   }
 
-   for (;;)
+   if (backend == state->deflate_backend)
+      backend->define(*stream, "level", 1);
+   return true;
+}
+
+/* Deflates a patch dropped from the main ring into the archive.
+ * The archive is a ring of its own, so that its oldest entries are
+ * discarded once it's full. Each record is the deflated size as a
+ * uint32, followed by the deflated patch. */
+static void state_manager_archive_push(state_manager_t *state,
+      const uint8_t *patch)
+{
+   uint32_t rd, wn;
+   enum trans_stream_error error;
+   uint8_t *out = state_manager_ring_reserve(state, &state->archive, NULL);
+
+   if (!out)
+      return;
+
+   state->deflate_backend->set_in(state->deflate_stream, patch,
+         (uint32_t)state_manager_raw_patch_size(patch));
+   state->deflate_backend->set_out(state->deflate_stream,
+         out + sizeof(uint32_t), (uint32_t)(state->archive.maxsize
+            - sizeof(size_t) * 2 - sizeof(uint32_t)));
+
+   if (!state->deflate_backend->trans(state->deflate_stream, true,
+            &rd, &wn, &error) || error != TRANS_STREAM_ERROR_NONE)
    {
-      uint16_t numchanged = *(patch16++);
+      /* Older entries no longer connect to the main ring */
+      state_manager_archive_clear(state);
+      state_manager_archive_renew(state, state->deflate_backend,
+            &state->deflate_stream);
+      return;
+   }
 
-      if (numchanged)
-      {
-         uint16_t i;
+   memcpy(out, &wn, sizeof(wn));
+   state_manager_ring_commit(state, &state->archive,
+         out + sizeof(uint32_t) + wn, NULL);
+}
 
-         out16 += *patch16++;
+/* Returns the newest archived patch, or NULL if there is none. */
+static const uint8_t *state_manager_archive_pop(state_manager_t *state)
+{
+   uint32_t len, rd, wn;
+   enum trans_stream_error error;
+   const uint8_t *record;
 
-         /* We could do memcpy, but it seems that memcpy has a
-          * constant-per-call overhead that actually shows up.
-          *
-          * Our average size in here seems to be 8 or something.
-          * Therefore, we do something with lower overhead. */
-         for (i = 0; i < numchanged; i++)
-            out16[i] = patch16[i];
+   if (!state->archive.data)
+      return NULL;
 
-         patch16 += numchanged;
-         out16 += numchanged;
-      }
-      else
-      {
-         uint32_t numunchanged = patch16[0] | (patch16[1] << 16);
+   if (!(record = state_manager_ring_pop(&state->archive)))
+      return NULL;
 
-         if (!numunchanged)
-            break;
-         patch16 += 2;
-         out16 += numunchanged;
-      }
+   memcpy(&len, record, sizeof(len));
+
+   state->inflate_backend->set_in(state->inflate_stream,
+         record + sizeof(uint32_t), len);
+   state->inflate_backend->set_out(state->inflate_stream,
+         state->archive_patch, (uint32_t)(state->ring.maxsize));
+
+   if (!state->inflate_backend->trans(state->inflate_stream, true,
+            &rd, &wn, &error) || error != TRANS_STREAM_ERROR_NONE)
+   {
+      /* Older entries only apply on top of this one */
+      state_manager_archive_clear(state);
+      state_manager_archive_renew(state, state->inflate_backend,
+            &state->inflate_stream);
+      return NULL;
    }
+
+   return state->archive_patch;
 }
 
-/* The start offsets point to 'nextstart' of any given compressed frame.
- * Each uint16 is stored native endian; anything that claims any other
- * endianness refers to the endianness of this specific item.
- * The uint32 is stored little endian.
- *
- * Each size value is stored native endian if alignment is not enforced;
- * if it is, they're little endian.
- *
- * The start of the buffer contains a size pointing to the end of the
- * buffer; the end points to its start.
- *
- * Wrapping is handled by returning to the start of the buffer if the
- * compressed data could potentially hit the edge;
- *
- * if the compressed data could potentially overwrite the tail pointer,
- * the tail retreats until it can no longer collide.
- *
- * This means that on average, ~2 * maxcompsize is
- * unused at any given moment. */
+/* Worst case deflate output for 'len' bytes, with some slack for the
+ * zlib header and trailer. */
+static size_t state_manager_archive_maxsize(size_t len)
+{
+   return len + (len >> 8) + 64;
+}
+#endif
 
-/* These are called very few constant times per frame,
- * keep it as simple as possible. */
-static INLINE void write_size_t(void *ptr, size_t val)
+/* Called for each patch dropped from the tail of the main ring. */
+static void state_manager_drop(state_manager_t *state,
+      const uint8_t *patch)
 {
-   memcpy(ptr, &val, sizeof(val));
+#ifdef HAVE_ZLIB
+   if (state->archive.data)
+      state_manager_archive_push(state, patch);
+#endif
+   state->entries--;
 }
 
-static INLINE size_t read_size_t(const void *ptr)
+/* Waits for the diff of the last push, if any, and commits it. */
+static void state_manager_push_wait(state_manager_t *state)
 {
-   size_t ret;
+#ifdef HAVE_THREADS
+   if (!state->pending)
+      return;
 
-   memcpy(&ret, ptr, sizeof(ret));
-   return ret;
+   tpool_wait(state->pool);
+
+   state_manager_ring_commit(state, &state->ring, state->pending +
+         state_manager_diff_join(state, state->pending),
+         state_manager_drop);
+   state->pending = NULL;
+#endif
 }
 
 static void state_manager_free(state_manager_t *state)
@@ -414,8 +613,31 @@ static void state_manager_free(state_manager_t *state)
    if (!state)
       return;
 
-   if (state->data)
-      free(state->data);
+#ifdef HAVE_THREADS
+   if (state->pool)
+      tpool_destroy(state->pool);
+   if (state->diff_blocks)
+      free(state->diff_blocks);
+   if (state->prevblock)
+      free(state->prevblock);
+   state->pool        = NULL;
+   state->diff_blocks = NULL;
+   state->prevblock   = NULL;
+   state->pending     = NULL;
+#endif
+#ifdef HAVE_ZLIB
+   state_manager_ring_free(&state->archive);
+   if (state->deflate_stream)
+      state->deflate_backend->stream_free(state->deflate_stream);
+   if (state->inflate_stream)
+      state->inflate_backend->stream_free(state->inflate_stream);
+   if (state->archive_patch)
+      free(state->archive_patch);
+   state->deflate_stream = NULL;
+   state->inflate_stream = NULL;
+   state->archive_patch  = NULL;
+#endif
+   state_manager_ring_free(&state->ring);
    if (state->thisblock)
       free(state->thisblock);
    if (state->nextblock)
@@ -425,46 +647,126 @@ static void state_manager_free(state_manager_t *state)
       free(state->debugblock);
    state->debugblock = NULL;
 #endif
-   state->data       = NULL;
    state->thisblock  = NULL;
    state->nextblock  = NULL;
 }
 
-static state_manager_t *state_manager_new(size_t state_size, size_t buffer_size)
+#ifdef HAVE_ZLIB
+static bool state_manager_archive_init(state_manager_t *state,
+      size_t archive_size, const char *archive_path)
+{
+   state->deflate_backend = trans_stream_get_zlib_deflate_backend();
+   state->inflate_backend = trans_stream_get_zlib_inflate_backend();
+
+   if (!state->deflate_backend || !state->inflate_backend)
+      return false;
+
+   state->deflate_stream  = state->deflate_backend->stream_new();
+   state->inflate_stream  = state->inflate_backend->stream_new();
+   state->archive_patch   = (uint8_t*)malloc(state->ring.maxsize);
+
+   if (!state->deflate_stream || !state->inflate_stream
+         || !state->archive_patch)
+      return false;
+
+   /* Archiving runs on the main thread whenever the main ring is
+    * full, favour speed over ratio. */
+   state->deflate_backend->define(state->deflate_stream, "level", 1);
+
+   return state_manager_ring_init(&state->archive, archive_size,
+         state_manager_archive_maxsize(state->ring.maxsize)
+         + sizeof(uint32_t), archive_path);
+}
+#endif
+
+/**
+ * state_manager_new:
+ * @state_size           : size of a savestate in bytes.
+ * @buffer_size          : size of the main ring in bytes.
+ * @archive_size         : size of the deflated archive of older
+ *                         patches in bytes, 0 to disable it.
+ * @threads              : number of diff worker threads.
+ * @dir                  : directory to map the rings from, NULL or
+ *                         empty to keep them in memory.
+ **/
+static state_manager_t *state_manager_new(size_t state_size,
+      size_t buffer_size, size_t archive_size, unsigned threads,
+      const char *dir)
 {
    size_t max_comp_size, block_size;
+   char ring_path[PATH_MAX_LENGTH];
+   char archive_path[PATH_MAX_LENGTH];
    uint8_t *next_block    = NULL;
    uint8_t *this_block    = NULL;
-   uint8_t *state_data    = NULL;
    state_manager_t *state = (state_manager_t*)calloc(1, sizeof(*state));
 
    if (!state)
       return NULL;
 
+   ring_path[0]       = '\0';
+   archive_path[0]    = '\0';
+
+   if (!string_is_empty(dir))
+   {
+      fill_pathname_join(ring_path, dir,
+            "rewind.ring", sizeof(ring_path));
+      fill_pathname_join(archive_path, dir,
+            "rewind_archive.ring", sizeof(archive_path));
+   }
+
    block_size         = (state_size + sizeof(uint16_t) - 1) & -sizeof(uint16_t);
 
    /* the compressed data is surrounded by pointers to the other side */
    max_comp_size      = state_manager_raw_maxsize(state_size) + sizeof(size_t) * 2;
-   state_data         = (uint8_t*)malloc(buffer_size);
 
-   if (!state_data)
-      goto error;
+   this_block         = (uint8_t*)state_manager_raw_alloc(state_size);
+   next_block         = (uint8_t*)state_manager_raw_alloc(state_size);
 
-   this_block         = (uint8_t*)state_manager_raw_alloc(state_size, 0);
-   next_block         = (uint8_t*)state_manager_raw_alloc(state_size, 1);
+   state->blocksize   = block_size;
+   state->thisblock   = this_block;
+   state->nextblock   = next_block;
 
    if (!this_block || !next_block)
       goto error;
 
-   state->blocksize   = block_size;
-   state->maxcompsize = max_comp_size;
-   state->data        = state_data;
-   state->thisblock   = this_block;
-   state->nextblock   = next_block;
-   state->capacity    = buffer_size;
+#ifdef HAVE_THREADS
+   if (threads)
+   {
+      size_t joined_size = state_manager_diff_blocks_init(state, threads);
+
+      if (joined_size)
+      {
+         state->prevblock = (uint8_t*)state_manager_raw_alloc(state_size);
+         if (state->prevblock)
+            state->pool   = tpool_create(threads);
+      }
+
+      if (state->pool)
+         max_comp_size    = joined_size + sizeof(size_t) * 2;
+      else
+         RARCH_WARN("[Rewind]: Failed to start diff workers, "
+               "compressing on the main thread.\n");
+   }
+#else
+   (void)threads;
+#endif
 
-   state->head        = state->data + sizeof(size_t);
-   state->tail        = state->data + sizeof(size_t);
+   if (!state_manager_ring_init(&state->ring, buffer_size,
+            max_comp_size, ring_path))
+      goto error;
+
+   if (archive_size)
+   {
+#ifdef HAVE_ZLIB
+      if (!state_manager_archive_init(state, archive_size, archive_path))
+      {
+         RARCH_WARN("[Rewind]: Failed to create the archive.\n");
+         state_manager_ring_free(&state->archive);
+      }
+#else
+      RARCH_WARN("[Rewind]: The archive requires zlib support.\n");
+#endif
+   }
 
 #if STRICT_BUF_SIZE
    state->debugsize   = state_size;
@@ -474,8 +776,6 @@ static state_manager_t *state_manager_new(size_t state_size, size_t buffer_size)
    return state;
 
 error:
-   if (state_data)
-      free(state_data);
    state_manager_free(state);
    free(state);
 
@@ -484,10 +784,10 @@ error:
 
 static bool state_manager_pop(state_manager_t *state, const void **data)
 {
-   size_t start;
-   uint8_t *out                 = NULL;
    const uint8_t *compressed    = NULL;
 
+   state_manager_push_wait(state);
+
    *data = NULL;
 
    if (state->thisblock_valid)
@@ -499,19 +799,20 @@ static bool state_manager_pop(state_manager_t *state, const void **data)
    }
 
    *data = state->thisblock;
-   if (state->head == state->tail)
-      return false;
 
-   start = read_size_t(state->head - sizeof(size_t));
-   state->head = state->data + start;
+   if ((compressed = state_manager_ring_pop(&state->ring)))
+      state->entries--;
+#ifdef HAVE_ZLIB
+   else
+      compressed = state_manager_archive_pop(state);
+#endif
 
-   compressed = state->data + start + sizeof(size_t);
-   out = state->thisblock;
+   if (!compressed)
+      return false;
 
    state_manager_raw_decompress(compressed,
-         state->maxcompsize, out, state->blocksize);
+         state->ring.maxsize, state->thisblock, state->blocksize);
 
-   state->entries--;
    return true;
 }
 
@@ -541,49 +842,42 @@ static void state_manager_push_do(state_manager_t *state)
 {
    uint8_t *swap = NULL;
 
+   state_manager_push_wait(state);
+
 #if STRICT_BUF_SIZE
    memcpy(state->nextblock, state->debugblock, state->debugsize);
 #endif
 
    if (state->thisblock_valid)
    {
-      const uint8_t *oldb, *newb;
-      uint8_t *compressed;
-      size_t headpos, tailpos, remaining;
-      if (state->capacity < sizeof(size_t) + state->maxcompsize)
+      uint8_t *compressed = state_manager_ring_reserve(state,
+            &state->ring, state_manager_drop);
+
+      if (!compressed)
          return;
 
-recheckcapacity:;
+#ifdef HAVE_THREADS
+      if (state->pool)
+      {
+         /* The workers keep reading the previous state, so serialize
+          * the next one into the spare buffer instead. */
+         state_manager_diff_start(state, compressed);
 
-      headpos = state->head - state->data;
-      tailpos = state->tail - state->data;
-      remaining = (tailpos + state->capacity -
-            sizeof(size_t) - headpos - 1) % state->capacity + 1;
+         swap             = state->prevblock;
+         state->prevblock = state->thisblock;
+         state->thisblock = state->nextblock;
+         state->nextblock = swap;
 
-      if (remaining <= state->maxcompsize)
-      {
-         state->tail = state->data + read_size_t(state->tail);
-         state->entries--;
-         goto recheckcapacity;
+         state->entries++;
+         return;
       }
+#endif
 
-      oldb        = state->thisblock;
-      newb        = state->nextblock;
-      compressed  = state->head + sizeof(size_t);
-
-      compressed += state_manager_raw_compress(oldb, newb,
-            state->blocksize, compressed);
+      compressed += state_manager_raw_compress(state->thisblock,
+            state->nextblock, state->blocksize, compressed);
 
-      if (compressed - state->data + state->maxcompsize > state->capacity)
-      {
-         compressed = state->data;
-         if (state->tail == state->data + sizeof(size_t))
-            state->tail = state->data + read_size_t(state->tail);
-      }
-      write_size_t(compressed, state->head-state->data);
-      compressed += sizeof(size_t);
-      write_size_t(state->head, compressed-state->data);
-      state->head = compressed;
+      state_manager_ring_commit(state, &state->ring, compressed,
+            state_manager_drop);
    }
    else
       state->thisblock_valid = true;
@@ -599,23 +893,24 @@ recheckcapacity:;
 static void state_manager_capacity(state_manager_t *state,
       unsigned *entries, size_t *bytes, bool *full)
 {
-   size_t headpos   = state->head - state->data;
-   size_t tailpos   = state->tail - state->data;
-   size_t remaining = (tailpos + state->capacity -
-         sizeof(size_t) - headpos - 1) % state->capacity + 1;
+   size_t headpos   = state->ring.head - state->ring.data;
+   size_t tailpos   = state->ring.tail - state->ring.data;
+   size_t remaining = (tailpos + state->ring.capacity -
+         sizeof(size_t) - headpos - 1) % state->ring.capacity + 1;
 
    if (entries)
       *entries = state->entries;
    if (bytes)
-      *bytes = state->capacity-remaining;
+      *bytes = state->ring.capacity-remaining;
    if (full)
-      *full = remaining <= state->maxcompsize * 2;
+      *full = remaining <= state->ring.maxsize * 2;
 }
 #endif
 
-void state_manager_event_init(unsigned rewind_buffer_size)
+void state_manager_event_init(size_t rewind_buffer_size,
+      size_t rewind_archive_size, unsigned rewind_threads,
+      const char *rewind_dir)
 {
-   retro_ctx_serialize_info_t serial_info;
    retro_ctx_size_info_t info;
    void *state          = NULL;
 
@@ -644,17 +939,15 @@ void state_manager_event_init(unsigned rewind_buffer_size)
          (unsigned)(rewind_buffer_size / 1000000));
 
    rewind_state.state = state_manager_new(rewind_state.size,
-         rewind_buffer_size);
+         rewind_buffer_size, rewind_archive_size, rewind_threads,
+         rewind_dir);
 
    if (!rewind_state.state)
       RARCH_WARN("%s.\n", msg_hash_to_str(MSG_REWIND_INIT_FAILED));
 
    state_manager_push_where(rewind_state.state, &state);
 
-   serial_info.data = state;
-   serial_info.size = rewind_state.size;
-
-   core_serialize(&serial_info);
+   savestate_pool_serialize_to(state, rewind_state.size, true);
 
    state_manager_push_do(rewind_state.state);
 }
@@ -777,15 +1070,14 @@ bool state_manager_check_rewind(bool pressed,
 
       if ((cnt == 0) || rarch_ctl(RARCH_CTL_BSV_MOVIE_IS_INITED, NULL))
       {
-         retro_ctx_serialize_info_t serial_info;
          void *state = NULL;
 
          state_manager_push_where(rewind_state.state, &state);
 
-         serial_info.data = state;
-         serial_info.size = rewind_state.size;
-
-         core_serialize(&serial_info);
+         /* Picks up the state run-ahead saved last frame, if any.
+          * The rewind blocks are patched in place when popping,
+          * so this is a copy rather than a shared buffer. */
+         savestate_pool_serialize_to(state, rewind_state.size, true);
 
          state_manager_push_do(rewind_state.state);
       }
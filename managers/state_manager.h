@@ -32,7 +32,23 @@ bool state_manager_frame_is_reversed(void);
 
 void state_manager_event_deinit(void);
 
-void state_manager_event_init(unsigned rewind_buffer_size);
+/**
+ * state_manager_event_init:
+ * @rewind_buffer_size   : size of the rewind buffer in bytes.
+ * @rewind_archive_size  : size in bytes of the zlib-compressed archive
+ *                         holding patches dropped from the rewind
+ *                         buffer, 0 to discard them.
+ * @rewind_threads       : number of worker threads computing savestate
+ *                         deltas in the background, 0 to compute them
+ *                         on the main thread.
+ * @rewind_dir           : directory to map the buffers from, NULL to
+ *                         keep them in memory.
+ *
+ * Initializes rewind and pushes the current state.
+ **/
+void state_manager_event_init(size_t rewind_buffer_size,
+      size_t rewind_archive_size, unsigned rewind_threads,
+      const char *rewind_dir);
 
 /**
  * check_rewind:
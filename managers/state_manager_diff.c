@@ -0,0 +1,698 @@
+/*  RetroArch - A frontend for libretro.
+ *  Copyright (C) 2010-2014 - Hans-Kristian Arntzen
+ *  Copyright (C) 2011-2017 - Daniel De Matteis
+ *  Copyright (C) 2014-2017 - Alfred Agrell
+ *
+ *  RetroArch is free software: you can redistribute it and/or modify it under the terms
+ *  of the GNU General Public License as published by the Free Software Found-
+ *  ation, either version 3 of the License, or (at your option) any later version.
+ *
+ *  RetroArch is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ *  PURPOSE.  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with RetroArch.
+ *  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __STDC_LIMIT_MACROS
+#define __STDC_LIMIT_MACROS
+#endif
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <retro_inline.h>
+#include <features/features_cpu.h>
+
+#include "state_manager_diff.h"
+
+#ifndef UINT16_MAX
+#define UINT16_MAX 0xffff
+#endif
+
+#ifndef UINT32_MAX
+#define UINT32_MAX 0xffffffffu
+#endif
+
+#if defined(__x86_64__) || defined(__i386__) || defined(__i486__) || defined(__i686__) || defined(_M_IX86) || defined(_M_AMD64) || defined(_M_X64)
+#define CPU_X86
+#endif
+
+/* Other arches SIGBUS (usually) on unaligned accesses. */
+#ifndef CPU_X86
+#define NO_UNALIGNED_MEM
+#endif
+
+/* The x86 scanners are built with target attributes, so they are
+ * available regardless of the baseline the rest is compiled for. */
+#ifdef CPU_X86
+#if defined(__clang__) || (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)))
+#define STATE_MANAGER_HAVE_SSE2
+#define STATE_MANAGER_HAVE_AVX2
+#define STATE_MANAGER_TARGET_SSE2 __attribute__((target("sse2")))
+#define STATE_MANAGER_TARGET_AVX2 __attribute__((target("avx2")))
+#elif defined(_MSC_VER) && _MSC_VER >= 1700
+#define STATE_MANAGER_HAVE_SSE2
+#define STATE_MANAGER_HAVE_AVX2
+#define STATE_MANAGER_TARGET_SSE2
+#define STATE_MANAGER_TARGET_AVX2
+#endif
+#endif
+
+#ifdef STATE_MANAGER_HAVE_SSE2
+#include <emmintrin.h>
+#endif
+#ifdef STATE_MANAGER_HAVE_AVX2
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define STATE_MANAGER_HAVE_NEON
+#include <arm_neon.h>
+#endif
+
+/* The vector scanners read whole vectors, up to this many bytes
+ * past the end of the range they were given. */
+#define STATE_MANAGER_MAX_OVERREAD 32
+
+typedef size_t (*state_manager_compress_range_t)(const uint16_t *old16,
+      const uint16_t *new16, size_t num16s, void *patch, size_t *trailing);
+
+/* Trailing zero count of a vector compare mask. compat_ctz() only
+ * handles 16-bit masks everywhere. */
+static INLINE unsigned state_manager_ctz32(uint32_t x)
+{
+#if defined(__GNUC__) || defined(__clang__)
+   return __builtin_ctz(x);
+#elif defined(_MSC_VER) && _MSC_VER >= 1400
+   unsigned long r = 0;
+   _BitScanForward(&r, x);
+   return (unsigned)r;
+#else
+   unsigned r = 0;
+   while (!(x & 1))
+   {
+      x >>= 1;
+      r++;
+   }
+   return r;
+#endif
+}
+
+/* Returns the index of the first differing uint16 in the first 'len',
+ * or 'len' if there is none.
+ *
+ * There's no equivalent in libc, you'd think so ...
+ * std::mismatch exists, but it's not optimized at all. */
+static INLINE size_t find_change_scalar(const uint16_t *a,
+      const uint16_t *b, size_t len)
+{
+   const uint16_t *a_org = a;
+   const uint16_t *a_end = a + len;
+   size_t ret;
+#ifdef NO_UNALIGNED_MEM
+   while (a < a_end && ((uintptr_t)a & (sizeof(size_t) - 1)) && *a == *b)
+   {
+      a++;
+      b++;
+   }
+   if (a < a_end && *a == *b)
+#endif
+   {
+      const size_t *a_big = (const size_t*)a;
+      const size_t *b_big = (const size_t*)b;
+
+      while ((const uint16_t*)a_big < a_end && *a_big == *b_big)
+      {
+         a_big++;
+         b_big++;
+      }
+      a = (const uint16_t*)a_big;
+      b = (const uint16_t*)b_big;
+
+      while (a < a_end && *a == *b)
+      {
+         a++;
+         b++;
+      }
+   }
+
+   ret = a - a_org;
+   return ret < len ? ret : len;
+}
+
+/* Returns the number of uint16s in the first 'len' before the next
+ * run of identical data, or 'len' if the rest is all different. */
+static INLINE size_t find_same_scalar(const uint16_t *a,
+      const uint16_t *b, size_t len)
+{
+   const uint16_t *a_org = a;
+   const uint16_t *a_end = a + len;
+   size_t ret;
+#ifdef NO_UNALIGNED_MEM
+   if (((uintptr_t)a & (sizeof(uint32_t) - 1)) && *a != *b)
+   {
+      a++;
+      b++;
+   }
+   if (a < a_end && *a != *b)
+#endif
+   {
+      /* With this, it's random whether two consecutive identical
+       * words are caught.
+       *
+       * Luckily, compression rate is the same for both cases, and
+       * three is always caught.
+       *
+       * (We prefer to miss two-word blocks, anyways; fewer iterations
+       * of the outer loop, as well as in the decompressor.) */
+      const uint32_t *a_big = (const uint32_t*)a;
+      const uint32_t *b_big = (const uint32_t*)b;
+
+      while ((const uint16_t*)a_big < a_end && *a_big != *b_big)
+      {
+         a_big++;
+         b_big++;
+      }
+      a = (const uint16_t*)a_big;
+      b = (const uint16_t*)b_big;
+
+      if (a != a_org && a[-1] == b[-1])
+      {
+         a--;
+         b--;
+      }
+   }
+
+   ret = a - a_org;
+   return ret < len ? ret : len;
+}
+
+/* The vector scanners below compare 32-bit lanes starting at 'a', like
+ * the scalar ones, so they find the same runs. */
+
+/* 'ret' is the uint16 index of the first lane that differs; the
+ * difference is in its second half if the first half matches. */
+static INLINE size_t state_manager_change_at(const uint16_t *a,
+      const uint16_t *b, size_t ret, size_t len)
+{
+   ret |= (a[ret] == b[ret]);
+   return ret < len ? ret : len;
+}
+
+/* 'ret' is the uint16 index of the first lane that matches; include
+ * the uint16 before it in the run if it matches as well. If no lane
+ * matches, the scalar scanner stops at the first lane past the end,
+ * so the vector ones pass that to get identical patches. */
+static INLINE size_t state_manager_same_at(const uint16_t *a,
+      const uint16_t *b, size_t ret, size_t len)
+{
+   if (ret && a[ret - 1] == b[ret - 1])
+      ret--;
+   return ret < len ? ret : len;
+}
+
+#ifdef STATE_MANAGER_HAVE_SSE2
+static STATE_MANAGER_TARGET_SSE2 INLINE size_t find_change_sse2(
+      const uint16_t *a, const uint16_t *b, size_t len)
+{
+   size_t pos;
+
+   for (pos = 0; pos < len; pos += 8)
+   {
+      __m128i v0    = _mm_loadu_si128((const __m128i*)(a + pos));
+      __m128i v1    = _mm_loadu_si128((const __m128i*)(b + pos));
+      uint32_t mask = _mm_movemask_epi8(_mm_cmpeq_epi32(v0, v1));
+
+      if (mask != 0xffff) /* Something has changed, figure out where. */
+         return state_manager_change_at(a, b,
+               pos + (state_manager_ctz32(~mask) >> 1), len);
+   }
+
+   return len;
+}
+
+static STATE_MANAGER_TARGET_SSE2 INLINE size_t find_same_sse2(
+      const uint16_t *a, const uint16_t *b, size_t len)
+{
+   size_t pos;
+
+   for (pos = 0; pos < len; pos += 8)
+   {
+      __m128i v0    = _mm_loadu_si128((const __m128i*)(a + pos));
+      __m128i v1    = _mm_loadu_si128((const __m128i*)(b + pos));
+      uint32_t mask = _mm_movemask_epi8(_mm_cmpeq_epi32(v0, v1));
+
+      if (mask)
+         return state_manager_same_at(a, b,
+               pos + (state_manager_ctz32(mask) >> 1), len);
+   }
+
+   return state_manager_same_at(a, b, (len + 1) & ~(size_t)1, len);
+}
+#endif
+
+#ifdef STATE_MANAGER_HAVE_AVX2
+static STATE_MANAGER_TARGET_AVX2 INLINE size_t find_change_avx2(
+      const uint16_t *a, const uint16_t *b, size_t len)
+{
+   size_t pos;
+
+   for (pos = 0; pos < len; pos += 16)
+   {
+      __m256i v0    = _mm256_loadu_si256((const __m256i*)(a + pos));
+      __m256i v1    = _mm256_loadu_si256((const __m256i*)(b + pos));
+      uint32_t mask = (uint32_t)_mm256_movemask_epi8(
+            _mm256_cmpeq_epi32(v0, v1));
+
+      if (mask != 0xffffffffu)
+         return state_manager_change_at(a, b,
+               pos + (state_manager_ctz32(~mask) >> 1), len);
+   }
+
+   return len;
+}
+
+static STATE_MANAGER_TARGET_AVX2 INLINE size_t find_same_avx2(
+      const uint16_t *a, const uint16_t *b, size_t len)
+{
+   size_t pos;
+
+   for (pos = 0; pos < len; pos += 16)
+   {
+      __m256i v0    = _mm256_loadu_si256((const __m256i*)(a + pos));
+      __m256i v1    = _mm256_loadu_si256((const __m256i*)(b + pos));
+      uint32_t mask = (uint32_t)_mm256_movemask_epi8(
+            _mm256_cmpeq_epi32(v0, v1));
+
+      if (mask)
+         return state_manager_same_at(a, b,
+               pos + (state_manager_ctz32(mask) >> 1), len);
+   }
+
+   return state_manager_same_at(a, b, (len + 1) & ~(size_t)1, len);
+}
+#endif
+
+#ifdef STATE_MANAGER_HAVE_NEON
+/* Narrows a 32-bit lane compare result to 16 bits per lane, so
+ * that it fits a general purpose register. */
+static INLINE uint64_t state_manager_neon_mask(uint32x4_t c)
+{
+   return vget_lane_u64(vreinterpret_u64_u16(vmovn_u32(c)), 0);
+}
+
+static INLINE size_t find_change_neon(const uint16_t *a,
+      const uint16_t *b, size_t len)
+{
+   size_t pos;
+
+   for (pos = 0; pos < len; pos += 8)
+   {
+      uint32x4_t v0 = vreinterpretq_u32_u16(vld1q_u16(a + pos));
+      uint32x4_t v1 = vreinterpretq_u32_u16(vld1q_u16(b + pos));
+      uint64_t mask = state_manager_neon_mask(vceqq_u32(v0, v1));
+
+      if (mask != UINT64_C(0xffffffffffffffff))
+      {
+         size_t ret = pos;
+         while (mask & 0xffff)
+         {
+            mask >>= 16;
+            ret   += 2;
+         }
+         return state_manager_change_at(a, b, ret, len);
+      }
+   }
+
+   return len;
+}
+
+static INLINE size_t find_same_neon(const uint16_t *a,
+      const uint16_t *b, size_t len)
+{
+   size_t pos;
+
+   for (pos = 0; pos < len; pos += 8)
+   {
+      uint32x4_t v0 = vreinterpretq_u32_u16(vld1q_u16(a + pos));
+      uint32x4_t v1 = vreinterpretq_u32_u16(vld1q_u16(b + pos));
+      uint64_t mask = state_manager_neon_mask(vceqq_u32(v0, v1));
+
+      if (mask)
+      {
+         size_t ret = pos;
+         while (!(mask & 0xffff))
+         {
+            mask >>= 16;
+            ret   += 2;
+         }
+         return state_manager_same_at(a, b, ret, len);
+      }
+   }
+
+   return state_manager_same_at(a, b, (len + 1) & ~(size_t)1, len);
+}
+#endif
+
+typedef size_t (*state_manager_find_t)(const uint16_t *a,
+      const uint16_t *b, size_t len);
+
+/* Shared body of the compressors. Each implementation below calls it
+ * with its own scanners, so that they are inlined with the matching
+ * target. */
+static INLINE size_t state_manager_compress_range(const uint16_t *old16,
+      const uint16_t *new16, size_t num16s, void *patch, size_t *trailing,
+      state_manager_find_t find_change, state_manager_find_t find_same)
+{
+   uint16_t *compressed16 = (uint16_t*)patch;
+
+   *trailing = 0;
+
+   while (num16s)
+   {
+      size_t i, changed;
+      size_t skip = find_change(old16, new16, num16s);
+
+      if (skip >= num16s)
+      {
+         *trailing = num16s;
+         break;
+      }
+
+      old16  += skip;
+      new16  += skip;
+      num16s -= skip;
+
+      if (skip > UINT16_MAX)
+      {
+         if (skip > UINT32_MAX)
+         {
+            /* This will make it scan the entire thing again,
+             * but it only hits on 8GB unchanged data anyways,
+             * and if you're doing that, you've got bigger problems. */
+            skip = UINT32_MAX;
+         }
+         *compressed16++ = 0;
+         *compressed16++ = skip;
+         *compressed16++ = skip >> 16;
+         continue;
+      }
+
+      changed = find_same(old16, new16, num16s);
+      if (changed > UINT16_MAX)
+         changed = UINT16_MAX;
+
+      *compressed16++ = changed;
+      *compressed16++ = skip;
+
+      for (i = 0; i < changed; i++)
+         compressed16[i] = old16[i];
+
+      old16 += changed;
+      new16 += changed;
+      num16s -= changed;
+      compressed16 += changed;
+   }
+
+   return (uint8_t*)compressed16 - (uint8_t*)patch;
+}
+
+static size_t state_manager_compress_range_scalar(const uint16_t *old16,
+      const uint16_t *new16, size_t num16s, void *patch, size_t *trailing)
+{
+   return state_manager_compress_range(old16, new16, num16s, patch,
+         trailing, find_change_scalar, find_same_scalar);
+}
+
+#ifdef STATE_MANAGER_HAVE_SSE2
+static STATE_MANAGER_TARGET_SSE2 size_t state_manager_compress_range_sse2(
+      const uint16_t *old16, const uint16_t *new16, size_t num16s,
+      void *patch, size_t *trailing)
+{
+   return state_manager_compress_range(old16, new16, num16s, patch,
+         trailing, find_change_sse2, find_same_sse2);
+}
+#endif
+
+#ifdef STATE_MANAGER_HAVE_AVX2
+static STATE_MANAGER_TARGET_AVX2 size_t state_manager_compress_range_avx2(
+      const uint16_t *old16, const uint16_t *new16, size_t num16s,
+      void *patch, size_t *trailing)
+{
+   return state_manager_compress_range(old16, new16, num16s, patch,
+         trailing, find_change_avx2, find_same_avx2);
+}
+#endif
+
+#ifdef STATE_MANAGER_HAVE_NEON
+static size_t state_manager_compress_range_neon(const uint16_t *old16,
+      const uint16_t *new16, size_t num16s, void *patch, size_t *trailing)
+{
+   return state_manager_compress_range(old16, new16, num16s, patch,
+         trailing, find_change_neon, find_same_neon);
+}
+#endif
+
+static state_manager_compress_range_t state_manager_impl_compress_range(
+      enum state_manager_diff_impl impl)
+{
+   switch (impl)
+   {
+#ifdef STATE_MANAGER_HAVE_SSE2
+      case STATE_MANAGER_DIFF_IMPL_SSE2:
+         return state_manager_compress_range_sse2;
+#endif
+#ifdef STATE_MANAGER_HAVE_AVX2
+      case STATE_MANAGER_DIFF_IMPL_AVX2:
+         return state_manager_compress_range_avx2;
+#endif
+#ifdef STATE_MANAGER_HAVE_NEON
+      case STATE_MANAGER_DIFF_IMPL_NEON:
+         return state_manager_compress_range_neon;
+#endif
+      default:
+         break;
+   }
+
+   return state_manager_compress_range_scalar;
+}
+
+bool state_manager_diff_impl_supported(enum state_manager_diff_impl impl)
+{
+   switch (impl)
+   {
+      case STATE_MANAGER_DIFF_IMPL_SCALAR:
+         return true;
+#ifdef STATE_MANAGER_HAVE_SSE2
+      case STATE_MANAGER_DIFF_IMPL_SSE2:
+         return (cpu_features_get() & RETRO_SIMD_SSE2) != 0;
+#endif
+#ifdef STATE_MANAGER_HAVE_AVX2
+      case STATE_MANAGER_DIFF_IMPL_AVX2:
+         /* RETRO_SIMD_AVX implies the OS saves the YMM registers. */
+         return (cpu_features_get() & (RETRO_SIMD_AVX | RETRO_SIMD_AVX2))
+            == (RETRO_SIMD_AVX | RETRO_SIMD_AVX2);
+#endif
+#ifdef STATE_MANAGER_HAVE_NEON
+      case STATE_MANAGER_DIFF_IMPL_NEON:
+#ifdef __aarch64__
+         return true;
+#else
+         return (cpu_features_get() & RETRO_SIMD_NEON) != 0;
+#endif
+#endif
+      default:
+         break;
+   }
+
+   return false;
+}
+
+const char *state_manager_diff_impl_name(enum state_manager_diff_impl impl)
+{
+   switch (impl)
+   {
+      case STATE_MANAGER_DIFF_IMPL_SCALAR:
+         return "scalar";
+      case STATE_MANAGER_DIFF_IMPL_SSE2:
+         return "sse2";
+      case STATE_MANAGER_DIFF_IMPL_AVX2:
+         return "avx2";
+      case STATE_MANAGER_DIFF_IMPL_NEON:
+         return "neon";
+      default:
+         break;
+   }
+
+   return "unknown";
+}
+
+/* Resolved on first use. Concurrent first calls may both resolve,
+ * but they store the same pointer. */
+static state_manager_compress_range_t state_manager_compress_range_best = NULL;
+
+static state_manager_compress_range_t state_manager_diff_resolve(void)
+{
+   unsigned impl;
+   state_manager_compress_range_t compress =
+      state_manager_compress_range_scalar;
+
+   /* Later entries are faster */
+   for (impl = 0; impl < STATE_MANAGER_DIFF_IMPL_LAST; impl++)
+      if (state_manager_diff_impl_supported(
+               (enum state_manager_diff_impl)impl))
+         compress = state_manager_impl_compress_range(
+               (enum state_manager_diff_impl)impl);
+
+   state_manager_compress_range_best = compress;
+   return compress;
+}
+
+size_t state_manager_raw_maxsize(size_t uncomp)
+{
+   /* bytes covered by a compressed block */
+   const int maxcblkcover = UINT16_MAX * sizeof(uint16_t);
+   /* uncompressed size, rounded to 16 bits */
+   size_t uncomp16        = (uncomp + sizeof(uint16_t) - 1) & -sizeof(uint16_t);
+   /* number of blocks */
+   size_t maxcblks        = (uncomp + maxcblkcover - 1) / maxcblkcover;
+   return uncomp16 + maxcblks * sizeof(uint16_t) * 2 /* two u16 overhead per block */ + sizeof(uint16_t) *
+      3; /* three u16 to end it */
+}
+
+void *state_manager_raw_alloc(size_t len)
+{
+   size_t  len16 = (len + sizeof(uint16_t) - 1) & -sizeof(uint16_t);
+
+   /* The scanners only check bounds once per vector, so they may read
+    * past the end of the state; pad the buffer to keep that inside
+    * the allocation (and Valgrind happy). */
+   return calloc(len16 + STATE_MANAGER_MAX_OVERREAD, 1);
+}
+
+size_t state_manager_raw_compress_range(const uint16_t *old16,
+      const uint16_t *new16, size_t num16s, void *patch, size_t *trailing)
+{
+   state_manager_compress_range_t compress =
+      state_manager_compress_range_best;
+
+   if (!compress)
+      compress = state_manager_diff_resolve();
+
+   return compress(old16, new16, num16s, patch, trailing);
+}
+
+static size_t state_manager_raw_terminate(void *patch, size_t len)
+{
+   uint16_t *compressed16 = (uint16_t*)((uint8_t*)patch + len);
+
+   compressed16[0] = 0;
+   compressed16[1] = 0;
+   compressed16[2] = 0;
+
+   return len + sizeof(uint16_t) * 3;
+}
+
+size_t state_manager_raw_compress(const void *src,
+      const void *dst, size_t len, void *patch)
+{
+   size_t trailing;
+   return state_manager_raw_terminate(patch,
+         state_manager_raw_compress_range((const uint16_t*)src,
+            (const uint16_t*)dst,
+            (len + sizeof(uint16_t) - 1) / sizeof(uint16_t),
+            patch, &trailing));
+}
+
+size_t state_manager_raw_compress_with_impl(
+      enum state_manager_diff_impl impl,
+      const void *src, const void *dst, size_t len, void *patch)
+{
+   size_t trailing;
+   state_manager_compress_range_t compress =
+      state_manager_compress_range_scalar;
+
+   if (state_manager_diff_impl_supported(impl))
+      compress = state_manager_impl_compress_range(impl);
+
+   return state_manager_raw_terminate(patch,
+         compress((const uint16_t*)src, (const uint16_t*)dst,
+            (len + sizeof(uint16_t) - 1) / sizeof(uint16_t),
+            patch, &trailing));
+}
+
+size_t state_manager_raw_patch_size(const void *patch)
+{
+   const uint16_t *patch16 = (const uint16_t*)patch;
+
+   for (;;)
+   {
+      uint16_t numchanged = *(patch16++);
+
+      if (numchanged)
+         patch16 += 1 + numchanged;
+      else
+      {
+         uint32_t numunchanged = patch16[0] | (patch16[1] << 16);
+
+         patch16 += 2;
+         if (!numunchanged)
+            break;
+      }
+   }
+
+   return (const uint8_t*)patch16 - (const uint8_t*)patch;
+}
+
+/* Runs at least this long are copied with memcpy(). */
+#define STATE_MANAGER_MEMCPY_MIN 64
+
+void state_manager_raw_decompress(const void *patch,
+      size_t patchlen, void *data, size_t datalen)
+{
+   uint16_t         *out16 = (uint16_t*)data;
+   const uint16_t *patch16 = (const uint16_t*)patch;
+
+   (void)patchlen;
+   (void)datalen;
+
+   for (;;)
+   {
+      uint16_t numchanged = *(patch16++);
+
+      if (numchanged)
+      {
+         out16 += *patch16++;
+
+         /* We could do memcpy, but it seems that memcpy has a
+          * constant-per-call overhead that actually shows up.
+          *
+          * Our average size in here seems to be 8 or something.
+          * Therefore, we only use it for the long runs a heavily
+          * changed state produces. */
+         if (numchanged >= STATE_MANAGER_MEMCPY_MIN)
+            memcpy(out16, patch16, numchanged * sizeof(uint16_t));
+         else
+         {
+            uint16_t i;
+            for (i = 0; i < numchanged; i++)
+               out16[i] = patch16[i];
+         }
+
+         patch16 += numchanged;
+         out16 += numchanged;
+      }
+      else
+      {
+         uint32_t numunchanged = patch16[0] | (patch16[1] << 16);
+
+         if (!numunchanged)
+            break;
+         patch16 += 2;
+         out16 += numunchanged;
+      }
+   }
+}
@@ -0,0 +1,133 @@
+/*  RetroArch - A frontend for libretro.
+ *  Copyright (C) 2010-2014 - Hans-Kristian Arntzen
+ *  Copyright (C) 2011-2017 - Daniel De Matteis
+ *  Copyright (C) 2014-2017 - Alfred Agrell
+ *
+ *  RetroArch is free software: you can redistribute it and/or modify it under the terms
+ *  of the GNU General Public License as published by the Free Software Found-
+ *  ation, either version 3 of the License, or (at your option) any later version.
+ *
+ *  RetroArch is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ *  PURPOSE.  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with RetroArch.
+ *  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __STATE_MANAGER_DIFF_H
+#define __STATE_MANAGER_DIFF_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <boolean.h>
+#include <retro_common_api.h>
+
+RETRO_BEGIN_DECLS
+
+/* Format per frame (pseudocode): */
+#if 0
+repeat {
+   uint16 numchanged; /* everything is counted in units of uint16 */
+   if (numchanged)
+   {
+      uint16 numunchanged; /* skip these before handling numchanged */
+      uint16[numchanged] changeddata;
+   }
+   else
+   {
+      uint32 numunchanged;
+      if (!numunchanged)
+         break;
+   }
+}
+#endif
+
+/* Implementations of the diff scanners. state_manager_raw_compress()
+ * picks the fastest one supported by the running CPU the first time
+ * it is called; all of them produce valid patches. */
+enum state_manager_diff_impl
+{
+   STATE_MANAGER_DIFF_IMPL_SCALAR = 0,
+   STATE_MANAGER_DIFF_IMPL_SSE2,
+   STATE_MANAGER_DIFF_IMPL_AVX2,
+   STATE_MANAGER_DIFF_IMPL_NEON,
+   STATE_MANAGER_DIFF_IMPL_LAST
+};
+
+/* Returns the maximum compressed size of a savestate.
+ * It is very likely to compress to far less. */
+size_t state_manager_raw_maxsize(size_t uncomp);
+
+/*
+ * Allocates a savestate buffer for state_manager_raw_compress().
+ * When you're done with it, send it to free().
+ */
+void *state_manager_raw_alloc(size_t len);
+
+/*
+ * Takes two savestates and creates a patch that turns 'dst' into 'src'.
+ * Both 'src' and 'dst' must be returned from state_manager_raw_alloc(),
+ * with the same 'len'.
+ *
+ * 'patch' must be size 'state_manager_raw_maxsize(len)' or more.
+ * Returns the number of bytes actually written to 'patch'.
+ */
+size_t state_manager_raw_compress(const void *src,
+      const void *dst, size_t len, void *patch);
+
+/*
+ * Compresses 'num16s' uint16s of 'old16' against 'new16' into 'patch',
+ * without the terminating record. Unchanged data at the end of the
+ * range is not encoded; its length is stored in 'trailing' so that
+ * ranges can be compressed independently and joined afterwards.
+ *
+ * Returns the number of bytes written to 'patch'.
+ */
+size_t state_manager_raw_compress_range(const uint16_t *old16,
+      const uint16_t *new16, size_t num16s, void *patch, size_t *trailing);
+
+/*
+ * Takes 'patch' from a previous call to 'state_manager_raw_compress'
+ * and applies it to 'data' ('dst' from that call),
+ * yielding 'src' in that call.
+ *
+ * If the given arguments do not match a previous call to
+ * state_manager_raw_compress(), anything at all can happen.
+ */
+void state_manager_raw_decompress(const void *patch,
+      size_t patchlen, void *data, size_t datalen);
+
+/*
+ * Returns the size in bytes of a patch from state_manager_raw_compress(),
+ * including the terminating record.
+ */
+size_t state_manager_raw_patch_size(const void *patch);
+
+/**
+ * state_manager_diff_impl_supported:
+ * @impl                : Diff implementation.
+ *
+ * Returns: true if @impl was compiled in and the running CPU
+ * supports it.
+ **/
+bool state_manager_diff_impl_supported(enum state_manager_diff_impl impl);
+
+const char *state_manager_diff_impl_name(enum state_manager_diff_impl impl);
+
+/**
+ * state_manager_raw_compress_with_impl:
+ * @impl                : Diff implementation.
+ *
+ * Same as state_manager_raw_compress(), but forces @impl. Falls back
+ * to the scalar implementation if @impl is not supported. Meant for
+ * benchmarks and tests.
+ **/
+size_t state_manager_raw_compress_with_impl(
+      enum state_manager_diff_impl impl,
+      const void *src, const void *dst, size_t len, void *patch);
+
+RETRO_END_DECLS
+
+#endif
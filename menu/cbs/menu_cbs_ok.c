@@ -2076,6 +2076,7 @@ static int action_ok_playlist_entry_collection(const char *path,
    playlist_config.old_format             = settings->bools.playlist_use_old_format;
    playlist_config.compress               = settings->bools.playlist_compression;
    playlist_config.fuzzy_archive_match    = settings->bools.playlist_fuzzy_archive_match;
+   playlist_config.binary_cache           = settings->bools.playlist_binary_cache;
 
    content_path[0]  = '\0';
    content_label[0] = '\0';
@@ -6300,6 +6301,7 @@ static int action_ok_manual_content_scan_start(const char *path,
    playlist_config.old_format          = settings->bools.playlist_use_old_format;
    playlist_config.compress            = settings->bools.playlist_compression;
    playlist_config.fuzzy_archive_match = settings->bools.playlist_fuzzy_archive_match;
+   playlist_config.binary_cache        = settings->bools.playlist_binary_cache;
 
    task_push_manual_content_scan(&playlist_config, directory_playlist);
    return 0;
@@ -6607,6 +6609,7 @@ static int action_ok_delete_playlist(const char *path,
    path = playlist_get_conf_path(playlist);
 
    filestream_delete(path);
+   playlist_delete_cache_file(path);
 
    menu_environ.type = MENU_ENVIRON_RESET_HORIZONTAL_LIST;
 
@@ -6631,6 +6634,7 @@ static int action_ok_pl_content_thumbnails(const char *path,
       playlist_config.old_format          = settings->bools.playlist_use_old_format;
       playlist_config.compress            = settings->bools.playlist_compression;
       playlist_config.fuzzy_archive_match = settings->bools.playlist_fuzzy_archive_match;
+      playlist_config.binary_cache        = settings->bools.playlist_binary_cache;
 
       if (!string_is_empty(path_dir_playlist))
       {
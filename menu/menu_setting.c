@@ -29,6 +29,9 @@
 #include <lists/string_list.h>
 #include <streams/file_stream.h>
 #include <audio/audio_resampler.h>
+#ifdef HAVE_CHD
+#include <streams/chd_stream.h>
+#endif
 
 #include <compat/strl.h>
 
@@ -4644,6 +4647,34 @@ static void setting_get_string_representation_int_audio_wasapi_sh_buffer_length(
 }
 #endif
 
+/* Thread counts and the like, where 0 picks a value itself */
+static void setting_get_string_representation_uint_auto(
+      rarch_setting_t *setting,
+      char *s, size_t len)
+{
+   if (!setting)
+      return;
+
+   if (*setting->value.target.unsigned_integer == 0)
+      strlcpy(s, "Auto", len);
+   else
+      snprintf(s, len, "%u", *setting->value.target.unsigned_integer);
+}
+
+/* Counts and sizes where 0 turns the feature off */
+static void setting_get_string_representation_uint_off(
+      rarch_setting_t *setting,
+      char *s, size_t len)
+{
+   if (!setting)
+      return;
+
+   if (*setting->value.target.unsigned_integer == 0)
+      strlcpy(s, msg_hash_to_str(MENU_ENUM_LABEL_VALUE_OFF), len);
+   else
+      snprintf(s, len, "%u", *setting->value.target.unsigned_integer);
+}
+
 static void setting_get_string_representation_crt_switch_resolution_super(
       rarch_setting_t *setting,
       char *s, size_t len)
@@ -7237,6 +7268,13 @@ static void general_write_handler(rarch_setting_t *setting)
             audio_driver_load_system_sounds();
 #endif
          break;
+#ifdef HAVE_CHD
+      case MENU_ENUM_LABEL_CHD_CACHE_HUNKS:
+      case MENU_ENUM_LABEL_CHD_READAHEAD_HUNKS:
+         chdstream_set_cache(settings->uints.chd_cache_hunks,
+               settings->uints.chd_readahead_hunks);
+         break;
+#endif
       default:
          break;
    }
@@ -8825,6 +8863,40 @@ static bool setting_append_list(
                      bool_entries[i].flags);
             }
 
+#ifdef HAVE_CHD
+            CONFIG_UINT(
+                  list, list_info,
+                  &settings->uints.chd_cache_hunks,
+                  MENU_ENUM_LABEL_CHD_CACHE_HUNKS,
+                  MENU_ENUM_LABEL_VALUE_CHD_CACHE_HUNKS,
+                  DEFAULT_CHD_CACHE_HUNKS,
+                  &group_info,
+                  &subgroup_info,
+                  parent_group,
+                  general_write_handler,
+                  general_read_handler);
+            (*list)[list_info->index - 1].action_ok = &setting_action_ok_uint;
+            menu_settings_list_current_add_range(list, list_info, 1, 256, 1, true, true);
+            SETTINGS_DATA_LIST_CURRENT_ADD_FLAGS(list, list_info, SD_FLAG_ADVANCED);
+
+            CONFIG_UINT(
+                  list, list_info,
+                  &settings->uints.chd_readahead_hunks,
+                  MENU_ENUM_LABEL_CHD_READAHEAD_HUNKS,
+                  MENU_ENUM_LABEL_VALUE_CHD_READAHEAD_HUNKS,
+                  DEFAULT_CHD_READAHEAD_HUNKS,
+                  &group_info,
+                  &subgroup_info,
+                  parent_group,
+                  general_write_handler,
+                  general_read_handler);
+            (*list)[list_info->index - 1].action_ok = &setting_action_ok_uint;
+            (*list)[list_info->index - 1].get_string_representation =
+               &setting_get_string_representation_uint_off;
+            menu_settings_list_current_add_range(list, list_info, 0, 128, 1, true, true);
+            SETTINGS_DATA_LIST_CURRENT_ADD_FLAGS(list, list_info, SD_FLAG_ADVANCED);
+#endif
+
             END_SUB_GROUP(list, list_info, parent_group);
             END_GROUP(list, list_info, parent_group);
          }
@@ -9235,6 +9307,22 @@ static bool setting_append_list(
                   general_read_handler,
                   SD_FLAG_NONE);
 
+            CONFIG_UINT(
+                  list, list_info,
+                  &settings->uints.scan_hash_threads,
+                  MENU_ENUM_LABEL_SCAN_HASH_THREADS,
+                  MENU_ENUM_LABEL_VALUE_SCAN_HASH_THREADS,
+                  DEFAULT_SCAN_HASH_THREADS,
+                  &group_info,
+                  &subgroup_info,
+                  parent_group,
+                  general_write_handler,
+                  general_read_handler);
+            (*list)[list_info->index - 1].action_ok     = &setting_action_ok_uint;
+            (*list)[list_info->index - 1].get_string_representation =
+               &setting_get_string_representation_uint_auto;
+            menu_settings_list_current_add_range(list, list_info, 0, 32, 1, true, true);
+
             END_SUB_GROUP(list, list_info, parent_group);
             END_GROUP(list, list_info, parent_group);
          }
@@ -9365,6 +9453,57 @@ static bool setting_append_list(
             (*list)[list_info->index - 1].offset_by     = 1;
             menu_settings_list_current_add_range(list, list_info, 1, 100, 1, true, true);
 
+#ifdef HAVE_THREADS
+            CONFIG_UINT(
+                  list, list_info,
+                  &settings->uints.rewind_threads,
+                  MENU_ENUM_LABEL_REWIND_THREADS,
+                  MENU_ENUM_LABEL_VALUE_REWIND_THREADS,
+                  DEFAULT_REWIND_THREADS,
+                  &group_info,
+                  &subgroup_info,
+                  parent_group,
+                  general_write_handler,
+                  general_read_handler);
+            (*list)[list_info->index - 1].action_ok     = &setting_action_ok_uint;
+            (*list)[list_info->index - 1].get_string_representation =
+               &setting_get_string_representation_uint_off;
+            menu_settings_list_current_add_range(list, list_info, 0, 16, 1, true, true);
+#endif
+
+            CONFIG_BOOL(
+                  list, list_info,
+                  &settings->bools.rewind_buffer_to_disk,
+                  MENU_ENUM_LABEL_REWIND_BUFFER_TO_DISK,
+                  MENU_ENUM_LABEL_VALUE_REWIND_BUFFER_TO_DISK,
+                  DEFAULT_REWIND_BUFFER_TO_DISK,
+                  MENU_ENUM_LABEL_VALUE_OFF,
+                  MENU_ENUM_LABEL_VALUE_ON,
+                  &group_info,
+                  &subgroup_info,
+                  parent_group,
+                  general_write_handler,
+                  general_read_handler,
+                  SD_FLAG_NONE);
+
+#ifdef HAVE_ZLIB
+            CONFIG_UINT(
+                  list, list_info,
+                  &settings->uints.rewind_archive_size,
+                  MENU_ENUM_LABEL_REWIND_ARCHIVE_SIZE,
+                  MENU_ENUM_LABEL_VALUE_REWIND_ARCHIVE_SIZE,
+                  DEFAULT_REWIND_ARCHIVE_SIZE,
+                  &group_info,
+                  &subgroup_info,
+                  parent_group,
+                  general_write_handler,
+                  general_read_handler);
+            (*list)[list_info->index - 1].action_ok     = &setting_action_ok_uint;
+            (*list)[list_info->index - 1].get_string_representation =
+               &setting_get_string_representation_uint_off;
+            menu_settings_list_current_add_range(list, list_info, 0, 4096, 16, true, true);
+#endif
+
          END_SUB_GROUP(list, list_info, parent_group);
          END_GROUP(list, list_info, parent_group);
          break;
@@ -14781,6 +14920,22 @@ static bool setting_append_list(
             menu_settings_list_current_add_range(list, list_info, 0.0f, 1024.0f, 64.0f, true, true);
          }
 
+         CONFIG_UINT(
+               list, list_info,
+               &settings->uints.gfx_thumbnail_cache_size,
+               MENU_ENUM_LABEL_MENU_THUMBNAIL_CACHE_SIZE,
+               MENU_ENUM_LABEL_VALUE_MENU_THUMBNAIL_CACHE_SIZE,
+               DEFAULT_GFX_THUMBNAIL_CACHE_SIZE,
+               &group_info,
+               &subgroup_info,
+               parent_group,
+               general_write_handler,
+               general_read_handler);
+         (*list)[list_info->index - 1].action_ok = &setting_action_ok_uint;
+         (*list)[list_info->index - 1].get_string_representation =
+            &setting_get_string_representation_uint_off;
+         menu_settings_list_current_add_range(list, list_info, 0, 4096, 16, true, true);
+
          CONFIG_BOOL(
                list, list_info,
                &settings->bools.menu_timedate_enable,
@@ -16151,6 +16306,22 @@ static bool setting_append_list(
                );
 #endif
 
+         CONFIG_BOOL(
+               list, list_info,
+               &settings->bools.playlist_binary_cache,
+               MENU_ENUM_LABEL_PLAYLIST_BINARY_CACHE,
+               MENU_ENUM_LABEL_VALUE_PLAYLIST_BINARY_CACHE,
+               DEFAULT_PLAYLIST_BINARY_CACHE,
+               MENU_ENUM_LABEL_VALUE_OFF,
+               MENU_ENUM_LABEL_VALUE_ON,
+               &group_info,
+               &subgroup_info,
+               parent_group,
+               general_write_handler,
+               general_read_handler,
+               SD_FLAG_NONE
+               );
+
          CONFIG_BOOL(
                list, list_info,
                &settings->bools.playlist_show_sublabels,
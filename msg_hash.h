@@ -477,6 +477,7 @@ enum msg_hash_enums
    MENU_LABEL(MENU_XMB_ANIMATION_MOVE_UP_DOWN),
    MENU_LABEL(MENU_XMB_ANIMATION_OPENING_MAIN_MENU),
    MENU_LABEL(SCAN_WITHOUT_CORE_MATCH),
+   MENU_LABEL(SCAN_HASH_THREADS),
    MENU_LABEL(STREAMING_TITLE),
    MENU_LABEL(STREAMING_MODE),
    MENU_LABEL(VIDEO_RECORD_QUALITY),
@@ -1094,6 +1095,7 @@ enum msg_hash_enums
    MENU_LABEL(XMB_VERTICAL_THUMBNAILS),
    MENU_LABEL(MENU_XMB_THUMBNAIL_SCALE_FACTOR),
    MENU_LABEL(MENU_THUMBNAIL_UPSCALE_THRESHOLD),
+   MENU_LABEL(MENU_THUMBNAIL_CACHE_SIZE),
    MENU_LABEL(MENU_RGUI_INLINE_THUMBNAILS),
    MENU_LABEL(MENU_RGUI_SWAP_THUMBNAILS),
    MENU_LABEL(MENU_RGUI_THUMBNAIL_DOWNSCALER),
@@ -1628,6 +1630,9 @@ enum msg_hash_enums
    MENU_LABEL(REWIND_GRANULARITY),
    MENU_LABEL(REWIND_BUFFER_SIZE),
    MENU_LABEL(REWIND_BUFFER_SIZE_STEP),
+   MENU_LABEL(REWIND_THREADS),
+   MENU_LABEL(REWIND_BUFFER_TO_DISK),
+   MENU_LABEL(REWIND_ARCHIVE_SIZE),
    /* TODO/FIXME: INPUT_META_REWIND is incorrectly defined;
     * the LABEL/SUBLABEL enums should be entered 'manually',
     * like all the other hotkeys. Moreover, the resultant
@@ -1964,6 +1969,8 @@ enum msg_hash_enums
 #ifndef HAVE_DYNAMIC
    MENU_LABEL(ALWAYS_RELOAD_CORE_ON_RUN_CONTENT),
 #endif
+   MENU_LABEL(CHD_CACHE_HUNKS),
+   MENU_LABEL(CHD_READAHEAD_HUNKS),
 
    MENU_LABEL(DETECT_CORE_LIST_OK_CURRENT_CORE),
    MENU_LABEL(DETECT_CORE_LIST_OK),
@@ -2862,6 +2869,7 @@ enum msg_hash_enums
    MENU_ENUM_LABEL_VALUE_DOWN_SELECT,
    MENU_LABEL(PLAYLIST_USE_OLD_FORMAT),
    MENU_LABEL(PLAYLIST_COMPRESSION),
+   MENU_LABEL(PLAYLIST_BINARY_CACHE),
    MENU_LABEL(MENU_SOUNDS),
    MENU_LABEL(MENU_SOUND_OK),
    MENU_LABEL(MENU_SOUND_CANCEL),
@@ -20,6 +20,10 @@
 
 #include "netplay_private.h"
 
+#ifdef HAVE_NETPLAY_POLL
+#include <sys/uio.h>
+#endif
+
 static size_t buf_used(struct socket_buffer *sbuf)
 {
    if (sbuf->end < sbuf->start)
@@ -51,6 +55,51 @@ static size_t buf_remaining(struct socket_buffer *sbuf)
    return sbuf->bufsz - buf_used(sbuf) - 1;
 }
 
+#ifdef HAVE_NETPLAY_POLL
+/* Hand both halves of a wrapped send buffer to the socket in one call */
+static ssize_t buf_send_wrapped(struct socket_buffer *sbuf, int sockfd)
+{
+   struct iovec iov[2];
+   struct msghdr msg = {0};
+   ssize_t sent;
+
+   iov[0].iov_base = sbuf->data + sbuf->start;
+   iov[0].iov_len  = sbuf->bufsz - sbuf->start;
+   iov[1].iov_base = sbuf->data;
+   iov[1].iov_len  = sbuf->end;
+   msg.msg_iov     = iov;
+   msg.msg_iovlen  = 2;
+
+   /* sendmsg rather than writev, so a hung up peer can't SIGPIPE us */
+   sent = sendmsg(sockfd, &msg, MSG_NOSIGNAL);
+   if (sent < 0)
+      return isagain((int)sent) ? 0 : -1;
+   return sent;
+}
+
+/* Receive into the free space at both ends of the buffer in one call */
+static ssize_t buf_recv_wrapped(struct socket_buffer *sbuf, int sockfd)
+{
+   struct iovec iov[2];
+   struct msghdr msg = {0};
+   ssize_t recvd;
+
+   iov[0].iov_base = sbuf->data + sbuf->end;
+   iov[0].iov_len  = sbuf->bufsz - sbuf->end;
+   iov[1].iov_base = sbuf->data;
+   iov[1].iov_len  = sbuf->start - 1;
+   msg.msg_iov     = iov;
+   msg.msg_iovlen  = 2;
+
+   recvd = recvmsg(sockfd, &msg, 0);
+   if (recvd == 0)
+      return -1; /* Socket closed */
+   if (recvd < 0)
+      return isagain((int)recvd) ? 0 : -1;
+   return recvd;
+}
+#endif
+
 /**
  * netplay_init_socket_buffer
  *
@@ -234,6 +283,17 @@ bool netplay_send_flush(struct socket_buffer *sbuf, int sockfd, bool block)
       }
       else
       {
+#ifdef HAVE_NETPLAY_POLL
+         if ((sent = buf_send_wrapped(sbuf, sockfd)) < 0)
+            return false;
+
+         sbuf->start += sent;
+
+         if (sbuf->start >= sbuf->bufsz)
+            sbuf->start -= sbuf->bufsz;
+         if (sbuf->start == sbuf->end)
+            sbuf->start = sbuf->end = 0;
+#else
          sent = socket_send_all_nonblocking(
                sockfd, sbuf->data + sbuf->start,
                sbuf->bufsz - sbuf->start, true);
@@ -248,6 +308,7 @@ bool netplay_send_flush(struct socket_buffer *sbuf, int sockfd, bool block)
             sbuf->start = 0;
             return netplay_send_flush(sbuf, sockfd, false);
          }
+#endif
       }
 
    }
@@ -255,6 +316,40 @@ bool netplay_send_flush(struct socket_buffer *sbuf, int sockfd, bool block)
    return true;
 }
 
+/**
+ * netplay_send_queued
+ *
+ * Returns the number of bytes queued in the given socket buffer that have not
+ * been handed to the socket yet.
+ */
+size_t netplay_send_queued(struct socket_buffer *sbuf)
+{
+   return buf_used(sbuf);
+}
+
+/**
+ * netplay_send_cmd
+ *
+ * Queue a command and its payload for sending.
+ */
+bool netplay_send_cmd(struct socket_buffer *sbuf, int sockfd, uint32_t cmd,
+   const void *data, size_t size)
+{
+   uint32_t cmdbuf[2];
+
+   cmdbuf[0] = htonl(cmd);
+   cmdbuf[1] = htonl((uint32_t)size);
+
+   if (!netplay_send(sbuf, sockfd, cmdbuf, sizeof(cmdbuf)))
+      return false;
+
+   if (size > 0)
+      if (!netplay_send(sbuf, sockfd, data, size))
+         return false;
+
+   return true;
+}
+
 /**
  * netplay_recv
  *
@@ -268,41 +363,62 @@ ssize_t netplay_recv(struct socket_buffer *sbuf, int sockfd, void *buf,
    ssize_t recvd;
    bool error    = false;
 
-   /* Receive whatever we can into the buffer */
-   if (sbuf->end >= sbuf->start)
+   /* Receive whatever we can into the buffer. Not when it's full though,
+    * reading nothing would look like the other side hung up. */
+   if (buf_remaining(sbuf))
    {
-      recvd = socket_receive_all_nonblocking(sockfd, &error,
-         sbuf->data + sbuf->end, sbuf->bufsz - sbuf->end -
-         ((sbuf->start == 0) ? 1 : 0));
-
-      if (recvd < 0 || error)
-         return -1;
+#ifdef HAVE_NETPLAY_POLL
+      if (sbuf->end >= sbuf->start && sbuf->start > 0)
+      {
+         if ((recvd = buf_recv_wrapped(sbuf, sockfd)) < 0)
+            return -1;
 
-      sbuf->end += recvd;
+         sbuf->end += recvd;
 
-      if (sbuf->end >= sbuf->bufsz)
+         if (sbuf->end >= sbuf->bufsz)
+            sbuf->end -= sbuf->bufsz;
+      }
+      else
+#endif
+      if (sbuf->end >= sbuf->start)
       {
-         sbuf->end = 0;
-         error     = false;
-         recvd     = socket_receive_all_nonblocking(
-               sockfd, &error, sbuf->data, sbuf->start - 1);
+         recvd = socket_receive_all_nonblocking(sockfd, &error,
+            sbuf->data + sbuf->end, sbuf->bufsz - sbuf->end -
+            ((sbuf->start == 0) ? 1 : 0));
 
          if (recvd < 0 || error)
             return -1;
 
          sbuf->end += recvd;
+
+         if (sbuf->end >= sbuf->bufsz)
+         {
+            sbuf->end = 0;
+
+            if (sbuf->start > 1)
+            {
+               error     = false;
+               recvd     = socket_receive_all_nonblocking(
+                     sockfd, &error, sbuf->data, sbuf->start - 1);
+
+               if (recvd < 0 || error)
+                  return -1;
+
+               sbuf->end += recvd;
+            }
+         }
       }
-   }
-   else
-   {
-      recvd = socket_receive_all_nonblocking(
-            sockfd, &error, sbuf->data + sbuf->end,
-            sbuf->start - sbuf->end - 1);
+      else
+      {
+         recvd = socket_receive_all_nonblocking(
+               sockfd, &error, sbuf->data + sbuf->end,
+               sbuf->start - sbuf->end - 1);
 
-      if (recvd < 0 || error)
-         return -1;
+         if (recvd < 0 || error)
+            return -1;
 
-      sbuf->end += recvd;
+         sbuf->end += recvd;
+      }
    }
 
    /* Now copy it into the reader */
@@ -16,6 +16,7 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 #include <sys/types.h>
 
 #include <boolean.h>
@@ -55,9 +56,10 @@ bool netplay_delta_frame_ready(netplay_t *netplay, struct delta_frame *delta,
          return false;
    }
 
-   delta->used  = true;
-   delta->frame = frame;
-   delta->crc   = 0;
+   delta->used      = true;
+   delta->frame     = frame;
+   delta->have_crc  = false;
+   delta->have_hash = false;
 
    for (i = 0; i < MAX_INPUT_DEVICES; i++)
    {
@@ -79,12 +81,62 @@ bool netplay_delta_frame_ready(netplay_t *netplay, struct delta_frame *delta,
 uint32_t netplay_delta_frame_crc(netplay_t *netplay,
       struct delta_frame *delta)
 {
+   const void *state;
+
    if (!netplay->state_size)
       return 0;
-   return encoding_crc32(0L, (const unsigned char*)delta->state,
+
+   if (!(state = netplay_delta_frame_state(netplay, delta - netplay->buffer)))
+      return 0;
+
+   return encoding_crc32(0L, (const unsigned char*)state,
          netplay->state_size);
 }
 
+/**
+ * netplay_delta_frame_hash_tree
+ *
+ * Build the hash tree for the serialization of this frame into tree.
+ *
+ * Returns: false if the state is lost, leaving tree invalid.
+ */
+bool netplay_delta_frame_hash_tree(netplay_t *netplay,
+      struct delta_frame *delta, struct netplay_hash_tree *tree)
+{
+   const void *state;
+
+   tree->valid = false;
+
+   if (!netplay->state_size)
+      return false;
+
+   if (!(state = netplay_delta_frame_state(netplay, delta - netplay->buffer)))
+      return false;
+
+   if (!netplay_hash_tree_build(tree, state, netplay->state_size))
+      return false;
+   tree->frame = delta->frame;
+
+   return true;
+}
+
+/**
+ * netplay_delta_frame_check_hash
+ *
+ * Build the hash tree of this frame into netplay->hash_tree and check its
+ * root against the one the server sent.
+ *
+ * Returns: true if they match, false if not or if the state is lost.
+ */
+bool netplay_delta_frame_check_hash(netplay_t *netplay,
+      struct delta_frame *delta, uint64_t hash)
+{
+   struct netplay_hash_tree *tree = &netplay->hash_tree;
+
+   return netplay_delta_frame_hash_tree(netplay, delta, tree)
+      && netplay_hash_tree_root(tree) == hash;
+}
+
 /*
  * Free an input state list
  */
@@ -110,10 +162,12 @@ void netplay_delta_frame_free(struct delta_frame *delta)
 {
    uint32_t i;
 
-   if (delta->state)
+   if (delta->patch)
    {
-      free(delta->state);
-      delta->state = NULL;
+      free(delta->patch);
+      delta->patch          = NULL;
+      delta->patch_size     = 0;
+      delta->patch_capacity = 0;
    }
 
    for (i = 0; i < MAX_INPUT_DEVICES; i++)
@@ -124,6 +178,264 @@ void netplay_delta_frame_free(struct delta_frame *delta)
    }
 }
 
+/* Size of a full state buffer, including the padding the diff
+ * scanners need. */
+static size_t netplay_delta_state_alloc_size(netplay_t *netplay)
+{
+   return ((netplay->state_size + 1) & ~(size_t)1) + 32;
+}
+
+static void netplay_delta_memory_update(netplay_t *netplay,
+      size_t old_size, size_t new_size)
+{
+   netplay->state_memory += new_size;
+   netplay->state_memory -= old_size;
+   if (netplay->state_memory > netplay->state_memory_peak)
+      netplay->state_memory_peak = netplay->state_memory;
+}
+
+/**
+ * netplay_delta_states_init
+ *
+ * Allocate the full state buffers once the state size is known.
+ */
+bool netplay_delta_states_init(netplay_t *netplay)
+{
+   size_t full_size = netplay_delta_state_alloc_size(netplay);
+
+   netplay->state_head    = (uint8_t*)state_manager_raw_alloc(netplay->state_size);
+   netplay->state_work    = (uint8_t*)state_manager_raw_alloc(netplay->state_size);
+   netplay->state_scratch = (uint8_t*)state_manager_raw_alloc(netplay->state_size);
+   netplay->state_patch   = (uint8_t*)malloc(
+         state_manager_raw_maxsize(netplay->state_size));
+
+   if (     !netplay->state_head
+         || !netplay->state_work
+         || !netplay->state_scratch
+         || !netplay->state_patch)
+      return false;
+
+   netplay->have_state_head    = false;
+   netplay->have_state_scratch = false;
+
+   netplay_delta_memory_update(netplay, 0, full_size * 3
+         + state_manager_raw_maxsize(netplay->state_size));
+
+   RARCH_LOG("[Netplay]: Keeping %u frames of %u-byte states as deltas, "
+         "full states would take %.1f MB.\n",
+         (unsigned)netplay->buffer_size, (unsigned)netplay->state_size,
+         (double)netplay->buffer_size * netplay->state_size
+         / (1024.0 * 1024.0));
+
+   return true;
+}
+
+/**
+ * netplay_delta_states_free
+ *
+ * Free the full state buffers and report the memory used.
+ */
+void netplay_delta_states_free(netplay_t *netplay)
+{
+   if (netplay->state_memory_peak)
+      RARCH_LOG("[Netplay]: State buffers peaked at %.1f MB "
+            "(%.1f MB as full states).\n",
+            netplay->state_memory_peak / (1024.0 * 1024.0),
+            (double)netplay->buffer_size * netplay->state_size
+            / (1024.0 * 1024.0));
+
+   free(netplay->state_head);
+   free(netplay->state_work);
+   free(netplay->state_scratch);
+   free(netplay->state_patch);
+
+   netplay->state_head         = NULL;
+   netplay->state_work         = NULL;
+   netplay->state_scratch      = NULL;
+   netplay->state_patch        = NULL;
+   netplay->have_state_head    = false;
+   netplay->have_state_scratch = false;
+   netplay->state_memory       = 0;
+   netplay->state_memory_peak  = 0;
+}
+
+/* Is the state of the frame at ptr reachable from the newest state? */
+static bool netplay_delta_frame_has_state(netplay_t *netplay, size_t ptr)
+{
+   size_t i;
+
+   if (!netplay->have_state_head)
+      return false;
+
+   for (i = netplay->state_head_ptr;;)
+   {
+      if (i == ptr)
+         return true;
+      i = PREV_PTR(i);
+      if (i == netplay->state_head_ptr || !netplay->buffer[i].patch_size)
+         return false;
+   }
+}
+
+/* Stores in delta the patch turning the new state into old_state. */
+static void netplay_delta_frame_diff(netplay_t *netplay,
+      struct delta_frame *delta, const void *old_state)
+{
+   size_t size = state_manager_raw_compress(old_state, netplay->state_work,
+         netplay->state_size, netplay->state_patch);
+
+   /* Grow in 4 KiB steps, and give memory back after a burst of
+    * changes (e.g. a scene transition) has passed */
+   if (     size > delta->patch_capacity
+         || (delta->patch_capacity > 65536 && size < delta->patch_capacity / 4))
+   {
+      size_t capacity = (size + 4095) & ~(size_t)4095;
+      uint8_t *patch  = (uint8_t*)realloc(delta->patch, capacity);
+
+      if (!patch)
+      {
+         delta->patch_size = 0;
+         return;
+      }
+
+      netplay_delta_memory_update(netplay, delta->patch_capacity, capacity);
+      delta->patch          = patch;
+      delta->patch_capacity = capacity;
+   }
+
+   memcpy(delta->patch, netplay->state_patch, size);
+   delta->patch_size = size;
+}
+
+/**
+ * netplay_delta_frame_state_buffer
+ *
+ * Get the buffer to serialize a new state into, before handing it to
+ * netplay_delta_frame_store_state. Its contents are undefined.
+ */
+void *netplay_delta_frame_state_buffer(netplay_t *netplay)
+{
+   return netplay->state_work;
+}
+
+/**
+ * netplay_delta_frame_store_state
+ *
+ * Store the state in netplay_delta_frame_state_buffer as the state of the
+ * frame at ptr. States newer than ptr are discarded.
+ */
+void netplay_delta_frame_store_state(netplay_t *netplay, size_t ptr)
+{
+   size_t i;
+   uint8_t *swap;
+
+   if (!netplay->state_work)
+      return;
+
+   if (netplay->have_state_head)
+   {
+      size_t head = netplay->state_head_ptr;
+
+      if (ptr == NEXT_PTR(head))
+         netplay_delta_frame_diff(netplay,
+               &netplay->buffer[head], netplay->state_head);
+      else if (netplay_delta_frame_has_state(netplay, ptr))
+      {
+         /* Replaying: rebase the frame before on the new state. The
+          * frames after are about to be replayed too. */
+         size_t prev = PREV_PTR(ptr);
+
+         if (prev != head && netplay->buffer[prev].patch_size)
+            netplay_delta_frame_diff(netplay, &netplay->buffer[prev],
+                  netplay_delta_frame_state(netplay, prev));
+
+         for (i = ptr;; i = NEXT_PTR(i))
+         {
+            netplay->buffer[i].patch_size = 0;
+            if (i == head)
+               break;
+         }
+      }
+      else
+      {
+         for (i = 0; i < netplay->buffer_size; i++)
+            netplay->buffer[i].patch_size = 0;
+      }
+   }
+
+   netplay->buffer[ptr].patch_size = 0;
+
+   swap                        = netplay->state_head;
+   netplay->state_head         = netplay->state_work;
+   netplay->state_work         = swap;
+   netplay->state_head_ptr     = ptr;
+   netplay->have_state_head    = true;
+
+   if (netplay->have_state_scratch
+         && (  netplay->state_scratch_ptr == ptr
+            || !netplay_delta_frame_has_state(netplay,
+               netplay->state_scratch_ptr)))
+      netplay->have_state_scratch = false;
+}
+
+/**
+ * netplay_delta_frame_state
+ *
+ * Get the serialized state of the frame at ptr, rebuilding it from the
+ * newest state if needed. Only valid until the next call to any of the
+ * state functions. Returns NULL if the state was never stored or can no
+ * longer be rebuilt.
+ */
+const void *netplay_delta_frame_state(netplay_t *netplay, size_t ptr)
+{
+   size_t i;
+   bool from_scratch = false;
+
+   if (!netplay->state_scratch)
+      return NULL;
+
+   if (netplay->have_state_head && ptr == netplay->state_head_ptr)
+      return netplay->state_head;
+
+   if (netplay->have_state_scratch && ptr == netplay->state_scratch_ptr)
+      return netplay->state_scratch;
+
+   /* Never stored, or the chain of patches back to it is broken */
+   if (!netplay_delta_frame_has_state(netplay, ptr))
+      return NULL;
+
+   /* Walk back from the newest state, or from the one in scratch if
+    * it is between ptr and the newest */
+   for (i = netplay->state_head_ptr; i != ptr; i = PREV_PTR(i))
+   {
+      if (netplay->have_state_scratch && i == netplay->state_scratch_ptr)
+      {
+         from_scratch = true;
+         break;
+      }
+   }
+
+   if (!from_scratch)
+   {
+      memcpy(netplay->state_scratch, netplay->state_head,
+            netplay->state_size);
+      i = netplay->state_head_ptr;
+   }
+
+   do
+   {
+      i = PREV_PTR(i);
+      state_manager_raw_decompress(netplay->buffer[i].patch,
+            netplay->buffer[i].patch_size,
+            netplay->state_scratch, netplay->state_size);
+   } while (i != ptr);
+
+   netplay->state_scratch_ptr  = ptr;
+   netplay->have_state_scratch = true;
+
+   return netplay->state_scratch;
+}
+
 /**
  * netplay_input_state_for
  *
@@ -293,9 +293,9 @@ bool netplay_lan_ad_server(netplay_t *netplay)
             continue;
          }
 
-         /* For this version */
-         if (ntohl(ad_packet_buffer.protocol_version) !=
-               NETPLAY_PROTOCOL_VERSION)
+         /* For a version we can talk to */
+         if (ntohl(ad_packet_buffer.protocol_version) <
+               NETPLAY_PROTOCOL_VERSION_MIN)
          {
             RARCH_LOG("[discovery] invalid protocol version\n");
             continue;
@@ -466,8 +466,8 @@ static bool netplay_lan_ad_client(void)
          if (memcmp((void *) &ad_packet_buffer, "RANS", 4))
             continue;
 
-         /* For this version */
-         if (ntohl(ad_packet_buffer.protocol_version) != NETPLAY_PROTOCOL_VERSION)
+         /* For a version we can talk to */
+         if (ntohl(ad_packet_buffer.protocol_version) < NETPLAY_PROTOCOL_VERSION_MIN)
             continue;
 
          /* And that we know how to handle it */
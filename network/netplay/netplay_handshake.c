@@ -21,8 +21,6 @@
 
 #include <boolean.h>
 #include <compat/strl.h>
-#include <string/stdstring.h>
-#include <rhash.h>
 #include <retro_timers.h>
 
 #include "netplay_private.h"
@@ -35,27 +33,6 @@
 #include "../../configuration.h"
 #include "../../content.h"
 #include "../../retroarch.h"
-#include "../../version.h"
-
-struct nick_buf_s
-{
-   uint32_t cmd[2];
-   char nick[NETPLAY_NICK_LEN];
-};
-
-struct password_buf_s
-{
-   uint32_t cmd[2];
-   char password[NETPLAY_PASS_HASH_LEN];
-};
-
-struct info_buf_s
-{
-   uint32_t cmd[2];
-   char core_name[NETPLAY_NICK_LEN];
-   char core_version[NETPLAY_NICK_LEN];
-   uint32_t content_crc;
-};
 
 #define RECV(buf, sz) \
    recvd = netplay_recv(&connection->recv_packet_buffer, connection->fd, (buf), (sz), false); \
@@ -66,8 +43,6 @@ struct info_buf_s
    } \
    else if (recvd < 0)
 
-#define NETPLAY_MAGIC 0x52414E50 /* RANP */
-
 /* TODO/FIXME - static global variables */
 static netplay_t *handshake_password_netplay = NULL;
 static unsigned long simple_rand_next        = 1;
@@ -149,48 +124,6 @@ static void netplay_log_connection(
 }
 #endif
 
-/**
- * netplay_impl_magic:
- *
- * A pseudo-hash of the RetroArch and Netplay version, so only compatible
- * versions play together.
- */
-static uint32_t netplay_impl_magic(void)
-{
-   size_t i;
-   uint32_t res                        = 0;
-   const char *ver                     = PACKAGE_VERSION;
-   size_t len                          = strlen(ver);
-
-   for (i = 0; i < len; i++)
-      res ^= ver[i] << (i & 0xf);
-
-   res ^= NETPLAY_PROTOCOL_VERSION << (i & 0xf);
-
-   return res;
-}
-
-/**
- * netplay_platform_magic
- *
- * Just enough info to tell us if our platforms mismatch: Endianness and a
- * couple of type sizes.
- *
- * Format:
- *    bit 31:     Reserved
- *    bit 30:     1 for big endian
- *    bits 29-15: sizeof(size_t)
- *    bits 14-0:  sizeof(long)
- */
-static uint32_t netplay_platform_magic(void)
-{
-   uint32_t ret =
-       ((1 == htonl(1)) << 30)
-      |(sizeof(size_t) << 15)
-      |(sizeof(long));
-   return ret;
-}
-
 /**
  * netplay_endian_mismatch
  *
@@ -236,13 +169,6 @@ bool netplay_handshake_init_send(netplay_t *netplay,
    unsigned conn_salt   = 0;
    settings_t *settings = config_get_ptr();
 
-   header[0] = htonl(NETPLAY_MAGIC);
-   header[1] = htonl(netplay_platform_magic());
-   header[2] = htonl(NETPLAY_COMPRESSION_SUPPORTED);
-   header[3] = 0;
-   header[4] = htonl(NETPLAY_PROTOCOL_VERSION);
-   header[5] = htonl(netplay_impl_magic());
-
    if (netplay->is_server &&
        (settings->paths.netplay_password[0] ||
         settings->paths.netplay_spectate_password[0]))
@@ -256,7 +182,7 @@ bool netplay_handshake_init_send(netplay_t *netplay,
       conn_salt           = connection->salt;
    }
 
-   header[3] = htonl(conn_salt);
+   netplay_protocol_header(header, conn_salt);
 
    if (!netplay_send(&connection->send_packet_buffer, connection->fd, header,
          sizeof(header)) ||
@@ -269,23 +195,11 @@ bool netplay_handshake_init_send(netplay_t *netplay,
 #ifdef HAVE_MENU
 static void handshake_password(void *ignore, const char *line)
 {
-   struct password_buf_s password_buf;
-   char password[8+NETPLAY_PASS_LEN]; /* 8 for salt, 128 for password */
-   char hash[NETPLAY_PASS_HASH_LEN+1]; /* + NULL terminator */
    netplay_t *netplay                    = handshake_password_netplay;
    struct netplay_connection *connection = &netplay->connections[0];
 
-   snprintf(password, sizeof(password), "%08X", connection->salt);
-   if (!string_is_empty(line))
-      strlcpy(password + 8, line, sizeof(password)-8);
-
-   password_buf.cmd[0] = htonl(NETPLAY_CMD_PASSWORD);
-   password_buf.cmd[1] = htonl(sizeof(password_buf.password));
-   sha256_hash(hash, (uint8_t *) password, strlen(password));
-   memcpy(password_buf.password, hash, NETPLAY_PASS_HASH_LEN);
-
    /* We have no way to handle an error here, so we'll let the next function error out */
-   if (netplay_send(&connection->send_packet_buffer, connection->fd, &password_buf, sizeof(password_buf)))
+   if (netplay_protocol_send_password(connection, line))
       netplay_send_flush(&connection->send_packet_buffer, connection->fd, false);
 
 #ifdef HAVE_MENU
@@ -305,12 +219,9 @@ bool netplay_handshake_init(netplay_t *netplay,
    struct netplay_connection *connection, bool *had_input)
 {
    ssize_t recvd;
-   struct nick_buf_s nick_buf;
    uint32_t header[6];
    uint32_t local_pmagic                 = 0;
    uint32_t remote_pmagic                = 0;
-   uint32_t remote_version               = 0;
-   uint32_t compression                  = 0;
    struct compression_transcoder *ctrans = NULL;
    const char *dmsg                      = NULL;
 
@@ -334,12 +245,8 @@ bool netplay_handshake_init(netplay_t *netplay,
       goto error;
    }
 
-   remote_version = ntohl(header[4]);
-   if (remote_version < NETPLAY_PROTOCOL_VERSION)
-   {
-      dmsg = msg_hash_to_str(MSG_NETPLAY_OUT_OF_DATE);
+   if ((dmsg = netplay_protocol_check_header(connection, header)))
       goto error;
-   }
 
    if (ntohl(header[5]) != netplay_impl_magic())
    {
@@ -368,11 +275,8 @@ bool netplay_handshake_init(netplay_t *netplay,
       goto error;
    }
 
-   /* Check what compression is supported */
-   compression  = ntohl(header[2]);
-   compression &= NETPLAY_COMPRESSION_SUPPORTED;
-
-   if (compression & NETPLAY_COMPRESSION_ZLIB)
+   /* Set up the compression it supports */
+   if (connection->compression_supported & NETPLAY_COMPRESSION_ZLIB)
    {
       ctrans = &netplay->compress_zlib;
       if (!ctrans->compression_backend)
@@ -382,7 +286,6 @@ bool netplay_handshake_init(netplay_t *netplay,
          if (!ctrans->compression_backend)
             ctrans->compression_backend = trans_stream_get_pipe_backend();
       }
-      connection->compression_supported = NETPLAY_COMPRESSION_ZLIB;
    }
    else
    {
@@ -392,7 +295,6 @@ bool netplay_handshake_init(netplay_t *netplay,
          ctrans->compression_backend =
             trans_stream_get_pipe_backend();
       }
-      connection->compression_supported = 0;
    }
 
    if (!ctrans->decompression_backend)
@@ -431,12 +333,7 @@ bool netplay_handshake_init(netplay_t *netplay,
    }
 
    /* Send our nick */
-   nick_buf.cmd[0] = htonl(NETPLAY_CMD_NICK);
-   nick_buf.cmd[1] = htonl(sizeof(nick_buf.nick));
-   memset(nick_buf.nick, 0, sizeof(nick_buf.nick));
-   strlcpy(nick_buf.nick, netplay->nick, sizeof(nick_buf.nick));
-   if (!netplay_send(&connection->send_packet_buffer, connection->fd, &nick_buf,
-         sizeof(nick_buf)) ||
+   if (!netplay_protocol_send_nick(connection, netplay->nick) ||
        !netplay_send_flush(&connection->send_packet_buffer, connection->fd, false))
       return false;
 
@@ -551,10 +448,8 @@ static bool netplay_handshake_sync(netplay_t *netplay,
    /* If we're the server, now we send sync info */
    size_t i;
    int matchct;
-   uint32_t cmd[4];
    retro_ctx_memory_info_t mem_info;
    uint32_t client_num        = 0;
-   uint32_t device            = 0;
    size_t nicklen, nickmangle = 0;
    bool nick_matched          = false;
 
@@ -567,58 +462,11 @@ static bool netplay_handshake_sync(netplay_t *netplay,
    autosave_unlock();
 #endif
 
-   /* Send basic sync info */
-   cmd[0]     = htonl(NETPLAY_CMD_SYNC);
-   cmd[1]     = htonl(2*sizeof(uint32_t)
-         /* Controller devices */
-         + MAX_INPUT_DEVICES*sizeof(uint32_t)
-
-         /* Share modes */
-         + MAX_INPUT_DEVICES*sizeof(uint8_t)
-
-         /* Device-client mapping */
-         + MAX_INPUT_DEVICES*sizeof(uint32_t)
-
-         /* Client nick */
-         + NETPLAY_NICK_LEN
-
-         /* And finally, sram */
-         + mem_info.size);
-   cmd[2]     = htonl(netplay->self_frame_count);
    client_num = (uint32_t)(connection - netplay->connections + 1);
 
    if (netplay->local_paused || netplay->remote_paused)
       client_num |= NETPLAY_CMD_SYNC_BIT_PAUSED;
 
-   cmd[3]     = htonl(client_num);
-
-   if (!netplay_send(&connection->send_packet_buffer, connection->fd, cmd,
-            sizeof(cmd)))
-      return false;
-
-   /* Now send the device info */
-   for (i = 0; i < MAX_INPUT_DEVICES; i++)
-   {
-      device = htonl(netplay->config_devices[i]);
-      if (!netplay_send(&connection->send_packet_buffer, connection->fd,
-            &device, sizeof(device)))
-         return false;
-   }
-
-   /* Then the share mode */
-   if (!netplay_send(&connection->send_packet_buffer, connection->fd,
-         netplay->device_share_modes, sizeof(netplay->device_share_modes)))
-      return false;
-
-   /* Then the device-client mapping */
-   for (i = 0; i < MAX_INPUT_DEVICES; i++)
-   {
-      device = htonl(netplay->device_clients[i]);
-      if (!netplay_send(&connection->send_packet_buffer, connection->fd,
-            &device, sizeof(device)))
-         return false;
-   }
-
    /* Now see if we need to mangle their nick */
    nicklen = strlen(connection->nick);
    if (nicklen > NETPLAY_NICK_LEN - 5)
@@ -654,16 +502,13 @@ static bool netplay_handshake_sync(netplay_t *netplay,
       }
    } while (nick_matched);
 
-   /* Send the nick */
-   if (!netplay_send(&connection->send_packet_buffer, connection->fd,
-         connection->nick, NETPLAY_NICK_LEN))
-      return false;
-
-   /* And finally, the SRAM */
+   /* Send the sync info, with the SRAM */
 #ifdef HAVE_THREADS
    autosave_lock();
 #endif
-   if (!netplay_send(&connection->send_packet_buffer, connection->fd,
+   if (!netplay_protocol_send_sync(connection, netplay->self_frame_count,
+            client_num, netplay->config_devices,
+            netplay->device_share_modes, netplay->device_clients,
             mem_info.data, mem_info.size) ||
          !netplay_send_flush(&connection->send_packet_buffer, connection->fd,
             false))
@@ -757,8 +602,6 @@ static bool netplay_handshake_pre_password(netplay_t *netplay,
    struct netplay_connection *connection, bool *had_input)
 {
    struct password_buf_s password_buf;
-   char password[8+NETPLAY_PASS_LEN]; /* 8 for salt */
-   char hash[NETPLAY_PASS_HASH_LEN+1]; /* + NULL terminator */
    ssize_t recvd;
    char msg[512];
    bool correct         = false;
@@ -785,33 +628,20 @@ static bool netplay_handshake_pre_password(netplay_t *netplay,
       return false;
    }
 
-   /* Calculate the correct password hash(es) and compare */
+   /* Compare against the correct password hash(es) */
    correct = false;
-   snprintf(password, sizeof(password), "%08X", connection->salt);
 
-   if (settings->paths.netplay_password[0])
+   if (settings->paths.netplay_password[0] &&
+       netplay_protocol_check_password(connection, password_buf.password,
+          settings->paths.netplay_password))
    {
-      strlcpy(password + 8,
-            settings->paths.netplay_password, sizeof(password)-8);
-
-      sha256_hash(hash, (uint8_t *) password, strlen(password));
-
-      if (!memcmp(password_buf.password, hash, NETPLAY_PASS_HASH_LEN))
-      {
-         correct              = true;
-         connection->can_play = true;
-      }
-   }
-   if (settings->paths.netplay_spectate_password[0])
-   {
-      strlcpy(password + 8,
-            settings->paths.netplay_spectate_password, sizeof(password)-8);
-
-      sha256_hash(hash, (uint8_t *) password, strlen(password));
-
-      if (!memcmp(password_buf.password, hash, NETPLAY_PASS_HASH_LEN))
-         correct = true;
+      correct              = true;
+      connection->can_play = true;
    }
+   if (settings->paths.netplay_spectate_password[0] &&
+       netplay_protocol_check_password(connection, password_buf.password,
+          settings->paths.netplay_spectate_password))
+      correct = true;
 
    /* Just disconnect if it was wrong */
    if (!correct)
@@ -960,8 +790,7 @@ static bool netplay_handshake_pre_sync(netplay_t *netplay,
 
    /* Only expecting a sync command */
    if (ntohl(cmd[0]) != NETPLAY_CMD_SYNC ||
-         ntohl(cmd[1]) < (2+2*MAX_INPUT_DEVICES)*sizeof(uint32_t) + (MAX_INPUT_DEVICES)*sizeof(uint8_t) +
-         NETPLAY_NICK_LEN)
+         ntohl(cmd[1]) < NETPLAY_CMD_SYNC_MIN_SIZE)
    {
       RARCH_ERR("%s\n",
             msg_hash_to_str(MSG_FAILED_TO_RECEIVE_SRAM_DATA_FROM_HOST));
@@ -1080,8 +909,7 @@ static bool netplay_handshake_pre_sync(netplay_t *netplay,
    core_get_memory(&mem_info);
 
    local_sram_size  = (unsigned)mem_info.size;
-   remote_sram_size = ntohl(cmd[1]) -
-         (2+2*MAX_INPUT_DEVICES)*sizeof(uint32_t) - (MAX_INPUT_DEVICES)*sizeof(uint8_t) - NETPLAY_NICK_LEN;
+   remote_sram_size = ntohl(cmd[1]) - NETPLAY_CMD_SYNC_MIN_SIZE;
 
    if (local_sram_size != 0 && local_sram_size == remote_sram_size)
    {
@@ -0,0 +1,222 @@
+/*  RetroArch - A frontend for libretro.
+ *  Copyright (C) 2016-2017 - Gregor Richards
+ *
+ *  RetroArch is free software: you can redistribute it and/or modify it under the terms
+ *  of the GNU General Public License as published by the Free Software Found-
+ *  ation, either version 3 of the License, or (at your option) any later version.
+ *
+ *  RetroArch is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ *  PURPOSE.  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with RetroArch.
+ *  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+
+#include <retro_inline.h>
+#include <retro_endianness.h>
+
+#include "netplay_hash.h"
+
+#define PRIME64_1 UINT64_C(0x9E3779B185EBCA87)
+#define PRIME64_2 UINT64_C(0xC2B2AE3D27D4EB4F)
+#define PRIME64_3 UINT64_C(0x165667B19E3779F9)
+#define PRIME64_4 UINT64_C(0x85EBCA77C2B2AE63)
+#define PRIME64_5 UINT64_C(0x27D4EB2F165667C5)
+
+#define ROTL64(x, r) (((x) << (r)) | ((x) >> (64 - (r))))
+
+static INLINE uint64_t netplay_hash_round(uint64_t acc, uint64_t input)
+{
+   acc += input * PRIME64_2;
+   acc  = ROTL64(acc, 31);
+   return acc * PRIME64_1;
+}
+
+static INLINE uint64_t netplay_hash_merge(uint64_t acc, uint64_t val)
+{
+   acc ^= netplay_hash_round(0, val);
+   return acc * PRIME64_1 + PRIME64_4;
+}
+
+uint64_t netplay_hash(const void *data, size_t len, uint64_t seed)
+{
+   uint8_t *p         = (uint8_t*)data;
+   const uint8_t *end = p + len;
+   uint64_t h;
+
+   if (len >= 32)
+   {
+      const uint8_t *limit = end - 32;
+      uint64_t v1          = seed + PRIME64_1 + PRIME64_2;
+      uint64_t v2          = seed + PRIME64_2;
+      uint64_t v3          = seed;
+      uint64_t v4          = seed - PRIME64_1;
+
+      do
+      {
+         v1  = netplay_hash_round(v1, retro_get_unaligned_64le(p));
+         v2  = netplay_hash_round(v2, retro_get_unaligned_64le(p + 8));
+         v3  = netplay_hash_round(v3, retro_get_unaligned_64le(p + 16));
+         v4  = netplay_hash_round(v4, retro_get_unaligned_64le(p + 24));
+         p  += 32;
+      } while (p <= limit);
+
+      h = ROTL64(v1, 1) + ROTL64(v2, 7) + ROTL64(v3, 12) + ROTL64(v4, 18);
+      h = netplay_hash_merge(h, v1);
+      h = netplay_hash_merge(h, v2);
+      h = netplay_hash_merge(h, v3);
+      h = netplay_hash_merge(h, v4);
+   }
+   else
+      h = seed + PRIME64_5;
+
+   h += (uint64_t)len;
+
+   for (; p + 8 <= end; p += 8)
+   {
+      h ^= netplay_hash_round(0, retro_get_unaligned_64le(p));
+      h  = ROTL64(h, 27) * PRIME64_1 + PRIME64_4;
+   }
+
+   if (p + 4 <= end)
+   {
+      h ^= (uint64_t)retro_get_unaligned_32le(p) * PRIME64_1;
+      h  = ROTL64(h, 23) * PRIME64_2 + PRIME64_3;
+      p += 4;
+   }
+
+   for (; p < end; p++)
+   {
+      h ^= (*p) * PRIME64_5;
+      h  = ROTL64(h, 11) * PRIME64_1;
+   }
+
+   h ^= h >> 33;
+   h *= PRIME64_2;
+   h ^= h >> 29;
+   h *= PRIME64_3;
+   h ^= h >> 32;
+
+   return h;
+}
+
+bool netplay_hash_tree_build(struct netplay_hash_tree *tree,
+      const void *state, size_t size)
+{
+   size_t i;
+   unsigned level;
+   size_t num_nodes  = 0;
+   size_t level_size = (size + NETPLAY_HASH_BLOCK_SIZE - 1)
+      / NETPLAY_HASH_BLOCK_SIZE;
+   const uint8_t *in = (const uint8_t*)state;
+
+   tree->valid  = false;
+   tree->levels = 0;
+
+   if (!level_size)
+      level_size = 1;
+
+   /* Lay out the levels */
+   for (;;)
+   {
+      if (tree->levels >= NETPLAY_HASH_MAX_LEVELS)
+         return false;
+
+      tree->level_offset[tree->levels] = num_nodes;
+      tree->level_size[tree->levels]   = level_size;
+      tree->levels++;
+      num_nodes += level_size;
+
+      if (level_size == 1)
+         break;
+      level_size = (level_size + NETPLAY_HASH_FANOUT - 1)
+         / NETPLAY_HASH_FANOUT;
+   }
+
+   if (num_nodes > tree->capacity)
+   {
+      uint64_t *nodes = (uint64_t*)realloc(tree->nodes,
+            num_nodes * sizeof(*nodes));
+      if (!nodes)
+         return false;
+      tree->nodes    = nodes;
+      tree->capacity = num_nodes;
+   }
+
+   /* Leaves */
+   for (i = 0; i < tree->level_size[0]; i++)
+   {
+      size_t offset = i * NETPLAY_HASH_BLOCK_SIZE;
+      size_t len    = size - offset;
+
+      if (len > NETPLAY_HASH_BLOCK_SIZE)
+         len = NETPLAY_HASH_BLOCK_SIZE;
+
+      tree->nodes[i] = netplay_hash(in + offset, size ? len : 0, 0);
+   }
+
+   /* Inner nodes hash their children as little endian words */
+   for (level = 1; level < tree->levels; level++)
+   {
+      const uint64_t *below = tree->nodes + tree->level_offset[level - 1];
+      uint64_t *out         = tree->nodes + tree->level_offset[level];
+
+      for (i = 0; i < tree->level_size[level]; i++)
+      {
+         size_t j;
+         uint8_t buf[NETPLAY_HASH_FANOUT * sizeof(uint64_t)];
+         size_t first = i * NETPLAY_HASH_FANOUT;
+         size_t count = tree->level_size[level - 1] - first;
+
+         if (count > NETPLAY_HASH_FANOUT)
+            count = NETPLAY_HASH_FANOUT;
+
+         for (j = 0; j < count; j++)
+            retro_set_unaligned_64le(buf + j * sizeof(uint64_t),
+                  below[first + j]);
+
+         out[i] = netplay_hash(buf, count * sizeof(uint64_t), level);
+      }
+   }
+
+   tree->valid = true;
+   return true;
+}
+
+uint64_t netplay_hash_tree_root(const struct netplay_hash_tree *tree)
+{
+   return tree->nodes[tree->level_offset[tree->levels - 1]];
+}
+
+size_t netplay_hash_tree_children(const struct netplay_hash_tree *tree,
+      unsigned level, size_t index, size_t *first)
+{
+   size_t count;
+
+   if (level == 0 || level >= tree->levels
+         || index >= tree->level_size[level])
+      return 0;
+
+   *first = index * NETPLAY_HASH_FANOUT;
+   count  = tree->level_size[level - 1] - *first;
+
+   return count > NETPLAY_HASH_FANOUT ? NETPLAY_HASH_FANOUT : count;
+}
+
+uint64_t netplay_hash_tree_node(const struct netplay_hash_tree *tree,
+      unsigned level, size_t index)
+{
+   return tree->nodes[tree->level_offset[level] + index];
+}
+
+void netplay_hash_tree_free(struct netplay_hash_tree *tree)
+{
+   free(tree->nodes);
+   tree->nodes    = NULL;
+   tree->capacity = 0;
+   tree->levels   = 0;
+   tree->valid    = false;
+}
@@ -0,0 +1,113 @@
+/*  RetroArch - A frontend for libretro.
+ *  Copyright (C) 2016-2017 - Gregor Richards
+ *
+ *  RetroArch is free software: you can redistribute it and/or modify it under the terms
+ *  of the GNU General Public License as published by the Free Software Found-
+ *  ation, either version 3 of the License, or (at your option) any later version.
+ *
+ *  RetroArch is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ *  PURPOSE.  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with RetroArch.
+ *  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __RARCH_NETPLAY_HASH_H
+#define __RARCH_NETPLAY_HASH_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <boolean.h>
+#include <retro_common_api.h>
+
+RETRO_BEGIN_DECLS
+
+/* Frame hashes are a tree over the serialized state: each leaf hashes
+ * this many bytes of the state, each inner node hashes up to
+ * NETPLAY_HASH_FANOUT nodes of the level below, and the root stands
+ * for the whole state. When two roots differ, comparing the levels
+ * below top down finds the blocks that differ. */
+#define NETPLAY_HASH_BLOCK_SIZE  4096
+#define NETPLAY_HASH_FANOUT      16
+
+/* Enough levels for any state that fits in a size_t */
+#define NETPLAY_HASH_MAX_LEVELS  16
+
+struct netplay_hash_tree
+{
+   /* All levels, leaves first and the root last */
+   uint64_t *nodes;
+   size_t capacity;
+
+   size_t level_offset[NETPLAY_HASH_MAX_LEVELS];
+   size_t level_size[NETPLAY_HASH_MAX_LEVELS];
+   unsigned levels;
+
+   /* Frame the tree was built for, if valid */
+   uint32_t frame;
+   bool valid;
+};
+
+/**
+ * netplay_hash:
+ * @data                 : data to hash.
+ * @len                  : length of @data in bytes.
+ * @seed                 : seed.
+ *
+ * A fast non-cryptographic 64-bit hash (XXH64), independent of the
+ * host's endianness.
+ *
+ * Returns: the hash of @data.
+ **/
+uint64_t netplay_hash(const void *data, size_t len, uint64_t seed);
+
+/**
+ * netplay_hash_tree_build:
+ * @tree                 : tree to (re)build, zeroed before the first use.
+ * @state                : serialized state.
+ * @size                 : size of @state in bytes.
+ *
+ * Returns: true on success. @tree->frame is left to the caller.
+ **/
+bool netplay_hash_tree_build(struct netplay_hash_tree *tree,
+      const void *state, size_t size);
+
+/**
+ * netplay_hash_tree_root:
+ * @tree                 : a built tree.
+ *
+ * Returns: the hash of the whole state.
+ **/
+uint64_t netplay_hash_tree_root(const struct netplay_hash_tree *tree);
+
+/**
+ * netplay_hash_tree_children:
+ * @tree                 : a built tree.
+ * @level                : level of the node, 0 being the leaves.
+ * @index                : index of the node within @level.
+ * @first                : index of its first child within @level - 1.
+ *
+ * Returns: the number of children of the node, 0 if it has none or
+ * does not exist.
+ **/
+size_t netplay_hash_tree_children(const struct netplay_hash_tree *tree,
+      unsigned level, size_t index, size_t *first);
+
+/**
+ * netplay_hash_tree_node:
+ * @tree                 : a built tree.
+ * @level                : level of the node, 0 being the leaves.
+ * @index                : index of the node within @level.
+ *
+ * Returns: the hash of the node. It must exist.
+ **/
+uint64_t netplay_hash_tree_node(const struct netplay_hash_tree *tree,
+      unsigned level, size_t index);
+
+void netplay_hash_tree_free(struct netplay_hash_tree *tree);
+
+RETRO_END_DECLS
+
+#endif
@@ -21,6 +21,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/types.h>
 
 #include <boolean.h>
@@ -271,7 +272,6 @@ static bool netplay_init_socket_buffers(netplay_t *netplay)
 
 static bool netplay_init_serialization(netplay_t *netplay)
 {
-   unsigned i;
    retro_ctx_size_info_t info;
 
    if (netplay->state_size)
@@ -284,15 +284,10 @@ static bool netplay_init_serialization(netplay_t *netplay)
 
    netplay->state_size = info.size;
 
-   for (i = 0; i < netplay->buffer_size; i++)
+   if (!netplay_delta_states_init(netplay))
    {
-      netplay->buffer[i].state = calloc(netplay->state_size, 1);
-
-      if (!netplay->buffer[i].state)
-      {
-         netplay->quirks |= NETPLAY_QUIRK_NO_SAVESTATES;
-         return false;
-      }
+      netplay->quirks |= NETPLAY_QUIRK_NO_SAVESTATES;
+      return false;
    }
 
    netplay->zbuffer_size = netplay->state_size * 2;
@@ -326,12 +321,14 @@ bool netplay_try_init_serialization(netplay_t *netplay)
 
    /* Check if we can actually save */
    serial_info.data_const = NULL;
-   serial_info.data       = netplay->buffer[netplay->run_ptr].state;
+   serial_info.data       = netplay_delta_frame_state_buffer(netplay);
    serial_info.size       = netplay->state_size;
 
    if (!core_serialize(&serial_info))
       return false;
 
+   netplay_delta_frame_store_state(netplay, netplay->run_ptr);
+
    /* Once initialized, we no longer exhibit this quirk */
    netplay->quirks &= ~((uint64_t) NETPLAY_QUIRK_INITIALIZATION);
 
@@ -506,9 +503,31 @@ netplay_t *netplay_new(void *direct_host, const char *server, uint16_t port,
          goto error;
    }
 
+   if (!netplay_poller_init(&netplay->poller, NULL))
+      goto error;
+
+   RARCH_LOG("[netplay] Waiting on sockets with %s.\n",
+         netplay->poller.backend->ident);
+
+   if (netplay->is_server)
+   {
+      if (!netplay_poller_add(&netplay->poller, netplay->listen_fd,
+               NETPLAY_POLL_TAG_LISTEN))
+         goto error;
+   }
+   else
+   {
+      if (!netplay_poller_add(&netplay->poller, netplay->connections[0].fd,
+               1))
+         goto error;
+      netplay->connections[0].readable = true;
+   }
+
    return netplay;
 
 error:
+   netplay_poller_deinit(&netplay->poller);
+
    if (netplay->listen_fd >= 0)
       socket_close(netplay->listen_fd);
 
@@ -529,6 +548,9 @@ void netplay_free(netplay_t *netplay)
 {
    size_t i;
 
+   /* Closing them takes them out of the poller too */
+   netplay_poller_deinit(&netplay->poller);
+
    if (netplay->listen_fd >= 0)
       socket_close(netplay->listen_fd);
 
@@ -540,6 +562,8 @@ void netplay_free(netplay_t *netplay)
          socket_close(connection->fd);
          netplay_deinit_socket_buffer(&connection->send_packet_buffer);
          netplay_deinit_socket_buffer(&connection->recv_packet_buffer);
+         netplay_savestate_transfer_free(&connection->savestate_out);
+         netplay_savestate_transfer_free(&connection->savestate_in);
       }
    }
 
@@ -557,9 +581,17 @@ void netplay_free(netplay_t *netplay)
       free(netplay->buffer);
    }
 
+   netplay_delta_states_free(netplay);
+
    if (netplay->zbuffer)
       free(netplay->zbuffer);
 
+   if (netplay->savestate_diff)
+      free(netplay->savestate_diff);
+
+   netplay_hash_tree_free(&netplay->hash_tree);
+   netplay_hash_tree_free(&netplay->hash_desync);
+
    if (netplay->compress_nil.compression_stream)
    {
       netplay->compress_nil.compression_backend->stream_free(netplay->compress_nil.compression_stream);
@@ -17,6 +17,7 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <sys/types.h>
 
 #include <boolean.h>
@@ -138,10 +139,14 @@ void netplay_hangup(netplay_t *netplay,
    RARCH_LOG("[netplay] %s\n", dmsg);
    runloop_msg_queue_push(dmsg, 1, 180, false, NULL, MESSAGE_QUEUE_ICON_DEFAULT, MESSAGE_QUEUE_CATEGORY_INFO);
 
+   netplay_poller_remove(&netplay->poller, connection->fd);
    socket_close(connection->fd);
-   connection->active = false;
+   connection->active   = false;
+   connection->readable = false;
    netplay_deinit_socket_buffer(&connection->send_packet_buffer);
    netplay_deinit_socket_buffer(&connection->recv_packet_buffer);
+   netplay_savestate_transfer_free(&connection->savestate_out);
+   netplay_savestate_transfer_free(&connection->savestate_in);
 
    if (!netplay->is_server)
    {
@@ -354,6 +359,10 @@ bool netplay_send_cur_input(netplay_t *netplay,
          return false;
    }
 
+   /* Slip in some of any savestate we're sending */
+   if (!netplay_send_savestate_chunks(netplay, connection))
+      return false;
+
    if (!netplay_send_flush(&connection->send_packet_buffer, connection->fd,
          false))
       return false;
@@ -372,20 +381,8 @@ bool netplay_send_raw_cmd(netplay_t *netplay,
    struct netplay_connection *connection, uint32_t cmd, const void *data,
    size_t size)
 {
-   uint32_t cmdbuf[2];
-
-   cmdbuf[0] = htonl(cmd);
-   cmdbuf[1] = htonl(size);
-
-   if (!netplay_send(&connection->send_packet_buffer, connection->fd, cmdbuf,
-         sizeof(cmdbuf)))
-      return false;
-
-   if (size > 0)
-      if (!netplay_send(&connection->send_packet_buffer, connection->fd, data, size))
-         return false;
-
-   return true;
+   return netplay_send_cmd(&connection->send_packet_buffer, connection->fd,
+         cmd, data, size);
 }
 
 /**
@@ -443,24 +440,59 @@ static bool netplay_cmd_nak(netplay_t *netplay,
 }
 
 /**
- * netplay_cmd_crc
+ * netplay_cmd_frame_hash
  *
- * Send a CRC command to all active clients.
+ * Send the hash of a frame to all active clients: the root of its hash
+ * tree to those new enough to take it, its CRC to the others.
  */
-bool netplay_cmd_crc(netplay_t *netplay, struct delta_frame *delta)
+bool netplay_cmd_frame_hash(netplay_t *netplay, struct delta_frame *delta)
 {
-   uint32_t payload[2];
-   bool success = true;
    size_t i;
-   payload[0] = htonl(delta->frame);
-   payload[1] = htonl(delta->crc);
+   uint32_t crc_payload[2];
+   uint32_t hash_payload[3];
+   bool success = true;
+
    for (i = 0; i < netplay->connections_size; i++)
    {
-      if (netplay->connections[i].active &&
-            netplay->connections[i].mode >= NETPLAY_CONNECTION_CONNECTED)
-         success = netplay_send_raw_cmd(netplay, &netplay->connections[i],
-            NETPLAY_CMD_CRC, payload, sizeof(payload)) && success;
+      struct netplay_connection *connection = &netplay->connections[i];
+
+      if (!connection->active ||
+            connection->mode < NETPLAY_CONNECTION_CONNECTED)
+         continue;
+
+      if (connection->protocol_version >= NETPLAY_PROTOCOL_VERSION_FRAME_HASH)
+      {
+         /* The tree stays in hash_tree for the requests of a client
+          * whose root doesn't match */
+         if (!delta->have_hash)
+         {
+            if (!netplay_delta_frame_hash_tree(netplay, delta,
+                     &netplay->hash_tree))
+               continue;
+            delta->hash      = netplay_hash_tree_root(&netplay->hash_tree);
+            delta->have_hash = true;
+         }
+         hash_payload[0] = htonl(delta->frame);
+         hash_payload[1] = htonl((uint32_t)(delta->hash >> 32));
+         hash_payload[2] = htonl((uint32_t)delta->hash);
+         success = netplay_send_raw_cmd(netplay, connection,
+            NETPLAY_CMD_FRAME_HASH, hash_payload, sizeof(hash_payload))
+            && success;
+      }
+      else
+      {
+         if (!delta->have_crc)
+         {
+            delta->crc      = netplay_delta_frame_crc(netplay, delta);
+            delta->have_crc = true;
+         }
+         crc_payload[0] = htonl(delta->frame);
+         crc_payload[1] = htonl(delta->crc);
+         success = netplay_send_raw_cmd(netplay, connection,
+            NETPLAY_CMD_CRC, crc_payload, sizeof(crc_payload)) && success;
+      }
    }
+
    return success;
 }
 
@@ -482,6 +514,315 @@ bool netplay_cmd_request_savestate(netplay_t *netplay)
       NETPLAY_CMD_REQUEST_SAVESTATE, NULL, 0);
 }
 
+static void netplay_cmd_request_frame_hashes(netplay_t *netplay,
+      unsigned level, size_t index)
+{
+   uint32_t payload[3];
+
+   if (netplay->connections_size == 0 ||
+       !netplay->connections[0].active ||
+       netplay->connections[0].mode < NETPLAY_CONNECTION_CONNECTED)
+      return;
+
+   payload[0] = htonl(netplay->hash_desync.frame);
+   payload[1] = htonl(level);
+   payload[2] = htonl((uint32_t)index);
+
+   if (netplay_send_raw_cmd(netplay, &netplay->connections[0],
+         NETPLAY_CMD_REQUEST_FRAME_HASHES, payload, sizeof(payload)))
+   {
+      netplay->hash_desync_budget--;
+      netplay->hash_desync_pending++;
+   }
+}
+
+/* Logs the leaves [first, last] of hash_desync as differing */
+static void netplay_log_frame_desync(netplay_t *netplay,
+      size_t first, size_t last)
+{
+   size_t start = first * NETPLAY_HASH_BLOCK_SIZE;
+   size_t end   = (last + 1) * NETPLAY_HASH_BLOCK_SIZE;
+
+   if (end > netplay->state_size)
+      end = netplay->state_size;
+
+   RARCH_WARN("[netplay] Frame %u desynced in state bytes 0x%X-0x%X.\n",
+         netplay->hash_desync.frame, (unsigned)start,
+         (unsigned)(end ? end - 1 : 0));
+}
+
+/**
+ * netplay_frame_hash_desync
+ *
+ * After a frame didn't match the server's, ask the server for the hashes
+ * below the root of its hash tree to find and log the blocks which differ.
+ */
+void netplay_frame_hash_desync(netplay_t *netplay, struct delta_frame *delta)
+{
+   struct netplay_hash_tree swap;
+   struct netplay_hash_tree *tree = &netplay->hash_desync;
+
+   /* Until a new state arrives, every check fails the same way; the
+    * first one will do */
+   if (tree->valid)
+      return;
+
+   /* Older servers can't tell us their hashes */
+   if (netplay->connections_size == 0 ||
+       !netplay->connections[0].active ||
+       netplay->connections[0].protocol_version <
+       NETPLAY_PROTOCOL_VERSION_FRAME_HASH)
+      return;
+
+   /* Checking the root left the tree in hash_tree; keep it, and reuse
+    * the old one's memory for the next. After a CRC, build it now. */
+   if (netplay->hash_tree.valid && netplay->hash_tree.frame == delta->frame)
+   {
+      swap                     = *tree;
+      *tree                    = netplay->hash_tree;
+      netplay->hash_tree       = swap;
+      netplay->hash_tree.valid = false;
+   }
+   else if (!netplay_delta_frame_hash_tree(netplay, delta, tree))
+      return;
+
+   RARCH_WARN("[netplay] State of frame %u differs from the server's.\n",
+         tree->frame);
+
+   netplay->hash_desync_budget  = NETPLAY_MAX_FRAME_HASH_REQUESTS;
+   netplay->hash_desync_pending = 0;
+
+   if (tree->levels > 1)
+      netplay_cmd_request_frame_hashes(netplay, tree->levels - 1, 0);
+   else
+      netplay_log_frame_desync(netplay, 0, 0);
+
+   if (!netplay->hash_desync_pending)
+      tree->valid = false;
+}
+
+static struct compression_transcoder *netplay_connection_ctrans(
+      netplay_t *netplay, struct netplay_connection *connection)
+{
+   if (connection->compression_supported == NETPLAY_COMPRESSION_ZLIB)
+      return &netplay->compress_zlib;
+   return &netplay->compress_nil;
+}
+
+/**
+ * netplay_savestate_transfer_init
+ *
+ * Allocate the buffers of a delta savestate transfer, if they aren't already.
+ */
+static bool netplay_savestate_transfer_init(netplay_t *netplay,
+      struct netplay_savestate_transfer *transfer, bool sending)
+{
+   size_t diff_size = netplay_savestate_diff_maxsize(netplay->state_size);
+
+   if (!netplay->savestate_diff)
+   {
+      netplay->savestate_diff = (uint8_t*)malloc(diff_size);
+      if (!netplay->savestate_diff)
+         return false;
+   }
+
+   if (!transfer->base)
+   {
+      transfer->base = (uint8_t*)calloc(1, netplay->state_size);
+      if (!transfer->base)
+         return false;
+   }
+
+   if (sending && !transfer->state)
+   {
+      transfer->state = (uint8_t*)malloc(netplay->state_size);
+      if (!transfer->state)
+         return false;
+   }
+
+   if (!transfer->data)
+   {
+      /* Leave room for zlib making a diff of random data slightly bigger */
+      transfer->capacity = diff_size + diff_size / 8 + 64;
+      transfer->data     = (uint8_t*)malloc(transfer->capacity);
+      if (!transfer->data)
+      {
+         transfer->capacity = 0;
+         return false;
+      }
+   }
+
+   return true;
+}
+
+/**
+ * netplay_savestate_transfer_free
+ *
+ * Free the buffers of a delta savestate transfer.
+ */
+void netplay_savestate_transfer_free(
+   struct netplay_savestate_transfer *transfer)
+{
+   free(transfer->base);
+   free(transfer->state);
+   free(transfer->data);
+   memset(transfer, 0, sizeof(*transfer));
+}
+
+/**
+ * netplay_send_savestate_chunk
+ *
+ * Queue the next chunk of the savestate being sent to a connection.
+ */
+static bool netplay_send_savestate_chunk(netplay_t *netplay,
+   struct netplay_connection *connection)
+{
+   uint32_t header[7];
+   struct netplay_savestate_transfer *transfer = &connection->savestate_out;
+   size_t len = transfer->size - transfer->pos;
+
+   if (len > NETPLAY_SAVESTATE_CHUNK_SIZE)
+      len = NETPLAY_SAVESTATE_CHUNK_SIZE;
+
+   header[0] = htonl(transfer->cmd);
+   header[1] = htonl((uint32_t)(5*sizeof(uint32_t) + len));
+   header[2] = htonl(transfer->frame);
+   header[3] = htonl(transfer->id);
+   header[4] = htonl((uint32_t)netplay->state_size);
+   header[5] = htonl((uint32_t)transfer->size);
+   header[6] = htonl((uint32_t)transfer->pos);
+
+   if (!netplay_send(&connection->send_packet_buffer, connection->fd, header,
+         sizeof(header)))
+      return false;
+   if (len && !netplay_send(&connection->send_packet_buffer, connection->fd,
+         transfer->data + transfer->pos, len))
+      return false;
+
+   transfer->pos += len;
+
+   if (transfer->pos == transfer->size)
+   {
+      /* TCP won't drop or reorder the rest, so as far as the next diff is
+       * concerned the peer has this state now */
+      uint8_t *base      = transfer->base;
+      transfer->base     = transfer->state;
+      transfer->state    = base;
+      transfer->pending  = false;
+   }
+
+   return true;
+}
+
+/**
+ * netplay_send_savestate_delta
+ *
+ * Start sending a savestate for the given frame to a connection which
+ * supports NETPLAY_COMPRESSION_DELTA, replacing any transfer in progress.
+ * cmd is NETPLAY_CMD_LOAD_SAVESTATE_DELTA, or NETPLAY_CMD_KEYFRAME_DELTA for
+ * a relay to keep. Only the first chunk is queued;
+ * netplay_send_savestate_chunks sends the rest.
+ *
+ * Returns true on success, false on failure.
+ */
+bool netplay_send_savestate_delta(netplay_t *netplay,
+   struct netplay_connection *connection, uint32_t cmd, const void *state,
+   size_t size, uint32_t frame)
+{
+   uint32_t rd, wn;
+   size_t diff_size, changed;
+   struct netplay_savestate_transfer *transfer = &connection->savestate_out;
+   struct compression_transcoder *ctrans       =
+      netplay_connection_ctrans(netplay, connection);
+
+   if (size > netplay->state_size ||
+       !netplay_savestate_transfer_init(netplay, transfer, true))
+      return false;
+
+   /* If an older state is still in transit, it's simply abandoned: the peer
+    * drops it when this one begins, and our base hasn't moved */
+   memcpy(transfer->state, state, size);
+   memset(transfer->state + size, 0, netplay->state_size - size);
+
+   diff_size = netplay_savestate_diff(transfer->base, transfer->state,
+         netplay->state_size, netplay->savestate_diff, &changed);
+
+   ctrans->compression_backend->set_in(ctrans->compression_stream,
+      netplay->savestate_diff, (uint32_t)diff_size);
+   ctrans->compression_backend->set_out(ctrans->compression_stream,
+      transfer->data, (uint32_t)transfer->capacity);
+   if (!ctrans->compression_backend->trans(ctrans->compression_stream, true,
+         &rd, &wn, NULL))
+      return false;
+
+   transfer->cmd     = cmd;
+   transfer->size    = wn;
+   transfer->pos     = 0;
+   transfer->frame   = frame;
+   transfer->id++;
+   transfer->pending = true;
+
+   RARCH_LOG("[netplay] Sending %s for frame %u as a %u byte diff "
+         "(%u of %u blocks changed).\n",
+         cmd == NETPLAY_CMD_KEYFRAME_DELTA ? "keyframe" : "savestate",
+         frame, (unsigned)wn,
+         (unsigned)changed,
+         (unsigned)((netplay->state_size + NETPLAY_SAVESTATE_BLOCK_SIZE - 1)
+            / NETPLAY_SAVESTATE_BLOCK_SIZE));
+
+   /* The first chunk goes out now, since where it lands among our input
+    * tells the peer which frame the state belongs to */
+   return netplay_send_savestate_chunk(netplay, connection);
+}
+
+/**
+ * netplay_send_savestate_chunks
+ *
+ * Queue more of the savestate being sent to a connection, if any, as long as
+ * it won't hold up the input behind it.
+ *
+ * Returns true on success, false on failure.
+ */
+bool netplay_send_savestate_chunks(netplay_t *netplay,
+   struct netplay_connection *connection)
+{
+   unsigned i;
+
+   for (i = 0; i < NETPLAY_SAVESTATE_CHUNKS_PER_SEND &&
+         connection->savestate_out.pending; i++)
+   {
+      /* Only queue a chunk once everything before it has left, so input
+       * never waits behind more than a chunk */
+      if (!netplay_send_flush(&connection->send_packet_buffer,
+            connection->fd, false))
+         return false;
+      if (netplay_send_queued(&connection->send_packet_buffer))
+         break;
+      if (!netplay_send_savestate_chunk(netplay, connection))
+         return false;
+   }
+
+   return true;
+}
+
+/**
+ * netplay_savestate_receiving
+ *
+ * Returns true if we're in the middle of receiving a savestate, in which case
+ * our own state is known to be wrong and CRCs shouldn't be checked.
+ */
+bool netplay_savestate_receiving(netplay_t *netplay)
+{
+   size_t i;
+   for (i = 0; i < netplay->connections_size; i++)
+   {
+      struct netplay_connection *connection = &netplay->connections[i];
+      if (connection->active && connection->savestate_in.pending)
+         return true;
+   }
+   return false;
+}
+
 /**
  * netplay_cmd_mode
  *
@@ -909,6 +1250,145 @@ static void handle_play_spectate(netplay_t *netplay, uint32_t client_num,
 }
 
 #undef RECV
+/**
+ * netplay_savestate_load_allowed
+ *
+ * Check whether a connection may make us load a state or reset, making sure
+ * we're initialized enough to do so.
+ */
+static bool netplay_savestate_load_allowed(netplay_t *netplay,
+   struct netplay_connection *connection)
+{
+   /* Make sure we're ready for it */
+   if (netplay->quirks & NETPLAY_QUIRK_INITIALIZATION)
+   {
+      if (!netplay->is_replay)
+      {
+         netplay->is_replay          = true;
+         netplay->replay_ptr         = netplay->run_ptr;
+         netplay->replay_frame_count = netplay->run_frame_count;
+         netplay_wait_and_init_serialization(netplay);
+         netplay->is_replay         = false;
+      }
+      else
+         netplay_wait_and_init_serialization(netplay);
+   }
+
+   /* Only players may load states */
+   if (connection->mode != NETPLAY_CONNECTION_PLAYING &&
+       connection->mode != NETPLAY_CONNECTION_SLAVE)
+   {
+      RARCH_ERR("Netplay state load from a spectator.\n");
+      return false;
+   }
+
+   /* We only allow players to load state if we're in a simple
+    * two-player situation */
+   if (netplay->is_server && netplay->connections_size > 1)
+   {
+      RARCH_ERR("Netplay state load from a client with other clients connected disallowed.\n");
+      return false;
+   }
+
+   return true;
+}
+
+/**
+ * netplay_load_frame
+ *
+ * Get the frame at which a state or reset from the given connection applies.
+ */
+static void netplay_load_frame(netplay_t *netplay,
+   struct netplay_connection *connection, size_t *load_ptr,
+   uint32_t *load_frame_count)
+{
+   if (netplay->is_server)
+   {
+      uint32_t client_num = (uint32_t)(connection - netplay->connections + 1);
+      *load_ptr           = netplay->read_ptr[client_num];
+      *load_frame_count   = netplay->read_frame_count[client_num];
+   }
+   else
+   {
+      *load_ptr           = netplay->server_ptr;
+      *load_frame_count   = netplay->server_frame_count;
+   }
+}
+
+/**
+ * netplay_load_state_at
+ *
+ * Bring our frame pointers in line with a state loaded, or a reset, at the
+ * given frame. The state itself must already be in its delta frame.
+ */
+static void netplay_load_state_at(netplay_t *netplay, size_t load_ptr,
+   uint32_t load_frame_count, bool reset)
+{
+   uint32_t client;
+
+   /* Skip ahead if it's past where we are */
+   if (load_frame_count > netplay->run_frame_count || reset)
+   {
+      /* This is squirrely: We need to assure that when we advance the
+       * frame in post_frame, THEN we're referring to the frame to
+       * load into. If we refer directly to read_ptr, then we'll end
+       * up never reading the input for read_frame_count itself, which
+       * will make the other side unhappy. */
+      netplay->run_ptr           = PREV_PTR(load_ptr);
+      netplay->run_frame_count   = load_frame_count - 1;
+      if (load_frame_count > netplay->self_frame_count)
+      {
+         netplay->self_ptr         = netplay->run_ptr;
+         netplay->self_frame_count = netplay->run_frame_count;
+      }
+   }
+
+   /* Don't expect earlier data from other clients */
+   for (client = 0; client < MAX_CLIENTS; client++)
+   {
+      if (!(netplay->connected_players & (1<<client)))
+         continue;
+
+      if (load_frame_count > netplay->read_frame_count[client])
+      {
+         netplay->read_ptr[client] = load_ptr;
+         netplay->read_frame_count[client] = load_frame_count;
+      }
+   }
+
+   /* Make sure our states are correct */
+   netplay->savestate_request_outstanding = false;
+   netplay->other_ptr                     = load_ptr;
+   netplay->other_frame_count             = load_frame_count;
+
+#ifdef DEBUG_NETPLAY_STEPS
+   RARCH_LOG("[netplay] Loading state at %u\n", load_frame_count);
+   print_state(netplay);
+#endif
+}
+
+/* Finds the delta frame holding the given frame, if we still have it.
+ * This approach could be improved with some quick modular arithmetic. */
+static bool netplay_find_frame(netplay_t *netplay, uint32_t frame,
+   size_t *ptr)
+{
+   size_t tmp_ptr = netplay->run_ptr;
+
+   do
+   {
+      if (     netplay->buffer[tmp_ptr].used
+            && netplay->buffer[tmp_ptr].frame == frame)
+      {
+         *ptr = tmp_ptr;
+         return true;
+      }
+
+      tmp_ptr = PREV_PTR(tmp_ptr);
+   } while (tmp_ptr != netplay->run_ptr);
+
+   return false;
+}
+
 #define RECV(buf, sz) \
 recvd = netplay_recv(&connection->recv_packet_buffer, connection->fd, (buf), \
 (sz), false); \
@@ -1503,8 +1983,7 @@ static bool netplay_get_cmd(netplay_t *netplay,
       case NETPLAY_CMD_CRC:
          {
             uint32_t buffer[2];
-            size_t tmp_ptr = netplay->run_ptr;
-            bool found = false;
+            size_t tmp_ptr;
 
             if (cmd_size != sizeof(buffer))
             {
@@ -1522,22 +2001,12 @@ static bool netplay_get_cmd(netplay_t *netplay,
             buffer[1] = ntohl(buffer[1]);
 
             /* Received a CRC for some frame. If we still have it, check if it
-             * matched. This approach could be improved with some quick modular
-             * arithmetic. */
-            do
-            {
-               if (     netplay->buffer[tmp_ptr].used
-                     && netplay->buffer[tmp_ptr].frame == buffer[0])
-               {
-                  found = true;
-                  break;
-               }
+             * matched. */
+            if (!netplay_find_frame(netplay, buffer[0], &tmp_ptr))
+               break; /* Oh well, we got rid of it! */
 
-               tmp_ptr = PREV_PTR(tmp_ptr);
-            } while (tmp_ptr != netplay->run_ptr);
-
-            /* Oh well, we got rid of it! */
-            if (!found)
+            /* Our state is about to be replaced anyway */
+            if (netplay_savestate_receiving(netplay))
                break;
 
             if (buffer[0] <= netplay->other_frame_count)
@@ -1549,66 +2018,241 @@ static bool netplay_get_cmd(netplay_t *netplay,
 
                /* Problem! */
                if (buffer[1] != local_crc)
+               {
+                  netplay_frame_hash_desync(netplay,
+                        &netplay->buffer[tmp_ptr]);
                   netplay_cmd_request_savestate(netplay);
+               }
             }
             else
             {
                /* We'll have to check it when we catch up */
-               netplay->buffer[tmp_ptr].crc = buffer[1];
+               netplay->buffer[tmp_ptr].crc      = buffer[1];
+               netplay->buffer[tmp_ptr].have_crc = true;
             }
 
             break;
          }
 
+      case NETPLAY_CMD_FRAME_HASH:
+         {
+            uint32_t buffer[3];
+            uint32_t frame;
+            uint64_t hash;
+            size_t tmp_ptr;
+
+            if (cmd_size != sizeof(buffer))
+            {
+               RARCH_ERR("NETPLAY_CMD_FRAME_HASH received unexpected payload size.\n");
+               return netplay_cmd_nak(netplay, connection);
+            }
+
+            RECV(buffer, sizeof(buffer))
+            {
+               RARCH_ERR("NETPLAY_CMD_FRAME_HASH failed to receive payload.\n");
+               return netplay_cmd_nak(netplay, connection);
+            }
+
+            frame = ntohl(buffer[0]);
+            hash  = ((uint64_t)ntohl(buffer[1]) << 32) | ntohl(buffer[2]);
+
+            /* Same as NETPLAY_CMD_CRC, with the root of the hash tree */
+            if (!netplay_find_frame(netplay, frame, &tmp_ptr))
+               break;
+
+            if (netplay_savestate_receiving(netplay))
+               break;
+
+            if (frame <= netplay->other_frame_count)
+            {
+               if (!netplay_delta_frame_check_hash(netplay,
+                        &netplay->buffer[tmp_ptr], hash))
+               {
+                  netplay_frame_hash_desync(netplay,
+                        &netplay->buffer[tmp_ptr]);
+                  netplay_cmd_request_savestate(netplay);
+               }
+            }
+            else
+            {
+               netplay->buffer[tmp_ptr].hash      = hash;
+               netplay->buffer[tmp_ptr].have_hash = true;
+            }
+
+            break;
+         }
+
+      case NETPLAY_CMD_REQUEST_FRAME_HASHES:
+         {
+            uint32_t buffer[3];
+            uint32_t payload[4 + 2 * NETPLAY_HASH_FANOUT];
+            uint32_t frame, level, index;
+            size_t j, tmp_ptr;
+            size_t first                   = 0;
+            size_t count                   = 0;
+            struct netplay_hash_tree *tree = &netplay->hash_tree;
+
+            if (cmd_size != sizeof(buffer))
+            {
+               RARCH_ERR("NETPLAY_CMD_REQUEST_FRAME_HASHES received unexpected payload size.\n");
+               return netplay_cmd_nak(netplay, connection);
+            }
+
+            RECV(buffer, sizeof(buffer))
+            {
+               RARCH_ERR("NETPLAY_CMD_REQUEST_FRAME_HASHES failed to receive payload.\n");
+               return netplay_cmd_nak(netplay, connection);
+            }
+
+            frame = ntohl(buffer[0]);
+            level = ntohl(buffer[1]);
+            index = ntohl(buffer[2]);
+
+            /* The tree of the frame we last sent a hash for is usually still
+             * there, otherwise rebuild it if the frame is final */
+            if (!tree->valid || tree->frame != frame)
+            {
+               if (     frame <= netplay->other_frame_count
+                     && netplay_find_frame(netplay, frame, &tmp_ptr))
+                  netplay_delta_frame_hash_tree(netplay,
+                        &netplay->buffer[tmp_ptr], tree);
+            }
+
+            /* No hashes tells the peer we don't have the frame anymore */
+            if (tree->valid && tree->frame == frame)
+               count = netplay_hash_tree_children(tree, level, index, &first);
+
+            payload[0] = htonl(frame);
+            payload[1] = htonl(level);
+            payload[2] = htonl(index);
+            payload[3] = htonl((uint32_t)count);
+            for (j = 0; j < count; j++)
+            {
+               uint64_t hash      = netplay_hash_tree_node(tree, level - 1,
+                     first + j);
+               payload[4 + 2 * j] = htonl((uint32_t)(hash >> 32));
+               payload[5 + 2 * j] = htonl((uint32_t)hash);
+            }
+
+            netplay_send_raw_cmd(netplay, connection,
+                  NETPLAY_CMD_FRAME_HASHES, payload,
+                  (4 + 2 * count) * sizeof(uint32_t));
+            break;
+         }
+
+      case NETPLAY_CMD_FRAME_HASHES:
+         {
+            uint32_t buffer[4 + 2 * NETPLAY_HASH_FANOUT];
+            uint32_t frame, level, index, count;
+            size_t j;
+            size_t first                   = 0;
+            size_t diff_start              = 0;
+            bool in_diff                   = false;
+            struct netplay_hash_tree *tree = &netplay->hash_desync;
+
+            if (cmd_size < 4 * sizeof(uint32_t) || cmd_size > sizeof(buffer))
+            {
+               RARCH_ERR("NETPLAY_CMD_FRAME_HASHES received unexpected payload size.\n");
+               return netplay_cmd_nak(netplay, connection);
+            }
+
+            RECV(buffer, cmd_size)
+            {
+               RARCH_ERR("NETPLAY_CMD_FRAME_HASHES failed to receive payload.\n");
+               return netplay_cmd_nak(netplay, connection);
+            }
+
+            frame = ntohl(buffer[0]);
+            level = ntohl(buffer[1]);
+            index = ntohl(buffer[2]);
+            count = ntohl(buffer[3]);
+
+            if (cmd_size != (4 + 2 * count) * sizeof(uint32_t))
+            {
+               RARCH_ERR("NETPLAY_CMD_FRAME_HASHES received unexpected payload size.\n");
+               return netplay_cmd_nak(netplay, connection);
+            }
+
+            if (!tree->valid || tree->frame != frame)
+               break;
+
+            if (netplay->hash_desync_pending)
+               netplay->hash_desync_pending--;
+
+            /* The trees must have the same shape, or the server lost the
+             * frame */
+            if (count && count == netplay_hash_tree_children(tree, level,
+                     index, &first))
+            {
+               /* Follow the children which differ down to the leaves,
+                * logging runs of differing leaves */
+               for (j = 0; j <= count; j++)
+               {
+                  bool differs = false;
+
+                  if (j < count)
+                  {
+                     uint64_t hash = ((uint64_t)ntohl(buffer[4 + 2 * j]) << 32)
+                        | ntohl(buffer[5 + 2 * j]);
+                     differs       = hash !=
+                        netplay_hash_tree_node(tree, level - 1, first + j);
+                  }
+
+                  if (level > 1)
+                  {
+                     if (differs && netplay->hash_desync_budget)
+                        netplay_cmd_request_frame_hashes(netplay,
+                              level - 1, first + j);
+                     continue;
+                  }
+
+                  if (differs && !in_diff)
+                     diff_start = first + j;
+                  else if (!differs && in_diff)
+                     netplay_log_frame_desync(netplay,
+                           diff_start, first + j - 1);
+                  in_diff = differs;
+               }
+            }
+
+            if (!netplay->hash_desync_pending)
+               tree->valid = false;
+            break;
+         }
+
       case NETPLAY_CMD_REQUEST_SAVESTATE:
          /* Delay until next frame so we don't send the savestate after the
           * input */
          netplay->force_send_savestate = true;
          break;
 
+      case NETPLAY_CMD_REQUEST_KEYFRAME:
+         /* A relay wants a state to start its own spectators from. Unlike
+          * NETPLAY_CMD_REQUEST_SAVESTATE, nobody else gets it or loads it. */
+         if (!netplay->is_server ||
+             !connection->savestate_delta ||
+             cmd_size != 0)
+         {
+            RARCH_ERR("Unexpected NETPLAY_CMD_REQUEST_KEYFRAME.\n");
+            return netplay_cmd_nak(netplay, connection);
+         }
+
+         /* Sent with our next stored state */
+         connection->keyframe_requested = true;
+         break;
+
       case NETPLAY_CMD_LOAD_SAVESTATE:
       case NETPLAY_CMD_RESET:
          {
             uint32_t frame;
             uint32_t isize;
             uint32_t rd, wn;
-            uint32_t client;
             uint32_t load_frame_count;
             size_t load_ptr;
             struct compression_transcoder *ctrans = NULL;
-            uint32_t                   client_num = (uint32_t)
-             (connection - netplay->connections + 1);
-
-            /* Make sure we're ready for it */
-            if (netplay->quirks & NETPLAY_QUIRK_INITIALIZATION)
-            {
-               if (!netplay->is_replay)
-               {
-                  netplay->is_replay          = true;
-                  netplay->replay_ptr         = netplay->run_ptr;
-                  netplay->replay_frame_count = netplay->run_frame_count;
-                  netplay_wait_and_init_serialization(netplay);
-                  netplay->is_replay         = false;
-               }
-               else
-                  netplay_wait_and_init_serialization(netplay);
-            }
 
-            /* Only players may load states */
-            if (connection->mode != NETPLAY_CONNECTION_PLAYING &&
-                connection->mode != NETPLAY_CONNECTION_SLAVE)
-            {
-               RARCH_ERR("Netplay state load from a spectator.\n");
+            if (!netplay_savestate_load_allowed(netplay, connection))
                return netplay_cmd_nak(netplay, connection);
-            }
-
-            /* We only allow players to load state if we're in a simple
-             * two-player situation */
-            if (netplay->is_server && netplay->connections_size > 1)
-            {
-               RARCH_ERR("Netplay state load from a client with other clients connected disallowed.\n");
-               return netplay_cmd_nak(netplay, connection);
-            }
 
             /* There is a subtlty in whether the load comes before or after the
              * current frame:
@@ -1637,16 +2281,8 @@ static bool netplay_get_cmd(netplay_t *netplay,
             }
             frame = ntohl(frame);
 
-            if (netplay->is_server)
-            {
-               load_ptr = netplay->read_ptr[client_num];
-               load_frame_count = netplay->read_frame_count[client_num];
-            }
-            else
-            {
-               load_ptr = netplay->server_ptr;
-               load_frame_count = netplay->server_frame_count;
-            }
+            netplay_load_frame(netplay, connection, &load_ptr,
+                  &load_frame_count);
 
             if (frame != load_frame_count)
             {
@@ -1683,21 +2319,15 @@ static bool netplay_get_cmd(netplay_t *netplay,
                }
 
                /* And decompress it */
-               switch (connection->compression_supported)
-               {
-                  case NETPLAY_COMPRESSION_ZLIB:
-                     ctrans = &netplay->compress_zlib;
-                     break;
-                  default:
-                     ctrans = &netplay->compress_nil;
-               }
+               ctrans = netplay_connection_ctrans(netplay, connection);
                ctrans->decompression_backend->set_in(ctrans->decompression_stream,
                   netplay->zbuffer, cmd_size - 2*sizeof(uint32_t));
                ctrans->decompression_backend->set_out(ctrans->decompression_stream,
-                  (uint8_t*)netplay->buffer[load_ptr].state,
+                  (uint8_t*)netplay_delta_frame_state_buffer(netplay),
                   (unsigned)netplay->state_size);
                ctrans->decompression_backend->trans(ctrans->decompression_stream,
                   true, &rd, &wn, NULL);
+               netplay_delta_frame_store_state(netplay, load_ptr);
 
                /* Force a rewind to the relevant frame */
                netplay->force_rewind = true;
@@ -1709,46 +2339,168 @@ static bool netplay_get_cmd(netplay_t *netplay,
 
             }
 
-            /* Skip ahead if it's past where we are */
-            if (load_frame_count > netplay->run_frame_count ||
-                cmd == NETPLAY_CMD_RESET)
+            /* Either supersedes any diff still on its way from this peer */
+            connection->savestate_in.pending = false;
+
+            netplay_load_state_at(netplay, load_ptr, load_frame_count,
+                  cmd == NETPLAY_CMD_RESET);
+
+            break;
+         }
+
+      case NETPLAY_CMD_LOAD_SAVESTATE_DELTA:
+         {
+            uint32_t header[5];
+            uint32_t frame, id, isize, total, offset;
+            uint32_t rd, wn;
+            uint32_t load_frame_count = 0;
+            size_t load_ptr           = 0;
+            size_t len;
+            struct netplay_savestate_transfer *transfer =
+               &connection->savestate_in;
+            struct compression_transcoder *ctrans       = NULL;
+
+            if (!connection->savestate_delta ||
+                cmd_size < sizeof(header) ||
+                cmd_size > sizeof(header) + NETPLAY_SAVESTATE_CHUNK_SIZE)
+            {
+               RARCH_ERR("CMD_LOAD_SAVESTATE_DELTA received an unexpected payload size.\n");
+               return netplay_cmd_nak(netplay, connection);
+            }
+
+            RECV(header, sizeof(header))
             {
-               /* This is squirrely: We need to assure that when we advance the
-                * frame in post_frame, THEN we're referring to the frame to
-                * load into. If we refer directly to read_ptr, then we'll end
-                * up never reading the input for read_frame_count itself, which
-                * will make the other side unhappy. */
-               netplay->run_ptr           = PREV_PTR(load_ptr);
-               netplay->run_frame_count   = load_frame_count - 1;
-               if (frame > netplay->self_frame_count)
+               RARCH_ERR("CMD_LOAD_SAVESTATE_DELTA failed to receive header.\n");
+               return netplay_cmd_nak(netplay, connection);
+            }
+
+            frame  = ntohl(header[0]);
+            id     = ntohl(header[1]);
+            isize  = ntohl(header[2]);
+            total  = ntohl(header[3]);
+            offset = ntohl(header[4]);
+            len    = cmd_size - sizeof(header);
+
+            if (!offset)
+            {
+               /* The first chunk is where the state belongs among the input,
+                * just like a whole CMD_LOAD_SAVESTATE */
+               if (!netplay_savestate_load_allowed(netplay, connection))
+                  return netplay_cmd_nak(netplay, connection);
+
+               netplay_load_frame(netplay, connection, &load_ptr,
+                     &load_frame_count);
+
+               if (frame != load_frame_count)
                {
-                  netplay->self_ptr         = netplay->run_ptr;
-                  netplay->self_frame_count = netplay->run_frame_count;
+                  RARCH_ERR("CMD_LOAD_SAVESTATE_DELTA loading a state out of order!\n");
+                  return netplay_cmd_nak(netplay, connection);
+               }
+
+               if (!netplay_delta_frame_ready(netplay,
+                        &netplay->buffer[load_ptr], load_frame_count))
+                  goto shrt;
+
+               if (!netplay_savestate_transfer_init(netplay, transfer, false) ||
+                   total > transfer->capacity)
+               {
+                  RARCH_ERR("CMD_LOAD_SAVESTATE_DELTA received an oversized diff.\n");
+                  return netplay_cmd_nak(netplay, connection);
                }
             }
+            else if (!transfer->pending ||
+                  id     != transfer->id    ||
+                  frame  != transfer->frame ||
+                  total  != transfer->size  ||
+                  offset != transfer->pos)
+            {
+               RARCH_ERR("CMD_LOAD_SAVESTATE_DELTA received a chunk out of order.\n");
+               return netplay_cmd_nak(netplay, connection);
+            }
 
-            /* Don't expect earlier data from other clients */
-            for (client = 0; client < MAX_CLIENTS; client++)
+            if (isize != netplay->state_size)
             {
-               if (!(netplay->connected_players & (1<<client)))
-                  continue;
+               RARCH_ERR("CMD_LOAD_SAVESTATE_DELTA received an unexpected save state size.\n");
+               return netplay_cmd_nak(netplay, connection);
+            }
 
-               if (frame > netplay->read_frame_count[client])
+            if (len > total - offset)
+            {
+               RARCH_ERR("CMD_LOAD_SAVESTATE_DELTA received an oversized chunk.\n");
+               return netplay_cmd_nak(netplay, connection);
+            }
+
+            RECV(transfer->data + offset, len)
+            {
+               RARCH_ERR("CMD_LOAD_SAVESTATE_DELTA failed to receive savestate.\n");
+               return netplay_cmd_nak(netplay, connection);
+            }
+
+            if (!offset)
+            {
+               /* Anything else still on its way is dropped */
+               transfer->pending = true;
+               transfer->id      = id;
+               transfer->frame   = frame;
+               transfer->ptr     = load_ptr;
+               transfer->size    = total;
+               transfer->pos     = 0;
+            }
+            transfer->pos += len;
+
+            if (transfer->pos < transfer->size)
+               break;
+
+            /* That was the last chunk. Whether or not we can still use the
+             * state, the sender now diffs against it. */
+            transfer->pending = false;
+
+            ctrans = netplay_connection_ctrans(netplay, connection);
+            ctrans->decompression_backend->set_in(ctrans->decompression_stream,
+               transfer->data, (uint32_t)transfer->size);
+            ctrans->decompression_backend->set_out(ctrans->decompression_stream,
+               netplay->savestate_diff,
+               (uint32_t)netplay_savestate_diff_maxsize(netplay->state_size));
+            if (!ctrans->decompression_backend->trans(
+                     ctrans->decompression_stream, true, &rd, &wn, NULL) ||
+                !netplay_savestate_patch(transfer->base, netplay->state_size,
+                     netplay->savestate_diff, wn))
+            {
+               RARCH_ERR("CMD_LOAD_SAVESTATE_DELTA received a corrupt diff.\n");
+               return netplay_cmd_nak(netplay, connection);
+            }
+
+            /* We kept running while the state was in transit. If its frame
+             * has left our buffer since, we can't load it where it belongs,
+             * so get both sides onto one state again: a client asks the
+             * server for a fresh one, a server sends its own. */
+            if (!netplay->buffer[transfer->ptr].used ||
+                netplay->buffer[transfer->ptr].frame != transfer->frame)
+            {
+               RARCH_WARN("[netplay] Savestate for frame %u arrived too late.\n",
+                     transfer->frame);
+               if (netplay->is_server)
+                  netplay->force_send_savestate = true;
+               else
                {
-                  netplay->read_ptr[client] = load_ptr;
-                  netplay->read_frame_count[client] = load_frame_count;
+                  netplay->savestate_request_outstanding = false;
+                  netplay_cmd_request_savestate(netplay);
                }
+               break;
             }
 
-            /* Make sure our states are correct */
-            netplay->savestate_request_outstanding = false;
-            netplay->other_ptr                     = load_ptr;
-            netplay->other_frame_count             = load_frame_count;
+            memcpy(netplay_delta_frame_state_buffer(netplay), transfer->base,
+                  netplay->state_size);
+            netplay_delta_frame_store_state(netplay, transfer->ptr);
 
-#ifdef DEBUG_NETPLAY_STEPS
-            RARCH_LOG("[netplay] Loading state at %u\n", load_frame_count);
-            print_state(netplay);
-#endif
+            RARCH_LOG("[netplay] Loading savestate for frame %u from a %u byte diff.\n",
+                  transfer->frame, (unsigned)transfer->size);
+
+            /* Force a rewind to the relevant frame */
+            netplay->force_rewind = true;
+
+            netplay_load_state_at(netplay, transfer->ptr, transfer->frame,
+                  false);
 
             break;
          }
@@ -1856,6 +2608,38 @@ shrt:
 #undef RECV
 }
 
+static void netplay_poll_event(void *data, size_t tag)
+{
+   netplay_t *netplay = (netplay_t*)data;
+
+   if (tag == NETPLAY_POLL_TAG_LISTEN)
+      netplay->listen_readable = true;
+   else if (tag - 1 < netplay->connections_size)
+      netplay->connections[tag - 1].readable = true;
+}
+
+/**
+ * netplay_poll_events
+ *
+ * Wait up to timeout_ms milliseconds for any of our sockets to become
+ * readable, and mark those which have.
+ *
+ * Returns the number of sockets which became readable, or -1 on error.
+ */
+int netplay_poll_events(netplay_t *netplay, int timeout_ms)
+{
+   bool listen_readable = netplay->listen_readable;
+   int ret              = netplay_poller_wait(&netplay->poller, timeout_ms,
+         netplay_poll_event, netplay);
+
+   /* Until accept() runs dry we know there's a connection waiting, so don't
+    * let poll() and select() keep telling us */
+   if (!listen_readable && netplay->listen_readable)
+      netplay_poller_remove(&netplay->poller, netplay->listen_fd);
+
+   return ret;
+}
+
 /**
  * netplay_poll_net_input
  *
@@ -1864,33 +2648,49 @@ shrt:
 int netplay_poll_net_input(netplay_t *netplay, bool block)
 {
    bool had_input = false;
-   int max_fd = 0;
+   bool connected = false;
    size_t i;
 
    for (i = 0; i < netplay->connections_size; i++)
    {
-      struct netplay_connection *connection = &netplay->connections[i];
-      if (connection->active && connection->fd >= max_fd)
-         max_fd = connection->fd + 1;
+      if (netplay->connections[i].active)
+      {
+         connected = true;
+         break;
+      }
    }
 
-   if (max_fd == 0)
+   if (!connected)
       return 0;
 
    netplay->timeout_cnt = 0;
 
+   if (netplay_poll_events(netplay, 0) < 0)
+      return -1;
+
    do
    {
       had_input = false;
 
       netplay->timeout_cnt++;
 
-      /* Read input from each connection */
+      /* Read input from each connection with something to read */
       for (i = 0; i < netplay->connections_size; i++)
       {
+         bool connection_input                 = false;
          struct netplay_connection *connection = &netplay->connections[i];
-         if (connection->active && !netplay_get_cmd(netplay, connection, &had_input))
+
+         if (!connection->active || !connection->readable)
+            continue;
+
+         if (!netplay_get_cmd(netplay, connection, &connection_input))
             netplay_hangup(netplay, connection);
+         else if (connection_input)
+            had_input = true;
+         else
+            /* Came up short. If the socket still has data, the poller
+             * reports it again. */
+            connection->readable = false;
       }
 
       if (block)
@@ -1904,21 +2704,18 @@ int netplay_poll_net_input(netplay_t *netplay, bool block)
          /* If we're supposed to block but we didn't have enough input, wait for it */
          if (!had_input)
          {
-            fd_set fds;
-            struct timeval tv = {0};
-            tv.tv_usec = RETRY_MS * 1000;
-
-            FD_ZERO(&fds);
-            for (i = 0; i < netplay->connections_size; i++)
-            {
-               struct netplay_connection *connection = &netplay->connections[i];
-               if (connection->active)
-                  FD_SET(connection->fd, &fds);
-            }
+            int ready = netplay_poll_events(netplay, RETRY_MS);
 
-            if (socket_select(max_fd, &fds, NULL, NULL, &tv) < 0)
+            if (ready < 0)
                return -1;
 
+            /* Nothing came, so try everyone again as we would without a
+             * poller, in case a command sits in a receive buffer */
+            if (ready == 0)
+               for (i = 0; i < netplay->connections_size; i++)
+                  if (netplay->connections[i].active)
+                     netplay->connections[i].readable = true;
+
             RARCH_LOG("[netplay] Network is stalling at frame %u, count %u of %d ...\n",
                   netplay->run_frame_count, netplay->timeout_cnt, MAX_RETRIES);
 
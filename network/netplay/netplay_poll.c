@@ -0,0 +1,399 @@
+/*  RetroArch - A frontend for libretro.
+ *  Copyright (C) 2016-2017 - Gregor Richards
+ *
+ *  RetroArch is free software: you can redistribute it and/or modify it under the terms
+ *  of the GNU General Public License as published by the Free Software Found-
+ *  ation, either version 3 of the License, or (at your option) any later version.
+ *
+ *  RetroArch is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ *  PURPOSE.  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with RetroArch.
+ *  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <errno.h>
+
+#include <net/net_compat.h>
+#include <net/net_socket.h>
+#include <string/stdstring.h>
+
+#include "netplay_poll.h"
+
+#ifdef HAVE_NETPLAY_EPOLL
+#include <unistd.h>
+#include <sys/epoll.h>
+#endif
+
+#ifdef HAVE_NETPLAY_POLL
+#include <poll.h>
+#endif
+
+#ifdef HAVE_NETPLAY_EPOLL
+/* epoll: the kernel keeps the list, so the sockets we don't hear from
+ * cost nothing. Level triggered like the others, so a socket read short of
+ * what it holds is simply reported again. */
+
+#ifndef EPOLLRDHUP
+#define EPOLLRDHUP 0
+#endif
+
+struct netplay_poller_epoll
+{
+   int epfd;
+   /* Room for an event from every socket, so one wait hears them all */
+   struct epoll_event *evs;
+   size_t size;
+   size_t capacity;
+};
+
+static void *netplay_poller_epoll_init(void)
+{
+   struct netplay_poller_epoll *ep = (struct netplay_poller_epoll*)
+      calloc(1, sizeof(*ep));
+
+   if (!ep)
+      return NULL;
+
+#ifdef EPOLL_CLOEXEC
+   ep->epfd = epoll_create1(EPOLL_CLOEXEC);
+#else
+   ep->epfd = epoll_create(16);
+#endif
+
+   if (ep->epfd < 0)
+   {
+      free(ep);
+      return NULL;
+   }
+
+   return ep;
+}
+
+static void netplay_poller_epoll_free(void *data)
+{
+   struct netplay_poller_epoll *ep = (struct netplay_poller_epoll*)data;
+   close(ep->epfd);
+   free(ep->evs);
+   free(ep);
+}
+
+static bool netplay_poller_epoll_add(void *data, int fd, size_t tag)
+{
+   struct epoll_event ev;
+   struct netplay_poller_epoll *ep = (struct netplay_poller_epoll*)data;
+
+   if (ep->size == ep->capacity)
+   {
+      size_t capacity         = ep->capacity ? ep->capacity * 2 : 8;
+      struct epoll_event *evs = (struct epoll_event*)realloc(ep->evs,
+            capacity * sizeof(*evs));
+
+      if (!evs)
+         return false;
+      ep->evs      = evs;
+      ep->capacity = capacity;
+   }
+
+   ev.events    = EPOLLIN | EPOLLRDHUP;
+   ev.data.u64  = tag;
+
+   if (epoll_ctl(ep->epfd, EPOLL_CTL_ADD, fd, &ev) != 0)
+      return false;
+
+   ep->size++;
+   return true;
+}
+
+static void netplay_poller_epoll_remove(void *data, int fd)
+{
+   /* Pre-2.6.9 kernels want an event even though it is ignored */
+   struct epoll_event ev           = {0};
+   struct netplay_poller_epoll *ep = (struct netplay_poller_epoll*)data;
+
+   if (epoll_ctl(ep->epfd, EPOLL_CTL_DEL, fd, &ev) == 0)
+      ep->size--;
+}
+
+static int netplay_poller_epoll_wait(void *data, int timeout_ms,
+      netplay_poller_cb_t cb, void *userdata)
+{
+   int i, ret;
+   struct netplay_poller_epoll *ep = (struct netplay_poller_epoll*)data;
+   struct epoll_event ev;
+
+   /* With nothing to watch, still wait as long as asked */
+   if (ep->size)
+      ret = epoll_wait(ep->epfd, ep->evs, (int)ep->size, timeout_ms);
+   else
+      ret = epoll_wait(ep->epfd, &ev, 1, timeout_ms);
+
+   if (ret < 0)
+      return (errno == EINTR) ? 0 : -1;
+
+   for (i = 0; i < ret; i++)
+      cb(userdata, (size_t)ep->evs[i].data.u64);
+
+   return ret;
+}
+
+static const netplay_poller_backend_t netplay_poller_epoll = {
+   netplay_poller_epoll_init,
+   netplay_poller_epoll_free,
+   netplay_poller_epoll_add,
+   netplay_poller_epoll_remove,
+   netplay_poller_epoll_wait,
+   "epoll"
+};
+#endif
+
+/* poll() and select() keep their own list of sockets */
+struct netplay_poller_list
+{
+   int *fds;
+   size_t *tags;
+#ifdef HAVE_NETPLAY_POLL
+   struct pollfd *pfds;
+#endif
+   size_t size;
+   size_t capacity;
+};
+
+static void *netplay_poller_list_init(void)
+{
+   return calloc(1, sizeof(struct netplay_poller_list));
+}
+
+static void netplay_poller_list_free(void *data)
+{
+   struct netplay_poller_list *list = (struct netplay_poller_list*)data;
+
+   free(list->fds);
+   free(list->tags);
+#ifdef HAVE_NETPLAY_POLL
+   free(list->pfds);
+#endif
+   free(list);
+}
+
+static bool netplay_poller_list_add(void *data, int fd, size_t tag)
+{
+   struct netplay_poller_list *list = (struct netplay_poller_list*)data;
+
+   if (list->size == list->capacity)
+   {
+      size_t capacity = list->capacity ? list->capacity * 2 : 8;
+      int *fds        = (int*)realloc(list->fds, capacity * sizeof(*fds));
+      size_t *tags;
+#ifdef HAVE_NETPLAY_POLL
+      struct pollfd *pfds;
+#endif
+
+      if (!fds)
+         return false;
+      list->fds = fds;
+
+      if (!(tags = (size_t*)realloc(list->tags, capacity * sizeof(*tags))))
+         return false;
+      list->tags = tags;
+
+#ifdef HAVE_NETPLAY_POLL
+      if (!(pfds = (struct pollfd*)realloc(list->pfds,
+                  capacity * sizeof(*pfds))))
+         return false;
+      list->pfds = pfds;
+#endif
+
+      list->capacity = capacity;
+   }
+
+   list->fds[list->size]  = fd;
+   list->tags[list->size] = tag;
+#ifdef HAVE_NETPLAY_POLL
+   list->pfds[list->size].fd      = fd;
+   list->pfds[list->size].events  = POLLIN;
+   list->pfds[list->size].revents = 0;
+#endif
+   list->size++;
+
+   return true;
+}
+
+static void netplay_poller_list_remove(void *data, int fd)
+{
+   size_t i;
+   struct netplay_poller_list *list = (struct netplay_poller_list*)data;
+
+   for (i = 0; i < list->size; i++)
+   {
+      if (list->fds[i] != fd)
+         continue;
+
+      /* Order doesn't matter, move the last one in */
+      list->size--;
+      list->fds[i]  = list->fds[list->size];
+      list->tags[i] = list->tags[list->size];
+#ifdef HAVE_NETPLAY_POLL
+      list->pfds[i] = list->pfds[list->size];
+#endif
+      return;
+   }
+}
+
+#ifdef HAVE_NETPLAY_POLL
+static int netplay_poller_poll_wait(void *data, int timeout_ms,
+      netplay_poller_cb_t cb, void *userdata)
+{
+   size_t i;
+   int num_events                   = 0;
+   struct netplay_poller_list *list = (struct netplay_poller_list*)data;
+   int ret                          = poll(list->pfds, list->size,
+         timeout_ms);
+
+   if (ret < 0)
+      return (errno == EINTR) ? 0 : -1;
+
+   for (i = 0; i < list->size && num_events < ret; i++)
+   {
+      if (list->pfds[i].revents)
+      {
+         cb(userdata, list->tags[i]);
+         num_events++;
+      }
+   }
+
+   return num_events;
+}
+
+static const netplay_poller_backend_t netplay_poller_poll = {
+   netplay_poller_list_init,
+   netplay_poller_list_free,
+   netplay_poller_list_add,
+   netplay_poller_list_remove,
+   netplay_poller_poll_wait,
+   "poll"
+};
+#endif
+
+static int netplay_poller_select_wait(void *data, int timeout_ms,
+      netplay_poller_cb_t cb, void *userdata)
+{
+   size_t i;
+   fd_set fds;
+   struct timeval tv;
+   int max_fd                       = 0;
+   int num_events                   = 0;
+   struct netplay_poller_list *list = (struct netplay_poller_list*)data;
+
+   tv.tv_sec  = timeout_ms / 1000;
+   tv.tv_usec = (timeout_ms % 1000) * 1000;
+
+   FD_ZERO(&fds);
+   for (i = 0; i < list->size; i++)
+   {
+#ifndef _WIN32
+      /* Can't be selected on; always call it readable, as we did before
+       * we had pollers */
+      if (list->fds[i] >= FD_SETSIZE)
+      {
+         cb(userdata, list->tags[i]);
+         num_events++;
+         tv.tv_sec = tv.tv_usec = 0;
+         continue;
+      }
+#endif
+      FD_SET(list->fds[i], &fds);
+      if (list->fds[i] >= max_fd)
+         max_fd = list->fds[i] + 1;
+   }
+
+   if (socket_select(max_fd, &fds, NULL, NULL, &tv) < 0)
+      return -1;
+
+   for (i = 0; i < list->size; i++)
+   {
+#ifndef _WIN32
+      if (list->fds[i] >= FD_SETSIZE)
+         continue;
+#endif
+      if (FD_ISSET(list->fds[i], &fds))
+      {
+         cb(userdata, list->tags[i]);
+         num_events++;
+      }
+   }
+
+   return num_events;
+}
+
+static const netplay_poller_backend_t netplay_poller_select = {
+   netplay_poller_list_init,
+   netplay_poller_list_free,
+   netplay_poller_list_add,
+   netplay_poller_list_remove,
+   netplay_poller_select_wait,
+   "select"
+};
+
+/* In order of preference. epoll keeps the socket set in the kernel, so a
+ * wait does not copy and rescan every socket the way poll() and select()
+ * do; it stays level triggered like the others. */
+static const netplay_poller_backend_t *netplay_poller_backends[] = {
+#ifdef HAVE_NETPLAY_EPOLL
+   &netplay_poller_epoll,
+#endif
+#ifdef HAVE_NETPLAY_POLL
+   &netplay_poller_poll,
+#endif
+   &netplay_poller_select,
+   NULL
+};
+
+bool netplay_poller_init(netplay_poller_t *poller, const char *ident)
+{
+   size_t i;
+
+   for (i = 0; netplay_poller_backends[i]; i++)
+   {
+      const netplay_poller_backend_t *backend = netplay_poller_backends[i];
+
+      if (ident && !string_is_equal(ident, backend->ident))
+         continue;
+
+      if ((poller->data = backend->init()))
+      {
+         poller->backend = backend;
+         return true;
+      }
+   }
+
+   poller->backend = NULL;
+   return false;
+}
+
+void netplay_poller_deinit(netplay_poller_t *poller)
+{
+   if (poller->backend)
+      poller->backend->free(poller->data);
+   poller->backend = NULL;
+   poller->data    = NULL;
+}
+
+bool netplay_poller_add(netplay_poller_t *poller, int fd, size_t tag)
+{
+   return poller->backend->add(poller->data, fd, tag);
+}
+
+void netplay_poller_remove(netplay_poller_t *poller, int fd)
+{
+   if (poller->backend)
+      poller->backend->remove(poller->data, fd);
+}
+
+int netplay_poller_wait(netplay_poller_t *poller, int timeout_ms,
+      netplay_poller_cb_t cb, void *userdata)
+{
+   return poller->backend->wait(poller->data, timeout_ms, cb, userdata);
+}
@@ -0,0 +1,107 @@
+/*  RetroArch - A frontend for libretro.
+ *  Copyright (C) 2016-2017 - Gregor Richards
+ *
+ *  RetroArch is free software: you can redistribute it and/or modify it under the terms
+ *  of the GNU General Public License as published by the Free Software Found-
+ *  ation, either version 3 of the License, or (at your option) any later version.
+ *
+ *  RetroArch is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ *  PURPOSE.  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with RetroArch.
+ *  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __RARCH_NETPLAY_POLL_H
+#define __RARCH_NETPLAY_POLL_H
+
+#include <stddef.h>
+
+#include <boolean.h>
+#include <retro_common_api.h>
+
+#if defined(__linux__)
+#define HAVE_NETPLAY_EPOLL
+#endif
+
+/* Also where sendmsg()/recvmsg() take an iovec, for netplay_buf */
+#if (defined(__unix__) || defined(__APPLE__) || defined(__HAIKU__)) \
+   && !defined(GEKKO) && !defined(__PSL1GHT__) && !defined(__CELLOS_LV2__) \
+   && !defined(VITA) && !defined(WIIU) && !defined(_3DS) && !defined(SWITCH)
+#define HAVE_NETPLAY_POLL
+#endif
+
+RETRO_BEGIN_DECLS
+
+/* Tells the caller which socket became readable */
+typedef void (*netplay_poller_cb_t)(void *userdata, size_t tag);
+
+typedef struct netplay_poller_backend
+{
+   void *(*init)(void);
+   void  (*free)(void *data);
+   bool  (*add)(void *data, int fd, size_t tag);
+   void  (*remove)(void *data, int fd);
+   int   (*wait)(void *data, int timeout_ms, netplay_poller_cb_t cb,
+         void *userdata);
+   const char *ident;
+} netplay_poller_backend_t;
+
+/* Waits on the netplay sockets with epoll on Linux, else poll() where
+ * available, else select(). All are level triggered: a socket is reported
+ * for as long as it has data. */
+typedef struct netplay_poller
+{
+   const netplay_poller_backend_t *backend;
+   void *data;
+} netplay_poller_t;
+
+/**
+ * netplay_poller_init:
+ * @poller               : poller to initialize.
+ * @ident                : backend to use, or NULL for the best one
+ *                         available.
+ *
+ * Returns: true on success.
+ **/
+bool netplay_poller_init(netplay_poller_t *poller, const char *ident);
+
+/**
+ * netplay_poller_deinit:
+ * @poller               : poller to free. The sockets in it are left open.
+ **/
+void netplay_poller_deinit(netplay_poller_t *poller);
+
+/**
+ * netplay_poller_add:
+ * @poller               : an initialized poller.
+ * @fd                   : socket to watch for incoming data.
+ * @tag                  : passed to the callback when @fd is readable.
+ *
+ * Returns: true on success.
+ **/
+bool netplay_poller_add(netplay_poller_t *poller, int fd, size_t tag);
+
+/**
+ * netplay_poller_remove:
+ * @poller               : an initialized poller.
+ * @fd                   : socket to stop watching, before it is closed.
+ **/
+void netplay_poller_remove(netplay_poller_t *poller, int fd);
+
+/**
+ * netplay_poller_wait:
+ * @poller               : an initialized poller.
+ * @timeout_ms           : how long to wait, 0 to just check.
+ * @cb                   : called with the tag of each readable socket.
+ * @userdata             : passed to @cb.
+ *
+ * Returns: the number of sockets reported, or -1 on error.
+ **/
+int netplay_poller_wait(netplay_poller_t *poller, int timeout_ms,
+      netplay_poller_cb_t cb, void *userdata);
+
+RETRO_END_DECLS
+
+#endif
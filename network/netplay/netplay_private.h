@@ -27,8 +27,26 @@
 
 #include "../../msg_hash.h"
 #include "../../verbosity.h"
+#include "../../managers/savestate_pool.h"
+#include "../../managers/state_manager_diff.h"
 
-#define NETPLAY_PROTOCOL_VERSION 5
+#include "netplay_hash.h"
+#include "netplay_poll.h"
+#include "netplay_savestate.h"
+
+#define NETPLAY_PROTOCOL_VERSION 7
+
+/* Oldest protocol version we still talk to */
+#define NETPLAY_PROTOCOL_VERSION_MIN 5
+
+/* First protocol version checking frames with NETPLAY_CMD_FRAME_HASH
+ * rather than NETPLAY_CMD_CRC */
+#define NETPLAY_PROTOCOL_VERSION_FRAME_HASH 6
+
+/* First protocol version answering NETPLAY_CMD_REQUEST_KEYFRAME */
+#define NETPLAY_PROTOCOL_VERSION_KEYFRAME 7
+
+#define NETPLAY_MAGIC 0x52414E50 /* RANP */
 
 #define RARCH_DEFAULT_PORT 55435
 #define RARCH_DEFAULT_NICK "Anonymous"
@@ -57,6 +75,12 @@ typedef uint32_t client_bitmap_t;
 #define NETPLAY_MAX_REQ_STALL_TIME     60
 #define NETPLAY_MAX_REQ_STALL_FREQUENCY 120
 
+/* Most NETPLAY_CMD_REQUEST_FRAME_HASHES sent looking for one desync */
+#define NETPLAY_MAX_FRAME_HASH_REQUESTS 32
+
+/* Poller tag of the listen socket; connections use their index + 1 */
+#define NETPLAY_POLL_TAG_LISTEN 0
+
 #define PREV_PTR(x) ((x) == 0 ? netplay->buffer_size - 1 : (x) - 1)
 #define NEXT_PTR(x) ((x + 1) % netplay->buffer_size)
 
@@ -89,10 +113,14 @@ typedef uint32_t client_bitmap_t;
 
 /* Compression protocols supported */
 #define NETPLAY_COMPRESSION_ZLIB (1<<0)
+/* Not a compression protocol as such: savestates are sent as chunked
+ * diffs against the last state the peer received. Older peers mask it
+ * out of the header, so it needs no protocol version bump. */
+#define NETPLAY_COMPRESSION_DELTA (1<<1)
 #if HAVE_ZLIB
-#define NETPLAY_COMPRESSION_SUPPORTED NETPLAY_COMPRESSION_ZLIB
+#define NETPLAY_COMPRESSION_SUPPORTED (NETPLAY_COMPRESSION_ZLIB | NETPLAY_COMPRESSION_DELTA)
 #else
-#define NETPLAY_COMPRESSION_SUPPORTED 0
+#define NETPLAY_COMPRESSION_SUPPORTED NETPLAY_COMPRESSION_DELTA
 #endif
 
 enum netplay_cmd
@@ -166,6 +194,28 @@ enum netplay_cmd
    /* Sends over cheats enabled on client (unsupported) */
    NETPLAY_CMD_CHEATS         = 0x0047,
 
+   /* Send a chunk of a savestate diff for the client to load
+    * (NETPLAY_COMPRESSION_DELTA only) */
+   NETPLAY_CMD_LOAD_SAVESTATE_DELTA = 0x0048,
+
+   /* Send the root of a frame's hash tree, replaces NETPLAY_CMD_CRC
+    * (NETPLAY_PROTOCOL_VERSION_FRAME_HASH) */
+   NETPLAY_CMD_FRAME_HASH     = 0x0049,
+
+   /* Request the hashes below a node of a frame's hash tree */
+   NETPLAY_CMD_REQUEST_FRAME_HASHES = 0x004A,
+
+   /* Send the hashes below a node of a frame's hash tree */
+   NETPLAY_CMD_FRAME_HASHES   = 0x004B,
+
+   /* Request a savestate to keep rather than load (relays only,
+    * NETPLAY_PROTOCOL_VERSION_KEYFRAME) */
+   NETPLAY_CMD_REQUEST_KEYFRAME = 0x004C,
+
+   /* Send a chunk of a savestate diff, like NETPLAY_CMD_LOAD_SAVESTATE_DELTA,
+    * for the receiver to keep rather than load */
+   NETPLAY_CMD_KEYFRAME_DELTA = 0x004D,
+
    /* Misc. commands */
 
    /* Sends multiple config requests over,
@@ -179,6 +229,12 @@ enum netplay_cmd
 };
 
 #define NETPLAY_CMD_SYNC_BIT_PAUSED    (1U<<31)
+
+/* Payload of a SYNC command without the SRAM: frame, client number,
+ * devices, share modes, device-client mapping and nick */
+#define NETPLAY_CMD_SYNC_MIN_SIZE \
+   ((2+2*MAX_INPUT_DEVICES)*sizeof(uint32_t) + \
+    MAX_INPUT_DEVICES*sizeof(uint8_t) + NETPLAY_NICK_LEN)
 #define NETPLAY_CMD_PLAY_BIT_SLAVE     (1U<<31)
 #define NETPLAY_CMD_MODE_BIT_YOU       (1U<<31)
 #define NETPLAY_CMD_MODE_BIT_PLAYING   (1U<<30)
@@ -292,11 +348,20 @@ struct delta_frame
    bool used; /* a bit derpy, but this is how we know if the delta's been used at all */
    uint32_t frame;
 
-   /* The serialized state of the core at this frame, before input */
-   void *state;
+   /* Patch turning the serialized state of the next frame into the
+    * state of this frame, before input. The newest frame has its state
+    * stored in full instead, see netplay->state_head. */
+   uint8_t *patch;
+   size_t patch_size;
+   size_t patch_capacity;
 
-   /* The CRC-32 of the serialized state if we've calculated it, else 0 */
+   /* The CRC-32 of the serialized state, if have_crc */
    uint32_t crc;
+   bool have_crc;
+
+   /* The root of the state's hash tree, if have_hash */
+   uint64_t hash;
+   bool have_hash;
 
    /* The resolved input, i.e., what's actually going to the core. One input
     * per device. */
@@ -316,6 +381,27 @@ struct delta_frame
    bool have_real[MAX_CLIENTS];
 };
 
+/* Handshake commands of fixed size */
+struct nick_buf_s
+{
+   uint32_t cmd[2];
+   char nick[NETPLAY_NICK_LEN];
+};
+
+struct password_buf_s
+{
+   uint32_t cmd[2];
+   char password[NETPLAY_PASS_HASH_LEN];
+};
+
+struct info_buf_s
+{
+   uint32_t cmd[2];
+   char core_name[NETPLAY_NICK_LEN];
+   char core_version[NETPLAY_NICK_LEN];
+   uint32_t content_crc;
+};
+
 struct socket_buffer
 {
    unsigned char *data;
@@ -325,6 +411,38 @@ struct socket_buffer
 };
 
 /* Each connection gets a connection struct */
+/* A savestate sent as a diff, see NETPLAY_CMD_LOAD_SAVESTATE_DELTA */
+struct netplay_savestate_transfer
+{
+   /* The last state transferred in full, which diffs are made against.
+    * Both peers start from a zeroed state. */
+   uint8_t *base;
+
+   /* Sending only: the state being sent, which becomes the base once its
+    * last chunk is queued */
+   uint8_t *state;
+
+   /* The compressed diff */
+   uint8_t *data;
+   size_t size;
+   size_t capacity;
+
+   /* How much of it has been sent or received so far */
+   size_t pos;
+
+   /* Sending only: NETPLAY_CMD_LOAD_SAVESTATE_DELTA or
+    * NETPLAY_CMD_KEYFRAME_DELTA */
+   uint32_t cmd;
+
+   /* Frame the state belongs to, its delta frame when receiving, and an id
+    * telling transfers apart */
+   uint32_t frame;
+   size_t ptr;
+   uint32_t id;
+
+   bool pending;
+};
+
 struct netplay_connection
 {
    /* Is this connection buffer in use? */
@@ -333,6 +451,10 @@ struct netplay_connection
    /* fd associated with this connection */
    int fd;
 
+   /* Might the socket have data we haven't read? Set by the poller,
+    * cleared once a read comes up short. */
+   bool readable;
+
    /* Address of peer */
    struct sockaddr_storage addr;
 
@@ -356,9 +478,21 @@ struct netplay_connection
     * to wait for, or 0 if no delay is active. */
    uint32_t delay_frame;
 
+   /* Protocol version of the peer */
+   uint32_t protocol_version;
+
    /* What compression does this peer support? */
    uint32_t compression_supported;
 
+   /* Does this peer take savestates as diffs (NETPLAY_COMPRESSION_DELTA)? */
+   bool savestate_delta;
+
+   /* Delta savestates being sent to and received from this peer */
+   struct netplay_savestate_transfer savestate_out, savestate_in;
+
+   /* Server only: has this peer (a relay) asked for a keyframe? */
+   bool keyframe_requested;
+
    /* Is this player paused? */
    bool paused;
 
@@ -394,6 +528,13 @@ struct netplay
    /* TCP connection for listening (server only) */
    int listen_fd;
 
+   /* Might a connection be waiting on listen_fd? */
+   bool listen_readable;
+
+   /* Watches listen_fd and our connections. Each connection is tagged with
+    * its index + 1, listen_fd with NETPLAY_POLL_TAG_LISTEN. */
+   netplay_poller_t poller;
+
    /* Our client number */
    uint32_t self_client_num;
 
@@ -459,6 +600,9 @@ struct netplay
    uint8_t *zbuffer;
    size_t zbuffer_size;
 
+   /* Uncompressed savestate diffs, netplay_savestate_diff_maxsize() bytes */
+   uint8_t *savestate_diff;
+
    /* The size of our packet buffers */
    size_t packet_buffer_size;
 
@@ -498,6 +642,23 @@ struct netplay
    /* Size of savestates */
    size_t state_size;
 
+   /* The delta frames only keep patches between consecutive states.
+    * The newest state is kept in full in state_head, for the frame at
+    * state_head_ptr. Older states are rebuilt on demand into
+    * state_scratch, and new states are serialized into state_work. */
+   uint8_t *state_head;
+   uint8_t *state_work;
+   uint8_t *state_scratch;
+   uint8_t *state_patch;
+   size_t state_head_ptr;
+   size_t state_scratch_ptr;
+   bool have_state_head;
+   bool have_state_scratch;
+
+   /* Memory held by the states, and its peak, in bytes */
+   size_t state_memory;
+   size_t state_memory_peak;
+
    /* Are we replaying old frames? */
    bool is_replay;
 
@@ -567,6 +728,18 @@ struct netplay
 
    /* Are they valid? */
    bool crcs_valid;
+
+   /* Hash tree of the last frame we hashed */
+   struct netplay_hash_tree hash_tree;
+
+   /* Client: hash tree of the last frame found to mismatch, while we
+    * look for the blocks which differ */
+   struct netplay_hash_tree hash_desync;
+
+   /* Hash requests we may still send for hash_desync, and those we're
+    * waiting on */
+   unsigned hash_desync_budget;
+   unsigned hash_desync_pending;
 };
 
 /***************************************************************
@@ -612,6 +785,22 @@ bool netplay_send(struct socket_buffer *sbuf, int sockfd, const void *buf,
  */
 bool netplay_send_flush(struct socket_buffer *sbuf, int sockfd, bool block);
 
+/**
+ * netplay_send_queued
+ *
+ * Returns the number of bytes queued in the given socket buffer that have not
+ * been handed to the socket yet.
+ */
+size_t netplay_send_queued(struct socket_buffer *sbuf);
+
+/**
+ * netplay_send_cmd
+ *
+ * Queue a command and its payload for sending.
+ */
+bool netplay_send_cmd(struct socket_buffer *sbuf, int sockfd, uint32_t cmd,
+   const void *data, size_t size);
+
 /**
  * netplay_recv
  *
@@ -661,6 +850,27 @@ bool netplay_delta_frame_ready(netplay_t *netplay, struct delta_frame *delta,
  */
 uint32_t netplay_delta_frame_crc(netplay_t *netplay, struct delta_frame *delta);
 
+/**
+ * netplay_delta_frame_hash_tree
+ *
+ * Build the hash tree for the serialization of this frame into tree.
+ *
+ * Returns: false if the state is lost, leaving tree invalid.
+ */
+bool netplay_delta_frame_hash_tree(netplay_t *netplay,
+      struct delta_frame *delta, struct netplay_hash_tree *tree);
+
+/**
+ * netplay_delta_frame_check_hash
+ *
+ * Build the hash tree of this frame into netplay->hash_tree and check its
+ * root against the one the server sent.
+ *
+ * Returns: true if they match, false if not or if the state is lost.
+ */
+bool netplay_delta_frame_check_hash(netplay_t *netplay,
+      struct delta_frame *delta, uint64_t hash);
+
 /**
  * netplay_delta_frame_free
  *
@@ -668,6 +878,46 @@ uint32_t netplay_delta_frame_crc(netplay_t *netplay, struct delta_frame *delta);
  */
 void netplay_delta_frame_free(struct delta_frame *delta);
 
+/**
+ * netplay_delta_states_init
+ *
+ * Allocate the full state buffers once the state size is known.
+ */
+bool netplay_delta_states_init(netplay_t *netplay);
+
+/**
+ * netplay_delta_states_free
+ *
+ * Free the full state buffers and report the memory used.
+ */
+void netplay_delta_states_free(netplay_t *netplay);
+
+/**
+ * netplay_delta_frame_state_buffer
+ *
+ * Get the buffer to serialize a new state into, before handing it to
+ * netplay_delta_frame_store_state. Its contents are undefined.
+ */
+void *netplay_delta_frame_state_buffer(netplay_t *netplay);
+
+/**
+ * netplay_delta_frame_store_state
+ *
+ * Store the state in netplay_delta_frame_state_buffer as the state of the
+ * frame at ptr. States newer than ptr are discarded.
+ */
+void netplay_delta_frame_store_state(netplay_t *netplay, size_t ptr);
+
+/**
+ * netplay_delta_frame_state
+ *
+ * Get the serialized state of the frame at ptr, rebuilding it from the
+ * newest state if needed. Only valid until the next call to any of the
+ * state functions. Returns NULL if the state was never stored or can no
+ * longer be rebuilt.
+ */
+const void *netplay_delta_frame_state(netplay_t *netplay, size_t ptr);
+
 /**
  * netplay_input_state_for
  *
@@ -725,6 +975,80 @@ uint8_t netplay_settings_share_mode(unsigned share_digital, unsigned share_analo
  */
 void input_poll_net(void);
 
+/***************************************************************
+ * NETPLAY-PROTOCOL.C
+ **************************************************************/
+
+/**
+ * netplay_impl_magic
+ *
+ * A pseudo-hash of the RetroArch and Netplay version, so only compatible
+ * versions play together.
+ */
+uint32_t netplay_impl_magic(void);
+
+/**
+ * netplay_platform_magic
+ *
+ * Just enough info to tell us if our platforms mismatch: Endianness and a
+ * couple of type sizes.
+ */
+uint32_t netplay_platform_magic(void);
+
+/**
+ * netplay_protocol_header
+ *
+ * Fill in the header both sides open the connection with.
+ */
+void netplay_protocol_header(uint32_t *header, uint32_t salt);
+
+/**
+ * netplay_protocol_check_header
+ *
+ * Check the header the other side opened with, and note down the protocol
+ * version and compression it supports.
+ *
+ * Returns NULL if we can talk to it, otherwise why not.
+ */
+const char *netplay_protocol_check_header(
+      struct netplay_connection *connection, const uint32_t *header);
+
+/**
+ * netplay_protocol_send_nick
+ *
+ * Queue a NICK command.
+ */
+bool netplay_protocol_send_nick(struct netplay_connection *connection,
+      const char *nick);
+
+/**
+ * netplay_protocol_send_password
+ *
+ * Queue a PASSWORD command, salted as the other side asked.
+ */
+bool netplay_protocol_send_password(struct netplay_connection *connection,
+      const char *password);
+
+/**
+ * netplay_protocol_check_password
+ *
+ * Is the hash the other side sent that of this password, salted as we
+ * asked?
+ */
+bool netplay_protocol_check_password(struct netplay_connection *connection,
+      const char *hash, const char *password);
+
+/**
+ * netplay_protocol_send_sync
+ *
+ * Queue a SYNC command, which tells a new client the frame, its client
+ * number and nick, who plays on which device, and the SRAM.
+ */
+bool netplay_protocol_send_sync(struct netplay_connection *connection,
+      uint32_t frame, uint32_t client_num, const uint32_t *config_devices,
+      const uint8_t *share_modes, const uint32_t *device_clients,
+      const void *sram, size_t sram_size);
+
 /***************************************************************
  * NETPLAY-HANDSHAKE.C
  **************************************************************/
@@ -849,11 +1173,20 @@ void netplay_send_raw_cmd_all(netplay_t *netplay,
    size_t size);
 
 /**
- * netplay_cmd_crc
+ * netplay_cmd_frame_hash
  *
- * Send a CRC command to all active clients.
+ * Send the hash of a frame to all active clients: the root of its hash
+ * tree to those new enough to take it, its CRC to the others.
  */
-bool netplay_cmd_crc(netplay_t *netplay, struct delta_frame *delta);
+bool netplay_cmd_frame_hash(netplay_t *netplay, struct delta_frame *delta);
+
+/**
+ * netplay_frame_hash_desync
+ *
+ * After a frame didn't match the server's, ask the server for the hashes
+ * below the root of its hash tree to find and log the blocks which differ.
+ */
+void netplay_frame_hash_desync(netplay_t *netplay, struct delta_frame *delta);
 
 /**
  * netplay_cmd_request_savestate
@@ -862,6 +1195,48 @@ bool netplay_cmd_crc(netplay_t *netplay, struct delta_frame *delta);
  */
 bool netplay_cmd_request_savestate(netplay_t *netplay);
 
+/**
+ * netplay_send_savestate_delta
+ *
+ * Start sending a savestate for the given frame to a connection which
+ * supports NETPLAY_COMPRESSION_DELTA, replacing any transfer in progress.
+ * cmd is NETPLAY_CMD_LOAD_SAVESTATE_DELTA, or NETPLAY_CMD_KEYFRAME_DELTA for
+ * a relay to keep. Only the first chunk is queued;
+ * netplay_send_savestate_chunks sends the rest.
+ *
+ * Returns true on success, false on failure.
+ */
+bool netplay_send_savestate_delta(netplay_t *netplay,
+   struct netplay_connection *connection, uint32_t cmd, const void *state,
+   size_t size, uint32_t frame);
+
+/**
+ * netplay_send_savestate_chunks
+ *
+ * Queue more of the savestate being sent to a connection, if any, as long as
+ * it won't hold up the input behind it.
+ *
+ * Returns true on success, false on failure.
+ */
+bool netplay_send_savestate_chunks(netplay_t *netplay,
+   struct netplay_connection *connection);
+
+/**
+ * netplay_savestate_transfer_free
+ *
+ * Free the buffers of a delta savestate transfer.
+ */
+void netplay_savestate_transfer_free(
+   struct netplay_savestate_transfer *transfer);
+
+/**
+ * netplay_savestate_receiving
+ *
+ * Returns true if we're in the middle of receiving a savestate, in which case
+ * our own state is known to be wrong and CRCs shouldn't be checked.
+ */
+bool netplay_savestate_receiving(netplay_t *netplay);
+
 /**
  * netplay_cmd_mode
  *
@@ -880,6 +1255,16 @@ bool netplay_cmd_stall(netplay_t *netplay,
    struct netplay_connection *connection,
    uint32_t frames);
 
+/**
+ * netplay_poll_events
+ *
+ * Wait up to timeout_ms milliseconds for any of our sockets to become
+ * readable, and mark those which have.
+ *
+ * Returns the number of sockets which became readable, or -1 on error.
+ */
+int netplay_poll_events(netplay_t *netplay, int timeout_ms);
+
 /**
  * netplay_poll_net_input
  *
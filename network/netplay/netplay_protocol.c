@@ -0,0 +1,234 @@
+/*  RetroArch - A frontend for libretro.
+ *  Copyright (C) 2016-2017 - Gregor Richards
+ *
+ *  RetroArch is free software: you can redistribute it and/or modify it under the terms
+ *  of the GNU General Public License as published by the Free Software Found-
+ *  ation, either version 3 of the License, or (at your option) any later version.
+ *
+ *  RetroArch is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ *  PURPOSE.  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with RetroArch.
+ *  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <boolean.h>
+#include <compat/strl.h>
+#include <rhash.h>
+
+#include "netplay_private.h"
+
+#include "../../version.h"
+
+/**
+ * netplay_impl_magic:
+ *
+ * A pseudo-hash of the RetroArch and Netplay version, so only compatible
+ * versions play together.
+ */
+uint32_t netplay_impl_magic(void)
+{
+   size_t i;
+   uint32_t res                        = 0;
+   const char *ver                     = PACKAGE_VERSION;
+   size_t len                          = strlen(ver);
+
+   for (i = 0; i < len; i++)
+      res ^= ver[i] << (i & 0xf);
+
+   res ^= NETPLAY_PROTOCOL_VERSION << (i & 0xf);
+
+   return res;
+}
+
+/**
+ * netplay_platform_magic
+ *
+ * Just enough info to tell us if our platforms mismatch: Endianness and a
+ * couple of type sizes.
+ *
+ * Format:
+ *    bit 31:     Reserved
+ *    bit 30:     1 for big endian
+ *    bits 29-15: sizeof(size_t)
+ *    bits 14-0:  sizeof(long)
+ */
+uint32_t netplay_platform_magic(void)
+{
+   uint32_t ret =
+       ((1 == htonl(1)) << 30)
+      |(sizeof(size_t) << 15)
+      |(sizeof(long));
+   return ret;
+}
+
+/**
+ * netplay_protocol_header
+ *
+ * Fill in the header both sides open the connection with.
+ */
+void netplay_protocol_header(uint32_t *header, uint32_t salt)
+{
+   header[0] = htonl(NETPLAY_MAGIC);
+   header[1] = htonl(netplay_platform_magic());
+   header[2] = htonl(NETPLAY_COMPRESSION_SUPPORTED);
+   header[3] = htonl(salt);
+   header[4] = htonl(NETPLAY_PROTOCOL_VERSION);
+   header[5] = htonl(netplay_impl_magic());
+}
+
+/**
+ * netplay_protocol_check_header
+ *
+ * Check the header the other side opened with, and note down the protocol
+ * version and compression it supports.
+ *
+ * Returns NULL if we can talk to it, otherwise why not.
+ */
+const char *netplay_protocol_check_header(
+      struct netplay_connection *connection, const uint32_t *header)
+{
+   uint32_t compression;
+
+   if (ntohl(header[0]) != NETPLAY_MAGIC)
+      return msg_hash_to_str(MSG_NETPLAY_NOT_RETROARCH);
+   if (ntohl(header[4]) < NETPLAY_PROTOCOL_VERSION_MIN)
+      return msg_hash_to_str(MSG_NETPLAY_OUT_OF_DATE);
+
+   compression                       = ntohl(header[2]) &
+      NETPLAY_COMPRESSION_SUPPORTED;
+   connection->protocol_version      = ntohl(header[4]);
+   connection->compression_supported = compression & NETPLAY_COMPRESSION_ZLIB;
+
+   /* Can savestates be sent as diffs? */
+   connection->savestate_delta       =
+      !!(compression & NETPLAY_COMPRESSION_DELTA);
+
+   return NULL;
+}
+
+/**
+ * netplay_protocol_send_nick
+ *
+ * Queue a NICK command.
+ */
+bool netplay_protocol_send_nick(struct netplay_connection *connection,
+      const char *nick)
+{
+   struct nick_buf_s nick_buf;
+
+   nick_buf.cmd[0] = htonl(NETPLAY_CMD_NICK);
+   nick_buf.cmd[1] = htonl(sizeof(nick_buf.nick));
+   memset(nick_buf.nick, 0, sizeof(nick_buf.nick));
+   strlcpy(nick_buf.nick, nick, sizeof(nick_buf.nick));
+
+   return netplay_send(&connection->send_packet_buffer, connection->fd,
+         &nick_buf, sizeof(nick_buf));
+}
+
+static void netplay_protocol_password_hash(char *hash, uint32_t salt,
+      const char *password)
+{
+   char salted[8+NETPLAY_PASS_LEN]; /* 8 for salt */
+
+   snprintf(salted, sizeof(salted), "%08X", salt);
+   if (password)
+      strlcpy(salted + 8, password, sizeof(salted) - 8);
+
+   sha256_hash(hash, (uint8_t *) salted, strlen(salted));
+}
+
+/**
+ * netplay_protocol_send_password
+ *
+ * Queue a PASSWORD command, salted as the other side asked.
+ */
+bool netplay_protocol_send_password(struct netplay_connection *connection,
+      const char *password)
+{
+   struct password_buf_s password_buf;
+   char hash[NETPLAY_PASS_HASH_LEN+1]; /* + NULL terminator */
+
+   netplay_protocol_password_hash(hash, connection->salt, password);
+
+   password_buf.cmd[0] = htonl(NETPLAY_CMD_PASSWORD);
+   password_buf.cmd[1] = htonl(sizeof(password_buf.password));
+   memcpy(password_buf.password, hash, NETPLAY_PASS_HASH_LEN);
+
+   return netplay_send(&connection->send_packet_buffer, connection->fd,
+         &password_buf, sizeof(password_buf));
+}
+
+/**
+ * netplay_protocol_check_password
+ *
+ * Is the hash the other side sent that of this password, salted as we
+ * asked?
+ */
+bool netplay_protocol_check_password(struct netplay_connection *connection,
+      const char *hash, const char *password)
+{
+   char correct[NETPLAY_PASS_HASH_LEN+1];
+
+   netplay_protocol_password_hash(correct, connection->salt, password);
+
+   return !memcmp(hash, correct, NETPLAY_PASS_HASH_LEN);
+}
+
+/**
+ * netplay_protocol_send_sync
+ *
+ * Queue a SYNC command, which tells a new client the frame, its client
+ * number and nick, who plays on which device, and the SRAM.
+ */
+bool netplay_protocol_send_sync(struct netplay_connection *connection,
+      uint32_t frame, uint32_t client_num, const uint32_t *config_devices,
+      const uint8_t *share_modes, const uint32_t *device_clients,
+      const void *sram, size_t sram_size)
+{
+   size_t i;
+   uint32_t cmd[4];
+   uint32_t device;
+
+   cmd[0] = htonl(NETPLAY_CMD_SYNC);
+   cmd[1] = htonl((uint32_t)(NETPLAY_CMD_SYNC_MIN_SIZE + sram_size));
+   cmd[2] = htonl(frame);
+   cmd[3] = htonl(client_num);
+
+   if (!netplay_send(&connection->send_packet_buffer, connection->fd, cmd,
+            sizeof(cmd)))
+      return false;
+
+   /* Now send the device info */
+   for (i = 0; i < MAX_INPUT_DEVICES; i++)
+   {
+      device = htonl(config_devices[i]);
+      if (!netplay_send(&connection->send_packet_buffer, connection->fd,
+            &device, sizeof(device)))
+         return false;
+   }
+
+   /* Then the share mode */
+   if (!netplay_send(&connection->send_packet_buffer, connection->fd,
+         share_modes, MAX_INPUT_DEVICES * sizeof(uint8_t)))
+      return false;
+
+   /* Then the device-client mapping */
+   for (i = 0; i < MAX_INPUT_DEVICES; i++)
+   {
+      device = htonl(device_clients[i]);
+      if (!netplay_send(&connection->send_packet_buffer, connection->fd,
+            &device, sizeof(device)))
+         return false;
+   }
+
+   /* The nick, and finally the SRAM */
+   return netplay_send(&connection->send_packet_buffer, connection->fd,
+         connection->nick, NETPLAY_NICK_LEN) &&
+      (!sram_size || netplay_send(&connection->send_packet_buffer,
+         connection->fd, sram, sram_size));
+}
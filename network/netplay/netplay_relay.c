@@ -0,0 +1,2081 @@
+/*  RetroArch - A frontend for libretro.
+ *  Copyright (C) 2016-2017 - Gregor Richards
+ *
+ *  RetroArch is free software: you can redistribute it and/or modify it under the terms
+ *  of the GNU General Public License as published by the Free Software Found-
+ *  ation, either version 3 of the License, or (at your option) any later version.
+ *
+ *  RetroArch is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ *  PURPOSE.  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with RetroArch.
+ *  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <boolean.h>
+#include <compat/strl.h>
+#include <net/net_compat.h>
+#include <net/net_socket.h>
+
+#include "netplay_private.h"
+#include "netplay_relay.h"
+
+/* Spectators further behind than this many bytes of log are dropped. A
+ * host too old to send keyframes is asked for a savestate once the log
+ * since the last one is half this long. */
+#define RELAY_LOG_LIMIT        (16 * 1024 * 1024)
+
+/* Frames whose place in the log we remember. A keyframe which arrives
+ * later than this after its frame can't be used. */
+#define RELAY_BOUNDARIES       256
+
+/* Fewest frames between savestates asked for on behalf of spectators */
+#define RELAY_REQUEST_FRAMES   60
+
+/* Socket buffers, and how much log to drop at a time */
+#define RELAY_BUFFER_SIZE      (64 * 1024)
+
+/* Never sent: marks where a state belongs in the log */
+#define RELAY_CMD_STATE        0xFFFF0001
+
+#define RELAY_TAG_LISTEN       0
+#define RELAY_TAG_HOST         1
+#define RELAY_TAG_VIEWER       2
+
+/* A state as a spectator takes it: wire ready commands */
+struct relay_encoding
+{
+   struct relay_encoding *next;
+   uint8_t *data;
+   size_t size;
+
+   /* What it's diffed against, 0 for a zeroed state */
+   uint32_t base_id;
+   uint32_t compression;
+   bool delta;
+};
+
+struct relay_state
+{
+   uint8_t *data;
+   struct relay_encoding *encodings;
+   uint32_t id;
+   uint32_t frame;
+   unsigned refs;
+
+   /* Otherwise still in transit from the host */
+   bool complete;
+
+   /* The host gave up sending it */
+   bool dropped;
+};
+
+/* Payload of a RELAY_CMD_STATE */
+struct relay_marker
+{
+   struct relay_state *state;
+
+   /* The host's frame at this point of the log */
+   uint32_t frame;
+
+   /* Only for spectators who asked for a state */
+   bool keyframe;
+};
+
+/* Where a frame's input begins in the log, and what a spectator starting
+ * there needs to be told */
+struct relay_boundary
+{
+   /* Other players' input for this frame or later, logged before pos */
+   uint8_t *carry;
+   size_t carry_size;
+
+   size_t pos;
+   uint32_t frame;
+   uint32_t device_clients[MAX_INPUT_DEVICES];
+   uint8_t share_modes[MAX_INPUT_DEVICES];
+   bool paused;
+   bool valid;
+};
+
+struct relay_viewer
+{
+   struct netplay_connection connection;
+
+   /* Log position of the next byte to send, and the end of the commands we
+    * can send straight from the log */
+   size_t cursor;
+   size_t run_end;
+
+   /* State being sent */
+   struct relay_state *blob_state;
+   struct relay_encoding *blob;
+   size_t blob_pos;
+
+   /* The last state sent, and the one diffs are made against */
+   struct relay_state *delta_base;
+   uint32_t state_id;
+
+   /* Stopped partway through a command, so no replies may go out */
+   bool mid;
+
+   /* Desynched and asked for a savestate */
+   bool wants_state;
+};
+
+struct netplay_relay
+{
+   /* The host, and the delta savestate it's sending us */
+   struct netplay_connection host;
+   struct netplay_savestate_transfer transfer;
+   struct relay_state *transfer_state;
+   uint32_t transfer_marker_frame;
+   uint8_t *zbuffer;
+   size_t zbuffer_size;
+
+   /* What the host told us in the handshake, passed on to our spectators */
+   struct info_buf_s info;
+   uint8_t *sram;
+   size_t sram_size;
+   uint32_t config_devices[MAX_INPUT_DEVICES];
+   uint32_t client_num;
+   char nick[NETPLAY_NICK_LEN];
+   char password[NETPLAY_PASS_LEN];
+
+   /* Had the host's SYNC, but perhaps not all of the SRAM in it */
+   bool synced;
+   size_t sram_received;
+
+   /* The host's frame after the input logged so far, and its players now */
+   uint32_t server_frame;
+   uint32_t device_clients[MAX_INPUT_DEVICES];
+   uint8_t share_modes[MAX_INPUT_DEVICES];
+   bool paused;
+
+   /* Other players' input logged for frames the host hasn't reached */
+   uint8_t *ahead;
+   size_t ahead_size;
+   size_t ahead_capacity;
+
+   struct relay_boundary boundaries[RELAY_BOUNDARIES];
+
+   /* Everything to forward, starting at absolute position log_base */
+   uint8_t *log;
+   size_t log_size;
+   size_t log_capacity;
+   size_t log_base;
+
+   /* Where new spectators start */
+   struct relay_state *keyframe;
+   struct relay_boundary keyframe_at;
+   unsigned keyframe_interval;
+
+   /* When we last asked for a keyframe, and for a savestate on behalf of
+    * spectators */
+   uint32_t keyframe_request_frame;
+   uint32_t state_request_frame;
+
+   /* Keyframes don't land where the host's input is, so can't fix
+    * desynched spectators (the host has input latency frames) */
+   bool keyframes_misplaced;
+
+   size_t state_size;
+   uint8_t *zeros;
+   uint8_t *diff;
+   uint8_t *scratch;
+   size_t scratch_size;
+   uint32_t next_state_id;
+
+   struct compression_transcoder compress_nil, compress_zlib;
+
+   int listen_fd;
+   bool listen_readable;
+   netplay_poller_t poller;
+
+   struct relay_viewer *viewers;
+   size_t viewers_size;
+};
+
+static struct compression_transcoder *relay_ctrans(netplay_relay_t *relay,
+      uint32_t compression)
+{
+   struct compression_transcoder *ctrans = &relay->compress_nil;
+
+   if (compression == NETPLAY_COMPRESSION_ZLIB)
+   {
+      ctrans = &relay->compress_zlib;
+      if (!ctrans->compression_backend)
+         ctrans->compression_backend =
+            trans_stream_get_zlib_deflate_backend();
+   }
+   if (!ctrans->compression_backend)
+      ctrans->compression_backend = trans_stream_get_pipe_backend();
+   if (!ctrans->decompression_backend)
+      ctrans->decompression_backend = ctrans->compression_backend->reverse;
+
+   if (!ctrans->compression_stream)
+   {
+      ctrans->compression_stream   = ctrans->compression_backend->stream_new();
+      ctrans->decompression_stream = ctrans->decompression_backend->stream_new();
+   }
+   if (!ctrans->compression_stream || !ctrans->decompression_stream)
+      return NULL;
+
+   return ctrans;
+}
+
+static void relay_ctrans_free(struct compression_transcoder *ctrans)
+{
+   if (ctrans->compression_stream)
+      ctrans->compression_backend->stream_free(ctrans->compression_stream);
+   if (ctrans->decompression_stream)
+      ctrans->decompression_backend->stream_free(ctrans->decompression_stream);
+}
+
+/**
+ * relay_state_size
+ *
+ * Learn the size of the host's savestates from the first one, and allocate
+ * what handling them takes. From then on we take commands as big as a
+ * netplay peer would, see netplay_init_socket_buffers.
+ */
+static bool relay_state_size(netplay_relay_t *relay, uint32_t isize)
+{
+   size_t diff_size, packet_buffer_size;
+   struct socket_buffer *sbuf = &relay->host.recv_packet_buffer;
+
+   if (relay->state_size)
+      return isize == relay->state_size;
+
+   if (!isize)
+      return false;
+
+   diff_size                = netplay_savestate_diff_maxsize(isize);
+   relay->state_size        = isize;
+   relay->zbuffer_size      = relay->state_size * 2;
+   packet_buffer_size       = relay->zbuffer_size +
+      NETPLAY_MAX_STALL_FRAMES * 16;
+   if (packet_buffer_size > sbuf->bufsz &&
+       !netplay_resize_socket_buffer(sbuf, packet_buffer_size))
+      return false;
+
+   relay->zbuffer           = (uint8_t*)malloc(relay->zbuffer_size);
+   relay->zeros             = (uint8_t*)calloc(1, isize);
+   relay->transfer.base     = (uint8_t*)calloc(1, isize);
+   relay->diff              = (uint8_t*)malloc(diff_size);
+
+   /* Leave room for zlib making random data slightly bigger */
+   relay->scratch_size      = diff_size + diff_size / 8 + 64;
+   relay->scratch           = (uint8_t*)malloc(relay->scratch_size);
+   relay->transfer.capacity = relay->scratch_size;
+   relay->transfer.data     = (uint8_t*)malloc(relay->transfer.capacity);
+
+   return relay->zbuffer && relay->zeros && relay->transfer.base &&
+      relay->diff && relay->scratch && relay->transfer.data;
+}
+
+static struct relay_state *relay_state_new(netplay_relay_t *relay,
+      uint32_t frame)
+{
+   struct relay_state *state = (struct relay_state*)
+      calloc(1, sizeof(*state));
+
+   if (!state)
+      return NULL;
+
+   state->data = (uint8_t*)malloc(relay->state_size);
+   if (!state->data)
+   {
+      free(state);
+      return NULL;
+   }
+
+   state->id    = ++relay->next_state_id;
+   state->frame = frame;
+   state->refs  = 1;
+   return state;
+}
+
+static struct relay_state *relay_state_ref(struct relay_state *state)
+{
+   if (state)
+      state->refs++;
+   return state;
+}
+
+static void relay_state_unref(struct relay_state *state)
+{
+   if (!state || --state->refs)
+      return;
+
+   while (state->encodings)
+   {
+      struct relay_encoding *encoding = state->encodings;
+      state->encodings                = encoding->next;
+      free(encoding->data);
+      free(encoding);
+   }
+   free(state->data);
+   free(state);
+}
+
+static bool relay_log_append(netplay_relay_t *relay, const void *data,
+      size_t size)
+{
+   if (relay->log_size + size > relay->log_capacity)
+   {
+      size_t capacity = relay->log_capacity ? relay->log_capacity :
+         RELAY_BUFFER_SIZE;
+      uint8_t *log;
+
+      while (capacity < relay->log_size + size)
+         capacity *= 2;
+      log = (uint8_t*)realloc(relay->log, capacity);
+      if (!log)
+         return false;
+      relay->log          = log;
+      relay->log_capacity = capacity;
+   }
+
+   memcpy(relay->log + relay->log_size, data, size);
+   relay->log_size += size;
+   return true;
+}
+
+static bool relay_log_cmd(netplay_relay_t *relay, uint32_t cmd,
+      const void *payload, size_t size)
+{
+   uint32_t header[2];
+
+   header[0] = htonl(cmd);
+   header[1] = htonl((uint32_t)size);
+
+   return relay_log_append(relay, header, sizeof(header)) &&
+      (!size || relay_log_append(relay, payload, size));
+}
+
+/* Log where a state from the host belongs among its input */
+static bool relay_log_marker(netplay_relay_t *relay,
+      struct relay_state *state, bool keyframe)
+{
+   struct relay_marker marker;
+
+   memset(&marker, 0, sizeof(marker));
+   marker.state    = relay_state_ref(state);
+   marker.frame    = relay->server_frame;
+   marker.keyframe = keyframe;
+
+   if (!relay_log_cmd(relay, RELAY_CMD_STATE, &marker, sizeof(marker)))
+   {
+      relay_state_unref(state);
+      return false;
+   }
+   return true;
+}
+
+static size_t relay_log_end(netplay_relay_t *relay)
+{
+   return relay->log_base + relay->log_size;
+}
+
+/* The command at an absolute log position */
+static const uint8_t *relay_log_entry(netplay_relay_t *relay, size_t pos,
+      uint32_t *cmd, uint32_t *cmd_size)
+{
+   const uint8_t *entry = relay->log + (pos - relay->log_base);
+   uint32_t header[2];
+
+   memcpy(header, entry, sizeof(header));
+   *cmd      = ntohl(header[0]);
+   *cmd_size = ntohl(header[1]);
+   return entry + sizeof(header);
+}
+
+static void relay_boundary_clear(struct relay_boundary *boundary)
+{
+   free(boundary->carry);
+   memset(boundary, 0, sizeof(*boundary));
+}
+
+/* The frame of a logged INPUT command */
+static uint32_t relay_input_frame(const uint8_t *entry)
+{
+   uint32_t frame;
+   memcpy(&frame, entry + 2 * sizeof(uint32_t), sizeof(frame));
+   return ntohl(frame);
+}
+
+/**
+ * relay_frame_done
+ *
+ * The host sent its own input for a frame, so what follows in the log is
+ * the next frame's. Remember where that begins.
+ */
+static void relay_frame_done(netplay_relay_t *relay, uint32_t frame)
+{
+   size_t pos, kept = 0;
+   struct relay_boundary *boundary;
+
+   /* Already had it */
+   if (frame < relay->server_frame)
+      return;
+
+   relay->server_frame = frame + 1;
+   boundary            =
+      &relay->boundaries[relay->server_frame % RELAY_BOUNDARIES];
+   relay_boundary_clear(boundary);
+
+   boundary->pos    = relay_log_end(relay);
+   boundary->frame  = relay->server_frame;
+   boundary->paused = relay->paused;
+   memcpy(boundary->device_clients, relay->device_clients,
+         sizeof(boundary->device_clients));
+   memcpy(boundary->share_modes, relay->share_modes,
+         sizeof(boundary->share_modes));
+
+   /* Input the other players sent ahead of the host would be missed by a
+    * spectator starting here, so it gets a copy. Anything older is no
+    * longer ahead. */
+   for (pos = 0; pos < relay->ahead_size; )
+   {
+      uint32_t size;
+      memcpy(&size, relay->ahead + pos + sizeof(uint32_t), sizeof(size));
+      size = 2 * sizeof(uint32_t) + ntohl(size);
+
+      if (relay_input_frame(relay->ahead + pos) >= relay->server_frame)
+      {
+         memmove(relay->ahead + kept, relay->ahead + pos, size);
+         kept += size;
+      }
+      pos += size;
+   }
+   relay->ahead_size = kept;
+
+   if (kept)
+   {
+      boundary->carry = (uint8_t*)malloc(kept);
+      if (!boundary->carry)
+         return;
+      memcpy(boundary->carry, relay->ahead, kept);
+      boundary->carry_size = kept;
+   }
+
+   boundary->valid = true;
+}
+
+static bool relay_ahead_add(netplay_relay_t *relay, const void *cmd,
+      size_t size)
+{
+   if (relay->ahead_size + size > relay->ahead_capacity)
+   {
+      size_t capacity = (relay->ahead_size + size) * 2;
+      uint8_t *ahead  = (uint8_t*)realloc(relay->ahead, capacity);
+      if (!ahead)
+         return false;
+      relay->ahead          = ahead;
+      relay->ahead_capacity = capacity;
+   }
+
+   memcpy(relay->ahead + relay->ahead_size, cmd, size);
+   relay->ahead_size += size;
+   return true;
+}
+
+static void relay_set_socket_options(int fd)
+{
+#if defined(IPPROTO_TCP) && defined(TCP_NODELAY)
+   int flag = 1;
+   if (setsockopt(fd, IPPROTO_TCP, TCP_NODELAY,
+#ifdef _WIN32
+      (const char*)
+#else
+      (const void*)
+#endif
+      &flag, sizeof(int)) < 0)
+      RARCH_WARN("Could not set netplay TCP socket to nodelay. Expect jitter.\n");
+#endif
+}
+
+/* Connect to the host, or listen for spectators if server is NULL */
+static int relay_socket(const char *server, uint16_t port)
+{
+   char port_buf[16];
+   struct addrinfo hints;
+   struct addrinfo *res = NULL;
+   struct addrinfo *tmp;
+   int fd               = -1;
+
+   memset(&hints, 0, sizeof(hints));
+   hints.ai_socktype = SOCK_STREAM;
+   if (!server)
+      hints.ai_flags = AI_PASSIVE;
+
+   snprintf(port_buf, sizeof(port_buf), "%hu", (unsigned short)port);
+   if (getaddrinfo_retro(server, port_buf, &hints, &res) != 0 || !res)
+      return -1;
+
+   for (tmp = res; tmp; tmp = tmp->ai_next)
+   {
+      fd = socket(tmp->ai_family, tmp->ai_socktype, tmp->ai_protocol);
+      if (fd < 0)
+         continue;
+
+      if (server)
+      {
+         relay_set_socket_options(fd);
+         if (socket_connect(fd, (void*)tmp, false) >= 0)
+            break;
+      }
+      else if (socket_bind(fd, (void*)tmp) && listen(fd, 1024) >= 0)
+         break;
+
+      socket_close(fd);
+      fd = -1;
+   }
+
+   freeaddrinfo_retro(res);
+   return fd;
+}
+
+/**
+ * relay_transfer_drop
+ *
+ * The host started another state, so it won't finish the one in transit.
+ */
+static void relay_transfer_drop(netplay_relay_t *relay)
+{
+   if (relay->transfer_state)
+   {
+      relay->transfer_state->dropped = true;
+      relay_state_unref(relay->transfer_state);
+      relay->transfer_state = NULL;
+   }
+   relay->transfer.pending = false;
+}
+
+static void relay_viewer_start(netplay_relay_t *relay,
+      struct relay_viewer *viewer);
+
+/**
+ * relay_keyframe_set
+ *
+ * New spectators start from this state now.
+ */
+static void relay_keyframe_set(netplay_relay_t *relay,
+      struct relay_state *state)
+{
+   size_t i;
+   struct relay_boundary *boundary =
+      &relay->boundaries[state->frame % RELAY_BOUNDARIES];
+
+   if (!boundary->valid ||
+       boundary->frame != state->frame ||
+       boundary->pos < relay->log_base)
+   {
+      RARCH_WARN("[netplay] Keyframe for frame %u arrived too late to use.\n",
+            state->frame);
+      return;
+   }
+
+   relay_state_unref(relay->keyframe);
+   relay_boundary_clear(&relay->keyframe_at);
+
+   relay->keyframe    = relay_state_ref(state);
+   relay->keyframe_at = *boundary;
+   if (boundary->carry_size)
+   {
+      relay->keyframe_at.carry = (uint8_t*)malloc(boundary->carry_size);
+      if (!relay->keyframe_at.carry)
+      {
+         relay->keyframe_at.carry_size = 0;
+         return;
+      }
+      memcpy(relay->keyframe_at.carry, boundary->carry,
+            boundary->carry_size);
+   }
+
+   /* Let in whoever was waiting for one */
+   for (i = 0; i < relay->viewers_size; i++)
+   {
+      struct relay_viewer *viewer = &relay->viewers[i];
+      if (viewer->connection.active &&
+          viewer->connection.mode == NETPLAY_CONNECTION_PRE_SYNC)
+         relay_viewer_start(relay, viewer);
+   }
+}
+
+#define RECV(buf, sz) \
+recvd = netplay_recv(&connection->recv_packet_buffer, connection->fd, (buf), \
+(sz), false); \
+if (recvd >= 0 && recvd < (ssize_t) (sz)) goto shrt; \
+else if (recvd < 0)
+
+/**
+ * relay_host_handshake
+ *
+ * Join the host as a spectator, as netplay_handshake does for a client.
+ * Whatever the host tells a spectator is kept for our own.
+ */
+static bool relay_host_handshake(netplay_relay_t *relay, bool *had_input)
+{
+   ssize_t recvd;
+   struct netplay_connection *connection = &relay->host;
+
+   switch (connection->mode)
+   {
+      case NETPLAY_CONNECTION_INIT:
+         {
+            uint32_t header[6];
+            const char *dmsg;
+
+            RECV(header, sizeof(header))
+               return false;
+
+            if ((dmsg = netplay_protocol_check_header(connection, header)))
+            {
+               RARCH_ERR("%s\n", dmsg);
+               return false;
+            }
+            if (ntohl(header[5]) != netplay_impl_magic())
+               RARCH_WARN("%s\n",
+                     msg_hash_to_str(MSG_NETPLAY_DIFFERENT_VERSIONS));
+
+            /* Our nick, and the password if one is demanded */
+            connection->salt = ntohl(header[3]);
+            if (!netplay_protocol_send_nick(connection, relay->nick) ||
+                (connection->salt &&
+                 !netplay_protocol_send_password(connection,
+                    relay->password)))
+               return false;
+
+            connection->mode = NETPLAY_CONNECTION_PRE_NICK;
+            break;
+         }
+
+      case NETPLAY_CONNECTION_PRE_NICK:
+         {
+            struct nick_buf_s nick_buf;
+
+            RECV(&nick_buf, sizeof(nick_buf))
+               return false;
+
+            if (ntohl(nick_buf.cmd[0]) != NETPLAY_CMD_NICK ||
+                ntohl(nick_buf.cmd[1]) != sizeof(nick_buf.nick))
+            {
+               RARCH_ERR("%s\n",
+                     msg_hash_to_str(MSG_FAILED_TO_RECEIVE_NICKNAME_FROM_HOST));
+               return false;
+            }
+            nick_buf.nick[sizeof(nick_buf.nick) - 1] = '\0';
+            strlcpy(connection->nick, nick_buf.nick, sizeof(connection->nick));
+
+            connection->mode = NETPLAY_CONNECTION_PRE_INFO;
+            break;
+         }
+
+      case NETPLAY_CONNECTION_PRE_INFO:
+         {
+            struct info_buf_s info_buf;
+
+            RECV(info_buf.cmd, sizeof(info_buf.cmd))
+               return false;
+
+            if (ntohl(info_buf.cmd[0]) != NETPLAY_CMD_INFO)
+            {
+               RARCH_ERR("Failed to receive netplay info.\n");
+               return false;
+            }
+            if (ntohl(info_buf.cmd[1]) !=
+                  sizeof(info_buf) - sizeof(info_buf.cmd))
+            {
+               RARCH_ERR("[netplay] The host has no content loaded to relay.\n");
+               return false;
+            }
+
+            RECV(info_buf.core_name, sizeof(info_buf) - sizeof(info_buf.cmd))
+               return false;
+
+            /* The host's core and content, which we claim as our own */
+            relay->info = info_buf;
+            if (!netplay_send(&connection->send_packet_buffer, connection->fd,
+                     &relay->info, sizeof(relay->info)))
+               return false;
+
+            connection->mode = NETPLAY_CONNECTION_PRE_SYNC;
+            break;
+         }
+
+      case NETPLAY_CONNECTION_PRE_SYNC:
+         if (!relay->synced)
+         {
+            size_t i;
+            uint32_t cmd[4];
+            uint32_t devices[MAX_INPUT_DEVICES];
+            char nick[NETPLAY_NICK_LEN];
+
+            RECV(cmd, sizeof(cmd))
+               return false;
+
+            if (ntohl(cmd[0]) != NETPLAY_CMD_SYNC ||
+                ntohl(cmd[1]) < NETPLAY_CMD_SYNC_MIN_SIZE)
+            {
+               RARCH_ERR("%s\n",
+                     msg_hash_to_str(MSG_FAILED_TO_RECEIVE_SRAM_DATA_FROM_HOST));
+               return false;
+            }
+
+            RECV(devices, sizeof(devices))
+               return false;
+            for (i = 0; i < MAX_INPUT_DEVICES; i++)
+               relay->config_devices[i] = ntohl(devices[i]);
+
+            RECV(relay->share_modes, sizeof(relay->share_modes))
+               return false;
+
+            RECV(devices, sizeof(devices))
+               return false;
+            for (i = 0; i < MAX_INPUT_DEVICES; i++)
+               relay->device_clients[i] = ntohl(devices[i]);
+
+            RECV(nick, sizeof(nick))
+               return false;
+            nick[sizeof(nick) - 1] = '\0';
+            strlcpy(relay->nick, nick, sizeof(relay->nick));
+
+            relay->server_frame = ntohl(cmd[2]);
+            relay->paused       = !!(ntohl(cmd[3]) &
+                  NETPLAY_CMD_SYNC_BIT_PAUSED);
+            relay->client_num   = ntohl(cmd[3]) &
+                  ~NETPLAY_CMD_SYNC_BIT_PAUSED;
+
+            relay->sram_size    = ntohl(cmd[1]) - NETPLAY_CMD_SYNC_MIN_SIZE;
+            if (relay->sram_size &&
+                !(relay->sram = (uint8_t*)malloc(relay->sram_size)))
+               return false;
+
+            relay->synced = true;
+            netplay_recv_flush(&connection->recv_packet_buffer);
+            *had_input    = true;
+         }
+
+         /* The SRAM needn't fit our socket buffer, so take what's come */
+         if (relay->sram_received < relay->sram_size)
+         {
+            recvd = netplay_recv(&connection->recv_packet_buffer,
+                  connection->fd, relay->sram + relay->sram_received,
+                  relay->sram_size - relay->sram_received, false);
+            if (recvd < 0)
+               return false;
+            netplay_recv_flush(&connection->recv_packet_buffer);
+
+            relay->sram_received += recvd;
+            if (recvd)
+               *had_input = true;
+            if (relay->sram_received < relay->sram_size)
+               return true;
+         }
+
+         /* Spectators can start from the very beginning */
+         relay_frame_done(relay, relay->server_frame - 1);
+         relay->keyframe_request_frame = relay->server_frame;
+         relay->state_request_frame    = relay->server_frame;
+         connection->mode              = NETPLAY_CONNECTION_SPECTATING;
+
+         /* Only now is there anything to tell our own spectators */
+         if (!netplay_poller_add(&relay->poller, relay->listen_fd,
+                  RELAY_TAG_LISTEN))
+            return false;
+
+         RARCH_LOG("[netplay] Relaying \"%s\" (%s) from %s at frame %u.\n",
+               relay->info.core_name, relay->info.core_version,
+               connection->nick, relay->server_frame);
+         return true;
+
+      default:
+         return false;
+   }
+
+   netplay_recv_flush(&connection->recv_packet_buffer);
+   *had_input = true;
+   return true;
+
+shrt:
+   netplay_recv_reset(&connection->recv_packet_buffer);
+   return true;
+}
+
+/**
+ * relay_host_savestate
+ *
+ * Receive a NETPLAY_CMD_LOAD_SAVESTATE_DELTA or NETPLAY_CMD_KEYFRAME_DELTA
+ * chunk, or a whole NETPLAY_CMD_LOAD_SAVESTATE.
+ */
+static bool relay_host_savestate(netplay_relay_t *relay, uint32_t cmd,
+      uint32_t cmd_size, bool *had_input)
+{
+   uint32_t header[5];
+   uint32_t frame, id, isize, total, offset;
+   uint32_t rd, wn;
+   size_t len;
+   struct relay_state *state                   = NULL;
+   struct netplay_connection *connection       = &relay->host;
+   struct netplay_savestate_transfer *transfer = &relay->transfer;
+   struct compression_transcoder *ctrans       =
+      relay_ctrans(relay, connection->compression_supported);
+   ssize_t recvd;
+
+   if (!ctrans)
+      return false;
+
+   if (cmd == NETPLAY_CMD_LOAD_SAVESTATE)
+   {
+      if (cmd_size < 2 * sizeof(uint32_t))
+         return false;
+
+      RECV(header, 2 * sizeof(uint32_t))
+         return false;
+      frame = ntohl(header[0]);
+      isize = ntohl(header[1]);
+      len   = cmd_size - 2 * sizeof(uint32_t);
+
+      if (!relay_state_size(relay, isize))
+      {
+         RARCH_ERR("CMD_LOAD_SAVESTATE received an unexpected save state size.\n");
+         return false;
+      }
+
+      if (len > relay->zbuffer_size)
+      {
+         RARCH_ERR("CMD_LOAD_SAVESTATE received an unexpected payload size.\n");
+         return false;
+      }
+
+      RECV(relay->zbuffer, len)
+         return false;
+
+      /* Supersedes any diff still on its way */
+      relay_transfer_drop(relay);
+
+      if (!(state = relay_state_new(relay, frame)))
+         return false;
+
+      ctrans->decompression_backend->set_in(ctrans->decompression_stream,
+            relay->zbuffer, (uint32_t)len);
+      ctrans->decompression_backend->set_out(ctrans->decompression_stream,
+            state->data, (uint32_t)relay->state_size);
+      if (!ctrans->decompression_backend->trans(ctrans->decompression_stream,
+               true, &rd, &wn, NULL) ||
+          !relay_log_marker(relay, state, false))
+      {
+         relay_state_unref(state);
+         return false;
+      }
+
+      state->complete = true;
+      relay_keyframe_set(relay, state);
+      relay_state_unref(state);
+      goto done;
+   }
+
+   if (cmd_size < sizeof(header) ||
+       cmd_size > sizeof(header) + NETPLAY_SAVESTATE_CHUNK_SIZE)
+   {
+      RARCH_ERR("CMD_LOAD_SAVESTATE_DELTA received an unexpected payload size.\n");
+      return false;
+   }
+
+   RECV(header, sizeof(header))
+      return false;
+
+   frame  = ntohl(header[0]);
+   id     = ntohl(header[1]);
+   isize  = ntohl(header[2]);
+   total  = ntohl(header[3]);
+   offset = ntohl(header[4]);
+   len    = cmd_size - sizeof(header);
+
+   if (!offset)
+   {
+      if (!relay_state_size(relay, isize) || total > transfer->capacity)
+      {
+         RARCH_ERR("CMD_LOAD_SAVESTATE_DELTA received an oversized diff.\n");
+         return false;
+      }
+   }
+   else if (!transfer->pending ||
+         cmd    != transfer->cmd   ||
+         id     != transfer->id    ||
+         frame  != transfer->frame ||
+         total  != transfer->size  ||
+         offset != transfer->pos)
+   {
+      RARCH_ERR("CMD_LOAD_SAVESTATE_DELTA received a chunk out of order.\n");
+      return false;
+   }
+
+   if (isize != relay->state_size || len > total - offset)
+   {
+      RARCH_ERR("CMD_LOAD_SAVESTATE_DELTA received an unexpected save state size.\n");
+      return false;
+   }
+
+   RECV(transfer->data + offset, len)
+      return false;
+
+   if (!offset)
+   {
+      relay_transfer_drop(relay);
+
+      /* The first chunk is where the state belongs among the input */
+      if (!(relay->transfer_state = relay_state_new(relay, frame)) ||
+          !relay_log_marker(relay, relay->transfer_state,
+             cmd == NETPLAY_CMD_KEYFRAME_DELTA))
+         return false;
+
+      relay->transfer_marker_frame = relay->server_frame;
+      transfer->pending            = true;
+      transfer->cmd                = cmd;
+      transfer->id                 = id;
+      transfer->frame              = frame;
+      transfer->size               = total;
+      transfer->pos                = 0;
+   }
+   transfer->pos += len;
+
+   if (transfer->pos < transfer->size)
+      goto done;
+
+   /* That was the last chunk, so the host diffs against this state now */
+   transfer->pending     = false;
+   state                 = relay->transfer_state;
+   relay->transfer_state = NULL;
+
+   ctrans->decompression_backend->set_in(ctrans->decompression_stream,
+         transfer->data, (uint32_t)transfer->size);
+   ctrans->decompression_backend->set_out(ctrans->decompression_stream,
+         relay->diff,
+         (uint32_t)netplay_savestate_diff_maxsize(relay->state_size));
+   if (!ctrans->decompression_backend->trans(ctrans->decompression_stream,
+            true, &rd, &wn, NULL) ||
+       !netplay_savestate_patch(transfer->base, relay->state_size,
+          relay->diff, wn))
+   {
+      RARCH_ERR("CMD_LOAD_SAVESTATE_DELTA received a corrupt diff.\n");
+      state->dropped = true;
+      relay_state_unref(state);
+      return false;
+   }
+
+   memcpy(state->data, transfer->base, relay->state_size);
+   state->complete = true;
+
+   if (cmd == NETPLAY_CMD_KEYFRAME_DELTA &&
+       state->frame != relay->transfer_marker_frame &&
+       !relay->keyframes_misplaced)
+   {
+      RARCH_LOG("[netplay] The host runs ahead of its keyframes, so desynched "
+            "spectators will get savestates instead.\n");
+      relay->keyframes_misplaced = true;
+   }
+
+   relay_keyframe_set(relay, state);
+   relay_state_unref(state);
+
+done:
+   netplay_recv_flush(&connection->recv_packet_buffer);
+   *had_input = true;
+   return true;
+
+shrt:
+   netplay_recv_reset(&connection->recv_packet_buffer);
+   return true;
+}
+
+/**
+ * relay_host_cmd
+ *
+ * Receive a command from the host, and log it for our spectators if it's
+ * theirs too.
+ */
+static bool relay_host_cmd(netplay_relay_t *relay, bool *had_input)
+{
+   uint32_t cmd, cmd_size;
+   uint32_t payload[64];
+   ssize_t recvd;
+   struct netplay_connection *connection = &relay->host;
+   struct socket_buffer *sbuf            = &connection->recv_packet_buffer;
+
+   /* The handshake isn't a command */
+   if (connection->mode < NETPLAY_CONNECTION_CONNECTED)
+      return relay_host_handshake(relay, had_input);
+
+   RECV(&cmd, sizeof(cmd))
+      return false;
+   RECV(&cmd_size, sizeof(cmd_size))
+      return false;
+   cmd      = ntohl(cmd);
+   cmd_size = ntohl(cmd_size);
+
+   switch (cmd)
+   {
+      case NETPLAY_CMD_INPUT:
+      case NETPLAY_CMD_NOINPUT:
+      case NETPLAY_CMD_MODE:
+      case NETPLAY_CMD_PAUSE:
+      case NETPLAY_CMD_RESUME:
+      case NETPLAY_CMD_RESET:
+      case NETPLAY_CMD_CRC:
+      case NETPLAY_CMD_FRAME_HASH:
+         {
+            uint32_t frame;
+            uint32_t cmdbuf[2 + 64];
+
+            if (cmd_size > sizeof(payload) ||
+                (cmd == NETPLAY_CMD_INPUT && cmd_size < 2 * sizeof(uint32_t)) ||
+                (cmd == NETPLAY_CMD_NOINPUT && cmd_size != sizeof(uint32_t)) ||
+                (cmd == NETPLAY_CMD_MODE && cmd_size != 15 * sizeof(uint32_t)))
+            {
+               RARCH_ERR("[netplay] The host sent a command of unexpected size.\n");
+               return false;
+            }
+
+            if (cmd_size)
+            {
+               RECV(payload, cmd_size)
+                  return false;
+            }
+
+            if (cmd == NETPLAY_CMD_MODE)
+            {
+               size_t device;
+               uint32_t mode       = ntohl(payload[1]);
+               uint32_t devices    = ntohl(payload[2]);
+               uint32_t client_num = mode & 0xFFFF;
+
+               /* Only ever about us if the host wants us out */
+               if ((mode & NETPLAY_CMD_MODE_BIT_YOU) || client_num >= MAX_CLIENTS)
+                  break;
+
+               for (device = 0; device < MAX_INPUT_DEVICES; device++)
+               {
+                  if ((mode & NETPLAY_CMD_MODE_BIT_PLAYING) &&
+                      (devices & (1 << device)))
+                     relay->device_clients[device] |= 1 << client_num;
+                  else
+                     relay->device_clients[device] &= ~(1 << client_num);
+               }
+               memcpy(relay->share_modes, payload + 3,
+                     sizeof(relay->share_modes));
+            }
+            else if (cmd == NETPLAY_CMD_PAUSE)
+               relay->paused = true;
+            else if (cmd == NETPLAY_CMD_RESUME)
+               relay->paused = false;
+
+            if (!relay_log_cmd(relay, cmd, payload, cmd_size))
+               return false;
+
+            if (cmd == NETPLAY_CMD_NOINPUT)
+               relay_frame_done(relay, ntohl(payload[0]));
+            else if (cmd == NETPLAY_CMD_INPUT)
+            {
+               frame = ntohl(payload[0]);
+               if ((ntohl(payload[1]) & 0xFFFF) == 0)
+                  relay_frame_done(relay, frame);
+               else if (frame >= relay->server_frame)
+               {
+                  cmdbuf[0] = htonl(cmd);
+                  cmdbuf[1] = htonl(cmd_size);
+                  memcpy(cmdbuf + 2, payload, cmd_size);
+                  if (!relay_ahead_add(relay, cmdbuf,
+                           2 * sizeof(uint32_t) + cmd_size))
+                     return false;
+               }
+            }
+            break;
+         }
+
+      case NETPLAY_CMD_LOAD_SAVESTATE:
+      case NETPLAY_CMD_LOAD_SAVESTATE_DELTA:
+      case NETPLAY_CMD_KEYFRAME_DELTA:
+         return relay_host_savestate(relay, cmd, cmd_size, had_input);
+
+      case NETPLAY_CMD_NAK:
+      case NETPLAY_CMD_DISCONNECT:
+         return false;
+
+      default:
+         /* Nothing our spectators need (stalls, refusals, ...), but it
+          * has to fit our socket buffer all the same */
+         if (cmd_size + 2 * sizeof(uint32_t) >= sbuf->bufsz)
+         {
+            RARCH_ERR("[netplay] The host sent an oversized command.\n");
+            return false;
+         }
+         while (cmd_size)
+         {
+            uint32_t len = cmd_size > sizeof(payload) ?
+               sizeof(payload) : cmd_size;
+            RECV(payload, len)
+               return false;
+            cmd_size -= len;
+         }
+         break;
+   }
+
+   netplay_recv_flush(&connection->recv_packet_buffer);
+   *had_input = true;
+   return true;
+
+shrt:
+   netplay_recv_reset(&connection->recv_packet_buffer);
+   return true;
+}
+
+static void relay_viewer_hangup(netplay_relay_t *relay,
+      struct relay_viewer *viewer)
+{
+   struct netplay_connection *connection = &viewer->connection;
+
+   if (!connection->active)
+      return;
+
+   if (connection->mode >= NETPLAY_CONNECTION_CONNECTED)
+      RARCH_LOG("[netplay] Spectator \"%s\" left the relay.\n",
+            connection->nick);
+
+   netplay_poller_remove(&relay->poller, connection->fd);
+   socket_close(connection->fd);
+   netplay_deinit_socket_buffer(&connection->send_packet_buffer);
+   netplay_deinit_socket_buffer(&connection->recv_packet_buffer);
+   relay_state_unref(viewer->blob_state);
+   relay_state_unref(viewer->delta_base);
+   memset(viewer, 0, sizeof(*viewer));
+}
+
+/**
+ * relay_encoding_get
+ *
+ * Get a state ready to send the way a spectator takes it. Spectators
+ * taking diffs get them against the last state we sent them; each
+ * encoding is made once however many take it.
+ */
+static struct relay_encoding *relay_encoding_get(netplay_relay_t *relay,
+      struct relay_state *state, struct relay_viewer *viewer)
+{
+   uint32_t rd, wn;
+   struct relay_encoding *encoding;
+   struct netplay_connection *connection = &viewer->connection;
+   struct compression_transcoder *ctrans =
+      relay_ctrans(relay, connection->compression_supported);
+   bool delta                            = connection->savestate_delta;
+   uint32_t base_id                      = (delta && viewer->delta_base) ?
+      viewer->delta_base->id : 0;
+
+   for (encoding = state->encodings; encoding; encoding = encoding->next)
+      if (encoding->delta       == delta &&
+          encoding->base_id     == base_id &&
+          encoding->compression == connection->compression_supported)
+         return encoding;
+
+   if (!ctrans)
+      return NULL;
+
+   if (delta)
+   {
+      size_t diff_size = netplay_savestate_diff(
+            viewer->delta_base ? viewer->delta_base->data : relay->zeros,
+            state->data, relay->state_size, relay->diff, NULL);
+      ctrans->compression_backend->set_in(ctrans->compression_stream,
+            relay->diff, (uint32_t)diff_size);
+   }
+   else
+      ctrans->compression_backend->set_in(ctrans->compression_stream,
+            state->data, (uint32_t)relay->state_size);
+   ctrans->compression_backend->set_out(ctrans->compression_stream,
+         relay->scratch, (uint32_t)relay->scratch_size);
+   if (!ctrans->compression_backend->trans(ctrans->compression_stream, true,
+            &rd, &wn, NULL))
+      return NULL;
+
+   if (!(encoding = (struct relay_encoding*)calloc(1, sizeof(*encoding))))
+      return NULL;
+   encoding->delta       = delta;
+   encoding->base_id     = base_id;
+   encoding->compression = connection->compression_supported;
+
+   if (delta)
+   {
+      /* The chunks of a NETPLAY_CMD_LOAD_SAVESTATE_DELTA, back to back */
+      size_t pos;
+      size_t chunks = (wn + NETPLAY_SAVESTATE_CHUNK_SIZE - 1)
+         / NETPLAY_SAVESTATE_CHUNK_SIZE;
+      uint8_t *out;
+
+      if (!chunks)
+         chunks = 1;
+      encoding->size = wn + chunks * 7 * sizeof(uint32_t);
+      encoding->data = out = (uint8_t*)malloc(encoding->size);
+      if (!encoding->data)
+      {
+         free(encoding);
+         return NULL;
+      }
+
+      for (pos = 0; chunks--; )
+      {
+         uint32_t header[7];
+         size_t len = wn - pos;
+         if (len > NETPLAY_SAVESTATE_CHUNK_SIZE)
+            len = NETPLAY_SAVESTATE_CHUNK_SIZE;
+
+         header[0] = htonl(NETPLAY_CMD_LOAD_SAVESTATE_DELTA);
+         header[1] = htonl((uint32_t)(5 * sizeof(uint32_t) + len));
+         header[2] = htonl(state->frame);
+         header[3] = htonl(state->id);
+         header[4] = htonl((uint32_t)relay->state_size);
+         header[5] = htonl(wn);
+         header[6] = htonl((uint32_t)pos);
+         memcpy(out, header, sizeof(header));
+         memcpy(out + sizeof(header), relay->scratch + pos, len);
+         out += sizeof(header) + len;
+         pos += len;
+      }
+   }
+   else
+   {
+      uint32_t header[4];
+
+      header[0] = htonl(NETPLAY_CMD_LOAD_SAVESTATE);
+      header[1] = htonl(wn + 2 * sizeof(uint32_t));
+      header[2] = htonl(state->frame);
+      header[3] = htonl((uint32_t)relay->state_size);
+
+      encoding->size = sizeof(header) + wn;
+      encoding->data = (uint8_t*)malloc(encoding->size);
+      if (!encoding->data)
+      {
+         free(encoding);
+         return NULL;
+      }
+      memcpy(encoding->data, header, sizeof(header));
+      memcpy(encoding->data + sizeof(header), relay->scratch, wn);
+   }
+
+   encoding->next   = state->encodings;
+   state->encodings = encoding;
+   return encoding;
+}
+
+/* Queue a state for a spectator, after anything already queued */
+static bool relay_viewer_send_state(netplay_relay_t *relay,
+      struct relay_viewer *viewer, struct relay_state *state)
+{
+   struct relay_encoding *encoding = relay_encoding_get(relay, state, viewer);
+
+   if (!encoding)
+      return false;
+
+   viewer->blob        = encoding;
+   viewer->blob_state  = relay_state_ref(state);
+   viewer->blob_pos    = 0;
+   viewer->state_id    = state->id;
+   viewer->wants_state = false;
+
+   /* TCP won't drop it, so as far as the next diff is concerned they have
+    * it now */
+   if (viewer->connection.savestate_delta)
+   {
+      relay_state_unref(viewer->delta_base);
+      viewer->delta_base = relay_state_ref(state);
+   }
+
+   return true;
+}
+
+/**
+ * relay_viewer_start
+ *
+ * Start a spectator from the keyframe: sync info as of the keyframe, any
+ * input which was ahead of it, the keyframe itself, then the log.
+ */
+static void relay_viewer_start(netplay_relay_t *relay,
+      struct relay_viewer *viewer)
+{
+   struct netplay_connection *connection = &viewer->connection;
+   struct relay_boundary *start          = &relay->keyframe_at;
+   struct socket_buffer *sbuf            = &connection->send_packet_buffer;
+   size_t size                           = 2 * sizeof(uint32_t) +
+      NETPLAY_CMD_SYNC_MIN_SIZE + relay->sram_size + start->carry_size;
+
+   /* All of it has to fit, so we don't block on this one */
+   if (netplay_send_queued(sbuf) + size >= sbuf->bufsz &&
+       !netplay_resize_socket_buffer(sbuf, netplay_send_queued(sbuf) + size +
+          RELAY_BUFFER_SIZE))
+      goto error;
+
+   if (!netplay_protocol_send_sync(connection, start->frame,
+            relay->client_num |
+               (start->paused ? NETPLAY_CMD_SYNC_BIT_PAUSED : 0),
+            relay->config_devices, start->share_modes, start->device_clients,
+            relay->sram, relay->sram_size) ||
+       (start->carry_size && !netplay_send(sbuf, connection->fd,
+            start->carry, start->carry_size)))
+      goto error;
+
+   if (!relay_viewer_send_state(relay, viewer, relay->keyframe))
+      goto error;
+
+   connection->mode = NETPLAY_CONNECTION_SPECTATING;
+   viewer->cursor   = viewer->run_end = start->pos;
+
+   RARCH_LOG("[netplay] Spectator \"%s\" joined the relay at frame %u.\n",
+         connection->nick, start->frame);
+   return;
+
+error:
+   relay_viewer_hangup(relay, viewer);
+}
+
+/**
+ * relay_viewer_next
+ *
+ * Find what to send a spectator next from the log.
+ *
+ * Returns 1 if there's something, 0 if not yet, -1 on error.
+ */
+static int relay_viewer_next(netplay_relay_t *relay,
+      struct relay_viewer *viewer)
+{
+   uint32_t cmd, cmd_size;
+   size_t end                            = relay_log_end(relay);
+   bool frame_hash                       =
+      viewer->connection.protocol_version >=
+      NETPLAY_PROTOCOL_VERSION_FRAME_HASH;
+
+   while (viewer->cursor < end)
+   {
+      const uint8_t *payload = relay_log_entry(relay, viewer->cursor, &cmd,
+            &cmd_size);
+
+      if (cmd == RELAY_CMD_STATE)
+      {
+         struct relay_marker marker;
+         memcpy(&marker, payload, sizeof(marker));
+
+         if (marker.keyframe && !viewer->wants_state)
+            marker.state = NULL;
+         else if (!marker.state->complete && !marker.state->dropped)
+            return 0;
+
+         viewer->cursor += 2 * sizeof(uint32_t) + cmd_size;
+         viewer->run_end = viewer->cursor;
+
+         /* It has to land where the host's input was when it was sent */
+         if (     marker.state
+               && !marker.state->dropped
+               && marker.state->frame == marker.frame
+               && marker.state->id    != viewer->state_id)
+            return relay_viewer_send_state(relay, viewer, marker.state) ?
+               1 : -1;
+         continue;
+      }
+
+      /* Older spectators can't take frame hashes */
+      if (cmd == NETPLAY_CMD_FRAME_HASH && !frame_hash)
+      {
+         viewer->cursor += 2 * sizeof(uint32_t) + cmd_size;
+         viewer->run_end = viewer->cursor;
+         continue;
+      }
+
+      /* Everything up to the next command needing a look goes straight from
+       * the log */
+      viewer->run_end = viewer->cursor;
+      while (viewer->run_end < end)
+      {
+         relay_log_entry(relay, viewer->run_end, &cmd, &cmd_size);
+         if (cmd == RELAY_CMD_STATE ||
+             (cmd == NETPLAY_CMD_FRAME_HASH && !frame_hash))
+            break;
+         viewer->run_end += 2 * sizeof(uint32_t) + cmd_size;
+      }
+      return 1;
+   }
+
+   return 0;
+}
+
+/**
+ * relay_viewer_send
+ *
+ * Send a spectator as much as its socket takes.
+ *
+ * Returns false on socket failure.
+ */
+static bool relay_viewer_send(netplay_relay_t *relay,
+      struct relay_viewer *viewer)
+{
+   ssize_t sent;
+   struct netplay_connection *connection = &viewer->connection;
+
+   for (;;)
+   {
+      /* Handshake and replies go between whole commands */
+      if (!viewer->mid)
+      {
+         if (!netplay_send_flush(&connection->send_packet_buffer,
+                  connection->fd, false))
+            return false;
+         if (netplay_send_queued(&connection->send_packet_buffer))
+            return true;
+      }
+
+      if (viewer->blob)
+      {
+         sent = socket_send_all_nonblocking(connection->fd,
+               viewer->blob->data + viewer->blob_pos,
+               viewer->blob->size - viewer->blob_pos, true);
+         if (sent < 0)
+            return false;
+         viewer->blob_pos += sent;
+         if ((viewer->mid = viewer->blob_pos < viewer->blob->size))
+            return true;
+
+         relay_state_unref(viewer->blob_state);
+         viewer->blob_state = NULL;
+         viewer->blob       = NULL;
+         continue;
+      }
+
+      if (viewer->cursor < viewer->run_end)
+      {
+         sent = socket_send_all_nonblocking(connection->fd,
+               relay->log + (viewer->cursor - relay->log_base),
+               viewer->run_end - viewer->cursor, true);
+         if (sent < 0)
+            return false;
+         viewer->cursor += sent;
+         if ((viewer->mid = viewer->cursor < viewer->run_end))
+            return true;
+         continue;
+      }
+
+      if (connection->mode != NETPLAY_CONNECTION_SPECTATING)
+         return true;
+
+      switch (relay_viewer_next(relay, viewer))
+      {
+         case 0:
+            return true;
+         case -1:
+            return false;
+         default:
+            break;
+      }
+   }
+}
+
+/* Is anything waiting on a spectator's socket? */
+static bool relay_viewer_blocked(struct relay_viewer *viewer)
+{
+   return viewer->mid || viewer->blob || viewer->cursor < viewer->run_end ||
+      netplay_send_queued(&viewer->connection.send_packet_buffer);
+}
+
+/* Ask the host for a state on behalf of a desynched spectator */
+static void relay_request_state(netplay_relay_t *relay)
+{
+   uint32_t cmd = NETPLAY_CMD_REQUEST_SAVESTATE;
+
+   if (relay->server_frame - relay->state_request_frame <
+         RELAY_REQUEST_FRAMES)
+      return;
+
+   if (relay->host.protocol_version >= NETPLAY_PROTOCOL_VERSION_KEYFRAME &&
+       relay->host.savestate_delta && !relay->keyframes_misplaced)
+   {
+      cmd                           = NETPLAY_CMD_REQUEST_KEYFRAME;
+      relay->keyframe_request_frame = relay->server_frame;
+   }
+
+   relay->state_request_frame = relay->server_frame;
+   netplay_send_cmd(&relay->host.send_packet_buffer, relay->host.fd, cmd,
+         NULL, 0);
+}
+
+/**
+ * relay_viewer_cmd
+ *
+ * Receive the spectator's side of the handshake, or a command.
+ */
+static bool relay_viewer_cmd(netplay_relay_t *relay,
+      struct relay_viewer *viewer, bool *had_input)
+{
+   uint32_t cmd, cmd_size;
+   uint32_t payload[4];
+   ssize_t recvd;
+   struct netplay_connection *connection = &viewer->connection;
+
+   switch (connection->mode)
+   {
+      case NETPLAY_CONNECTION_INIT:
+         {
+            uint32_t header[6];
+
+            RECV(header, sizeof(header))
+               return false;
+
+            if (netplay_protocol_check_header(connection, header) ||
+                !netplay_protocol_send_nick(connection, relay->nick))
+               return false;
+
+            connection->mode = NETPLAY_CONNECTION_PRE_NICK;
+            break;
+         }
+
+      case NETPLAY_CONNECTION_PRE_NICK:
+      case NETPLAY_CONNECTION_PRE_PASSWORD:
+         {
+            if (connection->mode == NETPLAY_CONNECTION_PRE_NICK)
+            {
+               struct nick_buf_s nick_buf;
+
+               RECV(&nick_buf, sizeof(nick_buf))
+                  return false;
+               if (ntohl(nick_buf.cmd[0]) != NETPLAY_CMD_NICK ||
+                   ntohl(nick_buf.cmd[1]) != sizeof(nick_buf.nick))
+                  return false;
+               nick_buf.nick[sizeof(nick_buf.nick) - 1] = '\0';
+               strlcpy(connection->nick, nick_buf.nick,
+                     sizeof(connection->nick));
+
+               if (connection->salt)
+               {
+                  connection->mode = NETPLAY_CONNECTION_PRE_PASSWORD;
+                  break;
+               }
+            }
+            else
+            {
+               struct password_buf_s password_buf;
+
+               RECV(&password_buf, sizeof(password_buf))
+                  return false;
+               if (ntohl(password_buf.cmd[0]) != NETPLAY_CMD_PASSWORD ||
+                   ntohl(password_buf.cmd[1]) !=
+                     sizeof(password_buf.password) ||
+                   !netplay_protocol_check_password(connection,
+                     password_buf.password, relay->password))
+                  return false;
+            }
+
+            /* Tell them what the host would have */
+            if (!netplay_send(&connection->send_packet_buffer, connection->fd,
+                     &relay->info, sizeof(relay->info)))
+               return false;
+            connection->mode = NETPLAY_CONNECTION_PRE_INFO;
+            break;
+         }
+
+      case NETPLAY_CONNECTION_PRE_INFO:
+         {
+            struct info_buf_s info_buf;
+
+            RECV(&info_buf, sizeof(info_buf))
+               return false;
+            if (ntohl(info_buf.cmd[0]) != NETPLAY_CMD_INFO ||
+                ntohl(info_buf.cmd[1]) !=
+                  sizeof(info_buf) - sizeof(info_buf.cmd))
+               return false;
+
+            if (strncmp(info_buf.core_name, relay->info.core_name,
+                     sizeof(info_buf.core_name)))
+            {
+               RARCH_WARN("[netplay] Turned away a spectator with the wrong core.\n");
+               return false;
+            }
+
+            connection->mode = NETPLAY_CONNECTION_PRE_SYNC;
+            if (relay->keyframe)
+               relay_viewer_start(relay, viewer);
+            break;
+         }
+
+      default:
+         RECV(&cmd, sizeof(cmd))
+            return false;
+         RECV(&cmd_size, sizeof(cmd_size))
+            return false;
+         cmd      = ntohl(cmd);
+         cmd_size = ntohl(cmd_size);
+
+         switch (cmd)
+         {
+            case NETPLAY_CMD_ACK:
+            case NETPLAY_CMD_RESUME:
+               break;
+
+            case NETPLAY_CMD_PAUSE:
+               {
+                  char nick[NETPLAY_NICK_LEN];
+                  if (cmd_size != sizeof(nick))
+                     return false;
+                  /* Spectators can't pause anyone */
+                  RECV(nick, sizeof(nick))
+                     return false;
+                  break;
+               }
+
+            case NETPLAY_CMD_PLAY:
+               if (cmd_size != sizeof(uint32_t))
+                  return false;
+               RECV(payload, sizeof(uint32_t))
+                  return false;
+               payload[0] = htonl(NETPLAY_CMD_MODE_REFUSED_REASON_UNPRIVILEGED);
+               if (!netplay_send_cmd(&connection->send_packet_buffer,
+                        connection->fd, NETPLAY_CMD_MODE_REFUSED, payload,
+                        sizeof(uint32_t)))
+                  return false;
+               break;
+
+            case NETPLAY_CMD_REQUEST_SAVESTATE:
+               if (cmd_size)
+                  return false;
+               viewer->wants_state = true;
+               relay_request_state(relay);
+               break;
+
+            case NETPLAY_CMD_REQUEST_FRAME_HASHES:
+               if (cmd_size != 3 * sizeof(uint32_t))
+                  return false;
+               RECV(payload, 3 * sizeof(uint32_t))
+                  return false;
+               /* No hashes: we don't have the frame */
+               payload[3] = 0;
+               if (!netplay_send_cmd(&connection->send_packet_buffer,
+                        connection->fd, NETPLAY_CMD_FRAME_HASHES, payload,
+                        sizeof(payload)))
+                  return false;
+               break;
+
+            case NETPLAY_CMD_DISCONNECT:
+               return false;
+
+            default:
+               /* Spectators have nothing else to say, and we can't pass on
+                * keyframes to a relay of our own */
+               netplay_send_cmd(&connection->send_packet_buffer,
+                     connection->fd, NETPLAY_CMD_NAK, NULL, 0);
+               return false;
+         }
+         break;
+   }
+
+   netplay_recv_flush(&connection->recv_packet_buffer);
+   *had_input = true;
+   return true;
+
+shrt:
+   netplay_recv_reset(&connection->recv_packet_buffer);
+   return true;
+}
+
+#undef RECV
+
+static void relay_accept(netplay_relay_t *relay)
+{
+   for (;;)
+   {
+      size_t i;
+      uint32_t header[6];
+      struct relay_viewer *viewer;
+      struct netplay_connection *connection;
+      int fd = accept(relay->listen_fd, NULL, NULL);
+
+      if (fd < 0)
+      {
+         if (!isagain(fd))
+            RARCH_ERR("%s\n", msg_hash_to_str(MSG_NETPLAY_FAILED));
+         relay->listen_readable = false;
+         return;
+      }
+
+      if (!socket_nonblock(fd))
+      {
+         socket_close(fd);
+         continue;
+      }
+      relay_set_socket_options(fd);
+
+      for (i = 0; i < relay->viewers_size; i++)
+         if (!relay->viewers[i].connection.active)
+            break;
+      if (i == relay->viewers_size)
+      {
+         size_t size                  = relay->viewers_size ?
+            relay->viewers_size * 2 : 16;
+         struct relay_viewer *viewers = (struct relay_viewer*)
+            realloc(relay->viewers, size * sizeof(*viewers));
+         if (!viewers)
+         {
+            socket_close(fd);
+            continue;
+         }
+         memset(viewers + relay->viewers_size, 0,
+               (size - relay->viewers_size) * sizeof(*viewers));
+         relay->viewers      = viewers;
+         relay->viewers_size = size;
+      }
+
+      viewer     = &relay->viewers[i];
+      connection = &viewer->connection;
+      memset(viewer, 0, sizeof(*viewer));
+      connection->active   = true;
+      connection->fd       = fd;
+      connection->mode     = NETPLAY_CONNECTION_INIT;
+      connection->readable = true;
+
+      if (!netplay_init_socket_buffer(&connection->send_packet_buffer,
+               RELAY_BUFFER_SIZE) ||
+          !netplay_init_socket_buffer(&connection->recv_packet_buffer,
+               RELAY_BUFFER_SIZE) ||
+          !netplay_poller_add(&relay->poller, fd, RELAY_TAG_VIEWER + i))
+      {
+         netplay_deinit_socket_buffer(&connection->send_packet_buffer);
+         netplay_deinit_socket_buffer(&connection->recv_packet_buffer);
+         memset(viewer, 0, sizeof(*viewer));
+         socket_close(fd);
+         continue;
+      }
+
+      /* Demand our password too */
+      if (relay->password[0])
+      {
+         connection->salt = (uint32_t)rand() << 16 ^ (uint32_t)rand();
+         if (!connection->salt)
+            connection->salt = 1;
+      }
+
+      netplay_protocol_header(header, connection->salt);
+      if (!netplay_send(&connection->send_packet_buffer, fd, header,
+               sizeof(header)))
+         relay_viewer_hangup(relay, viewer);
+   }
+}
+
+/**
+ * relay_prune
+ *
+ * Forget the log nobody needs anymore: before the keyframe, and before the
+ * slowest spectator, who is dropped if too far behind.
+ */
+static void relay_prune(netplay_relay_t *relay)
+{
+   size_t i, floor, cut;
+   uint32_t cmd, cmd_size;
+   size_t end = relay_log_end(relay);
+
+   /* Without a keyframe, the one coming may be for any frame we know */
+   if (relay->keyframe && end - relay->keyframe_at.pos > 2 * RELAY_LOG_LIMIT)
+   {
+      RARCH_WARN("[netplay] No keyframe for too long, spectators must wait "
+            "for the next one.\n");
+      relay_state_unref(relay->keyframe);
+      relay_boundary_clear(&relay->keyframe_at);
+      relay->keyframe = NULL;
+   }
+   floor = end;
+   if (relay->keyframe)
+      floor = relay->keyframe_at.pos;
+   else
+   {
+      for (i = 0; i < RELAY_BOUNDARIES; i++)
+         if (relay->boundaries[i].valid &&
+             relay->boundaries[i].pos >= relay->log_base &&
+             relay->boundaries[i].pos < floor)
+            floor = relay->boundaries[i].pos;
+   }
+
+   for (i = 0; i < relay->viewers_size; i++)
+   {
+      struct relay_viewer *viewer = &relay->viewers[i];
+      if (!viewer->connection.active ||
+          viewer->connection.mode != NETPLAY_CONNECTION_SPECTATING)
+         continue;
+
+      if (end - viewer->cursor > RELAY_LOG_LIMIT)
+      {
+         RARCH_WARN("[netplay] Spectator \"%s\" fell too far behind.\n",
+               viewer->connection.nick);
+         relay_viewer_hangup(relay, viewer);
+         continue;
+      }
+      if (viewer->cursor < floor)
+         floor = viewer->cursor;
+   }
+
+   if (floor - relay->log_base < RELAY_BUFFER_SIZE)
+      return;
+
+   /* Cut between commands, letting go of the states marked */
+   for (cut = relay->log_base; cut < end; )
+   {
+      const uint8_t *payload = relay_log_entry(relay, cut, &cmd, &cmd_size);
+      size_t next            = cut + 2 * sizeof(uint32_t) + cmd_size;
+
+      if (next > floor)
+         break;
+      if (cmd == RELAY_CMD_STATE)
+      {
+         struct relay_marker marker;
+         memcpy(&marker, payload, sizeof(marker));
+         relay_state_unref(marker.state);
+      }
+      cut = next;
+   }
+
+   memmove(relay->log, relay->log + (cut - relay->log_base), end - cut);
+   relay->log_size = end - cut;
+   relay->log_base = cut;
+}
+
+static void relay_poll_event(void *data, size_t tag)
+{
+   netplay_relay_t *relay = (netplay_relay_t*)data;
+
+   if (tag == RELAY_TAG_LISTEN)
+      relay->listen_readable = true;
+   else if (tag == RELAY_TAG_HOST)
+      relay->host.readable = true;
+   else if (tag - RELAY_TAG_VIEWER < relay->viewers_size)
+      relay->viewers[tag - RELAY_TAG_VIEWER].connection.readable = true;
+}
+
+/**
+ * netplay_relay_poll
+ *
+ * Forward whatever the host sent, and serve the spectators.
+ */
+bool netplay_relay_poll(netplay_relay_t *relay, int timeout_ms)
+{
+   size_t i;
+   bool had_input;
+
+   /* We only hear when sockets are readable, so a spectator whose socket
+    * was full is tried again soon */
+   for (i = 0; timeout_ms && i < relay->viewers_size; i++)
+      if (relay->viewers[i].connection.active &&
+          relay_viewer_blocked(&relay->viewers[i]))
+      {
+         timeout_ms = 1;
+         break;
+      }
+
+   netplay_poller_wait(&relay->poller, timeout_ms, relay_poll_event, relay);
+
+   if (relay->listen_readable)
+      relay_accept(relay);
+
+   while (relay->host.readable)
+   {
+      had_input = false;
+      if (!relay_host_cmd(relay, &had_input))
+      {
+         RARCH_LOG("[netplay] %s\n",
+               msg_hash_to_str(MSG_NETPLAY_SERVER_HANGUP));
+         return false;
+      }
+      if (!had_input)
+         relay->host.readable = false;
+   }
+
+   /* Nobody can join us before we've joined the host */
+   if (relay->host.mode < NETPLAY_CONNECTION_CONNECTED)
+      return netplay_send_flush(&relay->host.send_packet_buffer,
+            relay->host.fd, false);
+
+   for (i = 0; i < relay->viewers_size; i++)
+   {
+      struct relay_viewer *viewer = &relay->viewers[i];
+
+      while (viewer->connection.active && viewer->connection.readable)
+      {
+         had_input = false;
+         if (!relay_viewer_cmd(relay, viewer, &had_input))
+            relay_viewer_hangup(relay, viewer);
+         else if (!had_input)
+            viewer->connection.readable = false;
+      }
+   }
+
+   /* Keep a recent keyframe for whoever joins next */
+   if (relay->keyframe_interval &&
+       relay->server_frame - relay->keyframe_request_frame >=
+         relay->keyframe_interval)
+   {
+      relay->keyframe_request_frame = relay->server_frame;
+      if (relay->host.protocol_version >= NETPLAY_PROTOCOL_VERSION_KEYFRAME &&
+          relay->host.savestate_delta)
+         netplay_send_cmd(&relay->host.send_packet_buffer, relay->host.fd,
+               NETPLAY_CMD_REQUEST_KEYFRAME, NULL, 0);
+   }
+
+   /* A host without keyframes has to be asked for a savestate everyone
+    * loads, but only when we'd otherwise keep too much log */
+   if ((relay->host.protocol_version < NETPLAY_PROTOCOL_VERSION_KEYFRAME ||
+        !relay->host.savestate_delta) &&
+       relay_log_end(relay) - (relay->keyframe ?
+          relay->keyframe_at.pos : relay->log_base) > RELAY_LOG_LIMIT / 2)
+      relay_request_state(relay);
+
+   if (!netplay_send_flush(&relay->host.send_packet_buffer, relay->host.fd,
+            false))
+      return false;
+
+   for (i = 0; i < relay->viewers_size; i++)
+   {
+      struct relay_viewer *viewer = &relay->viewers[i];
+      if (viewer->connection.active && !relay_viewer_send(relay, viewer))
+         relay_viewer_hangup(relay, viewer);
+   }
+
+   relay_prune(relay);
+   return true;
+}
+
+/**
+ * netplay_relay_new
+ *
+ * Connect to the host and open the port for spectators. Joining the host
+ * and serving them is left to netplay_relay_poll.
+ */
+netplay_relay_t *netplay_relay_new(const char *server, uint16_t server_port,
+      uint16_t port, const char *nick, const char *password,
+      unsigned keyframe_interval)
+{
+   uint32_t header[6];
+   netplay_relay_t *relay = NULL;
+
+   if (!network_init())
+      return NULL;
+
+   relay = (netplay_relay_t*)calloc(1, sizeof(*relay));
+   if (!relay)
+      return NULL;
+
+   relay->listen_fd         = -1;
+   relay->host.fd           = -1;
+   relay->keyframe_interval = keyframe_interval;
+   strlcpy(relay->nick, nick && *nick ? nick : RARCH_DEFAULT_NICK,
+         sizeof(relay->nick));
+   if (password)
+      strlcpy(relay->password, password, sizeof(relay->password));
+
+   if ((relay->host.fd = relay_socket(server, server_port)) < 0)
+   {
+      RARCH_ERR("%s\n", msg_hash_to_str(MSG_NETPLAY_FAILED));
+      goto error;
+   }
+   relay->host.active = true;
+   relay->host.mode   = NETPLAY_CONNECTION_INIT;
+
+   if (!socket_nonblock(relay->host.fd) ||
+       !netplay_init_socket_buffer(&relay->host.send_packet_buffer,
+          RELAY_BUFFER_SIZE) ||
+       !netplay_init_socket_buffer(&relay->host.recv_packet_buffer,
+          RELAY_BUFFER_SIZE))
+      goto error;
+
+   /* The first part of the handshake, as netplay_handshake_init_send */
+   netplay_protocol_header(header, 0);
+   if (!netplay_send(&relay->host.send_packet_buffer, relay->host.fd, header,
+            sizeof(header)) ||
+       !netplay_send_flush(&relay->host.send_packet_buffer, relay->host.fd,
+          false))
+      goto error;
+
+   if ((relay->listen_fd = relay_socket(NULL, port)) < 0 ||
+       !socket_nonblock(relay->listen_fd))
+   {
+      RARCH_ERR("Failed to set up netplay sockets.\n");
+      goto error;
+   }
+
+   /* The listening socket is only watched once we've joined the host */
+   if (!netplay_poller_init(&relay->poller, NULL) ||
+       !netplay_poller_add(&relay->poller, relay->host.fd, RELAY_TAG_HOST))
+      goto error;
+
+   RARCH_LOG("[netplay] Serving spectators on port %hu.\n",
+         (unsigned short)port);
+   return relay;
+
+error:
+   netplay_relay_free(relay);
+   return NULL;
+}
+
+/**
+ * netplay_relay_free
+ *
+ * Disconnect everyone and free the relay.
+ */
+void netplay_relay_free(netplay_relay_t *relay)
+{
+   size_t i, pos;
+
+   if (!relay)
+      return;
+
+   for (i = 0; i < relay->viewers_size; i++)
+      relay_viewer_hangup(relay, &relay->viewers[i]);
+   free(relay->viewers);
+
+   netplay_poller_deinit(&relay->poller);
+   if (relay->listen_fd >= 0)
+      socket_close(relay->listen_fd);
+   if (relay->host.fd >= 0)
+      socket_close(relay->host.fd);
+   netplay_deinit_socket_buffer(&relay->host.send_packet_buffer);
+   netplay_deinit_socket_buffer(&relay->host.recv_packet_buffer);
+
+   /* Let go of the states still marked in the log */
+   for (pos = relay->log_base; pos < relay_log_end(relay); )
+   {
+      uint32_t cmd, cmd_size;
+      const uint8_t *payload = relay_log_entry(relay, pos, &cmd, &cmd_size);
+      if (cmd == RELAY_CMD_STATE)
+      {
+         struct relay_marker marker;
+         memcpy(&marker, payload, sizeof(marker));
+         relay_state_unref(marker.state);
+      }
+      pos += 2 * sizeof(uint32_t) + cmd_size;
+   }
+   free(relay->log);
+
+   relay_transfer_drop(relay);
+   free(relay->transfer.base);
+   free(relay->transfer.data);
+   relay_state_unref(relay->keyframe);
+   relay_boundary_clear(&relay->keyframe_at);
+   for (i = 0; i < RELAY_BOUNDARIES; i++)
+      relay_boundary_clear(&relay->boundaries[i]);
+
+   relay_ctrans_free(&relay->compress_nil);
+   relay_ctrans_free(&relay->compress_zlib);
+
+   free(relay->ahead);
+   free(relay->zbuffer);
+   free(relay->sram);
+   free(relay->zeros);
+   free(relay->diff);
+   free(relay->scratch);
+   free(relay);
+}
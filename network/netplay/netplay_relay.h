@@ -0,0 +1,71 @@
+/*  RetroArch - A frontend for libretro.
+ *  Copyright (C) 2016-2017 - Gregor Richards
+ *
+ *  RetroArch is free software: you can redistribute it and/or modify it under the terms
+ *  of the GNU General Public License as published by the Free Software Found-
+ *  ation, either version 3 of the License, or (at your option) any later version.
+ *
+ *  RetroArch is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ *  PURPOSE.  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with RetroArch.
+ *  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __RARCH_NETPLAY_RELAY_H
+#define __RARCH_NETPLAY_RELAY_H
+
+#include <stdint.h>
+
+#include <boolean.h>
+#include <retro_common_api.h>
+
+RETRO_BEGIN_DECLS
+
+/* A relay joins a netplay host as a spectator and serves its input stream
+ * to any number of spectators of its own, without running a core. Each
+ * spectator starts from the last keyframe (a savestate the host sends only
+ * to the relay) and the input logged since. */
+typedef struct netplay_relay netplay_relay_t;
+
+/**
+ * netplay_relay_new:
+ * @server               : host to relay.
+ * @server_port          : its netplay port.
+ * @port                 : port to serve spectators on.
+ * @nick                 : our nickname.
+ * @password             : password for the host, which our spectators must
+ *                         give too. May be NULL.
+ * @keyframe_interval    : frames between keyframes.
+ *
+ * Connects to the host. The rest of joining it, like everything else,
+ * happens in netplay_relay_poll, so nothing here waits on the host.
+ *
+ * Returns: the relay, or NULL on failure.
+ **/
+netplay_relay_t *netplay_relay_new(const char *server, uint16_t server_port,
+      uint16_t port, const char *nick, const char *password,
+      unsigned keyframe_interval);
+
+/**
+ * netplay_relay_poll:
+ * @relay                : relay to run.
+ * @timeout_ms           : longest to wait for the network, 0 to only
+ *                         take what has come in already.
+ *
+ * Joins the host, forwards whatever it sent, and serves the spectators.
+ *
+ * Returns: false once the host is gone.
+ **/
+bool netplay_relay_poll(netplay_relay_t *relay, int timeout_ms);
+
+/**
+ * netplay_relay_free:
+ * @relay                : relay to disconnect and free.
+ **/
+void netplay_relay_free(netplay_relay_t *relay);
+
+RETRO_END_DECLS
+
+#endif
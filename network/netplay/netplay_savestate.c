@@ -0,0 +1,96 @@
+/*  RetroArch - A frontend for libretro.
+ *  Copyright (C) 2016-2017 - Gregor Richards
+ *
+ *  RetroArch is free software: you can redistribute it and/or modify it under the terms
+ *  of the GNU General Public License as published by the Free Software Found-
+ *  ation, either version 3 of the License, or (at your option) any later version.
+ *
+ *  RetroArch is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ *  PURPOSE.  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with RetroArch.
+ *  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "netplay_savestate.h"
+
+#define NETPLAY_SAVESTATE_BLOCKS(size) \
+   (((size) + NETPLAY_SAVESTATE_BLOCK_SIZE - 1) / NETPLAY_SAVESTATE_BLOCK_SIZE)
+
+size_t netplay_savestate_diff_maxsize(size_t size)
+{
+   return (NETPLAY_SAVESTATE_BLOCKS(size) + 7) / 8 + size;
+}
+
+size_t netplay_savestate_diff(const uint8_t *base, const uint8_t *state,
+      size_t size, uint8_t *diff, size_t *changed)
+{
+   size_t i;
+   size_t num_blocks  = NETPLAY_SAVESTATE_BLOCKS(size);
+   size_t map_size    = (num_blocks + 7) / 8;
+   uint8_t *out       = diff + map_size;
+   size_t num_changed = 0;
+
+   memset(diff, 0, map_size);
+
+   for (i = 0; i < num_blocks; i++)
+   {
+      size_t j;
+      size_t offset = i * NETPLAY_SAVESTATE_BLOCK_SIZE;
+      size_t len    = size - offset;
+
+      if (len > NETPLAY_SAVESTATE_BLOCK_SIZE)
+         len = NETPLAY_SAVESTATE_BLOCK_SIZE;
+
+      if (!memcmp(base + offset, state + offset, len))
+         continue;
+
+      diff[i / 8] |= 1 << (i % 8);
+      for (j = 0; j < len; j++)
+         out[j] = base[offset + j] ^ state[offset + j];
+      out += len;
+      num_changed++;
+   }
+
+   if (changed)
+      *changed = num_changed;
+
+   return out - diff;
+}
+
+bool netplay_savestate_patch(uint8_t *base, size_t size,
+      const uint8_t *diff, size_t diff_size)
+{
+   size_t i;
+   size_t num_blocks  = NETPLAY_SAVESTATE_BLOCKS(size);
+   size_t map_size    = (num_blocks + 7) / 8;
+   const uint8_t *in  = diff + map_size;
+   const uint8_t *end = diff + diff_size;
+
+   if (diff_size < map_size)
+      return false;
+
+   for (i = 0; i < num_blocks; i++)
+   {
+      size_t j;
+      size_t offset = i * NETPLAY_SAVESTATE_BLOCK_SIZE;
+      size_t len    = size - offset;
+
+      if (!(diff[i / 8] & (1 << (i % 8))))
+         continue;
+
+      if (len > NETPLAY_SAVESTATE_BLOCK_SIZE)
+         len = NETPLAY_SAVESTATE_BLOCK_SIZE;
+      if ((size_t)(end - in) < len)
+         return false;
+
+      for (j = 0; j < len; j++)
+         base[offset + j] ^= in[j];
+      in += len;
+   }
+
+   return in == end;
+}
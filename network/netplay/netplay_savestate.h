@@ -0,0 +1,84 @@
+/*  RetroArch - A frontend for libretro.
+ *  Copyright (C) 2016-2017 - Gregor Richards
+ *
+ *  RetroArch is free software: you can redistribute it and/or modify it under the terms
+ *  of the GNU General Public License as published by the Free Software Found-
+ *  ation, either version 3 of the License, or (at your option) any later version.
+ *
+ *  RetroArch is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ *  PURPOSE.  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with RetroArch.
+ *  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __RARCH_NETPLAY_SAVESTATE_H
+#define __RARCH_NETPLAY_SAVESTATE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <boolean.h>
+#include <retro_common_api.h>
+
+RETRO_BEGIN_DECLS
+
+/* Savestates sent with NETPLAY_COMPRESSION_DELTA are diffed against the
+ * last state the peer received, in blocks of this many bytes */
+#define NETPLAY_SAVESTATE_BLOCK_SIZE   256
+
+/* The (compressed) diff is sent in chunks of at most this many bytes, so
+ * that input keeps flowing while a state is in transit */
+#define NETPLAY_SAVESTATE_CHUNK_SIZE   16384
+
+/* Most chunks queued per connection each time we send input */
+#define NETPLAY_SAVESTATE_CHUNKS_PER_SEND 4
+
+/* Diff format: */
+#if 0
+{
+   uint8 changed[(num_blocks + 7) / 8]; /* bit i set: block i changed */
+   uint8 blocks[];                      /* changed blocks, XORed with the
+                                           base state, in order; the last
+                                           block may be short */
+}
+#endif
+
+/**
+ * netplay_savestate_diff_maxsize:
+ * @size                 : savestate size in bytes.
+ *
+ * Returns: the largest diff netplay_savestate_diff() can produce.
+ **/
+size_t netplay_savestate_diff_maxsize(size_t size);
+
+/**
+ * netplay_savestate_diff:
+ * @base                 : state the receiver already has.
+ * @state                : state to send.
+ * @size                 : size of both states in bytes.
+ * @diff                 : output, netplay_savestate_diff_maxsize() bytes.
+ * @changed              : number of changed blocks, may be NULL.
+ *
+ * Returns: the number of bytes written to @diff.
+ **/
+size_t netplay_savestate_diff(const uint8_t *base, const uint8_t *state,
+      size_t size, uint8_t *diff, size_t *changed);
+
+/**
+ * netplay_savestate_patch:
+ * @base                 : state to patch in place.
+ * @size                 : size of @base in bytes.
+ * @diff                 : diff from netplay_savestate_diff().
+ * @diff_size            : size of @diff in bytes.
+ *
+ * Returns: true if @diff was well formed for a state of @size bytes,
+ * in which case @base now holds the sent state.
+ **/
+bool netplay_savestate_patch(uint8_t *base, size_t size,
+      const uint8_t *diff, size_t diff_size);
+
+RETRO_END_DECLS
+
+#endif
@@ -508,20 +508,32 @@ bool netplay_resolve_input(netplay_t *netplay, size_t sim_ptr, bool resim)
 static void netplay_handle_frame_hash(netplay_t *netplay,
       struct delta_frame *delta)
 {
+   /* Until a savestate in transit is loaded, our CRCs mean nothing */
+   if (netplay_savestate_receiving(netplay))
+      return;
+
    if (netplay->is_server)
    {
       if (netplay->check_frames &&
           delta->frame % abs(netplay->check_frames) == 0)
       {
-         delta->crc = netplay_delta_frame_crc(netplay, delta);
-         netplay_cmd_crc(netplay, delta);
+         /* A replayed frame has a new state */
+         delta->have_crc  = false;
+         delta->have_hash = false;
+         netplay_cmd_frame_hash(netplay, delta);
       }
    }
-   else if (delta->crc && netplay->crcs_valid)
+   else if ((delta->have_hash || delta->have_crc) && netplay->crcs_valid)
    {
-      /* We have a remote CRC, so check it */
-      uint32_t local_crc = netplay_delta_frame_crc(netplay, delta);
-      if (local_crc != delta->crc)
+      /* We have a remote hash (or CRC from an older server), so check it */
+      bool match;
+
+      if (delta->have_hash)
+         match = netplay_delta_frame_check_hash(netplay, delta, delta->hash);
+      else
+         match = netplay_delta_frame_crc(netplay, delta) == delta->crc;
+
+      if (!match)
       {
          /* If the very first check frame is wrong,
           * they probably just don't work */
@@ -529,6 +541,9 @@ static void netplay_handle_frame_hash(netplay_t *netplay,
             netplay->crcs_valid = false;
          else if (netplay->crcs_valid)
          {
+            /* Find out where, if we can */
+            netplay_frame_hash_desync(netplay, delta);
+
             /* Fix this! */
             if (netplay->check_frames < 0)
             {
@@ -544,6 +559,36 @@ static void netplay_handle_frame_hash(netplay_t *netplay,
    }
 }
 
+/**
+ * netplay_send_keyframes
+ *
+ * Send the state just stored to every relay which asked for a keyframe and
+ * isn't still receiving the last one.
+ */
+static void netplay_send_keyframes(netplay_t *netplay)
+{
+   size_t i;
+   const void *state = netplay_delta_frame_state(netplay, netplay->run_ptr);
+
+   if (!state)
+      return;
+
+   for (i = 0; i < netplay->connections_size; i++)
+   {
+      struct netplay_connection *connection = &netplay->connections[i];
+      if (!connection->active ||
+          connection->mode < NETPLAY_CONNECTION_CONNECTED ||
+          !connection->keyframe_requested ||
+          connection->savestate_out.pending)
+         continue;
+
+      connection->keyframe_requested = false;
+      if (!netplay_send_savestate_delta(netplay, connection,
+            NETPLAY_CMD_KEYFRAME_DELTA, state, netplay->state_size, netplay->run_frame_count))
+         netplay_hangup(netplay, connection);
+   }
+}
+
 /**
  * netplay_sync_pre_frame
  * @netplay              : pointer to netplay object
@@ -558,37 +603,47 @@ bool netplay_sync_pre_frame(netplay_t *netplay)
             &netplay->buffer[netplay->run_ptr], netplay->run_frame_count))
    {
       serial_info.data_const = NULL;
-      serial_info.data       = netplay->buffer[netplay->run_ptr].state;
+      serial_info.data       = netplay_delta_frame_state_buffer(netplay);
       serial_info.size       = netplay->state_size;
 
-      memset(serial_info.data, 0, serial_info.size);
+      if (serial_info.data)
+         memset(serial_info.data, 0, serial_info.size);
       if ((netplay->quirks & NETPLAY_QUIRK_INITIALIZATION)
             || netplay->run_frame_count == 0)
       {
          /* Don't serialize until it's safe */
       }
       else if (!(netplay->quirks & NETPLAY_QUIRK_NO_SAVESTATES)
-            && core_serialize(&serial_info))
+            && savestate_pool_serialize_to(serial_info.data,
+               serial_info.size, false))
       {
-         if (netplay->force_send_savestate && !netplay->stall
-               && !netplay->remote_paused)
+         bool send_savestate = netplay->force_send_savestate
+            && !netplay->stall && !netplay->remote_paused;
+
+         /* Bring our running frame and input frames into
+          * parity so we don't send old info. */
+         if (send_savestate && netplay->run_ptr != netplay->self_ptr)
          {
-            /* Bring our running frame and input frames into
-             * parity so we don't send old info. */
-            if (netplay->run_ptr != netplay->self_ptr)
+            netplay->run_ptr         = netplay->self_ptr;
+            netplay->run_frame_count = netplay->self_frame_count;
+         }
+
+         netplay_delta_frame_store_state(netplay, netplay->run_ptr);
+
+         if (send_savestate)
+         {
+            /* Send this along to the other side. If it can't be read
+             * back, leave the request pending for the next frame. */
+            serial_info.data_const = netplay_delta_frame_state(netplay,
+                  netplay->run_ptr);
+            if (serial_info.data_const)
             {
-               memcpy(netplay->buffer[netplay->self_ptr].state,
-                  netplay->buffer[netplay->run_ptr].state,
-                  netplay->state_size);
-               netplay->run_ptr         = netplay->self_ptr;
-               netplay->run_frame_count = netplay->self_frame_count;
+               netplay_load_savestate(netplay, &serial_info, false);
+               netplay->force_send_savestate = false;
             }
-
-            /* Send this along to the other side */
-            serial_info.data_const = netplay->buffer[netplay->run_ptr].state;
-            netplay_load_savestate(netplay, &serial_info, false);
-            netplay->force_send_savestate = false;
          }
+         else if (netplay->is_server)
+            netplay_send_keyframes(netplay);
       }
       else
       {
@@ -609,8 +664,6 @@ bool netplay_sync_pre_frame(netplay_t *netplay)
 
    if (netplay->is_server)
    {
-      fd_set fds;
-      struct timeval tmp_tv = {0};
       int new_fd;
       struct sockaddr_storage their_addr;
       socklen_t addr_size;
@@ -618,11 +671,8 @@ bool netplay_sync_pre_frame(netplay_t *netplay)
       size_t connection_num;
 
       /* Check for a connection */
-      FD_ZERO(&fds);
-      FD_SET(netplay->listen_fd, &fds);
-      if (socket_select(netplay->listen_fd + 1,
-               &fds, NULL, NULL, &tmp_tv) > 0 &&
-          FD_ISSET(netplay->listen_fd, &fds))
+      netplay_poll_events(netplay, 0);
+      if (netplay->listen_readable)
       {
          addr_size = sizeof(their_addr);
          new_fd = accept(netplay->listen_fd,
@@ -630,7 +680,13 @@ bool netplay_sync_pre_frame(netplay_t *netplay)
 
          if (new_fd < 0)
          {
-            RARCH_ERR("%s\n", msg_hash_to_str(MSG_NETPLAY_FAILED));
+            /* That was the last one, so wait for the next */
+            netplay->listen_readable = false;
+            netplay_poller_add(&netplay->poller, netplay->listen_fd,
+                  NETPLAY_POLL_TAG_LISTEN);
+
+            if (!isagain(new_fd))
+               RARCH_ERR("%s\n", msg_hash_to_str(MSG_NETPLAY_FAILED));
             goto process;
          }
 
@@ -713,6 +769,9 @@ bool netplay_sync_pre_frame(netplay_t *netplay)
          connection->fd     = new_fd;
          connection->mode   = NETPLAY_CONNECTION_INIT;
 
+         /* It may have sent something already */
+         connection->readable = true;
+
          if (!netplay_init_socket_buffer(&connection->send_packet_buffer,
                netplay->packet_buffer_size) ||
              !netplay_init_socket_buffer(&connection->recv_packet_buffer,
@@ -725,6 +784,15 @@ bool netplay_sync_pre_frame(netplay_t *netplay)
             goto process;
          }
 
+         if (!netplay_poller_add(&netplay->poller, new_fd, connection_num + 1))
+         {
+            netplay_deinit_socket_buffer(&connection->send_packet_buffer);
+            netplay_deinit_socket_buffer(&connection->recv_packet_buffer);
+            connection->active = false;
+            socket_close(new_fd);
+            goto process;
+         }
+
          netplay_handshake_init_send(netplay, connection);
 
       }
@@ -863,10 +931,24 @@ void netplay_sync_post_frame(netplay_t *netplay, bool stalled)
          netplay_wait_and_init_serialization(netplay);
 
       serial_info.data       = NULL;
-      serial_info.data_const = netplay->buffer[netplay->replay_ptr].state;
+      serial_info.data_const = netplay_delta_frame_state(netplay,
+            netplay->replay_ptr);
       serial_info.size       = netplay->state_size;
 
-      if (!core_unserialize(&serial_info))
+      if (!serial_info.data_const)
+      {
+         /* The state to rewind to is gone, so we can't replay. Stay
+          * where we are and resync from a full savestate. */
+         RARCH_ERR("[Netplay]: State of frame %u is lost, requesting a "
+               "savestate.\n", (unsigned)netplay->replay_frame_count);
+         if (netplay->is_server)
+            netplay->force_send_savestate = true;
+         else
+            netplay_cmd_request_savestate(netplay);
+         netplay->replay_ptr         = netplay->run_ptr;
+         netplay->replay_frame_count = netplay->run_frame_count;
+      }
+      else if (!core_unserialize(&serial_info))
       {
          RARCH_ERR("Netplay savestate loading failed: Prepare for desync!\n");
       }
@@ -876,7 +958,7 @@ void netplay_sync_post_frame(netplay_t *netplay, bool stalled)
          retro_time_t start, tm;
          struct delta_frame *ptr = &netplay->buffer[netplay->replay_ptr];
 
-         serial_info.data        = ptr->state;
+         serial_info.data        = netplay_delta_frame_state_buffer(netplay);
          serial_info.size        = netplay->state_size;
          serial_info.data_const  = NULL;
 
@@ -884,7 +966,9 @@ void netplay_sync_post_frame(netplay_t *netplay, bool stalled)
 
          /* Remember the current state */
          memset(serial_info.data, 0, serial_info.size);
-         core_serialize(&serial_info);
+         savestate_pool_serialize_to(serial_info.data,
+               serial_info.size, false);
+         netplay_delta_frame_store_state(netplay, netplay->replay_ptr);
          if (netplay->replay_frame_count < netplay->unread_frame_count)
             netplay_handle_frame_hash(netplay, ptr);
 
@@ -910,9 +994,10 @@ void netplay_sync_post_frame(netplay_t *netplay, bool stalled)
             else
                RARCH_LOG("INP  %X %X\n", ptr->self_state[0], ptr->real_input_state[0]);
             ptr = &netplay->buffer[netplay->replay_ptr];
-            serial_info.data = ptr->state;
+            serial_info.data = netplay_delta_frame_state_buffer(netplay);
             memset(serial_info.data, 0, serial_info.size);
             core_serialize(&serial_info);
+            netplay_delta_frame_store_state(netplay, netplay->replay_ptr);
             RARCH_LOG("POST %u: %X\n", netplay->replay_frame_count-1, netplay_delta_frame_crc(netplay, ptr));
          }
 #endif
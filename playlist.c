@@ -17,20 +17,28 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <string.h>
 #include <ctype.h>
 
 #include <libretro.h>
 #include <boolean.h>
+#include <memmap.h>
 #include <retro_assert.h>
 #include <retro_miscellaneous.h>
 #include <compat/posix_string.h>
 #include <string/stdstring.h>
 #include <streams/interface_stream.h>
+#include <streams/file_stream.h>
 #include <file/file_path.h>
 #include <lists/string_list.h>
 #include <formats/jsonsax_full.h>
 
+#ifdef HAVE_MMAN
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 #include "playlist.h"
 #include "verbosity.h"
 #include "file_path_special.h"
@@ -39,11 +47,122 @@
 #define PLAYLIST_ENTRIES 6
 #endif
 
+#define PLAYLIST_INDEX_MIN_BUCKETS 16
+
+#define PLAYLIST_CACHE_EXTENSION  ".cache"
+#define PLAYLIST_CACHE_MAGIC      "RAPLST1"
+#define PLAYLIST_CACHE_BYTE_ORDER 0x01020304
+#define PLAYLIST_CACHE_VERSION    1
+
+/* Binary playlist cache
+ *
+ * With 'binary_cache' set in the playlist configuration, each JSON
+ * playlist file gets a '.cache' sidecar holding the same entries in
+ * a form that can be used in place. On-disk layout, in host byte
+ * order:
+ *
+ *   playlist_cache_header
+ *   playlist_cache_record [entry_count]
+ *   uint32_t              [rom_count], subsystem ROM strings
+ *   string table; offset 0 holds an empty string and stands for NULL
+ *
+ * The sidecar is only used while the size and mtime of the playlist
+ * file match the ones recorded in its header. It is mapped (or read
+ * whole, where mmap is unavailable) and each entry has its strings
+ * pointed into it the first time the entry is asked for. Entries
+ * get strings of their own once the playlist is modified, at which
+ * point the sidecar is let go. */
+
+enum playlist_cache_flags
+{
+   PLAYLIST_CACHE_COMPRESSED = (1 << 0)
+};
+
+/* String members of playlist_entry that go into a playlist file */
+static const size_t playlist_cache_fields[] = {
+   offsetof(struct playlist_entry, path),
+   offsetof(struct playlist_entry, label),
+   offsetof(struct playlist_entry, core_path),
+   offsetof(struct playlist_entry, core_name),
+   offsetof(struct playlist_entry, crc32),
+   offsetof(struct playlist_entry, db_name),
+   offsetof(struct playlist_entry, subsystem_ident),
+   offsetof(struct playlist_entry, subsystem_name)
+};
+
+#define PLAYLIST_CACHE_FIELD_COUNT \
+   (sizeof(playlist_cache_fields) / sizeof(playlist_cache_fields[0]))
+
+#define PLAYLIST_ENTRY_FIELD(entry, i) \
+   (*(char**)((uint8_t*)(entry) + playlist_cache_fields[i]))
+
+typedef struct playlist_cache_header
+{
+   char magic[8];
+   uint32_t byte_order;
+   uint32_t version;
+   int64_t playlist_size;
+   int64_t playlist_mtime;
+   uint32_t entry_count;
+   uint32_t rom_count;
+   uint32_t strings_size;
+   uint32_t flags;
+   uint32_t default_core_path;
+   uint32_t default_core_name;
+   uint32_t label_display_mode;
+   uint32_t right_thumbnail_mode;
+   uint32_t left_thumbnail_mode;
+   uint32_t sort_mode;
+} playlist_cache_header_t;
+
+typedef struct playlist_cache_record
+{
+   uint32_t fields[PLAYLIST_CACHE_FIELD_COUNT];
+   uint32_t roms_index;
+   uint32_t roms_count;
+} playlist_cache_record_t;
+
+/* A loaded sidecar */
+typedef struct playlist_cache
+{
+   uint8_t *data;
+   size_t size;
+   bool mapped;
+   const playlist_cache_header_t *header;
+   const playlist_cache_record_t *records;
+   const uint32_t *roms;
+   const char *strings;
+} playlist_cache_t;
+
+/* Lookup key of a playlist entry, holding the 'real' paths that
+ * playlist_path_equal() and playlist_core_path_equal() would
+ * otherwise resolve for every entry a search compares against.
+ * Keys are allocated one by one, so that the hash chains survive
+ * the entries array shifting around; 'idx' follows the entry. */
+struct playlist_key
+{
+   char *path;                        /* NULL if the entry has none */
+   char *core_path;                   /* Resolved on first use */
+   char *archive_path;                /* [archive_path] of
+                                         [archive_path][delim][rom_file] */
+   struct playlist_key *next;         /* Next in path bucket */
+   struct playlist_key *archive_next; /* Next in archive bucket */
+   size_t idx;
+   uint32_t hash;
+   uint32_t archive_hash;
+   bool compressed;
+   bool core_path_resolved;
+};
+
 struct content_playlist
 {
    bool modified;
    bool old_format;
    bool compressed;
+   /* The path index is only built once a lookup needs it,
+    * so that playlists which are merely displayed never
+    * resolve a path */
+   bool index_built;
 
    enum playlist_label_display_mode label_display_mode;
    enum playlist_thumbnail_mode right_thumbnail_mode;
@@ -57,6 +176,21 @@ struct content_playlist
 
    struct playlist_entry *entries;
    playlist_config_t config;
+
+   /* Path index: 'keys' runs parallel to 'entries',
+    * 'buckets' chains keys by real path and 'archive_buckets'
+    * chains those inside an archive by archive path */
+   struct playlist_key **keys;
+   struct playlist_key **buckets;
+   struct playlist_key **archive_buckets;
+   size_t bucket_count;
+   size_t key_count;
+
+   /* Sidecar the entries were loaded from, if any;
+    * 'cache_decoded' flags the entries pointed into it so far */
+   playlist_cache_t cache;
+   uint8_t *cache_decoded;
+   size_t cache_pending;
 };
 
 typedef struct
@@ -118,6 +252,7 @@ bool playlist_config_copy(const playlist_config_t *src, playlist_config_t *dst)
    dst->old_format          = src->old_format;
    dst->compress            = src->compress;
    dst->fuzzy_archive_match = src->fuzzy_archive_match;
+   dst->binary_cache        = src->binary_cache;
 
    return true;
 }
@@ -180,90 +315,1093 @@ static bool playlist_path_equal(const char *real_path,
       return false;
 #endif
 
-   /* If we reach this point, we have to work
-    * harder...
-    * Need to handle a rather awkward archive file
-    * case where:
-    * - playlist path contains a properly formatted
-    *   [archive_path][delimiter][rom_file]
-    * - search path is just [archive_path]
-    * ...or vice versa.
-    * This pretty much always happens when a playlist
-    * is generated via scan content (which handles the
-    * archive paths correctly), but the user subsequently
-    * loads an archive file via the command line or some
-    * external launcher (where the [delimiter][rom_file]
-    * part is almost always omitted) */
-   real_path_is_compressed       = path_is_compressed_file(real_path);
-   entry_real_path_is_compressed = path_is_compressed_file(entry_real_path);
+   /* If we reach this point, we have to work
+    * harder...
+    * Need to handle a rather awkward archive file
+    * case where:
+    * - playlist path contains a properly formatted
+    *   [archive_path][delimiter][rom_file]
+    * - search path is just [archive_path]
+    * ...or vice versa.
+    * This pretty much always happens when a playlist
+    * is generated via scan content (which handles the
+    * archive paths correctly), but the user subsequently
+    * loads an archive file via the command line or some
+    * external launcher (where the [delimiter][rom_file]
+    * part is almost always omitted) */
+   real_path_is_compressed       = path_is_compressed_file(real_path);
+   entry_real_path_is_compressed = path_is_compressed_file(entry_real_path);
+
+   if ((real_path_is_compressed  && !entry_real_path_is_compressed) ||
+       (!real_path_is_compressed && entry_real_path_is_compressed))
+   {
+      const char *compressed_path_a  = real_path_is_compressed ? real_path       : entry_real_path;
+      const char *full_path          = real_path_is_compressed ? entry_real_path : real_path;
+      const char *delim              = path_get_archive_delim(full_path);
+
+      if (delim)
+      {
+         char compressed_path_b[PATH_MAX_LENGTH] = {0};
+         unsigned len = (unsigned)(1 + delim - full_path);
+
+         strlcpy(compressed_path_b, full_path,
+               (len < PATH_MAX_LENGTH ? len : PATH_MAX_LENGTH) * sizeof(char));
+
+#ifdef _WIN32
+         /* Handle case-insensitive operating systems*/
+         if (string_is_equal_noncase(compressed_path_a, compressed_path_b))
+            return true;
+#else
+         if (string_is_equal(compressed_path_a, compressed_path_b))
+            return true;
+#endif
+      }
+   }
+
+   return false;
+}
+
+/**
+ * playlist_core_path_equal:
+ * @real_core_path      : 'Real' search path, generated by path_resolve_realpath()
+ * @entry_core_path     : Existing playlist entry 'core path' value
+ *
+ * Returns 'true' if real_core_path matches entry_core_path
+ * (Taking into account relative paths, case insensitive
+ * filesystems)
+ **/
+static bool playlist_core_path_equal(const char *real_core_path, const char *entry_core_path)
+{
+   char entry_real_core_path[PATH_MAX_LENGTH];
+
+   entry_real_core_path[0] = '\0';
+
+   /* Sanity check */
+   if (string_is_empty(real_core_path) || string_is_empty(entry_core_path))
+      return false;
+
+   /* Get entry 'real' core path */
+   strlcpy(entry_real_core_path, entry_core_path, sizeof(entry_real_core_path));
+   if (!string_is_equal(entry_real_core_path, "DETECT") &&
+       !string_is_equal(entry_real_core_path, "builtin"))
+      path_resolve_realpath(entry_real_core_path, sizeof(entry_real_core_path), true);
+
+   if (string_is_empty(entry_real_core_path))
+      return false;
+
+#ifdef _WIN32
+   /* Handle case-insensitive operating systems*/
+   if (string_is_equal_noncase(real_core_path, entry_real_core_path))
+      return true;
+#else
+   if (string_is_equal(real_core_path, entry_real_core_path))
+      return true;
+#endif
+
+   return false;
+}
+
+static void playlist_cache_get_path(const char *playlist_path,
+      char *s, size_t len)
+{
+   strlcpy(s, playlist_path, len);
+   strlcat(s, PLAYLIST_CACHE_EXTENSION, len);
+}
+
+static void playlist_cache_unload(playlist_t *playlist)
+{
+   playlist_cache_t *cache = &playlist->cache;
+
+   free(playlist->cache_decoded);
+   playlist->cache_decoded = NULL;
+   playlist->cache_pending = 0;
+
+   if (!cache->data)
+      return;
+#ifdef HAVE_MMAN
+   if (cache->mapped)
+      munmap(cache->data, cache->size);
+   else
+#endif
+      free(cache->data);
+   memset(cache, 0, sizeof(*cache));
+}
+
+static bool playlist_cache_attach(playlist_cache_t *cache)
+{
+   const playlist_cache_header_t *header =
+      (const playlist_cache_header_t*)cache->data;
+   size_t expected;
+
+   if (cache->size < sizeof(*header))
+      return false;
+   if (memcmp(header->magic, PLAYLIST_CACHE_MAGIC,
+            sizeof(PLAYLIST_CACHE_MAGIC)) != 0)
+      return false;
+   if (     header->byte_order != PLAYLIST_CACHE_BYTE_ORDER
+         || header->version    != PLAYLIST_CACHE_VERSION
+         || header->strings_size == 0)
+      return false;
+
+   expected = sizeof(*header)
+      + (size_t)header->entry_count * sizeof(playlist_cache_record_t)
+      + (size_t)header->rom_count   * sizeof(uint32_t)
+      + header->strings_size;
+
+   if (cache->size != expected)
+      return false;
+
+   cache->header  = header;
+   cache->records = (const playlist_cache_record_t*)(header + 1);
+   cache->roms    = (const uint32_t*)(cache->records + header->entry_count);
+   cache->strings = (const char*)(cache->roms + header->rom_count);
+
+   return cache->strings[header->strings_size - 1] == '\0';
+}
+
+/**
+ * playlist_cache_map:
+ * @cache              : Receives the sidecar contents.
+ * @path               : Path of the sidecar.
+ *
+ * Maps (or reads, where mmap is unavailable) the sidecar.
+ * The mapping is private and writable, so that entry strings
+ * edited in place by callers never reach the file.
+ *
+ * Returns: true if a valid sidecar was loaded.
+ **/
+static bool playlist_cache_map(playlist_cache_t *cache, const char *path)
+{
+#ifdef HAVE_MMAN
+   int fd         = open(path, O_RDONLY);
+   off_t len;
+   void *ptr;
+
+   if (fd < 0)
+      return false;
+
+   len            = lseek(fd, 0, SEEK_END);
+   if (len <= 0)
+   {
+      close(fd);
+      return false;
+   }
+
+   ptr            = mmap(NULL, (size_t)len, PROT_READ | PROT_WRITE,
+         MAP_PRIVATE, fd, 0);
+   close(fd);
+
+   if (ptr == MAP_FAILED)
+      return false;
+
+   cache->data    = (uint8_t*)ptr;
+   cache->size    = (size_t)len;
+   cache->mapped  = true;
+#else
+   void *buf      = NULL;
+   int64_t len    = 0;
+
+   if (!path_is_valid(path))
+      return false;
+
+   if (!filestream_read_file(path, &buf, &len) || len <= 0)
+   {
+      if (buf)
+         free(buf);
+      return false;
+   }
+
+   cache->data    = (uint8_t*)buf;
+   cache->size    = (size_t)len;
+   cache->mapped  = false;
+#endif
+
+   return playlist_cache_attach(cache);
+}
+
+static const char *playlist_cache_string(const playlist_cache_t *cache,
+      uint32_t offset)
+{
+   if (offset == 0 || offset >= cache->header->strings_size)
+      return NULL;
+   return cache->strings + offset;
+}
+
+static char *playlist_cache_strdup(const playlist_cache_t *cache,
+      uint32_t offset)
+{
+   const char *str = playlist_cache_string(cache, offset);
+   return str ? strdup(str) : NULL;
+}
+
+/**
+ * playlist_cache_load:
+ * @playlist            : Playlist handle.
+ *
+ * Takes the entries and metadata of the playlist from its
+ * sidecar, if there is one matching the playlist file.
+ * Entries are left empty, to be filled in on first access
+ * by playlist_cache_decode().
+ *
+ * Returns: true if the sidecar was used.
+ **/
+static bool playlist_cache_load(playlist_t *playlist)
+{
+   char cache_path[PATH_MAX_LENGTH];
+   const playlist_cache_header_t *header = NULL;
+   int64_t playlist_mtime                = path_get_mtime(
+         playlist->config.path);
+   int32_t playlist_size                 = path_get_size(
+         playlist->config.path);
+   size_t count;
+
+   if (playlist_mtime <= 0 || playlist_size <= 0)
+      return false;
+
+   cache_path[0] = '\0';
+   playlist_cache_get_path(playlist->config.path,
+         cache_path, sizeof(cache_path));
+
+   if (!playlist_cache_map(&playlist->cache, cache_path))
+      goto error;
+
+   header = playlist->cache.header;
+
+   if (     header->playlist_size  != playlist_size
+         || header->playlist_mtime != playlist_mtime)
+      goto error;
+
+   count = header->entry_count;
+   if (count > playlist->config.capacity)
+      count = playlist->config.capacity;
+
+   if (count > 0)
+   {
+      playlist->cache_decoded = (uint8_t*)calloc(count, 1);
+      if (!playlist->cache_decoded)
+         goto error;
+   }
+
+   playlist->size                 = count;
+   playlist->cache_pending        = count;
+   playlist->old_format           = false;
+   playlist->compressed           =
+      (header->flags & PLAYLIST_CACHE_COMPRESSED) != 0;
+   playlist->default_core_path    = playlist_cache_strdup(
+         &playlist->cache, header->default_core_path);
+   playlist->default_core_name    = playlist_cache_strdup(
+         &playlist->cache, header->default_core_name);
+   playlist->label_display_mode   =
+      (enum playlist_label_display_mode)header->label_display_mode;
+   playlist->right_thumbnail_mode =
+      (enum playlist_thumbnail_mode)header->right_thumbnail_mode;
+   playlist->left_thumbnail_mode  =
+      (enum playlist_thumbnail_mode)header->left_thumbnail_mode;
+   playlist->sort_mode            =
+      (enum playlist_sort_mode)header->sort_mode;
+
+   return true;
+
+error:
+   playlist_cache_unload(playlist);
+   return false;
+}
+
+/* Points the strings of entry 'idx' into the sidecar,
+ * if that has not happened yet */
+static void playlist_cache_decode(playlist_t *playlist, size_t idx)
+{
+   size_t i;
+   const playlist_cache_t *cache          = &playlist->cache;
+   const playlist_cache_record_t *record  = NULL;
+   struct playlist_entry *entry           = NULL;
+
+   if (     !playlist->cache_decoded
+         || idx >= playlist->size
+         || playlist->cache_decoded[idx])
+      return;
+
+   record = &cache->records[idx];
+   entry  = &playlist->entries[idx];
+
+   for (i = 0; i < PLAYLIST_CACHE_FIELD_COUNT; i++)
+      PLAYLIST_ENTRY_FIELD(entry, i) = (char*)playlist_cache_string(
+            cache, record->fields[i]);
+
+   if (     record->roms_count > 0
+         && record->roms_index <= cache->header->rom_count
+         && record->roms_count <=
+            cache->header->rom_count - record->roms_index)
+   {
+      entry->subsystem_roms = string_list_new();
+
+      if (entry->subsystem_roms)
+      {
+         union string_list_elem_attr attr;
+
+         attr.i = 0;
+
+         for (i = 0; i < record->roms_count; i++)
+         {
+            const char *rom = playlist_cache_string(cache,
+                  cache->roms[record->roms_index + i]);
+            if (rom)
+               string_list_append(entry->subsystem_roms, rom, attr);
+         }
+      }
+   }
+
+   playlist->cache_decoded[idx] = 1;
+   playlist->cache_pending--;
+}
+
+static void playlist_cache_decode_all(playlist_t *playlist)
+{
+   size_t i;
+
+   for (i = 0; i < playlist->size && playlist->cache_pending > 0; i++)
+      playlist_cache_decode(playlist, i);
+}
+
+/* Gives every entry strings of its own, ahead of the entries
+ * being changed. The sidecar itself stays loaded until the
+ * playlist is freed or cleared, so that strings handed out
+ * before the change remain valid as they would on the heap. */
+static void playlist_cache_release(playlist_t *playlist)
+{
+   size_t i, j;
+
+   if (!playlist->cache_decoded)
+      return;
+
+   playlist_cache_decode_all(playlist);
+
+   for (i = 0; i < playlist->size; i++)
+   {
+      for (j = 0; j < PLAYLIST_CACHE_FIELD_COUNT; j++)
+      {
+         char **field = &PLAYLIST_ENTRY_FIELD(&playlist->entries[i], j);
+         if (*field)
+            *field = strdup(*field);
+      }
+   }
+
+   free(playlist->cache_decoded);
+   playlist->cache_decoded = NULL;
+}
+
+/* Lets go of the sidecar, dropping the entry strings still
+ * pointing into it, ahead of the entries being freed */
+static void playlist_cache_discard(playlist_t *playlist)
+{
+   size_t i, j;
+
+   if (playlist->cache_decoded)
+      for (i = 0; i < playlist->size; i++)
+         for (j = 0; j < PLAYLIST_CACHE_FIELD_COUNT; j++)
+            PLAYLIST_ENTRY_FIELD(&playlist->entries[i], j) = NULL;
+
+   playlist_cache_unload(playlist);
+}
+
+typedef struct playlist_cache_builder
+{
+   char *strings;
+   size_t strings_size;
+   size_t strings_capacity;
+   bool failed;
+} playlist_cache_builder_t;
+
+static uint32_t playlist_cache_builder_string(
+      playlist_cache_builder_t *builder, const char *str)
+{
+   size_t len;
+   uint32_t offset;
+
+   if (string_is_empty(str) || builder->failed)
+      return 0;
+
+   len = strlen(str) + 1;
+
+   if (builder->strings_size + len > builder->strings_capacity)
+   {
+      char *tmp;
+      size_t capacity = builder->strings_capacity;
+
+      while (capacity < builder->strings_size + len)
+         capacity *= 2;
+
+      /* Offsets are 32 bit */
+      if (     (uint64_t)capacity > UINT32_MAX
+            || !(tmp = (char*)realloc(builder->strings, capacity)))
+      {
+         builder->failed = true;
+         return 0;
+      }
+
+      builder->strings          = tmp;
+      builder->strings_capacity = capacity;
+   }
+
+   offset = (uint32_t)builder->strings_size;
+   memcpy(builder->strings + offset, str, len);
+   builder->strings_size += len;
+
+   return offset;
+}
+
+/**
+ * playlist_cache_write:
+ * @playlist            : Playlist handle.
+ *
+ * (Re)writes the sidecar of the playlist from its entries, keyed
+ * on the current size and mtime of the playlist file. Strings
+ * repeated from the previous entry (core path and name, database
+ * name...) are stored once. The new sidecar is moved over the old
+ * one rather than written into it, which may still be mapped.
+ **/
+static void playlist_cache_write(playlist_t *playlist)
+{
+   size_t i, j;
+   char cache_path[PATH_MAX_LENGTH];
+   char tmp_path[PATH_MAX_LENGTH];
+   playlist_cache_header_t header;
+   playlist_cache_builder_t builder;
+   uint32_t last[PLAYLIST_CACHE_FIELD_COUNT];
+   size_t rom_count                   = 0;
+   playlist_cache_record_t *records   = NULL;
+   uint32_t *roms                     = NULL;
+   const struct playlist_entry *prev  = NULL;
+   RFILE *file                        = NULL;
+   int64_t playlist_mtime             = path_get_mtime(
+         playlist->config.path);
+   int32_t playlist_size              = path_get_size(
+         playlist->config.path);
+
+   if (playlist_mtime <= 0 || playlist_size <= 0)
+      return;
+
+   cache_path[0] = '\0';
+   tmp_path[0]   = '\0';
+   playlist_cache_get_path(playlist->config.path,
+         cache_path, sizeof(cache_path));
+   strlcpy(tmp_path, cache_path, sizeof(tmp_path));
+   strlcat(tmp_path, ".tmp", sizeof(tmp_path));
+
+   memset(&builder, 0, sizeof(builder));
+   memset(last, 0, sizeof(last));
+
+   /* Offset 0 is the empty string, standing for NULL */
+   builder.strings_capacity = 4096;
+   if (!(builder.strings = (char*)malloc(builder.strings_capacity)))
+      return;
+   builder.strings[0]       = '\0';
+   builder.strings_size     = 1;
+
+   for (i = 0; i < playlist->size; i++)
+   {
+      const struct string_list *list = playlist->entries[i].subsystem_roms;
+      if (list)
+         rom_count += list->size;
+   }
+
+   if (playlist->size > 0)
+   {
+      records = (playlist_cache_record_t*)
+         calloc(playlist->size, sizeof(*records));
+      if (!records)
+         goto end;
+   }
+
+   if (rom_count > 0)
+   {
+      roms = (uint32_t*)malloc(rom_count * sizeof(*roms));
+      if (!roms)
+         goto end;
+   }
+
+   rom_count = 0;
+
+   for (i = 0; i < playlist->size; i++)
+   {
+      const struct playlist_entry *entry = &playlist->entries[i];
+      playlist_cache_record_t *record    = &records[i];
+
+      for (j = 0; j < PLAYLIST_CACHE_FIELD_COUNT; j++)
+      {
+         const char *str = PLAYLIST_ENTRY_FIELD(entry, j);
+
+         if (!(prev && string_is_equal(str,
+                     PLAYLIST_ENTRY_FIELD(prev, j))))
+            last[j] = playlist_cache_builder_string(&builder, str);
+
+         record->fields[j] = last[j];
+      }
+
+      /* Empty ROM paths are dropped, as when reading the JSON */
+      if (entry->subsystem_roms)
+      {
+         record->roms_index = (uint32_t)rom_count;
+
+         for (j = 0; j < entry->subsystem_roms->size; j++)
+         {
+            const char *rom = entry->subsystem_roms->elems[j].data;
+            if (!string_is_empty(rom))
+               roms[rom_count++] = playlist_cache_builder_string(
+                     &builder, rom);
+         }
+
+         record->roms_count = (uint32_t)rom_count - record->roms_index;
+      }
+
+      prev = entry;
+   }
+
+   memset(&header, 0, sizeof(header));
+   memcpy(header.magic, PLAYLIST_CACHE_MAGIC, sizeof(PLAYLIST_CACHE_MAGIC));
+   header.byte_order           = PLAYLIST_CACHE_BYTE_ORDER;
+   header.version              = PLAYLIST_CACHE_VERSION;
+   header.playlist_size        = playlist_size;
+   header.playlist_mtime       = playlist_mtime;
+   header.entry_count          = (uint32_t)playlist->size;
+   header.rom_count            = (uint32_t)rom_count;
+   header.flags                = playlist->compressed
+      ? PLAYLIST_CACHE_COMPRESSED : 0;
+   header.default_core_path    = playlist_cache_builder_string(
+         &builder, playlist->default_core_path);
+   header.default_core_name    = playlist_cache_builder_string(
+         &builder, playlist->default_core_name);
+   header.label_display_mode   = (uint32_t)playlist->label_display_mode;
+   header.right_thumbnail_mode = (uint32_t)playlist->right_thumbnail_mode;
+   header.left_thumbnail_mode  = (uint32_t)playlist->left_thumbnail_mode;
+   header.sort_mode            = (uint32_t)playlist->sort_mode;
+   header.strings_size         = (uint32_t)builder.strings_size;
+
+   if (builder.failed)
+      goto end;
+
+   file = filestream_open(tmp_path,
+         RETRO_VFS_FILE_ACCESS_WRITE, RETRO_VFS_FILE_ACCESS_HINT_NONE);
+
+   if (!file)
+      goto end;
+
+   if (     filestream_write(file, &header, sizeof(header))
+            != (int64_t)sizeof(header)
+         || filestream_write(file, records,
+            playlist->size * sizeof(*records))
+            != (int64_t)(playlist->size * sizeof(*records))
+         || filestream_write(file, roms, rom_count * sizeof(*roms))
+            != (int64_t)(rom_count * sizeof(*roms))
+         || filestream_write(file, builder.strings, builder.strings_size)
+            != (int64_t)builder.strings_size)
+   {
+      filestream_close(file);
+      filestream_delete(tmp_path);
+      goto end;
+   }
+
+   filestream_close(file);
+
+   /* Renaming onto an existing file fails on some platforms */
+   if (filestream_rename(tmp_path, cache_path) != 0)
+   {
+      filestream_delete(cache_path);
+      if (filestream_rename(tmp_path, cache_path) != 0)
+         filestream_delete(tmp_path);
+   }
+
+end:
+   free(builder.strings);
+   free(records);
+   free(roms);
+}
+
+void playlist_delete_cache_file(const char *path)
+{
+   char cache_path[PATH_MAX_LENGTH];
+
+   if (string_is_empty(path))
+      return;
+
+   cache_path[0] = '\0';
+   playlist_cache_get_path(path, cache_path, sizeof(cache_path));
+
+   if (path_is_valid(cache_path))
+      filestream_delete(cache_path);
+}
+
+static uint32_t playlist_key_hash(const char *str)
+{
+   /* FNV-1a */
+   uint32_t hash = 0x811c9dc5;
+
+   while (*str)
+   {
+#ifdef _WIN32
+      /* Handle case-insensitive operating systems */
+      hash ^= (uint8_t)tolower((unsigned char)*str++);
+#else
+      hash ^= (uint8_t)*str++;
+#endif
+      hash *= 0x01000193;
+   }
+
+   return hash;
+}
+
+static bool playlist_key_path_equal(const char *a, const char *b)
+{
+#ifdef _WIN32
+   /* Handle case-insensitive operating systems*/
+   return string_is_equal_noncase(a, b);
+#else
+   return string_is_equal(a, b);
+#endif
+}
+
+static void playlist_key_free(struct playlist_key *key)
+{
+   if (!key)
+      return;
+
+   free(key->path);
+   free(key->core_path);
+   free(key->archive_path);
+   free(key);
+}
+
+static struct playlist_key *playlist_key_new(
+      const struct playlist_entry *entry, size_t idx)
+{
+   char tmp[PATH_MAX_LENGTH];
+   struct playlist_key *key = (struct playlist_key*)
+      calloc(1, sizeof(*key));
+
+   if (!key)
+      return NULL;
+
+   key->idx = idx;
+
+   if (!string_is_empty(entry->path))
+   {
+      strlcpy(tmp, entry->path, sizeof(tmp));
+      path_resolve_realpath(tmp, sizeof(tmp), true);
+
+      if (!string_is_empty(tmp) && !(key->path = strdup(tmp)))
+         goto error;
+   }
+
+   key->hash = playlist_key_hash(key->path ? key->path : "");
+
+   if (key->path)
+   {
+      key->compressed = path_is_compressed_file(key->path);
+
+      /* Entries inside an archive are also found
+       * by the path of the archive (see playlist_path_equal()) */
+      if (!key->compressed)
+      {
+         const char *delim = path_get_archive_delim(key->path);
+
+         if (delim)
+         {
+            size_t len = (size_t)(1 + delim - key->path);
+
+            strlcpy(tmp, key->path,
+                  len < sizeof(tmp) ? len : sizeof(tmp));
+
+            if (!(key->archive_path = strdup(tmp)))
+               goto error;
+
+            key->archive_hash = playlist_key_hash(key->archive_path);
+         }
+      }
+   }
+
+   return key;
+
+error:
+   playlist_key_free(key);
+   return NULL;
+}
+
+/* Returns the 'real' core path of the entry behind 'key',
+ * resolving it on first use. Most lookups are settled by the
+ * content path alone. */
+static const char *playlist_key_get_core_path(playlist_t *playlist,
+      struct playlist_key *key)
+{
+   const char *core_path = playlist->entries[key->idx].core_path;
+   char tmp[PATH_MAX_LENGTH];
+
+   if (key->core_path_resolved)
+      return key->core_path;
+
+   key->core_path_resolved = true;
+
+   if (string_is_empty(core_path))
+      return NULL;
+
+   strlcpy(tmp, core_path, sizeof(tmp));
+   if (!string_is_equal(tmp, "DETECT") &&
+       !string_is_equal(tmp, "builtin"))
+      path_resolve_realpath(tmp, sizeof(tmp), true);
+
+   if (!string_is_empty(tmp))
+      key->core_path = strdup(tmp);
+
+   return key->core_path;
+}
+
+static void playlist_index_link(playlist_t *playlist,
+      struct playlist_key *key)
+{
+   size_t mask                  = playlist->bucket_count - 1;
+   struct playlist_key **bucket = &playlist->buckets[key->hash & mask];
+
+   key->next = *bucket;
+   *bucket   = key;
+
+   if (key->archive_path)
+   {
+      bucket            = &playlist->archive_buckets[
+         key->archive_hash & mask];
+      key->archive_next = *bucket;
+      *bucket           = key;
+   }
+}
+
+static void playlist_index_unlink(playlist_t *playlist,
+      struct playlist_key *key)
+{
+   size_t mask                  = playlist->bucket_count - 1;
+   struct playlist_key **bucket = &playlist->buckets[key->hash & mask];
+
+   for (; *bucket; bucket = &(*bucket)->next)
+   {
+      if (*bucket == key)
+      {
+         *bucket = key->next;
+         break;
+      }
+   }
+
+   if (!key->archive_path)
+      return;
+
+   bucket = &playlist->archive_buckets[key->archive_hash & mask];
+
+   for (; *bucket; bucket = &(*bucket)->archive_next)
+   {
+      if (*bucket == key)
+      {
+         *bucket = key->archive_next;
+         break;
+      }
+   }
+}
+
+/**
+ * playlist_index_clear:
+ * @playlist            : Playlist handle.
+ *
+ * Drops the path index. It is built again
+ * by the next lookup.
+ **/
+static void playlist_index_clear(playlist_t *playlist)
+{
+   size_t i;
+
+   if (playlist->keys)
+      for (i = 0; i < playlist->config.capacity; i++)
+         playlist_key_free(playlist->keys[i]);
+
+   free(playlist->keys);
+   free(playlist->buckets);
+   free(playlist->archive_buckets);
+
+   playlist->keys            = NULL;
+   playlist->buckets         = NULL;
+   playlist->archive_buckets = NULL;
+   playlist->bucket_count    = 0;
+   playlist->key_count       = 0;
+   playlist->index_built     = false;
+}
+
+static bool playlist_index_resize(playlist_t *playlist, size_t count)
+{
+   size_t i;
+   struct playlist_key **buckets         = (struct playlist_key**)
+      calloc(count, sizeof(*buckets));
+   struct playlist_key **archive_buckets = (struct playlist_key**)
+      calloc(count, sizeof(*archive_buckets));
+   struct playlist_key **old_buckets     = playlist->buckets;
+   size_t old_count                      = playlist->bucket_count;
+
+   if (!buckets || !archive_buckets)
+   {
+      free(buckets);
+      free(archive_buckets);
+      return false;
+   }
+
+   free(playlist->archive_buckets);
+   playlist->buckets         = buckets;
+   playlist->archive_buckets = archive_buckets;
+   playlist->bucket_count    = count;
+
+   /* Every key sits in a path bucket, archive or not */
+   for (i = 0; i < old_count; i++)
+   {
+      struct playlist_key *key = old_buckets[i];
+
+      while (key)
+      {
+         struct playlist_key *next = key->next;
+         playlist_index_link(playlist, key);
+         key = next;
+      }
+   }
+
+   free(old_buckets);
+   return true;
+}
+
+/**
+ * playlist_index_build:
+ * @playlist            : Playlist handle.
+ *
+ * Builds the path index, unless it is already up.
+ * This resolves the path of every entry, once.
+ *
+ * Returns: true if the index is usable.
+ **/
+static bool playlist_index_build(playlist_t *playlist)
+{
+   size_t i;
+   size_t count = PLAYLIST_INDEX_MIN_BUCKETS;
+
+   if (playlist->index_built)
+      return true;
+
+   playlist_cache_decode_all(playlist);
+
+   while (count < playlist->size)
+      count <<= 1;
+
+   playlist->keys = (struct playlist_key**)calloc(
+         playlist->config.capacity, sizeof(*playlist->keys));
+
+   if (!playlist->keys || !playlist_index_resize(playlist, count))
+      goto error;
+
+   for (i = 0; i < playlist->size; i++)
+   {
+      struct playlist_key *key = playlist_key_new(
+            &playlist->entries[i], i);
+
+      if (!key)
+         goto error;
+
+      playlist->keys[i] = key;
+      playlist_index_link(playlist, key);
+   }
+
+   playlist->key_count   = playlist->size;
+   playlist->index_built = true;
+   return true;
+
+error:
+   playlist_index_clear(playlist);
+   return false;
+}
+
+/* Indexes the entry just written to 'idx' */
+static void playlist_index_add(playlist_t *playlist, size_t idx)
+{
+   struct playlist_key *key = NULL;
+
+   if (!playlist->index_built)
+      return;
+
+   /* Keep the load factor at or below 1 */
+   if (     playlist->key_count + 1 > playlist->bucket_count
+         && !playlist_index_resize(playlist, playlist->bucket_count << 1))
+      goto error;
+
+   if (!(key = playlist_key_new(&playlist->entries[idx], idx)))
+      goto error;
+
+   playlist->keys[idx] = key;
+   playlist->key_count++;
+   playlist_index_link(playlist, key);
+   return;
+
+error:
+   /* Better rebuilt later than out of step */
+   playlist_index_clear(playlist);
+}
+
+/* Drops the key of the entry at 'idx', ahead of
+ * that entry being freed or overwritten */
+static void playlist_index_remove(playlist_t *playlist, size_t idx)
+{
+   struct playlist_key *key = NULL;
+
+   if (!playlist->index_built || !(key = playlist->keys[idx]))
+      return;
+
+   playlist_index_unlink(playlist, key);
+   playlist_key_free(key);
+   playlist->keys[idx] = NULL;
+   playlist->key_count--;
+}
+
+/* Mirrors a memmove() of 'count' entries from 'src' to 'dst' */
+static void playlist_index_move(playlist_t *playlist,
+      size_t dst, size_t src, size_t count)
+{
+   size_t i;
+
+   if (!playlist->index_built)
+      return;
 
-   if ((real_path_is_compressed  && !entry_real_path_is_compressed) ||
-       (!real_path_is_compressed && entry_real_path_is_compressed))
+   memmove(playlist->keys + dst, playlist->keys + src,
+         count * sizeof(*playlist->keys));
+
+   for (i = dst; i < dst + count; i++)
+      if (playlist->keys[i])
+         playlist->keys[i]->idx = i;
+
+   /* Whatever was moved away from is vacant now */
+   if (src < dst)
+      memset(playlist->keys + src, 0,
+            (dst - src < count ? dst - src : count)
+            * sizeof(*playlist->keys));
+   else if (src > dst)
    {
-      const char *compressed_path_a  = real_path_is_compressed ? real_path       : entry_real_path;
-      const char *full_path          = real_path_is_compressed ? entry_real_path : real_path;
-      const char *delim              = path_get_archive_delim(full_path);
+      size_t start = src > dst + count ? src : dst + count;
+      memset(playlist->keys + start, 0,
+            (src + count - start) * sizeof(*playlist->keys));
+   }
+}
 
-      if (delim)
-      {
-         char compressed_path_b[PATH_MAX_LENGTH] = {0};
-         unsigned len = (unsigned)(1 + delim - full_path);
+/* Mirrors moving the entry at 'idx' to the top */
+static void playlist_index_bump(playlist_t *playlist, size_t idx)
+{
+   struct playlist_key *key = NULL;
 
-         strlcpy(compressed_path_b, full_path,
-               (len < PATH_MAX_LENGTH ? len : PATH_MAX_LENGTH) * sizeof(char));
+   if (!playlist->index_built)
+      return;
 
-#ifdef _WIN32
-         /* Handle case-insensitive operating systems*/
-         if (string_is_equal_noncase(compressed_path_a, compressed_path_b))
-            return true;
-#else
-         if (string_is_equal(compressed_path_a, compressed_path_b))
-            return true;
-#endif
-      }
-   }
+   key = playlist->keys[idx];
+   playlist_index_move(playlist, 1, 0, idx);
+   playlist->keys[0] = key;
+   key->idx          = 0;
+}
 
-   return false;
+typedef bool (*playlist_index_filter_t)(playlist_t *playlist,
+      struct playlist_key *key, const void *userdata);
+
+/* Of 'found' and 'key', returns whichever comes first
+ * in the playlist, taking 'key' only if 'filter' accepts it */
+static struct playlist_key *playlist_index_pick(playlist_t *playlist,
+      struct playlist_key *found, struct playlist_key *key,
+      playlist_index_filter_t filter, const void *userdata)
+{
+   if (found && found->idx < key->idx)
+      return found;
+   if (filter && !filter(playlist, key, userdata))
+      return found;
+   return key;
 }
 
 /**
- * playlist_core_path_equal:
- * @real_core_path      : 'Real' search path, generated by path_resolve_realpath()
- * @entry_core_path     : Existing playlist entry 'core path' value
+ * playlist_index_find:
+ * @playlist            : Playlist handle.
+ * @real_path           : 'Real' search path, generated by path_resolve_realpath()
+ * @filter              : Further test of a matching entry, or NULL.
+ * @userdata            : Passed to @filter.
  *
- * Returns 'true' if real_core_path matches entry_core_path
- * (Taking into account relative paths, case insensitive
- * filesystems)
+ * Finds the first entry whose path matches @real_path the way
+ * playlist_path_equal() would, and that @filter accepts.
+ * An empty @real_path matches entries without a path.
+ *
+ * Returns: key of the entry, or NULL if there is none
+ * (or the index could not be built).
  **/
-static bool playlist_core_path_equal(const char *real_core_path, const char *entry_core_path)
+static struct playlist_key *playlist_index_find(playlist_t *playlist,
+      const char *real_path,
+      playlist_index_filter_t filter, const void *userdata)
 {
-   char entry_real_core_path[PATH_MAX_LENGTH];
-
-   entry_real_core_path[0] = '\0';
+   size_t mask;
+   uint32_t hash;
+   const char *delim          = NULL;
+   struct playlist_key *key   = NULL;
+   struct playlist_key *found = NULL;
+   bool is_empty              = string_is_empty(real_path);
+
+   if (!playlist_index_build(playlist))
+      return NULL;
 
-   /* Sanity check */
-   if (string_is_empty(real_core_path) || string_is_empty(entry_core_path))
-      return false;
+   mask = playlist->bucket_count - 1;
+   hash = playlist_key_hash(is_empty ? "" : real_path);
 
-   /* Get entry 'real' core path */
-   strlcpy(entry_real_core_path, entry_core_path, sizeof(entry_real_core_path));
-   if (!string_is_equal(entry_real_core_path, "DETECT") &&
-       !string_is_equal(entry_real_core_path, "builtin"))
-      path_resolve_realpath(entry_real_core_path, sizeof(entry_real_core_path), true);
+   for (key = playlist->buckets[hash & mask]; key; key = key->next)
+   {
+      if (key->hash != hash)
+         continue;
+      if (is_empty ? !!key->path
+            : !playlist_key_path_equal(real_path, key->path))
+         continue;
+      found = playlist_index_pick(playlist, found, key, filter, userdata);
+   }
 
-   if (string_is_empty(entry_real_core_path))
-      return false;
+   if (is_empty)
+      return found;
 
-#ifdef _WIN32
-   /* Handle case-insensitive operating systems*/
-   if (string_is_equal_noncase(real_core_path, entry_real_core_path))
-      return true;
-#else
-   if (string_is_equal(real_core_path, entry_real_core_path))
-      return true;
+#ifdef RARCH_INTERNAL
+   /* If fuzzy matching is disabled, we can give up now */
+   if (!playlist->config.fuzzy_archive_match)
+      return found;
 #endif
 
-   return false;
+   /* Search path is [archive_path],
+    * entry is [archive_path][delimiter][rom_file] */
+   if (path_is_compressed_file(real_path))
+   {
+      for (key = playlist->archive_buckets[hash & mask]; key;
+            key = key->archive_next)
+      {
+         if (key->archive_hash != hash ||
+             !playlist_key_path_equal(real_path, key->archive_path))
+            continue;
+         found = playlist_index_pick(playlist, found, key,
+               filter, userdata);
+      }
+   }
+   /* ...or vice versa */
+   else if ((delim = path_get_archive_delim(real_path)))
+   {
+      char archive_path[PATH_MAX_LENGTH];
+      size_t len = (size_t)(1 + delim - real_path);
+
+      strlcpy(archive_path, real_path,
+            len < sizeof(archive_path) ? len : sizeof(archive_path));
+      hash = playlist_key_hash(archive_path);
+
+      for (key = playlist->buckets[hash & mask]; key; key = key->next)
+      {
+         if (key->hash != hash || !key->compressed ||
+             !playlist_key_path_equal(archive_path, key->path))
+            continue;
+         found = playlist_index_pick(playlist, found, key,
+               filter, userdata);
+      }
+   }
+
+   return found;
 }
 
 uint32_t playlist_get_size(playlist_t *playlist)
@@ -297,6 +1435,7 @@ void playlist_get_index(playlist_t *playlist,
    if (!playlist || !entry)
       return;
 
+   playlist_cache_decode(playlist, idx);
    *entry = &playlist->entries[idx];
 }
 
@@ -375,9 +1514,12 @@ void playlist_delete_index(playlist_t *playlist,
    if (idx >= playlist->size)
       return;
 
+   playlist_cache_release(playlist);
+
    playlist->size     = playlist->size - 1;
 
    /* Free unwanted entry */
+   playlist_index_remove(playlist, idx);
    entry_to_delete = (struct playlist_entry *)(playlist->entries + idx);
    if (entry_to_delete)
       playlist_free_entry(entry_to_delete);
@@ -385,6 +1527,7 @@ void playlist_delete_index(playlist_t *playlist,
    /* Shift remaining entries to fill the gap */
    memmove(playlist->entries + idx, playlist->entries + idx + 1,
          (playlist->size - idx) * sizeof(struct playlist_entry));
+   playlist_index_move(playlist, idx, idx + 1, playlist->size - idx);
 
    playlist->modified = true;
 }
@@ -400,7 +1543,7 @@ void playlist_delete_index(playlist_t *playlist,
 void playlist_delete_by_path(playlist_t *playlist,
       const char *search_path)
 {
-   size_t i = 0;
+   struct playlist_key *key = NULL;
    char real_search_path[PATH_MAX_LENGTH];
 
    real_search_path[0] = '\0';
@@ -412,28 +1555,16 @@ void playlist_delete_by_path(playlist_t *playlist,
    strlcpy(real_search_path, search_path, sizeof(real_search_path));
    path_resolve_realpath(real_search_path, sizeof(real_search_path), true);
 
-   while (i < playlist->size)
-   {
-      if (!playlist_path_equal(real_search_path, playlist->entries[i].path,
-            &playlist->config))
-      {
-         i++;
-         continue;
-      }
-
-      /* Paths are equal - delete entry */
-      playlist_delete_index(playlist, i);
-
-      /* Entries are shifted up by the delete
-       * operation - *do not* increment i */
-   }
+   while ((key = playlist_index_find(playlist, real_search_path,
+               NULL, NULL)))
+      playlist_delete_index(playlist, key->idx);
 }
 
 void playlist_get_index_by_path(playlist_t *playlist,
       const char *search_path,
       const struct playlist_entry **entry)
 {
-   size_t i;
+   struct playlist_key *key = NULL;
    char real_search_path[PATH_MAX_LENGTH];
 
    real_search_path[0] = '\0';
@@ -445,22 +1576,13 @@ void playlist_get_index_by_path(playlist_t *playlist,
    strlcpy(real_search_path, search_path, sizeof(real_search_path));
    path_resolve_realpath(real_search_path, sizeof(real_search_path), true);
 
-   for (i = 0; i < playlist->size; i++)
-   {
-      if (!playlist_path_equal(real_search_path, playlist->entries[i].path,
-               &playlist->config))
-         continue;
-
-      *entry = &playlist->entries[i];
-
-      break;
-   }
+   if ((key = playlist_index_find(playlist, real_search_path, NULL, NULL)))
+      *entry = &playlist->entries[key->idx];
 }
 
 bool playlist_entry_exists(playlist_t *playlist,
       const char *path)
 {
-   size_t i;
    char real_search_path[PATH_MAX_LENGTH];
 
    real_search_path[0] = '\0';
@@ -472,22 +1594,20 @@ bool playlist_entry_exists(playlist_t *playlist,
    strlcpy(real_search_path, path, sizeof(real_search_path));
    path_resolve_realpath(real_search_path, sizeof(real_search_path), true);
 
-   for (i = 0; i < playlist->size; i++)
-      if (playlist_path_equal(real_search_path, playlist->entries[i].path,
-               &playlist->config))
-         return true;
-
-   return false;
+   return playlist_index_find(playlist, real_search_path, NULL, NULL) != NULL;
 }
 
 void playlist_update(playlist_t *playlist, size_t idx,
       const struct playlist_entry *update_entry)
 {
    struct playlist_entry *entry = NULL;
+   bool rekey                   = false;
 
    if (!playlist || idx > playlist->size)
       return;
 
+   playlist_cache_release(playlist);
+
    entry            = &playlist->entries[idx];
 
    if (update_entry->path && (update_entry->path != entry->path))
@@ -496,6 +1616,7 @@ void playlist_update(playlist_t *playlist, size_t idx,
          free(entry->path);
       entry->path        = strdup(update_entry->path);
       playlist->modified = true;
+      rekey              = true;
    }
 
    if (update_entry->label && (update_entry->label != entry->label))
@@ -513,6 +1634,7 @@ void playlist_update(playlist_t *playlist, size_t idx,
       entry->core_path   = NULL;
       entry->core_path   = strdup(update_entry->core_path);
       playlist->modified = true;
+      rekey              = true;
    }
 
    if (update_entry->core_name && (update_entry->core_name != entry->core_name))
@@ -538,6 +1660,12 @@ void playlist_update(playlist_t *playlist, size_t idx,
       entry->crc32       = strdup(update_entry->crc32);
       playlist->modified = true;
    }
+
+   if (rekey && idx < playlist->size)
+   {
+      playlist_index_remove(playlist, idx);
+      playlist_index_add(playlist, idx);
+   }
 }
 
 void playlist_update_runtime(playlist_t *playlist, size_t idx,
@@ -545,10 +1673,13 @@ void playlist_update_runtime(playlist_t *playlist, size_t idx,
       bool register_update)
 {
    struct playlist_entry *entry = NULL;
+   bool rekey                   = false;
 
    if (!playlist || idx > playlist->size)
       return;
 
+   playlist_cache_release(playlist);
+
    entry            = &playlist->entries[idx];
 
    if (update_entry->path && (update_entry->path != entry->path))
@@ -558,6 +1689,7 @@ void playlist_update_runtime(playlist_t *playlist, size_t idx,
       entry->path        = NULL;
       entry->path        = strdup(update_entry->path);
       playlist->modified = playlist->modified || register_update;
+      rekey              = true;
    }
 
    if (update_entry->core_path && (update_entry->core_path != entry->core_path))
@@ -567,6 +1699,7 @@ void playlist_update_runtime(playlist_t *playlist, size_t idx,
       entry->core_path   = NULL;
       entry->core_path   = strdup(update_entry->core_path);
       playlist->modified = playlist->modified || register_update;
+      rekey              = true;
    }
 
    if (update_entry->runtime_status != entry->runtime_status)
@@ -646,12 +1779,113 @@ void playlist_update_runtime(playlist_t *playlist, size_t idx,
       entry->last_played_str = strdup(update_entry->last_played_str);
       playlist->modified = playlist->modified || register_update;
    }
+
+   if (rekey && idx < playlist->size)
+   {
+      playlist_index_remove(playlist, idx);
+      playlist_index_add(playlist, idx);
+   }
+}
+
+/* Accepts entries associated with the core at 'userdata',
+ * a 'real' core path. Core name can have changed while still
+ * being the same core, so this goes by the core path only. */
+static bool playlist_core_filter(playlist_t *playlist,
+      struct playlist_key *key, const void *userdata)
+{
+   const char *real_core_path  = (const char*)userdata;
+   const char *entry_core_path = NULL;
+
+   if (string_is_empty(real_core_path))
+      return false;
+
+   entry_core_path = playlist_key_get_core_path(playlist, key);
+
+   if (string_is_empty(entry_core_path))
+      return false;
+
+   return playlist_key_path_equal(real_core_path, entry_core_path);
+}
+
+struct playlist_push_filter_data
+{
+   const struct playlist_entry *entry;
+   const char *real_core_path;
+};
+
+/* Accepts entries that are the same launch as the one being
+ * pushed: same core, and same subsystem with the same content */
+static bool playlist_push_filter(playlist_t *playlist,
+      struct playlist_key *key, const void *userdata)
+{
+   const struct playlist_push_filter_data *data =
+      (const struct playlist_push_filter_data*)userdata;
+   const struct playlist_entry *entry           = data->entry;
+   const struct playlist_entry *existing        =
+      &playlist->entries[key->idx];
+
+   if (!playlist_core_filter(playlist, key, data->real_core_path))
+      return false;
+
+   if (     !string_is_empty(entry->subsystem_ident)
+         && !string_is_empty(existing->subsystem_ident)
+         && !string_is_equal(existing->subsystem_ident, entry->subsystem_ident))
+      return false;
+
+   if (      string_is_empty(entry->subsystem_ident)
+         && !string_is_empty(existing->subsystem_ident))
+      return false;
+
+   if (    !string_is_empty(entry->subsystem_ident)
+         && string_is_empty(existing->subsystem_ident))
+      return false;
+
+   if (     !string_is_empty(entry->subsystem_name)
+         && !string_is_empty(existing->subsystem_name)
+         && !string_is_equal(existing->subsystem_name, entry->subsystem_name))
+      return false;
+
+   if (      string_is_empty(entry->subsystem_name)
+         && !string_is_empty(existing->subsystem_name))
+      return false;
+
+   if (     !string_is_empty(entry->subsystem_name)
+         &&  string_is_empty(existing->subsystem_name))
+      return false;
+
+   if (entry->subsystem_roms)
+   {
+      unsigned j;
+      const struct string_list *roms = existing->subsystem_roms;
+
+      if (!roms || entry->subsystem_roms->size != roms->size)
+         return false;
+
+      for (j = 0; j < entry->subsystem_roms->size; j++)
+      {
+         char real_rom_path[PATH_MAX_LENGTH];
+
+         real_rom_path[0] = '\0';
+
+         if (!string_is_empty(entry->subsystem_roms->elems[j].data))
+         {
+            strlcpy(real_rom_path, entry->subsystem_roms->elems[j].data, sizeof(real_rom_path));
+            path_resolve_realpath(real_rom_path, sizeof(real_rom_path), true);
+         }
+
+         if (!playlist_path_equal(real_rom_path, roms->elems[j].data,
+                  &playlist->config))
+            return false;
+      }
+   }
+
+   return true;
 }
 
 bool playlist_push_runtime(playlist_t *playlist,
       const struct playlist_entry *entry)
 {
-   size_t i;
+   struct playlist_key *key = NULL;
    char real_path[PATH_MAX_LENGTH];
    char real_core_path[PATH_MAX_LENGTH];
 
@@ -661,6 +1895,8 @@ bool playlist_push_runtime(playlist_t *playlist,
    if (!playlist || !entry)
       return false;
 
+   playlist_cache_release(playlist);
+
    if (string_is_empty(entry->core_path))
    {
       RARCH_ERR("cannot push NULL or empty core path into the playlist.\n");
@@ -686,21 +1922,11 @@ bool playlist_push_runtime(playlist_t *playlist,
       return false;
    }
 
-   for (i = 0; i < playlist->size; i++)
+   if ((key = playlist_index_find(playlist, real_path,
+               playlist_core_filter, real_core_path)))
    {
       struct playlist_entry tmp;
-      const char *entry_path = playlist->entries[i].path;
-      bool equal_path        =
-         (string_is_empty(real_path) && string_is_empty(entry_path)) ||
-         playlist_path_equal(real_path, entry_path, &playlist->config);
-
-      /* Core name can have changed while still being the same core.
-       * Differentiate based on the core path only. */
-      if (!equal_path)
-         continue;
-
-      if (!playlist_core_path_equal(real_core_path, playlist->entries[i].core_path))
-         continue;
+      size_t i = key->idx;
 
       /* If top entry, we don't want to push a new entry since
        * the top and the entry to be pushed are the same. */
@@ -712,6 +1938,7 @@ bool playlist_push_runtime(playlist_t *playlist,
       memmove(playlist->entries + 1, playlist->entries,
             i * sizeof(struct playlist_entry));
       playlist->entries[0] = tmp;
+      playlist_index_bump(playlist, i);
 
       goto success;
    }
@@ -720,6 +1947,7 @@ bool playlist_push_runtime(playlist_t *playlist,
    {
       struct playlist_entry *last_entry = &playlist->entries[playlist->config.capacity - 1];
 
+      playlist_index_remove(playlist, playlist->config.capacity - 1);
       if (last_entry)
          playlist_free_entry(last_entry);
       playlist->size--;
@@ -727,8 +1955,10 @@ bool playlist_push_runtime(playlist_t *playlist,
 
    if (playlist->entries)
    {
+      /* Only the entries in use need to move down */
       memmove(playlist->entries + 1, playlist->entries,
-            (playlist->config.capacity - 1) * sizeof(struct playlist_entry));
+            playlist->size * sizeof(struct playlist_entry));
+      playlist_index_move(playlist, 1, 0, playlist->size);
 
       playlist->entries[0].path            = NULL;
       playlist->entries[0].core_path       = NULL;
@@ -756,6 +1986,8 @@ bool playlist_push_runtime(playlist_t *playlist,
          playlist->entries[0].runtime_str     = strdup(entry->runtime_str);
       if (!string_is_empty(entry->last_played_str))
          playlist->entries[0].last_played_str = strdup(entry->last_played_str);
+
+      playlist_index_add(playlist, 0);
    }
 
    playlist->size++;
@@ -820,10 +2052,12 @@ bool playlist_push(playlist_t *playlist,
       const struct playlist_entry *entry)
 {
    size_t i;
+   struct playlist_push_filter_data filter_data;
+   struct playlist_key *key = NULL;
    char real_path[PATH_MAX_LENGTH];
    char real_core_path[PATH_MAX_LENGTH];
-   const char *core_name = entry->core_name;
-   bool entry_updated    = false;
+   const char *core_name    = entry->core_name;
+   bool entry_updated       = false;
 
    real_path[0] = '\0';
    real_core_path[0] = '\0';
@@ -831,6 +2065,8 @@ bool playlist_push(playlist_t *playlist,
    if (!playlist || !entry)
       return false;
 
+   playlist_cache_release(playlist);
+
    if (string_is_empty(entry->core_path))
    {
       RARCH_ERR("cannot push NULL or empty core path into the playlist.\n");
@@ -869,80 +2105,14 @@ bool playlist_push(playlist_t *playlist,
       }
    }
 
-   for (i = 0; i < playlist->size; i++)
+   filter_data.entry          = entry;
+   filter_data.real_core_path = real_core_path;
+
+   if ((key = playlist_index_find(playlist, real_path,
+               playlist_push_filter, &filter_data)))
    {
       struct playlist_entry tmp;
-      const char *entry_path = playlist->entries[i].path;
-      bool equal_path        =
-         (string_is_empty(real_path) && string_is_empty(entry_path)) ||
-         playlist_path_equal(real_path, entry_path, &playlist->config);
-
-      /* Core name can have changed while still being the same core.
-       * Differentiate based on the core path only. */
-      if (!equal_path)
-         continue;
-
-      if (!playlist_core_path_equal(real_core_path, playlist->entries[i].core_path))
-         continue;
-
-      if (     !string_is_empty(entry->subsystem_ident)
-            && !string_is_empty(playlist->entries[i].subsystem_ident)
-            && !string_is_equal(playlist->entries[i].subsystem_ident, entry->subsystem_ident))
-         continue;
-
-      if (      string_is_empty(entry->subsystem_ident)
-            && !string_is_empty(playlist->entries[i].subsystem_ident))
-         continue;
-
-      if (    !string_is_empty(entry->subsystem_ident)
-            && string_is_empty(playlist->entries[i].subsystem_ident))
-         continue;
-
-      if (     !string_is_empty(entry->subsystem_name)
-            && !string_is_empty(playlist->entries[i].subsystem_name)
-            && !string_is_equal(playlist->entries[i].subsystem_name, entry->subsystem_name))
-         continue;
-
-      if (      string_is_empty(entry->subsystem_name)
-            && !string_is_empty(playlist->entries[i].subsystem_name))
-         continue;
-
-      if (     !string_is_empty(entry->subsystem_name)
-            &&  string_is_empty(playlist->entries[i].subsystem_name))
-         continue;
-
-      if (entry->subsystem_roms)
-      {
-         unsigned j;
-         const struct string_list *roms = playlist->entries[i].subsystem_roms;
-         bool                   unequal = false;
-
-         if (entry->subsystem_roms->size != roms->size)
-            continue;
-
-         for (j = 0; j < entry->subsystem_roms->size; j++)
-         {
-            char real_rom_path[PATH_MAX_LENGTH];
-
-            real_rom_path[0] = '\0';
-
-            if (!string_is_empty(entry->subsystem_roms->elems[j].data))
-            {
-               strlcpy(real_rom_path, entry->subsystem_roms->elems[j].data, sizeof(real_rom_path));
-               path_resolve_realpath(real_rom_path, sizeof(real_rom_path), true);
-            }
-
-            if (!playlist_path_equal(real_rom_path, roms->elems[j].data,
-                     &playlist->config))
-            {
-               unequal = true;
-               break;
-            }
-         }
-
-         if (unequal)
-            continue;
-      }
+      i = key->idx;
 
       /* If content was previously loaded via file browser
        * or command line, certain entry values will be missing.
@@ -979,6 +2149,7 @@ bool playlist_push(playlist_t *playlist,
       memmove(playlist->entries + 1, playlist->entries,
             i * sizeof(struct playlist_entry));
       playlist->entries[0] = tmp;
+      playlist_index_bump(playlist, i);
 
       goto success;
    }
@@ -988,6 +2159,7 @@ bool playlist_push(playlist_t *playlist,
       struct playlist_entry *last_entry =
          &playlist->entries[playlist->config.capacity - 1];
 
+      playlist_index_remove(playlist, playlist->config.capacity - 1);
       if (last_entry)
          playlist_free_entry(last_entry);
       playlist->size--;
@@ -995,8 +2167,10 @@ bool playlist_push(playlist_t *playlist,
 
    if (playlist->entries)
    {
+      /* Only the entries in use need to move down */
       memmove(playlist->entries + 1, playlist->entries,
-            (playlist->config.capacity - 1) * sizeof(struct playlist_entry));
+            playlist->size * sizeof(struct playlist_entry));
+      playlist_index_move(playlist, 1, 0, playlist->size);
 
       playlist->entries[0].path               = NULL;
       playlist->entries[0].label              = NULL;
@@ -1045,6 +2219,8 @@ bool playlist_push(playlist_t *playlist,
          for (i = 0; i < entry->subsystem_roms->size; i++)
             string_list_append(playlist->entries[0].subsystem_roms, entry->subsystem_roms->elems[i].data, attributes);
       }
+
+      playlist_index_add(playlist, 0);
    }
 
    playlist->size++;
@@ -1334,6 +2510,7 @@ void playlist_write_file(playlist_t *playlist)
    size_t i;
    intfstream_t *file = NULL;
    bool compressed    = false;
+   bool written       = false;
 
    /* Playlist will be written if any of the
     * following are true:
@@ -1350,6 +2527,8 @@ void playlist_write_file(playlist_t *playlist)
         (playlist->old_format != playlist->config.old_format)))
       return;
 
+   playlist_cache_decode_all(playlist);
+
 #if defined(HAVE_ZLIB)
    if (playlist->config.compress)
       file = intfstream_open_rzip_file(playlist->config.path,
@@ -1731,11 +2910,22 @@ void playlist_write_file(playlist_t *playlist)
 
    playlist->modified   = false;
    playlist->compressed = compressed;
+   written              = true;
 
    RARCH_LOG("[Playlist]: Written to playlist file: %s\n", playlist->config.path);
 end:
    intfstream_close(file);
    free(file);
+
+   /* Keep the sidecar in step with the file, or out of
+    * the way if it is not wanted */
+   if (written)
+   {
+      if (playlist->config.binary_cache && !playlist->old_format)
+         playlist_cache_write(playlist);
+      else
+         playlist_delete_cache_file(playlist->config.path);
+   }
 }
 
 /**
@@ -1759,6 +2949,9 @@ void playlist_free(playlist_t *playlist)
       free(playlist->default_core_name);
    playlist->default_core_name = NULL;
 
+   playlist_index_clear(playlist);
+   playlist_cache_discard(playlist);
+
    for (i = 0; i < playlist->size; i++)
    {
       struct playlist_entry *entry = &playlist->entries[i];
@@ -1785,6 +2978,9 @@ void playlist_clear(playlist_t *playlist)
    if (!playlist)
       return;
 
+   playlist_index_clear(playlist);
+   playlist_cache_discard(playlist);
+
    for (i = 0; i < playlist->size; i++)
    {
       struct playlist_entry *entry = &playlist->entries[i];
@@ -2171,15 +3367,22 @@ static bool playlist_read_file(playlist_t *playlist)
 {
    unsigned i;
    int test_char;
+   intfstream_t *file   = NULL;
+   bool write_cache     = false;
+
+   /* Skip parsing altogether if the sidecar is current */
+   if (playlist->config.binary_cache && playlist_cache_load(playlist))
+      return true;
+
 #if defined(HAVE_ZLIB)
       /* Always use RZIP interface when reading playlists
        * > this will automatically handle uncompressed
        *   data */
-   intfstream_t *file   = intfstream_open_rzip_file(
+   file                 = intfstream_open_rzip_file(
          playlist->config.path,
          RETRO_VFS_FILE_ACCESS_READ);
 #else
-   intfstream_t *file   = intfstream_open_file(
+   file                 = intfstream_open_file(
          playlist->config.path,
          RETRO_VFS_FILE_ACCESS_READ,
          RETRO_VFS_FILE_ACCESS_HINT_NONE);
@@ -2295,6 +3498,11 @@ static bool playlist_read_file(playlist_t *playlist)
          goto json_cleanup;
       }
 
+      /* Sidecar is missing or stale - replace it, provided
+       * that the whole playlist made it into memory */
+      write_cache = playlist->config.binary_cache
+         && !context.capacity_exceeded;
+
 json_cleanup:
 
       JSON_Parser_Free(context.parser);
@@ -2500,6 +3708,9 @@ json_cleanup:
 end:
    intfstream_close(file);
    free(file);
+
+   if (write_cache)
+      playlist_cache_write(playlist);
    return true;
 }
 
@@ -2568,6 +3779,15 @@ playlist_t *playlist_init(const playlist_config_t *config)
    playlist->default_core_name    = NULL;
    playlist->default_core_path    = NULL;
    playlist->entries              = entries;
+   memset(&playlist->cache, 0, sizeof(playlist->cache));
+   playlist->index_built          = false;
+   playlist->keys                 = NULL;
+   playlist->buckets              = NULL;
+   playlist->archive_buckets      = NULL;
+   playlist->bucket_count         = 0;
+   playlist->key_count            = 0;
+   playlist->cache_decoded        = NULL;
+   playlist->cache_pending        = 0;
    playlist->label_display_mode   = LABEL_DISPLAY_MODE_DEFAULT;
    playlist->right_thumbnail_mode = PLAYLIST_THUMBNAIL_MODE_DEFAULT;
    playlist->left_thumbnail_mode  = PLAYLIST_THUMBNAIL_MODE_DEFAULT;
@@ -2664,17 +3884,63 @@ end:
    return ret;
 }
 
+/* Sorted in place of a bare entry when the path index is up,
+ * so that each key travels with its entry. The entry comes
+ * first, which lets playlist_qsort_func() compare these too. */
+struct playlist_sort_item
+{
+   struct playlist_entry entry;
+   struct playlist_key *key;
+};
+
 void playlist_qsort(playlist_t *playlist)
 {
+   size_t i;
+   struct playlist_sort_item *items = NULL;
+
    /* Avoid inadvertent sorting if 'sort mode'
     * has been set explicitly to PLAYLIST_SORT_MODE_OFF */
    if (!playlist ||
        (playlist->sort_mode == PLAYLIST_SORT_MODE_OFF))
       return;
 
-   qsort(playlist->entries, playlist->size,
-         sizeof(struct playlist_entry),
+   playlist_cache_decode_all(playlist);
+
+   if (playlist->index_built && playlist->size > 1)
+   {
+      items = (struct playlist_sort_item*)malloc(
+            playlist->size * sizeof(*items));
+
+      /* No room to carry the keys along - drop them */
+      if (!items)
+         playlist_index_clear(playlist);
+   }
+
+   if (!items)
+   {
+      qsort(playlist->entries, playlist->size,
+            sizeof(struct playlist_entry),
+            (int (*)(const void *, const void *))playlist_qsort_func);
+      return;
+   }
+
+   for (i = 0; i < playlist->size; i++)
+   {
+      items[i].entry = playlist->entries[i];
+      items[i].key   = playlist->keys[i];
+   }
+
+   qsort(items, playlist->size, sizeof(*items),
          (int (*)(const void *, const void *))playlist_qsort_func);
+
+   for (i = 0; i < playlist->size; i++)
+   {
+      playlist->entries[i] = items[i].entry;
+      playlist->keys[i]    = items[i].key;
+      items[i].key->idx    = i;
+   }
+
+   free(items);
 }
 
 void command_playlist_push_write(
@@ -2715,6 +3981,8 @@ bool playlist_index_is_valid(playlist_t *playlist, size_t idx,
    if (idx >= playlist->size)
       return false;
 
+   playlist_cache_decode(playlist, idx);
+
    return string_is_equal(playlist->entries[idx].path, path) &&
           string_is_equal(path_basename(playlist->entries[idx].core_path), path_basename(core_path));
 }
@@ -2769,6 +4037,8 @@ void playlist_get_crc32(playlist_t *playlist, size_t idx,
    if (!playlist)
       return;
 
+   playlist_cache_decode(playlist, idx);
+
    if (crc32)
       *crc32 = playlist->entries[idx].crc32;
 }
@@ -2779,6 +4049,8 @@ void playlist_get_db_name(playlist_t *playlist, size_t idx,
    if (!playlist)
       return;
 
+   playlist_cache_decode(playlist, idx);
+
    if (db_name)
    {
       if (!string_is_empty(playlist->entries[idx].db_name))
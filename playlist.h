@@ -123,6 +123,9 @@ typedef struct
    bool old_format;
    bool compress;
    bool fuzzy_archive_match;
+   /* Keep a binary sidecar next to the playlist
+    * file, and load from it when it is current */
+   bool binary_cache;
 } playlist_config_t;
 
 /* Convenience function: copies specified playlist
@@ -268,6 +271,10 @@ void playlist_write_file(playlist_t *playlist);
 
 void playlist_write_runtime_file(playlist_t *playlist);
 
+/* Deletes the binary cache kept alongside the
+ * playlist file at 'path', if there is one */
+void playlist_delete_cache_file(const char *path);
+
 void playlist_qsort(playlist_t *playlist);
 
 void playlist_free_cached(void);
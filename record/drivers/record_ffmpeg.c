@@ -67,6 +67,18 @@ extern "C" {
 
 #include "../../retroarch.h"
 #include "../../verbosity.h"
+#include "../record_frame_pool.h"
+
+/* Full barrier between handing over work and checking for a waiter,
+ * and between announcing a wait and checking for work. Without one,
+ * every hand-over takes the lock. */
+#if defined(__clang__) || (defined(__GNUC__) \
+      && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 7)))
+#define FFMPEG_MEMORY_BARRIER() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#elif defined(_MSC_VER) && !defined(_XBOX)
+#include <windows.h>
+#define FFMPEG_MEMORY_BARRIER() MemoryBarrier()
+#endif
 
 #ifndef AV_CODEC_FLAG_QSCALE
 #define AV_CODEC_FLAG_QSCALE CODEC_FLAG_QSCALE
@@ -239,12 +251,13 @@ typedef struct ffmpeg
    slock_t *cond_lock;
    slock_t *lock;
    fifo_buffer_t *audio_fifo;
-   fifo_buffer_t *video_fifo;
-   fifo_buffer_t *attr_fifo;
+   record_frame_pool_t *frames;
    sthread_t *thread;
 
    volatile bool alive;
-   volatile bool can_sleep;
+   /* Threads in or about to be in scond_wait. Only changed
+    * under cond_lock. */
+   volatile unsigned waiting;
 } ffmpeg_t;
 
 AVFormatContext *ctx;
@@ -932,17 +945,18 @@ static bool init_thread(ffmpeg_t *handle)
    handle->cond = scond_new();
    handle->audio_fifo = fifo_new(32000 * sizeof(int16_t) *
          handle->params.channels * MAX_FRAMES / 60); /* Some arbitrary max size. */
-   handle->attr_fifo = fifo_new(sizeof(struct record_video_data) * MAX_FRAMES);
-   handle->video_fifo = fifo_new(handle->params.fb_width * handle->params.fb_height *
-            handle->video.pix_size * MAX_FRAMES);
+   /* FFmpeg has a tendency to crash if the last row
+    * of a frame isn't followed by a bit of slack. */
+   handle->frames = record_frame_pool_new(MAX_FRAMES,
+         (handle->params.fb_height + 1) * handle->params.fb_width *
+         handle->video.pix_size + 64);
 
    handle->alive = true;
-   handle->can_sleep = true;
    handle->thread = sthread_create(ffmpeg_thread, handle);
 
    retro_assert(handle->lock && handle->cond_lock &&
       handle->cond && handle->audio_fifo &&
-      handle->attr_fifo && handle->video_fifo && handle->thread);
+      handle->frames && handle->thread);
 
    return true;
 }
@@ -954,10 +968,9 @@ static void deinit_thread(ffmpeg_t *handle)
 
    slock_lock(handle->cond_lock);
    handle->alive = false;
-   handle->can_sleep = false;
+   scond_broadcast(handle->cond);
    slock_unlock(handle->cond_lock);
 
-   scond_signal(handle->cond);
    sthread_join(handle->thread);
 
    slock_free(handle->lock);
@@ -975,16 +988,19 @@ static void deinit_thread_buf(ffmpeg_t *handle)
       handle->audio_fifo = NULL;
    }
 
-   if (handle->attr_fifo)
+   if (handle->frames)
    {
-      fifo_free(handle->attr_fifo);
-      handle->attr_fifo = NULL;
-   }
+      struct record_stats stats;
 
-   if (handle->video_fifo)
-   {
-      fifo_free(handle->video_fifo);
-      handle->video_fifo = NULL;
+      record_frame_pool_get_stats(handle->frames, &stats);
+      if (stats.dropped || stats.skipped)
+         RARCH_WARN("[FFmpeg]: %llu of %llu frames dropped, %llu skipped.\n",
+               (unsigned long long)stats.dropped,
+               (unsigned long long)stats.pushed,
+               (unsigned long long)stats.skipped);
+
+      record_frame_pool_free(handle->frames);
+      handle->frames = NULL;
    }
 }
 
@@ -1096,14 +1112,52 @@ error:
    return NULL;
 }
 
+/* Wakes up whichever thread waits on the other, if one does.
+ * Called after handing over work. */
+static void ffmpeg_wake(ffmpeg_t *handle)
+{
+#ifdef FFMPEG_MEMORY_BARRIER
+   FFMPEG_MEMORY_BARRIER();
+   if (!handle->waiting)
+      return;
+#endif
+
+   slock_lock(handle->cond_lock);
+   scond_broadcast(handle->cond);
+   slock_unlock(handle->cond_lock);
+}
+
+/* Called with cond_lock held, before checking for work a last time.
+ * Either the waker's check sees us, or our check sees its work. */
+static void ffmpeg_wait_begin(ffmpeg_t *handle)
+{
+   handle->waiting++;
+#ifdef FFMPEG_MEMORY_BARRIER
+   FFMPEG_MEMORY_BARRIER();
+#endif
+}
+
+static void ffmpeg_wait_end(ffmpeg_t *handle)
+{
+   handle->waiting--;
+}
+
+static bool ffmpeg_audio_avail(ffmpeg_t *handle, size_t size)
+{
+   size_t avail;
+
+   slock_lock(handle->lock);
+   avail = FIFO_READ_AVAIL(handle->audio_fifo);
+   slock_unlock(handle->lock);
+
+   return avail >= size;
+}
+
 static bool ffmpeg_push_video(void *data,
       const struct record_video_data *vid)
 {
-   unsigned y;
-   struct record_video_data attr_data;
    bool drop_frame  = false;
    ffmpeg_t *handle = (ffmpeg_t*)data;
-   int       offset = 0;
 
    if (!handle || !vid)
       return false;
@@ -1116,60 +1170,29 @@ static bool ffmpeg_push_video(void *data,
    if (drop_frame)
       return true;
 
-   for (;;)
-   {
-      unsigned avail;
-
-      slock_lock(handle->lock);
-      avail = FIFO_WRITE_AVAIL(handle->attr_fifo);
-      slock_unlock(handle->lock);
-
-      if (!handle->alive)
-         return false;
-
-      if (avail >= sizeof(*vid))
-         break;
-
-      slock_lock(handle->cond_lock);
-      if (handle->can_sleep)
-      {
-         handle->can_sleep = false;
-         scond_wait(handle->cond, handle->cond_lock);
-         handle->can_sleep = true;
-      }
-      else
-         scond_signal(handle->cond);
-
-      slock_unlock(handle->cond_lock);
-   }
-
-   slock_lock(handle->lock);
-
-   /* Tightly pack our frame to conserve memory.
-    * libretro tends to use a very large pitch.
-    */
-   attr_data = *vid;
-
-   if (attr_data.is_dupe)
-      attr_data.width = attr_data.height = attr_data.pitch = 0;
-   else
-      attr_data.pitch = attr_data.width * handle->video.pix_size;
+   if (!handle->alive)
+      return false;
 
-   fifo_write(handle->attr_fifo, &attr_data, sizeof(attr_data));
+   /* Never waits for the encoder; if it falls behind,
+    * the pool drops frames rather than stall the core. */
+   record_frame_pool_push(handle->frames, vid, handle->video.pix_size);
+   ffmpeg_wake(handle);
 
-   for (y = 0; y < attr_data.height; y++, offset += vid->pitch)
-      fifo_write(handle->video_fifo,
-            (const uint8_t*)vid->data + offset, attr_data.pitch);
+   return true;
+}
 
-   slock_unlock(handle->lock);
-   scond_signal(handle->cond);
+static void ffmpeg_get_stats(void *data, struct record_stats *stats)
+{
+   ffmpeg_t *handle = (ffmpeg_t*)data;
 
-   return true;
+   if (handle && handle->frames)
+      record_frame_pool_get_stats(handle->frames, stats);
 }
 
 static bool ffmpeg_push_audio(void *data,
       const struct record_audio_data *audio_data)
 {
+   size_t size;
    ffmpeg_t *handle = (ffmpeg_t*)data;
 
    if (!handle || !audio_data)
@@ -1178,39 +1201,33 @@ static bool ffmpeg_push_audio(void *data,
    if (!handle->config.audio_enable)
       return true;
 
+   size = audio_data->frames * handle->params.channels * sizeof(int16_t);
+
+   slock_lock(handle->cond_lock);
+   ffmpeg_wait_begin(handle);
    for (;;)
    {
-      unsigned avail;
+      size_t avail;
 
       slock_lock(handle->lock);
       avail = FIFO_WRITE_AVAIL(handle->audio_fifo);
       slock_unlock(handle->lock);
 
-      if (!handle->alive)
-         return false;
-
-      if (avail >= audio_data->frames * handle->params.channels
-            * sizeof(int16_t))
+      if (!handle->alive || avail >= size)
          break;
 
-      slock_lock(handle->cond_lock);
-      if (handle->can_sleep)
-      {
-         handle->can_sleep = false;
-         scond_wait(handle->cond, handle->cond_lock);
-         handle->can_sleep = true;
-      }
-      else
-         scond_signal(handle->cond);
-
-      slock_unlock(handle->cond_lock);
+      scond_wait(handle->cond, handle->cond_lock);
    }
+   ffmpeg_wait_end(handle);
+   slock_unlock(handle->cond_lock);
+
+   if (!handle->alive)
+      return false;
 
    slock_lock(handle->lock);
-   fifo_write(handle->audio_fifo, audio_data->data,
-         audio_data->frames * handle->params.channels * sizeof(int16_t));
+   fifo_write(handle->audio_fifo, audio_data->data, size);
    slock_unlock(handle->lock);
-   scond_signal(handle->cond);
+   ffmpeg_wake(handle);
 
    return true;
 }
@@ -1605,8 +1622,6 @@ static void ffmpeg_flush_buffers(ffmpeg_t *handle)
 {
    void *audio_buf       = NULL;
    bool did_work         = false;
-   void *video_buf       = av_malloc(2 * handle->params.fb_width *
-         handle->params.fb_height * handle->video.pix_size);
    size_t audio_buf_size = handle->config.audio_enable ?
       (handle->audio.codec->frame_size *
        handle->params.channels * sizeof(int16_t)) : 0;
@@ -1618,7 +1633,7 @@ static void ffmpeg_flush_buffers(ffmpeg_t *handle)
 
    do
    {
-      struct record_video_data attr_buf;
+      struct record_frame *frame = NULL;
 
       did_work = false;
 
@@ -1637,13 +1652,10 @@ static void ffmpeg_flush_buffers(ffmpeg_t *handle)
          }
       }
 
-      if (FIFO_READ_AVAIL(handle->attr_fifo) >= sizeof(attr_buf))
+      if ((frame = record_frame_pool_pop(handle->frames)))
       {
-         fifo_read(handle->attr_fifo, &attr_buf, sizeof(attr_buf));
-         fifo_read(handle->video_fifo, video_buf,
-               attr_buf.height * attr_buf.pitch);
-         attr_buf.data = video_buf;
-         ffmpeg_push_video_thread(handle, &attr_buf);
+         ffmpeg_push_video_thread(handle, &frame->video);
+         record_frame_pool_release(handle->frames, frame);
 
          did_work = true;
       }
@@ -1656,7 +1668,6 @@ static void ffmpeg_flush_buffers(ffmpeg_t *handle)
    /* Flush out last video. */
    ffmpeg_flush_video(handle);
 
-   av_free(video_buf);
    av_free(audio_buf);
 }
 
@@ -1686,12 +1697,6 @@ static void ffmpeg_thread(void *data)
    size_t audio_buf_size;
    void *audio_buf = NULL;
    ffmpeg_t *ff    = (ffmpeg_t*)data;
-   /* For some reason, FFmpeg has a tendency to crash
-    * if we don't overallocate a bit. */
-   void *video_buf = av_malloc(2 * ff->params.fb_width *
-         ff->params.fb_height * ff->video.pix_size);
-
-   retro_assert(video_buf);
 
    audio_buf_size = ff->config.audio_enable ?
       (ff->audio.codec->frame_size * ff->params.channels * sizeof(int16_t)) : 0;
@@ -1699,46 +1704,30 @@ static void ffmpeg_thread(void *data)
 
    while (ff->alive)
    {
-      struct record_video_data attr_buf;
-
-      bool avail_video = false;
-      bool avail_audio = false;
+      struct record_frame *frame = record_frame_pool_pop(ff->frames);
+      bool avail_audio           = ff->config.audio_enable
+         && ffmpeg_audio_avail(ff, audio_buf_size);
 
-      slock_lock(ff->lock);
-      if (FIFO_READ_AVAIL(ff->attr_fifo) >= sizeof(attr_buf))
-         avail_video = true;
-
-      if (ff->config.audio_enable)
-         if (FIFO_READ_AVAIL(ff->audio_fifo) >= audio_buf_size)
-            avail_audio = true;
-      slock_unlock(ff->lock);
-
-      if (!avail_video && !avail_audio)
+      if (!frame && !avail_audio)
       {
+         /* Both checks are repeated under cond_lock once we count
+          * as waiting, so no wakeup is missed. */
          slock_lock(ff->cond_lock);
-         if (ff->can_sleep)
-         {
-            ff->can_sleep = false;
+         ffmpeg_wait_begin(ff);
+         while (ff->alive
+               && !(frame = record_frame_pool_pop(ff->frames))
+               && !(avail_audio = ff->config.audio_enable
+                  && ffmpeg_audio_avail(ff, audio_buf_size)))
             scond_wait(ff->cond, ff->cond_lock);
-            ff->can_sleep = true;
-         }
-         else
-            scond_signal(ff->cond);
-
+         ffmpeg_wait_end(ff);
          slock_unlock(ff->cond_lock);
       }
 
-      if (avail_video && video_buf)
+      if (frame)
       {
-         slock_lock(ff->lock);
-         fifo_read(ff->attr_fifo, &attr_buf, sizeof(attr_buf));
-         fifo_read(ff->video_fifo, video_buf,
-               attr_buf.height * attr_buf.pitch);
-         slock_unlock(ff->lock);
-         scond_signal(ff->cond);
-
-         attr_buf.data = video_buf;
-         ffmpeg_push_video_thread(ff, &attr_buf);
+         /* Encoded straight from the pool buffer */
+         ffmpeg_push_video_thread(ff, &frame->video);
+         record_frame_pool_release(ff->frames, frame);
       }
 
       if (avail_audio && audio_buf)
@@ -1748,7 +1737,7 @@ static void ffmpeg_thread(void *data)
          slock_lock(ff->lock);
          fifo_read(ff->audio_fifo, audio_buf, audio_buf_size);
          slock_unlock(ff->lock);
-         scond_signal(ff->cond);
+         ffmpeg_wake(ff);
 
          aud.frames = ff->audio.codec->frame_size;
          aud.data   = audio_buf;
@@ -1757,7 +1746,6 @@ static void ffmpeg_thread(void *data)
       }
    }
 
-   av_free(video_buf);
    av_free(audio_buf);
 }
 
@@ -1767,5 +1755,6 @@ const record_driver_t record_ffmpeg = {
    ffmpeg_push_video,
    ffmpeg_push_audio,
    ffmpeg_finalize,
+   ffmpeg_get_stats,
    "ffmpeg",
 };
@@ -0,0 +1,187 @@
+/*  RetroArch - A frontend for libretro.
+ *  Copyright (C) 2010-2014 - Hans-Kristian Arntzen
+ *  Copyright (C) 2011-2017 - Daniel De Matteis
+ *
+ *  RetroArch is free software: you can redistribute it and/or modify it under the terms
+ *  of the GNU General Public License as published by the Free Software Found-
+ *  ation, either version 3 of the License, or (at your option) any later version.
+ *
+ *  RetroArch is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ *  PURPOSE.  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with RetroArch.
+ *  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <memalign.h>
+#include <queues/spsc_queue.h>
+
+#include "record_frame_pool.h"
+
+/* Buffers start on their own cache line, which also suits the
+ * encoder's SIMD scalers */
+#define RECORD_FRAME_POOL_ALIGN 64
+
+struct record_frame_pool
+{
+   struct record_frame *frames;
+   uint8_t *buffer;
+   size_t frame_size;
+   unsigned count;
+
+   /* Queued in place of a frame that had no free buffer */
+   struct record_frame dupe;
+
+   /* Main thread -> encoder */
+   spsc_queue_t *ready;
+   /* Encoder -> main thread */
+   spsc_queue_t *free;
+
+   /* Written by the main thread only */
+   uint64_t pushed;
+   uint64_t dropped;
+   uint64_t skipped;
+};
+
+record_frame_pool_t *record_frame_pool_new(unsigned count,
+      size_t frame_size)
+{
+   unsigned i;
+   size_t stride;
+   record_frame_pool_t *pool = NULL;
+
+   if (!count || !frame_size)
+      return NULL;
+
+   pool = (record_frame_pool_t*)calloc(1, sizeof(*pool));
+   if (!pool)
+      return NULL;
+
+   stride            = (frame_size + RECORD_FRAME_POOL_ALIGN - 1)
+      & ~(size_t)(RECORD_FRAME_POOL_ALIGN - 1);
+
+   pool->count       = count;
+   pool->frame_size  = frame_size;
+   pool->frames      = (struct record_frame*)
+      calloc(count, sizeof(*pool->frames));
+   pool->buffer      = (uint8_t*)memalign_alloc(RECORD_FRAME_POOL_ALIGN,
+         stride * count);
+   /* Every buffer can be queued, and as many repeats besides */
+   pool->ready       = spsc_queue_new(2 * count);
+   pool->free        = spsc_queue_new(count);
+
+   pool->dupe.video.is_dupe = true;
+
+   if (!pool->frames || !pool->buffer || !pool->ready || !pool->free)
+   {
+      record_frame_pool_free(pool);
+      return NULL;
+   }
+
+   for (i = 0; i < count; i++)
+   {
+      pool->frames[i].data = pool->buffer + i * stride;
+      spsc_queue_push(pool->free, &pool->frames[i]);
+   }
+
+   return pool;
+}
+
+void record_frame_pool_free(record_frame_pool_t *pool)
+{
+   if (!pool)
+      return;
+
+   spsc_queue_free(pool->ready);
+   spsc_queue_free(pool->free);
+   if (pool->buffer)
+      memalign_free(pool->buffer);
+   free(pool->frames);
+   free(pool);
+}
+
+static void record_frame_copy(struct record_frame *frame,
+      const struct record_video_data *video, unsigned pix_size)
+{
+   unsigned y;
+   size_t row_size      = video->width * pix_size;
+   const uint8_t *src   = (const uint8_t*)video->data;
+   uint8_t *dst         = frame->data;
+
+   /* The pitch may be negative for bottom-up frames */
+   for (y = 0; y < video->height; y++, src += video->pitch, dst += row_size)
+      memcpy(dst, src, row_size);
+
+   frame->video.data    = frame->data;
+   frame->video.width   = video->width;
+   frame->video.height  = video->height;
+   frame->video.pitch   = (int)row_size;
+   frame->video.is_dupe = false;
+}
+
+bool record_frame_pool_push(record_frame_pool_t *pool,
+      const struct record_video_data *video, unsigned pix_size)
+{
+   void *item                 = NULL;
+   struct record_frame *frame = &pool->dupe;
+
+   pool->pushed++;
+
+   /* Only this thread fills the ready queue, so this cannot go stale
+    * before the push below. Checked first, as a buffer taken from the
+    * free queue could not be handed back from this side. */
+   if (spsc_queue_size(pool->ready) >= spsc_queue_capacity(pool->ready))
+   {
+      pool->skipped++;
+      return false;
+   }
+
+   if (!video->is_dupe && video->data)
+   {
+      if ((size_t)video->width * video->height * pix_size > pool->frame_size)
+      {
+         pool->skipped++;
+         return false;
+      }
+
+      if (spsc_queue_pop(pool->free, &item))
+      {
+         frame = (struct record_frame*)item;
+         record_frame_copy(frame, video, pix_size);
+      }
+      else
+         pool->dropped++;
+   }
+
+   spsc_queue_push(pool->ready, frame);
+   return true;
+}
+
+struct record_frame *record_frame_pool_pop(record_frame_pool_t *pool)
+{
+   void *item = NULL;
+   if (!spsc_queue_pop(pool->ready, &item))
+      return NULL;
+   return (struct record_frame*)item;
+}
+
+void record_frame_pool_release(record_frame_pool_t *pool,
+      struct record_frame *frame)
+{
+   if (frame && frame != &pool->dupe)
+      spsc_queue_push(pool->free, frame);
+}
+
+void record_frame_pool_get_stats(record_frame_pool_t *pool,
+      struct record_stats *stats)
+{
+   stats->queued     = (unsigned)spsc_queue_size(pool->ready);
+   stats->queue_size = (unsigned)spsc_queue_capacity(pool->ready);
+   stats->pushed     = pool->pushed;
+   stats->dropped    = pool->dropped;
+   stats->skipped    = pool->skipped;
+}
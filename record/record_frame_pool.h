@@ -0,0 +1,96 @@
+/*  RetroArch - A frontend for libretro.
+ *  Copyright (C) 2010-2014 - Hans-Kristian Arntzen
+ *  Copyright (C) 2011-2017 - Daniel De Matteis
+ *
+ *  RetroArch is free software: you can redistribute it and/or modify it under the terms
+ *  of the GNU General Public License as published by the Free Software Found-
+ *  ation, either version 3 of the License, or (at your option) any later version.
+ *
+ *  RetroArch is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ *  PURPOSE.  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with RetroArch.
+ *  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __RECORD_FRAME_POOL_H
+#define __RECORD_FRAME_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <boolean.h>
+#include <retro_common_api.h>
+
+#include "../retroarch.h"
+
+RETRO_BEGIN_DECLS
+
+/* Hands video frames from the main thread to a recording driver's
+ * encoder thread.
+ *
+ * A fixed set of frame buffers moves between two single-producer,
+ * single-consumer queues: the main thread takes a free buffer, copies
+ * the frame into it and queues it as ready; the encoder works on it in
+ * place and gives it back. A buffer belongs to exactly one thread at a
+ * time, and neither side ever takes a lock or waits on the other.
+ *
+ * When the encoder falls behind and no buffer is free, the frame is
+ * dropped and queued as a repeat of the previous one instead, which
+ * keeps the video in step with the audio. Only if the queue itself is
+ * full is a frame skipped outright. Both are counted. */
+typedef struct record_frame_pool record_frame_pool_t;
+
+struct record_frame
+{
+   /* Points into the pool for copied frames. is_dupe is set for
+    * repeats of the previous frame, which carry no data. */
+   struct record_video_data video;
+   uint8_t *data;
+};
+
+/**
+ * record_frame_pool_new:
+ * @count              : Number of frame buffers.
+ * @frame_size         : Size of each buffer; the largest frame's
+ *                       width * height * pixel size.
+ *
+ * Returns: the pool, or NULL on failure.
+ **/
+record_frame_pool_t *record_frame_pool_new(unsigned count,
+      size_t frame_size);
+
+/* Neither thread may use the pool any more */
+void record_frame_pool_free(record_frame_pool_t *pool);
+
+/**
+ * record_frame_pool_push:
+ * @pool               : Pool to push to. Producer thread only.
+ * @video              : Frame to copy, tightly packed, into the pool.
+ * @pix_size           : Bytes per pixel.
+ *
+ * Returns: false if the frame was skipped.
+ **/
+bool record_frame_pool_push(record_frame_pool_t *pool,
+      const struct record_video_data *video, unsigned pix_size);
+
+/**
+ * record_frame_pool_pop:
+ * @pool               : Pool to pop from. Consumer thread only.
+ *
+ * Returns: the oldest queued frame, or NULL if there is none. Must be
+ * given back with record_frame_pool_release() once encoded.
+ **/
+struct record_frame *record_frame_pool_pop(record_frame_pool_t *pool);
+
+void record_frame_pool_release(record_frame_pool_t *pool,
+      struct record_frame *frame);
+
+/* Producer thread only */
+void record_frame_pool_get_stats(record_frame_pool_t *pool,
+      struct record_stats *stats);
+
+RETRO_END_DECLS
+
+#endif
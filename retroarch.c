@@ -97,6 +97,9 @@
 #include <compat/posix_string.h>
 #include <streams/file_stream.h>
 #include <streams/interface_stream.h>
+#ifdef HAVE_CHD
+#include <streams/chd_stream.h>
+#endif
 #include <file/file_path.h>
 #include <retro_assert.h>
 #include <retro_miscellaneous.h>
@@ -188,6 +191,7 @@
 #include "network/netplay/netplay.h"
 #include "network/netplay/netplay_private.h"
 #include "network/netplay/netplay_discovery.h"
+#include "network/netplay/netplay_relay.h"
 #endif
 
 #ifdef HAVE_THREADS
@@ -235,6 +239,7 @@
 #endif
 #ifdef HAVE_REWIND
 #include "managers/state_manager.h"
+#include "managers/savestate_pool.h"
 #endif
 #ifdef HAVE_AUDIOMIXER
 #include "tasks/task_audio_mixer.h"
@@ -1018,6 +1023,7 @@ static const record_driver_t record_null = {
    NULL, /* push_video */
    NULL, /* push_audio */
    NULL, /* finalize */
+   NULL, /* get_stats */
    "null",
 };
 
@@ -1499,6 +1505,7 @@ enum
    RA_OPT_STATELESS,
    RA_OPT_CHECK_FRAMES,
    RA_OPT_PORT,
+   RA_OPT_RELAY,
    RA_OPT_SPECTATE,
    RA_OPT_NICK,
    RA_OPT_COMMAND,
@@ -2527,7 +2534,7 @@ struct rarch_state
    void *audio_driver_context_audio_data;
 
 #ifdef HAVE_RUNAHEAD
-   my_list *runahead_save_state_list;
+   savestate_buf_t *runahead_save_state;
    my_list *input_state_list;
 
    function_t retro_reset_callback_original;
@@ -2570,6 +2577,8 @@ struct rarch_state
 #ifdef HAVE_NETWORKING
    /* Used while Netplay is running */
    netplay_t *netplay_data;
+   /* Used while relaying a server with --relay */
+   netplay_relay_t *netplay_relay;
 #endif
 #if defined(HAVE_CG) || defined(HAVE_GLSL) || defined(HAVE_SLANG) || defined(HAVE_HLSL)
    struct video_shader *menu_driver_shader;
@@ -6503,6 +6512,32 @@ static bool menu_init(struct rarch_state *p_rarch)
 
    gfx_display_init();
 
+   /* Opened once and kept until exit, since image load tasks
+    * may still be using it after the menu is torn down */
+   if (     !p_rarch->gfx_thumb_state.cache
+         && settings->uints.gfx_thumbnail_cache_size > 0)
+   {
+      char cache_dir[PATH_MAX_LENGTH];
+      const char *base_dir =
+         !string_is_empty(settings->paths.directory_cache)
+         ? settings->paths.directory_cache
+         : settings->paths.directory_thumbnails;
+
+      cache_dir[0] = '\0';
+
+      if (!string_is_empty(base_dir))
+      {
+         fill_pathname_join(cache_dir, base_dir, "thumbnail_cache",
+               sizeof(cache_dir));
+         p_rarch->gfx_thumb_state.cache = gfx_thumbnail_cache_new(
+               cache_dir,
+               (uint64_t)settings->uints.gfx_thumbnail_cache_size << 20);
+      }
+
+      if (!p_rarch->gfx_thumb_state.cache)
+         RARCH_WARN("[Thumbnails]: Failed to open thumbnail cache.\n");
+   }
+
    return true;
 }
 
@@ -9863,9 +9898,22 @@ static bool netplay_pre_frame(struct rarch_state *p_rarch,
        ((!netplay->is_server || (netplay->connected_players>1)) &&
         (netplay->stall || netplay->remote_paused)))
    {
+      size_t i;
+
       /* We may have received data even if we're stalled, so run post-frame
        * sync */
       netplay_sync_post_frame(netplay, true);
+
+      /* No input goes out while we're stalled, so keep any savestates
+       * moving by themselves */
+      for (i = 0; i < netplay->connections_size; i++)
+      {
+         struct netplay_connection *connection = &netplay->connections[i];
+         if (connection->active &&
+             connection->mode >= NETPLAY_CONNECTION_CONNECTED &&
+             !netplay_send_savestate_chunks(netplay, connection))
+            netplay_hangup(netplay, connection);
+      }
       return false;
    }
    return true;
@@ -9965,6 +10013,19 @@ void netplay_send_savestate(netplay_t *netplay,
    uint32_t rd, wn;
    size_t i;
 
+   /* Peers taking diffs get theirs from netplay_send_savestate_delta */
+   for (i = 0; i < netplay->connections_size; i++)
+   {
+      struct netplay_connection *connection = &netplay->connections[i];
+      if (connection->active &&
+          connection->mode >= NETPLAY_CONNECTION_CONNECTED &&
+          connection->compression_supported == cx &&
+          !connection->savestate_delta)
+         break;
+   }
+   if (i == netplay->connections_size)
+      return;
+
    /* Compress it */
    z->compression_backend->set_in(z->compression_stream,
       (const uint8_t*)serial_info->data_const, (uint32_t)serial_info->size);
@@ -9990,7 +10051,8 @@ void netplay_send_savestate(netplay_t *netplay,
       struct netplay_connection *connection = &netplay->connections[i];
       if (!connection->active ||
           connection->mode < NETPLAY_CONNECTION_CONNECTED ||
-          connection->compression_supported != cx) continue;
+          connection->compression_supported != cx ||
+          connection->savestate_delta) continue;
 
       if (!netplay_send(&connection->send_packet_buffer, connection->fd, header,
             sizeof(header)) ||
@@ -10013,6 +10075,7 @@ void netplay_send_savestate(netplay_t *netplay,
 void netplay_load_savestate(netplay_t *netplay,
       retro_ctx_serialize_info_t *serial_info, bool save)
 {
+   size_t i;
    retro_ctx_serialize_info_t tmp_serial_info;
 
    netplay_force_future(netplay);
@@ -10023,20 +10086,28 @@ void netplay_load_savestate(netplay_t *netplay,
       if (netplay_delta_frame_ready(netplay,
                &netplay->buffer[netplay->run_ptr], netplay->run_frame_count))
       {
+         void *state = netplay_delta_frame_state_buffer(netplay);
+
+         if (!state)
+            return;
+
          if (!serial_info)
          {
             tmp_serial_info.size = netplay->state_size;
-            tmp_serial_info.data = netplay->buffer[netplay->run_ptr].state;
+            tmp_serial_info.data = state;
             if (!core_serialize(&tmp_serial_info))
                return;
-            tmp_serial_info.data_const = tmp_serial_info.data;
+            netplay_delta_frame_store_state(netplay, netplay->run_ptr);
+            tmp_serial_info.data_const = netplay_delta_frame_state(netplay,
+                  netplay->run_ptr);
             serial_info = &tmp_serial_info;
          }
-         else
+         else if (serial_info->size <= netplay->state_size)
          {
-            if (serial_info->size <= netplay->state_size)
-               memcpy(netplay->buffer[netplay->run_ptr].state,
-                     serial_info->data_const, serial_info->size);
+            memcpy(state, serial_info->data_const, serial_info->size);
+            memset((uint8_t*)state + serial_info->size, 0,
+                  netplay->state_size - serial_info->size);
+            netplay_delta_frame_store_state(netplay, netplay->run_ptr);
          }
       }
       /* FIXME: This is a critical failure! */
@@ -10060,6 +10131,23 @@ void netplay_load_savestate(netplay_t *netplay,
    if (netplay->compress_zlib.compression_backend)
       netplay_send_savestate(netplay, serial_info, NETPLAY_COMPRESSION_ZLIB,
          &netplay->compress_zlib);
+
+   for (i = 0; i < netplay->connections_size; i++)
+   {
+      struct netplay_connection *connection = &netplay->connections[i];
+      if (!connection->active ||
+          connection->mode < NETPLAY_CONNECTION_CONNECTED ||
+          !connection->savestate_delta) continue;
+
+      /* A relay can start its spectators from this one too */
+      connection->keyframe_requested = false;
+
+      if (!netplay_send_savestate_delta(netplay, connection,
+            NETPLAY_CMD_LOAD_SAVESTATE_DELTA,
+            serial_info->data_const, serial_info->size,
+            netplay->run_frame_count))
+         netplay_hangup(netplay, connection);
+   }
 }
 
 /**
@@ -10087,6 +10175,9 @@ static void netplay_core_reset(netplay_t *netplay)
       if (!connection->active ||
             connection->mode < NETPLAY_CONNECTION_CONNECTED) continue;
 
+      /* The reset makes any savestate still being sent moot */
+      connection->savestate_out.pending = false;
+
       if (!netplay_send(&connection->send_packet_buffer, connection->fd, cmd,
                sizeof(cmd)))
          netplay_hangup(netplay, connection);
@@ -12604,6 +12695,9 @@ static bool command_write_ram(const char *arg)
    if (!data)
       return false;
 
+   /* Any saved copy of the core state is stale now */
+   savestate_pool_invalidate();
+
    while (*arg)
    {
       *data = strtoul(arg, (char**)&arg, 16);
@@ -15810,7 +15904,19 @@ bool command_event(enum event_command cmd, void *data)
 #ifdef HAVE_REWIND
          {
             bool rewind_enable        = settings->bools.rewind_enable;
-            unsigned rewind_buf_size  = settings->sizes.rewind_buffer_size;
+            size_t rewind_buf_size    = settings->sizes.rewind_buffer_size;
+            size_t rewind_arch_size   = (size_t)
+               settings->uints.rewind_archive_size << 20;
+            unsigned rewind_threads   = settings->uints.rewind_threads;
+            const char *rewind_dir    = NULL;
+
+            if (settings->bools.rewind_buffer_to_disk)
+            {
+               rewind_dir = settings->paths.directory_cache;
+               if (string_is_empty(rewind_dir))
+                  RARCH_WARN("[Rewind]: No cache directory set, "
+                        "keeping the buffer in memory.\n");
+            }
 #ifdef HAVE_CHEEVOS
             if (rcheevos_hardcore_active)
                return false;
@@ -15824,7 +15930,8 @@ bool command_event(enum event_command cmd, void *data)
                         RARCH_NETPLAY_CTL_IS_ENABLED, NULL))
 #endif
                {
-                  state_manager_event_init((unsigned)rewind_buf_size);
+                  state_manager_event_init(rewind_buf_size,
+                        rewind_arch_size, rewind_threads, rewind_dir);
                }
             }
          }
@@ -16002,6 +16109,7 @@ bool command_event(enum event_command cmd, void *data)
             playlist_config.old_format             = settings->bools.playlist_use_old_format;
             playlist_config.compress               = settings->bools.playlist_compression;
             playlist_config.fuzzy_archive_match    = settings->bools.playlist_fuzzy_archive_match;
+            playlist_config.binary_cache           = settings->bools.playlist_binary_cache;
 
             command_event(CMD_EVENT_HISTORY_DEINIT, NULL);
 
@@ -16056,6 +16164,7 @@ bool command_event(enum event_command cmd, void *data)
             char ext_name[255];
             const char *dir_libretro       = settings->paths.directory_libretro;
             const char *path_libretro_info = settings->paths.path_libretro_info;
+            const char *dir_cache          = settings->paths.directory_cache;
             bool show_hidden_files         = settings->bools.show_hidden_files;
 
             ext_name[0]                    = '\0';
@@ -16068,6 +16177,7 @@ bool command_event(enum event_command cmd, void *data)
             if (!string_is_empty(dir_libretro))
                core_info_init_list(path_libretro_info,
                      dir_libretro,
+                     dir_cache,
                      ext_name,
                      show_hidden_files
                      );
@@ -17122,6 +17232,14 @@ void main_exit(void *args)
    if (config_save_on_exit)
       command_event(CMD_EVENT_MENU_SAVE_CURRENT_CONFIG, NULL);
 
+#ifdef HAVE_NETWORKING
+   if (p_rarch->netplay_relay)
+   {
+      netplay_relay_free(p_rarch->netplay_relay);
+      p_rarch->netplay_relay = NULL;
+   }
+#endif
+
 #if defined(HAVE_GFX_WIDGETS)
    /* Do not want display widgets to live any more. */
    p_rarch->widgets_persisting = false;
@@ -17161,6 +17279,12 @@ void main_exit(void *args)
    global_free(p_rarch);
    task_queue_deinit();
 
+#ifdef HAVE_MENU
+   /* No image load task is left to use it */
+   gfx_thumbnail_cache_free(p_rarch->gfx_thumb_state.cache);
+   p_rarch->gfx_thumb_state.cache = NULL;
+#endif
+
    if (p_rarch->configuration_settings)
       free(p_rarch->configuration_settings);
    p_rarch->configuration_settings = NULL;
@@ -32694,6 +32818,29 @@ static void video_driver_frame(const void *data, unsigned width,
             av_info->timing.fps,
             av_info->timing.sample_rate);
 
+      if (     p_rarch->recording_data
+            && p_rarch->recording_driver
+            && p_rarch->recording_driver->get_stats)
+      {
+         char rec_text[256];
+         struct record_stats rec_stats = {0};
+
+         p_rarch->recording_driver->get_stats(
+               p_rarch->recording_data, &rec_stats);
+
+         snprintf(rec_text, sizeof(rec_text),
+               "Recording Statistics:\n -Queued frames: %u / %u\n"
+               " -Frame count: %" PRIu64"\n -Dropped frames: %" PRIu64"\n"
+               " -Skipped frames: %" PRIu64"\n",
+               rec_stats.queued,
+               rec_stats.queue_size,
+               rec_stats.pushed,
+               rec_stats.dropped,
+               rec_stats.skipped);
+         strlcat(video_info.stat_text, rec_text,
+               sizeof(video_info.stat_text));
+      }
+
       /* TODO/FIXME - add OSD chat text here */
    }
 
@@ -34914,48 +35061,10 @@ static void remove_input_state_hook(void)
    }
 }
 
-static void *runahead_save_state_alloc(void)
+static void runahead_save_state_release(struct rarch_state *p_rarch)
 {
-   struct rarch_state *p_rarch           = &rarch_st;
-   retro_ctx_serialize_info_t *savestate = (retro_ctx_serialize_info_t*)
-      malloc(sizeof(retro_ctx_serialize_info_t));
-
-   if (!savestate)
-      return NULL;
-
-   savestate->data          = NULL;
-   savestate->data_const    = NULL;
-   savestate->size          = 0;
-
-   if (  (p_rarch->runahead_save_state_size > 0) &&
-         p_rarch->runahead_save_state_size_known)
-   {
-      savestate->data       = malloc(p_rarch->runahead_save_state_size);
-      savestate->data_const = savestate->data;
-      savestate->size       = p_rarch->runahead_save_state_size;
-   }
-
-   return savestate;
-}
-
-static void runahead_save_state_free(void *data)
-{
-   retro_ctx_serialize_info_t *savestate = (retro_ctx_serialize_info_t*)data;
-   if (!savestate)
-      return;
-   free(savestate->data);
-   free(savestate);
-}
-
-static void runahead_save_state_list_init(
-      struct rarch_state *p_rarch,
-      size_t save_state_size)
-{
-   p_rarch->runahead_save_state_size       = save_state_size;
-   p_rarch->runahead_save_state_size_known = true;
-
-   mylist_create(&p_rarch->runahead_save_state_list, 16,
-         runahead_save_state_alloc, runahead_save_state_free);
+   savestate_buf_unref(p_rarch->runahead_save_state);
+   p_rarch->runahead_save_state = NULL;
 }
 
 /* Hooks - Hooks to cleanup, and add dirty input hooks */
@@ -34988,7 +35097,7 @@ static void runahead_clear_variables(struct rarch_state *p_rarch)
 
 static void runahead_destroy(struct rarch_state *p_rarch)
 {
-   mylist_destroy(&p_rarch->runahead_save_state_list);
+   runahead_save_state_release(p_rarch);
    runahead_remove_hooks(p_rarch);
    runahead_clear_variables(p_rarch);
 }
@@ -35037,7 +35146,7 @@ static void runahead_add_hooks(struct rarch_state *p_rarch)
 static void runahead_error(struct rarch_state *p_rarch)
 {
    p_rarch->runahead_available             = false;
-   mylist_destroy(&p_rarch->runahead_save_state_list);
+   runahead_save_state_release(p_rarch);
    runahead_remove_hooks(p_rarch);
    p_rarch->runahead_save_state_size       = 0;
    p_rarch->runahead_save_state_size_known = true;
@@ -35052,7 +35161,8 @@ static bool runahead_create(struct rarch_state *p_rarch)
    core_serialize_size(&info);
    p_rarch->request_fast_savestate          = false;
 
-   runahead_save_state_list_init(p_rarch, info.size);
+   p_rarch->runahead_save_state_size        = info.size;
+   p_rarch->runahead_save_state_size_known  = true;
    p_rarch->runahead_video_driver_is_active = 
       p_rarch->video_driver_active;
 
@@ -35065,26 +35175,21 @@ static bool runahead_create(struct rarch_state *p_rarch)
 
    runahead_add_hooks(p_rarch);
    p_rarch->runahead_force_input_dirty = true;
-   mylist_resize(p_rarch->runahead_save_state_list, 1, true);
    return true;
 }
 
 static bool runahead_save_state(struct rarch_state *p_rarch)
 {
-   retro_ctx_serialize_info_t *serialize_info;
-   bool okay                       = false;
-
-   if (!p_rarch->runahead_save_state_list)
-      return false;
-
-   serialize_info                  =
-      (retro_ctx_serialize_info_t*)p_rarch->runahead_save_state_list->data[0];
+   /* Share the state with the pool rather than serializing into a
+    * private buffer, so that rewind can pick it up next frame. */
+   runahead_save_state_release(p_rarch);
 
    p_rarch->request_fast_savestate = true;
-   okay                            = core_serialize(serialize_info);
+   p_rarch->runahead_save_state    = savestate_pool_snapshot(
+         p_rarch->runahead_save_state_size, true);
    p_rarch->request_fast_savestate = false;
 
-   if (okay)
+   if (p_rarch->runahead_save_state)
       return true;
 
    runahead_error(p_rarch);
@@ -35094,22 +35199,29 @@ static bool runahead_save_state(struct rarch_state *p_rarch)
 static bool runahead_load_state(struct rarch_state *p_rarch)
 {
    bool okay                                  = false;
-   retro_ctx_serialize_info_t *serialize_info = (retro_ctx_serialize_info_t*)
-      p_rarch->runahead_save_state_list->data[0];
+   savestate_buf_t *savestate                 = p_rarch->runahead_save_state;
    bool last_dirty                            = p_rarch->input_is_dirty;
 
+   if (!savestate)
+      return false;
+
    p_rarch->request_fast_savestate            = true;
    /* calling core_unserialize has side effects with
     * netplay (it triggers transmitting your save state)
       call retro_unserialize directly from the core instead */
    okay = p_rarch->current_core.retro_unserialize(
-         serialize_info->data_const, serialize_info->size);
+         savestate->data, savestate->size);
 
    p_rarch->request_fast_savestate            = false;
    p_rarch->input_is_dirty                    = last_dirty;
 
    if (!okay)
+   {
+      savestate_pool_invalidate();
       runahead_error(p_rarch);
+   }
+   else
+      savestate_pool_set_current(savestate);
 
    return okay;
 }
@@ -35118,13 +35230,14 @@ static bool runahead_load_state(struct rarch_state *p_rarch)
 static bool runahead_load_state_secondary(struct rarch_state *p_rarch)
 {
    bool okay                                  = false;
-   retro_ctx_serialize_info_t *serialize_info =
-      (retro_ctx_serialize_info_t*)p_rarch->runahead_save_state_list->data[0];
+   savestate_buf_t *savestate                 = p_rarch->runahead_save_state;
+
+   if (!savestate)
+      return false;
 
    p_rarch->request_fast_savestate            = true;
    okay                                       = secondary_core_deserialize(
-         p_rarch,
-         serialize_info->data_const, (int)serialize_info->size);
+         p_rarch, savestate->data, (int)savestate->size);
    p_rarch->request_fast_savestate            = false;
 
    if (!okay)
@@ -35150,6 +35263,7 @@ static bool runahead_core_run_use_last_input(struct rarch_state *p_rarch)
    p_rarch->current_core.retro_set_input_poll(cbs->poll_cb);
    p_rarch->current_core.retro_set_input_state(cbs->state_cb);
 
+   savestate_pool_invalidate();
    p_rarch->current_core.retro_run();
 
    cbs->poll_cb                           = old_poll_function;
@@ -35428,6 +35542,42 @@ static void retroarch_print_version(void)
    fprintf(stdout, "%s\n", str);
 }
 
+#ifdef HAVE_NETWORKING
+/**
+ * retroarch_netplay_relay:
+ * @settings             : netplay port, nick and passwords.
+ * @server               : host to relay, as HOST[:PORT].
+ *
+ * Starts relaying a netplay host to spectators. The relay is driven a
+ * step every frame from runloop_iterate, until the host goes away.
+ *
+ * Returns: the relay, or NULL if it couldn't be started.
+ **/
+static netplay_relay_t *retroarch_netplay_relay(settings_t *settings,
+      const char *server)
+{
+   char host[256];
+   unsigned server_port     = RARCH_DEFAULT_PORT;
+   const char *password     = settings->paths.netplay_spectate_password;
+   char *port               = NULL;
+
+   strlcpy(host, server, sizeof(host));
+   /* A bare IPv6 address has no port */
+   if ((port = strchr(host, ':')) && !strchr(port + 1, ':'))
+   {
+      *port++     = '\0';
+      server_port = (unsigned)strtoul(port, NULL, 0);
+   }
+
+   if (!*password)
+      password = settings->paths.netplay_password;
+
+   return netplay_relay_new(host, server_port,
+         settings->uints.netplay_port, settings->paths.username, password,
+         600);
+}
+#endif
+
 /**
  * retroarch_print_help:
  *
@@ -35543,6 +35693,9 @@ static void retroarch_print_help(const char *arg0)
       strlcat(buf, "  -H, --host            Host netplay as user 1.\n", sizeof(buf));
       strlcat(buf, "  -C, --connect=HOST    Connect to netplay server as user 2.\n", sizeof(buf));
       strlcat(buf, "      --port=PORT       Port used to netplay. Default is 55435.\n", sizeof(buf));
+      strlcat(buf, "      --relay=HOST[:PORT]\n"
+            "                        Relay a netplay server to spectators on --port,\n"
+            "                        without running content.\n", sizeof(buf));
       strlcat(buf, "      --stateless       Use \"stateless\" mode for netplay\n", sizeof(buf));
       strlcat(buf, "                        (requires a very fast network).\n", sizeof(buf));
       strlcat(buf, "      --check-frames=NUMBER\n"
@@ -35612,6 +35765,9 @@ static void retroarch_parse_input_and_config(
    bool                 cli_active = false;
    bool               cli_core_set = false;
    bool            cli_content_set = false;
+#ifdef HAVE_NETWORKING
+   const char        *relay_server = NULL;
+#endif
    global_t                *global = &p_rarch->g_extern;
 
    const struct option opts[] = {
@@ -35646,6 +35802,7 @@ static void retroarch_parse_input_and_config(
       { "stateless",          0, NULL, RA_OPT_STATELESS },
       { "check-frames",       1, NULL, RA_OPT_CHECK_FRAMES },
       { "port",               1, NULL, RA_OPT_PORT },
+      { "relay",              1, NULL, RA_OPT_RELAY },
 #ifdef HAVE_NETWORK_CMD
       { "command",            1, NULL, RA_OPT_COMMAND },
 #endif
@@ -36079,6 +36236,10 @@ static void retroarch_parse_input_and_config(
                }
                break;
 
+            case RA_OPT_RELAY:
+               relay_server = optarg;
+               break;
+
 #ifdef HAVE_NETWORK_CMD
             case RA_OPT_COMMAND:
 #ifdef HAVE_COMMAND
@@ -36246,6 +36407,16 @@ static void retroarch_parse_input_and_config(
          PACKAGE_VERSION, retroarch_git_version);
 #endif
 
+#ifdef HAVE_NETWORKING
+   if (relay_server)
+   {
+      p_rarch->netplay_relay = retroarch_netplay_relay(
+            p_rarch->configuration_settings, relay_server);
+      if (!p_rarch->netplay_relay)
+         retroarch_fail(1, "retroarch_netplay_relay()");
+   }
+#endif
+
    if (explicit_menu)
    {
       if (optind < argc)
@@ -37029,14 +37200,22 @@ static void rarch_init_core_options(
 
 void retroarch_init_task_queue(void)
 {
-#ifdef HAVE_THREADS
+#if defined(HAVE_THREADS) || defined(HAVE_CHD)
    struct rarch_state *p_rarch = &rarch_st;
    settings_t *settings        = p_rarch->configuration_settings;
+#endif
+#ifdef HAVE_THREADS
    bool threaded_enable        = settings->bools.threaded_data_runloop_enable;
 #else
    bool threaded_enable        = false;
 #endif
 
+#ifdef HAVE_CHD
+   /* Before any task can open a CHD image */
+   chdstream_set_cache(settings->uints.chd_cache_hunks,
+         settings->uints.chd_readahead_hunks);
+#endif
+
    task_queue_deinit();
    task_queue_init(threaded_enable, runloop_task_msg_queue_push);
 }
@@ -39223,6 +39402,18 @@ int runloop_iterate(void)
       Discord_RunCallbacks();
 #endif
 
+   savestate_pool_frame_end();
+
+#ifdef HAVE_NETWORKING
+   /* Serve the relay's host and spectators without waiting on them */
+   if (p_rarch->netplay_relay
+         && !netplay_relay_poll(p_rarch->netplay_relay, 0))
+   {
+      netplay_relay_free(p_rarch->netplay_relay);
+      p_rarch->netplay_relay = NULL;
+   }
+#endif
+
    if (p_rarch->runloop_frame_time.callback)
    {
       /* Updates frame timing if frame timing callback is in use by the core.
@@ -39632,6 +39823,7 @@ void rarch_favorites_init(void)
    playlist_config.old_format          = settings ? settings->bools.playlist_use_old_format : false;
    playlist_config.compress            = settings ? settings->bools.playlist_compression : false;
    playlist_config.fuzzy_archive_match = settings ? settings->bools.playlist_fuzzy_archive_match : false;
+   playlist_config.binary_cache        = settings ? settings->bools.playlist_binary_cache : false;
 
    if (!settings)
       return;
@@ -39834,6 +40026,7 @@ bool core_unset_netplay_callbacks(void)
 bool core_set_cheat(retro_ctx_cheat_info_t *info)
 {
    struct rarch_state *p_rarch  = &rarch_st;
+   savestate_pool_invalidate();
    p_rarch->current_core.retro_cheat_set(info->index, info->enabled, info->code);
    return true;
 }
@@ -39841,6 +40034,7 @@ bool core_set_cheat(retro_ctx_cheat_info_t *info)
 bool core_reset_cheat(void)
 {
    struct rarch_state *p_rarch  = &rarch_st;
+   savestate_pool_invalidate();
    p_rarch->current_core.retro_cheat_reset();
    return true;
 }
@@ -39892,6 +40086,7 @@ bool core_load_game(retro_ctx_load_content_info_t *load_info)
 
    content_get_status(&contentless, &is_inited);
    set_save_state_in_background(false);
+   savestate_pool_invalidate();
 
    if (load_info && load_info->special)
       game_loaded = p_rarch->current_core.retro_load_game_special(
@@ -39918,6 +40113,9 @@ bool core_get_system_info(struct retro_system_info *system)
 bool core_unserialize(retro_ctx_serialize_info_t *info)
 {
    struct rarch_state *p_rarch  = &rarch_st;
+
+   savestate_pool_invalidate();
+
    if (!info || !p_rarch->current_core.retro_unserialize(info->data_const, info->size))
       return false;
 
@@ -39957,6 +40155,7 @@ bool core_reset(void)
 
    video_driver_set_cached_frame_ptr(NULL);
 
+   savestate_pool_invalidate();
    p_rarch->current_core.retro_reset();
    return true;
 }
@@ -39977,6 +40176,8 @@ static bool core_unload_game(struct rarch_state *p_rarch)
 
    audio_driver_stop(p_rarch);
 
+   savestate_pool_deinit();
+
    return true;
 }
 
@@ -40012,6 +40213,7 @@ bool core_run(void)
    else if (late_polling)
       current_core->input_polled = false;
 
+   savestate_pool_invalidate();
    current_core->retro_run();
 
    if (late_polling && !current_core->input_polled)
@@ -705,6 +705,19 @@ struct record_audio_data
    size_t frames;
 };
 
+struct record_stats
+{
+   /* Frames waiting for the encoder */
+   unsigned queued;
+   unsigned queue_size;
+   /* Frames handed to the driver */
+   uint64_t pushed;
+   /* Frames replaced by a repeat of the previous one */
+   uint64_t dropped;
+   /* Frames lost outright */
+   uint64_t skipped;
+};
+
 typedef struct record_driver
 {
    void *(*init)(const struct record_params *params);
@@ -712,6 +725,8 @@ typedef struct record_driver
    bool  (*push_video)(void *data, const struct record_video_data *video_data);
    bool  (*push_audio)(void *data, const struct record_audio_data *audio_data);
    bool  (*finalize)(void *data);
+   /* Optional */
+   void  (*get_stats)(void *data, struct record_stats *stats);
    const char *ident;
 } record_driver_t;
 
@@ -1172,7 +1187,7 @@ typedef struct video_frame_info
    float font_msg_color_b;
    float xmb_alpha_factor;
 
-   char stat_text[512];
+   char stat_text[1024];
 
    struct
    {
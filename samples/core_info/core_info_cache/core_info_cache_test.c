@@ -0,0 +1,298 @@
+/* Copyright  (C) 2010-2020 The RetroArch team
+ *
+ * ---------------------------------------------------------------------------------------
+ * The following license statement only applies to this file (core_info_cache_test.c).
+ * ---------------------------------------------------------------------------------------
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/* Checks that the core info cache is written to the cache
+ * directory, that records are reused while a .info file keeps its
+ * size and mtime, that changed .info files are parsed again, and
+ * that a damaged or missing cache is rebuilt.
+ *
+ * Usage: core_info_cache_test [scratch dir] */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <utime.h>
+
+#include <retro_miscellaneous.h>
+#include <compat/strl.h>
+#include <file/file_path.h>
+#include <lists/dir_list.h>
+#include <streams/file_stream.h>
+#include <string/stdstring.h>
+#include <rhash.h>
+
+#include "../../../retroarch.h"
+#include "../../../core_info.h"
+
+#define TEST_CHECK(cond) \
+   do \
+   { \
+      if (!(cond)) \
+      { \
+         fprintf(stderr, "%s:%d: check failed: %s\n", \
+               __FILE__, __LINE__, #cond); \
+         return false; \
+      } \
+   } while (0)
+
+#define TEST_CORE_EXT "so"
+
+static char test_dir[PATH_MAX_LENGTH];
+static char test_cores[PATH_MAX_LENGTH];
+static char test_info[PATH_MAX_LENGTH];
+static char test_cache[PATH_MAX_LENGTH];
+
+/* Frontend hooks core_info.c links against */
+static core_info_state_t test_coreinfo;
+
+core_info_state_t *coreinfo_get_ptr(void)
+{
+   return &test_coreinfo;
+}
+
+enum gfx_ctx_api video_context_driver_get_api(void)
+{
+   return GFX_CTX_NONE;
+}
+
+bool video_context_driver_get_flags(gfx_ctx_flags_t *flags)
+{
+   return false;
+}
+
+const char *video_driver_get_gpu_api_version_string(void)
+{
+   return NULL;
+}
+
+static bool test_write(const char *dir, const char *name, const char *s)
+{
+   char path[PATH_MAX_LENGTH];
+   fill_pathname_join(path, dir, name, sizeof(path));
+   return filestream_write_file(path, s, (int64_t)strlen(s));
+}
+
+static void test_cache_path(char *s, size_t len, const char *dir)
+{
+   char name[64];
+   snprintf(name, sizeof(name), "core_info_%08x.cache",
+         djb2_calculate(test_info));
+   fill_pathname_join(s, dir, name, len);
+}
+
+static size_t test_dir_size(const char *dir)
+{
+   size_t size              = 0;
+   struct string_list *list = dir_list_new(dir, NULL,
+         false, true, false, false);
+
+   if (list)
+   {
+      size = list->size;
+      string_list_free(list);
+   }
+   return size;
+}
+
+/* Writes alpha_libretro.info. With 'keep_stamp', the file is
+ * given back its previous mtime, so only its contents change */
+static bool test_write_alpha(const char *display_name, bool keep_stamp)
+{
+   char path[PATH_MAX_LENGTH];
+   char info[256];
+   struct stat st;
+
+   fill_pathname_join(path, test_info, "alpha_libretro.info", sizeof(path));
+
+   if (keep_stamp)
+      TEST_CHECK(stat(path, &st) == 0);
+
+   snprintf(info, sizeof(info),
+         "display_name = \"%s\"\n"
+         "supported_extensions = \"aaa|bbb\"\n"
+         "firmware_count = 1\n"
+         "firmware0_path = \"alpha.bin\"\n"
+         "firmware0_desc = \"Alpha BIOS\"\n",
+         display_name);
+   TEST_CHECK(test_write(test_info, "alpha_libretro.info", info));
+
+   if (keep_stamp)
+   {
+      struct utimbuf times;
+      times.actime  = st.st_atime;
+      times.modtime = st.st_mtime;
+      TEST_CHECK(utime(path, &times) == 0);
+   }
+
+   return true;
+}
+
+/* Loads the core list and checks what it holds for alpha */
+static bool test_load(const char *dir_cache, const char *display_name)
+{
+   size_t i;
+   core_info_list_t *list = NULL;
+   const core_info_t *alpha = NULL;
+   const core_info_t *beta  = NULL;
+
+   core_info_deinit_list();
+   TEST_CHECK(core_info_init_list(test_info, test_cores, dir_cache,
+            TEST_CORE_EXT, false));
+   TEST_CHECK(core_info_get_list(&list) && list);
+   TEST_CHECK(list->count == 3);
+
+   for (i = 0; i < list->count; i++)
+   {
+      const core_info_t *info = core_info_get(list, i);
+      TEST_CHECK(info);
+      if (string_is_equal(info->core_file_id.str, "alpha_libretro"))
+         alpha = info;
+      else if (string_is_equal(info->core_file_id.str, "beta_libretro"))
+         beta  = info;
+      else
+      {
+         /* No .info file: fallback name only */
+         TEST_CHECK(!info->has_info);
+         TEST_CHECK(string_is_equal(info->display_name,
+                  "gamma_libretro." TEST_CORE_EXT));
+      }
+   }
+
+   TEST_CHECK(alpha && alpha->has_info);
+   TEST_CHECK(string_is_equal(alpha->display_name, display_name));
+   TEST_CHECK(string_is_equal(alpha->supported_extensions, "aaa|bbb"));
+   TEST_CHECK(alpha->supported_extensions_list
+         && alpha->supported_extensions_list->size == 2);
+   TEST_CHECK(alpha->firmware_count == 1);
+   TEST_CHECK(string_is_equal(alpha->firmware[0].path, "alpha.bin"));
+   TEST_CHECK(string_is_equal(alpha->firmware[0].desc, "Alpha BIOS"));
+
+   TEST_CHECK(beta && beta->has_info);
+   TEST_CHECK(string_is_equal(beta->display_name, "Beta"));
+   TEST_CHECK(beta->firmware_count == 0);
+
+   return true;
+}
+
+static bool test_cache_valid(const char *path)
+{
+   void *buf   = NULL;
+   int64_t len = 0;
+   bool valid  = false;
+
+   if (filestream_read_file(path, &buf, &len))
+      valid = len > 8 && memcmp(buf, "RACINF1", 8) == 0;
+   free(buf);
+   return valid;
+}
+
+static bool test_info_cache(void)
+{
+   char cache_path[PATH_MAX_LENGTH];
+
+   test_cache_path(cache_path, sizeof(cache_path), test_cache);
+
+   /* Built from the .info files, written aside to the cache dir */
+   TEST_CHECK(test_load(test_cache, "Alpha One"));
+   TEST_CHECK(test_cache_valid(cache_path));
+   TEST_CHECK(test_dir_size(test_cache) == 1);
+   TEST_CHECK(test_dir_size(test_info) == 2);
+
+   /* Same size and mtime: the cached record wins */
+   TEST_CHECK(test_write_alpha("Alpha Two", true));
+   TEST_CHECK(test_load(test_cache, "Alpha One"));
+
+   /* Changed size: parsed again and the cache is updated */
+   TEST_CHECK(test_write_alpha("Alpha Three", false));
+   TEST_CHECK(test_load(test_cache, "Alpha Three"));
+   TEST_CHECK(test_write_alpha("Alpha Four!", true));
+   TEST_CHECK(test_load(test_cache, "Alpha Three"));
+
+   /* A damaged cache is ignored and replaced */
+   TEST_CHECK(filestream_write_file(cache_path, "RACINF1", 8));
+   TEST_CHECK(test_load(test_cache, "Alpha Four!"));
+   TEST_CHECK(test_cache_valid(cache_path));
+
+   /* A missing cache is rebuilt */
+   TEST_CHECK(filestream_delete(cache_path) == 0);
+   TEST_CHECK(test_load(test_cache, "Alpha Four!"));
+   TEST_CHECK(test_cache_valid(cache_path));
+   TEST_CHECK(test_dir_size(test_cache) == 1);
+
+   /* Without a cache dir, the info dir holds the cache */
+   TEST_CHECK(test_load(NULL, "Alpha Four!"));
+   test_cache_path(cache_path, sizeof(cache_path), test_info);
+   TEST_CHECK(test_cache_valid(cache_path));
+   TEST_CHECK(test_dir_size(test_info) == 3);
+
+   core_info_deinit_list();
+   return true;
+}
+
+static void test_remove_dir(const char *dir)
+{
+   size_t i;
+   struct string_list *list = dir_list_new(dir, NULL,
+         false, true, false, false);
+
+   if (list)
+   {
+      for (i = 0; i < list->size; i++)
+         filestream_delete(list->elems[i].data);
+      string_list_free(list);
+   }
+   filestream_delete(dir);
+}
+
+int main(int argc, char *argv[])
+{
+   bool ok = false;
+
+   strlcpy(test_dir, argc > 1 ? argv[1] : "core_info_cache_scratch",
+         sizeof(test_dir));
+   fill_pathname_join(test_cores, test_dir, "cores", sizeof(test_cores));
+   fill_pathname_join(test_info,  test_dir, "info",  sizeof(test_info));
+   fill_pathname_join(test_cache, test_dir, "cache", sizeof(test_cache));
+
+   if (     !path_mkdir(test_cores)
+         || !path_mkdir(test_info)
+         || !test_write(test_cores, "alpha_libretro." TEST_CORE_EXT, "")
+         || !test_write(test_cores, "beta_libretro."  TEST_CORE_EXT, "")
+         || !test_write(test_cores, "gamma_libretro." TEST_CORE_EXT, "")
+         || !test_write(test_info, "beta_libretro.info",
+               "display_name = \"Beta\"\n")
+         || !test_write_alpha("Alpha One", false))
+      fprintf(stderr, "Can't set up %s.\n", test_dir);
+   else
+      ok = test_info_cache();
+
+   test_remove_dir(test_cores);
+   test_remove_dir(test_info);
+   test_remove_dir(test_cache);
+   filestream_delete(test_dir);
+
+   printf("%s\n", ok ? "ok" : "FAILED");
+   return ok ? 0 : 1;
+}
@@ -0,0 +1,439 @@
+/* Copyright  (C) 2010-2019 The RetroArch team
+ *
+ * ---------------------------------------------------------------------------------------
+ * The following license statement only applies to this file (thumbnail_cache_test.c).
+ * ---------------------------------------------------------------------------------------
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/* Checks keying, LRU eviction, persistence, damage handling and
+ * concurrent stores of the decoded thumbnail cache in a scratch
+ * directory, then times
+ * cache hits against decoding the PNGs they stand for.
+ *
+ * Usage: thumbnail_cache_test [scratch dir] */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <retro_miscellaneous.h>
+#include <compat/strl.h>
+#include <file/file_path.h>
+#include <formats/image.h>
+#include <formats/rpng.h>
+#include <lists/dir_list.h>
+#include <lists/string_list.h>
+#include <streams/file_stream.h>
+#include <rthreads/rthreads.h>
+
+#include "../../../gfx/gfx_thumbnail_cache.h"
+
+#define TEST_SIZE   256
+#define TEST_IMAGES 4
+#define TEST_PASSES 20
+#define TEST_STORES 50
+
+#define TEST_CHECK(cond) \
+   do \
+   { \
+      if (!(cond)) \
+      { \
+         fprintf(stderr, "%s:%d: check failed: %s\n", \
+               __FILE__, __LINE__, #cond); \
+         return false; \
+      } \
+   } while (0)
+
+typedef struct test_store_job
+{
+   gfx_thumbnail_cache_t *cache;
+   uint32_t *pixels;
+   uint64_t key;
+   bool ok;
+} test_store_job_t;
+
+static char test_dir[PATH_MAX_LENGTH];
+static char test_cache_dir[PATH_MAX_LENGTH];
+
+static uint64_t test_now_ns(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* A thumbnail-like image: gradients and some noise, so that
+ * the PNG is neither trivial nor incompressible */
+static void test_fill(uint32_t *pixels, unsigned seed)
+{
+   unsigned x, y;
+   uint32_t state = 0x9e3779b9u * (seed + 1);
+
+   for (y = 0; y < TEST_SIZE; y++)
+      for (x = 0; x < TEST_SIZE; x++)
+      {
+         state = state * 1664525u + 1013904223u;
+         pixels[y * TEST_SIZE + x] = 0xff000000u
+            | ((x + seed * 40) & 0xff) << 16
+            | ((y + (state >> 29)) & 0xff) << 8
+            | ((x ^ y) & 0xff);
+      }
+}
+
+static void test_image_path(unsigned i, char *s, size_t len)
+{
+   char name[32];
+   snprintf(name, sizeof(name), "image%u.png", i);
+   fill_pathname_join(s, test_dir, name, len);
+}
+
+static bool test_same(const struct texture_image *img,
+      const uint32_t *pixels)
+{
+   return img->width == TEST_SIZE
+      && img->height == TEST_SIZE
+      && !memcmp(img->pixels, pixels,
+            TEST_SIZE * TEST_SIZE * sizeof(uint32_t));
+}
+
+static void test_clear_dir(const char *dir)
+{
+   size_t i;
+   struct string_list *list = dir_list_new(dir, NULL,
+         false, true, false, false);
+
+   if (!list)
+      return;
+
+   for (i = 0; i < list->size; i++)
+      filestream_delete(list->elems[i].data);
+   string_list_free(list);
+}
+
+static bool test_cache(uint32_t **pixels)
+{
+   unsigned i;
+   char path[PATH_MAX_LENGTH];
+   uint64_t keys[TEST_IMAGES];
+   uint64_t blob_size       = sizeof(uint32_t) * TEST_SIZE * TEST_SIZE + 32;
+   struct texture_image img = {0};
+   gfx_thumbnail_cache_t *cache;
+
+   for (i = 0; i < TEST_IMAGES; i++)
+   {
+      test_image_path(i, path, sizeof(path));
+      keys[i] = gfx_thumbnail_cache_key(path, 0, false);
+      TEST_CHECK(keys[i] != 0);
+   }
+
+   /* Keys depend on everything that changes the decoded image */
+   test_image_path(0, path, sizeof(path));
+   TEST_CHECK(gfx_thumbnail_cache_key(path, 0, false) == keys[0]);
+   TEST_CHECK(gfx_thumbnail_cache_key(path, 256, false) != keys[0]);
+   TEST_CHECK(gfx_thumbnail_cache_key(path, 0, true) != keys[0]);
+   TEST_CHECK(keys[1] != keys[0]);
+   fill_pathname_join(path, test_dir, "missing.png", sizeof(path));
+   TEST_CHECK(gfx_thumbnail_cache_key(path, 0, false) == 0);
+
+   /* Room for three blobs */
+   test_clear_dir(test_cache_dir);
+   cache = gfx_thumbnail_cache_new(test_cache_dir, blob_size * 3);
+   TEST_CHECK(cache);
+
+   for (i = 0; i < 3; i++)
+   {
+      img.width  = TEST_SIZE;
+      img.height = TEST_SIZE;
+      img.pixels = pixels[i];
+      TEST_CHECK(!gfx_thumbnail_cache_contains(cache, keys[i]));
+      TEST_CHECK(gfx_thumbnail_cache_store(cache, keys[i], &img));
+   }
+
+   for (i = 0; i < 3; i++)
+   {
+      TEST_CHECK(gfx_thumbnail_cache_load(cache, keys[i], &img));
+      TEST_CHECK(test_same(&img, pixels[i]));
+      free(img.pixels);
+   }
+
+   /* Image 0 was used last, then 2; a fourth evicts image 1 */
+   TEST_CHECK(gfx_thumbnail_cache_contains(cache, keys[2]));
+   TEST_CHECK(gfx_thumbnail_cache_contains(cache, keys[0]));
+   img.pixels = pixels[3];
+   TEST_CHECK(gfx_thumbnail_cache_store(cache, keys[3], &img));
+   TEST_CHECK(!gfx_thumbnail_cache_contains(cache, keys[1]));
+   TEST_CHECK(!gfx_thumbnail_cache_load(cache, keys[1], &img));
+   TEST_CHECK(gfx_thumbnail_cache_contains(cache, keys[2]));
+   TEST_CHECK(gfx_thumbnail_cache_contains(cache, keys[3]));
+   TEST_CHECK(gfx_thumbnail_cache_contains(cache, keys[0]));
+
+   /* Recency survives a restart: 2 is the oldest, so storing
+    * image 1 again evicts it */
+   gfx_thumbnail_cache_free(cache);
+   cache = gfx_thumbnail_cache_new(test_cache_dir, blob_size * 3);
+   TEST_CHECK(cache);
+   img.pixels = pixels[1];
+   TEST_CHECK(gfx_thumbnail_cache_store(cache, keys[1], &img));
+   TEST_CHECK(!gfx_thumbnail_cache_contains(cache, keys[2]));
+   TEST_CHECK(gfx_thumbnail_cache_contains(cache, keys[0]));
+   TEST_CHECK(gfx_thumbnail_cache_contains(cache, keys[1]));
+   TEST_CHECK(gfx_thumbnail_cache_contains(cache, keys[3]));
+
+   /* A smaller cap evicts on open, keeping the newest */
+   gfx_thumbnail_cache_free(cache);
+   cache = gfx_thumbnail_cache_new(test_cache_dir, blob_size);
+   TEST_CHECK(cache);
+   TEST_CHECK(!gfx_thumbnail_cache_contains(cache, keys[0]));
+   TEST_CHECK(!gfx_thumbnail_cache_contains(cache, keys[1]));
+   TEST_CHECK(gfx_thumbnail_cache_contains(cache, keys[3]));
+
+   /* A damaged blob is a miss, and is dropped */
+   {
+      char name[32];
+      snprintf(name, sizeof(name), "%016llx.thumb",
+            (unsigned long long)keys[3]);
+      fill_pathname_join(path, test_cache_dir, name, sizeof(path));
+      TEST_CHECK(filestream_write_file(path, "RATHMB1", 8));
+   }
+   TEST_CHECK(!gfx_thumbnail_cache_load(cache, keys[3], &img));
+   TEST_CHECK(!gfx_thumbnail_cache_contains(cache, keys[3]));
+   TEST_CHECK(!path_is_valid(path));
+
+   /* An image larger than the cap is not stored */
+   img.width  = TEST_SIZE;
+   img.height = TEST_SIZE * 2;
+   img.pixels = pixels[0];
+   TEST_CHECK(!gfx_thumbnail_cache_store(cache, keys[0], &img));
+
+   gfx_thumbnail_cache_free(cache);
+   printf("Cache checks passed.\n");
+   return true;
+}
+
+static void test_store_thread(void *data)
+{
+   unsigned i;
+   test_store_job_t *job    = (test_store_job_t*)data;
+   struct texture_image img = {0};
+
+   img.width  = TEST_SIZE;
+   img.height = TEST_SIZE;
+   img.pixels = job->pixels;
+
+   job->ok = true;
+   for (i = 0; i < TEST_STORES; i++)
+      job->ok = gfx_thumbnail_cache_store(job->cache, job->key, &img)
+         && job->ok;
+}
+
+/* Two image tasks storing the same key at once must not write over
+ * each other's temporary file. The blob left is one of the two images,
+ * whole. */
+static bool test_concurrent(uint32_t **pixels)
+{
+   unsigned i;
+   char path[PATH_MAX_LENGTH];
+   test_store_job_t jobs[2];
+   sthread_t *threads[2];
+   struct texture_image img = {0};
+   struct string_list *list = NULL;
+   uint64_t blob_size       = sizeof(uint32_t) * TEST_SIZE * TEST_SIZE + 32;
+   gfx_thumbnail_cache_t *cache;
+   uint64_t key;
+
+   test_image_path(0, path, sizeof(path));
+   key = gfx_thumbnail_cache_key(path, 0, false);
+
+   test_clear_dir(test_cache_dir);
+   cache = gfx_thumbnail_cache_new(test_cache_dir, blob_size * 3);
+   TEST_CHECK(cache);
+
+   for (i = 0; i < 2; i++)
+   {
+      jobs[i].cache  = cache;
+      jobs[i].pixels = pixels[i];
+      jobs[i].key    = key;
+      jobs[i].ok     = false;
+      threads[i]     = sthread_create(test_store_thread, &jobs[i]);
+      TEST_CHECK(threads[i]);
+   }
+   for (i = 0; i < 2; i++)
+      sthread_join(threads[i]);
+
+   TEST_CHECK(jobs[0].ok && jobs[1].ok);
+   TEST_CHECK(gfx_thumbnail_cache_load(cache, key, &img));
+   TEST_CHECK(test_same(&img, pixels[0]) || test_same(&img, pixels[1]));
+   free(img.pixels);
+   gfx_thumbnail_cache_free(cache);
+
+   /* No temporary files are left behind */
+   list = dir_list_new(test_cache_dir, "tmp", false, true, false, false);
+   TEST_CHECK(!list || list->size == 0);
+   string_list_free(list);
+
+   printf("Concurrent store checks passed.\n");
+   return true;
+}
+
+static bool test_decode(const char *path, struct texture_image *img)
+{
+   int retval;
+   void *buf    = NULL;
+   int64_t len  = 0;
+   bool ret     = false;
+   rpng_t *rpng = NULL;
+
+   img->pixels  = NULL;
+
+   if (!filestream_read_file(path, &buf, &len))
+      return false;
+
+   if (!(rpng = rpng_alloc()))
+      goto end;
+
+   if (     !rpng_set_buf_ptr(rpng, buf, (size_t)len)
+         || !rpng_start(rpng))
+      goto end;
+
+   while (rpng_iterate_image(rpng));
+
+   if (!rpng_is_valid(rpng))
+      goto end;
+
+   do
+   {
+      retval = rpng_process_image(rpng, (void**)&img->pixels,
+            (size_t)len, &img->width, &img->height);
+   } while (retval == IMAGE_PROCESS_NEXT);
+
+   ret = retval != IMAGE_PROCESS_ERROR && retval != IMAGE_PROCESS_ERROR_END;
+
+end:
+   rpng_free(rpng);
+   free(buf);
+   return ret;
+}
+
+/* What a thumbnail load costs with and without the cache. The
+ * cache side includes the stat()s of gfx_thumbnail_cache_key(). */
+static bool test_bench(uint32_t **pixels)
+{
+   unsigned pass, i;
+   char path[PATH_MAX_LENGTH];
+   uint64_t decode_ns       = 0;
+   uint64_t load_ns         = 0;
+   struct texture_image img = {0};
+   gfx_thumbnail_cache_t *cache;
+
+   test_clear_dir(test_cache_dir);
+   cache = gfx_thumbnail_cache_new(test_cache_dir, 64 << 20);
+   TEST_CHECK(cache);
+
+   for (i = 0; i < TEST_IMAGES; i++)
+   {
+      test_image_path(i, path, sizeof(path));
+      TEST_CHECK(test_decode(path, &img));
+      TEST_CHECK(test_same(&img, pixels[i]));
+      TEST_CHECK(gfx_thumbnail_cache_store(cache,
+               gfx_thumbnail_cache_key(path, 0, false), &img));
+      free(img.pixels);
+   }
+
+   for (pass = 0; pass < TEST_PASSES; pass++)
+   {
+      for (i = 0; i < TEST_IMAGES; i++)
+      {
+         uint64_t start;
+         uint64_t key;
+
+         test_image_path(i, path, sizeof(path));
+
+         start      = test_now_ns();
+         TEST_CHECK(test_decode(path, &img));
+         decode_ns += test_now_ns() - start;
+         free(img.pixels);
+
+         start      = test_now_ns();
+         key        = gfx_thumbnail_cache_key(path, 0, false);
+         TEST_CHECK(gfx_thumbnail_cache_contains(cache, key));
+         TEST_CHECK(gfx_thumbnail_cache_load(cache, key, &img));
+         load_ns   += test_now_ns() - start;
+         TEST_CHECK(test_same(&img, pixels[i]));
+         free(img.pixels);
+      }
+   }
+
+   gfx_thumbnail_cache_free(cache);
+
+   printf("%ux%u thumbnail: PNG decode %8.1f us, cache hit %8.1f us\n",
+         TEST_SIZE, TEST_SIZE,
+         decode_ns / 1000.0 / (TEST_PASSES * TEST_IMAGES),
+         load_ns   / 1000.0 / (TEST_PASSES * TEST_IMAGES));
+   return true;
+}
+
+int main(int argc, char *argv[])
+{
+   unsigned i;
+   uint32_t *pixels[TEST_IMAGES];
+   bool ok = true;
+
+   strlcpy(test_dir, argc > 1 ? argv[1] : "thumbnail_cache_scratch",
+         sizeof(test_dir));
+   fill_pathname_join(test_cache_dir, test_dir, "cache",
+         sizeof(test_cache_dir));
+
+   if (!path_is_directory(test_dir) && !path_mkdir(test_dir))
+   {
+      fprintf(stderr, "Can't create %s.\n", test_dir);
+      return 1;
+   }
+
+   for (i = 0; i < TEST_IMAGES; i++)
+   {
+      char path[PATH_MAX_LENGTH];
+
+      pixels[i] = (uint32_t*)malloc(TEST_SIZE * TEST_SIZE * sizeof(uint32_t));
+      if (!pixels[i])
+         return 1;
+
+      test_fill(pixels[i], i);
+      test_image_path(i, path, sizeof(path));
+      if (!rpng_save_image_argb(path, pixels[i], TEST_SIZE, TEST_SIZE,
+               TEST_SIZE * sizeof(uint32_t)))
+      {
+         fprintf(stderr, "Can't write %s.\n", path);
+         return 1;
+      }
+   }
+
+   ok = test_cache(pixels) && ok;
+   ok = test_concurrent(pixels) && ok;
+   ok = test_bench(pixels) && ok;
+
+   test_clear_dir(test_cache_dir);
+   filestream_delete(test_cache_dir);
+   test_clear_dir(test_dir);
+   filestream_delete(test_dir);
+
+   for (i = 0; i < TEST_IMAGES; i++)
+      free(pixels[i]);
+
+   return ok ? 0 : 1;
+}
@@ -0,0 +1,181 @@
+/* Copyright  (C) 2010-2020 The RetroArch team
+ *
+ * ---------------------------------------------------------------------------------------
+ * The following license statement only applies to this file (savestate_pool_test.c).
+ * ---------------------------------------------------------------------------------------
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/* Checks that the savestate pool hands out the current state without
+ * serializing the core again, and serializes anew once the core ran,
+ * had a state loaded or had its memory written. Also checks that
+ * released buffers are recycled.
+ *
+ * Usage: savestate_pool_test */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include <boolean.h>
+
+#include "../../../core.h"
+#include "../../../managers/savestate_pool.h"
+
+#define TEST_CHECK(cond) \
+   do \
+   { \
+      if (!(cond)) \
+      { \
+         fprintf(stderr, "%s:%d: check failed: %s\n", \
+               __FILE__, __LINE__, #cond); \
+         return false; \
+      } \
+   } while (0)
+
+#define TEST_STATE_SIZE 10000
+
+static uint8_t core_memory[TEST_STATE_SIZE];
+static unsigned serialize_calls;
+
+/* Fake core */
+bool core_serialize(retro_ctx_serialize_info_t *info)
+{
+   serialize_calls++;
+   memcpy(info->data, core_memory, info->size);
+   return true;
+}
+
+void RARCH_LOG(const char *fmt, ...) { }
+
+/* What the frontend does around a frame of emulation */
+static void test_run_frame(uint8_t value)
+{
+   savestate_pool_invalidate();
+   memset(core_memory, value, sizeof(core_memory));
+}
+
+static bool test_reuse(void)
+{
+   uint8_t copy[TEST_STATE_SIZE];
+   struct savestate_pool_stats total;
+   savestate_buf_t *a, *b;
+
+   test_run_frame(1);
+   serialize_calls = 0;
+
+   /* Run-ahead saves, then rewind and netplay ask again */
+   a = savestate_pool_snapshot(TEST_STATE_SIZE, true);
+   TEST_CHECK(a && a->data[0] == 1);
+   b = savestate_pool_snapshot(TEST_STATE_SIZE, true);
+   TEST_CHECK(b == a && a->refs == 3);
+   TEST_CHECK(savestate_pool_serialize_to(copy, TEST_STATE_SIZE, true));
+   TEST_CHECK(memcmp(copy, a->data, TEST_STATE_SIZE) == 0);
+   TEST_CHECK(serialize_calls == 1);
+
+   /* A fast state can't stand in for one leaving this instance */
+   b = savestate_pool_snapshot(TEST_STATE_SIZE, false);
+   TEST_CHECK(b && b != a && !b->fast);
+   TEST_CHECK(serialize_calls == 2);
+   savestate_buf_unref(b);
+
+   /* Nor can a state of another size */
+   b = savestate_pool_snapshot(TEST_STATE_SIZE / 2, true);
+   TEST_CHECK(b && b != a);
+   TEST_CHECK(serialize_calls == 3);
+   savestate_buf_unref(b);
+
+   savestate_pool_get_stats(NULL, &total);
+   TEST_CHECK(total.reused >= 2);
+   TEST_CHECK(total.bytes_copied >= TEST_STATE_SIZE);
+
+   savestate_buf_unref(a);
+   savestate_buf_unref(a);
+   return true;
+}
+
+static bool test_invalidate(void)
+{
+   uint8_t copy[TEST_STATE_SIZE];
+   savestate_buf_t *a, *b;
+
+   test_run_frame(2);
+   serialize_calls = 0;
+
+   a = savestate_pool_snapshot(TEST_STATE_SIZE, true);
+   TEST_CHECK(a && a->data[0] == 2);
+
+   /* The core ran: the held buffer keeps the old state */
+   test_run_frame(3);
+   b = savestate_pool_snapshot(TEST_STATE_SIZE, true);
+   TEST_CHECK(b && b != a && b->data[0] == 3 && a->data[0] == 2);
+   TEST_CHECK(serialize_calls == 2);
+   savestate_buf_unref(b);
+
+   /* Memory written from outside the core, as by cheats or the
+    * WRITE_CORE_RAM network command */
+   savestate_pool_invalidate();
+   core_memory[TEST_STATE_SIZE - 1] = 0x55;
+   TEST_CHECK(savestate_pool_serialize_to(copy, TEST_STATE_SIZE, true));
+   TEST_CHECK(copy[TEST_STATE_SIZE - 1] == 0x55);
+   TEST_CHECK(serialize_calls == 3);
+
+   /* Loading 'a' makes it current again */
+   memset(core_memory, 2, sizeof(core_memory));
+   savestate_pool_set_current(a);
+   b = savestate_pool_snapshot(TEST_STATE_SIZE, true);
+   TEST_CHECK(b == a);
+   TEST_CHECK(serialize_calls == 3);
+   savestate_buf_unref(b);
+
+   savestate_pool_invalidate();
+   TEST_CHECK(a->refs == 1);
+   savestate_buf_unref(a);
+   return true;
+}
+
+static bool test_recycle(void)
+{
+   savestate_buf_t *a, *b;
+
+   a = savestate_pool_alloc(TEST_STATE_SIZE);
+   TEST_CHECK(a && a->capacity >= TEST_STATE_SIZE && a->refs == 1);
+   savestate_buf_unref(a);
+
+   /* Same size class, same buffer */
+   b = savestate_pool_alloc(TEST_STATE_SIZE - 16);
+   TEST_CHECK(b == a && b->size == TEST_STATE_SIZE - 16);
+   savestate_buf_unref(b);
+
+   TEST_CHECK(!savestate_pool_alloc(0));
+   return true;
+}
+
+int main(int argc, char *argv[])
+{
+   bool ok = true;
+
+   ok = test_reuse()      && ok;
+   ok = test_invalidate() && ok;
+   ok = test_recycle()    && ok;
+
+   savestate_pool_deinit();
+
+   printf("%s\n", ok ? "ok" : "FAILED");
+   return ok ? 0 : 1;
+}
@@ -0,0 +1,239 @@
+/*  RetroArch - A frontend for libretro.
+ *  Copyright (C) 2010-2020 - The RetroArch team
+ *
+ *  RetroArch is free software: you can redistribute it and/or modify it under the terms
+ *  of the GNU General Public License as published by the Free Software Found-
+ *  ation, either version 3 of the License, or (at your option) any later version.
+ *
+ *  RetroArch is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ *  PURPOSE.  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with RetroArch.
+ *  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Replays consecutive savestates through every rewind diff
+ * implementation supported by this CPU, checks that each patch
+ * restores the older state, and reports compress and decompress
+ * throughput.
+ *
+ * Usage: state_manager_bench [-p passes] [state files...]
+ *
+ * The state files are taken in order, each one diffed against the
+ * one before it; capture them with frame advance and save state, or
+ * with a core's serialize callback. Without files, synthetic 4 MB
+ * states with sparse changes are used. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <features/features_cpu.h>
+
+#include "../../../managers/state_manager_diff.h"
+
+#define BENCH_SYNTHETIC_SIZE   (4 << 20)
+#define BENCH_SYNTHETIC_STATES 16
+
+static uint32_t bench_rng = 0x12345678;
+
+static uint32_t bench_rand(void)
+{
+   bench_rng = bench_rng * 1664525 + 1013904223;
+   return bench_rng >> 8;
+}
+
+static uint8_t *bench_load(const char *path, size_t *size)
+{
+   long len;
+   uint8_t *buf = NULL;
+   FILE *file   = fopen(path, "rb");
+
+   if (!file)
+      return NULL;
+
+   fseek(file, 0, SEEK_END);
+   len = ftell(file);
+   fseek(file, 0, SEEK_SET);
+
+   if (len > 0 && (buf = (uint8_t*)state_manager_raw_alloc(len)))
+   {
+      if (fread(buf, 1, len, file) != (size_t)len)
+      {
+         free(buf);
+         buf = NULL;
+      }
+      *size = len;
+   }
+
+   fclose(file);
+   return buf;
+}
+
+/* Mimics emulated RAM: a few runs of rewritten data and
+ * scattered single word updates each frame. */
+static void bench_mutate(uint8_t *state, size_t size)
+{
+   unsigned i;
+
+   for (i = 0; i < 64; i++)
+   {
+      size_t run   = 16 + bench_rand() % 2048;
+      size_t start = bench_rand() % size;
+      size_t j;
+
+      if (start + run > size)
+         run = size - start;
+      for (j = 0; j < run; j++)
+         state[start + j] ^= (uint8_t)bench_rand();
+   }
+
+   for (i = 0; i < 4096; i++)
+      state[bench_rand() % size]++;
+}
+
+int main(int argc, char *argv[])
+{
+   unsigned impl, i;
+   uint8_t *patch;
+   uint8_t *scratch;
+   uint8_t **states  = NULL;
+   unsigned count    = 0;
+   unsigned passes   = 4;
+   size_t size       = 0;
+   size_t maxsize;
+   int first_file    = 1;
+   int ret           = 0;
+
+   if (argc > 2 && !strcmp(argv[1], "-p"))
+   {
+      passes     = (unsigned)strtoul(argv[2], NULL, 0);
+      first_file = 3;
+   }
+
+   if (first_file < argc)
+   {
+      count  = argc - first_file;
+      states = (uint8_t**)calloc(count, sizeof(*states));
+
+      for (i = 0; i < count; i++)
+      {
+         size_t len = 0;
+
+         if (!(states[i] = bench_load(argv[first_file + i], &len)))
+         {
+            fprintf(stderr, "Failed to load %s\n", argv[first_file + i]);
+            return 1;
+         }
+         if (i && len != size)
+         {
+            fprintf(stderr, "%s: size differs from the previous state\n",
+                  argv[first_file + i]);
+            return 1;
+         }
+         size = len;
+      }
+   }
+   else
+   {
+      count  = BENCH_SYNTHETIC_STATES;
+      size   = BENCH_SYNTHETIC_SIZE;
+      states = (uint8_t**)calloc(count, sizeof(*states));
+
+      for (i = 0; i < count; i++)
+      {
+         states[i] = (uint8_t*)state_manager_raw_alloc(size);
+         if (i)
+         {
+            memcpy(states[i], states[i - 1], size);
+            bench_mutate(states[i], size);
+         }
+         else
+         {
+            size_t j;
+            for (j = 0; j < size; j++)
+               states[i][j] = (uint8_t)bench_rand();
+         }
+      }
+   }
+
+   if (count < 2)
+   {
+      fprintf(stderr, "Need at least two states\n");
+      return 1;
+   }
+
+   maxsize = state_manager_raw_maxsize(size);
+   patch   = (uint8_t*)malloc(maxsize);
+   scratch = (uint8_t*)state_manager_raw_alloc(size);
+
+   printf("%u states of %u bytes, %u passes\n",
+         count, (unsigned)size, passes);
+
+   for (impl = 0; impl < STATE_MANAGER_DIFF_IMPL_LAST; impl++)
+   {
+      unsigned pass;
+      retro_time_t comp_time   = 0;
+      retro_time_t decomp_time = 0;
+      size_t patch_bytes       = 0;
+      double mb                = (double)size * (count - 1) * passes
+         / (1024.0 * 1024.0);
+      const char *name         = state_manager_diff_impl_name(
+            (enum state_manager_diff_impl)impl);
+
+      if (!state_manager_diff_impl_supported(
+               (enum state_manager_diff_impl)impl))
+      {
+         printf("%-8s: not supported\n", name);
+         continue;
+      }
+
+      for (pass = 0; pass < passes; pass++)
+      {
+         for (i = 1; i < count; i++)
+         {
+            size_t len;
+            retro_time_t start = cpu_features_get_time_usec();
+
+            len = state_manager_raw_compress_with_impl(
+                  (enum state_manager_diff_impl)impl,
+                  states[i - 1], states[i], size, patch);
+            comp_time += cpu_features_get_time_usec() - start;
+
+            memcpy(scratch, states[i], size);
+
+            start = cpu_features_get_time_usec();
+            state_manager_raw_decompress(patch, len, scratch, size);
+            decomp_time += cpu_features_get_time_usec() - start;
+
+            if (memcmp(scratch, states[i - 1], size))
+            {
+               fprintf(stderr, "%s: patch %u does not restore the state\n",
+                     name, i);
+               ret = 1;
+            }
+
+            patch_bytes += len;
+         }
+      }
+
+      if (comp_time <= 0)
+         comp_time = 1;
+      if (decomp_time <= 0)
+         decomp_time = 1;
+
+      printf("%-8s: compress %8.1f MB/s, decompress %8.1f MB/s, "
+            "patch %5.2f%% of state\n", name,
+            mb / (comp_time / 1e6), mb / (decomp_time / 1e6),
+            100.0 * patch_bytes / ((double)size * (count - 1) * passes));
+   }
+
+   for (i = 0; i < count; i++)
+      free(states[i]);
+   free(states);
+   free(patch);
+   free(scratch);
+
+   return ret;
+}
@@ -0,0 +1,387 @@
+/* Copyright  (C) 2010-2020 The RetroArch team
+ *
+ * ---------------------------------------------------------------------------------------
+ * The following license statement only applies to this file (state_manager_test.c).
+ * ---------------------------------------------------------------------------------------
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/* Drives rewind through the state manager's public entry points
+ * against a fake core, and checks that every rewound frame gives
+ * back exactly the state that was pushed for it, with the deltas
+ * computed on the main thread and on diff workers, and with older
+ * patches going through the zlib archive. Archive errors are
+ * injected to check that rewinding then stops short rather than
+ * going wrong.
+ *
+ * Usage: state_manager_test */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include <boolean.h>
+#include <streams/trans_stream.h>
+
+#include "../../../core.h"
+#include "../../../msg_hash.h"
+#include "../../../retroarch.h"
+#include "../../../managers/state_manager.h"
+#include "../../../managers/savestate_pool.h"
+
+#define TEST_CHECK(cond) \
+   do \
+   { \
+      if (!(cond)) \
+      { \
+         fprintf(stderr, "%s:%d: check failed: %s\n", \
+               __FILE__, __LINE__, #cond); \
+         return false; \
+      } \
+   } while (0)
+
+/* Large enough to be split into several diff ranges per worker */
+#define TEST_STATE_SIZE (1 << 20)
+#define TEST_FRAMES     48
+
+static uint8_t *core_state;
+static uint8_t *history[TEST_FRAMES * 2 + 1];
+static unsigned history_count;
+static uint32_t test_rng = 0x2545f491;
+
+/* Archive streams, failing their Nth call when counted down to 0 */
+static struct trans_stream_backend test_deflate_backend;
+static struct trans_stream_backend test_inflate_backend;
+static int test_deflate_fail = -1;
+static int test_inflate_fail = -1;
+/* Patches archived since the injected deflate error */
+static int test_deflated_after;
+static const uint8_t *test_in;
+static uint32_t test_in_size;
+
+/* Fake core and frontend */
+bool core_serialize_size(retro_ctx_size_info_t *info)
+{
+   info->size = TEST_STATE_SIZE;
+   return true;
+}
+
+bool core_serialize(retro_ctx_serialize_info_t *info)
+{
+   memcpy(info->data, core_state, TEST_STATE_SIZE);
+   return true;
+}
+
+bool core_unserialize(retro_ctx_serialize_info_t *info)
+{
+   memcpy(core_state, info->data_const, TEST_STATE_SIZE);
+   savestate_pool_invalidate();
+   return true;
+}
+
+bool core_set_rewind_callbacks(void) { return true; }
+bool audio_driver_has_callback(void) { return false; }
+void audio_driver_setup_rewind(void) { }
+void audio_driver_frame_is_reverse(void) { }
+bool rarch_ctl(enum rarch_ctl_state state, void *data) { return false; }
+const char *msg_hash_to_str(enum msg_hash_enums msg) { return ""; }
+
+void RARCH_LOG(const char *fmt, ...) { }
+void RARCH_WARN(const char *fmt, ...) { }
+
+void RARCH_ERR(const char *fmt, ...)
+{
+   va_list ap;
+   va_start(ap, fmt);
+   vfprintf(stderr, fmt, ap);
+   va_end(ap);
+}
+
+/* Leaves the stream mid-way, as a real error would */
+static bool test_trans_fail(const struct trans_stream_backend *real,
+      void *data, uint32_t *rd, uint32_t *wn,
+      enum trans_stream_error *error)
+{
+   real->set_in(data, test_in, test_in_size / 2);
+   real->trans(data, false, rd, wn, error);
+   *error = TRANS_STREAM_ERROR_OTHER;
+   return false;
+}
+
+static void test_set_in(void *data, const uint8_t *in, uint32_t in_size)
+{
+   test_in      = in;
+   test_in_size = in_size;
+   zlib_deflate_backend.set_in(data, in, in_size);
+}
+
+static void test_inflate_set_in(void *data, const uint8_t *in,
+      uint32_t in_size)
+{
+   test_in      = in;
+   test_in_size = in_size;
+   zlib_inflate_backend.set_in(data, in, in_size);
+}
+
+static bool test_deflate_trans(void *data, bool flush,
+      uint32_t *rd, uint32_t *wn, enum trans_stream_error *error)
+{
+   if (test_deflate_fail >= 0 && test_deflate_fail-- == 0)
+   {
+      test_deflated_after = 0;
+      return test_trans_fail(&zlib_deflate_backend, data, rd, wn, error);
+   }
+   if (!zlib_deflate_backend.trans(data, flush, rd, wn, error))
+      return false;
+   test_deflated_after++;
+   return true;
+}
+
+static bool test_inflate_trans(void *data, bool flush,
+      uint32_t *rd, uint32_t *wn, enum trans_stream_error *error)
+{
+   if (test_inflate_fail >= 0 && test_inflate_fail-- == 0)
+      return test_trans_fail(&zlib_inflate_backend, data, rd, wn, error);
+   return zlib_inflate_backend.trans(data, flush, rd, wn, error);
+}
+
+const struct trans_stream_backend *trans_stream_get_zlib_deflate_backend(void)
+{
+   test_deflate_backend        = zlib_deflate_backend;
+   test_deflate_backend.set_in = test_set_in;
+   test_deflate_backend.trans  = test_deflate_trans;
+   return &test_deflate_backend;
+}
+
+const struct trans_stream_backend *trans_stream_get_zlib_inflate_backend(void)
+{
+   test_inflate_backend        = zlib_inflate_backend;
+   test_inflate_backend.set_in = test_inflate_set_in;
+   test_inflate_backend.trans  = test_inflate_trans;
+   return &test_inflate_backend;
+}
+
+static uint32_t test_rand(void)
+{
+   test_rng ^= test_rng << 13;
+   test_rng ^= test_rng >> 17;
+   test_rng ^= test_rng << 5;
+   return test_rng;
+}
+
+/* Runs the fake core for a frame: a few scattered bytes, a run that
+ * may straddle diff ranges and, now and then, a large rewrite */
+static void test_run_frame(void)
+{
+   unsigned i;
+   size_t start, len;
+
+   for (i = 0; i < 64; i++)
+      core_state[test_rand() % TEST_STATE_SIZE] = (uint8_t)test_rand();
+
+   start = test_rand() % TEST_STATE_SIZE;
+   len   = 1 + test_rand() % 8192;
+   if (start + len > TEST_STATE_SIZE)
+      len = TEST_STATE_SIZE - start;
+   memset(core_state + start, (uint8_t)test_rand(), len);
+
+   if (test_rand() % 8 == 0)
+      for (i = 0; i < TEST_STATE_SIZE / 4; i++)
+         core_state[i * 4 + 1] ^= (uint8_t)test_rand();
+
+   savestate_pool_invalidate();
+}
+
+/* Pushes the current core state, remembering it */
+static bool test_push(void)
+{
+   char msg[64];
+   unsigned time = 0;
+
+   TEST_CHECK(history_count < sizeof(history) / sizeof(history[0]));
+   TEST_CHECK(!state_manager_check_rewind(false, 1, false,
+            msg, sizeof(msg), &time));
+
+   history[history_count] = (uint8_t*)malloc(TEST_STATE_SIZE);
+   TEST_CHECK(history[history_count]);
+   memcpy(history[history_count++], core_state, TEST_STATE_SIZE);
+   return true;
+}
+
+/* Rewinds one step and checks the core got the newest remembered
+ * state back. With 'may_end', the buffer may have dropped it. */
+static bool test_pop(bool may_end, bool *ended)
+{
+   char msg[64];
+   unsigned time = 0;
+
+   TEST_CHECK(state_manager_check_rewind(true, 1, false,
+         msg, sizeof(msg), &time));
+
+   /* Past the oldest state, rewinding must stop */
+   *ended = !state_manager_frame_is_reversed();
+   if (*ended)
+   {
+      TEST_CHECK(may_end || history_count == 0);
+      return true;
+   }
+
+   TEST_CHECK(history_count > 0);
+
+   history_count--;
+   TEST_CHECK(memcmp(core_state, history[history_count],
+            TEST_STATE_SIZE) == 0);
+   free(history[history_count]);
+   return true;
+}
+
+static void test_history_free(void)
+{
+   while (history_count > 0)
+      free(history[--history_count]);
+}
+
+/**
+ * test_rewind:
+ * @threads              : diff worker threads.
+ * @buffer_size          : rewind buffer size in bytes.
+ * @archive_size         : zlib archive size in bytes.
+ *
+ * Pushes frames, rewinds part of the way, branches off with new
+ * frames and rewinds back to the start. With a small buffer,
+ * rewinding may end early, but never on a wrong state.
+ *
+ * Returns: number of frames rewound, or -1 on failure.
+ **/
+static int test_rewind(unsigned threads, size_t buffer_size,
+      size_t archive_size)
+{
+   unsigned i;
+   bool ended  = false;
+   bool bound  = buffer_size < (size_t)TEST_STATE_SIZE * TEST_FRAMES;
+   int rewound = 0;
+
+   /* Same frames every run */
+   test_rng = 0x2545f491;
+   memset(core_state, 0, TEST_STATE_SIZE);
+
+   state_manager_event_init(buffer_size, archive_size, threads, NULL);
+   history[history_count] = (uint8_t*)malloc(TEST_STATE_SIZE);
+   if (!history[history_count])
+      return -1;
+   memcpy(history[history_count++], core_state, TEST_STATE_SIZE);
+
+   for (i = 0; i < TEST_FRAMES; i++)
+   {
+      test_run_frame();
+      if (!test_push())
+         return -1;
+   }
+
+   for (i = 0; i < TEST_FRAMES / 3; i++)
+      if (!test_pop(false, &ended))
+         return -1;
+
+   for (i = 0; i < TEST_FRAMES / 2; i++)
+   {
+      test_run_frame();
+      if (!test_push())
+         return -1;
+   }
+
+   while (history_count > 0)
+   {
+      if (!test_pop(bound, &ended))
+         return -1;
+      if (ended)
+         break;
+      rewound++;
+   }
+
+   /* Reaching the end keeps the oldest state */
+   if (!ended)
+   {
+      if (!test_pop(true, &ended) || !ended)
+         return -1;
+   }
+
+   state_manager_event_deinit();
+   test_history_free();
+   return rewound;
+}
+
+int main(int argc, char *argv[])
+{
+   char msg[64];
+   unsigned time = 0;
+   int full_main, full_workers, bound;
+   int archived_main, archived_workers, deflate_error, inflate_error;
+   int deflated_after;
+   bool ok = true;
+
+   core_state = (uint8_t*)calloc(1, TEST_STATE_SIZE);
+   if (!core_state)
+      return 1;
+
+   /* The very first call only primes the rewind hotkey state */
+   state_manager_check_rewind(false, 1, false, msg, sizeof(msg), &time);
+
+   full_main    = test_rewind(0, (size_t)128 << 20, 0);
+   full_workers = test_rewind(3, (size_t)128 << 20, 0);
+   bound        = test_rewind(2, (size_t)6 << 20, 0);
+
+   /* Everything dropped from the small buffer is archived */
+   archived_main    = test_rewind(0, (size_t)6 << 20, (size_t)64 << 20);
+   archived_workers = test_rewind(2, (size_t)6 << 20, (size_t)64 << 20);
+
+   /* A failed deflate loses the older archive, but the patches
+    * archived after it must all come back */
+   test_deflate_fail = 8;
+   deflate_error     = test_rewind(2, (size_t)6 << 20, (size_t)64 << 20);
+   deflated_after    = test_deflated_after;
+   test_deflate_fail = -1;
+
+   /* A failed inflate ends rewinding at the last good state */
+   test_inflate_fail = 4;
+   inflate_error     = test_rewind(2, (size_t)6 << 20, (size_t)64 << 20);
+   test_inflate_fail = -1;
+
+   printf("rewound: %d main thread, %d workers, %d bounded\n",
+         full_main, full_workers, bound);
+   printf("archived: %d main thread, %d workers, %d deflate error, "
+         "%d inflate error\n", archived_main, archived_workers,
+         deflate_error, inflate_error);
+
+   /* Every frame comes back from a large enough buffer */
+   ok = ok && full_main    == 1 + TEST_FRAMES - TEST_FRAMES / 3
+      + TEST_FRAMES / 2;
+   ok = ok && full_workers == full_main;
+   ok = ok && bound > 0 && bound < full_main;
+   ok = ok && archived_main    == full_main;
+   ok = ok && archived_workers == full_main;
+   ok = ok && deflated_after > 0;
+   ok = ok && deflate_error == bound + deflated_after;
+   ok = ok && inflate_error == bound + 4;
+
+   test_history_free();
+   savestate_pool_deinit();
+   free(core_state);
+
+   printf("%s\n", ok ? "ok" : "FAILED");
+   return ok ? 0 : 1;
+}
@@ -0,0 +1,240 @@
+/*  RetroArch - A frontend for libretro.
+ *  Copyright (C) 2016-2017 - Gregor Richards
+ *
+ *  RetroArch is free software: you can redistribute it and/or modify it under the terms
+ *  of the GNU General Public License as published by the Free Software Found-
+ *  ation, either version 3 of the License, or (at your option) any later version.
+ *
+ *  RetroArch is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ *  PURPOSE.  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with RetroArch.
+ *  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Stores a run of states in the netplay frame buffer as patches and reads
+ * every frame back, in order, at random and after rewinding to replay.
+ * Then breaks the chain of patches the way a failed allocation does, and
+ * checks that the frames past the break read as lost (NULL) instead of
+ * as some other state.
+ *
+ * Usage: delta_chain_test [state bytes] [frames] */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <boolean.h>
+
+#include "../../../network/netplay/netplay_private.h"
+
+#define TEST_CHECK(cond) \
+   do \
+   { \
+      if (!(cond)) \
+      { \
+         fprintf(stderr, "%s:%d: check failed: %s\n", \
+               __FILE__, __LINE__, #cond); \
+         return false; \
+      } \
+   } while (0)
+
+#define TEST_BUFFER_SIZE 16
+
+static uint32_t test_rand_state = 0x12345678;
+
+/* States the frames in the buffer should read as */
+static uint8_t *test_states[TEST_BUFFER_SIZE];
+
+void RARCH_LOG(const char *fmt, ...) { }
+
+static uint32_t test_rand(void)
+{
+   test_rand_state = test_rand_state * 1664525 + 1013904223;
+   return test_rand_state >> 8;
+}
+
+/* Runs the fake core a frame from the state in 'from', changing a few
+ * bytes like most emulated memory does */
+static void test_run(netplay_t *netplay, const uint8_t *from, uint8_t *to)
+{
+   unsigned i;
+   unsigned changes = 1 + test_rand() % 64;
+
+   memcpy(to, from, netplay->state_size);
+   for (i = 0; i < changes; i++)
+      to[test_rand() % netplay->state_size] = (uint8_t)test_rand();
+}
+
+static void test_store(netplay_t *netplay, size_t ptr, const uint8_t *state)
+{
+   memcpy(netplay_delta_frame_state_buffer(netplay), state,
+         netplay->state_size);
+   netplay_delta_frame_store_state(netplay, ptr);
+   if (state != test_states[ptr])
+      memcpy(test_states[ptr], state, netplay->state_size);
+}
+
+static bool test_matches(netplay_t *netplay, size_t ptr)
+{
+   const void *state = netplay_delta_frame_state(netplay, ptr);
+   return state && !memcmp(state, test_states[ptr], netplay->state_size);
+}
+
+/* Runs 'frames' frames from 'ptr', returning the pointer to the last */
+static size_t test_run_frames(netplay_t *netplay, size_t ptr,
+      unsigned frames)
+{
+   unsigned i;
+
+   for (i = 0; i < frames; i++)
+   {
+      size_t next = NEXT_PTR(ptr);
+      test_run(netplay, test_states[ptr], test_states[next]);
+      test_store(netplay, next, test_states[next]);
+      ptr = next;
+   }
+
+   return ptr;
+}
+
+static bool test_round_trip(netplay_t *netplay, unsigned frames)
+{
+   unsigned i;
+   size_t ptr, head;
+   uint8_t *first = (uint8_t*)malloc(netplay->state_size);
+
+   TEST_CHECK(first);
+   for (i = 0; i < netplay->state_size; i++)
+      first[i] = (test_rand() & 7) ? 0 : (uint8_t)test_rand();
+   test_store(netplay, 0, first);
+   free(first);
+
+   head = test_run_frames(netplay, 0, frames);
+
+   /* Newest first, then oldest first, then at random. Every frame still
+    * in the buffer can be rebuilt. */
+   for (i = 0, ptr = head; i < TEST_BUFFER_SIZE; i++, ptr = PREV_PTR(ptr))
+      TEST_CHECK(test_matches(netplay, ptr));
+   for (i = 0, ptr = NEXT_PTR(head); i < TEST_BUFFER_SIZE;
+         i++, ptr = NEXT_PTR(ptr))
+      TEST_CHECK(test_matches(netplay, ptr));
+   for (i = 0; i < 4 * TEST_BUFFER_SIZE; i++)
+      TEST_CHECK(test_matches(netplay, test_rand() % TEST_BUFFER_SIZE));
+
+   /* Rewind half the buffer and replay with different input. The frames
+    * replayed over are discarded, the ones before stay readable. */
+   ptr = head;
+   for (i = 0; i < TEST_BUFFER_SIZE / 2; i++)
+      ptr = PREV_PTR(ptr);
+   test_store(netplay, ptr, test_states[ptr]);
+   TEST_CHECK(test_matches(netplay, ptr));
+   TEST_CHECK(!netplay_delta_frame_state(netplay, NEXT_PTR(ptr)));
+   TEST_CHECK(!netplay_delta_frame_state(netplay, head));
+
+   head = test_run_frames(netplay, ptr, TEST_BUFFER_SIZE / 2);
+   for (i = 0, ptr = head; i < TEST_BUFFER_SIZE; i++, ptr = PREV_PTR(ptr))
+      TEST_CHECK(test_matches(netplay, ptr));
+
+   return true;
+}
+
+static bool test_broken_chain(netplay_t *netplay)
+{
+   unsigned i;
+   size_t ptr, broken;
+   size_t head = netplay->state_head_ptr;
+
+   /* Lose the patch of a frame in the middle, as a failed allocation in
+    * netplay_delta_frame_diff does */
+   broken = head;
+   for (i = 0; i < TEST_BUFFER_SIZE / 2; i++)
+      broken = PREV_PTR(broken);
+   netplay->buffer[broken].patch_size = 0;
+
+   /* Start with a state past the break in scratch, so reading across the
+    * break can't reuse it either */
+   TEST_CHECK(test_matches(netplay, NEXT_PTR(broken)));
+
+   for (ptr = head; ptr != broken; ptr = PREV_PTR(ptr))
+      TEST_CHECK(test_matches(netplay, ptr));
+   for (; ptr != head; ptr = PREV_PTR(ptr))
+   {
+      struct delta_frame *delta = &netplay->buffer[ptr];
+
+      TEST_CHECK(!netplay_delta_frame_state(netplay, ptr));
+      TEST_CHECK(netplay_delta_frame_crc(netplay, delta) == 0);
+      TEST_CHECK(!netplay_delta_frame_hash_tree(netplay, delta,
+               &netplay->hash_tree));
+      TEST_CHECK(!netplay->hash_tree.valid);
+   }
+
+   /* Going on from the newest frame links up again */
+   head = test_run_frames(netplay, head, 3);
+   TEST_CHECK(test_matches(netplay, PREV_PTR(head)));
+   TEST_CHECK(test_matches(netplay, NEXT_PTR(broken)));
+   TEST_CHECK(!netplay_delta_frame_state(netplay, PREV_PTR(broken)));
+
+   /* A frame never stored reads as lost too */
+   netplay_delta_states_free(netplay);
+   TEST_CHECK(netplay_delta_states_init(netplay));
+   for (ptr = 0; ptr < TEST_BUFFER_SIZE; ptr++)
+      netplay->buffer[ptr].patch_size = 0;
+   TEST_CHECK(!netplay_delta_frame_state(netplay, 0));
+   test_store(netplay, 1, test_states[1]);
+   TEST_CHECK(test_matches(netplay, 1));
+   TEST_CHECK(!netplay_delta_frame_state(netplay, 0));
+
+   return true;
+}
+
+int main(int argc, char *argv[])
+{
+   size_t i;
+   bool ok            = false;
+   unsigned frames    = 100;
+   netplay_t *netplay = (netplay_t*)calloc(1, sizeof(*netplay));
+
+   if (!netplay)
+      return 1;
+
+   /* Odd on purpose, the diff scanners work on 16-bit words */
+   netplay->state_size  = 65537;
+   if (argc > 1)
+      netplay->state_size = strtoul(argv[1], NULL, 0);
+   if (argc > 2)
+      frames = strtoul(argv[2], NULL, 0);
+   if (!netplay->state_size || frames < TEST_BUFFER_SIZE)
+      return 1;
+
+   netplay->buffer_size = TEST_BUFFER_SIZE;
+   netplay->buffer      = (struct delta_frame*)calloc(TEST_BUFFER_SIZE,
+         sizeof(*netplay->buffer));
+   if (!netplay->buffer)
+      goto end;
+
+   for (i = 0; i < TEST_BUFFER_SIZE; i++)
+      if (!(test_states[i] = (uint8_t*)malloc(netplay->state_size)))
+         goto end;
+
+   if (!netplay_delta_states_init(netplay))
+      goto end;
+
+   ok = test_round_trip(netplay, frames)
+      && test_broken_chain(netplay);
+
+   printf("%s\n", ok ? "ok" : "FAILED");
+
+end:
+   netplay_delta_states_free(netplay);
+   if (netplay->buffer)
+      for (i = 0; i < TEST_BUFFER_SIZE; i++)
+         netplay_delta_frame_free(&netplay->buffer[i]);
+   for (i = 0; i < TEST_BUFFER_SIZE; i++)
+      free(test_states[i]);
+   free(netplay->buffer);
+   netplay_hash_tree_free(&netplay->hash_tree);
+   free(netplay);
+   return ok ? 0 : 1;
+}
@@ -0,0 +1,299 @@
+/*  RetroArch - A frontend for libretro.
+ *  Copyright (C) 2016-2017 - Gregor Richards
+ *
+ *  RetroArch is free software: you can redistribute it and/or modify it under the terms
+ *  of the GNU General Public License as published by the Free Software Found-
+ *  ation, either version 3 of the License, or (at your option) any later version.
+ *
+ *  RetroArch is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ *  PURPOSE.  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with RetroArch.
+ *  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Times a netplay frame check done with a CRC-32 of the whole state
+ * (NETPLAY_CMD_CRC, for older peers) against one done with a hash tree
+ * (NETPLAY_CMD_FRAME_HASH), then desyncs a few bytes of a state and walks
+ * the two trees top down the way NETPLAY_CMD_REQUEST_FRAME_HASHES does,
+ * checking that exactly the blocks holding those bytes are found.
+ *
+ * Usage: frame_hash_test [state KiB] [iterations] [bytes to desync] */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <encodings/crc32.h>
+#include <features/features_cpu.h>
+
+#include "../../../network/netplay/netplay_hash.h"
+
+/* Matches NETPLAY_MAX_FRAME_HASH_REQUESTS */
+#define TEST_MAX_REQUESTS   32
+/* Command header, then frame, level and index */
+#define TEST_REQUEST_BYTES  (2 * 4 + 3 * 4)
+/* Command header, then frame, level, index and count */
+#define TEST_REPLY_BYTES    (2 * 4 + 4 * 4)
+
+struct test_node
+{
+   unsigned level;
+   size_t index;
+};
+
+static uint32_t test_rand_state = 0x12345678;
+
+static uint32_t test_rand(void)
+{
+   test_rand_state = test_rand_state * 1664525 + 1013904223;
+   return test_rand_state >> 8;
+}
+
+static double test_msec(retro_time_t usec, unsigned iterations)
+{
+   return usec / 1000.0 / iterations;
+}
+
+static void test_time_crc(const uint8_t *state, size_t size,
+      unsigned iterations)
+{
+   unsigned impl;
+
+   for (impl = 0; impl < ENCODING_CRC32_IMPL_LAST; impl++)
+   {
+      unsigned i;
+      retro_time_t start;
+      uint32_t crc = 0;
+
+      if (!encoding_crc32_impl_supported((enum encoding_crc32_impl)impl))
+         continue;
+
+      start = cpu_features_get_time_usec();
+      for (i = 0; i < iterations; i++)
+         crc = encoding_crc32_with_impl((enum encoding_crc32_impl)impl,
+               0, state, size);
+
+      printf("crc32 %-10s %8.3f ms  (%08x)\n",
+            encoding_crc32_impl_name((enum encoding_crc32_impl)impl),
+            test_msec(cpu_features_get_time_usec() - start, iterations),
+            (unsigned)crc);
+   }
+}
+
+static bool test_time_tree(struct netplay_hash_tree *tree,
+      const uint8_t *state, size_t size, unsigned iterations)
+{
+   unsigned i;
+   uint64_t root      = 0;
+   retro_time_t start = cpu_features_get_time_usec();
+
+   for (i = 0; i < iterations; i++)
+   {
+      if (!netplay_hash_tree_build(tree, state, size))
+         return false;
+      root = netplay_hash_tree_root(tree);
+   }
+
+   printf("hash tree            %8.3f ms  (%016llx, %u levels)\n",
+         test_msec(cpu_features_get_time_usec() - start, iterations),
+         (unsigned long long)root, tree->levels);
+   return true;
+}
+
+/* Walks down from the root of two trees in the order replies would
+ * arrive, returning the differing leaves found in 'found', the bytes the
+ * peers would have exchanged in 'wire' and whether the request budget
+ * ran out in 'exhausted' */
+static size_t test_walk(const struct netplay_hash_tree *local,
+      const struct netplay_hash_tree *remote, size_t *found,
+      size_t max_found, size_t *wire, bool *exhausted)
+{
+   size_t head                  = 0;
+   size_t num_queued            = 0;
+   size_t num_found             = 0;
+   struct test_node *queue      = (struct test_node*)malloc(
+         TEST_MAX_REQUESTS * sizeof(*queue));
+
+   *wire      = 0;
+   *exhausted = false;
+
+   if (!queue)
+      return 0;
+
+   if (local->levels == 1)
+   {
+      free(queue);
+      found[0] = 0;
+      return 1;
+   }
+
+   queue[num_queued].level   = local->levels - 1;
+   queue[num_queued++].index = 0;
+
+   while (head < num_queued)
+   {
+      size_t j, first, count;
+      struct test_node node = queue[head++];
+
+      count  = netplay_hash_tree_children(remote, node.level, node.index,
+            &first);
+      *wire += TEST_REQUEST_BYTES + TEST_REPLY_BYTES
+         + count * sizeof(uint64_t);
+
+      for (j = 0; j < count; j++)
+      {
+         if (netplay_hash_tree_node(remote, node.level - 1, first + j) ==
+               netplay_hash_tree_node(local, node.level - 1, first + j))
+            continue;
+
+         if (node.level == 1)
+         {
+            if (num_found < max_found)
+               found[num_found++] = first + j;
+         }
+         else if (num_queued < TEST_MAX_REQUESTS)
+         {
+            queue[num_queued].level   = node.level - 1;
+            queue[num_queued++].index = first + j;
+         }
+         else
+            *exhausted = true;
+      }
+   }
+
+   free(queue);
+   return num_found;
+}
+
+static int test_cmp_size(const void *a, const void *b)
+{
+   size_t x = *(const size_t*)a;
+   size_t y = *(const size_t*)b;
+   return x < y ? -1 : x > y;
+}
+
+/* Is every entry of sorted 'a' in sorted 'b'? */
+static bool test_subset(const size_t *a, size_t num_a,
+      const size_t *b, size_t num_b)
+{
+   size_t i, j = 0;
+
+   for (i = 0; i < num_a; i++)
+   {
+      while (j < num_b && b[j] < a[i])
+         j++;
+      if (j == num_b || b[j] != a[i])
+         return false;
+   }
+
+   return true;
+}
+
+int main(int argc, char *argv[])
+{
+   size_t i, size, wire;
+   bool exhausted      = false;
+   size_t num_expected = 0;
+   size_t num_found    = 0;
+   unsigned iterations = 100;
+   unsigned desyncs    = 3;
+   size_t *expected    = NULL;
+   size_t *found       = NULL;
+   uint8_t *state      = NULL;
+   uint8_t *other      = NULL;
+   bool ok             = false;
+   struct netplay_hash_tree local;
+   struct netplay_hash_tree remote;
+
+   memset(&local,  0, sizeof(local));
+   memset(&remote, 0, sizeof(remote));
+
+   size = 4096 * 1024;
+   if (argc > 1)
+      size = strtoul(argv[1], NULL, 0) * 1024;
+   if (argc > 2)
+      iterations = strtoul(argv[2], NULL, 0);
+   if (argc > 3)
+      desyncs = strtoul(argv[3], NULL, 0);
+   if (!size || !iterations)
+      return 1;
+
+   state    = (uint8_t*)malloc(size);
+   other    = (uint8_t*)malloc(size);
+   expected = (size_t*)calloc(desyncs + 1, sizeof(*expected));
+   found    = (size_t*)calloc(desyncs + 1, sizeof(*found));
+   if (!state || !other || !expected || !found)
+      goto end;
+
+   /* Mostly static, like most emulated memory */
+   for (i = 0; i < size; i++)
+      state[i] = (test_rand() & 7) ? 0 : (uint8_t)test_rand();
+
+   printf("State: %u KiB, %u iterations, %u bytes desynced\n",
+         (unsigned)(size / 1024), iterations, desyncs);
+
+   test_time_crc(state, size, iterations);
+   if (!test_time_tree(&remote, state, size, iterations))
+      goto end;
+
+   /* Desync a few bytes */
+   memcpy(other, state, size);
+   for (i = 0; i < desyncs; i++)
+   {
+      size_t j;
+      size_t offset = test_rand() % size;
+      size_t block  = offset / NETPLAY_HASH_BLOCK_SIZE;
+
+      other[offset] ^= 1 + (test_rand() % 255);
+
+      for (j = 0; j < num_expected; j++)
+         if (expected[j] == block)
+            break;
+      if (j == num_expected)
+         expected[num_expected++] = block;
+   }
+   qsort(expected, num_expected, sizeof(*expected), test_cmp_size);
+
+   if (!netplay_hash_tree_build(&local, other, size))
+      goto end;
+
+   if ((netplay_hash_tree_root(&local) == netplay_hash_tree_root(&remote))
+         != !num_expected)
+   {
+      printf("root hashes %s\n", num_expected ? "match" : "differ");
+      goto end;
+   }
+
+   if (num_expected)
+   {
+      num_found = test_walk(&local, &remote, found, desyncs + 1, &wire,
+            &exhausted);
+      qsort(found, num_found, sizeof(*found), test_cmp_size);
+
+      printf("desynced blocks:");
+      for (i = 0; i < num_found; i++)
+         printf(" 0x%X", (unsigned)(found[i] * NETPLAY_HASH_BLOCK_SIZE));
+      printf("\nfound with %u bytes exchanged (all leaf hashes: %u bytes)\n",
+            (unsigned)wire,
+            (unsigned)(local.level_size[0] * sizeof(uint64_t)));
+      if (exhausted)
+         printf("request budget exhausted, %u of %u blocks found\n",
+               (unsigned)num_found, (unsigned)num_expected);
+   }
+
+   /* Out of requests, the walk may miss blocks but not make any up */
+   ok = (num_found == num_expected || exhausted)
+      && test_subset(found, num_found, expected, num_expected);
+   printf("%s\n", ok ? "ok" : "MISMATCH");
+
+end:
+   netplay_hash_tree_free(&local);
+   netplay_hash_tree_free(&remote);
+   free(state);
+   free(other);
+   free(expected);
+   free(found);
+   return ok ? 0 : 1;
+}
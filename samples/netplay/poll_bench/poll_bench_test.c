@@ -0,0 +1,493 @@
+/*  RetroArch - A frontend for libretro.
+ *  Copyright (C) 2016-2017 - Gregor Richards
+ *
+ *  RetroArch is free software: you can redistribute it and/or modify it under the terms
+ *  of the GNU General Public License as published by the Free Software Found-
+ *  ation, either version 3 of the License, or (at your option) any later version.
+ *
+ *  RetroArch is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ *  PURPOSE.  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with RetroArch.
+ *  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Runs the server side of a netplay room full of spectators over loopback
+ * TCP. Every frame the server sends each spectator an input packet and
+ * reads whatever they sent; the spectators answer once every 60 packets.
+ *
+ * "all" reads every connection every frame, as netplay_poll_net_input did
+ * before it had a poller. The others only read the connections their
+ * netplay_poller_t backend reports. Reported is the server thread's CPU
+ * time per frame, and how much of it went on reading, as the median of
+ * several rounds taking the modes in turn. Every packet must arrive in
+ * every mode.
+ *
+ * First checks that each backend reports every socket holding data, and
+ * reports it again on the next wait if it wasn't read.
+ *
+ * Usage: poll_bench_test [spectators] [frames] [rounds] */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <poll.h>
+
+#include <net/net_compat.h>
+#include <net/net_socket.h>
+#include <rthreads/rthreads.h>
+#include <retro_timers.h>
+
+#include "../../../network/netplay/netplay_private.h"
+
+#define TEST_MAX_SPECTATORS  1024
+#define TEST_INPUT_SIZE      16
+#define TEST_REPLY_SIZE      8
+#define TEST_REPLY_EVERY     60
+#define TEST_MAX_ROUNDS      16
+#define TEST_MODES           4
+
+/* NULL reads every connection */
+static const char *test_modes[TEST_MODES] = { NULL, "select", "poll", "epoll" };
+
+struct test_result
+{
+   double total[TEST_MAX_ROUNDS];
+   double read[TEST_MAX_ROUNDS];
+   double worst[TEST_MAX_ROUNDS];
+   unsigned replies;
+   bool unavailable;
+   bool ok;
+};
+
+struct test_room
+{
+   int server_fd[TEST_MAX_SPECTATORS];
+   int client_fd[TEST_MAX_SPECTATORS];
+   size_t spectators;
+   unsigned frames;
+
+   /* Spectator results */
+   unsigned received[TEST_MAX_SPECTATORS];
+   bool failed;
+};
+
+static uint64_t test_thread_cpu_ns(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+   return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static bool test_connect(struct test_room *room)
+{
+   size_t i;
+   struct sockaddr_in addr;
+   socklen_t addr_size = sizeof(addr);
+   int listen_fd       = socket(AF_INET, SOCK_STREAM, 0);
+
+   memset(&addr, 0, sizeof(addr));
+   addr.sin_family      = AF_INET;
+   addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+   if (listen_fd < 0 ||
+       bind(listen_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 ||
+       listen(listen_fd, 16) < 0 ||
+       getsockname(listen_fd, (struct sockaddr*)&addr, &addr_size) < 0)
+      return false;
+
+   for (i = 0; i < room->spectators; i++)
+   {
+      int flag = 1;
+
+      room->client_fd[i] = socket(AF_INET, SOCK_STREAM, 0);
+      if (connect(room->client_fd[i], (struct sockaddr*)&addr,
+               sizeof(addr)) < 0)
+         return false;
+
+      if ((room->server_fd[i] = accept(listen_fd, NULL, NULL)) < 0)
+         return false;
+
+      /* As netplay_init sets up its sockets */
+      setsockopt(room->server_fd[i], IPPROTO_TCP, TCP_NODELAY,
+            (char*)&flag, sizeof(flag));
+      setsockopt(room->client_fd[i], IPPROTO_TCP, TCP_NODELAY,
+            (char*)&flag, sizeof(flag));
+
+      if (!socket_nonblock(room->server_fd[i]) ||
+          !socket_nonblock(room->client_fd[i]))
+         return false;
+   }
+
+   socket_close(listen_fd);
+   return true;
+}
+
+/* The spectators: drain input, and answer every TEST_REPLY_EVERY packets */
+static void test_spectators(void *data)
+{
+   size_t i;
+   struct test_room *room = (struct test_room*)data;
+   size_t *pending        = (size_t*)calloc(room->spectators,
+         sizeof(*pending));
+   struct pollfd *pfds    = (struct pollfd*)calloc(room->spectators,
+         sizeof(*pfds));
+   size_t done            = 0;
+
+   for (i = 0; i < room->spectators; i++)
+   {
+      pfds[i].fd     = room->client_fd[i];
+      pfds[i].events = POLLIN;
+   }
+
+   while (done < room->spectators)
+   {
+      if (poll(pfds, room->spectators, 1000) <= 0)
+      {
+         room->failed = true;
+         break;
+      }
+
+      for (i = 0; i < room->spectators; i++)
+      {
+         uint8_t buf[4096];
+         bool error = false;
+         ssize_t recvd;
+
+         if (!pfds[i].revents)
+            continue;
+
+         recvd = socket_receive_all_nonblocking(room->client_fd[i], &error,
+               buf, sizeof(buf));
+         if (recvd < 0 || error)
+         {
+            room->failed = true;
+            free(pending);
+            free(pfds);
+            return;
+         }
+
+         pending[i] += recvd;
+         while (pending[i] >= TEST_INPUT_SIZE)
+         {
+            pending[i] -= TEST_INPUT_SIZE;
+            if (++room->received[i] % TEST_REPLY_EVERY == 0)
+            {
+               uint8_t reply[TEST_REPLY_SIZE] = {0};
+               socket_send_all_blocking(room->client_fd[i], reply,
+                     sizeof(reply), true);
+            }
+         }
+
+         if (room->received[i] == room->frames)
+         {
+            pfds[i].fd = -1;
+            done++;
+         }
+      }
+   }
+
+   free(pending);
+   free(pfds);
+}
+
+struct test_server
+{
+   struct test_room *room;
+   struct socket_buffer *send_buf;
+   struct socket_buffer *recv_buf;
+   bool *readable;
+   unsigned replies;
+};
+
+static void test_readable(void *data, size_t tag)
+{
+   struct test_server *server = (struct test_server*)data;
+   server->readable[tag]      = true;
+}
+
+/* The server's side of netplay_poll_net_input: read every reply waiting */
+static bool test_server_read(struct test_server *server, size_t i)
+{
+   uint8_t reply[TEST_REPLY_SIZE];
+   ssize_t recvd;
+
+   while ((recvd = netplay_recv(&server->recv_buf[i],
+               server->room->server_fd[i], reply, sizeof(reply),
+               false)) == sizeof(reply))
+   {
+      netplay_recv_flush(&server->recv_buf[i]);
+      server->replies++;
+   }
+
+   if (recvd < 0)
+      return false;
+
+   /* Came up short. If the socket still has data, the poller reports it
+    * again. */
+   netplay_recv_reset(&server->recv_buf[i]);
+   server->readable[i] = false;
+   return true;
+}
+
+static void test_count(void *data, size_t tag)
+{
+   (*(unsigned*)data)++;
+}
+
+/* Every spectator sends a byte the server doesn't read */
+static bool test_reports(const char *ident, size_t spectators)
+{
+   size_t i;
+   unsigned first  = 0;
+   unsigned second = 0;
+   netplay_poller_t poller;
+   struct test_room room;
+   bool ok         = false;
+
+   memset(&room, 0, sizeof(room));
+   memset(&poller, 0, sizeof(poller));
+   room.spectators = spectators;
+
+   if (!test_connect(&room))
+      return false;
+
+   if (!netplay_poller_init(&poller, ident))
+   {
+      ok = true;
+      goto done;
+   }
+
+   for (i = 0; i < spectators; i++)
+   {
+      uint8_t byte = 0;
+      netplay_poller_add(&poller, room.server_fd[i], i);
+      socket_send_all_blocking(room.client_fd[i], &byte, 1, true);
+   }
+
+   netplay_poller_wait(&poller, 100, test_count, &first);
+   netplay_poller_wait(&poller, 0,   test_count, &second);
+   ok = first == spectators && second == spectators;
+
+   printf("%-7s reports %u, then %u of %u sockets %6s\n", ident,
+         first, second, (unsigned)spectators, ok ? "ok" : "FAILED");
+
+done:
+   netplay_poller_deinit(&poller);
+   for (i = 0; i < spectators; i++)
+   {
+      socket_close(room.server_fd[i]);
+      socket_close(room.client_fd[i]);
+   }
+
+   return ok;
+}
+
+static bool test_run(const char *ident, size_t spectators, unsigned frames,
+      struct test_result *result, unsigned round)
+{
+   size_t i;
+   unsigned frame;
+   netplay_poller_t poller;
+   struct test_room room;
+   struct test_server server;
+   sthread_t *thread;
+   uint64_t cpu_total = 0;
+   uint64_t cpu_read  = 0;
+   uint64_t cpu_max   = 0;
+   unsigned expected  = (unsigned)spectators * (frames / TEST_REPLY_EVERY);
+   bool ok            = true;
+
+   memset(&room, 0, sizeof(room));
+   memset(&server, 0, sizeof(server));
+   memset(&poller, 0, sizeof(poller));
+   room.spectators  = spectators;
+   room.frames      = frames;
+   server.room      = &room;
+   server.send_buf  = (struct socket_buffer*)calloc(spectators,
+         sizeof(*server.send_buf));
+   server.recv_buf  = (struct socket_buffer*)calloc(spectators,
+         sizeof(*server.recv_buf));
+   server.readable  = (bool*)calloc(spectators, sizeof(*server.readable));
+
+   if (!test_connect(&room))
+   {
+      fprintf(stderr, "Failed to set up the loopback connections.\n");
+      return false;
+   }
+
+   if (ident && !netplay_poller_init(&poller, ident))
+   {
+      result->unavailable = true;
+      goto done;
+   }
+
+   for (i = 0; i < spectators; i++)
+   {
+      netplay_init_socket_buffer(&server.send_buf[i], 4096);
+      netplay_init_socket_buffer(&server.recv_buf[i], 4096);
+      if (ident)
+         netplay_poller_add(&poller, room.server_fd[i], i);
+   }
+
+   thread = sthread_create(test_spectators, &room);
+
+   for (frame = 0; frame < frames; frame++)
+   {
+      uint32_t input[TEST_INPUT_SIZE / sizeof(uint32_t)];
+      uint64_t cpu = test_thread_cpu_ns();
+
+      /* Read what's come in */
+      if (ident)
+      {
+         if (netplay_poller_wait(&poller, 0, test_readable, &server) < 0)
+            ok = false;
+      }
+      else
+         for (i = 0; i < spectators; i++)
+            server.readable[i] = true;
+
+      for (i = 0; i < spectators; i++)
+         if (server.readable[i] && !test_server_read(&server, i))
+            ok = false;
+
+      cpu_read  += test_thread_cpu_ns() - cpu;
+
+      /* Send everyone this frame's input */
+      input[0] = htonl(NETPLAY_CMD_INPUT);
+      input[1] = htonl(sizeof(input) - 2 * sizeof(uint32_t));
+      input[2] = htonl(frame);
+      input[3] = 0;
+      for (i = 0; i < spectators; i++)
+      {
+         if (!netplay_send(&server.send_buf[i], room.server_fd[i], input,
+                  sizeof(input)) ||
+             !netplay_send_flush(&server.send_buf[i], room.server_fd[i],
+                  false))
+            ok = false;
+      }
+
+      cpu        = test_thread_cpu_ns() - cpu;
+      cpu_total += cpu;
+      if (cpu > cpu_max)
+         cpu_max = cpu;
+
+      /* Give the spectators their turn, as a frame of emulation would */
+      retro_sleep(1);
+   }
+
+   sthread_join(thread);
+
+   /* Pick up the last replies */
+   for (i = 0; i < spectators; i++)
+      if (!test_server_read(&server, i))
+         ok = false;
+
+   for (i = 0; i < spectators; i++)
+      if (room.received[i] != frames)
+         ok = false;
+   if (room.failed || server.replies != expected)
+      ok = false;
+
+   result->total[round] = cpu_total / 1000.0 / frames;
+   result->read[round]  = cpu_read / 1000.0 / frames;
+   result->worst[round] = cpu_max / 1000.0;
+   result->replies      = server.replies;
+
+done:
+   netplay_poller_deinit(&poller);
+   for (i = 0; i < spectators; i++)
+   {
+      netplay_deinit_socket_buffer(&server.send_buf[i]);
+      netplay_deinit_socket_buffer(&server.recv_buf[i]);
+      socket_close(room.server_fd[i]);
+      socket_close(room.client_fd[i]);
+   }
+   free(server.send_buf);
+   free(server.recv_buf);
+   free(server.readable);
+
+   return ok;
+}
+
+static int test_compare(const void *a, const void *b)
+{
+   double x = *(const double*)a;
+   double y = *(const double*)b;
+   return (x > y) - (x < y);
+}
+
+static double test_median(double *values, unsigned rounds)
+{
+   qsort(values, rounds, sizeof(*values), test_compare);
+   return values[rounds / 2];
+}
+
+int main(int argc, char *argv[])
+{
+   unsigned mode, round;
+   static struct test_result results[TEST_MODES];
+   size_t spectators = argc > 1 ? strtoul(argv[1], NULL, 0) : 64;
+   unsigned frames   = argc > 2 ? strtoul(argv[2], NULL, 0) : 1200;
+   unsigned rounds   = argc > 3 ? strtoul(argv[3], NULL, 0) : 5;
+   bool ok           = true;
+
+   if (spectators < 1 || spectators > TEST_MAX_SPECTATORS)
+   {
+      fprintf(stderr, "Between 1 and %u spectators, please.\n",
+            TEST_MAX_SPECTATORS);
+      return 1;
+   }
+
+   if (rounds < 1 || rounds > TEST_MAX_ROUNDS)
+   {
+      fprintf(stderr, "Between 1 and %u rounds, please.\n",
+            TEST_MAX_ROUNDS);
+      return 1;
+   }
+
+   if (!network_init())
+      return 1;
+
+   ok = test_reports("select", spectators) && ok;
+   ok = test_reports("poll",   spectators) && ok;
+   ok = test_reports("epoll",  spectators) && ok;
+
+   /* Take turns, so whatever else the machine does hits all modes alike */
+   for (mode = 0; mode < TEST_MODES; mode++)
+      results[mode].ok = true;
+   for (round = 0; round < rounds; round++)
+      for (mode = 0; mode < TEST_MODES; mode++)
+         if (!results[mode].unavailable)
+            results[mode].ok = test_run(test_modes[mode], spectators,
+                  frames, &results[mode], round) && results[mode].ok;
+
+   printf("%u spectators, %u frames, median of %u rounds\n",
+         (unsigned)spectators, frames, rounds);
+   printf("%-7s %12s %12s %12s %10s\n", "reads", "us/frame", "reading",
+         "worst us", "replies");
+
+   for (mode = 0; mode < TEST_MODES; mode++)
+   {
+      struct test_result *result = &results[mode];
+      const char *ident          = test_modes[mode] ? test_modes[mode] : "all";
+
+      if (result->unavailable)
+      {
+         printf("%-7s unavailable\n", ident);
+         continue;
+      }
+
+      printf("%-7s %12.2f %12.2f %12.2f %10u %6s\n", ident,
+            test_median(result->total, rounds),
+            test_median(result->read, rounds),
+            test_median(result->worst, rounds), result->replies,
+            result->ok ? "ok" : "FAILED");
+      ok = result->ok && ok;
+   }
+
+   return ok ? 0 : 1;
+}
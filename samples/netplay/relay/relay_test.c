@@ -0,0 +1,780 @@
+/*  RetroArch - A frontend for libretro.
+ *  Copyright (C) 2016-2017 - Gregor Richards
+ *
+ *  RetroArch is free software: you can redistribute it and/or modify it under the terms
+ *  of the GNU General Public License as published by the Free Software Found-
+ *  ation, either version 3 of the License, or (at your option) any later version.
+ *
+ *  RetroArch is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ *  PURPOSE.  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with RetroArch.
+ *  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Runs a netplay relay over loopback TCP between a stand-in host and
+ * spectators joining one after another while the game runs. The host sends
+ * two players' input every frame, a savestate when the relay joins and
+ * again halfway through, and a keyframe whenever the relay asks. One
+ * spectator asks for a savestate partway through.
+ *
+ * Spectators take diffs, whole zlib'd states or whole plain states. Each
+ * must start from a recent keyframe, then get every frame's input from
+ * there on and each state just before the input of its frame, with the
+ * exact contents the host sent. Reported are the bytes the host sent and
+ * the bytes each kind of spectator received.
+ *
+ * Usage: relay_test [spectators] [frames] */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include <compat/strl.h>
+#include <net/net_compat.h>
+#include <net/net_socket.h>
+#include <rthreads/rthreads.h>
+#include <streams/trans_stream.h>
+#include <retro_timers.h>
+
+#include "../../../network/netplay/netplay_private.h"
+#include "../../../network/netplay/netplay_relay.h"
+
+#define TEST_STATE_SIZE      (96 * 1024)
+/* Bigger than the relay's socket buffers */
+#define TEST_SRAM_SIZE       (200 * 1024)
+#define TEST_KEYFRAME_FRAMES 60
+#define TEST_MAX_SPECTATORS  256
+#define TEST_CORE_NAME       "relay_test"
+
+/* What the relay needs from the rest of RetroArch */
+void RARCH_LOG(const char *fmt, ...) { }
+void RARCH_WARN(const char *fmt, ...) { }
+
+void RARCH_ERR(const char *fmt, ...)
+{
+   va_list ap;
+   va_start(ap, fmt);
+   vfprintf(stderr, fmt, ap);
+   va_end(ap);
+}
+
+const char *msg_hash_to_str(enum msg_hash_enums msg) { return "netplay"; }
+
+static const struct trans_stream_backend *test_deflate;
+static const struct trans_stream_backend *test_inflate;
+
+/* The host's state at a frame: some blocks change every frame, the rest
+ * every few */
+static void test_state(uint8_t *state, uint32_t frame)
+{
+   size_t i;
+   for (i = 0; i < TEST_STATE_SIZE; i++)
+      state[i] = (uint8_t)(i + (i / 256) * 31 + frame / ((i / 256) % 8 + 1));
+}
+
+struct test_host
+{
+   int listen_fd;
+   int fd;
+   uint16_t port;
+   uint8_t state[TEST_STATE_SIZE];
+   uint8_t base[TEST_STATE_SIZE];
+   uint8_t *diff;
+   uint8_t *zbuf;
+   size_t zbuf_size;
+   uint32_t transfer_id;
+   size_t sent;
+   bool keyframe_requested;
+   bool savestate_requested;
+   bool failed;
+   volatile bool joined;
+};
+
+static bool test_listen(int *fd, uint16_t *port)
+{
+   struct sockaddr_in addr;
+   socklen_t addr_size = sizeof(addr);
+
+   memset(&addr, 0, sizeof(addr));
+   addr.sin_family      = AF_INET;
+   addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+   *fd = socket(AF_INET, SOCK_STREAM, 0);
+   if (*fd < 0 ||
+       bind(*fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 ||
+       listen(*fd, 16) < 0 ||
+       getsockname(*fd, (struct sockaddr*)&addr, &addr_size) < 0)
+      return false;
+
+   *port = ntohs(addr.sin_port);
+   return true;
+}
+
+static bool test_send(struct test_host *host, const void *data, size_t size)
+{
+   host->sent += size;
+   return socket_send_all_blocking(host->fd, data, size, true);
+}
+
+static bool test_send_cmd(struct test_host *host, uint32_t cmd,
+      const uint32_t *payload, size_t words)
+{
+   size_t i;
+   uint32_t buf[16];
+
+   buf[0] = htonl(cmd);
+   buf[1] = htonl((uint32_t)(words * sizeof(uint32_t)));
+   for (i = 0; i < words; i++)
+      buf[2 + i] = htonl(payload[i]);
+   return test_send(host, buf, (2 + words) * sizeof(uint32_t));
+}
+
+/* The host's side of the handshake, as netplay_handshake does it */
+static void test_host_handshake(void *data)
+{
+   size_t i;
+   uint32_t header[6];
+   uint32_t sync[2 + 2 + MAX_INPUT_DEVICES];
+   uint8_t share_modes[MAX_INPUT_DEVICES];
+   uint32_t device_clients[MAX_INPUT_DEVICES];
+   struct nick_buf_s nick_buf;
+   struct info_buf_s info_buf;
+   struct test_host *host = (struct test_host*)data;
+   uint8_t *sram          = (uint8_t*)malloc(TEST_SRAM_SIZE);
+
+   host->failed = true;
+   if (!sram ||
+       (host->fd = accept(host->listen_fd, NULL, NULL)) < 0 ||
+       !socket_receive_all_blocking(host->fd, header, sizeof(header)) ||
+       ntohl(header[2]) != NETPLAY_COMPRESSION_SUPPORTED)
+      goto end;
+
+   netplay_protocol_header(header, 0);
+   if (!test_send(host, header, sizeof(header)) ||
+       !socket_receive_all_blocking(host->fd, &nick_buf, sizeof(nick_buf)))
+      goto end;
+
+   strlcpy(nick_buf.nick, "host", sizeof(nick_buf.nick));
+   if (!test_send(host, &nick_buf, sizeof(nick_buf)))
+      goto end;
+
+   memset(&info_buf, 0, sizeof(info_buf));
+   info_buf.cmd[0] = htonl(NETPLAY_CMD_INFO);
+   info_buf.cmd[1] = htonl(sizeof(info_buf) - sizeof(info_buf.cmd));
+   strlcpy(info_buf.core_name, TEST_CORE_NAME, sizeof(info_buf.core_name));
+   strlcpy(info_buf.core_version, "1.0", sizeof(info_buf.core_version));
+   if (!test_send(host, &info_buf, sizeof(info_buf)) ||
+       !socket_receive_all_blocking(host->fd, &info_buf, sizeof(info_buf)) ||
+       strcmp(info_buf.core_name, TEST_CORE_NAME))
+      goto end;
+
+   /* Two players, on the first two devices */
+   sync[0] = htonl(NETPLAY_CMD_SYNC);
+   sync[1] = htonl(NETPLAY_CMD_SYNC_MIN_SIZE + TEST_SRAM_SIZE);
+   sync[2] = 0;
+   sync[3] = htonl(2);
+   for (i = 0; i < MAX_INPUT_DEVICES; i++)
+   {
+      sync[4 + i]       = htonl(RETRO_DEVICE_JOYPAD);
+      share_modes[i]    = 0;
+      device_clients[i] = htonl(i < 2 ? 1 << i : 0);
+   }
+   for (i = 0; i < TEST_SRAM_SIZE; i++)
+      sram[i] = (uint8_t)i;
+
+   strlcpy(nick_buf.nick, "relay", sizeof(nick_buf.nick));
+   if (!test_send(host, sync, sizeof(sync)) ||
+       !test_send(host, share_modes, sizeof(share_modes)) ||
+       !test_send(host, device_clients, sizeof(device_clients)) ||
+       !test_send(host, nick_buf.nick, sizeof(nick_buf.nick)) ||
+       !test_send(host, sram, TEST_SRAM_SIZE))
+      goto end;
+
+   host->failed = !socket_nonblock(host->fd);
+
+end:
+   free(sram);
+   host->joined = true;
+}
+
+/* A LOAD_SAVESTATE_DELTA or KEYFRAME_DELTA, as netplay_send_savestate_delta
+ * sends it */
+static bool test_host_send_state(struct test_host *host, uint32_t cmd,
+      uint32_t frame)
+{
+   uint32_t rd, wn = 0;
+   size_t pos;
+   void *stream     = test_deflate->stream_new();
+   size_t diff_size;
+
+   test_state(host->state, frame);
+   diff_size = netplay_savestate_diff(host->base, host->state,
+         TEST_STATE_SIZE, host->diff, NULL);
+
+   test_deflate->set_in(stream, host->diff, (uint32_t)diff_size);
+   test_deflate->set_out(stream, host->zbuf, (uint32_t)host->zbuf_size);
+   if (!test_deflate->trans(stream, true, &rd, &wn, NULL))
+      wn = 0;
+   test_deflate->stream_free(stream);
+   if (!wn)
+      return false;
+
+   memcpy(host->base, host->state, TEST_STATE_SIZE);
+   host->transfer_id++;
+
+   for (pos = 0; pos < wn; pos += NETPLAY_SAVESTATE_CHUNK_SIZE)
+   {
+      uint32_t header[7];
+      size_t len = wn - pos;
+      if (len > NETPLAY_SAVESTATE_CHUNK_SIZE)
+         len = NETPLAY_SAVESTATE_CHUNK_SIZE;
+
+      header[0] = htonl(cmd);
+      header[1] = htonl((uint32_t)(5 * sizeof(uint32_t) + len));
+      header[2] = htonl(frame);
+      header[3] = htonl(host->transfer_id);
+      header[4] = htonl(TEST_STATE_SIZE);
+      header[5] = htonl(wn);
+      header[6] = htonl((uint32_t)pos);
+      if (!test_send(host, header, sizeof(header)) ||
+          !test_send(host, host->zbuf + pos, len))
+         return false;
+   }
+
+   return true;
+}
+
+/* Whatever the relay asked for */
+static bool test_host_read(struct test_host *host)
+{
+   uint32_t cmd[2];
+   ssize_t recvd;
+   bool error = false;
+
+   while ((recvd = socket_receive_all_nonblocking(host->fd, &error, cmd,
+               sizeof(cmd))) > 0)
+   {
+      if (recvd < (ssize_t)sizeof(cmd) &&
+          !socket_receive_all_blocking(host->fd, (uint8_t*)cmd + recvd,
+             sizeof(cmd) - recvd))
+         return false;
+
+      switch (ntohl(cmd[0]))
+      {
+         case NETPLAY_CMD_REQUEST_KEYFRAME:
+            host->keyframe_requested = true;
+            break;
+         case NETPLAY_CMD_REQUEST_SAVESTATE:
+            host->savestate_requested = true;
+            break;
+         default:
+            return false;
+      }
+   }
+
+   return !error;
+}
+
+/* One frame of the host: a state if due, then everyone's input */
+static bool test_host_frame(struct test_host *host, uint32_t frame,
+      uint32_t frames)
+{
+   uint32_t input[3];
+
+   if (!test_host_read(host))
+      return false;
+
+   if (frame == 0 || frame == frames / 2 || host->savestate_requested)
+   {
+      host->savestate_requested = false;
+      if (!test_host_send_state(host, NETPLAY_CMD_LOAD_SAVESTATE_DELTA, frame))
+         return false;
+   }
+   else if (host->keyframe_requested)
+   {
+      host->keyframe_requested = false;
+      if (!test_host_send_state(host, NETPLAY_CMD_KEYFRAME_DELTA, frame))
+         return false;
+   }
+
+   input[0] = frame;
+   input[1] = 1;
+   input[2] = frame * 7;
+   if (!test_send_cmd(host, NETPLAY_CMD_INPUT, input, 3))
+      return false;
+
+   input[1] = 0;
+   input[2] = frame * 3;
+   return test_send_cmd(host, NETPLAY_CMD_INPUT, input, 3);
+}
+
+enum test_kind
+{
+   TEST_KIND_DELTA = 0,
+   TEST_KIND_ZLIB,
+   TEST_KIND_PLAIN,
+   TEST_KINDS
+};
+
+static const char *test_kind_names[TEST_KINDS] = { "delta", "zlib", "plain" };
+
+struct test_viewer
+{
+   int fd;
+   enum test_kind kind;
+   uint32_t join_frame;
+
+   /* Received and not yet parsed */
+   uint8_t *buf;
+   size_t size;
+   size_t capacity;
+   bool header_done;
+
+   /* Where it started, and the next frame's input expected */
+   bool synced;
+   uint32_t start_frame;
+   uint32_t next_frame;
+   uint32_t client1_frame;
+   unsigned states;
+   bool state_due;
+   bool request_sent;
+
+   uint8_t base[TEST_STATE_SIZE];
+   uint8_t *transfer;
+   size_t transfer_size;
+   size_t received;
+   bool failed;
+};
+
+static bool test_viewer_connect(struct test_viewer *viewer, uint16_t port)
+{
+   uint32_t header[6];
+   struct nick_buf_s nick_buf;
+   struct info_buf_s info_buf;
+   struct sockaddr_in addr;
+   int flag = 1;
+
+   memset(&addr, 0, sizeof(addr));
+   addr.sin_family      = AF_INET;
+   addr.sin_port        = htons(port);
+   addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+   viewer->fd = socket(AF_INET, SOCK_STREAM, 0);
+   if (viewer->fd < 0 ||
+       connect(viewer->fd, (struct sockaddr*)&addr, sizeof(addr)) < 0)
+      return false;
+   setsockopt(viewer->fd, IPPROTO_TCP, TCP_NODELAY, (char*)&flag,
+         sizeof(flag));
+
+   /* Our whole side of the handshake goes at once, as it's all fixed */
+   header[0] = htonl(NETPLAY_MAGIC);
+   header[1] = htonl(netplay_platform_magic());
+   header[2] = htonl(viewer->kind == TEST_KIND_DELTA ?
+         NETPLAY_COMPRESSION_SUPPORTED : viewer->kind == TEST_KIND_ZLIB ?
+         NETPLAY_COMPRESSION_ZLIB : 0);
+   header[3] = 0;
+   header[4] = htonl(NETPLAY_PROTOCOL_VERSION);
+   header[5] = htonl(netplay_impl_magic());
+
+   memset(&nick_buf, 0, sizeof(nick_buf));
+   nick_buf.cmd[0] = htonl(NETPLAY_CMD_NICK);
+   nick_buf.cmd[1] = htonl(sizeof(nick_buf.nick));
+   snprintf(nick_buf.nick, sizeof(nick_buf.nick), "viewer %u",
+         (unsigned)viewer->join_frame);
+
+   memset(&info_buf, 0, sizeof(info_buf));
+   info_buf.cmd[0] = htonl(NETPLAY_CMD_INFO);
+   info_buf.cmd[1] = htonl(sizeof(info_buf) - sizeof(info_buf.cmd));
+   strlcpy(info_buf.core_name, TEST_CORE_NAME, sizeof(info_buf.core_name));
+
+   return socket_send_all_blocking(viewer->fd, header, sizeof(header), true) &&
+      socket_send_all_blocking(viewer->fd, &nick_buf, sizeof(nick_buf), true) &&
+      socket_send_all_blocking(viewer->fd, &info_buf, sizeof(info_buf), true) &&
+      socket_nonblock(viewer->fd);
+}
+
+/* Check a state as it's loaded, which must be right before its frame */
+static bool test_viewer_state(struct test_viewer *viewer, uint32_t frame,
+      const uint8_t *state)
+{
+   uint8_t expected[TEST_STATE_SIZE];
+
+   if (!viewer->synced || frame != viewer->next_frame)
+      return false;
+
+   test_state(expected, frame);
+   viewer->states++;
+   viewer->state_due = false;
+   return !memcmp(state, expected, TEST_STATE_SIZE);
+}
+
+static bool test_viewer_cmd(struct test_viewer *viewer, uint32_t cmd,
+      const uint8_t *payload, uint32_t size)
+{
+   uint32_t words[8];
+   uint32_t rd, wn = 0;
+
+   memset(words, 0, sizeof(words));
+   memcpy(words, payload, size < sizeof(words) ? size : sizeof(words));
+
+   switch (cmd)
+   {
+      case NETPLAY_CMD_NICK:
+      case NETPLAY_CMD_INFO:
+         return !viewer->synced;
+
+      case NETPLAY_CMD_SYNC:
+         {
+            uint32_t device_clients[2];
+            size_t clients_at = (2 + MAX_INPUT_DEVICES) * sizeof(uint32_t) +
+               MAX_INPUT_DEVICES;
+
+            if (viewer->synced ||
+                size != clients_at + MAX_INPUT_DEVICES * sizeof(uint32_t) +
+                  NETPLAY_NICK_LEN + TEST_SRAM_SIZE)
+               return false;
+            memcpy(device_clients, payload + clients_at,
+                  sizeof(device_clients));
+
+            viewer->synced        = true;
+            viewer->state_due     = true;
+            viewer->start_frame   = ntohl(words[0]);
+            viewer->next_frame    = viewer->start_frame;
+            viewer->client1_frame = viewer->start_frame;
+            return ntohl(device_clients[0]) == 1 &&
+               ntohl(device_clients[1]) == 2 &&
+               payload[size - 1] == (uint8_t)(TEST_SRAM_SIZE - 1);
+         }
+
+      case NETPLAY_CMD_INPUT:
+         {
+            uint32_t frame  = ntohl(words[0]);
+            uint32_t client = ntohl(words[1]);
+            uint32_t value  = ntohl(words[2]);
+
+            if (!viewer->synced || viewer->state_due || size != 12)
+               return false;
+            if (client == 1)
+            {
+               if (frame != viewer->client1_frame++ || value != frame * 7)
+                  return false;
+               return true;
+            }
+            if (client != 0 || frame != viewer->next_frame++ ||
+                value != frame * 3)
+               return false;
+            return true;
+         }
+
+      case NETPLAY_CMD_LOAD_SAVESTATE:
+         {
+            uint8_t state[TEST_STATE_SIZE];
+
+            if (size < 8 || ntohl(words[1]) != TEST_STATE_SIZE ||
+                viewer->kind == TEST_KIND_DELTA)
+               return false;
+            if (viewer->kind == TEST_KIND_PLAIN)
+            {
+               if (size - 8 != TEST_STATE_SIZE)
+                  return false;
+               memcpy(state, payload + 8, TEST_STATE_SIZE);
+            }
+            else
+            {
+               void *stream = test_inflate->stream_new();
+               test_inflate->set_in(stream, payload + 8, size - 8);
+               test_inflate->set_out(stream, state, TEST_STATE_SIZE);
+               if (!test_inflate->trans(stream, true, &rd, &wn, NULL))
+                  wn = 0;
+               test_inflate->stream_free(stream);
+               if (wn != TEST_STATE_SIZE)
+                  return false;
+            }
+            return test_viewer_state(viewer, ntohl(words[0]), state);
+         }
+
+      case NETPLAY_CMD_LOAD_SAVESTATE_DELTA:
+         {
+            uint32_t total  = ntohl(words[3]);
+            uint32_t offset = ntohl(words[4]);
+            size_t diff_max = netplay_savestate_diff_maxsize(TEST_STATE_SIZE);
+            uint8_t *diff;
+            void *stream;
+            bool ok;
+
+            if (size < 20 || viewer->kind != TEST_KIND_DELTA ||
+                offset != viewer->transfer_size ||
+                offset + size - 20 > total)
+               return false;
+            viewer->transfer = (uint8_t*)realloc(viewer->transfer, total);
+            memcpy(viewer->transfer + offset, payload + 20, size - 20);
+            viewer->transfer_size += size - 20;
+            if (viewer->transfer_size < total)
+               return true;
+            viewer->transfer_size = 0;
+
+            diff   = (uint8_t*)malloc(diff_max);
+            stream = test_inflate->stream_new();
+            test_inflate->set_in(stream, viewer->transfer, total);
+            test_inflate->set_out(stream, diff, (uint32_t)diff_max);
+            ok     = test_inflate->trans(stream, true, &rd, &wn, NULL) &&
+               netplay_savestate_patch(viewer->base, TEST_STATE_SIZE, diff,
+                     wn);
+            test_inflate->stream_free(stream);
+            free(diff);
+
+            return ok &&
+               test_viewer_state(viewer, ntohl(words[0]), viewer->base);
+         }
+
+      default:
+         return false;
+   }
+}
+
+static void test_viewer_read(struct test_viewer *viewer)
+{
+   size_t pos = 0;
+
+   for (;;)
+   {
+      ssize_t recvd;
+      bool error = false;
+
+      if (viewer->capacity - viewer->size < 65536)
+      {
+         viewer->capacity = viewer->capacity * 2 + 65536;
+         viewer->buf      = (uint8_t*)realloc(viewer->buf, viewer->capacity);
+      }
+
+      recvd = socket_receive_all_nonblocking(viewer->fd, &error,
+            viewer->buf + viewer->size, viewer->capacity - viewer->size);
+      if (error)
+      {
+         viewer->failed = true;
+         return;
+      }
+      if (recvd <= 0)
+         break;
+      viewer->size     += recvd;
+      viewer->received += recvd;
+   }
+
+   if (!viewer->header_done)
+   {
+      if (viewer->size < 6 * sizeof(uint32_t))
+         return;
+      viewer->header_done = true;
+      pos                 = 6 * sizeof(uint32_t);
+   }
+
+   while (viewer->size - pos >= 2 * sizeof(uint32_t))
+   {
+      uint32_t header[2];
+      memcpy(header, viewer->buf + pos, sizeof(header));
+      if (viewer->size - pos - sizeof(header) < ntohl(header[1]))
+         break;
+
+      if (!test_viewer_cmd(viewer, ntohl(header[0]),
+               viewer->buf + pos + sizeof(header), ntohl(header[1])))
+      {
+         fprintf(stderr, "Spectator joining at %u got a bad command %x.\n",
+               (unsigned)viewer->join_frame, (unsigned)ntohl(header[0]));
+         viewer->failed = true;
+         return;
+      }
+      pos += sizeof(header) + ntohl(header[1]);
+   }
+
+   memmove(viewer->buf, viewer->buf + pos, viewer->size - pos);
+   viewer->size -= pos;
+}
+
+int main(int argc, char *argv[])
+{
+   size_t i;
+   uint32_t frame;
+   struct test_host *host;
+   struct test_viewer *viewers;
+   netplay_relay_t *relay;
+   sthread_t *thread;
+   int spare_fd;
+   uint16_t relay_port;
+   size_t received[TEST_KINDS] = {0};
+   unsigned count[TEST_KINDS]  = {0};
+   size_t spectators           = argc > 1 ? strtoul(argv[1], NULL, 0) : 48;
+   uint32_t frames             = argc > 2 ? strtoul(argv[2], NULL, 0) : 900;
+   unsigned late               = 0;
+   bool ok                     = true;
+
+   if (spectators < 1 || spectators > TEST_MAX_SPECTATORS || frames < 2)
+   {
+      fprintf(stderr, "Between 1 and %u spectators, please.\n",
+            TEST_MAX_SPECTATORS);
+      return 1;
+   }
+
+   test_deflate = trans_stream_get_zlib_deflate_backend();
+   test_inflate = trans_stream_get_zlib_inflate_backend();
+
+   if (!network_init())
+      return 1;
+
+   host            = (struct test_host*)calloc(1, sizeof(*host));
+   viewers         = (struct test_viewer*)calloc(spectators, sizeof(*viewers));
+   host->diff      = (uint8_t*)malloc(
+         netplay_savestate_diff_maxsize(TEST_STATE_SIZE));
+   host->zbuf_size = netplay_savestate_diff_maxsize(TEST_STATE_SIZE) * 2;
+   host->zbuf      = (uint8_t*)malloc(host->zbuf_size);
+
+   /* A port for the relay, which is free once we let go of it */
+   if (!test_listen(&spare_fd, &relay_port) ||
+       !test_listen(&host->listen_fd, &host->port))
+   {
+      fprintf(stderr, "Failed to set up loopback sockets.\n");
+      return 1;
+   }
+   socket_close(spare_fd);
+
+   thread = sthread_create(test_host_handshake, host);
+   relay  = netplay_relay_new("127.0.0.1", host->port, relay_port, "relay",
+         NULL, TEST_KEYFRAME_FRAMES);
+
+   /* The relay joins the host as it's polled, never blocking */
+   while (relay && !host->joined)
+   {
+      if (!netplay_relay_poll(relay, 1))
+      {
+         netplay_relay_free(relay);
+         relay = NULL;
+      }
+   }
+   sthread_join(thread);
+   if (!relay || host->failed)
+   {
+      fprintf(stderr, "The relay failed to join the host.\n");
+      return 1;
+   }
+
+   /* Spectators join throughout, the last one near the end */
+   for (i = 0; i < spectators; i++)
+   {
+      viewers[i].kind       = (enum test_kind)(i % TEST_KINDS);
+      viewers[i].join_frame = (uint32_t)(i * (frames - frames / 8) /
+            spectators);
+      viewers[i].fd         = -1;
+   }
+
+   for (frame = 0; frame < frames && ok; frame++)
+   {
+      for (i = 0; i < spectators; i++)
+      {
+         if (viewers[i].join_frame == frame &&
+             !test_viewer_connect(&viewers[i], relay_port))
+            ok = false;
+
+         /* The first one asks for a savestate partway through */
+         if (i == 0 && !viewers[i].request_sent &&
+             viewers[i].next_frame > frames / 4)
+         {
+            uint32_t cmd[2];
+            cmd[0] = htonl(NETPLAY_CMD_REQUEST_SAVESTATE);
+            cmd[1] = 0;
+            viewers[i].request_sent = true;
+            viewers[i].state_due    = false;
+            if (!socket_send_all_blocking(viewers[i].fd, cmd, sizeof(cmd),
+                     true))
+               ok = false;
+         }
+      }
+
+      if (!test_host_frame(host, frame, frames) ||
+          !netplay_relay_poll(relay, 1))
+         ok = false;
+
+      for (i = 0; i < spectators; i++)
+         if (viewers[i].fd >= 0)
+            test_viewer_read(&viewers[i]);
+   }
+
+   /* Let everyone catch up */
+   for (i = 0; i < 5000 && ok; i++)
+   {
+      size_t j;
+      bool done = true;
+
+      if (!netplay_relay_poll(relay, 1))
+         ok = false;
+      for (j = 0; j < spectators; j++)
+      {
+         if (viewers[j].fd >= 0)
+            test_viewer_read(&viewers[j]);
+         if (!viewers[j].failed && viewers[j].next_frame != frames)
+            done = false;
+      }
+      if (done)
+         break;
+   }
+
+   printf("%u spectators, %u frames, %u byte states\n",
+         (unsigned)spectators, (unsigned)frames, TEST_STATE_SIZE);
+   printf("host sent %u bytes\n", (unsigned)host->sent);
+
+   for (i = 0; i < spectators; i++)
+   {
+      struct test_viewer *viewer = &viewers[i];
+
+      if (viewer->failed || !viewer->synced || viewer->next_frame != frames ||
+          viewer->client1_frame != frames)
+      {
+         fprintf(stderr, "Spectator joining at %u stopped at frame %u.\n",
+               (unsigned)viewer->join_frame, (unsigned)viewer->next_frame);
+         ok = false;
+      }
+
+      /* Started from a keyframe, not from the beginning */
+      if (viewer->start_frame + 2 * TEST_KEYFRAME_FRAMES < viewer->join_frame)
+         late++;
+
+      received[viewer->kind] += viewer->received;
+      count[viewer->kind]++;
+   }
+   if (late)
+   {
+      fprintf(stderr, "%u spectators started from a stale keyframe.\n", late);
+      ok = false;
+   }
+   /* The first state, the one asked for, and the one halfway through */
+   if (viewers[0].states < 3)
+   {
+      fprintf(stderr, "The savestate asked for never came.\n");
+      ok = false;
+   }
+
+   for (i = 0; i < TEST_KINDS; i++)
+      if (count[i])
+         printf("%-6s %3u spectators, %10u bytes each on average\n",
+               test_kind_names[i], count[i],
+               (unsigned)(received[i] / count[i]));
+   printf("%s\n", ok ? "ok" : "FAILED");
+
+   netplay_relay_free(relay);
+   for (i = 0; i < spectators; i++)
+   {
+      if (viewers[i].fd >= 0)
+         socket_close(viewers[i].fd);
+      free(viewers[i].buf);
+      free(viewers[i].transfer);
+   }
+   socket_close(host->fd);
+   socket_close(host->listen_fd);
+   free(host->diff);
+   free(host->zbuf);
+   free(host);
+   free(viewers);
+
+   return ok ? 0 : 1;
+}
@@ -0,0 +1,825 @@
+/*  RetroArch - A frontend for libretro.
+ *  Copyright (C) 2016-2017 - Gregor Richards
+ *
+ *  RetroArch is free software: you can redistribute it and/or modify it under the terms
+ *  of the GNU General Public License as published by the Free Software Found-
+ *  ation, either version 3 of the License, or (at your option) any later version.
+ *
+ *  RetroArch is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ *  PURPOSE.  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with RetroArch.
+ *  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Runs a spectating server and a client over loopback TCP through netplay's
+ * own command code: every frame the server sends NETPLAY_CMD_NOINPUT with
+ * netplay_send_cur_input, and now and then a savestate, once as a whole
+ * NETPLAY_CMD_LOAD_SAVESTATE and once with netplay_send_savestate_delta.
+ * The client reads everything with netplay_poll_net_input.
+ *
+ * Between the two sits a link which carries no more than the given speed
+ * towards the client. Reported are the bytes sent to the client and the
+ * stall: how late the worst input arrived, which is how long a peer would
+ * have waited for it. Every state must load with the exact contents sent,
+ * or arrive too late and be asked for again.
+ *
+ * Then delivers a diff after its frame has left the receiver's buffer, to a
+ * client and to a server, checking that either ends up with a new state on
+ * its way.
+ *
+ * Last, checks a frame whose state differs in two bytes on the client: with
+ * the root of its hash tree, and with the CRC older clients get, which
+ * nobody builds the tree for until it mismatches. Either way the client must
+ * find the two blocks and ask for a savestate.
+ *
+ * Usage: savestate_transfer_test [state KiB] [bytes changed per frame]
+ *                                [link KiB/s] */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include <net/net_compat.h>
+#include <net/net_socket.h>
+#include <rthreads/rthreads.h>
+#include <streams/trans_stream.h>
+#include <features/features_cpu.h>
+#include <retro_timers.h>
+
+#include "../../../network/netplay/netplay_private.h"
+#include "../../../configuration.h"
+#include "../../../retroarch.h"
+#include "../../../tasks/tasks_internal.h"
+
+#define TEST_FRAMES          360
+#define TEST_FRAME_USEC      16667
+#define TEST_SOCKET_BUFFER   (32 * 1024)
+#define TEST_MAX_LOADS       32
+
+/* The first load is what a joining client gets */
+static const unsigned test_load_frames[] = { 30, 150, 270 };
+#define TEST_LOADS (sizeof(test_load_frames) / sizeof(test_load_frames[0]))
+
+struct test_link
+{
+   int server_fd;
+   int client_fd;
+   size_t rate;
+   uint64_t forwarded;
+};
+
+struct test_run
+{
+   netplay_t *server;
+   netplay_t *client;
+   slock_t *lock;
+
+   /* Sender side */
+   retro_time_t sent_at[TEST_FRAMES + 1];
+   uint32_t load_frames[TEST_MAX_LOADS];
+   uint8_t *load_states[TEST_MAX_LOADS];
+   retro_time_t load_sent_at[TEST_MAX_LOADS];
+   unsigned loads;
+
+   /* Receiver side */
+   retro_time_t max_input_delay;
+   retro_time_t state_latency;
+   unsigned states;
+   bool failed;
+};
+
+/* What netplay_io.c needs from the rest of RetroArch */
+static unsigned test_late;
+static char test_desync_log[256];
+
+void RARCH_LOG(const char *fmt, ...) { }
+
+void RARCH_WARN(const char *fmt, ...)
+{
+   if (strstr(fmt, "arrived too late"))
+      test_late++;
+   else if (strstr(fmt, "desynced in state bytes"))
+   {
+      va_list ap;
+      size_t len = strlen(test_desync_log);
+
+      va_start(ap, fmt);
+      vsnprintf(test_desync_log + len, sizeof(test_desync_log) - len,
+            fmt, ap);
+      va_end(ap);
+   }
+}
+
+void RARCH_ERR(const char *fmt, ...)
+{
+   va_list ap;
+   va_start(ap, fmt);
+   vfprintf(stderr, fmt, ap);
+   va_end(ap);
+}
+
+const char *msg_hash_to_str(enum msg_hash_enums msg) { return "netplay"; }
+settings_t *config_get_ptr(void) { return NULL; }
+void runloop_msg_queue_push(const char *msg, unsigned prio,
+      unsigned duration, bool flush, char *title,
+      enum message_queue_icon icon, enum message_queue_category category) { }
+bool task_push_netplay_nat_traversal(void *nat_traversal_state,
+      uint16_t port) { return false; }
+bool netplay_handshake(netplay_t *netplay,
+      struct netplay_connection *connection, bool *had_input) { return false; }
+uint8_t netplay_settings_share_mode(unsigned share_digital,
+      unsigned share_analog) { return 0; }
+void netplay_update_unread_ptr(netplay_t *netplay) { }
+bool netplay_wait_and_init_serialization(netplay_t *netplay) { return true; }
+
+/* A connected peer, as the handshake would leave it */
+static netplay_t *test_netplay_new(bool is_server, int fd, size_t state_size,
+      bool delta)
+{
+   struct netplay_connection *connection = NULL;
+   struct compression_transcoder *ctrans = NULL;
+   netplay_t *netplay = (netplay_t*)calloc(1, sizeof(*netplay));
+
+   if (!netplay)
+      return NULL;
+
+   netplay->is_server    = is_server;
+   netplay->self_mode    = is_server
+      ? NETPLAY_CONNECTION_SPECTATING : NETPLAY_CONNECTION_PLAYING;
+   netplay->listen_fd    = -1;
+   netplay->state_size   = state_size;
+   netplay->buffer_size  = NETPLAY_MAX_STALL_FRAMES + 2;
+   netplay->buffer       = (struct delta_frame*)calloc(netplay->buffer_size,
+         sizeof(*netplay->buffer));
+   netplay->zbuffer_size = state_size * 2;
+   netplay->zbuffer      = (uint8_t*)calloc(netplay->zbuffer_size, 1);
+
+   if (is_server)
+   {
+      netplay->connections      = (struct netplay_connection*)calloc(1,
+            sizeof(*netplay->connections));
+      netplay->connections_size = 1;
+   }
+   else
+   {
+      netplay->connections      = &netplay->one_connection;
+      netplay->connections_size = 1;
+   }
+
+   ctrans                        = &netplay->compress_zlib;
+   ctrans->compression_backend   = trans_stream_get_zlib_deflate_backend();
+   ctrans->decompression_backend = ctrans->compression_backend->reverse;
+   ctrans->compression_stream    = ctrans->compression_backend->stream_new();
+   ctrans->decompression_stream  = ctrans->decompression_backend->stream_new();
+
+   if (     !netplay->buffer
+         || !netplay->zbuffer
+         || !netplay->connections
+         || !ctrans->compression_stream
+         || !ctrans->decompression_stream
+         || !netplay_delta_states_init(netplay)
+         || !netplay_poller_init(&netplay->poller, NULL)
+         || !netplay_poller_add(&netplay->poller, fd, 1))
+      return NULL;
+
+   connection                        = &netplay->connections[0];
+   connection->active                = true;
+   connection->fd                    = fd;
+   connection->mode                  = NETPLAY_CONNECTION_PLAYING;
+   connection->compression_supported = NETPLAY_COMPRESSION_ZLIB;
+   connection->savestate_delta       = delta;
+   connection->protocol_version      = NETPLAY_PROTOCOL_VERSION;
+
+   if (     !socket_nonblock(fd)
+         || !netplay_init_socket_buffer(&connection->send_packet_buffer,
+            netplay->zbuffer_size + NETPLAY_MAX_STALL_FRAMES * 16)
+         || !netplay_init_socket_buffer(&connection->recv_packet_buffer,
+            netplay->zbuffer_size + NETPLAY_MAX_STALL_FRAMES * 16))
+      return NULL;
+
+   return netplay;
+}
+
+static void test_netplay_free(netplay_t *netplay)
+{
+   size_t i;
+   struct compression_transcoder *ctrans = &netplay->compress_zlib;
+   struct netplay_connection *connection = &netplay->connections[0];
+
+   if (connection->active)
+   {
+      socket_close(connection->fd);
+      netplay_deinit_socket_buffer(&connection->send_packet_buffer);
+      netplay_deinit_socket_buffer(&connection->recv_packet_buffer);
+      netplay_savestate_transfer_free(&connection->savestate_out);
+      netplay_savestate_transfer_free(&connection->savestate_in);
+   }
+
+   netplay_poller_deinit(&netplay->poller);
+   netplay_delta_states_free(netplay);
+   for (i = 0; i < netplay->buffer_size; i++)
+      netplay_delta_frame_free(&netplay->buffer[i]);
+   ctrans->compression_backend->stream_free(ctrans->compression_stream);
+   ctrans->decompression_backend->stream_free(ctrans->decompression_stream);
+   if (netplay->is_server)
+      free(netplay->connections);
+   free(netplay->buffer);
+   free(netplay->zbuffer);
+   free(netplay->savestate_diff);
+   netplay_hash_tree_free(&netplay->hash_tree);
+   netplay_hash_tree_free(&netplay->hash_desync);
+   free(netplay);
+}
+
+/* What netplay_send_savestate does for a peer without diffs */
+static bool test_send_full(netplay_t *netplay, const uint8_t *state,
+      uint32_t frame, uint8_t *payload)
+{
+   uint32_t rd, wn;
+   uint32_t *header                      = (uint32_t*)payload;
+   struct compression_transcoder *ctrans = &netplay->compress_zlib;
+
+   ctrans->compression_backend->set_in(ctrans->compression_stream,
+         state, (uint32_t)netplay->state_size);
+   ctrans->compression_backend->set_out(ctrans->compression_stream,
+         payload + 2 * sizeof(uint32_t), (uint32_t)netplay->zbuffer_size);
+   if (!ctrans->compression_backend->trans(ctrans->compression_stream,
+            true, &rd, &wn, NULL))
+      return false;
+
+   header[0] = htonl(frame);
+   header[1] = htonl((uint32_t)netplay->state_size);
+
+   return netplay_send_raw_cmd(netplay, &netplay->connections[0],
+         NETPLAY_CMD_LOAD_SAVESTATE, payload, wn + 2 * sizeof(uint32_t));
+}
+
+static bool test_socket_pair(int *server_fd, int *client_fd)
+{
+   struct sockaddr_in addr;
+   socklen_t addr_size = sizeof(addr);
+   int listen_fd       = socket(AF_INET, SOCK_STREAM, 0);
+
+   memset(&addr, 0, sizeof(addr));
+   addr.sin_family      = AF_INET;
+   addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+   if (listen_fd < 0 ||
+       bind(listen_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 ||
+       listen(listen_fd, 1) < 0 ||
+       getsockname(listen_fd, (struct sockaddr*)&addr, &addr_size) < 0)
+      return false;
+
+   *client_fd = socket(AF_INET, SOCK_STREAM, 0);
+   if (connect(*client_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0)
+      return false;
+
+   *server_fd = accept(listen_fd, NULL, NULL);
+   socket_close(listen_fd);
+   return *server_fd >= 0;
+}
+
+/* Carries data to the client no faster than the link speed, and back to
+ * the server as it comes */
+static void test_link_thread(void *data)
+{
+   uint8_t buf[4096];
+   struct test_link *link = (struct test_link*)data;
+   retro_time_t start     = cpu_features_get_time_usec();
+   int max_fd             = link->server_fd > link->client_fd
+      ? link->server_fd : link->client_fd;
+
+   for (;;)
+   {
+      fd_set fds;
+      struct timeval tv;
+      ssize_t got;
+      retro_time_t now  = cpu_features_get_time_usec();
+      retro_time_t due  = start
+         + (retro_time_t)(link->forwarded * 1000000 / link->rate);
+      retro_time_t wait = due > now ? due - now : 10000;
+
+      FD_ZERO(&fds);
+      FD_SET(link->client_fd, &fds);
+      if (due <= now)
+         FD_SET(link->server_fd, &fds);
+      tv.tv_sec  = 0;
+      tv.tv_usec = wait > 10000 ? 10000 : (long)wait;
+
+      if (socket_select(max_fd + 1, &fds, NULL, NULL, &tv) < 0)
+         break;
+
+      if (FD_ISSET(link->server_fd, &fds))
+      {
+         if ((got = recv(link->server_fd, (char*)buf, sizeof(buf), 0)) <= 0 ||
+             !socket_send_all_blocking(link->client_fd, buf, got, true))
+            break;
+         link->forwarded += got;
+      }
+
+      if (FD_ISSET(link->client_fd, &fds))
+      {
+         if ((got = recv(link->client_fd, (char*)buf, sizeof(buf), 0)) <= 0 ||
+             !socket_send_all_blocking(link->server_fd, buf, got, true))
+            break;
+      }
+   }
+
+   socket_close(link->server_fd);
+   socket_close(link->client_fd);
+}
+
+static void test_check_load(struct test_run *run)
+{
+   unsigned i;
+   netplay_t *netplay = run->client;
+   const void *state  = netplay_delta_frame_state(netplay,
+         netplay->other_ptr);
+   retro_time_t now   = cpu_features_get_time_usec();
+
+   slock_lock(run->lock);
+   for (i = run->loads; i-- > 0;)
+   {
+      if (run->load_frames[i] != netplay->other_frame_count)
+         continue;
+
+      if (!state || memcmp(state, run->load_states[i], netplay->state_size))
+         run->failed = true;
+      run->state_latency += now - run->load_sent_at[i];
+      run->states++;
+      break;
+   }
+   if (i == (unsigned)-1)
+      run->failed = true;
+   slock_unlock(run->lock);
+}
+
+/* The client: reads whatever came in, then runs up to the server */
+static void test_receiver(void *data)
+{
+   struct test_run *run  = (struct test_run*)data;
+   netplay_t *netplay    = run->client;
+
+   while (netplay->connections[0].active &&
+          netplay->server_frame_count <= TEST_FRAMES)
+   {
+      uint32_t frame = netplay->server_frame_count;
+      retro_time_t now;
+
+      if (netplay_poll_net_input(netplay, false) < 0)
+         break;
+
+      now = cpu_features_get_time_usec();
+      slock_lock(run->lock);
+      for (; frame < netplay->server_frame_count; frame++)
+         if (now - run->sent_at[frame] > run->max_input_delay)
+            run->max_input_delay = now - run->sent_at[frame];
+      slock_unlock(run->lock);
+
+      if (netplay->force_rewind)
+      {
+         test_check_load(run);
+         netplay->force_rewind = false;
+      }
+
+      /* Requests for a fresh state go out with our next frame */
+      if (!netplay_send_flush(&netplay->connections[0].send_packet_buffer,
+               netplay->connections[0].fd, false))
+         break;
+
+      while (netplay->run_frame_count < netplay->server_frame_count)
+      {
+         netplay->run_ptr           = NEXT_PTR(netplay->run_ptr);
+         netplay->run_frame_count++;
+         netplay->other_ptr         = netplay->run_ptr;
+         netplay->other_frame_count = netplay->run_frame_count;
+         netplay_delta_frame_ready(netplay,
+               &netplay->buffer[netplay->run_ptr], netplay->run_frame_count);
+      }
+
+      retro_sleep(1);
+   }
+
+   if (netplay->server_frame_count <= TEST_FRAMES)
+      run->failed = true;
+}
+
+static bool test_run(bool delta, size_t state_size, size_t changes,
+      size_t rate)
+{
+   unsigned frame, i;
+   uint32_t seed          = 1;
+   unsigned next_load     = 0;
+   unsigned requested     = 0;
+   retro_time_t max_send  = 0;
+   uint8_t *state         = (uint8_t*)malloc(state_size);
+   uint8_t *payload       = (uint8_t*)malloc(state_size * 2 + 64);
+   struct netplay_connection *connection = NULL;
+   struct test_run *run   = (struct test_run*)calloc(1, sizeof(*run));
+   struct test_link link;
+   sthread_t *link_thread = NULL;
+   sthread_t *receiver    = NULL;
+   int server_fd, client_fd;
+   int bufsz              = TEST_SOCKET_BUFFER;
+   bool ok                = false;
+
+   memset(&link, 0, sizeof(link));
+   link.rate = rate;
+
+   if (!state || !payload || !run ||
+       !test_socket_pair(&server_fd, &link.server_fd) ||
+       !test_socket_pair(&link.client_fd, &client_fd))
+   {
+      fprintf(stderr, "Failed to set up the loopback connections.\n");
+      return false;
+   }
+
+   /* Small socket buffers, so the kernel can't hide the link speed */
+   setsockopt(server_fd,      SOL_SOCKET, SO_SNDBUF, (char*)&bufsz, sizeof(bufsz));
+   setsockopt(link.server_fd, SOL_SOCKET, SO_RCVBUF, (char*)&bufsz, sizeof(bufsz));
+   setsockopt(link.client_fd, SOL_SOCKET, SO_SNDBUF, (char*)&bufsz, sizeof(bufsz));
+   setsockopt(client_fd,      SOL_SOCKET, SO_RCVBUF, (char*)&bufsz, sizeof(bufsz));
+
+   run->lock   = slock_new();
+   run->server = test_netplay_new(true,  server_fd, state_size, delta);
+   run->client = test_netplay_new(false, client_fd, state_size, delta);
+   if (!run->lock || !run->server || !run->client)
+      goto end;
+   connection  = &run->server->connections[0];
+
+   /* A quarter noise, the rest the kind of tables that compress well */
+   for (i = 0; i < state_size; i++)
+   {
+      seed     = seed * 1103515245 + 12345;
+      state[i] = i < state_size / 4 ? (uint8_t)(seed >> 16) : (uint8_t)(i / 64);
+   }
+
+   test_late   = 0;
+   link_thread = sthread_create(test_link_thread, &link);
+   receiver    = sthread_create(test_receiver, run);
+
+   for (frame = 0; frame < TEST_FRAMES; frame++)
+   {
+      retro_time_t took;
+      retro_time_t frame_start = cpu_features_get_time_usec();
+      netplay_t *netplay       = run->server;
+
+      for (i = 0; i < changes; i++)
+      {
+         seed = seed * 1103515245 + 12345;
+         state[(seed >> 8) % state_size] ^= (uint8_t)(seed >> 24) | 1;
+      }
+
+      /* Picks up requests for a fresh state */
+      if (netplay_poll_net_input(netplay, false) < 0 || !connection->active)
+         break;
+
+      if (netplay->force_send_savestate ||
+          (next_load < TEST_LOADS && frame == test_load_frames[next_load]))
+      {
+         if (next_load < TEST_LOADS && frame == test_load_frames[next_load])
+            next_load++;
+         else
+            requested++;
+         netplay->force_send_savestate = false;
+
+         if (run->loads == TEST_MAX_LOADS)
+            break;
+
+         slock_lock(run->lock);
+         run->load_frames[run->loads]  = frame;
+         run->load_sent_at[run->loads] = frame_start;
+         run->load_states[run->loads]  = (uint8_t*)malloc(state_size);
+         if (run->load_states[run->loads])
+            memcpy(run->load_states[run->loads], state, state_size);
+         run->loads++;
+         slock_unlock(run->lock);
+
+         if (!(delta
+               ? netplay_send_savestate_delta(netplay, connection,
+                  NETPLAY_CMD_LOAD_SAVESTATE_DELTA, state, state_size, frame)
+               : test_send_full(netplay, state, frame, payload)))
+            break;
+      }
+
+      slock_lock(run->lock);
+      run->sent_at[frame] = cpu_features_get_time_usec();
+      slock_unlock(run->lock);
+
+      netplay->self_frame_count = frame;
+      if (!netplay_send_cur_input(netplay, connection))
+         break;
+
+      took = cpu_features_get_time_usec() - frame_start;
+      if (took > max_send)
+         max_send = took;
+      if (took < TEST_FRAME_USEC)
+         retro_sleep((unsigned)((TEST_FRAME_USEC - took) / 1000));
+   }
+
+   /* Whatever is left of the last diff, then the frame the client stops
+    * at */
+   while (frame == TEST_FRAMES && connection->savestate_out.pending)
+   {
+      if (!netplay_send_savestate_chunks(run->server, connection))
+         break;
+      retro_sleep(1);
+   }
+
+   slock_lock(run->lock);
+   run->sent_at[TEST_FRAMES] = cpu_features_get_time_usec();
+   slock_unlock(run->lock);
+   run->server->self_frame_count = TEST_FRAMES;
+   if (connection->active &&
+       netplay_send_cur_input(run->server, connection))
+      netplay_send_flush(&connection->send_packet_buffer, server_fd, true);
+
+   sthread_join(receiver);
+
+   ok = frame == TEST_FRAMES && !run->failed &&
+      run->states + test_late == run->loads &&
+      (delta || !test_late);
+
+   /* Closing our ends stops the link */
+   test_netplay_free(run->server);
+   test_netplay_free(run->client);
+   run->server = run->client = NULL;
+   sthread_join(link_thread);
+   link_thread = NULL;
+
+   printf("%-6s %3u/%-3u %4u %12.1f KiB %10.1f ms %10.1f ms %10.1f ms  %s\n",
+         delta ? "delta" : "full", run->states, run->loads, test_late,
+         link.forwarded / 1024.0, run->max_input_delay / 1000.0,
+         max_send / 1000.0,
+         run->states ? run->state_latency / 1000.0 / run->states : 0.0,
+         ok ? "ok" : "MISMATCH");
+
+   if (requested != test_late)
+      printf("       %u of %u late states asked for again in time\n",
+            requested, test_late);
+
+end:
+   if (run)
+   {
+      if (run->server)
+         test_netplay_free(run->server);
+      if (run->client)
+         test_netplay_free(run->client);
+      if (link_thread)
+         sthread_join(link_thread);
+      for (i = 0; i < run->loads; i++)
+         free(run->load_states[i]);
+      slock_free(run->lock);
+      free(run);
+   }
+   free(state);
+   free(payload);
+
+   return ok;
+}
+
+/* Delivers a diff whose frame the receiver ran past while it came in */
+static bool test_late_diff(bool to_server)
+{
+   size_t i;
+   uint32_t seed       = 7;
+   uint32_t frame      = 10;
+   size_t state_size   = 256 * 1024;
+   uint8_t *state      = (uint8_t*)malloc(state_size);
+   netplay_t *sender   = NULL;
+   netplay_t *receiver = NULL;
+   int server_fd, client_fd;
+   bool ok             = false;
+
+   if (!state || !test_socket_pair(&server_fd, &client_fd))
+      goto end;
+
+   sender   = test_netplay_new(!to_server,
+         to_server ? client_fd : server_fd, state_size, true);
+   receiver = test_netplay_new(to_server,
+         to_server ? server_fd : client_fd, state_size, true);
+   if (!sender || !receiver)
+      goto end;
+
+   /* Noise, so the diff takes many chunks */
+   for (i = 0; i < state_size; i++)
+   {
+      seed     = seed * 1103515245 + 12345;
+      state[i] = (uint8_t)(seed >> 16);
+   }
+
+   /* The receiver expects the frame's input next */
+   if (to_server)
+   {
+      receiver->read_ptr[1]         = frame % receiver->buffer_size;
+      receiver->read_frame_count[1] = frame;
+   }
+   else
+   {
+      receiver->server_ptr          = frame % receiver->buffer_size;
+      receiver->server_frame_count  = frame;
+   }
+
+   /* Only the first chunk goes out with the command */
+   test_late = 0;
+   if (!netplay_send_savestate_delta(sender, &sender->connections[0],
+            NETPLAY_CMD_LOAD_SAVESTATE_DELTA, state, state_size, frame) ||
+       !netplay_send_flush(&sender->connections[0].send_packet_buffer,
+            sender->connections[0].fd, true))
+      goto end;
+
+   for (i = 0; i < 100 && !receiver->connections[0].savestate_in.pending; i++)
+   {
+      netplay_poll_net_input(receiver, false);
+      retro_sleep(1);
+   }
+   if (!receiver->connections[0].savestate_in.pending)
+      goto end;
+
+   /* Run a buffer's worth of frames on */
+   for (i = 1; i <= receiver->buffer_size; i++)
+   {
+      receiver->other_frame_count = frame + (uint32_t)i;
+      netplay_delta_frame_ready(receiver,
+            &receiver->buffer[(frame + i) % receiver->buffer_size],
+            frame + (uint32_t)i);
+   }
+
+   /* The rest */
+   for (i = 0; i < 10000 &&
+         (sender->connections[0].savestate_out.pending ||
+          receiver->connections[0].savestate_in.pending); i++)
+   {
+      if (!netplay_send_savestate_chunks(sender, &sender->connections[0]) ||
+          !netplay_send_flush(&sender->connections[0].send_packet_buffer,
+            sender->connections[0].fd, false))
+         goto end;
+      netplay_poll_net_input(receiver, false);
+   }
+
+   /* A server sends its own state out, a client asks for one */
+   if (to_server)
+      ok = receiver->force_send_savestate;
+   else
+   {
+      netplay_send_flush(&receiver->connections[0].send_packet_buffer,
+            receiver->connections[0].fd, true);
+      for (i = 0; i < 100 && !sender->force_send_savestate; i++)
+      {
+         netplay_poll_net_input(sender, false);
+         retro_sleep(1);
+      }
+      ok = receiver->savestate_request_outstanding
+         && sender->force_send_savestate;
+   }
+   ok = ok && test_late == 1 && !receiver->force_rewind
+      && receiver->connections[0].active;
+
+   printf("late diff to a %-6s %s\n", to_server ? "server" : "client",
+         ok ? "ok" : "FAILED");
+
+end:
+   if (sender)
+      test_netplay_free(sender);
+   if (receiver)
+      test_netplay_free(receiver);
+   free(state);
+   return ok;
+}
+
+/* Stores a state as the one of the frame, already final */
+static void test_store_frame(netplay_t *netplay, uint32_t frame,
+      const uint8_t *state)
+{
+   size_t ptr = frame % netplay->buffer_size;
+
+   netplay->run_ptr           = ptr;
+   netplay->other_frame_count = frame;
+   netplay_delta_frame_ready(netplay, &netplay->buffer[ptr], frame);
+   memcpy(netplay_delta_frame_state_buffer(netplay), state,
+         netplay->state_size);
+   netplay_delta_frame_store_state(netplay, ptr);
+}
+
+/* Sends a frame hash the client's state doesn't match; a CRC if the server
+ * takes the client for one older than NETPLAY_PROTOCOL_VERSION_FRAME_HASH */
+static bool test_frame_desync(bool old_client)
+{
+   size_t i;
+   uint32_t seed       = 11;
+   uint32_t frame      = 20;
+   size_t state_size   = 256 * 1024;
+   uint8_t *state      = (uint8_t*)malloc(state_size);
+   netplay_t *server   = NULL;
+   netplay_t *client   = NULL;
+   struct delta_frame *delta;
+   int server_fd, client_fd;
+   bool ok             = false;
+
+   if (!state || !test_socket_pair(&server_fd, &client_fd))
+      goto end;
+
+   server = test_netplay_new(true,  server_fd, state_size, true);
+   client = test_netplay_new(false, client_fd, state_size, true);
+   if (!server || !client)
+      goto end;
+
+   for (i = 0; i < state_size; i++)
+   {
+      seed     = seed * 1103515245 + 12345;
+      state[i] = (uint8_t)(seed >> 16);
+   }
+   test_store_frame(server, frame, state);
+   state[5  * NETPLAY_HASH_BLOCK_SIZE + 3]++;
+   state[40 * NETPLAY_HASH_BLOCK_SIZE + 7]++;
+   test_store_frame(client, frame, state);
+
+   if (old_client)
+      server->connections[0].protocol_version = NETPLAY_PROTOCOL_VERSION_MIN;
+
+   /* What a server does on a check frame */
+   delta              = &server->buffer[server->run_ptr];
+   test_desync_log[0] = '\0';
+   if (!netplay_cmd_frame_hash(server, delta) ||
+       !netplay_send_flush(&server->connections[0].send_packet_buffer,
+            server->connections[0].fd, true))
+      goto end;
+
+   /* Only what the client takes is computed: the tree, kept for its
+    * requests, or the CRC alone */
+   if (     delta->have_crc  != old_client
+         || delta->have_hash == old_client
+         || server->hash_tree.valid == old_client
+         || client->hash_desync.valid)
+      goto end;
+
+   for (i = 0; i < 1000 && !client->hash_desync.valid; i++)
+   {
+      netplay_poll_net_input(client, false);
+      retro_sleep(1);
+   }
+   if (!client->hash_desync.valid)
+      goto end;
+
+   /* The search, until the client has all the hashes it asked for */
+   for (i = 0; i < 1000 && client->hash_desync.valid; i++)
+   {
+      netplay_send_flush(&client->connections[0].send_packet_buffer,
+            client->connections[0].fd, false);
+      netplay_poll_net_input(server, false);
+      netplay_send_flush(&server->connections[0].send_packet_buffer,
+            server->connections[0].fd, false);
+      netplay_poll_net_input(client, false);
+      retro_sleep(1);
+   }
+
+   ok = !client->hash_desync.valid
+      && server->hash_tree.valid
+      && server->hash_tree.frame == frame
+      && server->force_send_savestate
+      && client->savestate_request_outstanding
+      && strstr(test_desync_log, "0x5000-0x5FFF")
+      && strstr(test_desync_log, "0x28000-0x28FFF")
+      && NETPLAY_MAX_FRAME_HASH_REQUESTS - client->hash_desync_budget == 3;
+
+   printf("%s desync %s\n", old_client ? "crc" : "frame hash",
+         ok ? "ok" : "FAILED");
+
+end:
+   if (server)
+      test_netplay_free(server);
+   if (client)
+      test_netplay_free(client);
+   free(state);
+   return ok;
+}
+
+int main(int argc, char *argv[])
+{
+   size_t state_size = (argc > 1 ? strtoul(argv[1], NULL, 0) : 4096) * 1024;
+   size_t changes    = argc > 2 ? strtoul(argv[2], NULL, 0) : 64;
+   size_t rate       = (argc > 3 ? strtoul(argv[3], NULL, 0) : 1024) * 1024;
+   bool ok           = true;
+
+   if (!state_size || !rate || !network_init())
+      return 1;
+
+   printf("state: %u KiB, %u bytes changed per frame, link: %u KiB/s, "
+         "%u frames, %u loads\n", (unsigned)(state_size / 1024),
+         (unsigned)changes, (unsigned)(rate / 1024), TEST_FRAMES,
+         (unsigned)TEST_LOADS);
+   printf("%-6s %7s %4s %16s %13s %13s %13s\n", "mode", "states", "late",
+         "to the client", "input stall", "frame send", "state delay");
+
+   ok = test_run(false, state_size, changes, rate) && ok;
+   ok = test_run(true,  state_size, changes, rate) && ok;
+   ok = test_late_diff(false) && ok;
+   ok = test_late_diff(true)  && ok;
+   ok = test_frame_desync(false) && ok;
+   ok = test_frame_desync(true)  && ok;
+
+   return ok ? 0 : 1;
+}
@@ -0,0 +1,511 @@
+/* Copyright  (C) 2010-2020 The RetroArch team
+ *
+ * ---------------------------------------------------------------------------------------
+ * The following license statement only applies to this file (playlist_cache_test.c).
+ * ---------------------------------------------------------------------------------------
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/* Checks that a playlist loaded from its binary cache reads back
+ * the same as one parsed from JSON, that the cache is only used
+ * while it matches the playlist file, and that a playlist loaded
+ * from it can still be changed and written. Then times loading a
+ * large playlist either way.
+ *
+ * Usage: playlist_cache_test [entries to time] [scratch dir] */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef _WIN32
+#include <sys/types.h>
+#include <utime.h>
+#endif
+
+#include <retro_miscellaneous.h>
+#include <compat/strl.h>
+#include <file/file_path.h>
+#include <lists/string_list.h>
+#include <streams/file_stream.h>
+#include <string/stdstring.h>
+
+#include "../../../playlist.h"
+
+#define TEST_CHECK(cond) \
+   do \
+   { \
+      if (!(cond)) \
+      { \
+         fprintf(stderr, "%s:%d: check failed: %s\n", \
+               __FILE__, __LINE__, #cond); \
+         return false; \
+      } \
+   } while (0)
+
+/* Entries shown on a screen of the playlist view */
+#define TEST_VISIBLE 20
+
+static char test_dir[PATH_MAX_LENGTH];
+
+/* Frontend hooks playlist.c links against */
+void RARCH_LOG(const char *fmt, ...) { }
+void RARCH_WARN(const char *fmt, ...) { }
+
+void RARCH_ERR(const char *fmt, ...)
+{
+   va_list ap;
+   va_start(ap, fmt);
+   vfprintf(stderr, fmt, ap);
+   va_end(ap);
+}
+
+bool core_info_find(core_info_ctx_find_t *info)
+{
+   return false;
+}
+
+static uint64_t test_now_ns(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void test_path(char *s, size_t len, const char *name)
+{
+   fill_pathname_join(s, test_dir, name, len);
+}
+
+static void test_cache_path(char *s, size_t len, const char *name)
+{
+   test_path(s, len, name);
+   strlcat(s, ".cache", len);
+}
+
+static playlist_t *test_playlist(const char *name, size_t capacity,
+      bool binary_cache)
+{
+   playlist_config_t config;
+
+   test_path(config.path, sizeof(config.path), name);
+   config.capacity            = capacity;
+   config.old_format          = false;
+   config.compress            = false;
+   config.fuzzy_archive_match = false;
+   config.binary_cache        = binary_cache;
+
+   return playlist_init(&config);
+}
+
+/* Pushes 'count' entries like a content scan would, every
+ * fourth with subsystem content, and sets some metadata */
+static bool test_fill(playlist_t *playlist, unsigned count)
+{
+   unsigned i;
+
+   for (i = 0; i < count; i++)
+   {
+      char path[PATH_MAX_LENGTH];
+      char label[64];
+      char crc32[32];
+      struct playlist_entry entry = {0};
+      struct string_list *roms    = NULL;
+
+      snprintf(label, sizeof(label), "Game %06u (USA)", i);
+      snprintf(path, sizeof(path), "/roms/Game %06u (USA).sfc", i);
+      snprintf(crc32, sizeof(crc32), "%08X|crc", i * 2654435761u);
+
+      entry.path      = path;
+      entry.label     = label;
+      entry.core_path = (char*)"DETECT";
+      entry.core_name = (char*)"DETECT";
+      entry.crc32     = crc32;
+      entry.db_name   = (char*)"Nintendo - Super Nintendo Entertainment System.lpl";
+
+      if (i % 4 == 3)
+      {
+         union string_list_elem_attr attr;
+
+         attr.i                = 0;
+         roms                  = string_list_new();
+         entry.subsystem_ident = (char*)"sgb";
+         entry.subsystem_name  = (char*)"Super Game Boy";
+         entry.subsystem_roms  = roms;
+         string_list_append(roms, "/roms/sgb.sfc", attr);
+         string_list_append(roms, path, attr);
+      }
+
+      TEST_CHECK(playlist_push(playlist, &entry));
+      string_list_free(roms);
+   }
+
+   playlist_set_default_core_path(playlist, "/cores/snes9x_libretro.so");
+   playlist_set_default_core_name(playlist, "Snes9x");
+   playlist_set_label_display_mode(playlist,
+         LABEL_DISPLAY_MODE_REMOVE_PARENTHESES);
+   playlist_set_thumbnail_mode(playlist, PLAYLIST_THUMBNAIL_RIGHT,
+         PLAYLIST_THUMBNAIL_MODE_TITLE_SCREENS);
+   playlist_set_sort_mode(playlist, PLAYLIST_SORT_MODE_OFF);
+
+   return true;
+}
+
+static bool test_same_string(const char *a, const char *b)
+{
+   if (string_is_empty(a) || string_is_empty(b))
+      return string_is_empty(a) == string_is_empty(b);
+   return string_is_equal(a, b);
+}
+
+static bool test_same(playlist_t *a, playlist_t *b)
+{
+   size_t i, j;
+
+   TEST_CHECK(playlist_size(a) == playlist_size(b));
+   TEST_CHECK(test_same_string(playlist_get_default_core_path(a),
+            playlist_get_default_core_path(b)));
+   TEST_CHECK(test_same_string(playlist_get_default_core_name(a),
+            playlist_get_default_core_name(b)));
+   TEST_CHECK(playlist_get_label_display_mode(a)
+         == playlist_get_label_display_mode(b));
+   TEST_CHECK(playlist_get_thumbnail_mode(a, PLAYLIST_THUMBNAIL_RIGHT)
+         == playlist_get_thumbnail_mode(b, PLAYLIST_THUMBNAIL_RIGHT));
+   TEST_CHECK(playlist_get_thumbnail_mode(a, PLAYLIST_THUMBNAIL_LEFT)
+         == playlist_get_thumbnail_mode(b, PLAYLIST_THUMBNAIL_LEFT));
+   TEST_CHECK(playlist_get_sort_mode(a) == playlist_get_sort_mode(b));
+
+   /* Back to front, so the cache is not decoded in order */
+   for (i = playlist_size(a); i-- > 0;)
+   {
+      const struct playlist_entry *x = NULL;
+      const struct playlist_entry *y = NULL;
+
+      playlist_get_index(a, i, &x);
+      playlist_get_index(b, i, &y);
+
+      TEST_CHECK(test_same_string(x->path,            y->path));
+      TEST_CHECK(test_same_string(x->label,           y->label));
+      TEST_CHECK(test_same_string(x->core_path,       y->core_path));
+      TEST_CHECK(test_same_string(x->core_name,       y->core_name));
+      TEST_CHECK(test_same_string(x->crc32,           y->crc32));
+      TEST_CHECK(test_same_string(x->db_name,         y->db_name));
+      TEST_CHECK(test_same_string(x->subsystem_ident, y->subsystem_ident));
+      TEST_CHECK(test_same_string(x->subsystem_name,  y->subsystem_name));
+      TEST_CHECK(!x->subsystem_roms == !y->subsystem_roms);
+
+      if (x->subsystem_roms)
+      {
+         TEST_CHECK(x->subsystem_roms->size == y->subsystem_roms->size);
+         for (j = 0; j < x->subsystem_roms->size; j++)
+            TEST_CHECK(string_is_equal(x->subsystem_roms->elems[j].data,
+                     y->subsystem_roms->elems[j].data));
+      }
+   }
+
+   return true;
+}
+
+/* Overwrites the playlist file with spaces, keeping its size and
+ * mtime, so that only the cache can produce any entries */
+static bool test_blank_playlist(const char *name)
+{
+#ifndef _WIN32
+   char path[PATH_MAX_LENGTH];
+   struct utimbuf times;
+   void *buf      = NULL;
+   int64_t len    = 0;
+   int64_t mtime;
+
+   test_path(path, sizeof(path), name);
+   mtime          = path_get_mtime(path);
+
+   TEST_CHECK(mtime > 0);
+   TEST_CHECK(filestream_read_file(path, &buf, &len));
+   memset(buf, ' ', (size_t)len);
+   TEST_CHECK(filestream_write_file(path, buf, len));
+   free(buf);
+
+   times.actime   = (time_t)mtime;
+   times.modtime  = (time_t)mtime;
+   TEST_CHECK(utime(path, &times) == 0);
+#endif
+   return true;
+}
+
+static bool test_round_trip(void)
+{
+   char cache_path[PATH_MAX_LENGTH];
+   playlist_t *json     = NULL;
+   playlist_t *cached   = NULL;
+   playlist_t *playlist = test_playlist("trip.lpl", 100, true);
+
+   TEST_CHECK(playlist);
+   TEST_CHECK(test_fill(playlist, 40));
+   playlist_write_file(playlist);
+   playlist_free(playlist);
+
+   test_cache_path(cache_path, sizeof(cache_path), "trip.lpl");
+   TEST_CHECK(path_is_valid(cache_path));
+
+   json   = test_playlist("trip.lpl", 100, false);
+   cached = test_playlist("trip.lpl", 100, true);
+   TEST_CHECK(json && cached);
+   TEST_CHECK(playlist_size(json) == 40);
+   TEST_CHECK(test_same(json, cached));
+   playlist_free(cached);
+
+   /* A smaller capacity keeps the first entries only */
+   cached = test_playlist("trip.lpl", 10, true);
+   TEST_CHECK(cached);
+   TEST_CHECK(playlist_size(cached) == 10);
+   {
+      const struct playlist_entry *x = NULL;
+      const struct playlist_entry *y = NULL;
+      playlist_get_index(json, 9, &x);
+      playlist_get_index(cached, 9, &y);
+      TEST_CHECK(string_is_equal(x->path, y->path));
+   }
+   playlist_free(cached);
+   playlist_free(json);
+
+#ifndef _WIN32
+   /* With the file blanked, entries can only come from the cache */
+   TEST_CHECK(test_blank_playlist("trip.lpl"));
+   json   = test_playlist("trip.lpl", 100, false);
+   cached = test_playlist("trip.lpl", 100, true);
+   TEST_CHECK(json && cached);
+   TEST_CHECK(playlist_size(json) == 0);
+   TEST_CHECK(playlist_size(cached) == 40);
+   playlist_free(cached);
+   playlist_free(json);
+#endif
+
+   return true;
+}
+
+static bool test_stale(void)
+{
+   char cache_path[PATH_MAX_LENGTH];
+   char old_cache_path[PATH_MAX_LENGTH];
+   struct playlist_entry update = {0};
+   const struct playlist_entry *entry = NULL;
+   playlist_t *playlist = test_playlist("stale.lpl", 100, true);
+
+   TEST_CHECK(playlist);
+   TEST_CHECK(test_fill(playlist, 8));
+   playlist_write_file(playlist);
+   playlist_free(playlist);
+
+   test_cache_path(cache_path, sizeof(cache_path), "stale.lpl");
+   test_path(old_cache_path, sizeof(old_cache_path), "stale.old");
+   TEST_CHECK(filestream_rename(cache_path, old_cache_path) == 0);
+
+   /* Written without the cache: any sidecar would go */
+   playlist = test_playlist("stale.lpl", 100, false);
+   TEST_CHECK(playlist);
+   update.label = (char*)"A rather longer label than before";
+   playlist_update(playlist, 0, &update);
+   playlist_write_file(playlist);
+   playlist_free(playlist);
+   TEST_CHECK(!path_is_valid(cache_path));
+
+   /* An outdated sidecar is passed over, then replaced */
+   TEST_CHECK(filestream_rename(old_cache_path, cache_path) == 0);
+   playlist = test_playlist("stale.lpl", 100, true);
+   TEST_CHECK(playlist);
+   playlist_get_index(playlist, 0, &entry);
+   TEST_CHECK(string_is_equal(entry->label, update.label));
+   playlist_free(playlist);
+
+   TEST_CHECK(test_blank_playlist("stale.lpl"));
+   playlist = test_playlist("stale.lpl", 100, true);
+   TEST_CHECK(playlist);
+   TEST_CHECK(playlist_size(playlist) == 8);
+   playlist_get_index(playlist, 0, &entry);
+   TEST_CHECK(string_is_equal(entry->label, update.label));
+   playlist_free(playlist);
+
+   {
+      char path[PATH_MAX_LENGTH];
+      test_path(path, sizeof(path), "stale.lpl");
+      playlist_delete_cache_file(path);
+   }
+   TEST_CHECK(!path_is_valid(cache_path));
+
+   return true;
+}
+
+static bool test_modify(void)
+{
+   char label[64];
+   const char *kept_label             = NULL;
+   const struct playlist_entry *entry = NULL;
+   struct playlist_entry update       = {0};
+   struct playlist_entry push         = {0};
+   playlist_t *json                   = NULL;
+   playlist_t *playlist               = test_playlist("modify.lpl", 100, true);
+
+   TEST_CHECK(playlist);
+   TEST_CHECK(test_fill(playlist, 12));
+   playlist_write_file(playlist);
+   playlist_free(playlist);
+
+   playlist = test_playlist("modify.lpl", 100, true);
+   TEST_CHECK(playlist);
+
+   /* Strings handed out before a change stay valid after it */
+   playlist_get_index(playlist, 5, &entry);
+   kept_label = entry->label;
+   strlcpy(label, kept_label, sizeof(label));
+
+   /* Update with the entry's own strings, as the menu does */
+   playlist_get_index(playlist, 2, &entry);
+   update.path      = entry->path;
+   update.label     = (char*)"Renamed";
+   update.core_path = entry->core_path;
+   playlist_update(playlist, 2, &update);
+   TEST_CHECK(string_is_equal(kept_label, label));
+
+   playlist_delete_index(playlist, 0);
+   push.path      = (char*)"/roms/New.sfc";
+   push.core_path = (char*)"/cores/x.so";
+   push.core_name = (char*)"x";
+   TEST_CHECK(playlist_push(playlist, &push));
+   TEST_CHECK(playlist_entry_exists(playlist, "/roms/New.sfc"));
+
+   playlist_set_sort_mode(playlist, PLAYLIST_SORT_MODE_ALPHABETICAL);
+   playlist_qsort(playlist);
+   playlist_write_file(playlist);
+
+   /* The rewritten sidecar matches the rewritten file */
+   json = test_playlist("modify.lpl", 100, false);
+   TEST_CHECK(json);
+   TEST_CHECK(playlist_size(json) == 12);
+   TEST_CHECK(test_same(json, playlist));
+   playlist_free(playlist);
+
+   playlist = test_playlist("modify.lpl", 100, true);
+   TEST_CHECK(playlist);
+   TEST_CHECK(test_same(json, playlist));
+   playlist_get_index_by_path(playlist, "/roms/New.sfc", &entry);
+   TEST_CHECK(entry && string_is_equal(entry->core_name, "x"));
+
+   playlist_clear(playlist);
+   TEST_CHECK(playlist_size(playlist) == 0);
+   playlist_free(playlist);
+   playlist_free(json);
+
+   return true;
+}
+
+/* Loads a large playlist, reading one screen of it (as the menu
+ * does on opening it) and then all of it */
+static bool test_bench(unsigned count)
+{
+   unsigned pass;
+   char path[PATH_MAX_LENGTH];
+   char cache_path[PATH_MAX_LENGTH];
+   playlist_t *playlist = test_playlist("bench.lpl", count, true);
+
+   TEST_CHECK(playlist);
+   TEST_CHECK(test_fill(playlist, count));
+   playlist_write_file(playlist);
+   playlist_free(playlist);
+
+   test_path(path, sizeof(path), "bench.lpl");
+   test_cache_path(cache_path, sizeof(cache_path), "bench.lpl");
+
+   printf("%u entries: JSON %d bytes, cache %d bytes\n", count,
+         (int)path_get_size(path), (int)path_get_size(cache_path));
+
+   for (pass = 0; pass < 2; pass++)
+   {
+      size_t i;
+      uint64_t start, open_ns, all_ns;
+      size_t length = 0;
+
+      start    = test_now_ns();
+      playlist = test_playlist("bench.lpl", count, pass == 1);
+      TEST_CHECK(playlist);
+      TEST_CHECK(playlist_size(playlist) == count);
+
+      for (i = 0; i < TEST_VISIBLE; i++)
+      {
+         const struct playlist_entry *entry = NULL;
+         playlist_get_index(playlist, i, &entry);
+         length += strlen(entry->label);
+      }
+      open_ns  = test_now_ns() - start;
+
+      for (i = 0; i < count; i++)
+      {
+         const struct playlist_entry *entry = NULL;
+         playlist_get_index(playlist, i, &entry);
+         length += strlen(entry->label);
+      }
+      all_ns   = test_now_ns() - start;
+
+      playlist_free(playlist);
+      TEST_CHECK(length > 0);
+
+      printf("%-5s: first screen %9.3f ms, every entry %9.3f ms\n",
+            pass ? "cache" : "JSON", open_ns / 1000000.0,
+            all_ns / 1000000.0);
+   }
+
+   filestream_delete(path);
+   filestream_delete(cache_path);
+   return true;
+}
+
+int main(int argc, char *argv[])
+{
+   size_t i;
+   char path[PATH_MAX_LENGTH];
+   static const char *files[] = { "trip.lpl", "stale.lpl", "modify.lpl" };
+   unsigned count = argc > 1 ? (unsigned)strtoul(argv[1], NULL, 0) : 20000;
+   bool ok        = true;
+
+   strlcpy(test_dir, argc > 2 ? argv[2] : "playlist_cache_scratch",
+         sizeof(test_dir));
+
+   if (!path_is_directory(test_dir) && !path_mkdir(test_dir))
+   {
+      fprintf(stderr, "Can't create %s.\n", test_dir);
+      return 1;
+   }
+
+   ok = test_round_trip()    && ok;
+   ok = test_stale()         && ok;
+   ok = test_modify()        && ok;
+   if (count)
+      ok = test_bench(count) && ok;
+
+   for (i = 0; i < sizeof(files) / sizeof(files[0]); i++)
+   {
+      test_path(path, sizeof(path), files[i]);
+      filestream_delete(path);
+      test_cache_path(path, sizeof(path), files[i]);
+      filestream_delete(path);
+   }
+   filestream_delete(test_dir);
+
+   return ok ? 0 : 1;
+}
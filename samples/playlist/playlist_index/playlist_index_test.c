@@ -0,0 +1,387 @@
+/* Copyright  (C) 2010-2020 The RetroArch team
+ *
+ * ---------------------------------------------------------------------------------------
+ * The following license statement only applies to this file (playlist_index_test.c).
+ * ---------------------------------------------------------------------------------------
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/* Checks how playlist_push(), playlist_entry_exists() and friends
+ * match paths (relative, through symlinks, into archives) while
+ * entries are pushed, bumped, updated, deleted, evicted and sorted,
+ * then times populating and probing a large playlist.
+ *
+ * Usage: playlist_index_test [entries to time] [scratch dir] */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#include <retro_miscellaneous.h>
+#include <compat/strl.h>
+#include <file/file_path.h>
+#include <streams/file_stream.h>
+
+#include "../../../playlist.h"
+
+#define TEST_CHECK(cond) \
+   do \
+   { \
+      if (!(cond)) \
+      { \
+         fprintf(stderr, "%s:%d: check failed: %s\n", \
+               __FILE__, __LINE__, #cond); \
+         return false; \
+      } \
+   } while (0)
+
+/* Content that has to exist for its path to resolve */
+static const char *test_files[] = { "roms/a.sfc", "roms/b.sfc" };
+
+static char test_dir[PATH_MAX_LENGTH];
+
+/* Frontend hooks playlist.c links against */
+void RARCH_LOG(const char *fmt, ...) { }
+void RARCH_WARN(const char *fmt, ...) { }
+
+void RARCH_ERR(const char *fmt, ...)
+{
+   va_list ap;
+   va_start(ap, fmt);
+   vfprintf(stderr, fmt, ap);
+   va_end(ap);
+}
+
+bool core_info_find(core_info_ctx_find_t *info)
+{
+   return false;
+}
+
+static uint64_t test_now_ns(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void test_path(char *s, size_t len, const char *name)
+{
+   fill_pathname_join(s, test_dir, name, len);
+}
+
+static playlist_t *test_playlist(size_t capacity, bool fuzzy)
+{
+   playlist_config_t config;
+
+   /* Never written: the path only has to be unique */
+   test_path(config.path, sizeof(config.path), "unused.lpl");
+   config.capacity            = capacity;
+   config.old_format          = false;
+   config.compress            = false;
+   config.fuzzy_archive_match = fuzzy;
+   config.binary_cache        = false;
+
+   return playlist_init(&config);
+}
+
+static bool test_push(playlist_t *playlist, const char *name,
+      const char *core_path)
+{
+   char path[PATH_MAX_LENGTH];
+   struct playlist_entry entry = {0};
+
+   test_path(path, sizeof(path), name);
+   entry.path      = path;
+   entry.core_path = (char*)core_path;
+   entry.core_name = (char*)"core";
+
+   return playlist_push(playlist, &entry);
+}
+
+static bool test_exists(playlist_t *playlist, const char *name)
+{
+   char path[PATH_MAX_LENGTH];
+   test_path(path, sizeof(path), name);
+   return playlist_entry_exists(playlist, path);
+}
+
+/* Returns the playlist position of the entry found for 'name' */
+static int test_find(playlist_t *playlist, const char *name)
+{
+   size_t i;
+   char path[PATH_MAX_LENGTH];
+   const struct playlist_entry *found = NULL;
+
+   test_path(path, sizeof(path), name);
+   playlist_get_index_by_path(playlist, path, &found);
+
+   for (i = 0; found && i < playlist_size(playlist); i++)
+   {
+      const struct playlist_entry *entry = NULL;
+      playlist_get_index(playlist, i, &entry);
+      if (entry == found)
+         return (int)i;
+   }
+
+   return -1;
+}
+
+static bool test_matching(void)
+{
+   playlist_t *playlist = test_playlist(16, true);
+
+   TEST_CHECK(playlist);
+
+   TEST_CHECK(test_push(playlist, "roms/a.sfc", "/cores/x.so"));
+   TEST_CHECK(test_push(playlist, "roms/b.sfc", "/cores/x.so"));
+   TEST_CHECK(playlist_size(playlist) == 2);
+
+   /* Same content and core: refused at the top, bumped below it */
+   TEST_CHECK(!test_push(playlist, "roms/b.sfc", "/cores/x.so"));
+   TEST_CHECK(test_push(playlist, "roms/./a.sfc", "/cores/x.so"));
+   TEST_CHECK(playlist_size(playlist) == 2);
+   TEST_CHECK(test_find(playlist, "roms/a.sfc") == 0);
+   TEST_CHECK(test_find(playlist, "roms/b.sfc") == 1);
+
+   /* Same content, other core: a new entry */
+   TEST_CHECK(test_push(playlist, "roms/b.sfc", "/cores/y.so"));
+   TEST_CHECK(playlist_size(playlist) == 3);
+   TEST_CHECK(test_find(playlist, "roms/b.sfc") == 0);
+
+   TEST_CHECK(test_exists(playlist, "roms/../roms/a.sfc"));
+   TEST_CHECK(!test_exists(playlist, "roms/c.sfc"));
+#ifndef _WIN32
+   TEST_CHECK(test_exists(playlist, "link/a.sfc"));
+   TEST_CHECK(!test_push(playlist, "link/b.sfc", "/cores/y.so"));
+#endif
+
+   /* Both entries for b.sfc go */
+   {
+      char path[PATH_MAX_LENGTH];
+      test_path(path, sizeof(path), "roms/b.sfc");
+      playlist_delete_by_path(playlist, path);
+   }
+   TEST_CHECK(playlist_size(playlist) == 1);
+   TEST_CHECK(!test_exists(playlist, "roms/b.sfc"));
+   TEST_CHECK(test_find(playlist, "roms/a.sfc") == 0);
+
+   /* Renamed content is found by its new path only */
+   {
+      char path[PATH_MAX_LENGTH];
+      struct playlist_entry update = {0};
+
+      test_path(path, sizeof(path), "roms/renamed.sfc");
+      update.path = path;
+      playlist_update(playlist, 0, &update);
+   }
+   TEST_CHECK(!test_exists(playlist, "roms/a.sfc"));
+   TEST_CHECK(test_exists(playlist, "roms/renamed.sfc"));
+
+   /* Entries without content match each other only */
+   {
+      struct playlist_entry entry = {0};
+      entry.core_path = (char*)"/cores/x.so";
+      entry.core_name = (char*)"core";
+
+      TEST_CHECK(playlist_push(playlist, &entry));
+      TEST_CHECK(playlist_size(playlist) == 2);
+      TEST_CHECK(!playlist_push(playlist, &entry));
+      TEST_CHECK(playlist_size(playlist) == 2);
+   }
+
+   playlist_free(playlist);
+   return true;
+}
+
+static bool test_archives(void)
+{
+   playlist_t *playlist = test_playlist(16, true);
+
+   TEST_CHECK(playlist);
+
+   TEST_CHECK(test_push(playlist, "roms/game.zip#game.sfc", "/cores/x.so"));
+   TEST_CHECK(test_push(playlist, "roms/other.7z", "/cores/x.so"));
+
+   /* [archive] finds [archive]#[file], and the other way around */
+   TEST_CHECK(test_exists(playlist, "roms/game.zip"));
+   TEST_CHECK(test_exists(playlist, "roms/other.7z#other.sfc"));
+   TEST_CHECK(!test_exists(playlist, "roms/game.7z"));
+   TEST_CHECK(!test_exists(playlist, "roms/other.zip#other.sfc"));
+   TEST_CHECK(test_find(playlist, "roms/game.zip") == 1);
+
+   /* Loading the archive bumps the entry inside it */
+   TEST_CHECK(test_push(playlist, "roms/game.zip", "/cores/x.so"));
+   TEST_CHECK(playlist_size(playlist) == 2);
+   TEST_CHECK(test_find(playlist, "roms/game.zip#game.sfc") == 0);
+
+   playlist_free(playlist);
+
+   /* Without fuzzy matching, only exact paths count */
+   playlist = test_playlist(16, false);
+   TEST_CHECK(playlist);
+   TEST_CHECK(test_push(playlist, "roms/game.zip#game.sfc", "/cores/x.so"));
+   TEST_CHECK(!test_exists(playlist, "roms/game.zip"));
+   TEST_CHECK(test_exists(playlist, "roms/game.zip#game.sfc"));
+   playlist_free(playlist);
+
+   return true;
+}
+
+static bool test_capacity_and_sort(void)
+{
+   unsigned i;
+   char name[64];
+   playlist_t *playlist = test_playlist(4, true);
+
+   TEST_CHECK(playlist);
+
+   for (i = 0; i < 6; i++)
+   {
+      snprintf(name, sizeof(name), "roms/%c.sfc", 'f' - i);
+      TEST_CHECK(test_push(playlist, name, "/cores/x.so"));
+   }
+
+   /* The two oldest fell off the bottom */
+   TEST_CHECK(playlist_size(playlist) == 4);
+   TEST_CHECK(!test_exists(playlist, "roms/f.sfc"));
+   TEST_CHECK(!test_exists(playlist, "roms/e.sfc"));
+   TEST_CHECK(test_find(playlist, "roms/a.sfc") == 0);
+   TEST_CHECK(test_find(playlist, "roms/d.sfc") == 3);
+
+   /* Sorting by label (here, file name) reverses them */
+   playlist_set_sort_mode(playlist, PLAYLIST_SORT_MODE_ALPHABETICAL);
+   playlist_qsort(playlist);
+   TEST_CHECK(test_find(playlist, "roms/a.sfc") == 0);
+   TEST_CHECK(test_find(playlist, "roms/b.sfc") == 1);
+   TEST_CHECK(test_find(playlist, "roms/d.sfc") == 3);
+
+   playlist_delete_index(playlist, 1);
+   TEST_CHECK(!test_exists(playlist, "roms/b.sfc"));
+   TEST_CHECK(test_find(playlist, "roms/c.sfc") == 1);
+   TEST_CHECK(test_find(playlist, "roms/d.sfc") == 2);
+
+   /* After a clear, nothing is left to find */
+   playlist_clear(playlist);
+   TEST_CHECK(!test_exists(playlist, "roms/a.sfc"));
+   TEST_CHECK(test_push(playlist, "roms/a.sfc", "/cores/x.so"));
+   TEST_CHECK(test_find(playlist, "roms/a.sfc") == 0);
+
+   playlist_free(playlist);
+   return true;
+}
+
+/* Populates a playlist the way a content scan does, then checks
+ * every entry is there */
+static bool test_bench(unsigned count)
+{
+   unsigned i;
+   uint64_t start, push_ns, exists_ns;
+   char name[64];
+   playlist_t *playlist = test_playlist(count, true);
+
+   TEST_CHECK(playlist);
+
+   start = test_now_ns();
+   for (i = 0; i < count; i++)
+   {
+      snprintf(name, sizeof(name), "roms/game%06u.sfc", i);
+      TEST_CHECK(test_push(playlist, name, "DETECT"));
+   }
+   push_ns = test_now_ns() - start;
+
+   start = test_now_ns();
+   for (i = 0; i < count; i++)
+   {
+      snprintf(name, sizeof(name), "roms/game%06u.sfc", i);
+      TEST_CHECK(test_exists(playlist, name));
+   }
+   exists_ns = test_now_ns() - start;
+
+   playlist_free(playlist);
+
+   printf("%u entries: push %9.3f ms, exists %9.3f ms\n", count,
+         push_ns / 1000000.0, exists_ns / 1000000.0);
+   return true;
+}
+
+int main(int argc, char *argv[])
+{
+   size_t i;
+   char path[PATH_MAX_LENGTH];
+   unsigned count = argc > 1 ? (unsigned)strtoul(argv[1], NULL, 0) : 5000;
+   bool ok        = true;
+
+   strlcpy(test_dir, argc > 2 ? argv[2] : "playlist_index_scratch",
+         sizeof(test_dir));
+
+   test_path(path, sizeof(path), "roms");
+   if (!path_is_directory(path) && !path_mkdir(path))
+   {
+      fprintf(stderr, "Can't create %s.\n", path);
+      return 1;
+   }
+
+   for (i = 0; i < sizeof(test_files) / sizeof(test_files[0]); i++)
+   {
+      test_path(path, sizeof(path), test_files[i]);
+      if (!filestream_write_file(path, "", 0))
+      {
+         fprintf(stderr, "Can't create %s.\n", path);
+         return 1;
+      }
+   }
+
+#ifndef _WIN32
+   {
+      char link_path[PATH_MAX_LENGTH];
+      test_path(link_path, sizeof(link_path), "link");
+      unlink(link_path);
+      if (symlink("roms", link_path) != 0)
+      {
+         fprintf(stderr, "Can't create %s.\n", link_path);
+         return 1;
+      }
+   }
+#endif
+
+   ok = test_matching()          && ok;
+   ok = test_archives()          && ok;
+   ok = test_capacity_and_sort() && ok;
+   if (count)
+      ok = test_bench(count)     && ok;
+
+#ifndef _WIN32
+   test_path(path, sizeof(path), "link");
+   unlink(path);
+#endif
+   for (i = 0; i < sizeof(test_files) / sizeof(test_files[0]); i++)
+   {
+      test_path(path, sizeof(path), test_files[i]);
+      filestream_delete(path);
+   }
+   test_path(path, sizeof(path), "roms");
+   filestream_delete(path);
+   filestream_delete(test_dir);
+
+   return ok ? 0 : 1;
+}
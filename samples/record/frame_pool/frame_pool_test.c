@@ -0,0 +1,385 @@
+/* Copyright  (C) 2010-2020 The RetroArch team
+ *
+ * ---------------------------------------------------------------------------------------
+ * The following license statement only applies to this file (frame_pool_test.c).
+ * ---------------------------------------------------------------------------------------
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/* Checks the drop policy and counters of the recording frame pool,
+ * then streams frames through it from one thread to a deliberately
+ * slow second one, verifying order and contents on the way and
+ * timing how long the producer spends per frame.
+ *
+ * Usage: frame_pool_test [frames] */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <retro_timers.h>
+#include <rthreads/rthreads.h>
+#include <queues/spsc_queue.h>
+
+#include "../../../record/record_frame_pool.h"
+
+#define TEST_WIDTH    320
+#define TEST_HEIGHT   240
+#define TEST_PIX_SIZE 4
+#define TEST_POOL     8
+/* Frame period of the simulated core, in ms, and how long the
+ * simulated encoder stalls every 64 frames */
+#define TEST_PERIOD   1
+#define TEST_STALL    20
+
+#define TEST_CHECK(cond) \
+   do \
+   { \
+      if (!(cond)) \
+      { \
+         fprintf(stderr, "%s:%d: check failed: %s\n", \
+               __FILE__, __LINE__, #cond); \
+         return false; \
+      } \
+   } while (0)
+
+struct test_stream
+{
+   record_frame_pool_t *pool;
+   slock_t *lock;
+   unsigned frames;
+   bool done;
+
+   /* Consumer results */
+   unsigned received;
+   unsigned repeats;
+   bool ok;
+};
+
+static uint64_t test_now_ns(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* Stamps every pixel of a frame with its sequence number, leaving
+ * the pitch padding of each row unset */
+static void test_fill(uint32_t *pixels, unsigned pitch_pixels,
+      unsigned height, uint32_t seq)
+{
+   unsigned x, y;
+   for (y = 0; y < height; y++)
+      for (x = 0; x < TEST_WIDTH; x++)
+         pixels[y * pitch_pixels + x] = seq ^ (y << 16) ^ x;
+}
+
+static bool test_frame_matches(const struct record_frame *frame,
+      unsigned height, uint32_t seq)
+{
+   unsigned x, y;
+   const uint32_t *pixels = (const uint32_t*)frame->video.data;
+
+   if (  frame->video.width  != TEST_WIDTH
+      || frame->video.height != height
+      || frame->video.pitch  != TEST_WIDTH * TEST_PIX_SIZE)
+      return false;
+
+   for (y = 0; y < height; y++)
+      for (x = 0; x < TEST_WIDTH; x++)
+         if (pixels[y * TEST_WIDTH + x] != (seq ^ (y << 16) ^ x))
+            return false;
+   return true;
+}
+
+static bool test_spsc_queue(void)
+{
+   size_t i;
+   void *item        = NULL;
+   spsc_queue_t *q   = spsc_queue_new(5);
+
+   TEST_CHECK(q);
+   TEST_CHECK(spsc_queue_capacity(q) == 8);
+   TEST_CHECK(!spsc_queue_pop(q, &item));
+
+   for (i = 1; i <= 8; i++)
+      TEST_CHECK(spsc_queue_push(q, (void*)i));
+   TEST_CHECK(!spsc_queue_push(q, (void*)9));
+   TEST_CHECK(spsc_queue_size(q) == 8);
+
+   for (i = 1; i <= 8; i++)
+   {
+      TEST_CHECK(spsc_queue_pop(q, &item));
+      TEST_CHECK(item == (void*)i);
+   }
+   TEST_CHECK(spsc_queue_size(q) == 0);
+
+   spsc_queue_free(q);
+   return true;
+}
+
+static bool test_policy(void)
+{
+   unsigned i;
+   struct record_stats stats;
+   struct record_video_data vid;
+   struct record_frame *frames[TEST_POOL];
+   struct record_frame *frame = NULL;
+   uint32_t *src              = (uint32_t*)malloc(
+         2 * TEST_WIDTH * TEST_HEIGHT * TEST_PIX_SIZE);
+   record_frame_pool_t *pool  = record_frame_pool_new(TEST_POOL,
+         TEST_WIDTH * TEST_HEIGHT * TEST_PIX_SIZE);
+
+   TEST_CHECK(src && pool);
+
+   /* A padded pitch is packed away */
+   test_fill(src, 2 * TEST_WIDTH, TEST_HEIGHT, 1);
+   vid.data    = src;
+   vid.width   = TEST_WIDTH;
+   vid.height  = TEST_HEIGHT;
+   vid.pitch   = 2 * TEST_WIDTH * TEST_PIX_SIZE;
+   vid.is_dupe = false;
+   TEST_CHECK(record_frame_pool_push(pool, &vid, TEST_PIX_SIZE));
+
+   frame = record_frame_pool_pop(pool);
+   TEST_CHECK(frame && !frame->video.is_dupe);
+   TEST_CHECK(test_frame_matches(frame, TEST_HEIGHT, 1));
+   record_frame_pool_release(pool, frame);
+
+   /* So is a negative one */
+   test_fill(src, TEST_WIDTH, TEST_HEIGHT, 2);
+   vid.data  = src + (TEST_HEIGHT - 1) * TEST_WIDTH;
+   vid.pitch = -TEST_WIDTH * TEST_PIX_SIZE;
+   TEST_CHECK(record_frame_pool_push(pool, &vid, TEST_PIX_SIZE));
+
+   frame = record_frame_pool_pop(pool);
+   TEST_CHECK(frame);
+   {
+      unsigned y;
+      const uint8_t *rows = (const uint8_t*)frame->video.data;
+      for (y = 0; y < TEST_HEIGHT; y++)
+         TEST_CHECK(!memcmp(rows + y * TEST_WIDTH * TEST_PIX_SIZE,
+                  src + (TEST_HEIGHT - 1 - y) * TEST_WIDTH,
+                  TEST_WIDTH * TEST_PIX_SIZE));
+   }
+   record_frame_pool_release(pool, frame);
+
+   /* Fill every buffer without consuming any */
+   vid.data  = src;
+   vid.pitch = TEST_WIDTH * TEST_PIX_SIZE;
+   for (i = 0; i < TEST_POOL; i++)
+      TEST_CHECK(record_frame_pool_push(pool, &vid, TEST_PIX_SIZE));
+
+   /* Out of buffers: dropped and queued as a repeat */
+   TEST_CHECK(record_frame_pool_push(pool, &vid, TEST_PIX_SIZE));
+   record_frame_pool_get_stats(pool, &stats);
+   TEST_CHECK(stats.dropped == 1 && stats.skipped == 0);
+   TEST_CHECK(stats.queued == TEST_POOL + 1);
+
+   /* Until the queue itself is full: skipped */
+   for (i = TEST_POOL + 1; i < 2 * TEST_POOL; i++)
+      TEST_CHECK(record_frame_pool_push(pool, &vid, TEST_PIX_SIZE));
+   TEST_CHECK(!record_frame_pool_push(pool, &vid, TEST_PIX_SIZE));
+
+   /* A frame larger than the buffers is skipped as well */
+   vid.height = TEST_HEIGHT + 1;
+   TEST_CHECK(!record_frame_pool_push(pool, &vid, TEST_PIX_SIZE));
+   vid.height = TEST_HEIGHT;
+
+   record_frame_pool_get_stats(pool, &stats);
+   TEST_CHECK(stats.pushed  == 2 + 2 * TEST_POOL + 2);
+   TEST_CHECK(stats.dropped == TEST_POOL);
+   TEST_CHECK(stats.skipped == 2);
+   TEST_CHECK(stats.queued  == 2 * TEST_POOL);
+
+   /* Real frames come out first, in order, then the repeats */
+   for (i = 0; i < TEST_POOL; i++)
+   {
+      frames[i] = record_frame_pool_pop(pool);
+      TEST_CHECK(frames[i] && !frames[i]->video.is_dupe);
+   }
+   for (i = 0; i < TEST_POOL; i++)
+   {
+      frame = record_frame_pool_pop(pool);
+      TEST_CHECK(frame && frame->video.is_dupe);
+      /* Giving back a repeat is harmless */
+      record_frame_pool_release(pool, frame);
+   }
+   TEST_CHECK(!record_frame_pool_pop(pool));
+
+   /* Once buffers are back, frames are copied again */
+   record_frame_pool_release(pool, frames[0]);
+   TEST_CHECK(record_frame_pool_push(pool, &vid, TEST_PIX_SIZE));
+   frame = record_frame_pool_pop(pool);
+   TEST_CHECK(frame == frames[0] && !frame->video.is_dupe);
+
+   record_frame_pool_free(pool);
+   free(src);
+   return true;
+}
+
+static bool test_stream_done(struct test_stream *stream)
+{
+   bool done;
+   slock_lock(stream->lock);
+   done = stream->done;
+   slock_unlock(stream->lock);
+   return done;
+}
+
+static void test_consumer(void *data)
+{
+   struct test_stream *stream = (struct test_stream*)data;
+   uint32_t last_seq          = 0;
+
+   for (;;)
+   {
+      /* Sampled before popping, so that nothing pushed before
+       * it was set can be missed */
+      bool done                  = test_stream_done(stream);
+      struct record_frame *frame = record_frame_pool_pop(stream->pool);
+
+      if (!frame)
+      {
+         if (done)
+            break;
+         retro_sleep(0);
+         continue;
+      }
+
+      if (frame->video.is_dupe)
+         stream->repeats++;
+      else
+      {
+         uint32_t seq = *(const uint32_t*)frame->video.data;
+
+         if (seq <= last_seq
+               || !test_frame_matches(frame, TEST_HEIGHT, seq))
+         {
+            fprintf(stderr, "Frame %u arrived damaged or out of order.\n",
+                  (unsigned)seq);
+            stream->ok = false;
+         }
+         last_seq = seq;
+         stream->received++;
+
+         /* Every so often, play an encoder that can't keep up */
+         if ((seq % 64) == 0)
+            retro_sleep(TEST_STALL);
+      }
+
+      record_frame_pool_release(stream->pool, frame);
+   }
+}
+
+static bool test_threaded(unsigned frames)
+{
+   unsigned i;
+   struct record_stats stats;
+   struct record_video_data vid;
+   struct test_stream stream;
+   sthread_t *consumer = NULL;
+   uint64_t total_ns   = 0;
+   uint64_t max_ns     = 0;
+   unsigned dupes      = 0;
+   uint32_t *src       = (uint32_t*)malloc(
+         TEST_WIDTH * TEST_HEIGHT * TEST_PIX_SIZE);
+
+   TEST_CHECK(src);
+
+   memset(&stream, 0, sizeof(stream));
+   stream.pool   = record_frame_pool_new(TEST_POOL,
+         TEST_WIDTH * TEST_HEIGHT * TEST_PIX_SIZE);
+   stream.lock   = slock_new();
+   stream.frames = frames;
+   stream.ok     = true;
+   TEST_CHECK(stream.pool && stream.lock);
+
+   consumer      = sthread_create(test_consumer, &stream);
+   TEST_CHECK(consumer);
+
+   vid.data      = src;
+   vid.width     = TEST_WIDTH;
+   vid.height    = TEST_HEIGHT;
+   vid.pitch     = TEST_WIDTH * TEST_PIX_SIZE;
+
+   for (i = 1; i <= frames; i++)
+   {
+      uint64_t start, elapsed;
+
+      /* Every tenth frame, the core repeats the previous one */
+      vid.is_dupe = (i % 10) == 0;
+      if (!vid.is_dupe)
+         test_fill(src, TEST_WIDTH, TEST_HEIGHT, i);
+
+      start   = test_now_ns();
+      if (record_frame_pool_push(stream.pool, &vid, TEST_PIX_SIZE)
+            && vid.is_dupe)
+         dupes++;
+      elapsed = test_now_ns() - start;
+
+      total_ns += elapsed;
+      if (elapsed > max_ns)
+         max_ns = elapsed;
+
+      retro_sleep(TEST_PERIOD);
+   }
+
+   slock_lock(stream.lock);
+   stream.done = true;
+   slock_unlock(stream.lock);
+   sthread_join(consumer);
+
+   record_frame_pool_get_stats(stream.pool, &stats);
+
+   printf("Pushed %u frames: %u encoded, %u repeats, "
+         "%llu dropped, %llu skipped.\n",
+         frames, stream.received, stream.repeats,
+         (unsigned long long)stats.dropped,
+         (unsigned long long)stats.skipped);
+   printf("Producer time per frame: mean %.1f us, max %.1f us.\n",
+         total_ns / 1000.0 / frames, max_ns / 1000.0);
+
+   TEST_CHECK(stream.ok);
+   TEST_CHECK(stats.pushed == frames);
+   TEST_CHECK(stream.received + stream.repeats == frames - stats.skipped);
+   TEST_CHECK(stream.repeats == dupes + stats.dropped);
+   TEST_CHECK(stats.queued == 0);
+
+   slock_free(stream.lock);
+   record_frame_pool_free(stream.pool);
+   free(src);
+   return true;
+}
+
+int main(int argc, char *argv[])
+{
+   unsigned frames = argc > 1 ? (unsigned)strtoul(argv[1], NULL, 0) : 2000;
+
+   if (!frames)
+      frames = 2000;
+
+   if (!test_spsc_queue() || !test_policy() || !test_threaded(frames))
+   {
+      fprintf(stderr, "FAILED\n");
+      return 1;
+   }
+
+   printf("OK\n");
+   return 0;
+}
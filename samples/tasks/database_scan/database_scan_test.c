@@ -0,0 +1,317 @@
+/* Copyright  (C) 2010-2020 The RetroArch team
+ *
+ * ---------------------------------------------------------------------------------------
+ * The following license statement only applies to this file (database_scan_test.c).
+ * ---------------------------------------------------------------------------------------
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/* Scans a directory of generated content against a generated
+ * database through task_push_dbscan(), with the files hashed on
+ * the scanner's thread pool, and checks the playlist it writes:
+ * every known file is matched to its own entry, unknown files
+ * are left out, and the track of a cue sheet is only added
+ * through the sheet. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <retro_miscellaneous.h>
+#include <file/file_path.h>
+#include <streams/file_stream.h>
+#include <encodings/crc32.h>
+#include <queues/task_queue.h>
+#include <string/stdstring.h>
+
+#include "../../../core_info.h"
+#include "../../../playlist.h"
+#include "../../../msg_hash.h"
+#include "../../../tasks/tasks_internal.h"
+#include "../../../libretro-db/libretrodb.h"
+#include "../../../libretro-db/rmsgpack_dom.h"
+
+#define TEST_CHECK(cond) \
+   do \
+   { \
+      if (!(cond)) \
+      { \
+         fprintf(stderr, "%s:%d: check failed: %s\n", \
+               __FILE__, __LINE__, #cond); \
+         return false; \
+      } \
+   } while (0)
+
+#define TEST_DIR          "database_scan_test.dir"
+#define TEST_CONTENT_DIR  TEST_DIR "/content"
+#define TEST_DB_DIR       TEST_DIR "/database"
+#define TEST_PLAYLIST_DIR TEST_DIR "/playlists"
+#define TEST_SYSTEM       "Test System"
+/* Files in the database, then files that are not */
+#define TEST_KNOWN        24
+#define TEST_UNKNOWN      4
+#define TEST_DISC_SIZE    (2352 * 16)
+
+/* The database entries: one per known file, then the disc */
+static uint32_t test_crcs[TEST_KNOWN + 1];
+static bool test_done;
+
+/* The scanner only asks core info whether a core can load
+ * the content; this test has no cores, and accepts it all */
+bool core_info_database_supports_content_path(
+      const char *database_path, const char *path)
+{
+   return true;
+}
+
+bool core_info_database_match_archive_member(const char *database_path)
+{
+   return false;
+}
+
+bool core_info_get_list(core_info_list_t **core)
+{
+   *core = NULL;
+   return false;
+}
+
+bool core_info_find(core_info_ctx_find_t *info)
+{
+   return false;
+}
+
+int msg_hash_get_help_us_enum(enum msg_hash_enums msg, char *s, size_t len)
+{
+   return 0;
+}
+
+static void test_fill(uint8_t *buf, size_t len, unsigned seed)
+{
+   size_t i;
+   uint32_t x = seed * 2654435761u + 1;
+
+   for (i = 0; i < len; i++)
+   {
+      x      = x * 1103515245 + 12345;
+      buf[i] = (uint8_t)(x >> 16);
+   }
+}
+
+static bool test_write_content(void)
+{
+   unsigned i;
+   char path[PATH_MAX_LENGTH];
+   uint8_t *buf = (uint8_t*)malloc(TEST_DISC_SIZE);
+   const char *cue =
+      "FILE \"disc.bin\" BINARY\n"
+      "  TRACK 01 MODE1/2352\n"
+      "    INDEX 01 00:00:00\n";
+
+   TEST_CHECK(buf);
+
+   for (i = 0; i < TEST_KNOWN + TEST_UNKNOWN; i++)
+   {
+      /* Sizes differ, so some files end mid-chunk */
+      size_t len = 1000 + i * 777;
+
+      snprintf(path, sizeof(path), TEST_CONTENT_DIR "/game%02u.bin", i);
+      test_fill(buf, len, i);
+      TEST_CHECK(filestream_write_file(path, buf, len));
+      if (i < TEST_KNOWN)
+         test_crcs[i] = encoding_crc32(0, buf, len);
+   }
+
+   test_fill(buf, TEST_DISC_SIZE, 1000);
+   TEST_CHECK(filestream_write_file(TEST_CONTENT_DIR "/disc.bin",
+            buf, TEST_DISC_SIZE));
+   test_crcs[TEST_KNOWN] = encoding_crc32(0, buf, TEST_DISC_SIZE);
+   TEST_CHECK(filestream_write_file(TEST_CONTENT_DIR "/disc.cue",
+            cue, strlen(cue)));
+
+   free(buf);
+   return true;
+}
+
+static char *test_strdup_len(const char *s, uint32_t *len)
+{
+   *len = (uint32_t)strlen(s);
+   return strdup(s);
+}
+
+static int test_value_provider(void *data, struct rmsgpack_dom_value *out)
+{
+   char name[64];
+   struct rmsgpack_dom_pair *items = NULL;
+   unsigned *next                  = (unsigned*)data;
+   uint32_t crc;
+
+   if (*next > TEST_KNOWN)
+      return 1;
+
+   if (*next == TEST_KNOWN)
+      strlcpy(name, "Test Disc", sizeof(name));
+   else
+      snprintf(name, sizeof(name), "Test Game %02u", *next);
+   crc   = test_crcs[*next];
+
+   items = (struct rmsgpack_dom_pair*)calloc(2, sizeof(*items));
+
+   items[0].key.type                 = RDT_STRING;
+   items[0].key.val.string.buff      = test_strdup_len("name",
+         &items[0].key.val.string.len);
+   items[0].value.type               = RDT_STRING;
+   items[0].value.val.string.buff    = test_strdup_len(name,
+         &items[0].value.val.string.len);
+
+   items[1].key.type                 = RDT_STRING;
+   items[1].key.val.string.buff      = test_strdup_len("crc",
+         &items[1].key.val.string.len);
+   items[1].value.type               = RDT_BINARY;
+   items[1].value.val.binary.len     = 4;
+   items[1].value.val.binary.buff    = (char*)malloc(4);
+   items[1].value.val.binary.buff[0] = (char)(crc >> 24);
+   items[1].value.val.binary.buff[1] = (char)(crc >> 16);
+   items[1].value.val.binary.buff[2] = (char)(crc >>  8);
+   items[1].value.val.binary.buff[3] = (char)(crc >>  0);
+
+   out->type          = RDT_MAP;
+   out->val.map.len   = 2;
+   out->val.map.items = items;
+
+   (*next)++;
+   return 0;
+}
+
+static bool test_write_database(void)
+{
+   int rv;
+   unsigned next = 0;
+   RFILE *fd     = filestream_open(TEST_DB_DIR "/" TEST_SYSTEM ".rdb",
+         RETRO_VFS_FILE_ACCESS_WRITE,
+         RETRO_VFS_FILE_ACCESS_HINT_NONE);
+
+   TEST_CHECK(fd);
+   rv = libretrodb_create(fd, test_value_provider, &next);
+   filestream_close(fd);
+   TEST_CHECK(rv >= 0);
+
+   return true;
+}
+
+static void test_scan_cb(retro_task_t *task,
+      void *task_data, void *user_data, const char *err)
+{
+   test_done = true;
+}
+
+static bool test_scan(void)
+{
+   size_t i;
+   unsigned found[TEST_KNOWN + 1];
+   playlist_config_t config;
+   playlist_t *playlist = NULL;
+
+   test_done = false;
+   TEST_CHECK(task_push_dbscan(TEST_PLAYLIST_DIR, TEST_DB_DIR,
+            TEST_CONTENT_DIR, true, false, test_scan_cb));
+   while (!test_done)
+      task_queue_check();
+
+   memset(&config, 0, sizeof(config));
+   config.capacity = 1000;
+   playlist_config_set_path(&config,
+         TEST_PLAYLIST_DIR "/" TEST_SYSTEM ".lpl");
+   TEST_CHECK(playlist = playlist_init(&config));
+
+   memset(found, 0, sizeof(found));
+   for (i = 0; i < playlist_size(playlist); i++)
+   {
+      unsigned n;
+      char expected[PATH_MAX_LENGTH];
+      const struct playlist_entry *entry = NULL;
+
+      playlist_get_index(playlist, i, &entry);
+      TEST_CHECK(entry && entry->path && entry->label);
+
+      if (string_is_equal(entry->label, "Test Disc"))
+      {
+         TEST_CHECK(string_is_equal(path_basename(entry->path),
+                  "disc.cue"));
+         found[TEST_KNOWN]++;
+         continue;
+      }
+
+      TEST_CHECK(sscanf(entry->label, "Test Game %u", &n) == 1);
+      TEST_CHECK(n < TEST_KNOWN);
+      snprintf(expected, sizeof(expected), "game%02u.bin", n);
+      TEST_CHECK(string_is_equal(path_basename(entry->path), expected));
+      found[n]++;
+   }
+
+   for (i = 0; i <= TEST_KNOWN; i++)
+      TEST_CHECK(found[i] == 1);
+   TEST_CHECK(playlist_size(playlist) == TEST_KNOWN + 1);
+
+   playlist_free(playlist);
+   return true;
+}
+
+static void test_remove_dir(const char *dir)
+{
+   unsigned i;
+   char path[PATH_MAX_LENGTH];
+
+   for (i = 0; i < TEST_KNOWN + TEST_UNKNOWN; i++)
+   {
+      snprintf(path, sizeof(path), "%s/game%02u.bin", dir, i);
+      filestream_delete(path);
+   }
+}
+
+int main(int argc, char *argv[])
+{
+   bool ok = true;
+
+   path_mkdir(TEST_CONTENT_DIR);
+   path_mkdir(TEST_DB_DIR);
+   path_mkdir(TEST_PLAYLIST_DIR);
+
+   task_queue_init(true, NULL);
+
+   ok = test_write_content()  && ok;
+   ok = test_write_database() && ok;
+   /* Twice: the second scan finds the index the first one left */
+   ok = ok && test_scan();
+   filestream_delete(TEST_PLAYLIST_DIR "/" TEST_SYSTEM ".lpl");
+   ok = ok && test_scan();
+
+   task_queue_deinit();
+
+   test_remove_dir(TEST_CONTENT_DIR);
+   filestream_delete(TEST_CONTENT_DIR "/disc.bin");
+   filestream_delete(TEST_CONTENT_DIR "/disc.cue");
+   filestream_delete(TEST_DB_DIR "/" TEST_SYSTEM ".rdb");
+   filestream_delete(TEST_DB_DIR "/content_database.idx");
+   filestream_delete(TEST_PLAYLIST_DIR "/" TEST_SYSTEM ".lpl");
+   filestream_delete(TEST_CONTENT_DIR);
+   filestream_delete(TEST_DB_DIR);
+   filestream_delete(TEST_PLAYLIST_DIR);
+   filestream_delete(TEST_DIR);
+
+   printf("%s\n", ok ? "ok" : "FAILED");
+   return ok ? 0 : 1;
+}
@@ -425,6 +425,7 @@ void *task_push_get_core_updater_list(
 
    /* Configure task */
    task->handler          = task_core_updater_get_list_handler;
+   task->task_class       = TASK_CLASS_IO;
    task->state            = list_handle;
    task->mute             = mute;
    task->title            = strdup(msg_hash_to_str(MSG_FETCHING_CORE_LIST));
@@ -1049,6 +1050,7 @@ void *task_push_core_updater_download(
    strlcat(task_title, download_handle->display_name, sizeof(task_title));
 
    task->handler          = task_core_updater_download_handler;
+   task->task_class       = TASK_CLASS_IO;
    task->state            = download_handle;
    task->mute             = mute;
    task->title            = strdup(task_title);
@@ -1450,6 +1452,7 @@ void task_push_update_installed_cores(
 
    /* Configure task */
    task->handler          = task_update_installed_cores_handler;
+   task->task_class       = TASK_CLASS_IO;
    task->state            = update_installed_handle;
    task->title            = strdup(msg_hash_to_str(MSG_FETCHING_CORE_LIST));
    task->alternative_look = true;
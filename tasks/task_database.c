@@ -27,10 +27,17 @@
 #include <streams/file_stream.h>
 #include <streams/chd_stream.h>
 #include <streams/interface_stream.h>
+#include <file/nbio.h>
+#ifdef HAVE_THREADS
+#include <rthreads/rthreads.h>
+#include <rthreads/tpool.h>
+#include <features/features_cpu.h>
+#endif
 #include "tasks_internal.h"
 
 #include "../core_info.h"
 #include "../database_info.h"
+#include "../libretro-db/rdb_index.h"
 
 #include "../file_path_special.h"
 #include "../msg_hash.h"
@@ -43,6 +50,10 @@
 #endif
 #include "../verbosity.h"
 
+/* Maximum number of items a single index probe may
+ * resolve to (duplicate CRCs/serials in one database) */
+#define DATABASE_INDEX_MAX_MATCHES 16
+
 typedef struct database_state_handle
 {
    uint32_t crc;
@@ -54,8 +65,48 @@ typedef struct database_state_handle
    char serial[4096];
    database_info_list_t *info;
    struct string_list *list;
+   rdb_index_t *index;
 } database_state_handle_t;
 
+#ifdef HAVE_THREADS
+/* Number of files hashed ahead of the
+ * matching stage, per hashing thread */
+#define DATABASE_SCAN_WINDOW_PER_THREAD 4
+
+struct database_scan_pipeline;
+
+/* Result of hashing one entry of the scan list */
+typedef struct database_scan_slot
+{
+   struct database_scan_pipeline *pipeline;
+   char *path;
+   char *serial;
+   uint32_t crc;
+   uint32_t archive_crc;
+   int ret;
+   enum database_type type;
+   bool dispatched;
+   bool done;
+} database_scan_slot_t;
+
+/* Hashing stage of the scanner.
+ *
+ * Entries of the scan list are handed to the thread pool
+ * in list order, at most 'window' ahead of the entry the
+ * matching stage is processing. The matching stage (task
+ * handler) consumes the results in list order, so that
+ * playlist writes and progress reporting stay sequential. */
+typedef struct database_scan_pipeline
+{
+   tpool_t *pool;
+   slock_t *lock;
+   scond_t *cond;
+   database_scan_slot_t *slots;
+   size_t window;
+   size_t next;
+} database_scan_pipeline_t;
+#endif
+
 typedef struct db_handle
 {
    playlist_config_t playlist_config;
@@ -64,11 +115,16 @@ typedef struct db_handle
    bool scan_without_core_match;
    bool show_hidden_files;
    unsigned status;
+   unsigned hash_threads;
    char *playlist_directory;
    char *content_database_path;
+   char *index_path;
    char *fullpath;
    database_info_handle_t *handle;
    database_state_handle_t state;
+#ifdef HAVE_THREADS
+   database_scan_pipeline_t *pipeline;
+#endif
 } db_handle_t;
 
 /* Forward declarations */
@@ -192,60 +248,19 @@ static bool intfstream_file_get_serial(const char *name,
       uint64_t offset, uint64_t size, char *serial)
 {
    int rv;
-   uint8_t *data     = NULL;
-   int64_t file_size = -1;
-   intfstream_t *fd  = intfstream_open_file(name,
-         RETRO_VFS_FILE_ACCESS_READ, RETRO_VFS_FILE_ACCESS_HINT_NONE);
+   /* Detection only reads a few sectors, so read them
+    * from the track in place instead of copying it */
+   intfstream_t *fd = intfstream_open_file_range(name,
+         RETRO_VFS_FILE_ACCESS_READ, RETRO_VFS_FILE_ACCESS_HINT_NONE,
+         offset, size);
 
    if (!fd)
       return 0;
 
-   if (intfstream_seek(fd, 0, SEEK_END) == -1)
-      goto error;
-
-   file_size = intfstream_tell(fd);
-
-   if (intfstream_seek(fd, 0, SEEK_SET) == -1)
-      goto error;
-
-   if (file_size < 0)
-      goto error;
-
-   if (offset != 0 || size < (uint64_t) file_size)
-   {
-      if (intfstream_seek(fd, (int64_t)offset, SEEK_SET) == -1)
-         goto error;
-
-      data = (uint8_t*)malloc((size_t)size);
-
-      if (intfstream_read(fd, data, size) != (int64_t) size)
-      {
-         free(data);
-         goto error;
-      }
-
-      intfstream_close(fd);
-      free(fd);
-      fd = intfstream_open_memory(data, RETRO_VFS_FILE_ACCESS_READ,
-            RETRO_VFS_FILE_ACCESS_HINT_NONE,
-            size);
-      if (!fd)
-      {
-         free(data);
-         return 0;
-      }
-   }
-
    rv = intfstream_get_serial(fd, serial);
    intfstream_close(fd);
    free(fd);
-   free(data);
    return rv;
-
-error:
-   intfstream_close(fd);
-   free(fd);
-   return 0;
 }
 
 static int task_database_cue_get_serial(const char *name, char* serial)
@@ -327,59 +342,51 @@ static bool intfstream_file_get_crc(const char *name,
       uint64_t offset, size_t size, uint32_t *crc)
 {
    bool rv;
-   intfstream_t *fd  = intfstream_open_file(name,
-         RETRO_VFS_FILE_ACCESS_READ, RETRO_VFS_FILE_ACCESS_HINT_NONE);
-   uint8_t *data     = NULL;
-   int64_t file_size = -1;
+   intfstream_t *fd  = NULL;
 
-   if (!fd)
-      return 0;
+   /* Hash straight out of the page cache when files can be
+    * memory mapped, otherwise stream the range through a
+    * fixed-size buffer. Neither holds the content in memory. */
+   if (nbio_is_memory_mapped())
+   {
+      void *handle = nbio_open(name, NBIO_READ);
 
-   if (intfstream_seek(fd, 0, SEEK_END) == -1)
-      goto error;
+      if (handle)
+      {
+         size_t len          = 0;
+         const uint8_t *data = NULL;
 
-   file_size = intfstream_tell(fd);
+         nbio_begin_read(handle);
+         while (!nbio_iterate(handle));
 
-   if (intfstream_seek(fd, 0, SEEK_SET) == -1)
-      goto error;
+         data = (const uint8_t*)nbio_get_ptr(handle, &len);
 
-   if (file_size < 0)
-      goto error;
+         if ((data || len == 0) && offset <= len)
+         {
+            size_t avail = len - (size_t)offset;
 
-   if (offset != 0 || size < (uint64_t) file_size)
-   {
-      if (intfstream_seek(fd, (int64_t)offset, SEEK_SET) == -1)
-         goto error;
+            if (size < avail)
+               avail = size;
 
-      data = (uint8_t*)malloc(size);
+            *crc = encoding_crc32(0, data + offset, avail);
+            nbio_free(handle);
+            return 1;
+         }
 
-      if (intfstream_read(fd, data, size) != (int64_t) size)
-         goto error;
+         nbio_free(handle);
+      }
+   }
 
-      intfstream_close(fd);
-      free(fd);
-      fd = intfstream_open_memory(data, RETRO_VFS_FILE_ACCESS_READ,
-            RETRO_VFS_FILE_ACCESS_HINT_NONE, size);
+   fd = intfstream_open_file(name,
+         RETRO_VFS_FILE_ACCESS_READ, RETRO_VFS_FILE_ACCESS_HINT_NONE);
 
-      if (!fd)
-         goto error;
-   }
+   if (!fd)
+      return 0;
 
-   rv = intfstream_get_crc(fd, crc);
+   rv = intfstream_get_crc_range(fd, offset, size, crc);
    intfstream_close(fd);
    free(fd);
-   free(data);
    return rv;
-
-error:
-   if (fd)
-   {
-      intfstream_close(fd);
-      free(fd);
-   }
-   if (data)
-      free(data);
-   return 0;
 }
 
 static int task_database_cue_get_crc(const char *name, uint32_t *crc)
@@ -576,73 +583,282 @@ static enum msg_file_type extension_to_file_type(const char *ext)
    return FILE_TYPE_NONE;
 }
 
-static int task_database_iterate_playlist(
-      database_state_handle_t *db_state,
-      database_info_handle_t *db, const char *name)
+/* Detects the lookup type of a content file and computes
+ * the CRC32 and/or serial it should be matched with.
+ * Does not touch the scan state, so it may run on any thread. */
+static int task_database_hash_file(const char *name,
+      enum database_type *type,
+      uint32_t *crc, uint32_t *archive_crc, char *serial)
 {
    switch (extension_to_file_type(path_get_extension(name)))
    {
       case FILE_TYPE_COMPRESSED:
 #ifdef HAVE_COMPRESSION
-         db->type = DATABASE_TYPE_CRC_LOOKUP;
+         *type = DATABASE_TYPE_CRC_LOOKUP;
          /* first check crc of archive itself */
          return intfstream_file_get_crc(name,
-               0, SIZE_MAX, &db_state->archive_crc);
+               0, SIZE_MAX, archive_crc);
 #else
          break;
 #endif
       case FILE_TYPE_CUE:
-         task_database_cue_prune(db, name);
-         db_state->serial[0] = '\0';
-         if (task_database_cue_get_serial(name, db_state->serial))
-            db->type = DATABASE_TYPE_SERIAL_LOOKUP;
+         serial[0] = '\0';
+         if (task_database_cue_get_serial(name, serial))
+            *type = DATABASE_TYPE_SERIAL_LOOKUP;
          else
          {
-            db->type = DATABASE_TYPE_CRC_LOOKUP;
-            return task_database_cue_get_crc(name, &db_state->crc);
+            *type = DATABASE_TYPE_CRC_LOOKUP;
+            return task_database_cue_get_crc(name, crc);
          }
          break;
       case FILE_TYPE_GDI:
-         gdi_prune(db, name);
-         db_state->serial[0] = '\0';
+         serial[0] = '\0';
          /* There are no serial databases, so don't bother with
             serials at the moment */
-         if (0 && task_database_gdi_get_serial(name, db_state->serial))
-            db->type = DATABASE_TYPE_SERIAL_LOOKUP;
+         if (0 && task_database_gdi_get_serial(name, serial))
+            *type = DATABASE_TYPE_SERIAL_LOOKUP;
          else
          {
-            db->type = DATABASE_TYPE_CRC_LOOKUP;
-            return task_database_gdi_get_crc(name, &db_state->crc);
+            *type = DATABASE_TYPE_CRC_LOOKUP;
+            return task_database_gdi_get_crc(name, crc);
          }
          break;
       /* Consider Wii WBFS files similar to ISO files. */
       case FILE_TYPE_WBFS:
       case FILE_TYPE_ISO:
-         db_state->serial[0] = '\0';
-         intfstream_file_get_serial(name, 0, SIZE_MAX, db_state->serial);
-         db->type            =  DATABASE_TYPE_SERIAL_LOOKUP;
+         serial[0] = '\0';
+         intfstream_file_get_serial(name, 0, SIZE_MAX, serial);
+         *type     = DATABASE_TYPE_SERIAL_LOOKUP;
          break;
       case FILE_TYPE_CHD:
-         db_state->serial[0] = '\0';
-         if (task_database_chd_get_serial(name, db_state->serial))
-            db->type         = DATABASE_TYPE_SERIAL_LOOKUP;
+         serial[0] = '\0';
+         if (task_database_chd_get_serial(name, serial))
+            *type  = DATABASE_TYPE_SERIAL_LOOKUP;
          else
          {
-            db->type         = DATABASE_TYPE_CRC_LOOKUP;
-            return task_database_chd_get_crc(name, &db_state->crc);
+            *type  = DATABASE_TYPE_CRC_LOOKUP;
+            return task_database_chd_get_crc(name, crc);
          }
          break;
       case FILE_TYPE_LUTRO:
-         db->type            = DATABASE_TYPE_ITERATE_LUTRO;
+         *type     = DATABASE_TYPE_ITERATE_LUTRO;
          break;
       default:
-         db->type            = DATABASE_TYPE_CRC_LOOKUP;
-         return intfstream_file_get_crc(name, 0, SIZE_MAX, &db_state->crc);
+         *type     = DATABASE_TYPE_CRC_LOOKUP;
+         return intfstream_file_get_crc(name, 0, SIZE_MAX, crc);
    }
 
    return 1;
 }
 
+static void task_database_prune(database_info_handle_t *db,
+      const char *name)
+{
+   switch (extension_to_file_type(path_get_extension(name)))
+   {
+      case FILE_TYPE_CUE:
+         task_database_cue_prune(db, name);
+         break;
+      case FILE_TYPE_GDI:
+         gdi_prune(db, name);
+         break;
+      default:
+         break;
+   }
+}
+
+static int task_database_iterate_playlist(
+      database_state_handle_t *db_state,
+      database_info_handle_t *db, const char *name)
+{
+   task_database_prune(db, name);
+   return task_database_hash_file(name, &db->type,
+         &db_state->crc, &db_state->archive_crc, db_state->serial);
+}
+
+#ifdef HAVE_THREADS
+static void task_database_scan_worker(void *data)
+{
+   char serial[4096];
+   database_scan_slot_t *slot          = (database_scan_slot_t*)data;
+   database_scan_pipeline_t *pipeline  = slot->pipeline;
+   enum database_type type             = DATABASE_TYPE_NONE;
+   uint32_t crc                        = 0;
+   uint32_t archive_crc                = 0;
+   int ret;
+
+   serial[0] = '\0';
+   ret       = task_database_hash_file(slot->path, &type,
+         &crc, &archive_crc, serial);
+
+   slock_lock(pipeline->lock);
+   slot->type        = type;
+   slot->crc         = crc;
+   slot->archive_crc = archive_crc;
+   slot->ret         = ret;
+   if (!string_is_empty(serial))
+      slot->serial   = strdup(serial);
+   slot->done        = true;
+   scond_broadcast(pipeline->cond);
+   slock_unlock(pipeline->lock);
+}
+
+static void task_database_scan_slot_clear(database_scan_slot_t *slot)
+{
+   if (slot->path)
+      free(slot->path);
+   if (slot->serial)
+      free(slot->serial);
+   slot->path        = NULL;
+   slot->serial      = NULL;
+   slot->crc         = 0;
+   slot->archive_crc = 0;
+   slot->ret         = 0;
+   slot->type        = DATABASE_TYPE_NONE;
+   slot->dispatched  = false;
+   slot->done        = false;
+}
+
+static void task_database_scan_pipeline_free(
+      database_scan_pipeline_t *pipeline)
+{
+   size_t i;
+
+   if (!pipeline)
+      return;
+
+   /* Waits for in-flight work and discards the rest */
+   if (pipeline->pool)
+      tpool_destroy(pipeline->pool);
+
+   if (pipeline->slots)
+   {
+      for (i = 0; i < pipeline->window; i++)
+         task_database_scan_slot_clear(&pipeline->slots[i]);
+      free(pipeline->slots);
+   }
+
+   if (pipeline->cond)
+      scond_free(pipeline->cond);
+   if (pipeline->lock)
+      slock_free(pipeline->lock);
+
+   free(pipeline);
+}
+
+static database_scan_pipeline_t *task_database_scan_pipeline_new(
+      unsigned threads)
+{
+   size_t i;
+   database_scan_pipeline_t *pipeline = NULL;
+
+   if (threads == 0)
+      threads = cpu_features_get_core_amount();
+   if (threads == 0)
+      threads = 1;
+
+   pipeline = (database_scan_pipeline_t*)calloc(1, sizeof(*pipeline));
+   if (!pipeline)
+      return NULL;
+
+   pipeline->window = threads * DATABASE_SCAN_WINDOW_PER_THREAD;
+   pipeline->pool   = tpool_create(threads);
+   pipeline->lock   = slock_new();
+   pipeline->cond   = scond_new();
+   pipeline->slots  = (database_scan_slot_t*)
+      calloc(pipeline->window, sizeof(*pipeline->slots));
+
+   if (!pipeline->pool || !pipeline->lock
+         || !pipeline->cond || !pipeline->slots)
+   {
+      task_database_scan_pipeline_free(pipeline);
+      return NULL;
+   }
+
+   for (i = 0; i < pipeline->window; i++)
+      pipeline->slots[i].pipeline = pipeline;
+
+   return pipeline;
+}
+
+/* Hands list entries [next, list_ptr + window) to the hashing
+ * workers. Entries appended to the list while scanning (archive
+ * contents) are picked up as the window moves forward. */
+static void task_database_scan_pipeline_fill(
+      database_scan_pipeline_t *pipeline,
+      database_info_handle_t *db)
+{
+   if (pipeline->next < db->list_ptr)
+      pipeline->next = db->list_ptr;
+
+   while (     pipeline->next < db->list->size
+         &&    pipeline->next < db->list_ptr + pipeline->window)
+   {
+      const char *path           = db->list->elems[pipeline->next].data;
+      database_scan_slot_t *slot = &pipeline->slots[
+         pipeline->next % pipeline->window];
+
+      /* The previous user of this slot was never consumed */
+      slock_lock(pipeline->lock);
+      while (slot->dispatched && !slot->done)
+         scond_wait(pipeline->cond, pipeline->lock);
+      slock_unlock(pipeline->lock);
+
+      task_database_scan_slot_clear(slot);
+
+      /* Archive members are looked up by the CRC stored
+       * in the archive, so there is nothing to hash */
+      if (path && !path_contains_compressed_file(path))
+      {
+         slot->path       = strdup(path);
+         slot->dispatched = true;
+         if (!tpool_add_work(pipeline->pool,
+                  task_database_scan_worker, slot))
+            task_database_scan_slot_clear(slot);
+      }
+
+      pipeline->next++;
+   }
+}
+
+/* Waits for the hashing result of the current list entry
+ * and loads it into the scan state.
+ *
+ * Returns: -1 if the entry was not hashed by the pipeline,
+ * otherwise the result of task_database_hash_file(). */
+static int task_database_scan_pipeline_take(
+      database_scan_pipeline_t *pipeline,
+      database_state_handle_t *db_state,
+      database_info_handle_t *db, const char *name)
+{
+   int ret;
+   database_scan_slot_t *slot = NULL;
+
+   task_database_scan_pipeline_fill(pipeline, db);
+
+   slot = &pipeline->slots[db->list_ptr % pipeline->window];
+
+   if (!slot->dispatched || !string_is_equal(slot->path, name))
+      return -1;
+
+   slock_lock(pipeline->lock);
+   while (!slot->done)
+      scond_wait(pipeline->cond, pipeline->lock);
+   slock_unlock(pipeline->lock);
+
+   db->type              = slot->type;
+   db_state->crc         = slot->crc;
+   db_state->archive_crc = slot->archive_crc;
+   strlcpy(db_state->serial, slot->serial ? slot->serial : "",
+         sizeof(db_state->serial));
+   ret                   = slot->ret;
+
+   task_database_scan_slot_clear(slot);
+
+   return ret;
+}
+#endif
+
 static int database_info_list_iterate_end_no_match(
       database_info_handle_t *db,
       database_state_handle_t *db_state,
@@ -724,6 +940,21 @@ static int database_info_list_iterate_new(database_state_handle_t *db_state,
    return 0;
 }
 
+static int database_info_list_iterate_new_at(
+      database_state_handle_t *db_state,
+      const uint64_t *offsets, size_t count)
+{
+   const char *new_database = database_info_get_current_name(db_state);
+
+   if (db_state->info)
+   {
+      database_info_list_free(db_state->info);
+      free(db_state->info);
+   }
+   db_state->info = database_info_list_new_at(new_database, offsets, count);
+   return 0;
+}
+
 static int database_info_list_iterate_found_match(
       db_handle_t *_db,
       database_state_handle_t *db_state,
@@ -923,11 +1154,33 @@ static int task_database_iterate_crc_lookup(
          }
       }
 
-      snprintf(query, sizeof(query),
-            "{crc:or(b\"%08X\",b\"%08X\")}",
-            db_state->crc, db_state->archive_crc);
+      if (db_state->index)
+      {
+         uint64_t offsets[DATABASE_INDEX_MAX_MATCHES];
+         unsigned db_num = (unsigned)
+            db_state->list->elems[db_state->list_index].attr.i;
+         size_t count    = rdb_index_find_crc(db_state->index,
+               db_num, db_state->crc,
+               offsets, DATABASE_INDEX_MAX_MATCHES);
+
+         if (db_state->archive_crc)
+            count       += rdb_index_find_crc(db_state->index,
+                  db_num, db_state->archive_crc,
+                  offsets + count, DATABASE_INDEX_MAX_MATCHES - count);
+
+         if (count == 0)
+            return database_info_list_iterate_next(db_state);
 
-      database_info_list_iterate_new(db_state, query);
+         database_info_list_iterate_new_at(db_state, offsets, count);
+      }
+      else
+      {
+         snprintf(query, sizeof(query),
+               "{crc:or(b\"%08X\",b\"%08X\")}",
+               db_state->crc, db_state->archive_crc);
+
+         database_info_list_iterate_new(db_state, query);
+      }
    }
 
    if (db_state->info)
@@ -1049,7 +1302,19 @@ static int task_database_iterate_serial_lookup(
       )
       return database_info_list_iterate_end_no_match(db, db_state, name);
 
-   if (db_state->entry_index == 0)
+   if (db_state->entry_index == 0 && db_state->index)
+   {
+      uint64_t offsets[DATABASE_INDEX_MAX_MATCHES];
+      size_t count = rdb_index_find_serial(db_state->index,
+            (unsigned)db_state->list->elems[db_state->list_index].attr.i,
+            db_state->serial, offsets, DATABASE_INDEX_MAX_MATCHES);
+
+      if (count == 0)
+         return database_info_list_iterate_next(db_state);
+
+      database_info_list_iterate_new_at(db_state, offsets, count);
+   }
+   else if (db_state->entry_index == 0)
    {
       char query[50];
       char *serial_buf = bin_to_hex_alloc(
@@ -1112,6 +1377,15 @@ static int task_database_iterate(
    switch (db->type)
    {
       case DATABASE_TYPE_ITERATE:
+#ifdef HAVE_THREADS
+         if (_db->pipeline)
+         {
+            int ret = task_database_scan_pipeline_take(
+                  _db->pipeline, db_state, db, name);
+            if (ret >= 0)
+               return ret;
+         }
+#endif
          return task_database_iterate_playlist(db_state, db, name);
       case DATABASE_TYPE_ITERATE_ARCHIVE:
 #ifdef HAVE_COMPRESSION
@@ -1145,6 +1419,31 @@ static void task_database_cleanup_state(
    db_state->buf = NULL;
 }
 
+/* Builds or loads the CRC/serial index over every database
+ * in the list. Each element's attr.i is set to its database
+ * number in the index so that it survives list reordering. */
+static void task_database_open_index(db_handle_t *db,
+      database_state_handle_t *dbstate)
+{
+   size_t i;
+   const char **paths = (const char**)malloc(
+         dbstate->list->size * sizeof(*paths));
+
+   if (!paths)
+      return;
+
+   for (i = 0; i < dbstate->list->size; i++)
+   {
+      paths[i]                        = dbstate->list->elems[i].data;
+      dbstate->list->elems[i].attr.i  = (int)i;
+   }
+
+   dbstate->index = rdb_index_open(db->index_path,
+         paths, dbstate->list->size);
+
+   free(paths);
+}
+
 static void task_database_handler(retro_task_t *task)
 {
    const char *name                 = NULL;
@@ -1198,6 +1497,9 @@ static void task_database_handler(retro_task_t *task)
                      db->show_hidden_files,
                      false, false);
 
+            if (dbstate->list)
+               task_database_open_index(db, dbstate);
+
             /* If the scan path matches a database path exactly then
              * save time by only processing that database. */
             if (dbstate->list && db->is_directory)
@@ -1238,6 +1540,23 @@ static void task_database_handler(retro_task_t *task)
                }
             }
          }
+#ifdef HAVE_THREADS
+         /* Files referenced by cue/gdi sheets must be pruned
+          * before the hashing workers get to see them. */
+         if (dbinfo->list->size > 1)
+         {
+            size_t i;
+            for (i = 0; i < dbinfo->list->size; i++)
+            {
+               const char *path = dbinfo->list->elems[i].data;
+               if (path)
+                  task_database_prune(dbinfo, path);
+            }
+
+            db->pipeline = task_database_scan_pipeline_new(
+                  db->hash_threads);
+         }
+#endif
          dbinfo->status = DATABASE_STATUS_ITERATE_START;
          break;
       case DATABASE_STATUS_ITERATE_START:
@@ -1302,10 +1621,20 @@ task_finished:
    if (task)
       task_set_finished(task, true);
 
+#ifdef HAVE_THREADS
+   if (db)
+   {
+      task_database_scan_pipeline_free(db->pipeline);
+      db->pipeline = NULL;
+   }
+#endif
+
    if (dbstate)
    {
       if (dbstate->list)
          dir_list_free(dbstate->list);
+      rdb_index_free(dbstate->index);
+      dbstate->index = NULL;
    }
 
    if (db)
@@ -1314,6 +1643,8 @@ task_finished:
          free(db->playlist_directory);
       if (!string_is_empty(db->content_database_path))
          free(db->content_database_path);
+      if (!string_is_empty(db->index_path))
+         free(db->index_path);
       if (!string_is_empty(db->fullpath))
          free(db->fullpath);
       if (db->state.buf)
@@ -1345,16 +1676,27 @@ bool task_push_dbscan(
       bool db_dir_show_hidden_files,
       retro_task_callback_t cb)
 {
+   char index_path[PATH_MAX_LENGTH];
    retro_task_t *t                         = task_init();
 #ifdef RARCH_INTERNAL
    settings_t *settings                    = config_get_ptr();
+   const char *index_dir                   =
+      !string_is_empty(settings->paths.directory_cache)
+      ? settings->paths.directory_cache : content_database;
+#else
+   const char *index_dir                   = content_database;
 #endif
    db_handle_t *db                         = (db_handle_t*)calloc(1, sizeof(db_handle_t));
 
+   index_path[0]                           = '\0';
+
    if (!t || !db)
       goto error;
 
    t->handler                              = task_database_handler;
+   t->task_class                           = TASK_CLASS_CPU;
+   t->priority                             = TASK_PRIORITY_LOW;
+   t->non_reentrant                        = true;
    t->state                                = db;
    t->callback                             = cb;
    t->title                                = strdup(msg_hash_to_str(
@@ -1364,15 +1706,18 @@ bool task_push_dbscan(
 #ifdef RARCH_INTERNAL
    t->progress_cb                          = task_database_progress_cb;
    db->scan_without_core_match             = settings->bools.scan_without_core_match;
+   db->hash_threads                        = settings->uints.scan_hash_threads;
    db->playlist_config.capacity            = COLLECTION_SIZE;
    db->playlist_config.old_format          = settings->bools.playlist_use_old_format;
    db->playlist_config.compress            = settings->bools.playlist_compression;
    db->playlist_config.fuzzy_archive_match = settings->bools.playlist_fuzzy_archive_match;
+   db->playlist_config.binary_cache        = settings->bools.playlist_binary_cache;
 #else
    db->playlist_config.capacity            = COLLECTION_SIZE;
    db->playlist_config.old_format          = false;
    db->playlist_config.compress            = false;
    db->playlist_config.fuzzy_archive_match = false;
+   db->playlist_config.binary_cache        = false;
 #endif
    db->show_hidden_files                   = db_dir_show_hidden_files;
    db->is_directory                        = directory;
@@ -1380,6 +1725,13 @@ bool task_push_dbscan(
    db->playlist_directory                  = strdup(playlist_directory);
    db->content_database_path               = strdup(content_database);
 
+   if (!string_is_empty(index_dir))
+   {
+      fill_pathname_join(index_path, index_dir,
+            "content_database.idx", sizeof(index_path));
+      db->index_path                       = strdup(index_path);
+   }
+
    task_queue_push(t);
 
    return true;
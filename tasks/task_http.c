@@ -301,6 +301,7 @@ static void* task_push_http_transfer_generic(
       goto error;
 
    t->handler              = task_http_transfer_handler;
+   t->task_class           = TASK_CLASS_IO;
    t->state                = http;
    t->mute                 = mute;
    t->callback             = cb;
@@ -50,7 +50,9 @@ struct nbio_image_handle
    unsigned frame_duration;
    size_t size;
    unsigned upscale_threshold;
+   uint64_t cache_key;
    void *handle;
+   gfx_thumbnail_cache_t *cache;
    transfer_cb_t  cb;
    struct texture_image ti;
 };
@@ -366,6 +368,12 @@ bool task_image_load_handler(retro_task_t *task)
             }
          }
 
+         /* Keep the final image, so that the next load of the
+          * same file can skip decoding */
+         if (image->cache)
+            gfx_thumbnail_cache_store(image->cache,
+                  image->cache_key, &image->ti);
+
          img->width         = image->ti.width;
          img->height        = image->ti.height;
          img->pixels        = image->ti.pixels;
@@ -380,9 +388,48 @@ bool task_image_load_handler(retro_task_t *task)
    return true;
 }
 
+/* Loads an image from the thumbnail cache instead of decoding
+ * the source file */
+static void task_image_cache_load_handler(retro_task_t *task)
+{
+   nbio_handle_t            *nbio  = (nbio_handle_t*)task->state;
+   struct nbio_image_handle *image = (struct nbio_image_handle*)nbio->data;
+   struct texture_image *img       = NULL;
+
+   if (task_get_cancelled(task))
+   {
+      task_set_finished(task, true);
+      return;
+   }
+
+   img = (struct texture_image*)malloc(sizeof(struct texture_image));
+
+   if (img && gfx_thumbnail_cache_load(image->cache, image->cache_key, img))
+   {
+      task_set_data(task, img);
+      task_set_finished(task, true);
+      return;
+   }
+
+   /* Evicted or damaged since the lookup, so decode the
+    * source file after all (which stores it again) */
+   if (img)
+      free(img);
+   task->handler = task_file_load_handler;
+}
+
 bool task_push_image_load(const char *fullpath, 
       bool supports_rgba, unsigned upscale_threshold,
       retro_task_callback_t cb, void *user_data)
+{
+   return task_push_image_load_cached(fullpath, supports_rgba,
+         upscale_threshold, NULL, cb, user_data);
+}
+
+bool task_push_image_load_cached(const char *fullpath,
+      bool supports_rgba, unsigned upscale_threshold,
+      gfx_thumbnail_cache_t *cache,
+      retro_task_callback_t cb, void *user_data)
 {
    nbio_handle_t             *nbio   = NULL;
    struct nbio_image_handle   *image = NULL;
@@ -431,6 +478,10 @@ bool task_push_image_load(const char *fullpath,
    image->frame_duration             = 0;
    image->size                       = 0;
    image->upscale_threshold          = upscale_threshold;
+   image->cache_key                  = cache
+      ? gfx_thumbnail_cache_key(fullpath, upscale_threshold, supports_rgba)
+      : 0;
+   image->cache                      = image->cache_key ? cache : NULL;
    image->handle                     = NULL;
 
    image->ti.width                   = 0;
@@ -461,8 +512,13 @@ bool task_push_image_load(const char *fullpath,
    nbio->data          = (struct nbio_image_handle*)image;
 
    t->state           = nbio;
-   t->handler         = task_file_load_handler;
+   t->handler         = gfx_thumbnail_cache_contains(
+         image->cache, image->cache_key)
+      ? task_image_cache_load_handler
+      : task_file_load_handler;
    t->cleanup         = task_image_load_free;
+   t->task_class      = TASK_CLASS_LATENCY;
+   t->priority        = TASK_PRIORITY_HIGH;
    t->callback        = cb;
    t->user_data       = user_data;
 
@@ -505,6 +505,9 @@ bool task_push_manual_content_scan(
 
    /* > Configure task */
    task->handler                 = task_manual_content_scan_handler;
+   task->task_class              = TASK_CLASS_CPU;
+   task->priority                = TASK_PRIORITY_LOW;
+   task->non_reentrant           = true;
    task->state                   = manual_scan;
    task->title                   = strdup(task_title);
    task->alternative_look        = true;
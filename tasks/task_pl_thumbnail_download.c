@@ -537,6 +537,7 @@ bool task_push_pl_thumbnail_download(
    
    /* Configure task */
    task->handler                 = task_pl_thumbnail_download_handler;
+   task->task_class              = TASK_CLASS_IO;
    task->state                   = pl_thumb;
    task->title                   = strdup(system);
    task->alternative_look        = true;
@@ -867,6 +868,7 @@ bool task_push_pl_entry_thumbnail_download(
    
    /* Configure task */
    task->handler                 = task_pl_entry_thumbnail_download_handler;
+   task->task_class              = TASK_CLASS_IO;
    task->state                   = pl_thumb;
    task->title                   = strdup(system);
    task->alternative_look        = true;
@@ -750,6 +750,8 @@ static bool task_push_undo_save_state(const char *path, void *data, size_t size)
    task->type                    = TASK_TYPE_BLOCKING;
    task->state                   = state;
    task->handler                 = task_save_handler;
+   task->task_class              = TASK_CLASS_LATENCY;
+   task->priority                = TASK_PRIORITY_HIGH;
    task->callback                = undo_save_state_cb;
    task->title                   = strdup(msg_hash_to_str(MSG_UNDOING_SAVE_STATE));
 
@@ -1145,6 +1147,8 @@ static void task_push_save_state(const char *path, void *data, size_t size, bool
    task->type              = TASK_TYPE_BLOCKING;
    task->state             = state;
    task->handler           = task_save_handler;
+   task->task_class        = TASK_CLASS_LATENCY;
+   task->priority          = TASK_PRIORITY_HIGH;
    task->callback          = save_state_cb;
    task->title             = strdup(msg_hash_to_str(MSG_SAVING_STATE));
    task->mute              = state->mute;
@@ -1251,6 +1255,8 @@ static void task_push_load_and_save_state(const char *path, void *data,
    task->state       = state;
    task->type        = TASK_TYPE_BLOCKING;
    task->handler     = task_load_handler;
+   task->task_class  = TASK_CLASS_LATENCY;
+   task->priority    = TASK_PRIORITY_HIGH;
    task->callback    = content_load_and_save_state_cb;
    task->title       = strdup(msg_hash_to_str(MSG_LOADING_STATE));
    task->mute        = state->mute;
@@ -1427,6 +1433,8 @@ bool content_load_state(const char *path,
    task->type                   = TASK_TYPE_BLOCKING;
    task->state                  = state;
    task->handler                = task_load_handler;
+   task->task_class             = TASK_CLASS_LATENCY;
+   task->priority               = TASK_PRIORITY_HIGH;
    task->callback               = content_load_state_cb;
    task->title                  = strdup(msg_hash_to_str(MSG_LOADING_STATE));
 
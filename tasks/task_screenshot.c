@@ -89,6 +89,13 @@ static bool screenshot_dump_direct(screenshot_task_state_t *state)
    bool ret                       = false;
 
 #if defined(HAVE_RPNG)
+   /* Screenshots are taken mid-game, so favour speed a little
+    * over size and spread the work over every core */
+   struct rpng_encode_options options;
+
+   options.preset                 = RPNG_ENCODE_BALANCED;
+   options.threads                = 0;
+
    if (state->bgr24)
       scaler->in_fmt              = SCALER_FMT_BGR24;
    else if (state->pixel_format_type == RETRO_PIXEL_FORMAT_XRGB8888)
@@ -106,12 +113,13 @@ static bool screenshot_dump_direct(screenshot_task_state_t *state)
 
    scaler_ctx_gen_reset(&state->scaler);
 
-   ret = rpng_save_image_bgr24(
+   ret = rpng_save_image_bgr24_ex(
          state->filename,
          state->out_buffer,
          state->width,
          state->height,
-         state->width * 3
+         state->width * 3,
+         &options
          );
 
    free(state->out_buffer);
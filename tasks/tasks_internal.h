@@ -37,6 +37,9 @@
 /* Required for task_push_core_backup() */
 #include "../core_backup.h"
 
+/* Required for task_push_image_load_cached() */
+#include "../gfx/gfx_thumbnail_cache.h"
+
 RETRO_BEGIN_DECLS
 
 typedef struct nbio_buf
@@ -140,6 +143,14 @@ bool task_push_image_load(const char *fullpath,
       bool supports_rgba, unsigned upscale_threshold,
       retro_task_callback_t cb, void *userdata);
 
+/* As task_push_image_load(), but the final image is kept in
+ * 'cache' (which may be NULL), and taken from there on later
+ * loads of the same, unchanged file */
+bool task_push_image_load_cached(const char *fullpath,
+      bool supports_rgba, unsigned upscale_threshold,
+      gfx_thumbnail_cache_t *cache,
+      retro_task_callback_t cb, void *userdata);
+
 #ifdef HAVE_LIBRETRODB
 bool task_push_dbscan(
       const char *playlist_directory,
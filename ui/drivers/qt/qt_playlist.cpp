@@ -391,6 +391,7 @@ void MainWindow::addFilesToPlaylist(QStringList files)
    playlist_config.old_format          = settings->bools.playlist_use_old_format;
    playlist_config.compress            = settings->bools.playlist_compression;
    playlist_config.fuzzy_archive_match = settings->bools.playlist_fuzzy_archive_match;
+   playlist_config.binary_cache        = settings->bools.playlist_binary_cache;
 
    /* Assume a blank list means we will manually enter in all fields. */
    if (files.isEmpty())
@@ -697,6 +698,7 @@ bool MainWindow::updateCurrentPlaylistEntry(
    playlist_config.old_format          = settings->bools.playlist_use_old_format;
    playlist_config.compress            = settings->bools.playlist_compression;
    playlist_config.fuzzy_archive_match = settings->bools.playlist_fuzzy_archive_match;
+   playlist_config.binary_cache        = settings->bools.playlist_binary_cache;
 
    if (  playlistPath.isEmpty() || 
          contentHash.isEmpty()  || 
@@ -825,6 +827,7 @@ void MainWindow::onPlaylistWidgetContextMenuRequested(const QPoint&)
    playlist_config.old_format          = settings->bools.playlist_use_old_format;
    playlist_config.compress            = settings->bools.playlist_compression;
    playlist_config.fuzzy_archive_match = settings->bools.playlist_fuzzy_archive_match;
+   playlist_config.binary_cache        = settings->bools.playlist_binary_cache;
 
    if (selectedItem)
    {
@@ -1028,8 +1031,13 @@ void MainWindow::onPlaylistWidgetContextMenuRequested(const QPoint&)
       {
          if (showMessageBox(QString(msg_hash_to_str(MENU_ENUM_LABEL_VALUE_QT_CONFIRM_DELETE_PLAYLIST)).arg(selectedItem->text()), MainWindow::MSGBOX_TYPE_QUESTION_YESNO, Qt::ApplicationModal, false))
          {
+            QByteArray currentPlaylistArray = currentPlaylistFile.fileName().toUtf8();
+
             if (currentPlaylistFile.remove())
+            {
+               playlist_delete_cache_file(currentPlaylistArray.constData());
                reloadPlaylists();
+            }
             else
                showMessageBox(msg_hash_to_str(MENU_ENUM_LABEL_VALUE_QT_COULD_NOT_DELETE_FILE), MainWindow::MSGBOX_TYPE_ERROR, Qt::ApplicationModal, false);
          }
@@ -1361,6 +1369,7 @@ void MainWindow::deleteCurrentPlaylistItem()
    playlist_config.old_format          = settings->bools.playlist_use_old_format;
    playlist_config.compress            = settings->bools.playlist_compression;
    playlist_config.fuzzy_archive_match = settings->bools.playlist_fuzzy_archive_match;
+   playlist_config.binary_cache        = settings->bools.playlist_binary_cache;
 
    if (isAllPlaylist)
       return;
@@ -1408,6 +1417,7 @@ QString MainWindow::getPlaylistDefaultCore(QString dbName)
    playlist_config.old_format          = settings->bools.playlist_use_old_format;
    playlist_config.compress            = settings->bools.playlist_compression;
    playlist_config.fuzzy_archive_match = settings->bools.playlist_fuzzy_archive_match;
+   playlist_config.binary_cache        = settings->bools.playlist_binary_cache;
 
    playlistPath[0] = '\0';
 
@@ -1478,6 +1488,7 @@ void PlaylistModel::getPlaylistItems(QString path)
    playlist_config.old_format          = settings->bools.playlist_use_old_format;
    playlist_config.compress            = settings->bools.playlist_compression;
    playlist_config.fuzzy_archive_match = settings->bools.playlist_fuzzy_archive_match;
+   playlist_config.binary_cache        = settings->bools.playlist_binary_cache;
 
    pathArray.append(path);
    pathData              = pathArray.constData();
@@ -1426,7 +1426,7 @@ QVector<QHash<QString, QString> > MainWindow::getCoreInfo()
 
    if (     currentCore["core_path"].isEmpty() 
          || !core_info 
-         || !core_info->config_data)
+         || !core_info->has_info)
    {
       QHash<QString, QString> hash;
 